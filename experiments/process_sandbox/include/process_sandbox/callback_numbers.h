@@ -66,6 +66,11 @@ namespace sandbox
      * Marker for the last built-in callback that represents a libc function.
      */
     LastLibCCall = GetAddrInfo,
+    /**
+     * Fetching a read-only handle to a `SharedBuffer`, so that the child can
+     * map it.
+     */
+    MapSharedBuffer,
     /**
      * Total number of built-in callback kinds.
      */
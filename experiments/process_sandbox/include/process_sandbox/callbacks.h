@@ -376,5 +376,14 @@ namespace sandbox
   : internal::SyscallArgsBase<Connect, decltype(::connect)>
   {};
 
+  /**
+   * The arguments for fetching a `SharedBuffer`: the identifier from its
+   * `SharedBufferFrame`.
+   */
+  template<>
+  struct SyscallArgs<MapSharedBuffer>
+  : internal::SyscallArgsBase<MapSharedBuffer, int(uintptr_t)>
+  {};
+
   SANDBOX_GCC_DIAGNOSTIC_POP()
 }
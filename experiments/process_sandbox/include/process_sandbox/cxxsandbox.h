@@ -3,6 +3,8 @@
 
 #pragma once
 #include "sandbox.h"
+
+#include <future>
 /**
  * The generic sandbox code requires that libraries provide an initialisation
  * function and a dispatcher function, a vtable, and code for storing call
@@ -64,6 +66,10 @@ namespace sandbox
      * The index of this function in the library's vtable.
      */
     int vtable_index;
+    /**
+     * The time limit of each call, or zero to use the library's.
+     */
+    std::chrono::milliseconds timeout{0};
     /**
      * Designated constructor.  The public constructor both delegates to this
      * and calls it when construction a new temporary sandboxed function to
@@ -71,6 +77,73 @@ namespace sandbox
      */
     Function(Library& l, int idx) : lib(l), vtable_index(idx) {}
 
+    /**
+     * Allocate an argument frame in the sandbox and copy the arguments into
+     * it.
+     */
+    CallFrame* make_frame(Args... args)
+    {
+      auto cf = lib.alloc<CallFrame>();
+      if (!cf)
+      {
+        throw std::bad_alloc();
+      }
+      CallFrame* callframe = cf.value();
+      callframe->args = std::forward_as_tuple(args...);
+      return callframe;
+    }
+
+    /**
+     * Make the call with the arguments in `callframe`, which this frees, and
+     * wait for the return value.
+     */
+    Ret complete(CallFrame* callframe)
+    {
+      try
+      {
+        lib.send(vtable_index, callframe, timeout);
+      }
+      catch (...)
+      {
+        lib.free(callframe);
+        throw;
+      }
+      if constexpr (!std::is_void_v<Ret>)
+      {
+        Ret r = callframe->ret;
+        lib.free(callframe);
+        return r;
+      }
+      else
+      {
+        lib.free(callframe);
+      }
+    }
+
+    /**
+     * A call queued by `async_then`, which passes its result to `done`.
+     */
+    template<typename F>
+    struct Then : public AsyncCall
+    {
+      Function& fn;
+      CallFrame* callframe;
+      F done;
+
+      Then(Function& fn, CallFrame* callframe, F&& done)
+      : fn(fn), callframe(callframe), done(std::move(done))
+      {}
+
+      void run() override
+      {
+        std::packaged_task<Ret()> call(
+          [&]() -> Ret { return fn.complete(callframe); });
+        std::future<Ret> result = call.get_future();
+        call();
+        done(std::move(result));
+      }
+    };
+
   public:
     /**
      * Public constructor.  Called with a sandboxed library as an argument and
@@ -98,24 +171,76 @@ namespace sandbox
      */
     Ret operator()(Args... args)
     {
-      auto cf = lib.alloc<CallFrame>();
-      if (!cf)
-      {
-        throw std::bad_alloc();
-      }
-      CallFrame* callframe = cf.value();
-      callframe->args = std::forward_as_tuple(args...);
-      lib.send(vtable_index, callframe);
-      if constexpr (!std::is_void_v<Ret>)
-      {
-        Ret r = callframe->ret;
-        lib.free(callframe);
-        return r;
-      }
-      else
-      {
-        lib.free(callframe);
-      }
+      return complete(make_frame(args...));
+    }
+
+    /**
+     * Limit each call of this function to `t`, instead of the limit set by
+     * `Library::set_call_timeout`, or use that again if `t` is zero.  A call
+     * that runs for longer terminates the sandbox and throws
+     * `std::runtime_error`.
+     */
+    void set_timeout(std::chrono::milliseconds t)
+    {
+      timeout = t;
+    }
+
+    /**
+     * Returns the counters for calls of this function.
+     */
+    const CallStats& stats() const
+    {
+      return lib.stats().function(vtable_index);
+    }
+
+    /**
+     * Asynchronous call.  Copies the arguments into the sandbox and returns
+     * without waiting for the call, which is made by a thread owned by the
+     * library.  When the call completes, that thread calls `done` with a
+     * ready `std::future<Ret>`, whose `get` returns the return value or
+     * throws the error that ended the call.  `done` may be move-only, such as
+     * a lambda that owns the writer of a Verona promise and fulfills it.
+     *
+     * Callbacks made by the sandbox during the call are handled on the
+     * library's thread.  This function object must outlive the call.
+     */
+    template<typename F>
+    void async_then(F&& done, Args... args)
+    {
+      CallFrame* callframe = make_frame(args...);
+      lib.send_async(std::make_unique<Then<std::decay_t<F>>>(
+        *this, callframe, std::decay_t<F>(std::forward<F>(done))));
+    }
+
+    /**
+     * Asynchronous call, as `async_then`, that returns a future for the
+     * result.
+     */
+    std::future<Ret> async(Args... args)
+    {
+      std::promise<Ret> p;
+      std::future<Ret> result = p.get_future();
+      async_then(
+        [p = std::move(p)](std::future<Ret> r) mutable {
+          try
+          {
+            if constexpr (std::is_void_v<Ret>)
+            {
+              r.get();
+              p.set_value();
+            }
+            else
+            {
+              p.set_value(r.get());
+            }
+          }
+          catch (...)
+          {
+            p.set_exception(std::current_exception());
+          }
+        },
+        args...);
+      return result;
     }
   };
 
@@ -22,7 +22,10 @@
 #include "path.h"
 #include "platform/platform.h"
 
+#include <atomic>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -50,9 +53,24 @@ namespace sandbox
    * controls.  For example, when running a Verona program as `root`,
    * sandboxed code should not have read-write access to `/lib`, even if the
    * `root` user does.
+   *
+   * Lookups are cached by path, including the paths that are not found, so
+   * that repeatedly probing for files (as run-time linkers do) does not walk
+   * the tree each time.  Adding to the tree discards the cache.  The tree is
+   * normally set up before the sandbox first runs, after which `freeze` can
+   * be called to make it immutable, so that lookups no longer lock it.
+   * Handles returned by a lookup are owned by the tree and so are valid only
+   * until the path that they were found by is replaced.
    */
   class ExportedFileTree
   {
+  public:
+    /**
+     * The result of looking up a file, see `lookup_file`.
+     */
+    using LookupResult = std::optional<std::pair<platform::handle_t, Path>>;
+
+  private:
     /**
      * A single directory within the exported tree.  This class exists mostly
      * because C++ does not allow recursive types without an explicitly named
@@ -198,6 +216,100 @@ namespace sandbox
      */
     DirPtr root = std::make_shared<ExportedDirectory>();
 
+    /**
+     * Lock protecting the tree while it can change.  Once the tree is frozen,
+     * lookups do not take this lock.
+     */
+    std::shared_mutex tree_lock;
+
+    /**
+     * Set by `freeze`, after which the tree cannot change.
+     */
+    std::atomic<bool> frozen = false;
+
+    /**
+     * The maximum number of paths in `cache`.  When it is full, the cache is
+     * emptied, which is cheaper than tracking the use of each entry, and
+     * suffices for the paths probed repeatedly by a single program.
+     */
+    static constexpr size_t MaxCachedPaths = 4096;
+
+    /**
+     * Lock protecting `cache` and `cache_generation`.
+     */
+    std::mutex cache_lock;
+
+    /**
+     * The results of earlier lookups, by canonical path, including failed
+     * ones.
+     */
+    std::unordered_map<std::string, LookupResult> cache;
+
+    /**
+     * Incremented each time that the tree changes, so that a lookup that
+     * raced with the change does not cache its result.
+     */
+    size_t cache_generation = 0;
+
+    /**
+     * Walk the tree to look up `path`, see `lookup_file`.
+     */
+    LookupResult resolve(const Path& path)
+    {
+      DirPtr dir = root;
+      auto i = path.begin(), e = path.end();
+      if (std::distance(i, e) > 1)
+      {
+        auto last_dir = e;
+        --last_dir;
+        for (; i != last_dir; ++i)
+        {
+          auto result = dir->get_dir(*i);
+          if (std::holds_alternative<DirPtr>(result))
+          {
+            dir = std::get<DirPtr>(result);
+          }
+          else if (std::holds_alternative<platform::handle_t>(result))
+          {
+            return std::make_pair(
+              std::get<platform::handle_t>(result), Path(++i, e));
+          }
+          else
+          {
+            return {};
+          }
+        }
+      }
+      if (i != e)
+      {
+        auto file = dir->get_file(*i);
+        if (file)
+        {
+          return std::make_pair(file.value(), Path());
+        }
+      }
+      return {};
+    }
+
+    /**
+     * Modify the tree with `add`, unless it is frozen, and discard the cache.
+     * Returns false if the tree is frozen or `add` fails.
+     */
+    template<typename T>
+    bool modify(T&& add)
+    {
+      std::unique_lock g(tree_lock);
+      if (frozen)
+      {
+        return false;
+      }
+      bool ret = add();
+      std::lock_guard cg(cache_lock);
+      cache.clear();
+      cache_generation++;
+      return ret;
+    }
+
     /**
      * Add a handle at a specific page.  This is a helper method for the public
      * interfaces that add a file or directory handle.  The `add` parameter
@@ -253,42 +365,49 @@ namespace sandbox
      *
      * The argument is a canonicalised path.
      */
-    std::optional<std::pair<platform::handle_t, Path>>
-    lookup_file(const Path& path)
+    LookupResult lookup_file(const Path& path)
     {
-      DirPtr dir = root;
-      auto i = path.begin(), e = path.end();
-      if (std::distance(i, e) > 1)
+      std::string key = path.str();
+      size_t generation;
       {
-        auto last_dir = e;
-        --last_dir;
-        for (; i != last_dir; ++i)
+        std::lock_guard g(cache_lock);
+        auto it = cache.find(key);
+        if (it != cache.end())
         {
-          auto result = dir->get_dir(*i);
-          if (std::holds_alternative<DirPtr>(result))
-          {
-            dir = std::get<DirPtr>(result);
-          }
-          else if (std::holds_alternative<platform::handle_t>(result))
-          {
-            return std::make_pair(
-              std::get<platform::handle_t>(result), Path(++i, e));
-          }
-          else
-          {
-            return {};
-          }
+          return it->second;
         }
+        generation = cache_generation;
       }
-      if (i != e)
+      LookupResult result;
+      if (frozen)
       {
-        auto file = dir->get_file(*i);
-        if (file)
+        result = resolve(path);
+      }
+      else
+      {
+        std::shared_lock g(tree_lock);
+        result = resolve(path);
+      }
+      std::lock_guard g(cache_lock);
+      if (generation == cache_generation)
+      {
+        if (cache.size() >= MaxCachedPaths)
         {
-          return std::make_pair(file.value(), Path());
+          cache.clear();
         }
+        cache.emplace(std::move(key), result);
       }
-      return {};
+      return result;
+    }
+
+    /**
+     * Prevent any further changes to the tree.  Lookups then read it without
+     * locking, and adding to it fails.
+     */
+    void freeze()
+    {
+      std::unique_lock g(tree_lock);
+      frozen = true;
     }
 
     /**
@@ -296,23 +415,30 @@ namespace sandbox
      * success or false on failure.  Once a part of an exported tree is
      * represented by a directory handle, it cannot be replaced with a virtual
      * tree.  The directory descriptor may already be exposed in the sandbox
-     * and cannot be revoked.
+     * and cannot be revoked.  Fails if the tree is frozen.
      */
     bool add_directory(const std::string& path, platform::Handle&& file)
     {
-      return add_handle(path, [&](const std::string& filename, DirPtr& dir) {
-        dir->add_directory(filename, std::move(file));
+      return modify([&]() {
+        return add_handle(
+          path, [&](const std::string& filename, DirPtr& dir) {
+            dir->add_directory(filename, std::move(file));
+          });
       });
     }
 
     /**
      * Add a file, represented by a handle, to the exported tree, at the
-     * specified path.  Returns true on success, false on failure.
+     * specified path.  Returns true on success, false on failure, including
+     * if the tree is frozen.
      */
     bool add_file(const std::string& path, platform::Handle&& file)
     {
-      return add_handle(path, [&](const std::string& filename, DirPtr& dir) {
-        dir->add_file(filename, std::move(file));
+      return modify([&]() {
+        return add_handle(
+          path, [&](const std::string& filename, DirPtr& dir) {
+            dir->add_file(filename, std::move(file));
+          });
       });
     }
   };
@@ -9,7 +9,13 @@
  */
 
 #pragma once
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
 #include <netdb.h>
+#include <netinet/in.h>
 #include <optional>
 #include <string>
 #include <sys/socket.h>
@@ -17,7 +23,9 @@
 #include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
+#include <vector>
 
 namespace sandbox
 {
@@ -120,14 +128,284 @@ namespace sandbox
     };
 
     /**
-     * A policy.  This is either allow-all, deny-all, or invoke a callback to
-     * handle each specific case.  The arguments to these functions are copied
-     * before the callback is invoked, so the callback does not have to worry
-     * about TOCTOU bugs.
+     * A set of IPv4 and IPv6 addresses that `bind` or `connect` may use,
+     * held in a hash table so that checking an address does not depend on
+     * the number of addresses allowed.  Port 0 in an entry allows any port on
+     * that address.
+     */
+    class AddressSet
+    {
+      /**
+       * The parts of a `sockaddr_in` or `sockaddr_in6` that are compared.
+       * IPv4 addresses use the first 4 bytes of `addr`.
+       */
+      struct Key
+      {
+        sa_family_t family = AF_UNSPEC;
+        in_port_t port = 0;
+        std::array<uint8_t, 16> addr = {};
+
+        bool operator==(const Key& other) const
+        {
+          return (family == other.family) && (port == other.port) &&
+            (addr == other.addr);
+        }
+      };
+
+      /**
+       * FNV-1a hash of the fields of a `Key`.
+       */
+      struct KeyHash
+      {
+        size_t operator()(const Key& k) const
+        {
+          uint64_t h = 0xcbf29ce484222325;
+          auto mix = [&](uint8_t b) {
+            h ^= b;
+            h *= 0x100000001b3;
+          };
+          mix(static_cast<uint8_t>(k.family));
+          mix(static_cast<uint8_t>(k.port));
+          mix(static_cast<uint8_t>(k.port >> 8));
+          for (auto b : k.addr)
+          {
+            mix(b);
+          }
+          return static_cast<size_t>(h);
+        }
+      };
+
+      /**
+       * The allowed addresses.
+       */
+      std::unordered_set<Key, KeyHash> keys;
+
+      /**
+       * Extract the key from an address.  Returns `std::nullopt` for
+       * addresses that are not IPv4 or IPv6, or are too short.
+       */
+      static std::optional<Key> key_for(const sockaddr* addr, socklen_t len)
+      {
+        Key k;
+        if ((addr == nullptr) || (len < sizeof(sa_family_t)))
+        {
+          return std::nullopt;
+        }
+        if ((addr->sa_family == AF_INET) && (len >= sizeof(sockaddr_in)))
+        {
+          auto in = reinterpret_cast<const sockaddr_in*>(addr);
+          k.family = AF_INET;
+          k.port = in->sin_port;
+          memcpy(k.addr.data(), &in->sin_addr, sizeof(in->sin_addr));
+          return k;
+        }
+        if ((addr->sa_family == AF_INET6) && (len >= sizeof(sockaddr_in6)))
+        {
+          auto in6 = reinterpret_cast<const sockaddr_in6*>(addr);
+          k.family = AF_INET6;
+          k.port = in6->sin6_port;
+          memcpy(k.addr.data(), &in6->sin6_addr, sizeof(in6->sin6_addr));
+          return k;
+        }
+        return std::nullopt;
+      }
+
+    public:
+      /**
+       * Add an address.  Returns false if it is not an IPv4 or IPv6 address.
+       */
+      bool add(const sockaddr* addr, socklen_t len)
+      {
+        auto k = key_for(addr, len);
+        if (!k)
+        {
+          return false;
+        }
+        keys.insert(*k);
+        return true;
+      }
+
+      /**
+       * Returns true if the address is in the set, either exactly or with a
+       * wildcard port.
+       */
+      bool contains(const sockaddr* addr, socklen_t len) const
+      {
+        auto k = key_for(addr, len);
+        if (!k)
+        {
+          return false;
+        }
+        if (keys.count(*k) != 0)
+        {
+          return true;
+        }
+        k->port = 0;
+        return keys.count(*k) != 0;
+      }
+    };
+
+    /**
+     * A cache of the results of `getaddrinfo`, keyed on the host, the
+     * service, and the fields of the hints that are passed through.  The
+     * results are deep copied, so that they do not depend on the lifetime of
+     * the list returned by the policy.  Failed lookups are not cached.
+     */
+    class DnsCache
+    {
+      /**
+       * A copied `getaddrinfo` result.  `list` points into `addrs` and into
+       * itself, so entries must not be copied once built.
+       */
+      struct Entry
+      {
+        std::chrono::steady_clock::time_point expiry;
+        std::vector<addrinfo> list;
+        std::vector<sockaddr_storage> addrs;
+
+        Entry(std::chrono::steady_clock::time_point expiry, const addrinfo* res)
+        : expiry(expiry)
+        {
+          for (auto cur = res; cur != nullptr; cur = cur->ai_next)
+          {
+            if (cur->ai_addrlen > sizeof(sockaddr_storage))
+            {
+              continue;
+            }
+            list.push_back(*cur);
+            addrs.emplace_back();
+            memcpy(&addrs.back(), cur->ai_addr, cur->ai_addrlen);
+          }
+          for (size_t i = 0; i < list.size(); i++)
+          {
+            list[i].ai_addr = reinterpret_cast<sockaddr*>(&addrs[i]);
+            list[i].ai_canonname = nullptr;
+            list[i].ai_next = (i + 1 < list.size()) ? &list[i + 1] : nullptr;
+          }
+        }
+
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+      };
+
+      /**
+       * The maximum number of entries.  When the cache is full, expired
+       * entries are dropped and, if that is not enough, the whole cache is
+       * cleared.
+       */
+      static constexpr size_t MaxEntries = 256;
+
+      /**
+       * Lock protecting `entries`, callbacks may be handled concurrently.
+       */
+      std::mutex lock;
+
+      /**
+       * The cached results.
+       */
+      std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+
+    public:
+      /**
+       * How long results are kept.  Zero disables the cache.
+       */
+      std::chrono::steady_clock::duration ttl{0};
+
+      /**
+       * Build the cache key for a lookup.  A null host or service is
+       * distinguished from an empty one.
+       */
+      static std::string
+      key_for(const char* host, const char* service, const addrinfo* hints)
+      {
+        std::string key;
+        for (auto str : {host, service})
+        {
+          key.push_back(str == nullptr ? '\0' : '\1');
+          if (str != nullptr)
+          {
+            key.append(str);
+            key.push_back('\0');
+          }
+        }
+        if (hints != nullptr)
+        {
+          int fields[] = {
+            hints->ai_flags,
+            hints->ai_family,
+            hints->ai_socktype,
+            hints->ai_protocol};
+          key.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+        }
+        return key;
+      }
+
+      /**
+       * Look up `key` and, if it has a result that has not expired, call `fn`
+       * with it while the cache is locked.  Returns true on a hit.
+       */
+      template<typename Fn>
+      bool find(const std::string& key, Fn&& fn)
+      {
+        std::lock_guard g(lock);
+        auto it = entries.find(key);
+        if (it == entries.end())
+        {
+          return false;
+        }
+        if (it->second->expiry <= std::chrono::steady_clock::now())
+        {
+          entries.erase(it);
+          return false;
+        }
+        fn(it->second->list.empty() ? nullptr : it->second->list.data());
+        return true;
+      }
+
+      /**
+       * Add a copy of `res` as the result for `key`.
+       */
+      void insert(const std::string& key, const addrinfo* res)
+      {
+        auto now = std::chrono::steady_clock::now();
+        auto entry = std::make_unique<Entry>(now + ttl, res);
+        std::lock_guard g(lock);
+        if (entries.size() >= MaxEntries)
+        {
+          for (auto it = entries.begin(); it != entries.end();)
+          {
+            it = (it->second->expiry <= now) ? entries.erase(it) : ++it;
+          }
+          if (entries.size() >= MaxEntries)
+          {
+            entries.clear();
+          }
+        }
+        entries[key] = std::move(entry);
+      }
+
+      /**
+       * Drop all cached results.
+       */
+      void clear()
+      {
+        std::lock_guard g(lock);
+        entries.clear();
+      }
+    };
+
+    /**
+     * A policy.  This is either allow-all, deny-all, allow a set of
+     * addresses, or invoke a callback to handle each specific case.  The
+     * arguments to these functions are copied before the callback is invoked,
+     * so the callback does not have to worry about TOCTOU bugs.  Address sets
+     * apply only to `bind` and `connect`.
      */
     template<typename Callback>
-    using Policy =
-      std::variant<SimplePolicy, std::function<remove_noexcept_t<Callback>>>;
+    using Policy = std::variant<
+      SimplePolicy,
+      std::function<remove_noexcept_t<Callback>>,
+      AddressSet>;
 
     /**
      * The set of default implementations for each of the functions.
@@ -160,6 +438,24 @@ namespace sandbox
       Policy<NetOpFnType<NetOperation::Connect>>>
       policies;
 
+    /**
+     * Cached results of `getaddrinfo`, see `cache_lookups`.
+     */
+    DnsCache dns_cache;
+
+    /**
+     * Called when the policy for `Op` changes.  Cached lookups were made
+     * under the old policy, so are discarded.
+     */
+    template<NetOperation Op>
+    void policy_changed()
+    {
+      if constexpr (Op == NetOperation::GetAddrInfo)
+      {
+        dns_cache.clear();
+      }
+    }
+
   public:
     /**
      * Function used to free the return from any explicit `getaddrinfo`
@@ -189,6 +485,7 @@ namespace sandbox
     void deny()
     {
       getPolicy<Op>() = Deny;
+      policy_changed<Op>();
     }
 
     /**
@@ -199,6 +496,7 @@ namespace sandbox
     void allow()
     {
       getPolicy<Op>() = Allow;
+      policy_changed<Op>();
     }
 
     /**
@@ -210,6 +508,77 @@ namespace sandbox
     void register_handler(NetOpCallbackType<Op> callback)
     {
       getPolicy<Op>() = callback;
+      policy_changed<Op>();
+    }
+
+    /**
+     * Allow the sandbox to `bind` or `connect` to `addr`, an IPv4 or IPv6
+     * address.  A port of 0 allows any port.  The first call replaces any
+     * other policy for `Op` with a set containing only this address, later
+     * calls add to the set.  Requests for addresses that are not in the set
+     * fail with `EACCES`.  Returns false if `addr` is not IPv4 or IPv6.
+     */
+    template<NetOperation Op>
+    bool allow_address(const sockaddr* addr, socklen_t addrlen)
+    {
+      static_assert(
+        Op != NetOperation::GetAddrInfo,
+        "Address sets apply only to bind and connect");
+      auto& policy = getPolicy<Op>();
+      if (!std::holds_alternative<AddressSet>(policy))
+      {
+        policy = AddressSet{};
+      }
+      return std::get<AddressSet>(policy).add(addr, addrlen);
+    }
+
+    /**
+     * Cache the results of successful `getaddrinfo` requests for `ttl`, so
+     * that repeated lookups of the same host do not reach the resolver or the
+     * registered handler.  `getaddrinfo` does not report the TTL of the DNS
+     * records, so this should be short.  A `ttl` of zero disables the cache.
+     */
+    void cache_lookups(std::chrono::steady_clock::duration ttl)
+    {
+      dns_cache.clear();
+      dns_cache.ttl = ttl;
+    }
+
+    /**
+     * Perform a `getaddrinfo` request, enforcing the registered policy and
+     * using the cache if it is enabled.  On success, `fn` is called with the
+     * result list, which is valid only for the duration of the call.  As with
+     * `invoke`, the caller must copy the arguments.
+     */
+    template<typename Fn>
+    int lookup_addrinfo(
+      const char* host, const char* service, const addrinfo* hints, Fn&& fn)
+    {
+      std::string key;
+      if (dns_cache.ttl.count() != 0)
+      {
+        key = DnsCache::key_for(host, service, hints);
+        if (dns_cache.find(key, fn))
+        {
+          return 0;
+        }
+      }
+      addrinfo* res = nullptr;
+      int ret =
+        invoke<NetOperation::GetAddrInfo>(host, service, hints, &res);
+      if (ret == 0)
+      {
+        if (dns_cache.ttl.count() != 0)
+        {
+          dns_cache.insert(key, res);
+        }
+        fn(res);
+        if (res != nullptr)
+        {
+          freeaddrinfo(res);
+        }
+      }
+      return ret;
     }
 
     /**
@@ -234,6 +603,25 @@ namespace sandbox
             return std::get<static_cast<int>(Op)>(systemImplementations)(
               std::forward<Args>(args)...);
           }
+          else if constexpr (std::is_same_v<T, AddressSet>)
+          {
+            if constexpr (Op == NetOperation::GetAddrInfo)
+            {
+              errno = ENOSYS;
+              return -1;
+            }
+            else
+            {
+              std::tuple<Args...> copy{args...};
+              if (!v.contains(std::get<1>(copy), std::get<2>(copy)))
+              {
+                errno = EACCES;
+                return -1;
+              }
+              return std::get<static_cast<int>(Op)>(systemImplementations)(
+                std::forward<Args>(args)...);
+            }
+          }
           else
           {
             return v(std::forward<Args>(args)...);
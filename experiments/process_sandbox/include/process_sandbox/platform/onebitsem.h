@@ -23,12 +23,24 @@
  * Blocks for either the specified number of milliseconds have elapsed or
  * until `wake` is called.  Returns true if the return is in response to a wake
  * event, false if it is in response to a timeout.
+ *
+ * ```
+ * bool try_wait();
+ * ```
+ *
+ * Consumes a wake event if there is one, without blocking.  Returns true if
+ * there was.
+ *
+ * The `AdaptiveSpin` class in this file wraps `wait` with a spinning phase, for
+ * calls that complete faster than a sleep and wake in the kernel.
  */
 
 #include "onebitsem_futex.h"
 #include "onebitsem_umtx.h"
 //#include "onebitsem_posix.h"
 
+#include <algorithm>
+
 namespace sandbox
 {
   namespace platform
@@ -44,5 +56,46 @@ namespace sandbox
 #  error No one-bit semaphore defined for your platform
 #endif
       ;
+
+    /**
+     * Spin on a one-bit semaphore before blocking on it.  The number of spins
+     * adapts to the waits that use this: it doubles, up to `MaxSpins`, each
+     * time a spin sees the wake, and halves, down to `MinSpins`, each time
+     * the wait has to block.  Short calls are then served without a system
+     * call on either side, while a side that is idle quickly stops spinning.
+     *
+     * This holds no shared state and so should live in the private memory of
+     * the side that waits, one per semaphore waited on.
+     */
+    class AdaptiveSpin
+    {
+      /**
+       * Number of times to poll the semaphore in the next wait.
+       */
+      uint32_t spins = MinSpins;
+
+    public:
+      static constexpr uint32_t MinSpins = 16;
+      static constexpr uint32_t MaxSpins = 1 << 14;
+
+      /**
+       * Wait on `sem` for up to `milliseconds` after spinning, with the same
+       * return value as `OneBitSem::wait`.
+       */
+      bool wait(OneBitSem& sem, int milliseconds)
+      {
+        for (uint32_t i = 0; i < spins; i++)
+        {
+          if (sem.try_wait())
+          {
+            spins = std::min(spins * 2, MaxSpins);
+            return true;
+          }
+          snmalloc::Aal::pause();
+        }
+        spins = std::max(spins / 2, MinSpins);
+        return sem.wait(milliseconds);
+      }
+    };
   }
 }
@@ -23,6 +23,12 @@ namespace sandbox::platform
      * Attempting to wait while the value is 0 will block.
      */
     std::atomic<int> flag = {0};
+    /**
+     * The number of threads that are, or are about to be, blocked in the
+     * kernel on `flag`.  A wake makes a system call only if this is not zero,
+     * so that waking a thread that is spinning is cheap.
+     */
+    std::atomic<int> waiters = {0};
     int
     futex_op(int futex_op, int val, const struct timespec* timeout = nullptr)
     {
@@ -38,26 +44,32 @@ namespace sandbox::platform
     }
     void wake()
     {
-      uint32_t old = flag.fetch_add(1, std::memory_order_release);
+      // Sequentially consistent, so that either this sees a waiter that has
+      // registered, or the waiter's `FUTEX_WAIT` sees the new value.
+      uint32_t old = flag.fetch_add(1);
       SANDBOX_INVARIANT(
         old == 0,
         "Waking up one-bit semaphore that's already awake.  Count: {}.",
         old);
-      futex_op(FUTEX_WAKE, 1);
+      if (waiters.load() != 0)
+      {
+        futex_op(FUTEX_WAKE, 1);
+      }
+    }
+    bool try_wait()
+    {
+      int f = flag.load();
+      if (f > 0)
+      {
+        assert(f == 1);
+        return flag.compare_exchange_strong(
+          f, f - 1, std::memory_order_acquire, std::memory_order_acquire);
+      }
+      return false;
     }
     bool wait(int milliseconds)
     {
-      auto try_lock = [&]() {
-        int f = flag.load();
-        if (f > 0)
-        {
-          assert(f == 1);
-          return flag.compare_exchange_strong(
-            f, f - 1, std::memory_order_acquire, std::memory_order_acquire);
-        }
-        return false;
-      };
-      if (try_lock())
+      if (try_wait())
       {
         return true;
       }
@@ -67,12 +79,14 @@ namespace sandbox::platform
       struct timespec timeout = {milliseconds / 1000,
                                  (milliseconds % 1000) * 1000000};
       int ret;
+      waiters++;
       do
       {
         ret = futex_op(FUTEX_WAIT, 0, &timeout);
       } while ((ret == -1) && (errno == EINTR));
+      waiters--;
       assert((ret != -1) || ((errno == ETIMEDOUT) || (errno == EAGAIN)));
-      return try_lock();
+      return try_wait();
     }
   };
 }
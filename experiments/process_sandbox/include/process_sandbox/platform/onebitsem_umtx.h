@@ -53,25 +53,26 @@ namespace sandbox::platform
         SANDBOX_INVARIANT(ret == 0, "_umtx_op failed: {}", ret);
       }
     }
-    bool wait(int milliseconds)
+    bool try_wait()
     {
-      auto try_lock = [&]() {
-        uint32_t count = sem.count.load();
-        if (USEM_COUNT(count) > 0)
+      uint32_t count = sem.count.load();
+      if (USEM_COUNT(count) > 0)
+      {
+        assert(USEM_COUNT(count) == 1);
+        if (sem.count.compare_exchange_strong(
+              count,
+              count - 1,
+              std::memory_order_acquire,
+              std::memory_order_acquire))
         {
-          assert(USEM_COUNT(count) == 1);
-          if (sem.count.compare_exchange_strong(
-                count,
-                count - 1,
-                std::memory_order_acquire,
-                std::memory_order_acquire))
-          {
-            return true;
-          }
+          return true;
         }
-        return false;
-      };
-      if (try_lock())
+      }
+      return false;
+    }
+    bool wait(int milliseconds)
+    {
+      if (try_wait())
       {
         return true;
       }
@@ -96,7 +97,7 @@ namespace sandbox::platform
         timeout.timeout._timeout = timeout.remainder;
       } while ((ret == -1) && (errno == EINTR));
       assert((ret != -1) || (errno == ETIMEDOUT));
-      return try_lock();
+      return try_wait();
     }
   };
 }
@@ -13,7 +13,10 @@
 #include <assert.h>
 #include <functional>
 #ifdef __linux__
+#  include <link.h>
+#  include <sys/mman.h>
 #  include <sys/personality.h>
+#  include <unistd.h>
 #endif
 
 #pragma once
@@ -146,6 +149,46 @@ namespace sandbox
 #ifdef __linux__
       int p = personality(0xffffffff);
       personality(p | ADDR_NO_RANDOMIZE);
+#endif
+    }
+
+    /**
+     * Allow the kernel to merge the pages of relocated read-only data
+     * (`PT_GNU_RELRO`) of every loaded object with identical pages in other
+     * processes.  Children run without ASLR, so every sandbox of a library
+     * loads it, and the libraries that it depends on, at the same addresses
+     * and ends up with the same contents in these pages.  For C++ libraries
+     * this includes all of the vtables.  The pages are read-only once loaded,
+     * so merging them does not let one sandbox observe what another does.
+     *
+     * This has an effect only on Linux, when KSM is enabled.
+     */
+    inline void share_relro_pages()
+    {
+#if defined(__linux__) && defined(MADV_MERGEABLE)
+      dl_iterate_phdr(
+        [](dl_phdr_info* info, size_t, void*) {
+          auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+          for (int i = 0; i < info->dlpi_phnum; i++)
+          {
+            auto& phdr = info->dlpi_phdr[i];
+            if (phdr.p_type != PT_GNU_RELRO)
+            {
+              continue;
+            }
+            // The loader protects only the whole pages, do the same.
+            uintptr_t start = (info->dlpi_addr + phdr.p_vaddr) & ~(page - 1);
+            uintptr_t end = (info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz) &
+              ~(page - 1);
+            if (start < end)
+            {
+              madvise(
+                reinterpret_cast<void*>(start), end - start, MADV_MERGEABLE);
+            }
+          }
+          return 0;
+        },
+        nullptr);
 #endif
     }
   }
@@ -11,6 +11,12 @@ SANDBOX_CLANG_DIAGNOSTIC_POP()
 #  include <assert.h>
 #  include <process_sandbox/sandbox_fd_numbers.h>
 
+// The parent can service system calls from a user-notification listener if
+// libseccomp supports it.  The parent decodes the calls on x86-64 only.
+#  if defined(SCMP_ACT_NOTIFY) && defined(__x86_64__)
+#    define SANDBOX_HAS_SYSCALL_NOTIFY
+#  endif
+
 namespace sandbox
 {
   namespace platform
@@ -27,7 +33,10 @@ namespace sandbox
      *   These are typically things that require root privilege.
      * - Those that might be allowed, depending on the arguments.  These are
      *   configured to trap and the signal handler then tries to perform an
-     *   upcall for them.
+     *   upcall for them.  Alternatively, the file-system calls among them
+     *   can be reported to a user-notification listener that the parent
+     *   holds, which services them without a signal being delivered in the
+     *   child, see `apply_sandboxing_policy_postexec_notify`.
      */
     struct SandboxSeccompBPF
     {
@@ -65,6 +74,30 @@ namespace sandbox
        */
       static void apply_sandboxing_policy_postexec()
       {
+        apply_policy(false);
+      }
+
+#  ifdef SANDBOX_HAS_SYSCALL_NOTIFY
+      /**
+       * Apply the sandboxing policy, with the file-system calls that the
+       * parent polices reported to a user-notification listener instead of
+       * trapping.  Returns the listener, which must be passed to the parent,
+       * or -1 on failure.
+       */
+      static int apply_sandboxing_policy_postexec_notify()
+      {
+        return apply_policy(true);
+      }
+#  endif
+
+    private:
+      /**
+       * Apply the policy.  If `notify` is true, returns the listener for the
+       * system calls that the parent services, otherwise -1.
+       */
+      static int apply_policy(bool notify)
+      {
+        (void)notify;
         scmp_filter_ctx ctx = nullptr;
 #  ifndef DEBUG_SANDBOX
         ctx = seccomp_init(SCMP_ACT_KILL);
@@ -87,6 +120,17 @@ namespace sandbox
         auto trap = [&](auto syscall, auto... rules) {
           add_rule(SCMP_ACT_TRAP, syscall, rules...);
         };
+        // The system calls that the parent can service directly.
+        auto forward = [&](auto syscall) {
+#  ifdef SANDBOX_HAS_SYSCALL_NOTIFY
+          if (notify)
+          {
+            add_rule(SCMP_ACT_NOTIFY, syscall);
+            return;
+          }
+#  endif
+          trap(syscall);
+        };
         // Documentation only.  Deny is the default behaviour
         auto deny = [&](auto syscall) { (void)syscall; };
         pid_t self = getpid();
@@ -405,11 +449,11 @@ namespace sandbox
 
         // These system calls can be handled sometimes, depending on the
         // dynamic policy.
-        trap(SCMP_SYS(open));
-        trap(SCMP_SYS(stat));
+        forward(SCMP_SYS(open));
+        forward(SCMP_SYS(stat));
         trap(SCMP_SYS(lstat));
         trap(SCMP_SYS(ioctl));
-        trap(SCMP_SYS(access));
+        forward(SCMP_SYS(access));
         trap(SCMP_SYS(shmget));
         trap(SCMP_SYS(connect));
         trap(SCMP_SYS(bind));
@@ -455,7 +499,7 @@ namespace sandbox
         trap(SCMP_SYS(open_by_handle_at));
         trap(SCMP_SYS(renameat2));
         trap(SCMP_SYS(statx));
-        trap(SCMP_SYS(openat));
+        forward(SCMP_SYS(openat));
         trap(SCMP_SYS(mkdirat));
         trap(SCMP_SYS(mknodat));
         trap(SCMP_SYS(fchownat));
@@ -473,8 +517,16 @@ namespace sandbox
 
         assert(ctx != nullptr);
         ret &= (seccomp_load(ctx) == 0);
+        int listener = -1;
+#  ifdef SANDBOX_HAS_SYSCALL_NOTIFY
+        if (notify && ret)
+        {
+          listener = seccomp_notify_fd(ctx);
+        }
+#  endif
         seccomp_release(ctx);
         assert(ret);
+        return listener;
       }
     };
   }
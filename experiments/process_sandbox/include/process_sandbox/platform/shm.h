@@ -12,7 +12,7 @@
  *   Handle& get_handle()
  *   size_t get_size()
  *   void* get_base()
- *
+ *   void discard()
  * };
  * ```
  *
@@ -20,7 +20,8 @@
  * anonymous shared memory object, and then maps it (naturally aligned)
  * somewhere in the address space.  The `get_handle` method returns the
  * platform-specific handle to the object, for passing to the child process.
- * The remaining two accessors get the size and base address of the mapping.
+ * The next two accessors get the size and base address of the mapping.
+ * `discard` zeroes the memory, releasing its pages.
  */
 
 #include "shm_posix.h"
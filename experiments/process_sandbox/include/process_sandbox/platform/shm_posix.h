@@ -3,6 +3,10 @@
 #ifdef __unix__
 #  include <fcntl.h>
 #  include <memory>
+#  include <stdio.h>
+#  ifdef __FreeBSD__
+#    include <sys/capsicum.h>
+#  endif
 #  include <sys/mman.h>
 #  include <sys/stat.h>
 #  include <sys/types.h>
@@ -232,6 +236,47 @@ namespace sandbox
         return mem_object.fd;
       }
 
+      /**
+       * Returns a new handle to the underlying memory that can be mapped only
+       * for reading, to share the memory with a process that must not modify
+       * it.  The returned handle is invalid if this is not possible.
+       */
+      Handle get_read_only_handle()
+      {
+#  if defined(__linux__)
+        // Reopening the object through procfs gives a file description that
+        // is not writeable, so it cannot be mapped or made writeable later.
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", get_fd());
+        return Handle(open(path, O_RDONLY | O_CLOEXEC));
+#  elif defined(__FreeBSD__)
+        Handle h(dup(get_fd()));
+        cap_rights_t rights;
+        cap_rights_init(&rights, CAP_MMAP_R, CAP_FSTAT);
+        if (h.is_valid() && (cap_rights_limit(h.fd, &rights) != 0))
+        {
+          h.reset(-1);
+        }
+        return h;
+#  else
+        return Handle();
+#  endif
+      }
+
+      /**
+       * Discard the contents of the memory, which then reads as zero, by
+       * truncating the object and growing it again.  The mapping remains
+       * valid, but touching it from any process before this returns may
+       * fault.
+       */
+      void discard()
+      {
+        int ret = ftruncate(get_fd(), 0);
+        SANDBOX_INVARIANT(ret == 0, "ftruncate failed {}", strerror(errno));
+        ret = ftruncate(get_fd(), size);
+        SANDBOX_INVARIANT(ret == 0, "ftruncate failed {}", strerror(errno));
+      }
+
       /**
        * The size, in bytes, of the mapped region.
        */
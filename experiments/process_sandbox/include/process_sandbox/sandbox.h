@@ -3,10 +3,16 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string.h>
+#include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 #ifdef __unix__
 #  include <fcntl.h>
@@ -21,6 +27,7 @@
 #include "sandbox_fd_numbers.h"
 #include "sandbox_meta_entry.h"
 #include "shared_memory_region.h"
+#include "stats.h"
 
 namespace sandbox
 {
@@ -28,6 +35,7 @@ namespace sandbox
   class ExportedFileTree;
   struct CallbackHandlerBase;
   class Library;
+  class SyscallNotifier;
 
   /**
    * An snmalloc Platform Abstraction Layer (PAL) that cannot be used to
@@ -475,6 +483,43 @@ namespace sandbox
     }
   };
 
+  /**
+   * How the system calls that the child may make only with the parent's
+   * approval, such as `open`, reach the parent.
+   */
+  enum class SyscallInterposition
+  {
+    /**
+     * The system call raises a signal in the child, whose handler forwards
+     * it to the parent as a callback.  This works everywhere.
+     */
+    Signal,
+    /**
+     * The kernel suspends the calling thread and reports the system call to
+     * the parent, which services it directly and installs any resulting file
+     * descriptor in the child.  No signal is delivered in the child.  This is
+     * available only with seccomp-bpf user notifications, see
+     * `Library::supports`.  Other system calls that need approval still use
+     * a signal.
+     */
+    UserNotification,
+  };
+
+  /**
+   * A call into a sandbox queued by `Library::send_async`.
+   */
+  struct AsyncCall
+  {
+    /**
+     * Make the call and deliver its result.
+     */
+    virtual void run() = 0;
+    /**
+     * Virtual destructor, for the subclasses that hold the state of the call.
+     */
+    virtual ~AsyncCall() {}
+  };
+
   /**
    * Class encapsulating an instance of a shared library in a sandbox.
    * Instances of this class will create a sandbox and load a specified library
@@ -517,6 +562,12 @@ namespace sandbox
      */
     std::unique_ptr<SharedAlloc> allocator;
 
+    /**
+     * Lock protecting `allocator`, which may be used by calls from several
+     * threads at once.
+     */
+    std::mutex allocator_lock;
+
     /**
      * The handle to the socket that is used to pass file descriptors to the
      * sandboxed process.
@@ -561,6 +612,35 @@ namespace sandbox
      */
     SharedAllocConfig::LocalState memory_provider;
 
+    /**
+     * The path of the library that the child loads.
+     */
+    std::string library_path;
+
+    /**
+     * The path of the `library_runner` binary that runs as the child.
+     */
+    std::string runner_path;
+
+    /**
+     * The number of times that the sandbox has been reset.  Anything that the
+     * host set up in an earlier child is gone after a reset.
+     */
+    size_t generation = 0;
+
+    /**
+     * Set up the header of the shared memory region, start a child process
+     * and create the allocator that the host uses in the sandbox heap.  This
+     * expects a heap that nothing has used and a fresh memory provider.
+     */
+    void start();
+
+    /**
+     * Clear the pagemap entries of the sandbox heap, freeing the metadata of
+     * the slabs that the host allocated.  The child must have exited.
+     */
+    void clear_pagemap();
+
     /**
      * Allocate some memory in the sandbox.  Returns `nullptr` if the
      * allocation failed.
@@ -610,6 +690,18 @@ namespace sandbox
      */
     std::unique_ptr<CallbackDispatcher> callback_dispatcher;
 
+    /**
+     * How system calls that need approval reach the parent.
+     */
+    SyscallInterposition interposition;
+
+    /**
+     * The thread that services the child's system calls, with
+     * `SyscallInterposition::UserNotification`.  This is replaced along with
+     * the child.
+     */
+    std::unique_ptr<SyscallNotifier> syscall_notifier;
+
   public:
     /**
      * Returns the next vtable entry to use, incrementing the counter so
@@ -629,8 +721,53 @@ namespace sandbox
     /**
      * Constructor.  Creates a new sandboxed instance of the library named by
      * `library_name`, with the heap size specified in GiBs.
+     *
+     * The child runs calls on `workers` threads (at most
+     * `SharedMemoryRegion::MaxWorkers`), so that many threads can call into
+     * the library at once.  With more than one worker, the functions exported
+     * by the library must be safe to call concurrently.  Calls beyond the
+     * number of workers wait for one to finish.  Callbacks from different
+     * workers are handled one at a time.
+     *
+     * System calls that need the parent's approval reach it as described by
+     * `interposition`, which must be supported on this platform.
      */
-    Library(const char* library_name, size_t heap_size_in_GiBs = 1);
+    Library(
+      const char* library_name,
+      size_t heap_size_in_GiBs = 1,
+      size_t workers = 1,
+      SyscallInterposition interposition = SyscallInterposition::Signal);
+    /**
+     * Returns whether sandboxes can be created with `interposition` on this
+     * platform.
+     */
+    static bool supports(SyscallInterposition interposition);
+    /**
+     * Return the sandbox to the state that it was in when it was constructed,
+     * for instance after a call failed or to remove all state left by one
+     * user before another.  The child is replaced by a new one that loads the
+     * library again, and the heap is discarded.  Functions and callbacks
+     * remain valid, but every pointer into the sandbox heap is invalid
+     * afterwards.  This must not be called while any call into the sandbox,
+     * including an asynchronous one, is in progress or queued.
+     *
+     * This is cheaper than creating a new `Library`: the shared memory,
+     * address range and callbacks are kept.
+     */
+    void reset();
+    /**
+     * Set the time that each call into the sandbox may take, or remove the
+     * limit if `timeout` is zero, which is the default.  A `Function` may set
+     * its own limit instead.  If a call runs for longer, the child is
+     * terminated and the call throws `std::runtime_error`.  The sandbox can
+     * then be used again after `reset`.
+     *
+     * This must not be called while any call is in progress.
+     */
+    void set_call_timeout(std::chrono::milliseconds timeout)
+    {
+      call_timeout = timeout;
+    }
     /**
      * Allocate space for an array of `count` instances of `T`.  Objects in the
      * array will be default constructed.
@@ -666,6 +803,15 @@ namespace sandbox
      */
     NetworkPolicy& network_policy();
 
+    /**
+     * Returns the counters for calls into this sandbox.  These are kept
+     * across `reset`.
+     */
+    const LibraryStats& stats() const
+    {
+      return statistics;
+    }
+
     /**
      * Register a handler for a callback from this sandbox.  The return value
      * the index of this that should be passed to the `invoke_user_callback`
@@ -786,21 +932,128 @@ namespace sandbox
 
   private:
     /**
-     * Is this the first time that we've invoked a sandbox?  If so, we will
-     * need to wait for it to be ready before we invoke it.
+     * Flag for waiting, once, for the sandbox to be ready before the first
+     * time that we invoke it.
+     */
+    std::unique_ptr<std::once_flag> child_loaded =
+      std::make_unique<std::once_flag>();
+    /**
+     * Wait for the child to finish loading the library, handling any
+     * callbacks that it makes in the meantime.
+     */
+    void wait_for_child_load();
+    /**
+     * The number of call slots in the shared region that are served by a
+     * worker in the child.
+     */
+    size_t worker_count;
+    /**
+     * Lock protecting `free_slots`.
+     */
+    std::mutex slots_lock;
+    /**
+     * Signalled when a slot is added to `free_slots`.
+     */
+    std::condition_variable slot_freed;
+    /**
+     * The indexes of the call slots that no call is using.  This is kept
+     * outside of the shared region, where the child could corrupt it.
+     */
+    std::vector<int> free_slots;
+    /**
+     * The spinning state of the waits for the child in each call slot.
+     */
+    platform::AdaptiveSpin spinners[SharedMemoryRegion::MaxWorkers];
+    /**
+     * Take a free call slot, waiting for one if every worker is busy.
+     */
+    int acquire_slot();
+    /**
+     * Return a call slot taken with `acquire_slot`.
+     */
+    void release_slot(int slot);
+    /**
+     * Holds a call slot for the duration of `send`.
+     */
+    friend class HeldSlot;
+    /**
+     * Lock protecting the state of the asynchronous calls below.
+     */
+    std::mutex async_lock;
+    /**
+     * Signalled when a call is added to `async_calls` or the library is being
+     * destroyed.
+     */
+    std::condition_variable async_ready;
+    /**
+     * Calls queued by `send_async` that no thread has started.
+     */
+    std::deque<std::unique_ptr<AsyncCall>> async_calls;
+    /**
+     * Threads that make the calls queued by `send_async`.  These are started
+     * when needed, up to one per worker in the child, since more could not
+     * make progress at once.
+     */
+    std::vector<std::thread> async_threads;
+    /**
+     * The number of threads in `async_threads` waiting for a call.
+     */
+    size_t async_idle = 0;
+    /**
+     * Set when the library is being destroyed.  The threads finish the queued
+     * calls and then exit.
+     */
+    bool async_stopping = false;
+    /**
+     * Lock protecting the shared buffer state below.
+     */
+    std::mutex shared_buffers_lock;
+    /**
+     * Read-only handles to the `SharedBuffer`s that the child is about to map,
+     * by the identifier that it passes back to fetch them.  The child never
+     * sees the address of the `SharedBuffer` itself.
+     */
+    std::unordered_map<uintptr_t, platform::Handle> shared_buffer_handles;
+    /**
+     * The identifier of the next `SharedBuffer`.
+     */
+    uintptr_t next_shared_buffer = 0;
+    /**
+     * SharedBuffer maps itself into the child with `send`.
+     */
+    friend class SharedBuffer;
+    /**
+     * The body of each thread in `async_threads`.
+     */
+    void run_async_calls();
+    /**
+     * Queue `call` to be run by a thread owned by this library, so that the
+     * caller does not block on the sandbox.
      */
-    bool is_first_call = true;
+    void send_async(std::unique_ptr<AsyncCall>&& call);
     /**
      * Function is allowed to call the following methods in this class.
      */
     template<typename Ret, typename... Args>
     friend class Function;
+    /**
+     * The limit set by `set_call_timeout`.
+     */
+    std::chrono::milliseconds call_timeout{0};
+    /**
+     * The counters returned by `stats`.
+     */
+    LibraryStats statistics;
     /**
      * Sends a message to the child process, containing a vtable index and a
      * pointer to the argument frame (a tuple of arguments and space for the
-     * return value).
+     * return value).  The call is limited to `timeout`, if it is not zero,
+     * or otherwise to `call_timeout`.
      */
-    void send(int idx, void* ptr);
+    void send(
+      int idx,
+      void* ptr,
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
     /**
      * Instruct the child to exit and block until it does.  The return value is
      * the exit code of the child process.  If the child has already exited,
@@ -825,10 +1078,27 @@ namespace sandbox
      */
     friend class MemoryServiceProvider;
 
+    /**
+     * Watchdog terminates the child when a call misses its deadline.
+     */
+    friend class Watchdog;
+
     /**
      * CallbackDispatcher needs to be able to terminate a running sandbox.
      */
     friend class CallbackDispatcher;
+
+    /**
+     * SyscallNotifier services system calls with the dispatcher.
+     */
+    friend class SyscallNotifier;
+
+    /**
+     * SandboxPool needs to be able to wait for a sandbox to load and check
+     * whether it is still running.
+     */
+    template<typename T>
+    friend class SandboxPool;
   };
 
   /**
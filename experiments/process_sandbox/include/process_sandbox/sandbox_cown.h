@@ -0,0 +1,154 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Integration of sandboxes with the Verona runtime.  This header requires the
+ * runtime's C++ API (`cpp/when.h`) on the include path, in addition to this
+ * library.
+ *
+ * A sandbox is owned by a cown, so that behaviours have exclusive access to
+ * it.  Calling into the sandbox from a behaviour would block the scheduler
+ * thread for the whole of the call, so `SandboxCown::call` instead starts the
+ * call on one of the library's own threads, see `Function::async_then`, and
+ * returns.  When the call completes, its result is delivered as a new
+ * behaviour on the sandbox's cown.  While a call is in progress, it counts as
+ * an external event source, so the runtime does not terminate.
+ *
+ *   struct Zlib
+ *   {
+ *     Library lib{"libsandboxed-zlib.so"};
+ *     Function<int, int> level{lib};
+ *   };
+ *   auto zlib = SandboxCown<Zlib>::make();
+ *   zlib.call(&Zlib::level, [](acquired_cown<Zlib>&, std::future<int> r) {
+ *     ...
+ *   }, 6);
+ */
+
+#pragma once
+#include "cxxsandbox.h"
+#include "sandbox.h"
+
+#include <cpp/when.h>
+#include <exception>
+#include <future>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+namespace sandbox
+{
+  /**
+   * A sandbox owned by a cown.  `T` is a structure that wraps a library in a
+   * member called `lib`, along with the `Function`s that call into it.
+   * Copies refer to the same cown.
+   *
+   * The cown is released while a call runs, so other behaviours on it may run
+   * concurrently with calls that they did not start.  They may use the
+   * library, which is safe to use from several threads, but must not `reset`
+   * it while any call is in progress.  Calls start in the order of the
+   * behaviours that started them and, with a single worker, complete in that
+   * order too.
+   */
+  template<typename T>
+  class SandboxCown
+  {
+    /**
+     * The cown that owns the sandbox.
+     */
+    verona::cpp::cown_ptr<T> box;
+
+    explicit SandboxCown(verona::cpp::cown_ptr<T>&& b) : box(std::move(b)) {}
+
+  public:
+    /**
+     * Create a sandbox, passing `args` to the constructor of `T`, in a new
+     * cown.
+     */
+    template<typename... CtorArgs>
+    static SandboxCown make(CtorArgs&&... args)
+    {
+      return SandboxCown(
+        verona::cpp::make_cown<T>(std::forward<CtorArgs>(args)...));
+    }
+
+    /**
+     * The cown that owns the sandbox, for scheduling other behaviours on it.
+     */
+    const verona::cpp::cown_ptr<T>& cown() const
+    {
+      return box;
+    }
+
+    /**
+     * Schedule a behaviour on the sandbox that calls the function `fn` of
+     * `T` with `args`, without blocking its scheduler thread while the call
+     * runs.  When the call completes, `done` runs as a behaviour on the
+     * sandbox, with the sandbox and a ready `std::future<Ret>`, whose `get`
+     * returns the result or throws the error that ended the call.
+     *
+     * To deliver the result to another cown, `done` can schedule a behaviour
+     * on it.
+     */
+    template<typename Ret, typename... Args, typename F, typename... CallArgs>
+    void call(Function<Ret, Args...> T::*fn, F&& done, CallArgs&&... args)
+    {
+      verona::cpp::when(box) <<
+        [box = box,
+         fn,
+         done = std::decay_t<F>(std::forward<F>(done)),
+         args = std::tuple<Args...>(std::forward<CallArgs>(args)...)](
+          verona::cpp::acquired_cown<T> self) mutable {
+          start_call(box, self, fn, std::move(done), std::move(args));
+        };
+    }
+
+  private:
+    /**
+     * Start the call, from a behaviour on the sandbox.
+     */
+    template<typename Ret, typename... Args, typename F>
+    static void start_call(
+      const verona::cpp::cown_ptr<T>& box,
+      verona::cpp::acquired_cown<T>& self,
+      Function<Ret, Args...> T::*fn,
+      F&& done,
+      std::tuple<Args...>&& args)
+    {
+      // Keep the runtime alive until the result has been delivered.  It
+      // must be removed on a scheduler thread, so this is done by the
+      // behaviour that delivers the result.
+      verona::rt::Scheduler::add_external_event_source();
+      // Shared so that it is still available here if starting the call fails
+      // after the completion has been handed over.
+      auto on_done = std::make_shared<std::decay_t<F>>(std::move(done));
+      // The references to the cown are moved into the behaviour, so that
+      // they are not dropped on the library's thread.  Dropping the last one
+      // there would destroy the library from one of its own threads.
+      auto deliver = [box, on_done](std::future<Ret> result) mutable {
+        verona::cpp::when(box) <<
+          [box = std::move(box),
+           on_done = std::move(on_done),
+           result = std::move(result)](
+            verona::cpp::acquired_cown<T> self) mutable {
+            verona::rt::Scheduler::remove_external_event_source();
+            (*on_done)(self, std::move(result));
+          };
+      };
+      try
+      {
+        std::apply(
+          [&](auto&... a) { (self.get_ref().*fn).async_then(deliver, a...); },
+          args);
+      }
+      catch (...)
+      {
+        // The call could not be started, for instance because the arguments
+        // could not be copied into the sandbox.  Report it in the same way.
+        std::promise<Ret> p;
+        p.set_exception(std::current_exception());
+        deliver(p.get_future());
+      }
+    }
+  };
+}
@@ -0,0 +1,291 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+#include "sandbox.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sandbox
+{
+  /**
+   * A pool of sandboxes that have already started and loaded their library,
+   * so that taking one does not pay for creating a child process.
+   *
+   * `T` is either `Library` or a structure that wraps a library in a member
+   * called `lib`, along with the `Function`s that call into it.  The pool
+   * creates sandboxes with the factory that it is given, on a thread of its
+   * own, and keeps `size` of them, either idle or leased.
+   *
+   * When a lease ends, the sandbox is returned to the pool if the pool
+   * recycles by `Recycle::Reuse`.  With `Recycle::Replace` it is destroyed
+   * and replaced by a fresh one, so that no state, including the contents of
+   * the heap, passes from one lease to the next.  A sandbox whose child has
+   * exited, or whose lease was discarded, is always replaced.
+   *
+   * All leases must end before the pool is destroyed.
+   */
+  template<typename T = Library>
+  class SandboxPool
+  {
+  public:
+    /**
+     * Creates a sandbox for the pool.
+     */
+    using Factory = std::function<std::unique_ptr<T>()>;
+
+    /**
+     * What happens to a sandbox at the end of a lease.
+     */
+    enum class Recycle
+    {
+      /**
+       * Return it to the pool, with the state that it has.
+       */
+      Reuse,
+      /**
+       * Destroy it and create a fresh one.
+       */
+      Replace,
+    };
+
+    /**
+     * Exclusive use of a sandbox from the pool, until this is destroyed.
+     */
+    class Lease
+    {
+      friend class SandboxPool;
+
+      /**
+       * The pool that this came from, or null if this has been moved from.
+       */
+      SandboxPool* pool;
+
+      /**
+       * The leased sandbox.
+       */
+      std::unique_ptr<T> sandbox;
+
+      /**
+       * Whether the sandbox may be used by another lease.
+       */
+      bool reusable = true;
+
+      Lease(SandboxPool* p, std::unique_ptr<T>&& s)
+      : pool(p), sandbox(std::move(s))
+      {}
+
+    public:
+      Lease(Lease&& other)
+      : pool(other.pool),
+        sandbox(std::move(other.sandbox)),
+        reusable(other.reusable)
+      {
+        other.pool = nullptr;
+      }
+
+      Lease(const Lease&) = delete;
+      Lease& operator=(const Lease&) = delete;
+      Lease& operator=(Lease&&) = delete;
+
+      ~Lease()
+      {
+        if (pool != nullptr)
+        {
+          pool->release(std::move(sandbox), reusable);
+        }
+      }
+
+      T& operator*()
+      {
+        return *sandbox;
+      }
+
+      T* operator->()
+      {
+        return sandbox.get();
+      }
+
+      /**
+       * Do not return the sandbox to the pool at the end of this lease, for
+       * example because a call into it failed and it may be in a bad state.
+       */
+      void discard()
+      {
+        reusable = false;
+      }
+    };
+
+  private:
+    /**
+     * Creates each sandbox.
+     */
+    Factory factory;
+
+    /**
+     * What happens to a sandbox at the end of a lease.
+     */
+    Recycle recycle;
+
+    /**
+     * Lock protecting the remaining fields.
+     */
+    std::mutex lock;
+
+    /**
+     * Signalled when a sandbox is added to `idle`.
+     */
+    std::condition_variable ready;
+
+    /**
+     * Signalled when `missing` increases or the pool is stopping.
+     */
+    std::condition_variable wanted;
+
+    /**
+     * Sandboxes that are loaded and not leased.
+     */
+    std::vector<std::unique_ptr<T>> idle;
+
+    /**
+     * The number of sandboxes that the pool is short of and that `filler`
+     * has not started to create.
+     */
+    size_t missing;
+
+    /**
+     * Set when the pool is being destroyed.
+     */
+    bool stopping = false;
+
+    /**
+     * Thread that creates sandboxes, so that the threads that lease them do
+     * not wait for a child process to start.
+     */
+    std::thread filler;
+
+    /**
+     * The library in `sandbox`.
+     */
+    static Library& library(T& sandbox)
+    {
+      if constexpr (std::is_same_v<T, Library>)
+      {
+        return sandbox;
+      }
+      else
+      {
+        return sandbox.lib;
+      }
+    }
+
+    /**
+     * Create sandboxes until the pool is stopping.
+     */
+    void fill()
+    {
+      std::unique_lock g(lock);
+      while (true)
+      {
+        wanted.wait(g, [&]() { return stopping || (missing > 0); });
+        if (stopping)
+        {
+          return;
+        }
+        missing--;
+        g.unlock();
+        std::unique_ptr<T> sandbox = factory();
+        Library& lib = library(*sandbox);
+        std::call_once(*lib.child_loaded, [&]() { lib.wait_for_child_load(); });
+        g.lock();
+        idle.push_back(std::move(sandbox));
+        ready.notify_one();
+      }
+    }
+
+    /**
+     * End the lease of `sandbox`.
+     */
+    void release(std::unique_ptr<T>&& sandbox, bool reusable)
+    {
+      reusable = reusable && (recycle == Recycle::Reuse) &&
+        !library(*sandbox).has_child_exited();
+      {
+        std::lock_guard g(lock);
+        if (reusable)
+        {
+          idle.push_back(std::move(sandbox));
+          ready.notify_one();
+          return;
+        }
+        missing++;
+        wanted.notify_one();
+      }
+      // Destroy the sandbox, which waits for its child to exit, without
+      // holding the lock.
+      sandbox.reset();
+    }
+
+  public:
+    /**
+     * Create a pool of `size` sandboxes, made by `factory`.  The sandboxes
+     * are created in the background, and `acquire` waits for them.
+     */
+    SandboxPool(size_t size, Factory f, Recycle r = Recycle::Reuse)
+    : factory(std::move(f)), recycle(r), missing(size)
+    {
+      filler = std::thread([this]() { fill(); });
+    }
+
+    SandboxPool(const SandboxPool&) = delete;
+    SandboxPool& operator=(const SandboxPool&) = delete;
+
+    ~SandboxPool()
+    {
+      {
+        std::lock_guard g(lock);
+        stopping = true;
+        wanted.notify_one();
+      }
+      filler.join();
+    }
+
+    /**
+     * Lease a loaded sandbox, waiting for one if none is idle.  Sandboxes
+     * whose child has exited while idle are replaced.
+     */
+    Lease acquire()
+    {
+      std::unique_lock g(lock);
+      while (true)
+      {
+        ready.wait(g, [&]() { return !idle.empty(); });
+        std::unique_ptr<T> sandbox = std::move(idle.back());
+        idle.pop_back();
+        if (!library(*sandbox).has_child_exited())
+        {
+          return Lease(this, std::move(sandbox));
+        }
+        missing++;
+        wanted.notify_one();
+        g.unlock();
+        sandbox.reset();
+        g.lock();
+      }
+    }
+
+    /**
+     * The number of sandboxes that are loaded and not leased.
+     */
+    size_t idle_count()
+    {
+      std::lock_guard g(lock);
+      return idle.size();
+    }
+  };
+}
@@ -0,0 +1,168 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Verona regions whose objects live in the heap of a sandbox.  This header
+ * requires the Verona runtime on the include path, in addition to this
+ * library.
+ *
+ * The host builds the input of a sandboxed function as a region, lends it to
+ * the sandbox by passing pointers into its objects, and reads the results
+ * that the sandbox writes there, without copying the data in either
+ * direction:
+ *
+ *   SandboxRegion<Input> input(lib);
+ *   input.get()->length = n;
+ *   parse(input.lend()->bytes, n);
+ *   auto* result = input.reclaim();
+ */
+
+#pragma once
+#include "sandbox.h"
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include <verona.h>
+
+namespace sandbox
+{
+  /**
+   * The memory of a region, allocated in the heap of a sandbox.  The
+   * allocations are recorded in the host, so that releasing the region frees
+   * them without reading anything that the sandbox can write.
+   */
+  class SandboxArenas : public verona::rt::ArenaSource
+  {
+    /**
+     * The library whose heap holds the memory.
+     */
+    Library& lib;
+
+    /**
+     * Every allocation made for the region.
+     */
+    std::vector<char*> chunks;
+
+  public:
+    explicit SandboxArenas(Library& l) : lib(l) {}
+
+    void* alloc_chunk(size_t size) override
+    {
+      auto p = lib.alloc<char>(size);
+      if (!p)
+      {
+        throw std::bad_alloc();
+      }
+      chunks.push_back(*p);
+      return *p;
+    }
+
+    void release() override
+    {
+      for (auto* p : chunks)
+      {
+        lib.free(p);
+      }
+      chunks.clear();
+    }
+  };
+
+  /**
+   * An arena region, with an Iso object of type `T`, whose objects are all
+   * allocated in the heap of a sandbox, see `verona::rt::ArenaSource`.  `T`
+   * and the other objects allocated in the region must be trivial Verona
+   * objects, `verona::rt::V<T>`, whose fields are plain data or pointers
+   * within the region.
+   *
+   * The sandbox can read and write the whole region at any time, since it is
+   * in its heap, but it only knows where the region is once the host lends
+   * it with `lend`.  From then on, the contents of the region, including the
+   * headers of its objects, are untrusted: the host must check any pointer
+   * that it reads from the region with `Library::contains`, and must not
+   * allocate in the region, which reads the header of the Iso object, unless
+   * it trusts the sandbox to have left it alone.  Releasing the region
+   * reads nothing in the sandbox heap.
+   *
+   * The region must be destroyed before the library.
+   */
+  template<typename T>
+  class SandboxRegion
+  {
+    /**
+     * The memory of the region.
+     */
+    std::unique_ptr<SandboxArenas> arenas;
+
+    /**
+     * The Iso object, in the sandbox heap.
+     */
+    T* root;
+
+    /**
+     * The metadata of the region, kept by the host so that releasing the
+     * region does not need the header of `root`.
+     */
+    verona::rt::RegionArena* region;
+
+    /**
+     * Whether the region is lent to the sandbox.
+     */
+    bool lent = false;
+
+  public:
+    /**
+     * Create a region in the heap of `lib`, passing `args` to the
+     * constructor of its Iso object.
+     */
+    template<typename... Args>
+    explicit SandboxRegion(Library& lib, Args&&... args)
+    : arenas(std::make_unique<SandboxArenas>(lib)),
+      root(new (arenas.get()) T(std::forward<Args>(args)...)),
+      region(verona::rt::RegionArena::get(root))
+    {}
+
+    SandboxRegion(const SandboxRegion&) = delete;
+    SandboxRegion& operator=(const SandboxRegion&) = delete;
+
+    ~SandboxRegion()
+    {
+      verona::rt::RegionArena::release_sourced(
+        verona::rt::ThreadAlloc::get(), region);
+    }
+
+    /**
+     * The Iso object, for the host to fill in the region.  Objects are
+     * allocated in the region while it is open, see `UsingRegion`.
+     */
+    T* get()
+    {
+      SANDBOX_INVARIANT(!lent, "Region is lent to the sandbox");
+      return root;
+    }
+
+    /**
+     * Hand the region over to the sandbox.  Returns the Iso object, whose
+     * address is the same in the sandbox, so pointers into the region can be
+     * passed to sandboxed functions as they are.
+     */
+    T* lend()
+    {
+      SANDBOX_INVARIANT(!lent, "Region is already lent to the sandbox");
+      lent = true;
+      return root;
+    }
+
+    /**
+     * Take the region back from the sandbox, once the calls that use it have
+     * returned.  Returns the Iso object.
+     */
+    T* reclaim()
+    {
+      SANDBOX_INVARIANT(lent, "Region is not lent to the sandbox");
+      lent = false;
+      return root;
+    }
+  };
+} // namespace sandbox
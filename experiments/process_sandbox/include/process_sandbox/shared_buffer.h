@@ -0,0 +1,205 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+#include "sandbox.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace sandbox
+{
+  /**
+   * A buffer of memory owned by the host and mapped read-only into a sandbox,
+   * so that large inputs can be passed to the sandbox without copying them
+   * into its heap.  The host writes to `data()`, at any time, and passes
+   * `in_sandbox()` to sandboxed functions.  The child is given a handle that
+   * can only be mapped for reading, so it cannot modify the buffer.
+   *
+   * The buffer is not part of the sandbox heap, so `Library::contains`
+   * rejects pointers into it, and callback handlers that check pointers with
+   * `contains` can never be made to read it.  Handlers that expect pointers
+   * into this buffer should check them with `SharedBuffer::contains`.
+   *
+   * Results can already be read from the sandbox heap in place, without a
+   * copy, because the host maps the whole heap.  Pointers into it must be
+   * checked with `Library::contains` and their contents may change at any
+   * time while the sandbox runs.
+   *
+   * The buffer must be destroyed before the library.  It is no longer mapped
+ * into the sandbox after `Library::reset`.
+   */
+  class SharedBuffer
+  {
+    /**
+     * The library that this buffer is mapped into.
+     */
+    Library& lib;
+
+    /**
+     * The memory, mapped read-write in the host.
+     */
+    platform::SharedMemoryMap shm;
+
+    /**
+     * The size that was asked for, which may be smaller than `shm`.
+     */
+    size_t length;
+
+    /**
+     * The address of the buffer in the child.  This is written by the child,
+     * so is used only to pass back to it.
+     */
+    void* sandbox_address = nullptr;
+
+    /**
+     * The `Library::generation` of the child that the buffer was mapped into.
+     * A child started by a reset has never mapped it.
+     */
+    size_t generation;
+
+    /**
+     * Run `function`, one of the functions of the library runner that take a
+     * `SharedBufferFrame`, in the child, and return the address that it
+     * leaves in the frame.
+     */
+    void* call(int function, uintptr_t id)
+    {
+      auto frame = lib.alloc<SharedBufferFrame>();
+      if (!frame)
+      {
+        throw std::bad_alloc();
+      }
+      (*frame)->id = id;
+      (*frame)->size = shm.get_size();
+      (*frame)->address = sandbox_address;
+      try
+      {
+        lib.send(function, *frame);
+      }
+      catch (...)
+      {
+        lib.free(*frame);
+        throw;
+      }
+      void* address = (*frame)->address;
+      lib.free(*frame);
+      return address;
+    }
+
+  public:
+    /**
+     * Create a buffer of `size` bytes, which are zero, and map it into the
+     * sandbox of `l`.  Throws `std::runtime_error` if the sandbox could not
+     * map it.
+     */
+    SharedBuffer(Library& l, size_t size)
+    : lib(l),
+      shm(static_cast<uint8_t>(snmalloc::bits::next_pow2_bits(
+        std::max(size, static_cast<size_t>(snmalloc::OS_PAGE_SIZE))))),
+      length(size),
+      generation(l.generation)
+    {
+      uintptr_t id;
+      {
+        std::lock_guard g(lib.shared_buffers_lock);
+        id = lib.next_shared_buffer++;
+        lib.shared_buffer_handles.emplace(id, shm.get_read_only_handle());
+      }
+      try
+      {
+        sandbox_address = call(SharedMemoryRegion::MapSharedBufferFunction, id);
+      }
+      catch (...)
+      {
+        sandbox_address = nullptr;
+      }
+      {
+        // The child may not have fetched the handle.
+        std::lock_guard g(lib.shared_buffers_lock);
+        lib.shared_buffer_handles.erase(id);
+      }
+      if (sandbox_address == nullptr)
+      {
+        throw std::runtime_error("Failed to map shared buffer into sandbox");
+      }
+    }
+
+    SharedBuffer(const SharedBuffer&) = delete;
+    SharedBuffer& operator=(const SharedBuffer&) = delete;
+
+    /**
+     * Unmap the buffer from the sandbox, unless it has exited or been reset.
+     */
+    ~SharedBuffer()
+    {
+      if (lib.has_child_exited() || (lib.generation != generation))
+      {
+        return;
+      }
+      try
+      {
+        call(SharedMemoryRegion::UnmapSharedBufferFunction, 0);
+      }
+      catch (...)
+      {
+        // The child exited while unmapping: there is nothing to unmap.
+      }
+    }
+
+    /**
+     * The buffer, for the host to read and write.
+     */
+    void* data()
+    {
+      return shm.get_base();
+    }
+
+    /**
+     * The size of the buffer.
+     */
+    size_t size()
+    {
+      return length;
+    }
+
+    /**
+     * The address of the buffer in the sandbox, to pass to sandboxed
+     * functions.
+     */
+    template<typename T = void>
+    const T* in_sandbox()
+    {
+      return static_cast<const T*>(sandbox_address);
+    }
+
+    /**
+     * Predicate to test whether an object of size `sz` starting at `ptr`, an
+     * address in the sandbox, is within this buffer.
+     */
+    bool contains(const void* ptr, size_t sz)
+    {
+      auto base = reinterpret_cast<uintptr_t>(sandbox_address);
+      auto p = reinterpret_cast<uintptr_t>(ptr);
+      return (p >= base) && (sz <= length) && ((p - base) <= (length - sz));
+    }
+
+    /**
+     * Translate `ptr`, an address in the sandbox within this buffer, to the
+     * host's address for the same byte.  Returns null if the object of size
+     * `sz` at `ptr` is not within this buffer.
+     */
+    template<typename T>
+    const T* to_host(const T* ptr, size_t sz = sizeof(T))
+    {
+      if (!contains(ptr, sz))
+      {
+        return nullptr;
+      }
+      return static_cast<const T*>(pointer_offset(
+        data(),
+        reinterpret_cast<uintptr_t>(ptr) -
+          reinterpret_cast<uintptr_t>(sandbox_address)));
+    }
+  };
+}
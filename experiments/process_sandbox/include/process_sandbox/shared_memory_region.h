@@ -6,10 +6,34 @@
 #  include <pthread.h>
 #endif
 
+#include "callback_numbers.h"
+
 #include <snmalloc/snmalloc_core.h>
 
 namespace sandbox
 {
+  /**
+   * The argument frame of the functions that map and unmap a `SharedBuffer`
+   * in the child.
+   */
+  struct SharedBufferFrame
+  {
+    /**
+     * The identifier that the child passes back to the parent to fetch the
+     * buffer.
+     */
+    uintptr_t id;
+    /**
+     * The size of the buffer.
+     */
+    size_t size;
+    /**
+     * The address of the buffer in the child.  This is set by mapping it and
+     * read by unmapping it.
+     */
+    void* address;
+  };
+
   /**
    * Class representing a view of a shared memory region.  This provides both
    * the parent and child views of the region.
@@ -32,16 +56,6 @@ namespace sandbox
      * A flag indicating that the parent has instructed the sandbox to exit.
      */
     std::atomic<bool> should_exit = false;
-    /**
-     * The index of the function currently being called.  This interface is not
-     * currently reentrant.
-     */
-    int function_index;
-    /**
-     * A pointer to the tuple (in the shared memory range) that contains the
-     * argument frame provided by the sandbox caller.
-     */
-    void* msg_buffer = nullptr;
     /**
      * The message queue for the parent's allocator.  This is stored in the
      * shared region because the child must be able to free memory allocated by
@@ -50,37 +64,130 @@ namespace sandbox
     snmalloc::RemoteAllocator allocator_state;
 
     /**
-     * A token that is logically passed from the parent to the child and back
-     * again, where each hands control to the other.
+     * The maximum number of chunks that the child asks the parent for in one
+     * `AllocChunks` host service call.
+     */
+    static constexpr size_t MaxChunkBatch = 16;
+
+    /**
+     * The slab metadata for each chunk of the child's current `AllocChunks`
+     * call.  The child makes one host service call at a time.  The parent
+     * only stores these pointers in the pagemap and never dereferences them,
+     * so does not need to validate them.
+     */
+    uintptr_t chunk_batch[MaxChunkBatch];
+
+    /**
+     * The maximum number of threads in the child that can run calls from the
+     * parent.
      */
-    struct
+    static constexpr size_t MaxWorkers = 64;
+
+    /**
+     * Function indexes, below those of the loaded library, of the functions
+     * that the library runner itself provides to the parent.  Both take a
+     * `SharedBufferFrame`.
+     */
+    static constexpr int MapSharedBufferFunction = -1;
+    static constexpr int UnmapSharedBufferFunction = -2;
+
+    /**
+     * The number of worker threads that the child should start, each serving
+     * the call slot with the same index.  This is set by the parent before
+     * the child starts.
+     */
+    size_t workers = 1;
+
+    /**
+     * Monotonic flag indicating that the child has finished loading.  This
+     * is checked during the first call into a sandbox to process any pending
+     * callbacks before the first invocation.  Callbacks made while loading
+     * use the first call slot.
+     */
+    std::atomic<bool> is_child_loaded = false;
+
+    /**
+     * The state of one call from the parent to a worker thread in the child.
+     * The parent gives each concurrent call its own slot, so calls from
+     * different threads in the parent run in parallel in the child.
+     */
+    struct CallSlot
     {
       /**
-       * Semaphore that the child sleeps on when it's not running.
+       * The index of the function currently being called in this slot.
+       */
+      int function_index;
+      /**
+       * A pointer to the tuple (in the shared memory range) that contains the
+       * argument frame provided by the sandbox caller.
+       */
+      void* msg_buffer = nullptr;
+      /**
+       * Semaphore that the worker sleeps on when it's not running.  With
+       * `parent`, this passes control of the slot from the parent to the
+       * worker and back again.
        */
       platform::OneBitSem child{0};
       /**
-       * Semaphore that the parent sleeps on when the child is running.
+       * Semaphore that the parent sleeps on when the worker is running.
        */
       platform::OneBitSem parent{0};
       /**
-       * Flag indicating whether the child is executing.  Used only for
+       * Flag indicating whether the worker is executing.  Used only for
        * debugging.
        */
       std::atomic<bool> is_child_executing = false;
       /**
-       * Monotonic flag indicating that the child has finished loading.  This
-       * is checked during the first call into a sandbox to process any pending
-       * callbacks before the first invocation.
+       * The current depth of callbacks from the worker.  Callbacks from
+       * different workers are serialised by the child, so the parent has at
+       * most one to handle at a time.
        */
-      std::atomic<bool> is_child_loaded = false;
+      std::atomic<int> callback_depth = 0;
       /**
-       * The current depth of callbacks.
+       * A callback from the worker.  A callback that sends no file descriptor
+       * is passed here, instead of as a `CallbackRequest` over the callback
+       * socket, and so is its response, unless the response has a file
+       * descriptor.  This saves a socket round trip for most callbacks.
        *
-       * FIXME: Rentrancy with multiple threads in the child is not working.
+       * These fields are written by the side that hands control of the slot
+       * to the other, and so need no further synchronisation.  They are
+       * untrusted in the parent.
        */
-      std::atomic<int> callback_depth = 0;
-    } token;
+      struct
+      {
+        /**
+         * Whether the request is in this structure, rather than on the
+         * socket.
+         */
+        bool in_memory = false;
+        /**
+         * The kind of callback.
+         */
+        CallbackKind kind;
+        /**
+         * The size of the payload.
+         */
+        size_t size;
+        /**
+         * The payload, a pointer into the sandbox's heap.
+         */
+        uintptr_t data;
+        /**
+         * The result, if the response is in this structure.
+         */
+        uintptr_t response;
+        /**
+         * Whether the response was sent on the socket, with a file
+         * descriptor, rather than written to `response`.
+         */
+        bool response_on_socket = true;
+      } callback;
+    };
+
+    /**
+     * The call slots, of which the first `workers` are used.
+     */
+    CallSlot slots[MaxWorkers];
 
     /**
      * Tear down the parent-owned contents of this shared memory region.
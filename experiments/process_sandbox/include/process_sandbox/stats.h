@@ -0,0 +1,332 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This file contains the counters that a `Library` keeps about calls into its
+ * sandbox, so that the host can see where time in the sandbox goes.  All
+ * counters are updated with relaxed atomics and may be read at any time, so a
+ * snapshot taken while calls are running may be slightly inconsistent.
+ */
+
+#pragma once
+#include "callback_numbers.h"
+#include "shared_memory_region.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace sandbox
+{
+  /**
+   * A histogram of durations, in buckets of powers of two nanoseconds.
+   * Bucket `i` counts durations in `[2^(i-1), 2^i)` nanoseconds, bucket 0
+   * counts durations under a nanosecond.
+   */
+  class LatencyHistogram
+  {
+  public:
+    /**
+     * The number of buckets.  The last one also counts everything longer.
+     */
+    static constexpr size_t Buckets = 48;
+
+  private:
+    /**
+     * The number of durations recorded in each bucket.
+     */
+    std::array<std::atomic<uint64_t>, Buckets> buckets{};
+
+    /**
+     * The sum of all recorded durations, in nanoseconds.
+     */
+    std::atomic<uint64_t> total_ns{0};
+
+  public:
+    /**
+     * Record a duration.
+     */
+    void record(std::chrono::steady_clock::duration d)
+    {
+      auto ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+      size_t bucket = 0;
+      if (ns != 0)
+      {
+        bucket = std::min<size_t>(
+          Buckets - 1, snmalloc::bits::BITS - snmalloc::bits::clz(ns));
+      }
+      buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+      total_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /**
+     * The number of durations recorded in bucket `i`.
+     */
+    uint64_t bucket(size_t i) const
+    {
+      return buckets[i].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The exclusive upper bound of bucket `i`, in nanoseconds.
+     */
+    static uint64_t bucket_limit(size_t i)
+    {
+      return uint64_t(1) << i;
+    }
+
+    /**
+     * The number of durations recorded.
+     */
+    uint64_t count() const
+    {
+      uint64_t n = 0;
+      for (auto& b : buckets)
+      {
+        n += b.load(std::memory_order_relaxed);
+      }
+      return n;
+    }
+
+    /**
+     * The sum of the durations recorded.
+     */
+    std::chrono::nanoseconds total() const
+    {
+      return std::chrono::nanoseconds(total_ns.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * An upper bound on the `p`th percentile, for `p` in `[0, 1]`: the limit
+     * of the bucket that contains it.  Returns 0 if nothing was recorded.
+     */
+    std::chrono::nanoseconds percentile(double p) const
+    {
+      uint64_t n = count();
+      if (n == 0)
+      {
+        return std::chrono::nanoseconds(0);
+      }
+      auto rank = static_cast<uint64_t>(p * static_cast<double>(n - 1));
+      uint64_t seen = 0;
+      for (size_t i = 0; i < Buckets; i++)
+      {
+        seen += bucket(i);
+        if (seen > rank)
+        {
+          return std::chrono::nanoseconds(bucket_limit(i));
+        }
+      }
+      return std::chrono::nanoseconds(bucket_limit(Buckets - 1));
+    }
+  };
+
+  /**
+   * Counters for calls to one function exported from a sandbox.
+   */
+  struct CallStats
+  {
+    /**
+     * The number of calls started.
+     */
+    std::atomic<uint64_t> calls{0};
+
+    /**
+     * The number of callbacks handled during calls to this function, not
+     * counting those of calls made from the callbacks.
+     */
+    std::atomic<uint64_t> callbacks{0};
+
+    /**
+     * The time from starting each call that returned to it returning.
+     */
+    LatencyHistogram latency;
+
+    /**
+     * The part of `latency` spent waiting for the child, that is, excluding
+     * the time spent handling callbacks.
+     */
+    LatencyHistogram wait;
+  };
+
+  /**
+   * Counters for a `Library`, returned by `Library::stats`.
+   */
+  class LibraryStats
+  {
+  public:
+    /**
+     * The lowest function index that is counted separately.  Built-in
+     * functions have negative indexes.
+     */
+    static constexpr int MinFunction =
+      SharedMemoryRegion::UnmapSharedBufferFunction;
+
+    /**
+     * The number of function indexes, from `MinFunction`, that are counted
+     * separately.  Calls to any others are added to `other_functions`.
+     */
+    static constexpr size_t MaxFunctions = 64;
+
+    /**
+     * The number of callback kinds that are counted separately.  All user
+     * callbacks are counted in the last one.
+     */
+    static constexpr size_t CallbackKinds = FirstUserFunction + 1;
+
+  private:
+    /**
+     * Counters for each function index, from `MinFunction`.
+     */
+    std::array<CallStats, MaxFunctions> functions;
+
+    /**
+     * Counters for function indexes that do not fit in `functions`.
+     */
+    CallStats other_functions;
+
+    /**
+     * The number of callbacks of each kind.
+     */
+    std::array<std::atomic<uint64_t>, CallbackKinds> callbacks{};
+
+  public:
+    /**
+     * The number of requests from the child that updated the pagemap.
+     */
+    std::atomic<uint64_t> pagemap_updates{0};
+
+    /**
+     * The number of bytes of chunks currently given to the sandbox's heap.
+     */
+    std::atomic<int64_t> heap_bytes{0};
+
+    /**
+     * The counters for function index `idx`.  Indexes that are not counted
+     * separately share a set of counters.
+     */
+    CallStats& function(int idx)
+    {
+      auto i = static_cast<size_t>(idx - MinFunction);
+      return (idx < MinFunction) || (i >= MaxFunctions) ? other_functions :
+                                                          functions[i];
+    }
+
+    /**
+     * Const version of `function`.
+     */
+    const CallStats& function(int idx) const
+    {
+      return const_cast<LibraryStats*>(this)->function(idx);
+    }
+
+    /**
+     * Count a callback of kind `kind`.
+     */
+    void count_callback(size_t kind)
+    {
+      callbacks[std::min(kind, CallbackKinds - 1)].fetch_add(
+        1, std::memory_order_relaxed);
+    }
+
+    /**
+     * The number of callbacks of kind `kind`.  All user callbacks share the
+     * count of `FirstUserFunction`.
+     */
+    uint64_t callback_count(size_t kind) const
+    {
+      return callbacks[std::min(kind, CallbackKinds - 1)].load(
+        std::memory_order_relaxed);
+    }
+
+    /**
+     * Write the counters in the Prometheus text exposition format, with
+     * `labels` (for instance `library="libz.so"`) added to each sample.
+     * Functions that have not been called are omitted.
+     */
+    void write_prometheus(std::ostream& o, const std::string& labels = "") const
+    {
+      std::string sep = labels.empty() ? "" : ",";
+      auto each_function = [&](auto&& fn) {
+        for (size_t i = 0; i < MaxFunctions; i++)
+        {
+          if (functions[i].calls.load(std::memory_order_relaxed) != 0)
+          {
+            fn(std::to_string(static_cast<int>(i) + MinFunction), functions[i]);
+          }
+        }
+        if (other_functions.calls.load(std::memory_order_relaxed) != 0)
+        {
+          fn(std::string("other"), other_functions);
+        }
+      };
+      auto counter = [&](const char* name, const char* help) {
+        o << "# HELP sandbox_" << name << " " << help << "\n";
+        o << "# TYPE sandbox_" << name << " counter\n";
+      };
+      auto histogram = [&](const char* name, const char* help, auto get) {
+        o << "# HELP sandbox_" << name << " " << help << "\n";
+        o << "# TYPE sandbox_" << name << " histogram\n";
+        each_function([&](const std::string& f, const CallStats& s) {
+          const LatencyHistogram& h = get(s);
+          uint64_t seen = 0;
+          for (size_t i = 0; i < LatencyHistogram::Buckets; i++)
+          {
+            seen += h.bucket(i);
+            o << "sandbox_" << name << "_bucket{" << labels << sep
+              << "function=\"" << f << "\",le=\""
+              << LatencyHistogram::bucket_limit(i) << "\"} " << seen << "\n";
+          }
+          o << "sandbox_" << name << "_bucket{" << labels << sep
+            << "function=\"" << f << "\",le=\"+Inf\"} " << seen << "\n";
+          o << "sandbox_" << name << "_sum{" << labels << sep << "function=\""
+            << f << "\"} " << h.total().count() << "\n";
+          o << "sandbox_" << name << "_count{" << labels << sep
+            << "function=\"" << f << "\"} " << seen << "\n";
+        });
+      };
+
+      counter("calls_total", "Calls into the sandbox");
+      each_function([&](const std::string& f, const CallStats& s) {
+        o << "sandbox_calls_total{" << labels << sep << "function=\"" << f
+          << "\"} " << s.calls.load(std::memory_order_relaxed) << "\n";
+      });
+      counter("call_callbacks_total", "Callbacks handled during calls");
+      each_function([&](const std::string& f, const CallStats& s) {
+        o << "sandbox_call_callbacks_total{" << labels << sep << "function=\""
+          << f << "\"} " << s.callbacks.load(std::memory_order_relaxed)
+          << "\n";
+      });
+      histogram(
+        "call_latency_ns",
+        "Latency of calls into the sandbox",
+        [](const CallStats& s) -> const LatencyHistogram& {
+          return s.latency;
+        });
+      histogram(
+        "call_wait_ns",
+        "Time spent waiting for the sandbox during calls",
+        [](const CallStats& s) -> const LatencyHistogram& { return s.wait; });
+      counter("callbacks_total", "Callbacks from the sandbox, by kind");
+      for (size_t k = 0; k < CallbackKinds; k++)
+      {
+        o << "sandbox_callbacks_total{" << labels << sep << "kind=\""
+          << ((k == CallbackKinds - 1) ? std::string("user") :
+                                         std::to_string(k))
+          << "\"} " << callback_count(k) << "\n";
+      }
+      counter("pagemap_updates_total", "Pagemap updates for the sandbox");
+      o << "sandbox_pagemap_updates_total{" << labels << "} "
+        << pagemap_updates.load(std::memory_order_relaxed) << "\n";
+      o << "# HELP sandbox_heap_bytes Bytes of chunks in the sandbox heap\n";
+      o << "# TYPE sandbox_heap_bytes gauge\n";
+      o << "sandbox_heap_bytes{" << labels << "} "
+        << heap_bytes.load(std::memory_order_relaxed) << "\n";
+    }
+  };
+}
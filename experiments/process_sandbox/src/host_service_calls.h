@@ -42,6 +42,21 @@ namespace sandbox
      * - The size of the chunk.
      */
     DeallocChunk,
+
+    /**
+     * Allocate several chunks of the same size for slabs that share a message
+     * queue and sizeclass, in one contiguous range.  The arguments are:
+     *
+     * - The size of each chunk.
+     * - The address of the message queue and the sizeclass.
+     * - The number of chunks, a power of two.
+     *
+     * The metadata address for each chunk is read from the `chunk_batch`
+     * array of the shared memory region.  The return value is the address of
+     * the first chunk, or 0 if the parent could not allocate them all, in
+     * which case the child should fall back to `AllocChunk`.
+     */
+    AllocChunks,
   };
 
   /**
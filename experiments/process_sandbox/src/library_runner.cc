@@ -9,6 +9,8 @@
 #include "process_sandbox/sandbox.h"
 #include "process_sandbox/shared_memory_region.h"
 
+#include <algorithm>
+#include <array>
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -130,6 +132,17 @@ namespace
    */
   SharedMemoryRegion* shared = nullptr;
 
+  /**
+   * The call slot served by this thread.  The main thread serves the first
+   * slot, which is also used for callbacks made while loading the library.
+   */
+  thread_local SharedMemoryRegion::CallSlot* slot = nullptr;
+
+  /**
+   * The spinning state of this thread's waits for calls in `slot`.
+   */
+  thread_local sandbox::platform::AdaptiveSpin spin;
+
   /**
    * Synchronous RPC call to the parent environment.  This sends a message to
    * the parent and waits for a response.  These calls should never return an
@@ -214,6 +227,62 @@ namespace
    */
   snmalloc::Pipe<SharedMemoryRange, snmalloc::SmallBuddyRange> allocator_range;
 
+  /**
+   * The total size of the chunks that the child asks the parent for at once
+   * when it needs a chunk for a slab.  Chunks larger than half of this are
+   * requested one at a time.
+   */
+  constexpr size_t ChunkBatchBytes = 256 * 1024;
+
+  /**
+   * Chunks that the parent has allocated and bound in the pagemap ahead of
+   * their use, for slabs of one size with one message queue and sizeclass.
+   * Growing the heap by a slab takes a round trip to the parent, so the child
+   * asks for several chunks at a time and hands them out from here.
+   */
+  struct ChunkBatch
+  {
+    /**
+     * The size of each chunk, or 0 if this has never been filled.
+     */
+    size_t size;
+
+    /**
+     * The message queue and sizeclass that the chunks are bound to.
+     */
+    uintptr_t ras;
+
+    /**
+     * The address of the first chunk.
+     */
+    uintptr_t base;
+
+    /**
+     * The number of chunks not yet handed out.  These are the last ones.
+     */
+    size_t remaining;
+
+    /**
+     * The slab metadata that each chunk is bound to.
+     */
+    SnmallocGlobals::Backend::SlabMetadata*
+      metas[SharedMemoryRegion::MaxChunkBatch];
+  };
+
+  /**
+   * Batches of chunks, indexed by a hash of their message queue and
+   * sizeclass.  A slab whose entry holds chunks for another key is allocated
+   * on its own.  This has no constructor, so that it is zeroed before
+   * bootstrapping allocates anything.
+   */
+  std::array<ChunkBatch, 64> chunk_batches;
+
+  /**
+   * Lock protecting `chunk_batches` and the `chunk_batch` array of the shared
+   * memory region.
+   */
+  snmalloc::FlagWord chunk_batches_lock;
+
 }
 
 void SnmallocGlobals::ensure_init() noexcept
@@ -236,9 +305,56 @@ namespace sandbox
     SnmallocGlobals::Backend::alloc_chunk(
       SnmallocGlobals::LocalState&, size_t size, uintptr_t ras)
   {
-    auto* ms = new (
-      metadata_range.alloc_range(sizeof(SnmallocGlobals::Backend::SlabMetadata))
-        .unsafe_ptr()) SnmallocGlobals::Backend::SlabMetadata();
+    using SlabMetadata = SnmallocGlobals::Backend::SlabMetadata;
+    auto new_meta = []() {
+      return new (
+        metadata_range.alloc_range(sizeof(SlabMetadata)).unsafe_ptr())
+        SlabMetadata();
+    };
+    size_t count = std::min(
+      ChunkBatchBytes / size, SharedMemoryRegion::MaxChunkBatch);
+    if (count > 1)
+    {
+      FlagLock g(chunk_batches_lock);
+      auto& batch = chunk_batches
+        [((ras * 0x9E3779B97F4A7C15) >> 58) % chunk_batches.size()];
+      if ((batch.remaining == 0) && (ras != 0))
+      {
+        for (size_t i = 0; i < count; i++)
+        {
+          batch.metas[i] = new_meta();
+          shared->chunk_batch[i] = reinterpret_cast<uintptr_t>(batch.metas[i]);
+        }
+        batch.size = size;
+        batch.ras = ras;
+        batch.base = requestHostService(AllocChunks, size, ras, count);
+        if (batch.base != 0)
+        {
+          batch.remaining = count;
+        }
+        else
+        {
+          for (size_t i = 0; i < count; i++)
+          {
+            metadata_range.dealloc_range(
+              snmalloc::capptr::Arena<void>::unsafe_from(batch.metas[i]),
+              sizeof(SlabMetadata));
+          }
+        }
+      }
+      if (
+        (batch.remaining > 0) && (batch.size == size) && (batch.ras == ras))
+      {
+        batch.remaining--;
+        auto arena = snmalloc::capptr::Arena<void>::unsafe_from(
+          reinterpret_cast<void*>(batch.base + (batch.remaining * size)));
+        return {
+          snmalloc::Aal::capptr_bound<void, snmalloc::capptr::bounds::Chunk>(
+            arena, size),
+          batch.metas[batch.remaining]};
+      }
+    }
+    auto* ms = new_meta();
     auto arena = snmalloc::capptr::Arena<void>::unsafe_from(
       reinterpret_cast<void*>(requestHostService(
         AllocChunk,
@@ -296,6 +412,12 @@ namespace
    */
   void (*sandbox_invoke)(int, void*);
 
+  /**
+   * Run one of the functions that the library runner, rather than the loaded
+   * library, provides to the parent.  These have negative indexes.
+   */
+  void builtin_invoke(int idx, void* buf);
+
   /**
    * The run loop.  Takes the public interface of this library (effectively,
    * the library's vtable) as an argument.  Exits when the callback depth
@@ -303,6 +425,8 @@ namespace
    * runloop abstraction similar to OpenStep's modal runloop. Each recursion
    * depth in a callback has its own runloop that handles recursive invocations
    * from the parent in response to the callback.
+   *
+   * Each worker thread runs this for its own call slot, `slot`.
    */
   __attribute__((used)) void runloop(int callback_depth = 0)
   {
@@ -317,16 +441,18 @@ namespace
         {
           exit(0);
         }
-      } while (!shared->token.child.wait(INT_MAX));
+      } while (!spin.wait(slot->child, INT_MAX));
       SANDBOX_DEBUG_INVARIANT(
-        shared->token.is_child_executing,
+        slot->is_child_executing,
         "Child is executing when the parent thinks is is not");
-      int idx = shared->function_index;
-      void* buf = shared->msg_buffer;
-      shared->msg_buffer = nullptr;
+      int idx = slot->function_index;
+      void* buf = slot->msg_buffer;
+      slot->msg_buffer = nullptr;
       try
       {
-        if ((buf != nullptr) && (sandbox_invoke != nullptr))
+        if ((buf != nullptr) && (idx < 0))
+          builtin_invoke(idx, buf);
+        else if ((buf != nullptr) && (sandbox_invoke != nullptr))
           sandbox_invoke(idx, buf);
       }
       catch (...)
@@ -334,19 +460,44 @@ namespace
         // FIXME: Report error in some useful way.
         SANDBOX_INVARIANT(0, "Uncaught exception");
       }
-      new_depth = shared->token.callback_depth;
+      new_depth = slot->callback_depth;
       // Wake up the parent if it's expecting a wakeup for this callback depth.
       // The `callback` function has a wake but not a wait because it is using
       // the `wait` in this function, we need to ensure that we don't unbalance
       // the wakes and waits.
       if (new_depth == callback_depth)
       {
-        shared->token.is_child_executing = false;
-        shared->token.parent.wake();
+        slot->is_child_executing = false;
+        slot->parent.wake();
       }
     } while (new_depth == callback_depth);
   }
 
+  /**
+   * Start a detached thread that serves calls in `worker_slot`.  As with the
+   * first worker, its stack is in the shared region.
+   */
+  void
+  start_worker(SharedMemoryRegion::CallSlot* worker_slot, size_t stack_size)
+  {
+    pthread_t worker;
+    pthread_attr_t attrs;
+    pthread_attr_init(&attrs);
+    pthread_attr_setstack(&attrs, malloc(stack_size), stack_size);
+    pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(
+      &worker,
+      &attrs,
+      [](void* s) -> void* {
+        slot = static_cast<SharedMemoryRegion::CallSlot*>(s);
+        runloop();
+        return nullptr;
+      },
+      worker_slot);
+    SANDBOX_INVARIANT(ret == 0, "Failed to start worker thread: {}", ret);
+    pthread_attr_destroy(&attrs);
+  }
+
   SNMALLOC_SLOW_PATH
   void bootstrap()
   {
@@ -431,6 +582,15 @@ namespace
    */
   Socket callbackSocket;
 
+  /**
+   * Lock held by a worker for the whole of a callback, from sending the
+   * request to receiving the response, so that requests and responses from
+   * different workers do not interleave on `callbackSocket`.  It is recursive
+   * because the parent may call back into the same worker while handling the
+   * callback, and that call may make a callback of its own.
+   */
+  std::recursive_mutex callback_lock;
+
   /**
    * Invoke a callback.  This takes the kind of callback, the data to be sent,
    * and the file descriptor to send as arguments.  The file descriptor may be
@@ -445,22 +605,40 @@ namespace
   std::pair<uintptr_t, Handle>
   callback(sandbox::CallbackKind k, const void* buffer, size_t size, int fd)
   {
-    Handle out_fd(fd);
-    CallbackRequest req{k, size, reinterpret_cast<uintptr_t>(buffer)};
-    if (!callbackSocket.blocking_send(req, out_fd))
+    std::lock_guard g(callback_lock);
+    auto& request = slot->callback;
+    // Only a file descriptor needs the socket.  Other requests are passed in
+    // the call slot.
+    request.in_memory = fd < 0;
+    if (request.in_memory)
     {
-      snmalloc::report_fatal_error(
-        "Sandbox failed to write callback request (Callback {}, {} bytes to "
-        "file descriptor {})",
-        static_cast<size_t>(k),
-        size,
-        fd);
+      request.kind = k;
+      request.size = size;
+      request.data = reinterpret_cast<uintptr_t>(buffer);
+    }
+    else
+    {
+      Handle out_fd(fd);
+      CallbackRequest req{k, size, reinterpret_cast<uintptr_t>(buffer)};
+      if (!callbackSocket.blocking_send(req, out_fd))
+      {
+        snmalloc::report_fatal_error(
+          "Sandbox failed to write callback request (Callback {}, {} bytes to "
+          "file descriptor {})",
+          static_cast<size_t>(k),
+          size,
+          fd);
+      }
+      out_fd.take();
     }
-    out_fd.take();
-    int depth = ++shared->token.callback_depth;
-    shared->token.is_child_executing = false;
-    shared->token.parent.wake();
+    int depth = ++slot->callback_depth;
+    slot->is_child_executing = false;
+    slot->parent.wake();
     runloop(depth);
+    if (!request.response_on_socket)
+    {
+      return {request.response, Handle()};
+    }
     Handle in_fd;
     CallbackResponse response;
     if (!callbackSocket.blocking_receive(response, in_fd))
@@ -692,6 +870,33 @@ namespace
     return result;
   }
 
+  void builtin_invoke(int idx, void* buf)
+  {
+    auto* frame = static_cast<SharedBufferFrame*>(buf);
+    if (idx == SharedMemoryRegion::MapSharedBufferFunction)
+    {
+      // The parent gives us a handle that can only be mapped read-only.
+      auto ret =
+        callback_helper<sandbox::SyscallArgs<MapSharedBuffer>, uintptr_t>(
+          frame->id);
+      void* address = nullptr;
+      if (ret.second.is_valid())
+      {
+        address = mmap(
+          nullptr, frame->size, PROT_READ, MAP_SHARED, ret.second.fd, 0);
+        if (address == MAP_FAILED)
+        {
+          address = nullptr;
+        }
+      }
+      frame->address = address;
+    }
+    else if (idx == SharedMemoryRegion::UnmapSharedBufferFunction)
+    {
+      munmap(frame->address, frame->size);
+    }
+  }
+
   /**
    * Emulate the `access` system call by performing a callback to the parent.
    */
@@ -1040,11 +1245,12 @@ static void runloop_with_stack_pivot(void* stack, size_t stack_size)
   pthread_create(
     &runner,
     &attrs,
-    [](void*) -> void* {
+    [](void* s) -> void* {
+      slot = static_cast<SharedMemoryRegion::CallSlot*>(s);
       runloop();
       return nullptr;
     },
-    nullptr);
+    slot);
   // Block until the thread has exited.
   void* unused;
   pthread_join(runner, &unused);
@@ -1053,7 +1259,23 @@ static void runloop_with_stack_pivot(void* stack, size_t stack_size)
 
 int main()
 {
-  sandbox::platform::Sandbox::apply_sandboxing_policy_postexec();
+  callbackSocket.reset(FDSocket);
+#ifdef SANDBOX_HAS_SYSCALL_NOTIFY
+  // If the parent services system calls directly, it needs the listener
+  // before we make any of them, which it expects first on the socket.
+  if (getenv("SANDBOX_SYSCALL_NOTIFY") != nullptr)
+  {
+    Handle listener{
+      sandbox::platform::Sandbox::apply_sandboxing_policy_postexec_notify()};
+    SANDBOX_INVARIANT(
+      callbackSocket.blocking_send(0, listener),
+      "Failed to send the system call listener to the parent");
+  }
+  else
+#endif
+  {
+    sandbox::platform::Sandbox::apply_sandboxing_policy_postexec();
+  }
   struct sigaction sa;
   memset(&sa, 0, sizeof(sa));
   // If we do a disallowed system call while handling another, deliver the
@@ -1067,7 +1289,7 @@ int main()
   // code.
   close(SharedMemRegion);
   close(PageMapPage);
-  callbackSocket.reset(FDSocket);
+  slot = &shared->slots[0];
 
 #ifndef NDEBUG
   // Check that our bootstrapping actually did the right thing and that
@@ -1111,13 +1333,28 @@ int main()
     reinterpret_cast<decltype(sandbox_invoke)>(dlfunc(handle, "sandbox_call"));
   SANDBOX_INVARIANT(
     sandbox_invoke, "Sandbox invoke invoke function not found {}", dlerror());
-
-  shared->token.is_child_executing = false;
-  shared->token.is_child_loaded = true;
+  // Everything is loaded and relocated, so let other sandboxes share the
+  // read-only parts.
+  sandbox::platform::share_relro_pages();
 
   static constexpr size_t stack_size = 8 * 1024 * 1024;
+  // The parent may ask for any number of workers, but there are only
+  // `MaxWorkers` slots.
+  size_t workers = shared->workers;
+  if (workers > SharedMemoryRegion::MaxWorkers)
+  {
+    workers = SharedMemoryRegion::MaxWorkers;
+  }
+  for (size_t i = 1; i < workers; i++)
+  {
+    start_worker(&shared->slots[i], stack_size);
+  }
+
+  slot->is_child_executing = false;
+  shared->is_child_loaded = true;
+
   void* stack = malloc(stack_size);
-  // Enter the run loop, waiting for calls from trusted code.
+  // Enter the run loop of the first slot, waiting for calls from trusted code.
   // We do this in a new thread so that our stack can be in the shared region.
   // This avoids the need to copy arguments from the stack to the heap.
   runloop_with_stack_pivot(stack, stack_size);
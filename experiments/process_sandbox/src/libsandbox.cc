@@ -1,10 +1,13 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <functional>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 #include <tuple>
@@ -24,6 +27,12 @@
 #  include <unistd.h>
 #  ifdef __linux__
 #    include <bsd/unistd.h>
+// Before libseccomp, so that it uses the kernel's definitions.
+#    include <linux/seccomp.h>
+#    include <poll.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
 #  endif
 #endif
 #include "host_service_calls.h"
@@ -198,10 +207,65 @@ namespace sandbox
             metaentry.claim_for_sandbox();
             SharedAllocConfig::Pagemap::set_metaentry(
               address_cast(alloc), size, metaentry);
+            lib->statistics.pagemap_updates.fetch_add(
+              1, std::memory_order_relaxed);
+            lib->statistics.heap_bytes.fetch_add(
+              static_cast<int64_t>(size), std::memory_order_relaxed);
 
             reply.ret = alloc.unsafe_uintptr();
             break;
           }
+          case AllocChunks:
+          {
+            auto size = static_cast<size_t>(rpc.args[0]);
+            auto ras = rpc.args[1];
+            auto count = static_cast<size_t>(rpc.args[2]);
+            if (
+              (size < snmalloc::MIN_CHUNK_SIZE) ||
+              !snmalloc::bits::is_pow2(size) || (count < 2) ||
+              (count > SharedMemoryRegion::MaxChunkBatch) ||
+              !snmalloc::bits::is_pow2(count))
+            {
+              reply.error = 3;
+              break;
+            }
+            SharedAllocConfig::Pagemap::Entry metaentry{nullptr, ras};
+            if (!is_metaentry_valid(size, metaentry))
+            {
+              reply.error = 1;
+              break;
+            }
+            snmalloc::capptr::Arena<void> alloc;
+            {
+              auto [g, m] = s->get_memory();
+              alloc = m.alloc_range(size * count);
+            }
+            // Running low on memory is not an error here, the child will ask
+            // for the chunk it needs on its own.
+            if (alloc == nullptr)
+            {
+              break;
+            }
+            // Read each metadata pointer once.  The child can change the
+            // array concurrently, but that only affects its own chunks.
+            auto& metas = lib->shared_mem->chunk_batch;
+            for (size_t i = 0; i < count; i++)
+            {
+              SharedAllocConfig::Pagemap::Entry chunk_entry{
+                reinterpret_cast<SharedAllocConfig::Backend::SlabMetadata*>(
+                  metas[i]),
+                ras};
+              chunk_entry.claim_for_sandbox();
+              SharedAllocConfig::Pagemap::set_metaentry(
+                address_cast(alloc) + (i * size), size, chunk_entry);
+            }
+            lib->statistics.pagemap_updates.fetch_add(
+              1, std::memory_order_relaxed);
+            lib->statistics.heap_bytes.fetch_add(
+              static_cast<int64_t>(size * count), std::memory_order_relaxed);
+            reply.ret = alloc.unsafe_uintptr();
+            break;
+          }
           case DeallocChunk:
           {
             auto ptr = snmalloc::capptr::Arena<void>::unsafe_from(
@@ -242,6 +306,10 @@ namespace sandbox
             if (reply.error == 0)
             {
               SharedAllocConfig::Backend::dealloc_range(*s, ptr, size);
+              lib->statistics.pagemap_updates.fetch_add(
+                1, std::memory_order_relaxed);
+              lib->statistics.heap_bytes.fetch_sub(
+                static_cast<int64_t>(size), std::memory_order_relaxed);
             }
             break;
           }
@@ -293,6 +361,164 @@ namespace sandbox
     return *p;
   }
 
+  /**
+   * The deadline of a call into a sandbox.  This is registered with the
+   * `Watchdog` for as long as it exists, which should be the duration of the
+   * call.
+   */
+  struct CallDeadline
+  {
+    /**
+     * The library that the call is made to.
+     */
+    Library& lib;
+
+    /**
+     * The call slot that the caller is waiting on.
+     */
+    SharedMemoryRegion::CallSlot& slot;
+
+    /**
+     * The time by which the call must finish.
+     */
+    std::chrono::steady_clock::time_point when;
+
+    /**
+     * Set by the watchdog if it terminated the child because the call did
+     * not finish in time.
+     */
+    std::atomic<bool> expired = false;
+
+    CallDeadline(
+      Library& l,
+      SharedMemoryRegion::CallSlot& s,
+      std::chrono::milliseconds timeout);
+
+    ~CallDeadline();
+  };
+
+  /**
+   * Singleton class that enforces the deadlines of calls.  A single
+   * background thread sleeps until the earliest deadline, so calls pay for
+   * a deadline only when they register and remove one, and calls without a
+   * deadline pay nothing.
+   */
+  class Watchdog
+  {
+    /**
+     * Lock protecting `deadlines`.
+     */
+    std::mutex lock;
+
+    /**
+     * Signalled when a deadline earlier than all others is added.
+     */
+    std::condition_variable changed;
+
+    /**
+     * The deadlines of the calls in progress, earliest first.
+     */
+    std::multimap<std::chrono::steady_clock::time_point, CallDeadline*>
+      deadlines;
+
+    /**
+     * Run loop.  Terminate the child of each call whose deadline has passed
+     * and wake the caller, which then sees that the deadline expired.
+     */
+    void run()
+    {
+      std::unique_lock g(lock);
+      while (true)
+      {
+        auto now = std::chrono::steady_clock::now();
+        while (!deadlines.empty() && (deadlines.begin()->first <= now))
+        {
+          CallDeadline* d = deadlines.begin()->second;
+          deadlines.erase(deadlines.begin());
+          d->expired = true;
+          d->lib.terminate();
+          d->slot.parent.wake();
+        }
+        if (deadlines.empty())
+        {
+          changed.wait(g);
+        }
+        else
+        {
+          changed.wait_until(g, deadlines.begin()->first);
+        }
+      }
+    }
+
+  public:
+    /**
+     * Constructor.  Spawns a background thread to enforce deadlines.
+     */
+    Watchdog()
+    {
+      std::thread t([&]() { run(); });
+      t.detach();
+    }
+
+    /**
+     * Start enforcing `d`.
+     */
+    void add(CallDeadline& d)
+    {
+      bool earliest;
+      {
+        std::lock_guard g(lock);
+        earliest = deadlines.empty() || (d.when < deadlines.begin()->first);
+        deadlines.emplace(d.when, &d);
+      }
+      if (earliest)
+      {
+        changed.notify_one();
+      }
+    }
+
+    /**
+     * Stop enforcing `d`, if it has not already expired.
+     */
+    void remove(CallDeadline& d)
+    {
+      std::lock_guard g(lock);
+      auto [begin, end] = deadlines.equal_range(d.when);
+      for (auto i = begin; i != end; ++i)
+      {
+        if (i->second == &d)
+        {
+          deadlines.erase(i);
+          return;
+        }
+      }
+    }
+  };
+
+  /**
+   * Return a singleton instance of the watchdog.
+   */
+  Watchdog& watchdog()
+  {
+    // Leaks.  No need to run the destructor!
+    static Watchdog* w = new Watchdog();
+    return *w;
+  }
+
+  CallDeadline::CallDeadline(
+    Library& l,
+    SharedMemoryRegion::CallSlot& s,
+    std::chrono::milliseconds timeout)
+  : lib(l), slot(s), when(std::chrono::steady_clock::now() + timeout)
+  {
+    watchdog().add(*this);
+  }
+
+  CallDeadline::~CallDeadline()
+  {
+    watchdog().remove(*this);
+  }
+
   /**
    * Class that handles callbacks.  Each `Library` holds a single one
    * of these, its implementation is hidden from the public interface.
@@ -320,6 +546,11 @@ namespace sandbox
      */
     friend class Library;
 
+    /**
+     * SyscallNotifier services system calls with the `*_path` methods.
+     */
+    friend class SyscallNotifier;
+
     /**
      * The handle to the socket that is used to pass file descriptors to the
      * sandboxed process.
@@ -381,16 +612,15 @@ namespace sandbox
       return nullptr;
     }
 
+    /**
+     * Look up `raw_path`, which has been copied out of the sandbox, in the
+     * exported file tree, and call `handler` with the directory that
+     * contains it and the rest of the path.
+     */
     template<typename T>
-    Result
-    handle_path_syscall(Library& lib, uintptr_t inSandboxPath, T&& handler)
+    Result handle_path(const char* raw_path, T&& handler)
     {
-      auto raw_path = get_path(lib, inSandboxPath);
-      if (!raw_path)
-      {
-        return {-EINVAL};
-      }
-      Path path{raw_path.get()};
+      Path path{raw_path};
       if (!path.canonicalise())
       {
         return {-EINVAL};
@@ -410,24 +640,34 @@ namespace sandbox
      */
     Result handle_open(Library& lib, SyscallArgs<Open>::rpc_type& args)
     {
-      return handle_path_syscall(
-        lib, std::get<0>(args), [&](auto fd, auto& path_tail) {
-          if (!path_tail.is_empty())
-          {
-            fd = platform::SafeSyscalls::openat_beneath(
-              fd,
-              path_tail.str().c_str(),
-              std::get<1>(args),
-              std::get<2>(args));
-          }
-          else
-          {
-            // FIXME: Ugly hack to work around the lack of a non-owning version
-            // of `Handle`
-            fd = ::dup(fd);
-          }
-          return return_fd(fd);
-        });
+      auto raw_path = get_path(lib, std::get<0>(args));
+      if (!raw_path)
+      {
+        return {-EINVAL};
+      }
+      return open_path(raw_path.get(), std::get<1>(args), std::get<2>(args));
+    }
+
+    /**
+     * Open `raw_path`, which has been copied out of the sandbox, from the
+     * exported file tree.
+     */
+    Result open_path(const char* raw_path, int flags, mode_t mode)
+    {
+      return handle_path(raw_path, [&](auto fd, auto& path_tail) {
+        if (!path_tail.is_empty())
+        {
+          fd = platform::SafeSyscalls::openat_beneath(
+            fd, path_tail.str().c_str(), flags, mode);
+        }
+        else
+        {
+          // FIXME: Ugly hack to work around the lack of a non-owning version
+          // of `Handle`
+          fd = ::dup(fd);
+        }
+        return return_fd(fd);
+      });
     }
 
     /**
@@ -520,30 +760,32 @@ namespace sandbox
       }
       auto host = get_path(lib, std::get<0>(args));
       auto service = get_path(lib, std::get<1>(args));
-      addrinfo* res;
-      int ret = netpolicy.invoke<NetworkPolicy::NetOperation::GetAddrInfo>(
-        host.get(), service.get(), hints, &res);
-      // On success, we need to copy the result out and free it.
-      if (ret == 0)
-      {
-        size_t count = 0;
-        size_t extra = 0;
-        // Find the number of `addrinfo` structures in the list and the size of
-        // their associated `sockaddr`s
-        for (addrinfo* cur = res; cur != nullptr; cur = cur->ai_next)
-        {
-          count++;
-          extra += cur->ai_addrlen;
-        }
-        if (count > 0)
-        {
-          // Allocate space for everything.  No overflow checking here, but the
-          // called code is trusted and we could only overflow if it returned a
-          // nonsense `ai_addrlen`.
+      // Copy the result out.  The list is owned by the policy, or by its
+      // cache, and is valid only for the duration of this callback.
+      int copy_error = 0;
+      int ret = netpolicy.lookup_addrinfo(
+        host.get(), service.get(), hints, [&](const addrinfo* res) {
+          size_t count = 0;
+          size_t extra = 0;
+          // Find the number of `addrinfo` structures in the list and the size
+          // of their associated `sockaddr`s
+          for (const addrinfo* cur = res; cur != nullptr; cur = cur->ai_next)
+          {
+            count++;
+            extra += cur->ai_addrlen;
+          }
+          if (count == 0)
+          {
+            return;
+          }
+          // Allocate space for everything.  No overflow checking here, but
+          // the called code is trusted and we could only overflow if it
+          // returned a nonsense `ai_addrlen`.
           auto b = lib.alloc<char>((sizeof(addrinfo) * count) + extra);
           if (!b)
           {
-            return return_int(EAI_MEMORY);
+            copy_error = EAI_MEMORY;
+            return;
           }
           auto buffer = b.value();
           // The allocated space will be an array of `addrinfo`s, followed by
@@ -552,20 +794,26 @@ namespace sandbox
           char* sockaddrs = buffer + (sizeof(addrinfo) * count);
           size_t i = 0;
           // Copy each list element into the new buffer, updating its next
-          // pointer and copying the payload into the end of the buffer.
-          for (addrinfo* cur = res; cur != nullptr; cur = cur->ai_next, i++)
+          // pointer and copying the payload into the end of the buffer.  The
+          // canonical name is not copied and must not leak a pointer into
+          // the parent.
+          for (const addrinfo* cur = res; cur != nullptr;
+               cur = cur->ai_next, i++)
           {
             ais[i] = *cur;
             memcpy(sockaddrs, cur->ai_addr, cur->ai_addrlen);
             ais[i].ai_addr = reinterpret_cast<sockaddr*>(sockaddrs);
+            ais[i].ai_canonname = nullptr;
             sockaddrs += cur->ai_addrlen;
             ais[i].ai_next = &ais[i + 1];
           }
           // Add the null terminator in the list.
           ais[count - 1].ai_next = nullptr;
           *unsafeSandboxRes = ais;
-          netpolicy.freeaddrinfo(res);
-        }
+        });
+      if ((ret == 0) && (copy_error != 0))
+      {
+        ret = copy_error;
       }
       return return_int(ret);
     }
@@ -576,13 +824,24 @@ namespace sandbox
      */
     Result handle_access(Library& lib, SyscallArgs<Access>::rpc_type& args)
     {
-      return handle_path_syscall(
-        lib, std::get<0>(args), [&](auto fd, auto& path_tail) {
-          return return_int(platform::SafeSyscalls::faccessat_beneath(
-            fd,
-            path_tail.is_empty() ? nullptr : path_tail.str().c_str(),
-            std::get<1>(args)));
-        });
+      auto raw_path = get_path(lib, std::get<0>(args));
+      if (!raw_path)
+      {
+        return {-EINVAL};
+      }
+      return access_path(raw_path.get(), std::get<1>(args));
+    }
+
+    /**
+     * Check access to `raw_path`, which has been copied out of the sandbox,
+     * in the exported file tree.
+     */
+    Result access_path(const char* raw_path, int mode)
+    {
+      return handle_path(raw_path, [&](auto fd, auto& path_tail) {
+        return return_int(platform::SafeSyscalls::faccessat_beneath(
+          fd, path_tail.is_empty() ? nullptr : path_tail.str().c_str(), mode));
+      });
     }
 
     /**
@@ -592,18 +851,47 @@ namespace sandbox
      */
     Result handle_stat(Library& lib, SyscallArgs<Stat>::rpc_type& args)
     {
-      return handle_path_syscall(
-        lib, std::get<0>(args), [&](auto fd, auto& path_tail) {
-          struct stat* sb = check_pointer<struct stat>(lib, std::get<1>(args));
-          if (sb != nullptr)
-          {
-            return return_int(
-              path_tail.is_empty() ? fstat(fd, sb) :
-                                     platform::SafeSyscalls::fstatat_beneath(
-                                       fd, path_tail.str().c_str(), sb, 0));
-          }
-          return Result{-EINVAL};
-        });
+      auto raw_path = get_path(lib, std::get<0>(args));
+      struct stat* sb = check_pointer<struct stat>(lib, std::get<1>(args));
+      if (!raw_path || (sb == nullptr))
+      {
+        return {-EINVAL};
+      }
+      return stat_path(raw_path.get(), sb);
+    }
+
+    /**
+     * Stat `raw_path`, which has been copied out of the sandbox, in the
+     * exported file tree, into `sb`.
+     */
+    Result stat_path(const char* raw_path, struct stat* sb)
+    {
+      return handle_path(raw_path, [&](auto fd, auto& path_tail) {
+        return return_int(
+          path_tail.is_empty() ?
+            fstat(fd, sb) :
+            platform::SafeSyscalls::fstatat_beneath(
+              fd, path_tail.str().c_str(), sb, 0));
+      });
+    }
+
+    /**
+     * Handle the child fetching a `SharedBuffer` to map it.  Each handle is
+     * given out once.
+     */
+    Result handle_map_shared_buffer(
+      Library& lib, SyscallArgs<MapSharedBuffer>::rpc_type& args)
+    {
+      std::lock_guard g(lib.shared_buffers_lock);
+      auto it = lib.shared_buffer_handles.find(std::get<0>(args));
+      if (it == lib.shared_buffer_handles.end())
+      {
+        return -EINVAL;
+      }
+      Result r{std::move(it->second)};
+      r.integer = 0;
+      lib.shared_buffer_handles.erase(it);
+      return r;
     }
 
     /**
@@ -656,24 +944,38 @@ namespace sandbox
     }
 
     /**
-     * Handle a request.
+     * Handle a request from the worker serving `slot`.
      */
-    void handle(Library& lib)
+    void handle(Library& lib, SharedMemoryRegion::CallSlot& slot)
     {
       CallbackRequest req;
       platform::Handle in_fd;
+      auto& request = slot.callback;
+      // Read the flag once: the child can change it at any time.
+      bool in_memory = request.in_memory;
+      if (in_memory)
+      {
+        req = {request.kind, request.size, request.data};
+      }
       // This should not block, but it can if the sandbox doesn't write
       // anything into the socket.
-      if (!socket.nonblocking_receive(req, in_fd))
+      else if (!socket.nonblocking_receive(req, in_fd))
       {
         return;
       }
 
+      lib.statistics.count_callback(req.kind);
       CallbackHandlerBase::Result ret;
       if (req.kind < handlers.size())
       {
         ret = handlers[req.kind]->invoke(lib, req, std::move(in_fd));
       }
+      request.response_on_socket = !in_memory || ret.handle.is_valid();
+      if (!request.response_on_socket)
+      {
+        request.response = ret.integer;
+        return;
+      }
       if (!socket.nonblocking_send(ret.integer, ret.handle))
       {
         lib.terminate();
@@ -735,9 +1037,357 @@ namespace sandbox
         &CallbackDispatcher::handle_bind_or_connect<
           CallbackKind::Connect,
           NetworkPolicy::NetOperation::Connect>);
+      register_handler(
+        CallbackKind::MapSharedBuffer,
+        &CallbackDispatcher::handle_map_shared_buffer);
     };
   };
 
+#if defined(SANDBOX_HAS_SYSCALL_NOTIFY) && defined(SECCOMP_IOCTL_NOTIF_ADDFD)
+#  define SANDBOX_USE_SYSCALL_NOTIFIER
+  /**
+   * Services the system calls that a child reports to its seccomp
+   * user-notification listener, see `SyscallInterposition::UserNotification`.
+   * The calling thread in the child is suspended until the reply, and a file
+   * descriptor that the call returns is installed directly in the child, so
+   * the child does no work for the call.
+   *
+   * The arguments are read from the child's memory, which another of its
+   * threads may change at any time, so each is read once, into the parent,
+   * and the notification is checked to still be live before it is acted on.
+   */
+  class SyscallNotifier
+  {
+    /**
+     * The library whose child reports to `listener`.
+     */
+    Library& lib;
+
+    /**
+     * The user-notification listener of the child's seccomp filter.
+     */
+    platform::Handle listener;
+
+    /**
+     * The thread that waits on `listener`.  It exits when the child exits.
+     */
+    std::thread thread;
+
+    using Result = CallbackHandlerBase::Result;
+
+    /**
+     * Copy the null-terminated string at `addr` in the process `pid`.
+     */
+    static std::optional<std::string> read_string(pid_t pid, uintptr_t addr)
+    {
+      static constexpr size_t page = 4096;
+      std::string str;
+      char buf[256];
+      while (str.size() < PATH_MAX)
+      {
+        // Never read across a page boundary, which may be unmapped.
+        size_t len = std::min(sizeof(buf), page - (addr % page));
+        iovec local{buf, len};
+        iovec remote{reinterpret_cast<void*>(addr), len};
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n <= 0)
+        {
+          return std::nullopt;
+        }
+        char* end = std::find(buf, buf + n, '\0');
+        str.append(buf, end);
+        if (end != buf + n)
+        {
+          return str;
+        }
+        addr += static_cast<size_t>(n);
+      }
+      return std::nullopt;
+    }
+
+    /**
+     * If `path` names a descriptor of the process that contains the thread
+     * `tid`, in `/proc/{pid}/fd`, returns the descriptor number.  The
+     * run-time linker opens libraries that the parent passed in this way, and
+     * the signal handler in the child special-cases it in the same way.
+     */
+    static std::optional<int> proc_fd(pid_t tid, const std::string& path)
+    {
+      int pid;
+      int fd;
+      char tail;
+      if (
+        sscanf(path.c_str(), "/proc/%d/fd/%d%c", &pid, &fd, &tail) != 2 ||
+        (fd < 0))
+      {
+        return std::nullopt;
+      }
+      auto status = "/proc/" + std::to_string(tid) + "/status";
+      FILE* f = fopen(status.c_str(), "r");
+      if (f == nullptr)
+      {
+        return std::nullopt;
+      }
+      int tgid = -1;
+      char line[128];
+      while (fgets(line, sizeof(line), f) != nullptr)
+      {
+        if (sscanf(line, "Tgid: %d", &tgid) == 1)
+        {
+          break;
+        }
+      }
+      fclose(f);
+      if (tgid != pid)
+      {
+        return std::nullopt;
+      }
+      return fd;
+    }
+
+    /**
+     * Open the file named by `path` for the thread `tid`, with `dirfd`
+     * being the child's descriptor for the directory that a relative path
+     * is resolved in.
+     */
+    Result open_file(
+      pid_t tid, int dirfd, const std::string& path, int flags, mode_t mode)
+    {
+      auto& dispatcher = *lib.callback_dispatcher;
+      auto proc = "/proc/" + std::to_string(tid) + "/fd/";
+      if (auto fd = proc_fd(tid, path))
+      {
+        // Reopen the child's own descriptor.
+        proc += std::to_string(*fd);
+        return dispatcher.return_fd(::open(
+          proc.c_str(), flags & (O_ACCMODE | O_DIRECTORY | O_CLOEXEC)));
+      }
+      if (path[0] == '/')
+      {
+        return dispatcher.open_path(path.c_str(), flags, mode);
+      }
+      if (dirfd == AT_FDCWD)
+      {
+        return -ENOENT;
+      }
+      // As with the signal handler, the parent trusts the directory that
+      // the child passes, which it can only have been given by the parent.
+      proc += std::to_string(dirfd);
+      platform::Handle dir{
+        ::open(proc.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+      if (!dir.is_valid())
+      {
+        return -EBADF;
+      }
+      return dispatcher.return_fd(platform::SafeSyscalls::openat_beneath(
+        dir.fd, path.c_str(), flags, mode));
+    }
+
+    /**
+     * Service the system call reported by `req`.  Returns the result and
+     * the kind of callback that the call would have been with a signal.
+     */
+    std::pair<Result, CallbackKind> service(seccomp_notif& req)
+    {
+      auto& dispatcher = *lib.callback_dispatcher;
+      auto& args = req.data.args;
+      pid_t pid = static_cast<pid_t>(req.pid);
+      auto path = [&](int arg) { return read_string(pid, args[arg]); };
+      auto live = [&]() {
+        return seccomp_notify_id_valid(listener.fd, req.id) == 0;
+      };
+      switch (req.data.nr)
+      {
+        case __NR_open:
+        {
+          auto p = path(0);
+          if (!live())
+          {
+            break;
+          }
+          return {
+            p ? open_file(
+                  pid,
+                  AT_FDCWD,
+                  *p,
+                  static_cast<int>(args[1]),
+                  static_cast<mode_t>(args[2])) :
+                Result{-EFAULT},
+            Open};
+        }
+        case __NR_openat:
+        {
+          auto p = path(1);
+          if (!live())
+          {
+            break;
+          }
+          return {
+            p ? open_file(
+                  pid,
+                  static_cast<int>(args[0]),
+                  *p,
+                  static_cast<int>(args[2]),
+                  static_cast<mode_t>(args[3])) :
+                Result{-EFAULT},
+            OpenAt};
+        }
+        case __NR_access:
+        {
+          auto p = path(0);
+          if (!live())
+          {
+            break;
+          }
+          return {
+            p ? dispatcher.access_path(
+                  p->c_str(), static_cast<int>(args[1])) :
+                Result{-EFAULT},
+            Access};
+        }
+        case __NR_stat:
+        {
+          auto p = path(0);
+          if (!live())
+          {
+            break;
+          }
+          if (!p)
+          {
+            return {Result{-EFAULT}, Stat};
+          }
+          struct stat sb;
+          Result ret = dispatcher.stat_path(p->c_str(), &sb);
+          if (ret.integer == 0)
+          {
+            iovec local{&sb, sizeof(sb)};
+            iovec remote{reinterpret_cast<void*>(args[1]), sizeof(sb)};
+            if (
+              process_vm_writev(pid, &local, 1, &remote, 1, 0) !=
+              static_cast<ssize_t>(sizeof(sb)))
+            {
+              ret = -EFAULT;
+            }
+          }
+          return {std::move(ret), Stat};
+        }
+      }
+      return {Result{-ENOSYS}, CallbackKind::FirstUserFunction};
+    }
+
+    /**
+     * Reply to `req` with `ret`.  A file descriptor is installed in the
+     * child, and is the result of the call.
+     */
+    void reply(seccomp_notif& req, seccomp_notif_resp& resp, Result& ret)
+    {
+      resp.id = req.id;
+      resp.flags = 0;
+      resp.error = 0;
+      resp.val = 0;
+      if (ret.handle.is_valid())
+      {
+        seccomp_notif_addfd addfd;
+        memset(&addfd, 0, sizeof(addfd));
+        addfd.id = req.id;
+        addfd.srcfd = static_cast<uint32_t>(ret.handle.fd);
+#  ifdef SECCOMP_ADDFD_FLAG_SEND
+        // Install the descriptor and complete the call at once.  Older
+        // kernels need a separate reply.
+        addfd.flags = SECCOMP_ADDFD_FLAG_SEND;
+        if (ioctl(listener.fd, SECCOMP_IOCTL_NOTIF_ADDFD, &addfd) >= 0)
+        {
+          return;
+        }
+        addfd.flags = 0;
+#  endif
+        int fd = ioctl(listener.fd, SECCOMP_IOCTL_NOTIF_ADDFD, &addfd);
+        ret = (fd >= 0) ? fd : -EMFILE;
+      }
+      if (ret.integer < 0)
+      {
+        resp.error = static_cast<int32_t>(ret.integer);
+      }
+      else
+      {
+        resp.val = ret.integer;
+      }
+      // This fails only if the calling thread has gone.
+      (void)seccomp_notify_respond(listener.fd, &resp);
+    }
+
+    /**
+     * Service notifications until the child exits.
+     */
+    void run()
+    {
+      seccomp_notif* req;
+      seccomp_notif_resp* resp;
+      if (seccomp_notify_alloc(&req, &resp) != 0)
+      {
+        lib.terminate();
+        return;
+      }
+      pollfd pfd{listener.fd, POLLIN, 0};
+      while (true)
+      {
+        if (poll(&pfd, 1, -1) < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+          break;
+        }
+        if ((pfd.revents & POLLIN) == 0)
+        {
+          // Every thread of the child has exited.
+          break;
+        }
+        // This fails if the calling thread was killed in the meantime.
+        if (seccomp_notify_receive(listener.fd, req) != 0)
+        {
+          continue;
+        }
+        auto [ret, kind] = service(*req);
+        lib.statistics.count_callback(kind);
+        reply(*req, *resp, ret);
+      }
+      seccomp_notify_free(req, resp);
+    }
+
+  public:
+    SyscallNotifier(Library& l, platform::Handle&& h)
+    : lib(l), listener(std::move(h)), thread([this]() { run(); })
+    {}
+
+    /**
+     * Wait for the thread.  The child must have exited.
+     */
+    ~SyscallNotifier()
+    {
+      thread.join();
+    }
+  };
+#else
+  /**
+   * User notifications are not supported on this platform, so a library
+   * never creates one of these.
+   */
+  class SyscallNotifier
+  {};
+#endif
+
+  bool Library::supports(SyscallInterposition interposition)
+  {
+#ifdef SANDBOX_USE_SYSCALL_NOTIFIER
+    (void)interposition;
+    return true;
+#else
+    return interposition == SyscallInterposition::Signal;
+#endif
+  }
+
   ExportedFileTree& Library::filetree()
   {
     return callback_dispatcher->vfs;
@@ -756,35 +1406,48 @@ namespace sandbox
 
   Library::~Library()
   {
+    {
+      std::lock_guard g(async_lock);
+      async_stopping = true;
+    }
+    async_ready.notify_all();
+    for (auto& t : async_threads)
+    {
+      t.join();
+    }
     wait_for_child_exit();
+    syscall_notifier.reset();
+    clear_pagemap();
+    shared_mem->destroy();
+  }
+
+  void Library::clear_pagemap()
+  {
+    auto [g, pm] = SharedAllocConfig::Pagemap::get_pagemap_writeable();
+    snmalloc::address_t base =
+      snmalloc::address_cast(memory_provider.base_address());
+    auto top = snmalloc::address_cast(memory_provider.top_address());
+    SharedAllocConfig::Pagemap::Entry empty{nullptr, 0};
+    // Scan the pagemap for all memory associated with this and deallocate
+    // the metaslabs.  Note that we don't need to do any cleanup for the
+    // memory referenced by these metaslabs: it will all go away when the
+    // shared memory region is deallocated.
+    for (snmalloc::address_t a = base; a < top; a += snmalloc::MIN_CHUNK_SIZE)
     {
-      auto [g, pm] = SharedAllocConfig::Pagemap::get_pagemap_writeable();
-      snmalloc::address_t base =
-        snmalloc::address_cast(memory_provider.base_address());
-      auto top = snmalloc::address_cast(memory_provider.top_address());
-      SharedAllocConfig::Pagemap::Entry empty{nullptr, 0};
-      // Scan the pagemap for all memory associated with this and deallocate
-      // the metaslabs.  Note that we don't need to do any cleanup for the
-      // memory referenced by these metaslabs: it will all go away when the
-      // shared memory region is deallocated.
-      for (snmalloc::address_t a = base; a < top; a += snmalloc::MIN_CHUNK_SIZE)
+      auto& meta = SharedAllocConfig::Pagemap::get_metaentry_mut(a);
+      if (!meta.is_backend_owned())
       {
-        auto& meta = SharedAllocConfig::Pagemap::get_metaentry_mut(a);
-        if (!meta.is_backend_owned())
+        auto* remote = meta.get_remote();
+        if (!meta.is_sandbox_owned() && (remote != nullptr))
         {
-          auto* remote = meta.get_remote();
-          if (!meta.is_sandbox_owned() && (remote != nullptr))
-          {
-            delete meta.get_slab_metadata();
-          }
+          delete meta.get_slab_metadata();
         }
-        meta = empty;
-        SANDBOX_DEBUG_INVARIANT(
-          !meta.is_sandbox_owned(),
-          "Unused pagemap entry must not be sandbox owned");
       }
+      meta = empty;
+      SANDBOX_DEBUG_INVARIANT(
+        !meta.is_sandbox_owned(),
+        "Unused pagemap entry must not be sandbox owned");
     }
-    shared_mem->destroy();
   }
 
   void Library::start_child(
@@ -807,7 +1470,9 @@ namespace sandbox
     };
     // Move all of the file descriptors that we're going to use out of the
     // region that we're going to populate.
-    int shm_fd = move_fd(shm.get_handle().take());
+    // The parent keeps its handle to the heap, to start another child after
+    // a reset, so copy it rather than taking it.
+    int shm_fd = move_fd(shm.get_handle().fd);
     int pagemap_fd = move_fd(pagemap_mem.fd);
     fd_socket = move_fd(fd_socket.take());
     malloc_rpc_socket = move_fd(malloc_rpc_socket.take());
@@ -854,7 +1519,14 @@ namespace sandbox
       sizeof(location));
     static_assert(
       OtherLibraries == 8, "First entry in LD_LIBRARY_PATH_FDS is incorrect");
-    std::array<const char*, 2> env = {location, nullptr};
+    // The child applies its policy, and so picks how system calls reach us,
+    // after exec.
+    std::array<const char*, 3> env = {
+      location,
+      interposition == SyscallInterposition::UserNotification ?
+        "SANDBOX_SYSCALL_NOTIFY=1" :
+        nullptr,
+      nullptr};
     platform::disable_aslr();
     platform::Sandbox::execve(librunnerpath, env, libdirs);
     // Should be unreachable, but just in case we failed to exec, don't return
@@ -862,29 +1534,30 @@ namespace sandbox
     _exit(EXIT_FAILURE);
   }
 
-  Library::Library(const char* library_name, size_t size)
+  Library::Library(
+    const char* library_name,
+    size_t size,
+    size_t workers,
+    SyscallInterposition interposition)
   : shm(snmalloc::bits::next_pow2_bits(size << 30)),
     memory_provider(
       pointer_offset(shm.get_base(), sizeof(SharedMemoryRegion)),
       shm.get_size() - sizeof(SharedMemoryRegion)),
-    callback_dispatcher(std::make_unique<CallbackDispatcher>())
+    callback_dispatcher(std::make_unique<CallbackDispatcher>()),
+    interposition(interposition),
+    worker_count(
+      workers == 0 ? 1 : std::min(workers, SharedMemoryRegion::MaxWorkers))
   {
-    void* shm_base = shm.get_base();
-    // Allocate the shared memory region and set its memory provider to use all
-    // of the space after the end of the header for subsequent allocations.
-    shared_mem = new (shm_base) SharedMemoryRegion();
-    shared_mem->start = shm_base;
-    shared_mem->end = pointer_offset(shm.get_base(), shm.get_size());
+    SANDBOX_INVARIANT(
+      supports(interposition),
+      "System call interposition {} is not supported on this platform",
+      static_cast<int>(interposition));
+    for (size_t i = 0; i < worker_count; i++)
+    {
+      free_slots.push_back(static_cast<int>(i));
+    }
 
-    // Create a pair of sockets that we can use to
-    auto malloc_rpc_sockets = platform::SocketPair::create();
-    memory_service_provider().add_range(
-      *this, std::move(malloc_rpc_sockets.first));
-    // Construct a UNIX domain socket.  This is used to send file descriptors
-    // from the parent to the child
-    auto socks = platform::SocketPair::create();
     std::string path = ".";
-    std::string lib;
     // Use dladdr to find the path of the libsandbox shared library.  For now,
     // we assume that the library runner is in the same place and so is the
     // library that we're going to open.  Eventually we should look for
@@ -900,17 +1573,36 @@ namespace sandbox
     }
     if (library_name[0] == '/')
     {
-      lib = library_name;
+      library_path = library_name;
     }
     else
     {
-      lib = path;
-      lib += '/';
-      lib += library_name;
+      library_path = path;
+      library_path += '/';
+      library_path += library_name;
     }
-    library_name = lib.c_str();
-    path += "/library_runner";
-    const char* librunnerpath = path.c_str();
+    runner_path = path + "/library_runner";
+    start();
+  }
+
+  void Library::start()
+  {
+    void* shm_base = shm.get_base();
+    // Allocate the shared memory region and set its memory provider to use all
+    // of the space after the end of the header for subsequent allocations.
+    shared_mem = new (shm_base) SharedMemoryRegion();
+    shared_mem->start = shm_base;
+    shared_mem->end = pointer_offset(shm.get_base(), shm.get_size());
+    shared_mem->workers = worker_count;
+    // Create a pair of sockets that we can use to
+    auto malloc_rpc_sockets = platform::SocketPair::create();
+    memory_service_provider().add_range(
+      *this, std::move(malloc_rpc_sockets.first));
+    // Construct a UNIX domain socket.  This is used to send file descriptors
+    // from the parent to the child
+    auto socks = platform::SocketPair::create();
+    const char* library_name = library_path.c_str();
+    const char* librunnerpath = runner_path.c_str();
     child_proc = std::make_unique<platform::ChildProcess>([&]() {
       // In the child process.
       start_child(
@@ -922,6 +1614,23 @@ namespace sandbox
         std::move(socks.second));
     });
     callback_dispatcher->socket = std::move(socks.first);
+#ifdef SANDBOX_USE_SYSCALL_NOTIFIER
+    // The child sends its listener before it runs any code from the library,
+    // and so before anything else on the socket.  If it fails to start, the
+    // first call reports that it has exited.
+    if (interposition == SyscallInterposition::UserNotification)
+    {
+      int unused;
+      platform::Handle listener;
+      if (
+        callback_dispatcher->socket.blocking_receive(unused, listener) &&
+        listener.is_valid())
+      {
+        syscall_notifier =
+          std::make_unique<SyscallNotifier>(*this, std::move(listener));
+      }
+    }
+#endif
     // Allocate an allocator in the shared memory region.
 
     allocator = std::make_unique<SharedAlloc>();
@@ -931,65 +1640,247 @@ namespace sandbox
     allocator->init(core_alloc.get());
   }
 
-  void Library::send(int idx, void* ptr)
+  void Library::reset()
   {
-    // If this is the first call, we need to handle callbacks while the sandbox
-    // initialises
-    if (is_first_call)
     {
-      while (!shared_mem->token.is_child_loaded)
+      std::lock_guard g(slots_lock);
+      SANDBOX_INVARIANT(
+        free_slots.size() == worker_count,
+        "Library reset while a call into the sandbox is in progress");
+    }
+    wait_for_child_exit();
+    syscall_notifier.reset();
+    // Nothing can use the heap now, so throw away all of the allocator state
+    // that refers to it.  The host's allocator may post frees to the child's
+    // allocators as it is torn down, but those are about to be discarded.
+    allocator.reset();
+    core_alloc.reset();
+    clear_pagemap();
+    shared_mem->destroy();
+    shm.discard();
+    // The memory provider's free ranges were recorded in the pagemap entries
+    // that were just cleared, so start it again with the whole heap.
+    memory_provider.~LocalState();
+    new (&memory_provider) SharedAllocConfig::LocalState(
+      pointer_offset(shm.get_base(), sizeof(SharedMemoryRegion)),
+      shm.get_size() - sizeof(SharedMemoryRegion));
+    statistics.heap_bytes.store(0, std::memory_order_relaxed);
+    child_loaded = std::make_unique<std::once_flag>();
+    {
+      std::lock_guard g(shared_buffers_lock);
+      shared_buffer_handles.clear();
+    }
+    generation++;
+    start();
+  }
+
+  /**
+   * A call slot of a `Library` held by the calling thread for the duration of
+   * a call.  The slots held by a thread form a stack, so that a call made by
+   * a callback handler, while the thread is waiting on a slot of the same
+   * library, reuses that slot: the worker that made the callback is waiting
+   * in a nested run loop to run it.
+   */
+  class HeldSlot
+  {
+    /**
+     * The innermost slot held by this thread.
+     */
+    static inline thread_local HeldSlot* innermost = nullptr;
+
+    /**
+     * The library that the slot belongs to.
+     */
+    Library& lib;
+
+    /**
+     * The slot held by the enclosing call on this thread, if any.
+     */
+    HeldSlot* outer;
+
+    /**
+     * Whether this took the slot from the library, rather than reusing the
+     * one held by an enclosing call.
+     */
+    bool acquired = true;
+
+  public:
+    /**
+     * The index of the slot.
+     */
+    int index;
+
+    HeldSlot(Library& l) : lib(l), outer(innermost)
+    {
+      for (HeldSlot* h = outer; h != nullptr; h = h->outer)
       {
-        if (shared_mem->token.callback_depth > 0)
+        if (&h->lib == &lib)
         {
-          shared_mem->token.parent.wait(INT_MAX);
-          callback_dispatcher->handle(*this);
-          shared_mem->token.callback_depth--;
-          shared_mem->token.is_child_executing = true;
-          shared_mem->token.child.wake();
-        }
-        else
-        {
-          std::this_thread::sleep_for(1ms);
+          index = h->index;
+          acquired = false;
+          break;
         }
       }
+      if (acquired)
+      {
+        index = lib.acquire_slot();
+      }
+      innermost = this;
+    }
+
+    ~HeldSlot()
+    {
+      innermost = outer;
+      if (acquired)
+      {
+        lib.release_slot(index);
+      }
+    }
+  };
+
+  int Library::acquire_slot()
+  {
+    std::unique_lock g(slots_lock);
+    slot_freed.wait(g, [&]() { return !free_slots.empty(); });
+    int slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  }
+
+  void Library::release_slot(int slot)
+  {
+    {
+      std::lock_guard g(slots_lock);
+      free_slots.push_back(slot);
+    }
+    slot_freed.notify_one();
+  }
+
+  void Library::wait_for_child_load()
+  {
+    auto& slot = shared_mem->slots[0];
+    while (!shared_mem->is_child_loaded)
+    {
+      if (slot.callback_depth > 0)
+      {
+        slot.parent.wait(INT_MAX);
+        callback_dispatcher->handle(*this, slot);
+        slot.callback_depth--;
+        slot.is_child_executing = true;
+        slot.child.wake();
+      }
+      else
+      {
+        std::this_thread::sleep_for(1ms);
+      }
+    }
+  }
+
+  void Library::send(int idx, void* ptr, std::chrono::milliseconds timeout)
+  {
+    // If this is the first call, we need to handle callbacks while the sandbox
+    // initialises
+    std::call_once(*child_loaded, [&]() { wait_for_child_load(); });
+    HeldSlot held(*this);
+    auto& slot = shared_mem->slots[held.index];
+    auto& spin = spinners[held.index];
+    if (timeout.count() == 0)
+    {
+      timeout = call_timeout;
+    }
+    std::optional<CallDeadline> deadline;
+    if (timeout.count() > 0)
+    {
+      deadline.emplace(*this, slot, timeout);
     }
-    int callback_depth = shared_mem->token.callback_depth.load();
-    shared_mem->function_index = idx;
-    shared_mem->msg_buffer = ptr;
-    assert(!shared_mem->token.is_child_executing);
-    shared_mem->token.is_child_executing = true;
-    shared_mem->token.child.wake();
+    auto& stats = statistics.function(idx);
+    stats.calls.fetch_add(1, std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration waited{0};
+    int callback_depth = slot.callback_depth.load();
+    slot.function_index = idx;
+    slot.msg_buffer = ptr;
+    assert(!slot.is_child_executing);
+    slot.is_child_executing = true;
+    slot.child.wake();
     bool handled_callback;
+    auto check_deadline = [&]() {
+      if (deadline && deadline->expired)
+      {
+        throw std::runtime_error("Sandboxed call exceeded its deadline");
+      }
+    };
     // Wait for a second, see if the child has exited, if it's still going,
-    // try again.
-    // FIXME: We should probably allow the user to specify a maxmimum
-    // execution time for all calls and kill the sandbox and raise an
-    // exception if it's taking too long.
+    // try again.  The watchdog terminates the child and wakes us if the call
+    // has a deadline and misses it.
     do
     {
       handled_callback = false;
-      while (!shared_mem->token.parent.wait(100))
+      auto wait_start = std::chrono::steady_clock::now();
+      while (!spin.wait(slot.parent, 100))
       {
         if (has_child_exited())
         {
+          check_deadline();
           throw std::runtime_error("Sandboxed library terminated abnormally");
         }
       }
+      waited += std::chrono::steady_clock::now() - wait_start;
+      check_deadline();
       // If we were woken up for an callback, then handle it, wake up the
       // child, and then continue waiting.
       // Note that we may be called recursively by the callback handler to
       // re-invoke something in the child.  That should only happen for user
       // callbacks
-      if (shared_mem->token.callback_depth.load() > callback_depth)
+      if (slot.callback_depth.load() > callback_depth)
       {
-        callback_dispatcher->handle(*this);
-        shared_mem->token.callback_depth--;
-        shared_mem->token.is_child_executing = true;
-        shared_mem->token.child.wake();
+        callback_dispatcher->handle(*this, slot);
+        slot.callback_depth--;
+        slot.is_child_executing = true;
+        slot.child.wake();
         handled_callback = true;
+        stats.callbacks.fetch_add(1, std::memory_order_relaxed);
       }
     } while (handled_callback);
+    stats.latency.record(std::chrono::steady_clock::now() - start);
+    stats.wait.record(waited);
   }
+  void Library::run_async_calls()
+  {
+    std::unique_lock g(async_lock);
+    while (true)
+    {
+      async_idle++;
+      async_ready.wait(
+        g, [&]() { return async_stopping || !async_calls.empty(); });
+      async_idle--;
+      if (async_calls.empty())
+      {
+        return;
+      }
+      auto call = std::move(async_calls.front());
+      async_calls.pop_front();
+      g.unlock();
+      call->run();
+      call.reset();
+      g.lock();
+    }
+  }
+
+  void Library::send_async(std::unique_ptr<AsyncCall>&& call)
+  {
+    {
+      std::lock_guard g(async_lock);
+      async_calls.push_back(std::move(call));
+      if ((async_idle == 0) && (async_threads.size() < worker_count))
+      {
+        async_threads.emplace_back([this]() { run_async_calls(); });
+        return;
+      }
+    }
+    async_ready.notify_one();
+  }
+
   bool Library::has_child_exited()
   {
     return child_proc->exit_status().has_exited;
@@ -1011,9 +1902,13 @@ namespace sandbox
       return exit_status.exit_code;
     }
     shared_mem->should_exit = true;
-    assert(!shared_mem->token.is_child_executing);
-    shared_mem->token.is_child_executing = true;
-    shared_mem->token.child.wake();
+    for (size_t i = 0; i < worker_count; i++)
+    {
+      auto& slot = shared_mem->slots[i];
+      assert(!slot.is_child_executing);
+      slot.is_child_executing = true;
+      slot.child.wake();
+    }
     return child_proc->wait_for_exit().exit_code;
   }
 
@@ -1025,10 +1920,12 @@ namespace sandbox
     {
       return nullptr;
     }
+    std::lock_guard g(allocator_lock);
     return allocator->alloc(sz);
   }
   void Library::dealloc_in_sandbox(void* ptr)
   {
+    std::lock_guard g(allocator_lock);
     allocator->dealloc(ptr);
   }
 
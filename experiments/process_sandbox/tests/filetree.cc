@@ -0,0 +1,75 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <fcntl.h>
+#include <process_sandbox/filetree.h>
+#include <process_sandbox/helpers.h>
+
+using sandbox::ExportedFileTree;
+using sandbox::Path;
+using sandbox::platform::Handle;
+
+namespace
+{
+  /**
+   * Look up `path` twice, so that the second lookup is answered by the
+   * cache, and check that both give the same result.
+   */
+  ExportedFileTree::LookupResult
+  lookup(ExportedFileTree& tree, std::string_view path)
+  {
+    auto first = tree.lookup_file(Path(path));
+    auto second = tree.lookup_file(Path(path));
+    SANDBOX_INVARIANT(
+      first.has_value() == second.has_value(),
+      "Cached lookup of {} disagrees",
+      path);
+    if (first)
+    {
+      SANDBOX_INVARIANT(
+        (first->first == second->first) &&
+          (first->second.str() == second->second.str()),
+        "Cached lookup of {} disagrees",
+        path);
+    }
+    return first;
+  }
+}
+
+int main()
+{
+  ExportedFileTree tree;
+  int dir = open("/", O_DIRECTORY);
+  int file = open("/dev/null", O_RDONLY);
+  SANDBOX_INVARIANT(
+    tree.add_directory("/root/dir", Handle(dir)), "Adding a directory failed");
+  SANDBOX_INVARIANT(
+    tree.add_file("/files/null", Handle(file)), "Adding a file failed");
+
+  auto r = lookup(tree, "/root/dir/a/b");
+  SANDBOX_INVARIANT(r && (r->first == dir), "Directory lookup failed");
+  SANDBOX_INVARIANT(
+    r->second.str() == "a/b", "Unexpected path tail {}", r->second.str());
+
+  r = lookup(tree, "/files/null");
+  SANDBOX_INVARIANT(r && (r->first == file), "File lookup failed");
+  SANDBOX_INVARIANT(r->second.is_empty(), "File lookup left a path tail");
+
+  // A path that is not found is cached, but must be found once added.
+  r = lookup(tree, "/files/other");
+  SANDBOX_INVARIANT(!r, "Lookup of a missing file succeeded");
+  int other = open("/dev/null", O_RDONLY);
+  SANDBOX_INVARIANT(
+    tree.add_file("/files/other", Handle(other)), "Adding a file failed");
+  r = lookup(tree, "/files/other");
+  SANDBOX_INVARIANT(r && (r->first == other), "Added file was not found");
+
+  tree.freeze();
+  SANDBOX_INVARIANT(
+    !tree.add_file("/files/late", Handle(open("/dev/null", O_RDONLY))),
+    "Adding to a frozen tree succeeded");
+  r = lookup(tree, "/files/late");
+  SANDBOX_INVARIANT(!r, "File added to a frozen tree was found");
+  r = lookup(tree, "/root/dir/c");
+  SANDBOX_INVARIANT(r && (r->first == dir), "Lookup in a frozen tree failed");
+  return 0;
+}
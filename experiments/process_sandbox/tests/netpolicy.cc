@@ -0,0 +1,147 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <arpa/inet.h>
+#include <process_sandbox/helpers.h>
+#include <process_sandbox/netpolicy.h>
+#include <unistd.h>
+
+using sandbox::NetworkPolicy;
+using NetOp = NetworkPolicy::NetOperation;
+
+namespace
+{
+  /**
+   * Number of times that `fake_getaddrinfo` has been called.
+   */
+  int lookups = 0;
+
+  /**
+   * The address returned by `fake_getaddrinfo`.
+   */
+  sockaddr_in fake_addr;
+
+  /**
+   * The list returned by `fake_getaddrinfo`.
+   */
+  addrinfo fake_result;
+
+  /**
+   * A `getaddrinfo` handler that resolves every host to `fake_addr`.
+   */
+  int fake_getaddrinfo(
+    const char*, const char*, const addrinfo*, addrinfo** res) noexcept
+  {
+    lookups++;
+    memset(&fake_result, 0, sizeof(fake_result));
+    fake_result.ai_family = AF_INET;
+    fake_result.ai_addrlen = sizeof(fake_addr);
+    fake_result.ai_addr = reinterpret_cast<sockaddr*>(&fake_addr);
+    *res = &fake_result;
+    return 0;
+  }
+
+  /**
+   * Return a loopback address with the given port, in host byte order.
+   */
+  sockaddr_in loopback(in_port_t port)
+  {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+  }
+
+  /**
+   * Try to connect a new socket to `addr` with `policy`, returning the errno
+   * value, or 0 on success.
+   */
+  int try_connect(NetworkPolicy& policy, sockaddr_in addr)
+  {
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    SANDBOX_INVARIANT(s >= 0, "socket failed");
+    int ret = policy.invoke<NetOp::Connect>(
+      s, reinterpret_cast<sockaddr*>(&addr), socklen_t(sizeof(addr)));
+    int err = (ret == 0) ? 0 : errno;
+    close(s);
+    return err;
+  }
+}
+
+int main()
+{
+  NetworkPolicy policy;
+
+  // Listen on an ephemeral loopback port.
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = loopback(0);
+  socklen_t addrlen = sizeof(addr);
+  SANDBOX_INVARIANT(
+    bind(server, reinterpret_cast<sockaddr*>(&addr), addrlen) == 0,
+    "bind failed");
+  SANDBOX_INVARIANT(listen(server, 4) == 0, "listen failed");
+  getsockname(server, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+
+  // Connections are denied by default, and then only allowed to addresses in
+  // the set.
+  SANDBOX_INVARIANT(
+    try_connect(policy, addr) == ENOSYS, "Default policy allowed connect");
+  sockaddr_in other = addr;
+  other.sin_port = htons(ntohs(addr.sin_port) + 1);
+  policy.allow_address<NetOp::Connect>(
+    reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  SANDBOX_INVARIANT(
+    try_connect(policy, addr) == 0, "Connect to an allowed address failed");
+  SANDBOX_INVARIANT(
+    try_connect(policy, other) == EACCES,
+    "Connect to an address that is not allowed succeeded");
+
+  // A port of 0 allows every port on the address.
+  sockaddr_in any_port = loopback(0);
+  policy.allow_address<NetOp::Connect>(
+    reinterpret_cast<sockaddr*>(&any_port), sizeof(any_port));
+  SANDBOX_INVARIANT(
+    try_connect(policy, other) != EACCES, "Wildcard port was not allowed");
+
+  // Addresses that are not IPv4 or IPv6 are never in the set.
+  sockaddr unspec;
+  memset(&unspec, 0, sizeof(unspec));
+  SANDBOX_INVARIANT(
+    !policy.allow_address<NetOp::Bind>(&unspec, sizeof(unspec)),
+    "Added an address without a family");
+
+  // Lookups reach the handler each time unless the cache is enabled.
+  fake_addr = loopback(80);
+  policy.register_handler<NetOp::GetAddrInfo>(fake_getaddrinfo);
+  policy.freeaddrinfo = [](addrinfo*) {};
+  auto check_lookup = [&](const char* host) {
+    int ret = policy.lookup_addrinfo(
+      host, "http", nullptr, [](const addrinfo* res) {
+        SANDBOX_INVARIANT(
+          (res != nullptr) && (res->ai_next == nullptr) &&
+            (res->ai_addrlen == sizeof(fake_addr)) &&
+            (memcmp(res->ai_addr, &fake_addr, sizeof(fake_addr)) == 0),
+          "Lookup returned the wrong result");
+      });
+    SANDBOX_INVARIANT(ret == 0, "Lookup failed: {}", ret);
+  };
+  check_lookup("example.com");
+  check_lookup("example.com");
+  SANDBOX_INVARIANT(lookups == 2, "Uncached lookups: {}", lookups);
+
+  policy.cache_lookups(std::chrono::minutes(1));
+  check_lookup("example.com");
+  check_lookup("example.com");
+  SANDBOX_INVARIANT(lookups == 3, "Cached lookups: {}", lookups);
+  check_lookup("example.org");
+  SANDBOX_INVARIANT(lookups == 4, "Lookup of another host: {}", lookups);
+
+  // Changing the policy discards the cached results.
+  policy.register_handler<NetOp::GetAddrInfo>(fake_getaddrinfo);
+  check_lookup("example.com");
+  SANDBOX_INVARIANT(lookups == 5, "Lookup after a policy change: {}", lookups);
+
+  close(server);
+  return 0;
+}
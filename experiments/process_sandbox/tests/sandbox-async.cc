@@ -0,0 +1,66 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <vector>
+
+using namespace sandbox;
+
+int sum(int, int);
+
+/**
+ * The structure that represents an instance of the sandbox, with two
+ * workers so that two asynchronous calls can run at once.
+ */
+struct AsyncSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY, 1, 2};
+  decltype(make_sandboxed_function<decltype(::sum)>(lib)) sum =
+    make_sandboxed_function<decltype(::sum)>(lib);
+};
+
+/**
+ * Check that several calls can be in flight from one thread, each completing
+ * its own future.
+ */
+void test_futures(AsyncSandbox& sb)
+{
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 10; i++)
+  {
+    results.push_back(sb.sum.async(i, i));
+  }
+  for (int i = 0; i < 10; i++)
+  {
+    int ret = results[i].get();
+    SANDBOX_INVARIANT(ret == (i + i), "{} + {} == {}", i, i, ret);
+  }
+}
+
+/**
+ * Check that a move-only completion is called with the result.
+ */
+void test_then(AsyncSandbox& sb)
+{
+  std::promise<int> p;
+  std::future<int> result = p.get_future();
+  sb.sum.async_then(
+    [p = std::move(p)](std::future<int> r) mutable { p.set_value(r.get()); },
+    20,
+    22);
+  int ret = result.get();
+  SANDBOX_INVARIANT(ret == 42, "20 + 22 == {}", ret);
+}
+
+int main()
+{
+  AsyncSandbox sandbox;
+  test_futures(sandbox);
+  test_then(sandbox);
+  return 0;
+}
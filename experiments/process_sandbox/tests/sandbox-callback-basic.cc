@@ -6,6 +6,7 @@
 #include "process_sandbox/filetree.h"
 #include "process_sandbox/sandbox.h"
 
+#include <chrono>
 #include <stdio.h>
 
 using namespace sandbox;
@@ -21,6 +22,8 @@ struct CallbackSandbox
   Library lib = {SANDBOX_LIBRARY};
   decltype(make_sandboxed_function<int(int)>(lib)) call_callback =
     make_sandboxed_function<int(int)>(lib);
+  decltype(make_sandboxed_function<int(int, int, int)>(lib)) repeat =
+    make_sandboxed_function<int(int, int, int)>(lib);
 };
 
 CallbackHandlerBase::Result callback(Library&, int val)
@@ -30,6 +33,25 @@ CallbackHandlerBase::Result callback(Library&, int val)
   return 42;
 }
 
+/**
+ * Report the mean round trip of a callback, passed in the call slot when `fd`
+ * is -1 and over the socket with a file descriptor otherwise.
+ */
+void time_callbacks(CallbackSandbox& sandbox, int callback_number, int fd)
+{
+  static constexpr int count = 10000;
+  auto start = std::chrono::steady_clock::now();
+  int ret = sandbox.repeat(callback_number, count, fd);
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+  SANDBOX_INVARIANT(ret == count, "{} of {} callbacks succeeded", ret, count);
+  printf(
+    "%s: %lld ns per callback\n",
+    fd < 0 ? "shared memory" : "socket",
+    static_cast<long long>(ns / count));
+}
+
 int main()
 {
   CallbackSandbox sandbox;
@@ -39,6 +61,9 @@ int main()
   {
     int ret = sandbox.call_callback(callback_number);
     SANDBOX_INVARIANT(ret == 42, "Sandbox returned {}, expected 42", ret);
+    time_callbacks(sandbox, callback_number, -1);
+    // Sending the child's standard error forces the socket path.
+    time_callbacks(sandbox, callback_number, STDERR_FILENO);
   }
   catch (...)
   {
@@ -0,0 +1,107 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of sandboxes owned by cowns.  A call from a behaviour must not block
+ * the scheduler thread, so with a single scheduler thread another behaviour
+ * runs while the call does.  The results must be delivered as behaviours, in
+ * order, and the runtime must not terminate while a call is in progress.
+ */
+
+#include "process_sandbox/sandbox_cown.h"
+
+#include <atomic>
+#include <chrono>
+
+using namespace sandbox;
+using namespace verona::cpp;
+using namespace std::chrono;
+
+int sleep_for(int);
+int add(int, int);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct CownSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::sleep_for)>(lib)) sleep_for =
+    make_sandboxed_function<decltype(::sleep_for)>(lib);
+  decltype(make_sandboxed_function<decltype(::add)>(lib)) add =
+    make_sandboxed_function<decltype(::add)>(lib);
+};
+
+/**
+ * State of the test, owned by a cown of its own.
+ */
+struct Progress
+{
+  /**
+   * The time at which a behaviour ran during the slow call.
+   */
+  steady_clock::time_point other_ran;
+
+  /**
+   * The number of results delivered.
+   */
+  int results = 0;
+};
+
+/**
+ * Number of results delivered, checked after the runtime has stopped.
+ */
+std::atomic<int> delivered{0};
+
+int main()
+{
+  auto& sched = verona::rt::Scheduler::get();
+  sched.init(1);
+
+  {
+    auto box = SandboxCown<CownSandbox>::make();
+    auto progress = make_cown<Progress>();
+    auto start = steady_clock::now();
+    constexpr int slow_ms = 500;
+
+    box.call(
+      &CownSandbox::sleep_for,
+      [progress, start](acquired_cown<CownSandbox>&, std::future<int> r) {
+        SANDBOX_INVARIANT(r.get() == slow_ms, "sleep_for returned wrongly");
+        auto finished = steady_clock::now();
+        when(progress) << [start, finished](acquired_cown<Progress> p) {
+          SANDBOX_INVARIANT(
+            p->results == 0, "Results were delivered out of order");
+          SANDBOX_INVARIANT(
+            p->other_ran - start < (finished - start) / 2,
+            "The scheduler thread was blocked by the call");
+          p->results++;
+          delivered++;
+        };
+      },
+      slow_ms);
+    when(progress) << [](acquired_cown<Progress> p) {
+      p->other_ran = steady_clock::now();
+    };
+    box.call(
+      &CownSandbox::add,
+      [progress](acquired_cown<CownSandbox>&, std::future<int> r) {
+        SANDBOX_INVARIANT(r.get() == 3, "add returned wrongly");
+        when(progress) << [](acquired_cown<Progress> p) {
+          SANDBOX_INVARIANT(
+            p->results == 1, "Results were delivered out of order");
+          p->results++;
+          delivered++;
+        };
+      },
+      1,
+      2);
+  }
+
+  sched.run();
+  SANDBOX_INVARIANT(delivered == 2, "{} results delivered", delivered.load());
+  return 0;
+}
@@ -0,0 +1,49 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of growing the heap of a sandbox.  Each new slab in the child needs
+ * the parent to allocate it and update the pagemap, so this reports how long
+ * filling a fresh heap takes, and how long refilling it takes once the child
+ * has freed everything.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <stdio.h>
+
+using namespace sandbox;
+using namespace std::chrono;
+
+size_t grow(size_t);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct HeapGrowthSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::grow)>(lib)) grow =
+    make_sandboxed_function<decltype(::grow)>(lib);
+};
+
+int main()
+{
+  static constexpr size_t count = 100000;
+  HeapGrowthSandbox sandbox;
+  for (const char* run : {"fresh heap", "reused heap"})
+  {
+    auto start = steady_clock::now();
+    size_t valid = sandbox.grow(count);
+    auto time = duration_cast<microseconds>(steady_clock::now() - start);
+    SANDBOX_INVARIANT(
+      valid == count, "{} of {} objects were intact", valid, count);
+    printf("%s: %lld us\n", run, static_cast<long long>(time.count()));
+  }
+  return 0;
+}
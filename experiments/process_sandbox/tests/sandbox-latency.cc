@@ -0,0 +1,68 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Benchmark of the round trip of a call into a sandbox that does no work.
+ * This reports the mean latency of back-to-back calls, which spin instead of
+ * sleeping, and of calls spaced out so that the child has gone to sleep.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+using namespace sandbox;
+using namespace std::chrono;
+
+int identity(int);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct LatencySandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::identity)>(lib)) identity =
+    make_sandboxed_function<decltype(::identity)>(lib);
+};
+
+/**
+ * Make `calls` calls, waiting for `gap` before each, and return the mean time
+ * of a call in nanoseconds.
+ */
+double measure(LatencySandbox& sb, int calls, microseconds gap)
+{
+  nanoseconds total{0};
+  for (int i = 0; i < calls; i++)
+  {
+    if (gap.count() != 0)
+    {
+      std::this_thread::sleep_for(gap);
+    }
+    auto start = steady_clock::now();
+    int ret = sb.identity(i);
+    total += steady_clock::now() - start;
+    SANDBOX_INVARIANT(ret == i, "identity({}) returned {}", i, ret);
+  }
+  return static_cast<double>(total.count()) / calls;
+}
+
+int main()
+{
+  LatencySandbox sandbox;
+  // Warm up, so that the spinning has adapted to back-to-back calls.
+  measure(sandbox, 1000, microseconds(0));
+  printf(
+    "back-to-back: %.0f ns per call\n",
+    measure(sandbox, 100000, microseconds(0)));
+  printf(
+    "spaced by 1 ms: %.0f ns per call\n",
+    measure(sandbox, 200, microseconds(1000)));
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+#include "process_sandbox/sandbox_pool.h"
+
+using namespace sandbox;
+
+int count_calls();
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct CountSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::count_calls)>(lib)) count_calls =
+    make_sandboxed_function<decltype(::count_calls)>(lib);
+};
+
+using Pool = SandboxPool<CountSandbox>;
+
+std::unique_ptr<CountSandbox> make_sandbox()
+{
+  return std::make_unique<CountSandbox>();
+}
+
+/**
+ * Check that a pool that reuses sandboxes keeps their state between leases,
+ * and that a discarded sandbox is replaced by a fresh one.
+ */
+void test_reuse()
+{
+  Pool pool(1, make_sandbox);
+  {
+    auto lease = pool.acquire();
+    int calls = lease->count_calls();
+    SANDBOX_INVARIANT(calls == 1, "Fresh sandbox made {} calls", calls);
+  }
+  {
+    auto lease = pool.acquire();
+    int calls = lease->count_calls();
+    SANDBOX_INVARIANT(calls == 2, "Reused sandbox made {} calls", calls);
+    lease.discard();
+  }
+  {
+    auto lease = pool.acquire();
+    int calls = lease->count_calls();
+    SANDBOX_INVARIANT(calls == 1, "Replaced sandbox made {} calls", calls);
+  }
+}
+
+/**
+ * Check that a pool that replaces sandboxes gives each lease a fresh one,
+ * and that several sandboxes can be leased at once.
+ */
+void test_replace()
+{
+  Pool pool(2, make_sandbox, Pool::Recycle::Replace);
+  for (int i = 0; i < 3; i++)
+  {
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    SANDBOX_INVARIANT(&*a != &*b, "Leased the same sandbox twice");
+    int calls = a->count_calls() + b->count_calls();
+    SANDBOX_INVARIANT(calls == 2, "Fresh sandboxes made {} calls", calls);
+  }
+}
+
+int main()
+{
+  test_reuse();
+  test_replace();
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of Verona regions in the sandbox heap.  The host fills a region that
+ * spans several arenas, the sandbox reads and writes it in place, and the
+ * host reads the results back without a copy.  Releasing the region returns
+ * all of its memory to the sandbox heap.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+#include "process_sandbox/sandbox_region.h"
+
+using namespace sandbox;
+
+int64_t sum(const int32_t*, size_t);
+void negate(int32_t*, size_t);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct RegionSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+#define EXPORTED_FUNCTION(public_name, private_name) \
+  decltype(make_sandboxed_function<decltype(private_name)>(lib)) public_name = \
+    make_sandboxed_function<decltype(private_name)>(lib);
+  EXPORTED_FUNCTION(sum, ::sum)
+  EXPORTED_FUNCTION(negate, ::negate)
+};
+
+/**
+ * A block of values, in a list of blocks.
+ */
+struct Block : public verona::rt::V<Block>
+{
+  static constexpr size_t count = 64 * 1024;
+  int32_t values[count];
+  Block* next = nullptr;
+
+  void trace(verona::rt::ObjectStack& st) const
+  {
+    if (next != nullptr)
+    {
+      st.push(next);
+    }
+  }
+};
+
+/**
+ * The sum of the values of a block, computed in the host.
+ */
+int64_t block_sum(const Block* b)
+{
+  int64_t total = 0;
+  for (auto v : b->values)
+  {
+    total += v;
+  }
+  return total;
+}
+
+int main()
+{
+  static constexpr size_t blocks = 8;
+  RegionSandbox sandbox;
+  {
+    SandboxRegion<Block> region(sandbox.lib);
+    Block* head = region.get();
+    {
+      verona::rt::api::UsingRegion rr(head);
+      for (size_t i = 1; i < blocks; i++)
+      {
+        auto* b = new Block;
+        b->next = head->next;
+        head->next = b;
+      }
+    }
+    int32_t n = 0;
+    for (Block* b = head; b != nullptr; b = b->next)
+    {
+      SANDBOX_INVARIANT(
+        sandbox.lib.contains(b, sizeof(Block)), "Block is not in the sandbox");
+      for (auto& v : b->values)
+      {
+        v = n++ % 100;
+      }
+    }
+
+    int64_t expected = 0;
+    for (Block* b = region.lend(); b != nullptr; b = b->next)
+    {
+      int64_t s = block_sum(b);
+      expected += s;
+      SANDBOX_INVARIANT(
+        sandbox.sum(b->values, Block::count) == s,
+        "Sandbox read the block wrongly");
+      sandbox.negate(b->values, Block::count);
+    }
+
+    int64_t total = 0;
+    for (Block* b = region.reclaim(); b != nullptr; b = b->next)
+    {
+      SANDBOX_INVARIANT(
+        sandbox.lib.contains(b, sizeof(Block)), "Block is not in the sandbox");
+      total += block_sum(b);
+    }
+    SANDBOX_INVARIANT(
+      total == -expected, "Sum after negation is {}, expected {}", total,
+      -expected);
+  }
+
+  // Released regions give their memory back to the sandbox heap, so it does
+  // not run out when regions are created repeatedly.
+  for (int i = 0; i < 1000; i++)
+  {
+    SandboxRegion<Block> region(sandbox.lib);
+    SANDBOX_INVARIANT(
+      sandbox.lib.contains(region.get(), sizeof(Block)),
+      "Block is not in the sandbox");
+  }
+  return 0;
+}
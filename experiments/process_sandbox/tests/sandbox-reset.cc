@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of `Library::reset`.  The library counts the calls made to it, so a
+ * reset must start the count again.  A sandbox that has crashed must be
+ * usable again after a reset, through the same functions.  This also reports how long a reset takes, compared with
+ * creating a new sandbox.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <stdio.h>
+
+using namespace sandbox;
+using namespace std::chrono;
+
+int count_calls();
+int crash();
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct ResetSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+#define EXPORTED_FUNCTION(public_name, private_name) \
+  decltype(make_sandboxed_function<decltype(private_name)>(lib)) public_name = \
+    make_sandboxed_function<decltype(private_name)>(lib);
+  EXPORTED_FUNCTION(count_calls, ::count_calls)
+  EXPORTED_FUNCTION(crash, ::crash)
+};
+
+int main()
+{
+  auto start = steady_clock::now();
+  ResetSandbox sandbox;
+  int calls = sandbox.count_calls();
+  auto create_time = steady_clock::now() - start;
+  SANDBOX_INVARIANT(calls == 1, "First call counted {} calls", calls);
+  calls = sandbox.count_calls();
+  SANDBOX_INVARIANT(calls == 2, "Second call counted {} calls", calls);
+
+  start = steady_clock::now();
+  sandbox.lib.reset();
+  calls = sandbox.count_calls();
+  auto reset_time = steady_clock::now() - start;
+  SANDBOX_INVARIANT(calls == 1, "Call after reset counted {} calls", calls);
+
+  bool crashed = false;
+  try
+  {
+    sandbox.crash();
+  }
+  catch (std::runtime_error&)
+  {
+    crashed = true;
+  }
+  SANDBOX_INVARIANT(crashed, "Crashing the sandbox did not throw");
+  sandbox.lib.reset();
+  calls = sandbox.count_calls();
+  SANDBOX_INVARIANT(calls == 1, "Call after crash counted {} calls", calls);
+
+  printf(
+    "create: %lld us, reset: %lld us\n",
+    static_cast<long long>(duration_cast<microseconds>(create_time).count()),
+    static_cast<long long>(duration_cast<microseconds>(reset_time).count()));
+  return 0;
+}
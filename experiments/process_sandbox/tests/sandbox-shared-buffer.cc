@@ -0,0 +1,85 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+#include "process_sandbox/shared_buffer.h"
+
+#include <string.h>
+
+using namespace sandbox;
+
+size_t sum_bytes(const unsigned char*, size_t);
+void overwrite(unsigned char*);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct BufferSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+#define EXPORTED_FUNCTION(public_name, private_name) \
+  decltype(make_sandboxed_function<decltype(private_name)>(lib)) public_name = \
+    make_sandboxed_function<decltype(private_name)>(lib);
+  EXPORTED_FUNCTION(sum_bytes, ::sum_bytes)
+  EXPORTED_FUNCTION(overwrite, ::overwrite)
+};
+
+/**
+ * Check that the sandbox reads what the host writes, without a copy, and
+ * that pointers into the buffer are distinguished from the sandbox heap.
+ */
+void test_read()
+{
+  static constexpr size_t size = 1 << 20;
+  BufferSandbox sandbox;
+  SharedBuffer buffer(sandbox.lib, size);
+  memset(buffer.data(), 1, size);
+  auto* in = buffer.in_sandbox<unsigned char>();
+  size_t sum = sandbox.sum_bytes(in, size);
+  SANDBOX_INVARIANT(sum == size, "Sum of {} ones is {}", size, sum);
+
+  // Writes after mapping are visible too.
+  static_cast<unsigned char*>(buffer.data())[0] = 2;
+  sum = sandbox.sum_bytes(in, 1);
+  SANDBOX_INVARIANT(sum == 2, "First byte is {}, expected 2", sum);
+
+  SANDBOX_INVARIANT(
+    !sandbox.lib.contains(in, size), "Shared buffer is in the sandbox heap");
+  SANDBOX_INVARIANT(buffer.contains(in, size), "Buffer does not contain data");
+  SANDBOX_INVARIANT(
+    !buffer.contains(in + 1, size), "Buffer contains data past its end");
+  SANDBOX_INVARIANT(
+    buffer.to_host(in + 10) ==
+      static_cast<unsigned char*>(buffer.data()) + 10,
+    "Translated address is wrong");
+}
+
+/**
+ * Check that the sandbox cannot write to the buffer.
+ */
+void test_read_only()
+{
+  BufferSandbox sandbox;
+  SharedBuffer buffer(sandbox.lib, 4096);
+  try
+  {
+    sandbox.overwrite(const_cast<unsigned char*>(
+      buffer.in_sandbox<unsigned char>()));
+    SANDBOX_INVARIANT(false, "Sandbox wrote to a read-only buffer");
+  }
+  catch (std::runtime_error&)
+  {}
+  auto* data = static_cast<unsigned char*>(buffer.data());
+  SANDBOX_INVARIANT(data[0] == 0, "Buffer was modified to {}", data[0]);
+}
+
+int main()
+{
+  test_read();
+  test_read_only();
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of the counters kept by a `Library`.  Calls, their callbacks and
+ * their latency must be attributed to the function that was called, and the
+ * child's heap must be visible in the pagemap counters.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <sstream>
+#include <stdio.h>
+
+using namespace sandbox;
+
+int can_read(const char*);
+int identity(int);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct StatsSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::can_read)>(lib)) can_read =
+    make_sandboxed_function<decltype(::can_read)>(lib);
+  decltype(make_sandboxed_function<decltype(::identity)>(lib)) identity =
+    make_sandboxed_function<decltype(::identity)>(lib);
+};
+
+int main()
+{
+  StatsSandbox sandbox;
+  constexpr int calls = 10;
+  for (int i = 0; i < calls; i++)
+  {
+    SANDBOX_INVARIANT(sandbox.identity(i) == i, "identity returned wrongly");
+  }
+  auto path = sandbox.lib.strdup("/etc/ld.so.cache");
+  sandbox.can_read(path);
+  sandbox.lib.free(path);
+
+  auto& id = sandbox.identity.stats();
+  SANDBOX_INVARIANT(id.calls == calls, "{} calls counted", id.calls.load());
+  SANDBOX_INVARIANT(
+    id.latency.count() == calls, "{} latencies", id.latency.count());
+  SANDBOX_INVARIANT(id.callbacks == 0, "identity made callbacks");
+  SANDBOX_INVARIANT(
+    id.wait.total() <= id.latency.total(), "Waited for longer than the call");
+
+  auto& cr = sandbox.can_read.stats();
+  SANDBOX_INVARIANT(cr.calls == 1, "{} calls counted", cr.calls.load());
+  SANDBOX_INVARIANT(cr.callbacks >= 1, "can_read made no callbacks");
+
+  auto& stats = sandbox.lib.stats();
+  uint64_t callbacks = 0;
+  for (size_t k = 0; k < LibraryStats::CallbackKinds; k++)
+  {
+    callbacks += stats.callback_count(k);
+  }
+  SANDBOX_INVARIANT(
+    callbacks >= cr.callbacks, "{} callbacks counted by kind", callbacks);
+  SANDBOX_INVARIANT(stats.pagemap_updates > 0, "No pagemap updates counted");
+  SANDBOX_INVARIANT(stats.heap_bytes > 0, "No heap counted");
+
+  std::stringstream o;
+  stats.write_prometheus(o, "library=\"stats\"");
+  fprintf(stderr, "%s", o.str().c_str());
+  SANDBOX_INVARIANT(
+    o.str().find("sandbox_calls_total{library=\"stats\",function=") !=
+      std::string::npos,
+    "Calls missing from the export");
+
+  // Counters are kept across a reset, apart from the heap size.
+  sandbox.lib.reset();
+  SANDBOX_INVARIANT(id.calls == calls, "Reset cleared the counters");
+  sandbox.identity(1);
+  SANDBOX_INVARIANT(id.calls == calls + 1, "Call after reset not counted");
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Benchmark of the system calls that the parent services for a sandbox, with
+ * each of the ways that they can reach it, see `SyscallInterposition`.  The
+ * sandbox opens, stats and checks access to an exported file with raw system
+ * calls, and this reports the mean time of each group of three.  Every way
+ * must give the same results.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/filetree.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <stdio.h>
+
+using namespace sandbox;
+using namespace std::chrono;
+
+int churn(int);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct SyscallSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib;
+  decltype(make_sandboxed_function<decltype(::churn)>(lib)) churn =
+    make_sandboxed_function<decltype(::churn)>(lib);
+
+  SyscallSandbox(SyscallInterposition interposition)
+  : lib(SANDBOX_LIBRARY, 1, 1, interposition)
+  {}
+};
+
+/**
+ * Run `iterations` rounds of system calls with `interposition`, printing the
+ * mean time of a round, and return the result of the sandbox.
+ */
+int measure(
+  SyscallInterposition interposition, const char* name, int iterations)
+{
+  SyscallSandbox sandbox(interposition);
+  platform::SharedMemoryMap file(16);
+  sandbox.lib.filetree().add_file("/foo", std::move(file.get_handle()));
+  // Warm up, so that the child has everything it needs mapped.
+  sandbox.churn(10);
+  auto start = steady_clock::now();
+  int ret = sandbox.churn(iterations);
+  nanoseconds total = steady_clock::now() - start;
+  printf(
+    "%s: %.0f ns per open, stat and access\n",
+    name,
+    static_cast<double>(total.count()) / iterations);
+  return ret;
+}
+
+int main()
+{
+  static constexpr int iterations = 10000;
+  int signal = measure(SyscallInterposition::Signal, "signal", iterations);
+  SANDBOX_INVARIANT(
+    signal == 3 * iterations,
+    "{} of {} system calls succeeded",
+    signal,
+    3 * iterations);
+  if (Library::supports(SyscallInterposition::UserNotification))
+  {
+    int notify = measure(
+      SyscallInterposition::UserNotification, "user notification", iterations);
+    SANDBOX_INVARIANT(
+      notify == signal,
+      "{} system calls succeeded with user notification, {} with a signal",
+      notify,
+      signal);
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <thread>
+#include <vector>
+
+using namespace sandbox;
+
+int rendezvous(int);
+int sum(int, int);
+
+static constexpr int workers = 4;
+
+/**
+ * The structure that represents an instance of the sandbox, with several
+ * workers.
+ */
+struct ThreadsSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY, 1, workers};
+#define EXPORTED_FUNCTION(public_name, private_name) \
+  decltype(make_sandboxed_function<decltype(private_name)>(lib)) public_name = \
+    make_sandboxed_function<decltype(private_name)>(lib);
+  EXPORTED_FUNCTION(rendezvous, ::rendezvous)
+  EXPORTED_FUNCTION(sum, ::sum)
+};
+
+/**
+ * Check that calls from as many threads as there are workers run at the same
+ * time: each waits in the sandbox until all of them have arrived.
+ */
+void test_parallel(ThreadsSandbox& sb)
+{
+  std::vector<std::thread> threads;
+  for (int i = 0; i < workers; i++)
+  {
+    threads.emplace_back([&]() {
+      int seen = sb.rendezvous(workers);
+      SANDBOX_INVARIANT(
+        seen >= workers, "Saw {} concurrent calls, expected {}", seen, workers);
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+}
+
+/**
+ * Check that calls from more threads than there are workers wait for a free
+ * worker and all complete.
+ */
+void test_oversubscribed(ThreadsSandbox& sb)
+{
+  std::vector<std::thread> threads;
+  for (int i = 0; i < workers * 4; i++)
+  {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 100; j++)
+      {
+        int ret = sb.sum(i, j);
+        SANDBOX_INVARIANT(ret == (i + j), "{} + {} == {}", i, j, ret);
+      }
+    });
+  }
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+}
+
+int main()
+{
+  ThreadsSandbox sandbox;
+  test_parallel(sandbox);
+  test_oversubscribed(sandbox);
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Test of call deadlines.  A call that runs for longer than the limit set on
+ * its function, or on the library, must terminate the sandbox and throw
+ * promptly, and the sandbox must work again after a reset.  Calls that finish
+ * in time must be unaffected.
+ */
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <stdio.h>
+
+using namespace sandbox;
+using namespace std::chrono;
+
+int spin(int);
+
+/**
+ * The structure that represents an instance of the sandbox.
+ */
+struct TimeoutSandbox
+{
+  /**
+   * The library that defines the functions exposed by this sandbox.
+   */
+  Library lib = {SANDBOX_LIBRARY};
+  decltype(make_sandboxed_function<decltype(::spin)>(lib)) spin =
+    make_sandboxed_function<decltype(::spin)>(lib);
+};
+
+/**
+ * Call `spin` for `ms` milliseconds and check that it times out, well before
+ * it would have returned.
+ */
+void check_times_out(TimeoutSandbox& sandbox, int ms)
+{
+  auto start = steady_clock::now();
+  bool timed_out = false;
+  try
+  {
+    sandbox.spin(ms);
+  }
+  catch (std::runtime_error& e)
+  {
+    printf("Sandbox exception: %s\n", e.what());
+    timed_out = true;
+  }
+  auto time = duration_cast<milliseconds>(steady_clock::now() - start);
+  SANDBOX_INVARIANT(timed_out, "Call of {} ms did not time out", ms);
+  SANDBOX_INVARIANT(
+    time.count() < ms / 2, "Timing out took {} ms", time.count());
+}
+
+int main()
+{
+  TimeoutSandbox sandbox;
+  sandbox.spin.set_timeout(milliseconds(100));
+  int ret = sandbox.spin(1);
+  SANDBOX_INVARIANT(ret == 1, "spin returned {}", ret);
+  check_times_out(sandbox, 10000);
+
+  sandbox.lib.reset();
+  sandbox.spin.set_timeout(milliseconds(0));
+  sandbox.lib.set_call_timeout(milliseconds(100));
+  ret = sandbox.spin(1);
+  SANDBOX_INVARIANT(ret == 1, "spin returned {} after reset", ret);
+  check_times_out(sandbox, 10000);
+
+  sandbox.lib.reset();
+  sandbox.lib.set_call_timeout(milliseconds(0));
+  ret = sandbox.spin(200);
+  SANDBOX_INVARIANT(ret == 200, "spin returned {} without a limit", ret);
+  return 0;
+}
@@ -4,10 +4,12 @@
 #include "process_sandbox/cxxsandbox.h"
 #include "process_sandbox/sandbox.h"
 
+#include <chrono>
 #include <stdio.h>
 #include <zlib.h>
 
 using namespace sandbox;
+using namespace std::chrono;
 
 /**
  * The structure that represents an instance of the sandbox.
@@ -17,11 +19,15 @@ struct SandboxZlib
   /**
    * The library that defines the functions exposed by this sandbox.
    */
-  Library lib = {SANDBOX_LIBRARY};
+  Library lib;
 #define EXPORTED_FUNCTION(public_name, private_name) \
   decltype(make_sandboxed_function<decltype(private_name)>(lib)) public_name = \
     make_sandboxed_function<decltype(private_name)>(lib);
 #include "zlib.inc"
+
+  SandboxZlib(SyscallInterposition interposition)
+  : lib(SANDBOX_LIBRARY, 1, 1, interposition)
+  {}
 };
 
 struct UnsandboxedZlib
@@ -125,30 +131,57 @@ void test(ZLib& sandbox, const char* file, std::vector<char>& result)
   close(fd);
 }
 
+/**
+ * Compress `file` in a sandbox that uses `interposition`, printing the time
+ * that it took, and check that the result matches `compressed`.
+ */
+void check(
+  SyscallInterposition interposition,
+  const char* name,
+  const char* file,
+  std::vector<char>& compressed)
+{
+  auto start = steady_clock::now();
+  SandboxZlib sandbox(interposition);
+  std::vector<char> sb_compressed;
+  test(sandbox, file, sb_compressed);
+  auto total = duration_cast<microseconds>(steady_clock::now() - start);
+  printf(
+    "%s: %lld us to start the sandbox and compress\n",
+    name,
+    static_cast<long long>(total.count()));
+  SANDBOX_INVARIANT(
+    sb_compressed.size() == compressed.size(),
+    "Compression in the sandbox gave {} bytes, outside gave {} bytes",
+    sb_compressed.size(),
+    compressed.size());
+  SANDBOX_INVARIANT(
+    sb_compressed == compressed,
+    "Compressing inside and outside of the sandbox gave different results");
+}
+
 int main(int, char** argv)
 {
-  SandboxZlib sandbox;
   UnsandboxedZlib nosb;
-  std::vector<char> sb_compressed;
   std::vector<char> compressed;
   test(nosb, argv[0], compressed);
   try
   {
-    test(sandbox, argv[0], sb_compressed);
+    check(SyscallInterposition::Signal, "signal", argv[0], compressed);
+    if (Library::supports(SyscallInterposition::UserNotification))
+    {
+      check(
+        SyscallInterposition::UserNotification,
+        "user notification",
+        argv[0],
+        compressed);
+    }
   }
   catch (std::runtime_error& e)
   {
     printf("Sandbox exception: %s while running zlib compress\n", e.what());
     return -1;
   }
-  SANDBOX_INVARIANT(
-    sb_compressed.size() == compressed.size(),
-    "Compression in the sandbox gave {} bytes, outside gave {} bytes",
-    sb_compressed.size(),
-    compressed.size());
-  SANDBOX_INVARIANT(
-    sb_compressed == compressed,
-    "Compressing inside and outside of the sandbox gave different results");
 
   return 0;
 }
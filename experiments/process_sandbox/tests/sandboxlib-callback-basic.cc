@@ -12,7 +12,26 @@ int test(int idx)
   return ret;
 }
 
+/**
+ * Make `count` callbacks, each sending a copy of file descriptor `fd` unless
+ * it is -1, and return the number that returned the expected value.  Used to
+ * time the round trip of a callback.
+ */
+int repeat(int idx, int count, int fd)
+{
+  int v = 12;
+  for (int i = 0; i < count; i++)
+  {
+    if (sandbox::invoke_user_callback(idx, &v, sizeof(v), fd) != 42)
+    {
+      return i;
+    }
+  }
+  return count;
+}
+
 extern "C" void sandbox_init()
 {
   sandbox::ExportedLibrary::export_function(::test);
+  sandbox::ExportedLibrary::export_function(::repeat);
 }
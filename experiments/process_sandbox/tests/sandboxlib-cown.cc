@@ -0,0 +1,31 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+#include <thread>
+
+/**
+ * Sleep for `ms` milliseconds, then return `ms`.
+ */
+int sleep_for(int ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  return ms;
+}
+
+/**
+ * Return the sum of the arguments.
+ */
+int add(int a, int b)
+{
+  return a + b;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::sleep_for);
+  sandbox::ExportedLibrary::export_function(::add);
+}
@@ -0,0 +1,42 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Allocate `count` objects of assorted sizes, which grows the heap by many
+ * slabs, fill each with its index, then check and free them all.  Returns
+ * the number of objects that held the expected contents.
+ */
+size_t grow(size_t count)
+{
+  auto** objects = static_cast<unsigned char**>(calloc(count, sizeof(void*)));
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t size = 16 << (i % 9);
+    objects[i] = static_cast<unsigned char*>(malloc(size));
+    memset(objects[i], static_cast<int>(i & 0xff), size);
+  }
+  size_t valid = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t size = 16 << (i % 9);
+    if (
+      (objects[i][0] == (i & 0xff)) && (objects[i][size - 1] == (i & 0xff)))
+    {
+      valid++;
+    }
+    free(objects[i]);
+  }
+  free(objects);
+  return valid;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::grow);
+}
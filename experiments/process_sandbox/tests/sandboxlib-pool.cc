@@ -0,0 +1,19 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+/**
+ * Returns the number of times that this has been called in this sandbox.
+ */
+int count_calls()
+{
+  static int calls = 0;
+  return ++calls;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::count_calls);
+}
@@ -0,0 +1,37 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <cstdint>
+
+/**
+ * Return the sum of `count` values.
+ */
+int64_t sum(const int32_t* values, size_t count)
+{
+  int64_t total = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    total += values[i];
+  }
+  return total;
+}
+
+/**
+ * Negate `count` values in place.
+ */
+void negate(int32_t* values, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    values[i] = -values[i];
+  }
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::sum);
+  sandbox::ExportedLibrary::export_function(::negate);
+}
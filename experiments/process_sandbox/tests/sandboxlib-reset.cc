@@ -0,0 +1,28 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <stdlib.h>
+
+/**
+ * State left in the library by earlier calls.
+ */
+static int calls;
+
+int count_calls()
+{
+  return ++calls;
+}
+
+int crash()
+{
+  abort();
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::count_calls);
+  sandbox::ExportedLibrary::export_function(::crash);
+}
@@ -0,0 +1,32 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+/**
+ * Sum the bytes of a buffer.
+ */
+size_t sum_bytes(const unsigned char* data, size_t size)
+{
+  size_t sum = 0;
+  for (size_t i = 0; i < size; i++)
+  {
+    sum += data[i];
+  }
+  return sum;
+}
+
+/**
+ * Try to write to a buffer, which crashes if it is read-only.
+ */
+void overwrite(unsigned char* data)
+{
+  *static_cast<volatile unsigned char*>(data) = 42;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::sum_bytes);
+  sandbox::ExportedLibrary::export_function(::overwrite);
+}
@@ -0,0 +1,29 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <unistd.h>
+
+/**
+ * Check whether `path` can be read, which is a callback to the parent.
+ */
+int can_read(const char* path)
+{
+  return access(path, R_OK) == 0;
+}
+
+/**
+ * Return `x`, without any callbacks.
+ */
+int identity(int x)
+{
+  return x;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::can_read);
+  sandbox::ExportedLibrary::export_function(::identity);
+}
@@ -0,0 +1,62 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/callback_numbers.h"
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/platform/platform.h"
+#include "process_sandbox/sandbox.h"
+
+#include <memory>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using SyscallFrame = sandbox::platform::SyscallFrame;
+using sandbox::CallbackKind;
+
+/**
+ * Open, stat and check access to `/foo` `iterations` times, with raw system
+ * calls where the platform has them so that libc does not turn them into
+ * callbacks.  Returns the number of calls that succeeded.
+ */
+int churn(int iterations)
+{
+  constexpr int OpenSyscallNo =
+    SyscallFrame::syscall_number<CallbackKind::Open>();
+  constexpr int StatSyscallNo =
+    SyscallFrame::syscall_number<CallbackKind::Stat>();
+  constexpr int AccessSyscallNo =
+    SyscallFrame::syscall_number<CallbackKind::Access>();
+  const char* path = "/foo";
+  // The signal handler forwards only buffers in the shared heap.
+  auto sb = std::make_unique<struct stat>();
+  int succeeded = 0;
+  for (int i = 0; i < iterations; i++)
+  {
+    int fd = (OpenSyscallNo != -1) ? syscall(OpenSyscallNo, path, O_RDONLY) :
+                                     open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+      close(fd);
+      succeeded++;
+    }
+    int ret = (StatSyscallNo != -1) ? syscall(StatSyscallNo, path, sb.get()) :
+                                      stat(path, sb.get());
+    if (ret == 0)
+    {
+      succeeded++;
+    }
+    ret = (AccessSyscallNo != -1) ? syscall(AccessSyscallNo, path, R_OK) :
+                                    access(path, R_OK);
+    if (ret == 0)
+    {
+      succeeded++;
+    }
+  }
+  return succeeded;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::churn);
+}
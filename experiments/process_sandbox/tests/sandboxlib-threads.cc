@@ -0,0 +1,35 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * Wait, for up to ten seconds, until `n` calls are in this function at once.
+ * Returns the number of calls that had arrived.
+ */
+int rendezvous(int n)
+{
+  static std::atomic<int> arrived = 0;
+  int seen = ++arrived;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((seen < n) && (std::chrono::steady_clock::now() < deadline))
+  {
+    seen = arrived.load();
+  }
+  return seen;
+}
+
+int sum(int a, int b)
+{
+  return a + b;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::rendezvous);
+  sandbox::ExportedLibrary::export_function(::sum);
+}
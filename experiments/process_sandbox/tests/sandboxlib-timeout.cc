@@ -0,0 +1,25 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "process_sandbox/cxxsandbox.h"
+#include "process_sandbox/sandbox.h"
+
+#include <chrono>
+
+/**
+ * Busy-wait for `ms` milliseconds, as a hung library would, then return
+ * `ms`.
+ */
+int spin(int ms)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end)
+  {
+  }
+  return ms;
+}
+
+extern "C" void sandbox_init()
+{
+  sandbox::ExportedLibrary::export_function(::spin);
+}
@@ -10,7 +10,12 @@
 #include "compiler/typecheck/permission_check.h"
 #include "compiler/visitor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fmt/ostream.h>
+#include <functional>
+#include <sstream>
+#include <thread>
 
 namespace verona::compiler
 {
@@ -35,9 +40,74 @@ namespace verona::compiler
           visit_assertion(assertion.get());
         }
       }
+
+      run_checks();
     }
 
   private:
+    /**
+     * Run the checks of all methods and static assertions, on as many threads
+     * as the context allows. The checks are independent, except for the
+     * caches of the context, which are thread-safe.
+     *
+     * The diagnostics of each check are buffered, and printed in the order
+     * of the checks once they have all run, so they do not depend on the
+     * number of threads.
+     */
+    void run_checks()
+    {
+      size_t jobs = context_.analysis_jobs();
+      if (jobs == 0)
+        jobs = std::max(std::thread::hardware_concurrency(), 1u);
+
+      // These write to stderr as the checks run, so their output would be
+      // interleaved, and the solver's timings would be skewed.
+      if (context_.has_print_patterns() || context_.print_solver_stats())
+        jobs = 1;
+
+      jobs = std::min(jobs, checks_.size());
+      if (jobs <= 1)
+      {
+        for (const auto& check : checks_)
+        {
+          if (!check())
+            results_->ok = false;
+        }
+        return;
+      }
+
+      std::vector<std::stringstream> diagnostics(checks_.size());
+      std::vector<uint8_t> ok(checks_.size());
+      std::atomic<size_t> next{0};
+      auto worker = [&]() {
+        for (size_t i = next++; i < checks_.size(); i = next++)
+        {
+          SourceManager::set_thread_error_stream(&diagnostics[i]);
+          ok[i] = checks_[i]();
+          SourceManager::set_thread_error_stream(nullptr);
+        }
+      };
+
+      std::vector<std::thread> threads;
+      for (size_t i = 1; i < jobs; i++)
+      {
+        threads.emplace_back(worker);
+      }
+      worker();
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+
+      auto& out = context_.get_error_stream();
+      for (size_t i = 0; i < checks_.size(); i++)
+      {
+        out << diagnostics[i].str();
+        if (!ok[i])
+          results_->ok = false;
+      }
+    }
+
     void visit_entity(Entity* entity)
     {
       visit_members(entity->members);
@@ -45,10 +115,8 @@ namespace verona::compiler
 
     void visit_assertion(StaticAssertion* assertion)
     {
-      if (!check_static_assertion(context_, *assertion))
-      {
-        results_->ok = false;
-      }
+      checks_.push_back(
+        [=]() { return check_static_assertion(context_, *assertion); });
     }
 
     void visit_field(Field* fld) final {}
@@ -96,16 +164,23 @@ namespace verona::compiler
       if (!method->body)
         return;
 
+      // The results are created here, as the map must not change while the
+      // checks run.
+      FnAnalysis* analysis = &results_->functions[method];
+      checks_.push_back([=]() { return check_method(method, *analysis); });
+    }
+
+    /**
+     * Build the IR of a method and type check it. Returns false if the method
+     * is incorrect.
+     */
+    bool check_method(Method* method, FnAnalysis& analysis)
+    {
       if (!check_special_methods(method))
-      {
-        results_->ok = false;
-        return;
-      }
+        return false;
 
       std::string path = method->path();
 
-      FnAnalysis& analysis = results_->functions[method];
-
       analysis.ir = build_ir(*method->signature, *method->body);
       IRPrinter(*context_.dump(path, "ir")).print("IR", *method, *analysis.ir);
 
@@ -127,28 +202,32 @@ namespace verona::compiler
           SourceManager::Diagnostic::InferenceFailedForMethod,
           method->name);
 
-        results_->ok = false;
-        return;
+        return false;
       }
       IRPrinter(*context_.dump(path, "typed-ir"))
         .with_types(*analysis.typecheck)
         .print("Typed IR", *method, *analysis.ir);
 
-      if (!check_permissions(context_, *analysis.ir, *analysis.typecheck))
-      {
-        results_->ok = false;
-      }
+      bool ok = check_permissions(context_, *analysis.ir, *analysis.typecheck);
 
       analysis.region_graphs =
         make_region_graphs(context_, *method, *analysis.typecheck);
 
       CheckRegions(context_, *analysis.typecheck, *analysis.region_graphs)
         .process(*analysis.ir);
+
+      return ok;
     }
 
     Context& context_;
     const Program& program_;
     AnalysisResults* results_;
+
+    /**
+     * The checks of each method and static assertion, in program order. Each
+     * returns false if it failed.
+     */
+    std::vector<std::function<bool()>> checks_;
   };
 
   /**
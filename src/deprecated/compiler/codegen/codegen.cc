@@ -111,7 +111,7 @@ namespace verona::compiler
 
     Reachability reachability = compute_reachability(
       context, program, gen, entry->first, entry->second, analysis);
-    SelectorTable selectors = SelectorTable::build(reachability);
+    SelectorTable selectors = SelectorTable::build(context, reachability);
 
     emit_program_header(program, reachability, selectors, gen, entry->first);
     emit_functions(context, analysis, reachability, selectors, gen);
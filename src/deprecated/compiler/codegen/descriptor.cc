@@ -128,15 +128,7 @@ namespace verona::compiler
       uint32_t method_slots = 0;
       for (const auto& [method, info] : info.methods)
       {
-        TypeList arguments;
-        for (const auto& param : method.definition->signature->generics->types)
-        {
-          arguments.push_back(method.instantiation.types().at(param->index));
-        }
-
-        Selector selector =
-          Selector::method(method.definition->name, arguments);
-        SelectorIdx index = selectors.get(selector);
+        SelectorIdx index = selectors.get(method_selector(method));
         gen.selector(index);
         gen.u32(info.label.value());
         method_slots = std::max((uint32_t)(index.value + 1), method_slots);
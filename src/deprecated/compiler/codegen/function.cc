@@ -46,7 +46,7 @@ namespace verona::compiler
 
   void FunctionGenerator::generate_header(std::string_view name)
   {
-    gen_.str(name);
+    gen_.symbol(name);
     gen_.u8(truncate<uint8_t>(abi_.arguments));
     gen_.u8(truncate<uint8_t>(abi_.returns));
     gen_.u8(frame_size_);
@@ -119,6 +119,7 @@ namespace verona::compiler
         if (!method_info.label.has_value())
           continue;
 
+        Generator::Checkpoint start = gen.checkpoint();
         gen.define_label(method_info.label.value());
         if (method.definition->kind() == Method::Builtin)
         {
@@ -131,6 +132,11 @@ namespace verona::compiler
           emit_function(
             context, reachability, selectors, gen, method, fn_analysis);
         }
+
+        // Instantiations of a generic method often compile to the same
+        // bytecode, since the interpreter represents all values alike. Keep
+        // only the first, under its name.
+        gen.fold(start);
       }
     }
   }
@@ -34,6 +34,13 @@ namespace verona::compiler
     code_.insert(code_.end(), s.data(), s.data() + s.size());
   }
 
+  void Generator::symbol(std::string_view s)
+  {
+    size_t begin = current_offset();
+    str(s);
+    symbols_.push_back({begin, current_offset()});
+  }
+
   void Generator::opcode(bytecode::Opcode opcode)
   {
     u8((uint8_t)opcode);
@@ -132,6 +139,7 @@ namespace verona::compiler
   {
     size_t index = relocatables_.size();
     relocatables_.push_back(std::nullopt);
+    label_order_.push_back(std::nullopt);
     return Relocatable(index);
   }
 
@@ -158,5 +166,114 @@ namespace verona::compiler
   void Generator::define_label(Label label)
   {
     define_relocatable(label, current_offset());
+    label_order_.at(label.relocatable.index) = labels_.size();
+    labels_.push_back(label.relocatable.index);
+  }
+
+  Generator::Checkpoint Generator::checkpoint()
+  {
+    return {
+      current_offset(), relocations_.size(), symbols_.size(), labels_.size()};
+  }
+
+  size_t Generator::strip(const Checkpoint& start, size_t offset)
+  {
+    size_t skipped = 0;
+    for (size_t i = start.symbols; i < symbols_.size(); i++)
+    {
+      auto [begin, end] = symbols_[i];
+      if (end > offset)
+        break;
+      skipped += end - begin;
+    }
+    return offset - start.offset - skipped;
+  }
+
+  size_t Generator::unstrip(const Checkpoint& start, size_t stripped)
+  {
+    // A stripped offset at the start of a symbol maps to before it, which is
+    // where the label of a function is.
+    size_t offset = start.offset;
+    size_t seen = 0;
+    for (size_t i = start.symbols; i < symbols_.size(); i++)
+    {
+      auto [begin, end] = symbols_[i];
+      if (stripped <= seen + (begin - offset))
+        break;
+      seen += begin - offset;
+      offset = end;
+    }
+    return offset + (stripped - seen);
+  }
+
+  std::optional<std::vector<uint8_t>>
+  Generator::fold_key(const Checkpoint& start)
+  {
+    std::vector<uint8_t> key;
+    auto put = [&](uint64_t value) {
+      for (size_t i = 0; i < 64; i += 8)
+        key.push_back((value >> i) & 0xff);
+    };
+
+    size_t offset = start.offset;
+    for (size_t i = start.symbols; i < symbols_.size(); i++)
+    {
+      key.insert(
+        key.end(), code_.begin() + offset, code_.begin() + symbols_[i].first);
+      offset = symbols_[i].second;
+    }
+    key.insert(key.end(), code_.begin() + offset, code_.end());
+
+    for (size_t i = start.relocations; i < relocations_.size(); i++)
+    {
+      const Relocation& rel = relocations_[i];
+      const std::optional<RelocationValue>& slot = relocatables_[rel.index];
+      if (!slot.has_value())
+        return std::nullopt;
+
+      put(strip(start, rel.offset));
+      put(rel.width);
+      put(rel.is_signed);
+
+      // Labels defined in the code are compared by where they are in it,
+      // and so are the offsets that they are relative to. Anything else
+      // must resolve to the same value.
+      const std::optional<size_t>& order = label_order_[rel.index];
+      if (order.has_value() && (*order >= start.labels))
+      {
+        put(1);
+        put(strip(start, *slot));
+        put(rel.relative_to == 0 ? 0 : strip(start, rel.relative_to) + 1);
+      }
+      else
+      {
+        put(0);
+        put(*slot - rel.relative_to);
+      }
+    }
+    return key;
+  }
+
+  bool Generator::fold(const Checkpoint& start)
+  {
+    std::optional<std::vector<uint8_t>> key = fold_key(start);
+    if (!key.has_value())
+      return false;
+
+    auto [it, inserted] = folds_.insert({std::move(*key), start});
+    if (inserted)
+      return false;
+
+    const Checkpoint& copy = it->second;
+    for (size_t i = start.labels; i < labels_.size(); i++)
+    {
+      std::optional<RelocationValue>& slot = relocatables_[labels_[i]];
+      *slot = unstrip(copy, strip(start, *slot));
+    }
+
+    code_.resize(start.offset);
+    relocations_.resize(start.relocations);
+    symbols_.resize(start.symbols);
+    return true;
   }
 }
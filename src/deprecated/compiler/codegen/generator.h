@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <iostream>
+#include <map>
 #include <optional>
 #include <vector>
 
@@ -41,6 +42,8 @@ namespace verona::compiler
    * `define_relocatable` is used once the actual value is known. However
    * relocations are not actually resolved until `finish` is called.
    *
+   * Code written since a `Checkpoint` can be folded into an identical copy
+   * written earlier, using `fold`.
    */
   class Generator
   {
@@ -48,6 +51,17 @@ namespace verona::compiler
     struct Relocatable;
     typedef uint64_t RelocationValue;
 
+    /**
+     * A position in the code, and in the tables of the generator.
+     */
+    struct Checkpoint
+    {
+      size_t offset;
+      size_t relocations;
+      size_t symbols;
+      size_t labels;
+    };
+
     Generator(std::vector<uint8_t>& code) : code_(code) {}
 
     /**
@@ -63,6 +77,12 @@ namespace verona::compiler
      */
     void str(std::string_view s);
 
+    /**
+     * Write the name of a function, in the same format as `str`. Names are
+     * only used for debugging, and `fold` ignores them.
+     */
+    void symbol(std::string_view s);
+
     void opcode(bytecode::Opcode opcode);
     void selector(bytecode::SelectorIdx index);
 
@@ -107,6 +127,25 @@ namespace verona::compiler
      */
     void finish();
 
+    /**
+     * Mark the start of code that may be folded by `fold`.
+     */
+    Checkpoint checkpoint();
+
+    /**
+     * Fold the code written since `start` into an identical copy written
+     * earlier, if there is one, and return whether it did.
+     *
+     * Code is identical if it has the same bytes, other than symbols, and
+     * its relocations resolve to the same values, where labels defined
+     * since `start` are taken relative to it. Folded code is removed, and
+     * the labels it defined are moved to the same places in the copy.
+     * Otherwise the code is kept, and later code may be folded into it.
+     *
+     * The relocatables that the code refers to must be defined by then.
+     */
+    bool fold(const Checkpoint& start);
+
     size_t current_offset()
     {
       return code_.size();
@@ -182,9 +221,43 @@ namespace verona::compiler
       bool is_signed;
     };
 
+    /**
+     * The canonical form of the code since `start`, which is the same for
+     * identical code, see `fold`. Returns nullopt if it refers to an
+     * undefined relocatable.
+     */
+    std::optional<std::vector<uint8_t>> fold_key(const Checkpoint& start);
+
+    /**
+     * The offset of `offset` from `start`, without the symbols in between.
+     */
+    size_t strip(const Checkpoint& start, size_t offset);
+
+    /**
+     * The inverse of `strip`, for code that has not been folded.
+     */
+    size_t unstrip(const Checkpoint& start, size_t stripped);
+
     std::vector<uint8_t>& code_;
     std::vector<std::optional<RelocationValue>> relocatables_;
     std::vector<Relocation> relocations_;
+
+    /**
+     * The ranges of code written by `symbol`, in order.
+     */
+    std::vector<std::pair<size_t, size_t>> symbols_;
+
+    /**
+     * Relocatables defined by `define_label`, in order, and for each
+     * relocatable that is one of them, its index in `labels_`.
+     */
+    std::vector<size_t> labels_;
+    std::vector<std::optional<size_t>> label_order_;
+
+    /**
+     * Code that later code may be folded into, by canonical form.
+     */
+    std::map<std::vector<uint8_t>, Checkpoint> folds_;
   };
 
   /**
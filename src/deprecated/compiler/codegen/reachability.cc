@@ -262,14 +262,7 @@ namespace verona::compiler
       EntityReachability& parent_info = result_.entities.at(parent);
       add_method(parent_info, item);
 
-      TypeList arguments;
-      for (const auto& param : item.definition->signature->generics->types)
-      {
-        arguments.push_back(item.instantiation.types().at(param->index));
-      }
-
-      result_.selectors.insert(
-        Selector::method(item.definition->name, arguments));
+      result_.selectors.insert(method_selector(item));
 
       visit_signature(item.definition->signature->types, item.instantiation);
       visit_generic_bounds(
@@ -676,6 +669,16 @@ namespace verona::compiler
     return v.result_;
   }
 
+  Selector method_selector(const CodegenItem<Method>& method)
+  {
+    TypeList arguments;
+    for (const auto& param : method.definition->signature->generics->types)
+    {
+      arguments.push_back(method.instantiation.types().at(param->index));
+    }
+    return Selector::method(method.definition->name, arguments);
+  }
+
   std::ostream& operator<<(std::ostream& s, const CodegenItem<Method>& item)
   {
     return s << item.definition->instantiated_path(item.instantiation);
@@ -118,6 +118,11 @@ namespace verona::compiler
     CodegenItem<Method> main_method,
     const AnalysisResults& analysis);
 
+  /**
+   * The selector used to call an instantiation of a method.
+   */
+  Selector method_selector(const CodegenItem<Method>& method);
+
   std::ostream& operator<<(std::ostream& s, const CodegenItem<Method>& item);
   std::ostream& operator<<(std::ostream& s, const CodegenItem<Entity>& item);
   std::ostream& operator<<(std::ostream& s, const Selector& selector);
@@ -3,21 +3,136 @@
 #include "compiler/codegen/selector.h"
 
 #include "compiler/codegen/reachability.h"
+#include "compiler/context.h"
+
+#include <algorithm>
+#include <fmt/ostream.h>
+#include <numeric>
 
 namespace verona::compiler
 {
-  SelectorTable SelectorTable::build(const Reachability& reachability)
+  /**
+   * Find, for each selector, the vtables it has a slot in.
+   *
+   * Every class and primitive has two vtables, one for methods and one for
+   * fields, which are numbered 2*i and 2*i+1 for the i-th entity. Interfaces
+   * don't have any.
+   */
+  static std::map<Selector, std::vector<size_t>>
+  find_vtables(const Reachability& reachability)
+  {
+    std::map<Selector, std::vector<size_t>> vtables;
+    for (const auto& selector : reachability.selectors)
+    {
+      vtables[selector];
+    }
+
+    size_t index = 0;
+    for (const auto& [entity, info] : reachability.entities)
+    {
+      size_t methods = 2 * index;
+      size_t fields = 2 * index + 1;
+      index++;
+
+      if (entity.definition->kind->value() == Entity::Interface)
+        continue;
+
+      for (const auto& [method, method_info] : info.methods)
+      {
+        vtables.at(method_selector(method)).push_back(methods);
+      }
+
+      for (const auto& member : entity.definition->members)
+      {
+        if (const Field* fld = member->get_as<Field>())
+          vtables.at(Selector::field(fld->name)).push_back(fields);
+      }
+    }
+
+    return vtables;
+  }
+
+  SelectorTable
+  SelectorTable::build(Context& context, const Reachability& reachability)
   {
     SelectorTable table;
 
+    std::map<Selector, std::vector<size_t>> vtables =
+      find_vtables(reachability);
+
+    // Colour the selectors that appear in the most vtables first, as they
+    // are the most constrained.
+    std::vector<const Selector*> order;
+    for (const auto& [selector, _] : vtables)
+    {
+      order.push_back(&selector);
+    }
+    std::stable_sort(
+      order.begin(), order.end(), [&](const Selector* a, const Selector* b) {
+        return vtables.at(*a).size() > vtables.at(*b).size();
+      });
+
+    // Two selectors may share an index as long as they never appear in the
+    // same vtable. For each vtable, track which indices are taken.
+    std::vector<std::vector<bool>> taken(2 * reachability.entities.size());
+
     using selector_type = bytecode::SelectorIdx::underlying_type;
-    for (const auto& selector : reachability.selectors)
+    for (const Selector* selector : order)
     {
-      size_t index = table.selectors_.size();
+      const std::vector<size_t>& uses = vtables.at(*selector);
+
+      size_t index = 0;
+      while (std::any_of(uses.begin(), uses.end(), [&](size_t vtable) {
+        return index < taken[vtable].size() && taken[vtable][index];
+      }))
+      {
+        index++;
+      }
+
+      for (size_t vtable : uses)
+      {
+        if (taken[vtable].size() <= index)
+          taken[vtable].resize(index + 1);
+        taken[vtable][index] = true;
+      }
+
       assert(index <= std::numeric_limits<selector_type>::max());
       table.selectors_.insert(
-        {selector, bytecode::SelectorIdx(truncate<selector_type>(index))});
+        {*selector, bytecode::SelectorIdx(truncate<selector_type>(index))});
+    }
+
+    // Report the total size of the vtables, compared to giving each selector
+    // its own index.
+    size_t coloured_slots = 0;
+    for (const auto& indices : taken)
+    {
+      coloured_slots += indices.size();
+    }
+
+    std::vector<size_t> uncoloured(taken.size());
+    size_t position = 0;
+    for (const auto& [selector, uses] : vtables)
+    {
+      position++;
+      for (size_t vtable : uses)
+      {
+        uncoloured[vtable] = position;
+      }
     }
+    size_t uncoloured_slots =
+      std::accumulate(uncoloured.begin(), uncoloured.end(), size_t(0));
+
+    auto output = context.dump("selectors");
+    for (const auto& [selector, index] : table.selectors_)
+    {
+      fmt::print(*output, "selector {} {}\n", selector, index.value);
+    }
+    fmt::print(
+      *output,
+      "vtable slots {}, without colouring {}\n",
+      coloured_slots,
+      uncoloured_slots);
+
     return table;
   }
 
@@ -9,6 +9,7 @@
 
 namespace verona::compiler
 {
+  class Context;
   struct Reachability;
 
   /**
@@ -46,13 +47,15 @@ namespace verona::compiler
   /**
    * Mapping from selector to selector index.
    *
-   * For now this is a simple monotonic assignment of indices. Later we'll want
-   * to use selector colouring to reduce vtable sizes.
+   * Indices are assigned by colouring: selectors that never appear in the
+   * same vtable may share an index, which keeps vtables small even when the
+   * program has many selectors.
    */
   class SelectorTable
   {
   public:
-    static SelectorTable build(const Reachability& reachability);
+    static SelectorTable
+    build(Context& context, const Reachability& reachability);
     bytecode::SelectorIdx get(const Selector& selector) const;
 
   private:
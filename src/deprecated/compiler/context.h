@@ -45,6 +45,35 @@ namespace verona::compiler
       print_patterns_.push_back(pattern);
     }
 
+    void set_print_solver_stats(bool enable)
+    {
+      print_solver_stats_ = enable;
+    }
+
+    bool print_solver_stats() const
+    {
+      return print_solver_stats_;
+    }
+
+    bool has_print_patterns() const
+    {
+      return !print_patterns_.empty();
+    }
+
+    /**
+     * Set the number of threads used to type check methods, or 0 to use one
+     * per core.
+     */
+    void set_analysis_jobs(size_t jobs)
+    {
+      analysis_jobs_ = jobs;
+    }
+
+    size_t analysis_jobs() const
+    {
+      return analysis_jobs_;
+    }
+
     void exit(int error_code)
     {
       std::exit(error_code);
@@ -69,6 +98,8 @@ namespace verona::compiler
 
     std::optional<std::string> dump_path_;
     std::vector<std::string> print_patterns_;
+    bool print_solver_stats_ = false;
+    size_t analysis_jobs_ = 0;
   };
 
   /**
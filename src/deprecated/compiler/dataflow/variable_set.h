@@ -4,19 +4,45 @@
 
 #include "compiler/ir/variable.h"
 
-#include <unordered_set>
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
 
 namespace verona::compiler
 {
   /**
    * Set of SSA Variables.
+   *
+   * Variables are numbered densely within a function, so the set is a bitset
+   * over their indices. Operations between two sets work a word at a time.
+   *
+   * Only a few variables carry a LocalID, which is kept to the side. As with
+   * other sets, inserting a variable that is already present keeps the
+   * existing element.
    */
   class VariableSet
   {
+    using Word = uint64_t;
+    static constexpr size_t word_bits = 64;
+
   public:
     void insert(Variable variable)
     {
-      variables_.insert(variable);
+      size_t word = variable.index / word_bits;
+      Word bit = Word(1) << (variable.index % word_bits);
+      if (word >= words_.size())
+        words_.resize(word + 1);
+
+      if (words_[word] & bit)
+        return;
+
+      words_[word] |= bit;
+      size_++;
+      if (variable.lid)
+        lids_.insert({variable.index, *variable.lid});
     }
 
     template<typename T>
@@ -25,12 +51,42 @@ namespace verona::compiler
       static_assert(
         std::is_same_v<typename T::value_type, Variable>,
         "Argument should be a collection of Variables");
-      variables_.insert(others.begin(), others.end());
+      for (Variable v : others)
+      {
+        insert(v);
+      }
+    }
+
+    void insert_all(const VariableSet& others)
+    {
+      // Only variables that are new to this set bring their LocalID.
+      for (const auto& [index, lid] : others.lids_)
+      {
+        if (!contains_index(index))
+          lids_.insert({index, lid});
+      }
+
+      if (others.words_.size() > words_.size())
+        words_.resize(others.words_.size());
+
+      for (size_t i = 0; i < others.words_.size(); i++)
+      {
+        Word added = others.words_[i] & ~words_[i];
+        words_[i] |= added;
+        size_ += count(added);
+      }
     }
 
     void remove(Variable variable)
     {
-      variables_.erase(variable);
+      size_t word = variable.index / word_bits;
+      Word bit = Word(1) << (variable.index % word_bits);
+      if (word >= words_.size() || !(words_[word] & bit))
+        return;
+
+      words_[word] &= ~bit;
+      size_--;
+      lids_.erase(variable.index);
     }
 
     template<typename T>
@@ -41,41 +97,155 @@ namespace verona::compiler
         "Argument should be a collection of Variables");
       for (Variable v : others)
       {
-        variables_.erase(v);
+        remove(v);
+      }
+    }
+
+    void remove_all(const VariableSet& others)
+    {
+      size_t common = std::min(words_.size(), others.words_.size());
+      bool removed_any = false;
+      for (size_t i = 0; i < common; i++)
+      {
+        Word removed = words_[i] & others.words_[i];
+        if (!removed)
+          continue;
+
+        words_[i] &= ~removed;
+        size_ -= count(removed);
+        removed_any = true;
+      }
+
+      if (removed_any && !lids_.empty())
+      {
+        for (auto it = lids_.begin(); it != lids_.end();)
+        {
+          if (contains_index(it->first))
+            it++;
+          else
+            it = lids_.erase(it);
+        }
       }
     }
 
     bool contains(Variable element) const
     {
-      return variables_.find(element) != variables_.end();
+      return contains_index(element.index);
     }
 
     size_t size() const
     {
-      return variables_.size();
+      return size_;
     }
 
     bool empty() const
     {
-      return variables_.empty();
+      return size_ == 0;
     }
 
-    // VariableSet is iterable, piggybacking on the unordered_set's iterator
-    // implementation.
+    /**
+     * Iterates over the variables in the set, in order of their indices.
+     */
+    class const_iterator
+    {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Variable;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Variable*;
+      using reference = Variable;
+
+      Variable operator*() const
+      {
+        Variable variable{index_};
+        if (auto it = set_->lids_.find(index_); it != set_->lids_.end())
+          variable.lid = it->second;
+        return variable;
+      }
+
+      const_iterator& operator++()
+      {
+        index_ = set_->next(index_ + 1);
+        return *this;
+      }
+
+      const_iterator operator++(int)
+      {
+        const_iterator result = *this;
+        ++*this;
+        return result;
+      }
+
+      bool operator==(const const_iterator& other) const
+      {
+        return index_ == other.index_;
+      }
+
+      bool operator!=(const const_iterator& other) const
+      {
+        return index_ != other.index_;
+      }
+
+    private:
+      friend VariableSet;
+
+      const_iterator(const VariableSet* set, uint64_t index)
+      : set_(set), index_(index)
+      {}
+
+      const VariableSet* set_;
+      uint64_t index_;
+    };
+
     using value_type = Variable;
-    using const_iterator = std::unordered_set<Variable>::const_iterator;
 
     const_iterator begin() const
     {
-      return variables_.begin();
+      return const_iterator(this, next(0));
     }
     const_iterator end() const
     {
-      return variables_.end();
+      return const_iterator(this, words_.size() * word_bits);
     }
 
   private:
-    // TODO: This should be replaced by a bitset, using the variable indices.
-    std::unordered_set<Variable> variables_;
+    static size_t count(Word word)
+    {
+      return std::bitset<word_bits>(word).count();
+    }
+
+    bool contains_index(uint64_t index) const
+    {
+      size_t word = index / word_bits;
+      return (word < words_.size()) &&
+        ((words_[word] >> (index % word_bits)) & 1);
+    }
+
+    /**
+     * Returns the first index in the set that is at least `index`, or the end
+     * index if there isn't one.
+     */
+    uint64_t next(uint64_t index) const
+    {
+      size_t word = index / word_bits;
+      if (word >= words_.size())
+        return words_.size() * word_bits;
+
+      // Skip the bits below `index` in its word, then whole empty words.
+      Word bits = words_[word] & (~Word(0) << (index % word_bits));
+      while (!bits)
+      {
+        if (++word == words_.size())
+          return words_.size() * word_bits;
+        bits = words_[word];
+      }
+
+      // The number of trailing zeros is the offset of the lowest bit.
+      return word * word_bits + count((bits & (~bits + 1)) - 1);
+    }
+
+    std::vector<Word> words_;
+    size_t size_ = 0;
+    std::unordered_map<uint64_t, LocalID> lids_;
   };
 }
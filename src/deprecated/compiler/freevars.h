@@ -4,6 +4,7 @@
 
 #include "compiler/type_visitor.h"
 
+#include <shared_mutex>
 #include <unordered_map>
 
 namespace verona::compiler
@@ -95,12 +96,19 @@ namespace verona::compiler
   public:
     const FreeVariables& free_variables(const TypePtr& type)
     {
-      auto it = cache_.insert({type, FreeVariables()});
-      if (it.second)
       {
-        it.first->second = visit_type(type);
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = cache_.find(type);
+        if (it != cache_.end())
+          return it->second;
       }
-      return it.first->second;
+
+      // The lock is not held while visiting, since that looks up the free
+      // variables of the children. References to the cache's elements stay
+      // valid as it grows.
+      FreeVariables result = visit_type(type);
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      return cache_.insert({type, std::move(result)}).first->second;
     }
 
   private:
@@ -302,6 +310,11 @@ namespace verona::compiler
       }
     }
 
+    /**
+     * Guards the cache, which is shared by the threads that type check
+     * methods.
+     */
+    std::shared_mutex mutex_;
     std::unordered_map<TypePtr, FreeVariables> cache_;
   };
 }
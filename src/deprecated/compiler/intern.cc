@@ -1027,8 +1027,9 @@ namespace verona::compiler
     if (!ty)
       return false;
 
-    auto it = types_.find(ty);
-    return it != types_.end() && *it == ty;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Slot& slot = types_[find_slot(*ty, HashTypes()(*ty))];
+    return slot.type == ty;
   }
 
   bool TypeInterner::is_interned(const TypeList& tys)
@@ -1054,28 +1055,74 @@ namespace verona::compiler
   template<typename T>
   std::shared_ptr<const T> TypeInterner::intern(T value)
   {
-    // We split the lookup and insert steps, avoiding the allocation of the
-    // shared_ptr if the lookup succeeds. To avoid searching the map twice,
-    // we use lower_bound to perform the lookup, giving us a hint on where
-    // to insert even if the lookup fails.
-    // <Some rant about how unergonomic C++ containers are>
+    // The shared_ptr is only allocated if the lookup fails.
+    size_t hash = HashTypes()(value);
+    TypePtr result;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      result = types_[find_slot(value, hash)].type;
+    }
 
-    // After lower_bound, one of these must hold:
-    // - `it` is `types_.end()`
-    // - `*it` is strictly greater than `value`
-    // - `*it` is equal to `value`
-    // In the first two cases, value is not in the map, so we insert it.
-    auto it = types_.lower_bound(value);
-    if (it == types_.end() || LessTypes()(value, *it))
+    if (!result)
     {
-      it = types_.emplace_hint(it, std::make_shared<T>(value));
+      // Another thread may have interned the type since the lookup, so it is
+      // repeated under the exclusive lock.
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      size_t index = find_slot(value, hash);
+      if (!types_[index].type)
+      {
+        if (2 * (count_ + 1) > types_.size())
+        {
+          grow();
+          index = find_slot(value, hash);
+        }
+
+        types_[index] = {hash, std::make_shared<T>(value)};
+        count_++;
+      }
+      result = types_[index].type;
     }
 
-    assert(!LessTypes()(*it, value) && !LessTypes()(value, *it));
+    assert(!LessTypes()(*result, value) && !LessTypes()(value, *result));
 
-    // At this point, `*it` is equal to `value`, making the cast to a
+    // At this point, `result` is equal to `value`, making the cast to a
     // shared_ptr<T> safe.
-    return std::static_pointer_cast<const T>(*it);
+    return std::static_pointer_cast<const T>(result);
+  }
+
+  size_t TypeInterner::find_slot(const Type& value, size_t hash) const
+  {
+    LessTypes less;
+    size_t mask = types_.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask)
+    {
+      const Slot& slot = types_[index];
+      if (!slot.type)
+        return index;
+
+      if (
+        slot.hash == hash && !less(*slot.type, value) &&
+        !less(value, *slot.type))
+        return index;
+    }
+  }
+
+  void TypeInterner::grow()
+  {
+    std::vector<Slot> old(types_.size() * 2);
+    std::swap(old, types_);
+
+    size_t mask = types_.size() - 1;
+    for (Slot& slot : old)
+    {
+      if (!slot.type)
+        continue;
+
+      size_t index = slot.hash & mask;
+      while (types_[index].type)
+        index = (index + 1) & mask;
+      types_[index] = std::move(slot);
+    }
   }
 
   /**
@@ -1141,21 +1188,285 @@ namespace verona::compiler
     InternalError::print("TypeInterner dispatch failed on {}\n", info.name());
   }
 
-  bool TypeInterner::LessTypes::operator()(
-    const TypePtr& left, const TypePtr& right) const
+  namespace
   {
-    return (*this)(*left, *right);
+    /**
+     * Hashing of the fields of types, consistent with their operator<.
+     *
+     * Fields that are hard to hash, such as a VariableRenaming, are left out.
+     * This only costs some collisions, as the interner still compares the
+     * types themselves.
+     */
+    void combine(size_t& seed, size_t value)
+    {
+      seed ^= value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+    }
+
+    template<typename T>
+    size_t hash_field(const T& value)
+    {
+      return std::hash<T>()(value);
+    }
+
+    template<typename T>
+    size_t hash_field(const std::shared_ptr<T>& value)
+    {
+      return std::hash<const void*>()(value.get());
+    }
+
+    size_t hash_field(const Variable& value)
+    {
+      return std::hash<uint64_t>()(value.index);
+    }
+
+    size_t hash_field(const VariableRenaming& value)
+    {
+      return 0;
+    }
+
+    template<typename T>
+    size_t hash_field(const std::optional<T>& value)
+    {
+      return value ? hash_field(*value) + 1 : 0;
+    }
+
+    template<typename T, typename U>
+    size_t hash_field(const std::pair<T, U>& value)
+    {
+      size_t seed = hash_field(value.first);
+      combine(seed, hash_field(value.second));
+      return seed;
+    }
+
+    template<typename T>
+    size_t hash_elements(const T& collection)
+    {
+      size_t seed = collection.size();
+      for (const auto& element : collection)
+      {
+        combine(seed, hash_field(element));
+      }
+      return seed;
+    }
+
+    template<typename T>
+    size_t hash_field(const std::vector<T>& value)
+    {
+      return hash_elements(value);
+    }
+
+    template<typename T>
+    size_t hash_field(const std::set<T>& value)
+    {
+      return hash_elements(value);
+    }
+
+    template<typename K, typename V>
+    size_t hash_field(const std::map<K, V>& value)
+    {
+      return hash_elements(value);
+    }
+
+    size_t hash_field(const Region& value)
+    {
+      size_t seed = value.index();
+      if (auto variable = std::get_if<RegionVariable>(&value))
+        combine(seed, hash_field(variable->variable));
+      else if (auto parameter = std::get_if<RegionParameter>(&value))
+        combine(seed, parameter->index);
+      else if (auto external = std::get_if<RegionExternal>(&value))
+        combine(seed, external->index);
+      return seed;
+    }
+
+    size_t hash_field(const InferableTypeSequence& value)
+    {
+      size_t seed = value.index();
+      if (auto bounded = std::get_if<BoundedTypeSequence>(&value))
+        combine(seed, hash_field(bounded->types));
+      else if (auto unbounded = std::get_if<UnboundedTypeSequence>(&value))
+        combine(seed, unbounded->index);
+      return seed;
+    }
+
+    size_t hash_field(const TypeSignature& value)
+    {
+      size_t seed = hash_field(value.receiver);
+      combine(seed, hash_field(value.arguments));
+      combine(seed, hash_field(value.return_type));
+      return seed;
+    }
+
+    template<typename... Args>
+    size_t hash_fields(const Args&... fields)
+    {
+      size_t seed = 0;
+      (combine(seed, hash_field(fields)), ...);
+      return seed;
+    }
+
+    size_t hash_type(const ApplyRegionType& t)
+    {
+      return hash_fields(t.mode, t.region, t.type);
+    }
+
+    size_t hash_type(const CapabilityType& t)
+    {
+      return hash_fields(t.kind, t.region);
+    }
+
+    size_t hash_type(const DelayedFieldViewType& t)
+    {
+      return hash_fields(t.name, t.type);
+    }
+
+    size_t hash_type(const EntityOfType& t)
+    {
+      return hash_fields(t.inner);
+    }
+
+    size_t hash_type(const EntityType& t)
+    {
+      return hash_fields(t.definition, t.arguments);
+    }
+
+    size_t hash_type(const FixpointType& t)
+    {
+      return hash_fields(t.inner);
+    }
+
+    size_t hash_type(const FixpointVariableType& t)
+    {
+      return hash_fields(t.depth);
+    }
+
+    size_t hash_type(const HasAppliedMethodType& t)
+    {
+      return hash_fields(t.name, t.application, t.signature);
+    }
+
+    size_t hash_type(const HasFieldType& t)
+    {
+      return hash_fields(t.view, t.name, t.read_type, t.write_type);
+    }
+
+    size_t hash_type(const HasMethodType& t)
+    {
+      return hash_fields(t.name, t.signature);
+    }
+
+    size_t hash_type(const IndirectType& t)
+    {
+      return hash_fields(t.block, t.variable);
+    }
+
+    size_t hash_type(const InferType& t)
+    {
+      return hash_fields(t.index, t.subindex, t.polarity);
+    }
+
+    size_t hash_type(const IntersectionType& t)
+    {
+      return hash_fields(t.elements);
+    }
+
+    size_t hash_type(const IsEntityType& t)
+    {
+      return 0;
+    }
+
+    size_t hash_type(const NotChildOfType& t)
+    {
+      return hash_fields(t.region);
+    }
+
+    size_t hash_type(const PathCompressionType& t)
+    {
+      return hash_fields(t.compression, t.type);
+    }
+
+    size_t hash_type(const RangeType& t)
+    {
+      return hash_fields(t.lower, t.upper);
+    }
+
+    size_t hash_type(const StaticType& t)
+    {
+      return hash_fields(t.definition, t.arguments);
+    }
+
+    size_t hash_type(const TypeParameter& t)
+    {
+      return hash_fields(t.definition, t.expanded);
+    }
+
+    size_t hash_type(const UnapplyRegionType& t)
+    {
+      return hash_fields(t.type);
+    }
+
+    size_t hash_type(const UnionType& t)
+    {
+      return hash_fields(t.elements);
+    }
+
+    size_t hash_type(const UnitType& t)
+    {
+      return 0;
+    }
+
+    size_t hash_type(const VariableRenamingType& t)
+    {
+      return hash_fields(t.renaming, t.type);
+    }
+
+    size_t hash_type(const ViewpointType& t)
+    {
+      return hash_fields(t.capability, t.variables, t.right);
+    }
   }
 
-  bool TypeInterner::LessTypes::operator()(
-    const TypePtr& left, const Type& right) const
+  /**
+   * Shallow by-value hash of arbitrary types, which mixes in the kind of
+   * type so that different kinds with the same fields don't collide.
+   */
+  size_t TypeInterner::HashTypes::operator()(const Type& type) const
   {
-    return (*this)(*left, right);
+    const std::type_info& info = typeid(type);
+    size_t seed = info.hash_code();
+
+#define DISPATCH(ty) \
+  if (info == typeid(ty)) \
+  { \
+    combine(seed, hash_type(static_cast<const ty&>(type))); \
+    return seed; \
   }
+    DISPATCH(ApplyRegionType);
+    DISPATCH(CapabilityType);
+    DISPATCH(DelayedFieldViewType);
+    DISPATCH(EntityOfType);
+    DISPATCH(EntityType);
+    DISPATCH(FixpointType);
+    DISPATCH(FixpointVariableType);
+    DISPATCH(HasAppliedMethodType);
+    DISPATCH(HasFieldType);
+    DISPATCH(HasMethodType);
+    DISPATCH(IndirectType);
+    DISPATCH(InferType);
+    DISPATCH(IntersectionType);
+    DISPATCH(IsEntityType);
+    DISPATCH(NotChildOfType);
+    DISPATCH(PathCompressionType);
+    DISPATCH(RangeType);
+    DISPATCH(StaticType);
+    DISPATCH(TypeParameter);
+    DISPATCH(UnapplyRegionType);
+    DISPATCH(UnionType);
+    DISPATCH(UnitType);
+    DISPATCH(VariableRenamingType);
+    DISPATCH(ViewpointType);
+#undef DISPATCH
 
-  bool TypeInterner::LessTypes::operator()(
-    const Type& left, const TypePtr& right) const
-  {
-    return (*this)(left, *right);
+    InternalError::print("TypeInterner dispatch failed on {}\n", info.name());
   }
 }
@@ -7,15 +7,17 @@
 #include <algorithm>
 #include <optional>
 #include <set>
+#include <shared_mutex>
+#include <vector>
 
 /**
  * Type interner.
  *
  * To allow for fast equality checks between two Type objects, we intern all of
- * them in a single TypeInterner. The interner uses shallow comparison, through
- * the operator< method defined by each kind of Type, to check if a type had
- * already been interned. After interning, comparison and hashing can be done
- * directly on the pointer value.
+ * them in a single TypeInterner. The interner uses a shallow hash and shallow
+ * comparison, through the operator< method defined by each kind of Type, to
+ * check if a type had already been interned. After interning, comparison and
+ * hashing can be done directly on the pointer value.
  *
  * Type objects are never created manually. The various mk_* methods of the
  * interner should be used instead.
@@ -30,6 +32,9 @@
  *
  * All mk_ methods require their arguments to already be normalized. This is
  * enforced with debug-mode assertions.
+ *
+ * The interner may be used from several threads at once, as methods are type
+ * checked in parallel.
  */
 namespace verona::compiler
 {
@@ -139,25 +144,32 @@ namespace verona::compiler
 
     /**
      * Shallow by-value comparison of types.
-     *
-     * The set contains shared_ptr<Type>, but we don't want to allocate a
-     * shared_ptr everytime we lookup something. For this we make LessTypes
-     * a "transparent functor", allowing heterogenous lookup into the
-     * interning set.
-     *
      */
     struct LessTypes
     {
-      using is_transparent = void;
-
-      // Main comparison operator. We define the others in term of this one.
       bool operator()(const Type& left, const Type& right) const;
+    };
 
-      bool operator()(const TypePtr& left, const TypePtr& right) const;
-      bool operator()(const TypePtr& left, const Type& right) const;
-      bool operator()(const Type& left, const TypePtr& right) const;
+    /**
+     * Shallow by-value hash of types, consistent with LessTypes. Child types
+     * are already interned, so they are hashed by address.
+     */
+    struct HashTypes
+    {
+      size_t operator()(const Type& type) const;
     };
 
+    /**
+     * Returns the slot of the interning table that holds a type equal to
+     * `value`, or the empty slot where it would go.
+     */
+    size_t find_slot(const Type& value, size_t hash) const;
+
+    /**
+     * Doubles the size of the interning table.
+     */
+    void grow();
+
     TypePtr unfold_compression(
       const PathCompressionMap& compression,
       const Region& region,
@@ -165,6 +177,25 @@ namespace verona::compiler
     TypePtr unfold_compression(
       PathCompressionMap compression, Variable dead_variable, TypePtr type);
 
-    std::set<TypePtr, LessTypes> types_;
+    /**
+     * Interned types, in an open-addressing table with linear probing. The
+     * hash of each type is kept alongside it, so that growing the table and
+     * probing past other types never needs to look at them.
+     *
+     * The table's size is always a power of two, and it is at most half full.
+     */
+    struct Slot
+    {
+      size_t hash = 0;
+      TypePtr type;
+    };
+    std::vector<Slot> types_ = std::vector<Slot>(1024);
+    size_t count_ = 0;
+
+    /**
+     * Guards the interning table. Lookups of types that are already interned
+     * only take it shared.
+     */
+    mutable std::shared_mutex mutex_;
   };
 }
@@ -60,6 +60,8 @@ namespace verona::compiler
 
     bool enable_builtin = true;
     bool enable_colors = true;
+    bool solver_stats = false;
+    size_t jobs = 0;
   };
 
   /**
@@ -68,6 +70,8 @@ namespace verona::compiler
   void setup_context(Context& context, const Options& options)
   {
     context.set_enable_colored_diagnostics(options.enable_colors);
+    context.set_print_solver_stats(options.solver_stats);
+    context.set_analysis_jobs(options.jobs);
     if (options.dump_path)
     {
       context.set_dump_path(*options.dump_path);
@@ -249,6 +253,14 @@ int main(int argc, const char** argv)
   app.add_option("--print", options.print_patterns);
   app.add_flag("--disable-colors{false}", options.enable_colors);
   app.add_flag("--disable-builtin{false}", options.enable_builtin);
+  app.add_flag(
+    "--solver-stats",
+    options.solver_stats,
+    "Print the work and time taken to type check each method");
+  app.add_option(
+    "--jobs",
+    options.jobs,
+    "Number of threads used to type check methods, or 0 for one per core");
 
   verona::interpreter::add_arguments(app, options, "run");
 
@@ -14,26 +14,26 @@ namespace verona::compiler
     auto& cache =
       polarity == Polarity::Positive ? positive_cache_ : negative_cache_;
 
-    auto it = cache.find(type);
-    if (it != cache.end())
     {
-      return it->second;
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      auto it = cache.find(type);
+      if (it != cache.end())
+        return it->second;
     }
-    else
-    {
-      TypePtr normalized = visit_type(type, polarity);
-      TypePtr repeat = visit_type(normalized, polarity);
 
-      if (normalized != repeat)
-      {
-        InternalError::print(
-          "Not idempotent for\n{}\n{}\n{}\n", *type, *normalized, *repeat);
-      }
+    TypePtr normalized = visit_type(type, polarity);
+    TypePtr repeat = visit_type(normalized, polarity);
 
-      cache.insert({type, normalized});
-      cache.insert({normalized, normalized});
-      return normalized;
+    if (normalized != repeat)
+    {
+      InternalError::print(
+        "Not idempotent for\n{}\n{}\n{}\n", *type, *normalized, *repeat);
     }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    cache.insert({type, normalized});
+    cache.insert({normalized, normalized});
+    return normalized;
   }
 
   TypePtr Polarizer::visit_base_type(const TypePtr& ty, Polarity polarity)
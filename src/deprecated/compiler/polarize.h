@@ -6,6 +6,8 @@
 #include "compiler/mapper.h"
 #include "compiler/visitor.h"
 
+#include <shared_mutex>
+
 namespace verona::compiler
 {
   /**
@@ -102,6 +104,12 @@ namespace verona::compiler
 
     Context& context_;
 
+    /**
+     * Guards the caches, which are shared by the threads that type check
+     * methods. It is not held while normalizing a type, so two threads may
+     * normalize the same one, but they reach the same result.
+     */
+    std::shared_mutex mutex_;
     std::unordered_map<TypePtr, TypePtr> positive_cache_;
     std::unordered_map<TypePtr, TypePtr> negative_cache_;
   };
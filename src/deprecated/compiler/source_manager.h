@@ -4,6 +4,7 @@
 #include "ds/helpers.h"
 
 #include <array>
+#include <atomic>
 #include <climits>
 #include <fmt/color.h>
 #include <fmt/core.h>
@@ -19,6 +20,7 @@ namespace verona::compiler
   {
   private:
     std::unique_ptr<std::ostream> _error_stream;
+    static inline thread_local std::ostream* thread_error_stream = nullptr;
 
   public:
     void set_error_stream(std::unique_ptr<std::ostream> out)
@@ -28,7 +30,11 @@ namespace verona::compiler
 
     std::ostream& get_error_stream()
     {
-      if (_error_stream == nullptr)
+      if (thread_error_stream != nullptr)
+      {
+        return *thread_error_stream;
+      }
+      else if (_error_stream == nullptr)
       {
         return std::cerr;
       }
@@ -43,6 +49,17 @@ namespace verona::compiler
       return _error_stream != nullptr;
     }
 
+    /**
+     * Send the diagnostics printed by the current thread to `out`, rather
+     * than to the error stream, until this is called again with `nullptr`.
+     * This lets diagnostics printed in parallel be buffered, and copied to
+     * the error stream in a deterministic order.
+     */
+    static void set_thread_error_stream(std::ostream* out)
+    {
+      thread_error_stream = out;
+    }
+
     /**
      * Location in the source file.  This is an opaque value that can be
      * translated back to a source address by the context.
@@ -893,12 +910,13 @@ namespace verona::compiler
     /**
      * Number of diagnostics generated of each kind.
      */
-    std::array<int, NumberOfDiagnosticKinds> diagnostics_count = {0};
+    std::array<std::atomic<int>, NumberOfDiagnosticKinds> diagnostics_count =
+      {};
 
     /**
      * Returns the counter associated with a diagnostic kind.
      */
-    int& diagnostic_counter(DiagnosticKind k)
+    std::atomic<int>& diagnostic_counter(DiagnosticKind k)
     {
       return diagnostics_count.at(static_cast<int>(k));
     }
@@ -128,10 +128,20 @@ namespace verona::compiler
 
   Solver::SolutionSet Solver::solve_one(Constraint initial, SolverMode mode)
   {
+    auto [it, inserted] =
+      cache_.try_emplace(std::make_pair(initial, mode), SolutionSet());
+    if (!inserted)
+    {
+      fmt::print(output_, "  cached, {} solutions\n", it->second.size());
+      cache_hits_++;
+      return it->second;
+    }
+
     SolutionSet solutions;
 
     std::vector<SolverState> state_stack;
     state_stack.emplace_back(SolverState({initial}));
+    total_states_++;
 
     while (!state_stack.empty())
     {
@@ -176,6 +186,7 @@ namespace verona::compiler
         solution.value());
     }
 
+    it->second = solutions;
     return solutions;
   }
 
@@ -239,11 +250,19 @@ namespace verona::compiler
     state_stack->pop_back();
 
     trace(state, " with backtracking ", solution.subconstraints.size());
+
+    // Alternatives with the same constraint lead to identical states, so
+    // only explore the first of them.
+    std::set<Constraint> seen;
     for (const Constraint& subconstraint : solution.subconstraints)
     {
+      if (!seen.insert(subconstraint).second)
+        continue;
+
       SolverState substate = state;
       substate.add_constraint(subconstraint);
       state_stack->push_back(substate);
+      total_states_++;
     }
   }
 
@@ -4,6 +4,8 @@
 
 #include "compiler/typecheck/constraint.h"
 
+#include <map>
+
 namespace verona::compiler
 {
   struct SolverState;
@@ -31,6 +33,19 @@ namespace verona::compiler
     SolutionSet solve_one(Constraint constraints, SolverMode mode);
     void print_stats(const SolutionSet& solutions);
 
+    uint64_t total_steps() const
+    {
+      return total_steps_;
+    }
+    uint64_t total_states() const
+    {
+      return total_states_;
+    }
+    uint64_t cache_hits() const
+    {
+      return cache_hits_;
+    }
+
   private:
     void apply_solution(
       const Constraint& constraint,
@@ -53,6 +68,16 @@ namespace verona::compiler
     void trace(const SolverState& state, const Args&... args);
 
     uint64_t total_steps_ = 0;
+    uint64_t total_states_ = 0;
+    uint64_t cache_hits_ = 0;
+
+    /**
+     * Solutions of the constraints passed to solve_one. These only depend on
+     * the constraint and the mode, as each search starts without any
+     * assumptions, and solve_all often asks for the same constraint again
+     * under different partial solutions.
+     */
+    std::map<std::pair<Constraint, SolverMode>, SolutionSet> cache_;
     Context& context_;
     std::ostream& output_;
   };
@@ -8,7 +8,9 @@
 #include "compiler/typecheck/solver.h"
 #include "compiler/zip.h"
 
+#include <chrono>
 #include <fmt/ostream.h>
+#include <iostream>
 
 namespace verona::compiler
 {
@@ -52,11 +54,26 @@ namespace verona::compiler
     auto output = context.dump(path, "solver");
     *output << "Solver trace for " << path << ":" << std::endl;
 
+    auto start = std::chrono::steady_clock::now();
     Solver solver(context, *output);
     Solver::SolutionSet solutions =
       solver.solve_all(inference.constraints, SolverMode::Infer);
     solver.print_stats(solutions);
 
+    if (context.print_solver_stats())
+    {
+      std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - start;
+      fmt::print(
+        std::cerr,
+        "Solver stats for {}: {} states, {} steps, {} cache hits, {:.3f}ms\n",
+        path,
+        solver.total_states(),
+        solver.total_steps(),
+        solver.cache_hits(),
+        time.count());
+    }
+
     *output << "\n";
 
     dump_solutions(context, method, solutions);
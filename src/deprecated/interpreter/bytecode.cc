@@ -8,6 +8,106 @@
 
 namespace verona::bytecode
 {
+  std::ostream& operator<<(std::ostream& out, const Opcode& self)
+  {
+    switch (self)
+    {
+      case Opcode::BinOp:
+        fmt::print(out, "BINOP");
+        break;
+      case Opcode::Call:
+        fmt::print(out, "CALL");
+        break;
+      case Opcode::Clear:
+        fmt::print(out, "CLEAR");
+        break;
+      case Opcode::ClearList:
+        fmt::print(out, "CLEAR_LIST");
+        break;
+      case Opcode::Copy:
+        fmt::print(out, "COPY");
+        break;
+      case Opcode::FulfillSleepingCown:
+        fmt::print(out, "FULFILL");
+        break;
+      case Opcode::Freeze:
+        fmt::print(out, "FREEZE");
+        break;
+      case Opcode::Int64:
+        fmt::print(out, "INT64");
+        break;
+      case Opcode::String:
+        fmt::print(out, "STRING");
+        break;
+      case Opcode::Jump:
+        fmt::print(out, "JUMP");
+        break;
+      case Opcode::JumpIf:
+        fmt::print(out, "JUMP_IF");
+        break;
+      case Opcode::Load:
+        fmt::print(out, "LOAD");
+        break;
+      case Opcode::LoadDescriptor:
+        fmt::print(out, "LOAD_DESCRIPTOR");
+        break;
+      case Opcode::MatchCapability:
+        fmt::print(out, "MATCH_CAPABILITY");
+        break;
+      case Opcode::MatchDescriptor:
+        fmt::print(out, "MATCH_DESCRIPTOR");
+        break;
+      case Opcode::Merge:
+        fmt::print(out, "MERGE");
+        break;
+      case Opcode::Move:
+        fmt::print(out, "MOVE");
+        break;
+      case Opcode::MutView:
+        fmt::print(out, "MUT_VIEW");
+        break;
+      case Opcode::NewObject:
+        fmt::print(out, "NEW_OBJECT");
+        break;
+      case Opcode::NewCown:
+        fmt::print(out, "NEW_COWN");
+        break;
+      case Opcode::NewRegion:
+        fmt::print(out, "NEW_REGION");
+        break;
+      case Opcode::NewSleepingCown:
+        fmt::print(out, "NEW_SLEEPING_COWN");
+        break;
+      case Opcode::Print:
+        fmt::print(out, "PRINT");
+        break;
+      case Opcode::Protect:
+        fmt::print(out, "PROTECT");
+        break;
+      case Opcode::Return:
+        fmt::print(out, "RETURN");
+        break;
+      case Opcode::Store:
+        fmt::print(out, "STORE");
+        break;
+      case Opcode::TraceRegion:
+        fmt::print(out, "TRACE_REGION");
+        break;
+      case Opcode::Unprotect:
+        fmt::print(out, "UNPROTECT");
+        break;
+      case Opcode::Unreachable:
+        fmt::print(out, "UNREACHABLE");
+        break;
+      case Opcode::When:
+        fmt::print(out, "WHEN");
+        break;
+
+        EXHAUSTIVE_SWITCH;
+    }
+    return out;
+  }
+
   std::ostream& operator<<(std::ostream& out, const BinaryOperator& self)
   {
     switch (self)
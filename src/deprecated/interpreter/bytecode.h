@@ -555,6 +555,7 @@ namespace verona::bytecode
     constexpr static std::string_view format = "UNREACHABLE";
   };
 
+  std::ostream& operator<<(std::ostream& out, const Opcode& self);
   std::ostream& operator<<(std::ostream& out, const BinaryOperator& self);
   std::ostream& operator<<(std::ostream& out, const Capability& self);
 
@@ -32,6 +32,14 @@ namespace verona::interpreter
   class Code
   {
   public:
+    /**
+     * Size of the bytecode, in bytes.
+     */
+    size_t size() const
+    {
+      return data_.size();
+    }
+
     void check(size_t ip, size_t len) const
     {
       if ((ip + len) > data_.size())
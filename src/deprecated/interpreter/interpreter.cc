@@ -28,8 +28,13 @@ namespace verona::interpreter
     EmptyCown() {}
   };
 
-  void
-  instantiate(size_t cores, const Code& code, bool verbose, size_t seed = 1234)
+  void instantiate(
+    size_t cores,
+    const Code& code,
+    bool verbose,
+    OpcodeProfile* profile,
+    CallProfile* calls,
+    size_t seed = 1234)
   {
 #ifdef USE_SYSTEMATIC_TESTING
     verona::rt::Systematic::set_seed(seed);
@@ -53,13 +58,21 @@ namespace verona::interpreter
     rt::Alloc& alloc = rt::ThreadAlloc::get();
     rt::Cown::release(alloc, cown);
 
-    sched.run_with_startup<const Code*, bool>(VM::init_vm, &code, verbose);
+    sched.run_with_startup<const Code*, bool, OpcodeProfile*, CallProfile*>(
+      VM::init_vm, &code, verbose, profile, calls);
 
     snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
   }
 
   void instantiate(InterpreterOptions& options, const Code& code)
   {
+    std::unique_ptr<OpcodeProfile> profile;
+    if (options.profile_opcodes)
+      profile = std::make_unique<OpcodeProfile>();
+    std::unique_ptr<CallProfile> calls;
+    if (options.profile_calls)
+      calls = std::make_unique<CallProfile>(code);
+
 #ifdef USE_SYSTEMATIC_TESTING
     if (options.run_seed.has_value())
     {
@@ -72,21 +85,39 @@ namespace verona::interpreter
              i++)
         {
           std::cout << "Seed: " << i << std::endl;
-          interpreter::instantiate(options.cores, code, options.verbose, i);
+          interpreter::instantiate(
+            options.cores,
+            code,
+            options.verbose,
+            profile.get(),
+            calls.get(),
+            i);
         }
       }
       else
       {
         interpreter::instantiate(
-          options.cores, code, options.verbose, options.run_seed.value());
+          options.cores,
+          code,
+          options.verbose,
+          profile.get(),
+          calls.get(),
+          options.run_seed.value());
       }
     }
     else
     {
-      interpreter::instantiate(options.cores, code, options.verbose);
+      interpreter::instantiate(
+        options.cores, code, options.verbose, profile.get(), calls.get());
     }
 #else
-    interpreter::instantiate(options.cores, code, options.verbose);
+    interpreter::instantiate(
+      options.cores, code, options.verbose, profile.get(), calls.get());
 #endif
+
+    if (profile)
+      profile->print(std::cerr, 20);
+    if (calls)
+      calls->print(code, std::cerr, 20);
   }
 }
@@ -11,6 +11,8 @@ namespace verona::interpreter
     uint8_t cores = 4;
     bool verbose = false;
     bool run = false;
+    bool profile_opcodes = false;
+    bool profile_calls = false;
 #ifdef USE_SYSTEMATIC_TESTING
     std::optional<size_t> run_seed;
     std::optional<size_t> run_seed_upper;
@@ -33,6 +35,14 @@ namespace verona::interpreter
 
     app.add_option("--" + tag + "cores", options.cores);
     app.add_flag("--" + tag + "verbose", options.verbose);
+    app.add_flag(
+      "--" + tag + "profile-opcodes",
+      options.profile_opcodes,
+      "Print the pairs of opcodes that ran one after the other most often");
+    app.add_flag(
+      "--" + tag + "profile-calls",
+      options.profile_calls,
+      "Print the functions that were called most often");
 #ifdef USE_SYSTEMATIC_TESTING
     app.add_option("--" + tag + "seed", options.run_seed);
     app.add_option("--" + tag + "seed_upper", options.run_seed_upper);
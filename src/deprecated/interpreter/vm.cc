@@ -6,10 +6,145 @@
 #include "interpreter/format.h"
 #include "interpreter/value_list.h"
 
+#include <algorithm>
 #include <fmt/ranges.h>
+#include <functional>
+#include <iterator>
+#include <tuple>
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define USE_COMPUTED_GOTO
+#endif
 
 namespace verona::interpreter
 {
+  template<Opcode opcode, auto Fn>
+  struct VM::Decoded : public VM::DecodedInstruction
+  {
+    static_assert(std::is_member_function_pointer_v<decltype(Fn)>);
+
+    using Operands =
+      decltype(std::declval<const Code&>().load_operands<opcode>(
+        std::declval<size_t&>()));
+
+    Operands operands;
+
+    /**
+     * Call instructions have an inline cache, other instructions don't.
+     */
+    struct NoCache
+    {};
+    mutable std::conditional_t<opcode == Opcode::Call, CallCache, NoCache>
+      cache;
+
+    /**
+     * Loads the operands of the instruction, whose opcode ends just before
+     * `ip`.
+     */
+    Decoded(const Code& code, size_t ip) : operands(load(code, ip))
+    {
+      this->op = opcode;
+      this->handler = static_cast<uint8_t>(opcode);
+      this->next_ip = ip;
+      this->execute = &execute_instruction;
+    }
+
+    static Operands load(const Code& code, size_t& ip)
+    {
+      return code.load_operands<opcode>(ip);
+    }
+
+    static void execute_instruction(VM* vm, const DecodedInstruction& self)
+    {
+      if constexpr (opcode == Opcode::Call)
+        vm->call_cache_ = &static_cast<const Decoded&>(self).cache;
+
+      // The std::apply with a lambda trick turns the operands tuple into a
+      // parameter pack, so it can more easily be used.
+      std::apply(
+        [&](const auto&... args) {
+          vm->trace(bytecode::OpcodeSpec<opcode>::format, args...);
+          execute_handler<decltype(Fn)>::template execute<Fn>(vm, args...);
+        },
+        static_cast<const Decoded&>(self).operands);
+    }
+  };
+
+  template<VM::Superinstruction kind, typename First, typename Second>
+  struct VM::Fused : public VM::DecodedInstruction
+  {
+    First first;
+    Second second;
+
+    /**
+     * Loads the operands of both instructions. The first opcode ends just
+     * before `ip`, and the second follows the first instruction.
+     */
+    Fused(const Code& code, size_t ip)
+    : first(code, ip), second(code, first.next_ip + 1)
+    {
+      this->op = first.op;
+      this->handler = static_cast<uint8_t>(kind);
+      this->next_ip = first.next_ip;
+      this->execute = &execute_instruction;
+    }
+
+    static void execute_instruction(VM* vm, const DecodedInstruction& self)
+    {
+      const Fused& fused = static_cast<const Fused&>(self);
+      First::execute_instruction(vm, fused.first);
+
+      // A taken branch skips the second instruction.
+      if (vm->halt_ || (vm->frame().ip != fused.first.next_ip))
+        return;
+
+      vm->start_ip_ = fused.first.next_ip;
+      vm->frame().ip = fused.second.next_ip;
+      Second::execute_instruction(vm, fused.second);
+    }
+  };
+
+  void OpcodeProfile::print(std::ostream& out, size_t limit) const
+  {
+    std::vector<std::tuple<uint64_t, Opcode, Opcode>> pairs;
+    for (size_t i = 0; i < opcodes; i++)
+    {
+      for (size_t j = 0; j < opcodes; j++)
+      {
+        uint64_t count = counts_[i][j].load(std::memory_order_relaxed);
+        if (count > 0)
+          pairs.push_back(
+            {count, static_cast<Opcode>(i), static_cast<Opcode>(j)});
+      }
+    }
+
+    std::sort(pairs.begin(), pairs.end(), std::greater<>());
+    if (pairs.size() > limit)
+      pairs.resize(limit);
+
+    for (auto [count, first, second] : pairs)
+      fmt::print(out, "{:>12} {} {}\n", count, first, second);
+  }
+
+  void CallProfile::print(const Code& code, std::ostream& out, size_t limit)
+    const
+  {
+    std::vector<std::pair<uint64_t, size_t>> functions;
+    for (size_t addr = 0; addr < size_; addr++)
+    {
+      uint64_t count = counts_[addr].load(std::memory_order_relaxed);
+      if (count > 0)
+        functions.push_back({count, addr});
+    }
+
+    std::sort(functions.begin(), functions.end(), std::greater<>());
+    if (functions.size() > limit)
+      functions.resize(limit);
+
+    for (auto [count, addr] : functions)
+      fmt::print(out, "{:>12} {}\n", count, code.function_header(addr).name);
+  }
+
   void VM::run(std::vector<Value> args, size_t cown_count, size_t start)
   {
     assert(cfstack_.empty());
@@ -38,11 +173,43 @@ namespace verona::interpreter
     }
 
     dispatch_loop();
+
+    recycle_args(std::move(args));
+  }
+
+  std::vector<Value> VM::take_args()
+  {
+    if (spare_args_.empty())
+      return {};
+
+    std::vector<Value> args = std::move(spare_args_.back());
+    spare_args_.pop_back();
+    return args;
+  }
+
+  void VM::recycle_args(std::vector<Value> args)
+  {
+    assert(std::all_of(args.begin(), args.end(), [](const Value& value) {
+      return value.tag == Value::UNINIT;
+    }));
+
+    if (spare_args_.size() < max_spare_args)
+    {
+      args.clear();
+      spare_args_.push_back(std::move(args));
+    }
   }
 
   void VM::push_frame(size_t ip, size_t base, OnReturn on_return)
   {
-    FunctionHeader header = code_.function_header(ip);
+    push_frame(ip, code_.function_header(ip), base, on_return);
+  }
+
+  void VM::push_frame(
+    size_t ip, const FunctionHeader& header, size_t base, OnReturn on_return)
+  {
+    if (calls_ != nullptr)
+      calls_->record(ip);
 
     start_ip_ = ip;
     trace(
@@ -65,14 +232,172 @@ namespace verona::interpreter
     cfstack_.push_back(frame);
   }
 
+  const VM::DecodedInstruction& VM::decode(size_t ip)
+  {
+    code_.check(ip, 1);
+
+    std::unique_ptr<DecodedInstruction>& instruction = decoded_[ip];
+    if (!instruction)
+    {
+      Opcode op = code_.load<Opcode>(ip);
+      if (profile_ == nullptr)
+        instruction = decode_superinstruction(op, ip);
+      if (!instruction)
+        instruction = decode_opcode(op, ip);
+    }
+    return *instruction;
+  }
+
   void VM::dispatch_loop()
   {
+#ifdef USE_COMPUTED_GOTO
+    // Each handler ends with its own indirect jump to the next one, rather
+    // than sharing a single one, which makes the jumps easier to predict.
+    //
+    // The labels are in the order of the Opcode enum.
+    static const void* const labels[] = {
+      &&op_BinOp,
+      &&op_Call,
+      &&op_Clear,
+      &&op_ClearList,
+      &&op_Copy,
+      &&op_FulfillSleepingCown,
+      &&op_Freeze,
+      &&op_Int64,
+      &&op_String,
+      &&op_Jump,
+      &&op_JumpIf,
+      &&op_Load,
+      &&op_LoadDescriptor,
+      &&op_MatchCapability,
+      &&op_MatchDescriptor,
+      &&op_Merge,
+      &&op_Move,
+      &&op_MutView,
+      &&op_NewObject,
+      &&op_NewCown,
+      &&op_NewRegion,
+      &&op_NewSleepingCown,
+      &&op_Print,
+      &&op_Protect,
+      &&op_Return,
+      &&op_Store,
+      &&op_TraceRegion,
+      &&op_Unprotect,
+      &&op_Unreachable,
+      &&op_When,
+
+      // Superinstructions, in the order of the Superinstruction enum.
+      &&op_CopyCopy,
+      &&op_CopyCall,
+      &&op_CopyClear,
+      &&op_CopyWhen,
+      &&op_JumpIfJump,
+      &&op_LoadDescriptorMatchDescriptor,
+      &&op_LoadDescriptorNewObject,
+      &&op_MatchCapabilityJumpIf,
+      &&op_MatchDescriptorJumpIf,
+      &&op_MoveJump,
+      &&op_MoveMove,
+    };
+    static_assert(
+      std::size(labels) ==
+      static_cast<size_t>(Superinstruction::maximum_value) + 1);
+
+    const DecodedInstruction* instruction;
+    const DecodedInstruction* previous = nullptr;
+
+#  define NEXT() \
+    if (halt_) \
+      return; \
+    start_ip_ = frame().ip; \
+    instruction = &decode(start_ip_); \
+    frame().ip = instruction->next_ip; \
+    if (profile_ != nullptr) \
+      profile(previous, instruction); \
+    goto* labels[instruction->handler]
+
+#  define OP(NAME, FN) \
+  op_##NAME: \
+    Decoded<Opcode::NAME, &VM::FN>::execute_instruction(this, *instruction); \
+    NEXT();
+
+#  define FUSED(A, FA, B, FB) \
+  op_##A##B: \
+    Fused< \
+      Superinstruction::A##B, \
+      Decoded<Opcode::A, &VM::FA>, \
+      Decoded<Opcode::B, &VM::FB>>::execute_instruction(this, *instruction); \
+    NEXT();
+
+    NEXT();
+
+    OP(BinOp, opcode_binop);
+    OP(Call, opcode_call);
+    OP(Clear, opcode_clear);
+    OP(ClearList, opcode_clear_list);
+    OP(Copy, opcode_copy);
+    OP(FulfillSleepingCown, opcode_fulfill_sleeping_cown);
+    OP(Freeze, opcode_freeze);
+    OP(Int64, opcode_int64);
+    OP(Jump, opcode_jump);
+    OP(JumpIf, opcode_jump_if);
+    OP(Load, opcode_load);
+    OP(LoadDescriptor, opcode_load_descriptor);
+    OP(MatchCapability, opcode_match_capability);
+    OP(MatchDescriptor, opcode_match_descriptor);
+    OP(Move, opcode_move);
+    OP(MutView, opcode_mut_view);
+    OP(NewObject, opcode_new_object);
+    OP(NewRegion, opcode_new_region);
+    OP(NewSleepingCown, opcode_new_sleeping_cown);
+    OP(NewCown, opcode_new_cown);
+    OP(Print, opcode_print);
+    OP(Protect, opcode_protect);
+    OP(Return, opcode_return);
+    OP(Store, opcode_store);
+    OP(String, opcode_string);
+    OP(TraceRegion, opcode_trace_region);
+    OP(When, opcode_when);
+    OP(Unprotect, opcode_unprotect);
+    OP(Unreachable, opcode_unreachable);
+
+    FUSED(Copy, opcode_copy, Copy, opcode_copy);
+    FUSED(Copy, opcode_copy, Call, opcode_call);
+    FUSED(Copy, opcode_copy, Clear, opcode_clear);
+    FUSED(Copy, opcode_copy, When, opcode_when);
+    FUSED(JumpIf, opcode_jump_if, Jump, opcode_jump);
+    FUSED(
+      LoadDescriptor,
+      opcode_load_descriptor,
+      MatchDescriptor,
+      opcode_match_descriptor);
+    FUSED(
+      LoadDescriptor, opcode_load_descriptor, NewObject, opcode_new_object);
+    FUSED(MatchCapability, opcode_match_capability, JumpIf, opcode_jump_if);
+    FUSED(MatchDescriptor, opcode_match_descriptor, JumpIf, opcode_jump_if);
+    FUSED(Move, opcode_move, Jump, opcode_jump);
+    FUSED(Move, opcode_move, Move, opcode_move);
+
+#  undef FUSED
+#  undef OP
+#  undef NEXT
+
+  op_Merge:
+    // decode_opcode never produces one of these.
+    fatal("Invalid opcode {:#x}", static_cast<int>(instruction->op));
+#else
+    const DecodedInstruction* previous = nullptr;
     while (!halt_)
     {
       start_ip_ = frame().ip;
-      Opcode op = code_.load<Opcode>(frame().ip);
-      dispatch_opcode(op);
+      const DecodedInstruction& instruction = decode(start_ip_);
+      frame().ip = instruction.next_ip;
+      if (profile_ != nullptr)
+        profile(previous, &instruction);
+      instruction.execute(this, instruction);
     }
+#endif
   }
 
   void VM::execute_finaliser(VMObject* object)
@@ -138,7 +463,8 @@ namespace verona::interpreter
     {
       fatal("Out of bounds stack access (register {})", reg.value);
     }
-    return stack_.at(frame().base + reg.value);
+    // push_frame grew the stack to cover all of the frame's registers.
+    return stack_[frame().base + reg.value];
   }
 
   const Value& VM::read(Register reg) const
@@ -147,7 +473,7 @@ namespace verona::interpreter
     {
       fatal("Out of bounds stack access (register {})", reg.value);
     }
-    return stack_.at(frame().base + reg.value);
+    return stack_[frame().base + reg.value];
   }
 
   void VM::write(Register reg, Value value)
@@ -155,7 +481,7 @@ namespace verona::interpreter
     if (reg.value >= frame().locals)
       fatal("Out of bounds stack access (register {})", reg.value);
 
-    stack_.at(frame().base + reg.value).overwrite(alloc_, std::move(value));
+    stack_[frame().base + reg.value].overwrite(alloc_, std::move(value));
   }
 
   const VMDescriptor* VM::find_dispatch_descriptor(const Value& value) const
@@ -207,24 +533,23 @@ namespace verona::interpreter
     }
   }
 
-  void VM::check_type(const Value& value, Value::Tag expected)
+  void VM::type_error(
+    const Value& value, std::initializer_list<Value::Tag> expected) const
   {
-    if (value.tag != expected)
-      fatal(
-        "Invalid tag {} for value {}, expected {}", value.tag, value, expected);
-  }
-
-  void VM::check_type(const Value& value, std::vector<Value::Tag> expected)
-  {
-    if (
-      std::find(expected.begin(), expected.end(), value.tag) == expected.end())
+    if (expected.size() == 1)
     {
       fatal(
-        "Invalid tag {} for value {}, expected one of {}",
+        "Invalid tag {} for value {}, expected {}",
         value.tag,
         value,
-        expected);
+        *expected.begin());
     }
+
+    fatal(
+      "Invalid tag {} for value {}, expected one of {}",
+      value.tag,
+      value,
+      std::vector<Value::Tag>(expected));
   }
 
   Value
@@ -271,6 +596,24 @@ namespace verona::interpreter
     }
   }
 
+  const VM::CallCache::Entry& VM::CallCache::lookup(
+    const Code& code, const VMDescriptor* descriptor, SelectorIdx selector)
+  {
+    for (const Entry& entry : entries)
+    {
+      if (entry.descriptor == descriptor)
+        return entry;
+    }
+
+    Entry& entry = entries[victim];
+    victim = (victim + 1) % size;
+
+    entry.descriptor = descriptor;
+    entry.addr = descriptor->methods[selector.value];
+    entry.header = code.function_header(entry.addr);
+    return entry;
+  }
+
   void VM::opcode_call(SelectorIdx selector, uint8_t callspace)
   {
     if (callspace == 0)
@@ -282,10 +625,12 @@ namespace verona::interpreter
     const Value& receiver = read(Register(frame().locals - callspace));
     const VMDescriptor* descriptor = find_dispatch_descriptor(receiver);
 
-    size_t addr = descriptor->methods[selector.value];
+    assert(call_cache_ != nullptr);
+    const CallCache::Entry& target =
+      call_cache_->lookup(code_, descriptor, selector);
     size_t base = frame().base + frame().locals - callspace;
 
-    push_frame(addr, base, OnReturn::Continue);
+    push_frame(target.addr, target.header, base, OnReturn::Continue);
 
     if (callspace < frame().argc || callspace < frame().retc)
     {
@@ -570,8 +915,9 @@ namespace verona::interpreter
     size_t base = frame().locals - callspace;
 
     // Prepare the cowns and the arguments for the method invocation.
-    std::vector<Value> args;
-    std::vector<rt::Cown*> cowns;
+    std::vector<Value> args = take_args();
+    std::vector<rt::Cown*>& cowns = when_cowns_;
+    cowns.clear();
     args.reserve(header.argc);
     cowns.reserve(cown_count);
 
@@ -657,14 +1003,14 @@ namespace verona::interpreter
     fatal("Reached unreachable opcode");
   }
 
-  void VM::dispatch_opcode(Opcode op)
+  std::unique_ptr<VM::DecodedInstruction>
+  VM::decode_opcode(Opcode op, size_t ip)
   {
     switch (op)
     {
 #define OP(NAME, FN) \
   case Opcode::NAME: \
-    execute_opcode<Opcode::NAME, &VM::FN>(frame().ip); \
-    break;
+    return std::make_unique<Decoded<Opcode::NAME, &VM::FN>>(code_, ip);
 
       OP(BinOp, opcode_binop);
       OP(Call, opcode_call);
@@ -703,20 +1049,74 @@ namespace verona::interpreter
     }
   }
 
-  template<Opcode opcode, auto Fn>
-  void VM::execute_opcode(size_t& ip)
+  std::unique_ptr<VM::DecodedInstruction>
+  VM::decode_superinstruction(Opcode first, size_t ip)
   {
-    static_assert(std::is_member_function_pointer_v<decltype(Fn)>);
+    // Only the first instruction of a superinstruction is decoded here, to
+    // find the opcode of the second.
+    size_t next = ip;
+    switch (first)
+    {
+      case Opcode::Copy:
+        code_.load_operands<Opcode::Copy>(next);
+        break;
+      case Opcode::JumpIf:
+        code_.load_operands<Opcode::JumpIf>(next);
+        break;
+      case Opcode::LoadDescriptor:
+        code_.load_operands<Opcode::LoadDescriptor>(next);
+        break;
+      case Opcode::MatchCapability:
+        code_.load_operands<Opcode::MatchCapability>(next);
+        break;
+      case Opcode::MatchDescriptor:
+        code_.load_operands<Opcode::MatchDescriptor>(next);
+        break;
+      case Opcode::Move:
+        code_.load_operands<Opcode::Move>(next);
+        break;
+      default:
+        return nullptr;
+    }
 
-    auto operands = code_.load_operands<opcode>(ip);
+    if (next >= code_.size())
+      return nullptr;
+    uint8_t second = code_.u8(next);
+
+#define FUSED(A, FA, B, FB) \
+  if (first == Opcode::A && second == static_cast<uint8_t>(Opcode::B)) \
+    return std::make_unique<Fused< \
+      Superinstruction::A##B, \
+      Decoded<Opcode::A, &VM::FA>, \
+      Decoded<Opcode::B, &VM::FB>>>(code_, ip);
+
+    FUSED(Copy, opcode_copy, Copy, opcode_copy);
+    FUSED(Copy, opcode_copy, Call, opcode_call);
+    FUSED(Copy, opcode_copy, Clear, opcode_clear);
+    FUSED(Copy, opcode_copy, When, opcode_when);
+    FUSED(JumpIf, opcode_jump_if, Jump, opcode_jump);
+    FUSED(
+      LoadDescriptor,
+      opcode_load_descriptor,
+      MatchDescriptor,
+      opcode_match_descriptor);
+    FUSED(
+      LoadDescriptor, opcode_load_descriptor, NewObject, opcode_new_object);
+    FUSED(MatchCapability, opcode_match_capability, JumpIf, opcode_jump_if);
+    FUSED(MatchDescriptor, opcode_match_descriptor, JumpIf, opcode_jump_if);
+    FUSED(Move, opcode_move, Jump, opcode_jump);
+    FUSED(Move, opcode_move, Move, opcode_move);
+
+#undef FUSED
+
+    return nullptr;
+  }
 
-    // The std::apply with a lambda trick turns the operands tuple into a
-    // parameter pack, so it can more easily be used.
-    std::apply(
-      [&](const auto&... args) {
-        this->trace(bytecode::OpcodeSpec<opcode>::format, args...);
-        execute_handler<decltype(Fn)>::template execute<Fn>(this, args...);
-      },
-      operands);
+  void VM::profile(
+    const DecodedInstruction*& previous, const DecodedInstruction* current)
+  {
+    if (previous != nullptr)
+      profile_->record(previous->op, current->op);
+    previous = current;
   }
 }
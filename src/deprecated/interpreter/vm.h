@@ -4,8 +4,12 @@
 
 #include "interpreter/code.h"
 
+#include <atomic>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
+#include <initializer_list>
+#include <memory>
+#include <vector>
 
 namespace verona::interpreter
 {
@@ -19,13 +23,78 @@ namespace verona::interpreter
   using ValueList = BaseValueList<false>;
   using ConstValueList = BaseValueList<true>;
 
-  class VM
+  /**
+   * Counts of the pairs of opcodes that VMs executed one after the other,
+   * shared by all of them. This is used to choose superinstructions, see
+   * VM::Superinstruction.
+   */
+  class OpcodeProfile
   {
   public:
-    VM(const Code& code, bool verbose)
-    : code_(code), verbose_(verbose), alloc_(rt::ThreadAlloc::get())
+    void record(Opcode first, Opcode second)
+    {
+      counts_[static_cast<size_t>(first)][static_cast<size_t>(second)]
+        .fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Print the `limit` most frequent pairs, most frequent first.
+     */
+    void print(std::ostream& out, size_t limit) const;
+
+  private:
+    static constexpr size_t opcodes =
+      static_cast<size_t>(Opcode::maximum_value) + 1;
+
+    std::atomic<uint64_t> counts_[opcodes][opcodes] = {};
+  };
+
+  /**
+   * Number of times each function was entered, by the address of its header,
+   * shared by all VMs. The most frequent are the candidates for compiling
+   * rather than interpreting.
+   */
+  class CallProfile
+  {
+  public:
+    explicit CallProfile(const Code& code)
+    : counts_(new std::atomic<uint64_t>[code.size()]()), size_(code.size())
     {}
 
+    void record(size_t addr)
+    {
+      counts_[addr].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Print the `limit` most called functions, most called first.
+     */
+    void print(const Code& code, std::ostream& out, size_t limit) const;
+
+  private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    size_t size_;
+  };
+
+  class VM
+  {
+  public:
+    VM(
+      const Code& code,
+      bool verbose,
+      OpcodeProfile* profile,
+      CallProfile* calls)
+    : code_(code),
+      verbose_(verbose),
+      profile_(profile),
+      calls_(calls),
+      alloc_(rt::ThreadAlloc::get()),
+      decoded_(code.size())
+    {
+      cfstack_.reserve(initial_frames);
+      grow_stack(initial_registers);
+    }
+
     static inline thread_local VM* local_vm = nullptr;
 
     static void dealloc_vm()
@@ -33,10 +102,14 @@ namespace verona::interpreter
       delete local_vm;
     }
 
-    static void init_vm(const Code* code, bool verbose)
+    static void init_vm(
+      const Code* code,
+      bool verbose,
+      OpcodeProfile* profile,
+      CallProfile* calls)
     {
       static thread_local snmalloc::OnDestruct foo(&dealloc_vm);
-      local_vm = new VM(*code, verbose);
+      local_vm = new VM(*code, verbose, profile, calls);
     }
 
     /**
@@ -106,30 +179,154 @@ namespace verona::interpreter
      * grown to be big enough to execute this frame.
      */
     void push_frame(size_t ip, size_t base, OnReturn on_return);
+    void push_frame(
+      size_t ip,
+      const FunctionHeader& header,
+      size_t base,
+      OnReturn on_return);
 
     /**
-     * Switches on the opcode value and invokes the appropriate handler.
+     * Inline cache for a Call instruction.
+     *
+     * It remembers which function the last few receiver descriptors seen at
+     * the call site dispatched to, along with the function's header. A hit
+     * skips both the vtable lookup and decoding the header.
      */
-    void dispatch_opcode(Opcode op);
+    struct CallCache
+    {
+      struct Entry
+      {
+        const VMDescriptor* descriptor = nullptr;
+        size_t addr = 0;
+        FunctionHeader header;
+      };
+
+      static constexpr size_t size = 4;
+      Entry entries[size];
+
+      /**
+       * Entry to replace on the next miss.
+       */
+      size_t victim = 0;
+
+      const Entry& lookup(
+        const Code& code, const VMDescriptor* descriptor, SelectorIdx selector);
+    };
 
     /**
-     * Executes the VMs IP until the it returns from outer most stack frame.
-     **/
-    void dispatch_loop();
+     * An instruction whose operands have already been loaded from the
+     * bytecode.
+     */
+    struct DecodedInstruction
+    {
+      Opcode op;
+
+      /**
+       * Label of the instruction in dispatch_loop: its opcode, or a
+       * Superinstruction.
+       */
+      uint8_t handler;
+
+      /**
+       * Offset of the next instruction.
+       */
+      size_t next_ip;
+
+      /**
+       * Traces the instruction and invokes its handler.
+       */
+      void (*execute)(VM* vm, const DecodedInstruction& instruction);
+
+      virtual ~DecodedInstruction() = default;
+    };
 
     /**
-     * Wrapper around opcode handlers. Takes care of parsing and tracing the
-     * operands.
+     * Wrapper around opcode handlers, holding the operands of one instruction.
      *
      * Fn is the actual handler implementation, which will be called with the
      * operands as arguments. It should be a member function pointer of the VM
      * class.
      */
     template<Opcode opcode, auto Fn>
-    void execute_opcode(size_t& ip);
+    struct Decoded;
+
+    /**
+     * Pairs of instructions that are decoded and dispatched as one, numbered
+     * after the opcodes. The first of each pair never ends a function, and
+     * the second runs only if control falls through to it.
+     *
+     * These are sequences that the code generator emits for calls, matches,
+     * branches and returns. An OpcodeProfile of a program shows which pairs
+     * it runs most.
+     */
+    enum class Superinstruction : uint8_t
+    {
+      CopyCopy = static_cast<uint8_t>(Opcode::maximum_value) + 1,
+      CopyCall,
+      CopyClear,
+      CopyWhen,
+      JumpIfJump,
+      LoadDescriptorMatchDescriptor,
+      LoadDescriptorNewObject,
+      MatchCapabilityJumpIf,
+      MatchDescriptorJumpIf,
+      MoveJump,
+      MoveMove,
+
+      maximum_value = MoveMove,
+    };
+
+    /**
+     * A Superinstruction, holding both decoded instructions.
+     */
+    template<Superinstruction kind, typename First, typename Second>
+    struct Fused;
+
+    /**
+     * Returns the instruction at `ip`, decoding it the first time it is
+     * executed.
+     */
+    const DecodedInstruction& decode(size_t ip);
+
+    /**
+     * Switches on the opcode value and decodes the instruction with the
+     * appropriate handler.
+     */
+    std::unique_ptr<DecodedInstruction> decode_opcode(Opcode op, size_t ip);
+
+    /**
+     * Decodes the pair of instructions at `ip` as a Superinstruction, if
+     * there is one for their opcodes. `ip` is just after the first opcode.
+     */
+    std::unique_ptr<DecodedInstruction>
+    decode_superinstruction(Opcode first, size_t ip);
+
+    /**
+     * Count the pair of `previous` and `current` in profile_, and make
+     * `current` the previous instruction.
+     */
+    void profile(
+      const DecodedInstruction*& previous, const DecodedInstruction* current);
+
+    /**
+     * Executes the VMs IP until the it returns from outer most stack frame.
+     **/
+    void dispatch_loop();
 
     void grow_stack(size_t size);
 
+    /**
+     * Get an empty vector for the arguments of a new behaviour, reusing the
+     * one from a behaviour that has finished if there is one.
+     */
+    std::vector<Value> take_args();
+
+    /**
+     * Keep the argument vector of a finished behaviour for reuse. Its values
+     * must all have been moved out already.
+     */
+    void recycle_args(std::vector<Value> args);
+
     /**
      * Read the value of a register, relative to the current frame.
      *
@@ -185,13 +382,47 @@ namespace verona::interpreter
       abort();
     }
 
-    void check_type(const Value& value, Value::Tag expected);
-    void check_type(const Value& value, std::vector<Value::Tag> expected);
+    /**
+     * Abort the VM if the value doesn't have one of the expected tags.
+     *
+     * These run on most operands, so the check itself is inline and doesn't
+     * allocate. Only reporting the error is out of line.
+     */
+    void check_type(const Value& value, Value::Tag expected) const
+    {
+      if (value.tag != expected)
+        type_error(value, {expected});
+    }
+
+    void check_type(
+      const Value& value, std::initializer_list<Value::Tag> expected) const
+    {
+      for (Value::Tag tag : expected)
+      {
+        if (value.tag == tag)
+          return;
+      }
+      type_error(value, expected);
+    }
+
+    [[noreturn]] void type_error(
+      const Value& value, std::initializer_list<Value::Tag> expected) const;
 
     const Code& code_;
     rt::Alloc& alloc_;
     const bool verbose_;
 
+    /**
+     * Where to count pairs of opcodes, or null. Instructions are not fused
+     * while profiling, so that the pairs are those of the bytecode.
+     */
+    OpcodeProfile* const profile_;
+
+    /**
+     * Where to count calls to each function, or null.
+     */
+    CallProfile* const calls_;
+
     /**
      * Address of the currently executing instruction.
      *
@@ -202,6 +433,19 @@ namespace verona::interpreter
      */
     size_t start_ip_;
 
+    /**
+     * Decoded instructions, indexed by their offset in the bytecode.
+     *
+     * Decoding checks bounds and converts operands once per instruction
+     * rather than every time it runs, which dominates loops otherwise.
+     */
+    std::vector<std::unique_ptr<DecodedInstruction>> decoded_;
+
+    /**
+     * Inline cache of the Call instruction being executed.
+     */
+    CallCache* call_cache_ = nullptr;
+
     /**
      * Flag to halt VM execution.
      *
@@ -269,6 +513,26 @@ namespace verona::interpreter
      */
     std::vector<Frame> cfstack_;
 
+    /**
+     * The VM is kept for the lifetime of the scheduler thread, and the stacks
+     * are only ever grown. They start big enough for typical behaviours, so
+     * running one doesn't allocate.
+     */
+    static constexpr size_t initial_frames = 16;
+    static constexpr size_t initial_registers = 256;
+
+    /**
+     * Argument vectors of finished behaviours, see take_args and
+     * recycle_args. At most max_spare_args are kept.
+     */
+    std::vector<std::vector<Value>> spare_args_;
+    static constexpr size_t max_spare_args = 16;
+
+    /**
+     * Scratch space for the cowns of a `when`.
+     */
+    std::vector<rt::Cown*> when_cowns_;
+
     Frame& frame()
     {
       assert(!cfstack_.empty());
@@ -7,6 +7,9 @@
 #include "CXXType.h"
 #include "Compiler.h"
 
+#include <llvm/ADT/DenseMap.h>
+#include <map>
+
 namespace verona::interop
 {
   /**
@@ -24,6 +27,13 @@ namespace verona::interop
     /// Query system
     const CXXQuery* query;
 
+    /// Instantiated template classes, by canonical specialisation type, so
+    /// that repeated requests don't go through Sema again.
+    mutable llvm::DenseMap<const clang::Type*, CXXType> specialisations;
+    /// Functions built so far, by name and canonical function type
+    using FunctionKey = std::pair<std::string, const clang::Type*>;
+    mutable std::map<FunctionKey, clang::FunctionDecl*> functions;
+
     /**
      * Instantiate the class template specialisation at the end of the main
      * file, if not yet done.
@@ -206,10 +216,18 @@ namespace verona::interop
       auto args = query->gatherTemplateArguments(ty, params);
 
       // Build the canonical representation
-      query->getCanonicalTemplateSpecializationType(ty.decl, args);
+      auto canon = query->getCanonicalTemplateSpecializationType(ty.decl, args);
+
+      // Reuse the definition if this specialisation was already built
+      auto it = specialisations.find(canon.getTypePtr());
+      if (it != specialisations.end())
+        return it->second;
 
       // Instantiate and return the definition
-      return instantiateClassTemplate(ty, args);
+      auto spec = instantiateClassTemplate(ty, args);
+      if (spec.valid())
+        specialisations.try_emplace(canon.getTypePtr(), spec);
+      return spec;
     }
 
     /**
@@ -238,6 +256,12 @@ namespace verona::interop
       // Get function type of args/ret
       clang::QualType fnTy = ast->getFunctionType(retTy, argTys, EPI);
 
+      // Return the existing function, if there is one
+      auto canon = ast->getCanonicalType(fnTy).getTypePtr();
+      auto& existing = functions[{name.str(), canon}];
+      if (existing)
+        return existing;
+
       // Create a new function
       auto func = clang::FunctionDecl::Create(
         *ast,
@@ -276,6 +300,7 @@ namespace verona::interop
       func->setLexicalDeclContext(DC);
       DC->addDecl(func);
 
+      existing = func;
       return func;
     }
 
@@ -8,6 +8,7 @@
 #include "CXXType.h"
 #include "Compiler.h"
 #include "FS.h"
+#include "PCHCache.h"
 
 #include <clang/CodeGen/ModuleBuilder.h>
 #include <clang/Frontend/CompilerInstance.h>
@@ -25,6 +26,9 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/SmallVectorMemoryBuffer.h>
+#include <llvm/Support/ThreadPool.h>
+
+#include <optional>
 
 namespace verona::interop
 {
@@ -41,6 +45,9 @@ namespace verona::interop
    *  2. Query: using match handlers, searches the AST for specific constructs
    *     such as class types, function names, etc.
    *
+   * Interfaces don't share any state, so different interfaces can be created
+   * and used on different threads, see `createAll`. A single interface must
+   * only be used by one thread at a time.
    */
   class CXXInterface
   {
@@ -52,6 +59,8 @@ namespace verona::interop
     std::unique_ptr<Compiler> Clang;
     /// Virtual file system (compiler unit, pch, headers)
     FileSystem FS;
+    /// Pre-compiled header, which the file system refers to
+    std::unique_ptr<llvm::MemoryBuffer> pchBuffer;
     /// Query system
     std::unique_ptr<CXXQuery> query;
     /// Build system
@@ -135,7 +144,9 @@ namespace verona::interop
           Buffer,
           FrontendOpts.ModuleFileExtensions,
           false /* Allow errors */,
-          FrontendOpts.IncludeTimestamps,
+          // Cached PCHs are checked by content, so touching a header
+          // shouldn't invalidate them
+          /* IncludeTimestamps */ false,
           +CI.getLangOpts().CacheGeneratedPCH));
 
         // PCH container
@@ -153,17 +164,37 @@ namespace verona::interop
      * This method creates a new local Clang just for the pre-compiled headers
      * and returns a memory buffer with the contents, to be inserted in a
      * "file" inside the virtual file system.
+     *
+     * If `cacheDir` is set, the PCH is loaded from the cache there when none
+     * of its inputs have changed, and stored there otherwise.
      */
     std::unique_ptr<llvm::MemoryBuffer> generatePCH(
       const char* headerFile,
       llvm::ArrayRef<std::string> includePath,
-      SourceLanguage sourceLang)
+      SourceLanguage sourceLang,
+      llvm::StringRef cacheDir)
     {
+      std::optional<PCHCache> cache;
+      if (!cacheDir.empty())
+      {
+        std::vector<std::string> flags{std::to_string(sourceLang)};
+        flags.insert(flags.end(), includePath.begin(), includePath.end());
+        cache.emplace(cacheDir, headerFile, flags);
+        if (auto pch = cache->load())
+          return pch;
+      }
+
       Compiler LocalClang(
         llvm::vfs::getRealFileSystem(), headerFile, includePath, sourceLang);
       llvm::SmallVector<char, 0> pchOutBuffer;
       auto action = std::make_unique<GenerateMemoryPCHAction>(pchOutBuffer);
-      LocalClang.ExecuteAction(*action);
+      bool ok = LocalClang.ExecuteAction(*action);
+      if (ok && cache)
+      {
+        cache->store(
+          LocalClang.getInputFiles(),
+          {pchOutBuffer.data(), pchOutBuffer.size()});
+      }
       return std::unique_ptr<llvm::MemoryBuffer>(
         new llvm::SmallVectorMemoryBuffer(std::move(pchOutBuffer)));
     }
@@ -173,16 +204,19 @@ namespace verona::interop
      * CXXInterface c-tor. Creates the internal compile unit, include the
      * user file (and all dependencies), generates the pre-compiled headers,
      * creates the compiler instance and re-attaches the AST to the interface.
+     *
+     * Pre-compiled headers are cached in `pchCache` across runs, if set.
      */
     CXXInterface(
       std::string headerFile,
       llvm::ArrayRef<std::string> includePath,
-      SourceLanguage sourceLang = SourceLanguage::CXX)
+      SourceLanguage sourceLang = SourceLanguage::CXX,
+      llvm::StringRef pchCache = "")
     : factory(this)
     {
       // Pre-compiles the file requested by the user
-      std::unique_ptr<llvm::MemoryBuffer> pchBuffer =
-        generatePCH(headerFile.c_str(), includePath, sourceLang);
+      pchBuffer =
+        generatePCH(headerFile.c_str(), includePath, sourceLang, pchCache);
 
       // Creating a fake compile unit to include the target file
       // in an in-memory file system.
@@ -213,6 +247,31 @@ namespace verona::interop
       builder = std::make_unique<CXXBuilder>(ast, Clang.get(), query.get());
     }
 
+    /**
+     * Creates an interface for each of `headerFiles`, on up to `threads`
+     * threads (0 for one per core), and returns them in the same order.
+     */
+    static std::vector<std::unique_ptr<CXXInterface>> createAll(
+      llvm::ArrayRef<std::string> headerFiles,
+      llvm::ArrayRef<std::string> includePath,
+      SourceLanguage sourceLang = SourceLanguage::CXX,
+      llvm::StringRef pchCache = "",
+      unsigned threads = 0)
+    {
+      std::vector<std::unique_ptr<CXXInterface>> interfaces(
+        headerFiles.size());
+      llvm::ThreadPool pool(llvm::hardware_concurrency(threads));
+      for (size_t i = 0; i < headerFiles.size(); i++)
+      {
+        pool.async([&, i]() {
+          interfaces[i] = std::make_unique<CXXInterface>(
+            headerFiles[i], includePath, sourceLang, pchCache);
+        });
+      }
+      pool.wait();
+      return interfaces;
+    }
+
     /**
      * Dump AST for debug purposes
      */
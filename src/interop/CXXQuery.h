@@ -11,6 +11,7 @@
 #include <clang/Sema/Sema.h>
 #include <clang/Sema/Template.h>
 #include <clang/Sema/TemplateDeduction.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/Support/SmallVectorMemoryBuffer.h>
 
 // Makes matcher syntax so much clearer
@@ -39,37 +40,69 @@ namespace verona::interop
     /// The AST root
     clang::ASTContext* ast = nullptr;
 
+    /// Class, template and enum declarations by fully qualified name, built
+    /// on the first lookup so that queries don't each walk the whole AST.
+    mutable llvm::StringMap<const clang::NamedDecl*> index;
+    mutable bool indexed = false;
+
     /**
-     * Simple handler for indirect dispatch on a CXXType AST matcher.
-     *
-     * Use:
-     * ```
-     *  MatchFinder f;
-     *  f.addMatcher(new CXXTypeMatch<clang::CXXRecordDecl>(cxxTy));
-     *  f.matchAST(*ast);
-     *  // If matches, puts result in `cxxTy`
-     * ```
+     * Adds the types declared in `context` to the index, recursing into
+     * namespaces and classes. Like the matchers, the first declaration
+     * found for a name wins, except that a class definition replaces its
+     * forward declarations.
      */
-    template<class DeclTy>
-    class CXXTypeMatch : public MatchFinder::MatchCallback
+    void indexContext(const clang::DeclContext* context) const
     {
-      /// Type store owned by caller
-      CXXType& store;
-
-      /// Store the match on the caller's CXXType if empty
-      void run(const MatchFinder::MatchResult& Result) override
+      for (auto* decl : context->decls())
       {
-        auto* decl = Result.Nodes.getNodeAs<DeclTy>("id");
-        // Only store the first match (FIXME?)
-        if (decl && !store.valid())
+        if (auto* ns = llvm::dyn_cast<clang::NamespaceDecl>(decl))
+        {
+          indexContext(ns);
+        }
+        else if (auto* spec = llvm::dyn_cast<clang::LinkageSpecDecl>(decl))
+        {
+          indexContext(spec);
+        }
+        else if (llvm::isa<clang::ClassTemplateSpecializationDecl>(decl))
+        {
+          // Specialisations share the template's name.
+          continue;
+        }
+        else if (auto* rec = llvm::dyn_cast<clang::CXXRecordDecl>(decl))
+        {
+          auto& entry = index[rec->getQualifiedNameAsString()];
+          if (!entry || (rec->isThisDeclarationADefinition() &&
+                         llvm::isa<clang::CXXRecordDecl>(entry)))
+            entry = rec;
+          indexContext(rec);
+        }
+        else if (
+          llvm::isa<clang::ClassTemplateDecl>(decl) ||
+          llvm::isa<clang::EnumDecl>(decl))
         {
-          store = CXXType(decl);
+          auto* named = llvm::cast<clang::NamedDecl>(decl);
+          index.try_emplace(named->getQualifiedNameAsString(), named);
         }
       }
+    }
+
+    /**
+     * Finds a class, template or enum by fully qualified name, or returns
+     * null if there isn't one.
+     */
+    const clang::NamedDecl* lookup(llvm::StringRef name) const
+    {
+      if (!indexed)
+      {
+        indexContext(ast->getTranslationUnitDecl());
+        indexed = true;
+      }
 
-    public:
-      CXXTypeMatch(CXXType& store) : store(store) {}
-    };
+      auto it = index.find(name);
+      if (it == index.end())
+        return nullptr;
+      return it->second;
+    }
 
     /**
      * Maps between CXXType and Clang's types.
@@ -168,8 +201,8 @@ namespace verona::interop
      * We don't need to find builtin types because they're pre-defined in the
      * language and represented in CXXType directly.
      *
-     * TODO: Change this method to receive a list of names and return a list
-     * of types (or some variation over mutliple types at the same time).
+     * Other types are found in an index of the AST, built on the first call,
+     * so repeated queries don't each walk the whole translation unit.
      */
     CXXType getType(std::string name) const
     {
@@ -195,24 +228,18 @@ namespace verona::interop
       if (ty.valid())
         return ty;
 
-      // Search for class, enum or template.
-      name = "::" + name;
-      MatchFinder finder;
-      auto recDeclMatch =
-        std::make_unique<CXXTypeMatch<clang::CXXRecordDecl>>(ty);
-      auto classTempMatch =
-        std::make_unique<CXXTypeMatch<clang::ClassTemplateDecl>>(ty);
-      auto enumDeclMatch = std::make_unique<CXXTypeMatch<clang::EnumDecl>>(ty);
-
-      finder.addMatcher(
-        cxxRecordDecl(hasName(name)).bind("id"), recDeclMatch.get());
-      finder.addMatcher(
-        classTemplateDecl(hasName(name)).bind("id"), classTempMatch.get());
-      finder.addMatcher(
-        enumDecl(hasName(name)).bind("id"), enumDeclMatch.get());
-      finder.matchAST(*ast);
-
-      // Return the type matched directly.
+      // Search for class, enum or template, allowing a leading "::".
+      llvm::StringRef qualified = name;
+      qualified.consume_front("::");
+      auto* decl = lookup(qualified);
+
+      if (auto* rec = llvm::dyn_cast_or_null<clang::CXXRecordDecl>(decl))
+        return CXXType(rec);
+      if (auto* temp = llvm::dyn_cast_or_null<clang::ClassTemplateDecl>(decl))
+        return CXXType(temp);
+      if (auto* en = llvm::dyn_cast_or_null<clang::EnumDecl>(decl))
+        return CXXType(en);
+
       // If there was no match, the type is still invalid
       return ty;
     }
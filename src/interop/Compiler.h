@@ -45,6 +45,9 @@ namespace verona::interop
    *
    * Boilerplate for Clang specific logic to simplify CXXInterface to only AST
    * logic.
+   *
+   * Each compiler owns all of its state, including its LLVM context, so
+   * separate compilers can be used on separate threads.
    */
   class Compiler
   {
@@ -52,6 +55,10 @@ namespace verona::interop
     llvm::Optional<clang::PrecompiledPreamble> preamble;
     /// LLVMContext for LLVM lowering.
     std::unique_ptr<llvm::LLVMContext> llvmContext{new llvm::LLVMContext};
+    /// Module loader and header search, which the preprocessor refers to but
+    /// doesn't own. Declared before the compiler instance to outlive it.
+    clang::TrivialModuleLoader moduleLoader;
+    std::unique_ptr<clang::HeaderSearch> headerSearch;
     /// Compiler instance.
     std::unique_ptr<clang::CompilerInstance> Clang;
     /// All arguments, including empty last one that is replaced evey call
@@ -132,8 +139,7 @@ namespace verona::interop
 
       // Pre-processor and header search
       auto PPOpts = std::make_shared<clang::PreprocessorOptions>();
-      clang::TrivialModuleLoader TML;
-      auto HeaderSearchPtr = std::make_unique<clang::HeaderSearch>(
+      headerSearch = std::make_unique<clang::HeaderSearch>(
         std::make_shared<clang::HeaderSearchOptions>(),
         Clang->getSourceManager(),
         *Diags,
@@ -144,8 +150,8 @@ namespace verona::interop
         *Diags,
         Clang->getLangOpts(),
         Clang->getSourceManager(),
-        *HeaderSearchPtr,
-        TML,
+        *headerSearch,
+        moduleLoader,
         nullptr,
         false);
       Clang->setPreprocessor(PreprocessorPtr);
@@ -189,6 +195,19 @@ namespace verona::interop
       return Clang->ExecuteAction(action);
     }
 
+    /**
+     * Get the paths of all files read so far, such as the headers that a
+     * pre-compiled header was built from.
+     */
+    std::vector<std::string> getInputFiles() const
+    {
+      std::vector<std::string> files;
+      auto& SM = Clang->getSourceManager();
+      for (auto it = SM.fileinfo_begin(); it != SM.fileinfo_end(); ++it)
+        files.push_back(it->first->getName().str());
+      return files;
+    }
+
     /**
      * Lowers each top-level declaration to LLVM IR and dumps the module.
      *
@@ -198,13 +217,19 @@ namespace verona::interop
     std::unique_ptr<llvm::Module>
     emitLLVM(clang::ASTContext* ast, const char* cu_name)
     {
+      // The module may be linked into Verona code and optimised with it, so
+      // don't stop its functions from being inlined as -O0 normally does.
+      auto& CodeGenOpts = Clang->getCodeGenOpts();
+      CodeGenOpts.DisableO0ImplyOptNone = true;
+      CodeGenOpts.setInlining(clang::CodeGenOptions::NormalInlining);
+
       // Initialise codegen
       std::unique_ptr<clang::CodeGenerator> CodeGen{CreateLLVMCodeGen(
         Clang->getDiagnostics(),
         cu_name,
         Clang->getHeaderSearchOpts(),
         Clang->getPreprocessorOpts(),
-        Clang->getCodeGenOpts(),
+        CodeGenOpts,
         *llvmContext)};
       CodeGen->Initialize(*ast);
 
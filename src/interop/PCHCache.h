@@ -0,0 +1,160 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <clang/Basic/Version.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+namespace verona::interop
+{
+  /**
+   * On-disk cache of pre-compiled headers.
+   *
+   * Each entry is a single file in the cache directory, named after a hash
+   * of the Clang version, the compiler flags, and the path and contents of
+   * the header. An entry starts with the list of every file the PCH was
+   * built from, with a hash of its contents, followed by the PCH itself:
+   * ```
+   *  verona-pch <count>
+   *  <hash> <path>
+   *  ...
+   *  <pch>
+   * ```
+   * An entry is only used if all of those files still have the same
+   * contents, so changes to any included header are picked up.
+   *
+   * Entries are written to a temporary file and renamed into place, so that
+   * concurrent builds never read a partial entry. Builds that race to create
+   * the same entry write the same contents, and the last rename wins.
+   */
+  class PCHCache
+  {
+    /// Cache directory
+    std::string dir;
+    /// Path to the entry for this header and flags
+    llvm::SmallString<128> entry;
+
+    /// Magic at the start of every entry
+    static constexpr const char* magic = "verona-pch";
+
+    /// Hash of the contents of a file, or empty if it can't be read
+    static std::string hashFile(llvm::StringRef path)
+    {
+      auto buf = llvm::MemoryBuffer::getFile(path);
+      if (!buf)
+        return {};
+      return llvm::utohexstr(llvm::xxHash64((*buf)->getBuffer()));
+    }
+
+  public:
+    /**
+     * Finds the entry for `header`, compiled with `flags`.
+     */
+    PCHCache(
+      llvm::StringRef dir,
+      llvm::StringRef header,
+      llvm::ArrayRef<std::string> flags)
+    : dir(dir.str())
+    {
+      llvm::SmallString<128> path(header);
+      llvm::sys::fs::make_absolute(path);
+
+      llvm::SHA1 hash;
+      hash.update(clang::getClangFullVersion());
+      for (auto& flag : flags)
+      {
+        hash.update("\n");
+        hash.update(flag);
+      }
+      hash.update("\n");
+      hash.update(path);
+      hash.update("\n");
+      hash.update(hashFile(path));
+
+      entry = dir;
+      llvm::sys::path::append(entry, llvm::toHex(hash.final()) + ".pch");
+    }
+
+    /**
+     * Returns the cached PCH, or null if there isn't one or any of the files
+     * it was built from has changed.
+     */
+    std::unique_ptr<llvm::MemoryBuffer> load()
+    {
+      auto buf = llvm::MemoryBuffer::getFile(entry);
+      if (!buf)
+        return nullptr;
+
+      // Header line
+      llvm::StringRef rest = (*buf)->getBuffer();
+      llvm::StringRef line;
+      std::tie(line, rest) = rest.split('\n');
+      llvm::StringRef tag, countStr;
+      std::tie(tag, countStr) = line.split(' ');
+      size_t count;
+      if ((tag != magic) || countStr.getAsInteger(10, count))
+        return nullptr;
+
+      // Dependencies, which must all be unchanged
+      for (size_t i = 0; i < count; i++)
+      {
+        std::tie(line, rest) = rest.split('\n');
+        llvm::StringRef hash, path;
+        std::tie(hash, path) = line.split(' ');
+        if (hash.empty() || (hashFile(path) != hash))
+          return nullptr;
+      }
+
+      return llvm::MemoryBuffer::getMemBufferCopy(rest, entry);
+    }
+
+    /**
+     * Stores a PCH, built from the files in `inputs`. Failures are ignored,
+     * as the cache is only an optimisation.
+     */
+    void store(llvm::ArrayRef<std::string> inputs, llvm::StringRef pch)
+    {
+      if (llvm::sys::fs::create_directories(dir))
+        return;
+
+      int fd;
+      llvm::SmallString<128> temp;
+      llvm::SmallString<128> model(dir);
+      llvm::sys::path::append(model, "%%%%%%%%.tmp");
+      if (llvm::sys::fs::createUniqueFile(model, fd, temp))
+        return;
+
+      bool ok = true;
+      {
+        llvm::raw_fd_ostream out(fd, /*shouldClose*/ true);
+        out << magic << " " << inputs.size() << "\n";
+        for (auto& input : inputs)
+        {
+          llvm::SmallString<128> path(input);
+          llvm::sys::fs::make_absolute(path);
+          auto hash = hashFile(path);
+          ok = ok && !hash.empty();
+          out << hash << " " << path << "\n";
+        }
+        out << pch;
+        out.close();
+        if (out.has_error())
+        {
+          out.clear_error();
+          ok = false;
+        }
+      }
+
+      if (!ok || llvm::sys::fs::rename(temp, entry))
+        llvm::sys::fs::remove(temp);
+    }
+  };
+} // namespace verona::interop
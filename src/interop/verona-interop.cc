@@ -81,6 +81,32 @@ namespace
     cl::CommaSeparated,
     cl::value_desc("argTys"));
 
+  cl::opt<string> pchCache(
+    "pch-cache",
+    cl::desc("<directory to cache pre-compiled headers in>"),
+    cl::Optional,
+    cl::init(""),
+    cl::value_desc("pch-cache"));
+
+  cl::list<string> imports(
+    "imports",
+    cl::desc("<other headers to ingest alongside the input file>"),
+    cl::CommaSeparated,
+    cl::value_desc("imports"));
+
+  cl::opt<unsigned> threads(
+    "threads",
+    cl::desc("Number of threads to ingest headers on, 0 for one per core"),
+    cl::Optional,
+    cl::init(1));
+
+  cl::opt<string> outputFile(
+    "o",
+    cl::desc("<file to write the LLVM IR to, to link with Verona code>"),
+    cl::Optional,
+    cl::init(""),
+    cl::value_desc("filename"));
+
   /// Parse config file adding args to the args globals
   void parseCommandLine(int argc, char** argv, vector<string>& includePath)
   {
@@ -259,8 +285,12 @@ int main(int argc, char** argv)
   vector<string> includePath;
   parseCommandLine(argc, argv, includePath);
 
-  // Create the C++ interface
-  CXXInterface interface(inputFile, includePath);
+  // Create the C++ interfaces, the input file's first, in parallel
+  vector<string> headers{inputFile};
+  headers.insert(headers.end(), imports.begin(), imports.end());
+  auto interfaces = CXXInterface::createAll(
+    headers, includePath, SourceLanguage::CXX, pchCache, threads);
+  CXXInterface& interface = *interfaces.front();
 
   // Test type query
   if (!symbol.empty())
@@ -284,6 +314,21 @@ int main(int argc, char** argv)
   // Emit whatever is left on the main file
   // This is silent, just to make sure nothing breaks here
   auto mod = interface.emitLLVM();
+  for (auto& import : llvm::drop_begin(interfaces))
+    import->emitLLVM();
+
+  // Write LLVM IR for verona-mlir to link in with -link
+  if (!outputFile.empty())
+  {
+    std::error_code error;
+    llvm::raw_fd_ostream out(outputFile, error);
+    if (error)
+    {
+      cerr << "Cannot open " << outputFile << ": " << error.message() << endl;
+      return 1;
+    }
+    mod->print(out, nullptr);
+  }
 
   // Dump LLVM IR for debugging purposes
   // NOTE: Output is not stable, don't use it for tests
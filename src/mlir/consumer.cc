@@ -146,6 +146,10 @@ namespace mlir::verona
       assert(!func && "Function redeclaration");
       func = gen.Proto(loc, name, types, retTy);
 
+      // Record the method in its class, for calls on class values
+      if (!classStack.empty())
+        classStack.top().addMethod(node.name.view(), name);
+
       // Push the function declaration into the module
       gen.push_back(func);
     }
@@ -184,6 +188,78 @@ namespace mlir::verona
       return val;
     }
 
+    /// Once an error has been reported the module is discarded, so the nodes
+    /// that consume operands aren't lowered any more, as the values of the
+    /// node in error are missing.
+    bool hasFailed()
+    {
+      return !*this;
+    }
+
+    /// Call a function with `lhs` as its first argument, if there is one,
+    /// followed by the arguments in `rhs`, and push the result, if any.
+    void call(Location loc, FuncOp funcOp, Value lhs, Value rhs)
+    {
+      llvm::SmallVector<Value> args;
+      if (lhs)
+      {
+        args.push_back(lhs);
+      }
+      if (rhs)
+      {
+        auto first = args.size();
+        auto numArgs = funcOp.getNumArguments() - first;
+        // Single argument isn't wrapped in a tuple, so just push it.
+        if (numArgs == 1)
+        {
+          // If argument is indeed a tuple, dereference the pointer
+          if (gen.isStructPointer(rhs))
+          {
+            assert(
+              funcOp.getArgument(first).getType().isa<StructType>() &&
+              "Single argument type mismatch");
+
+            // Pass a a struct, not as a pointer
+            rhs = gen.GEP(loc, rhs);
+          }
+          rhs = gen.AutoLoad(loc, rhs);
+          args.push_back(rhs);
+        }
+        // Multiple arguments wrap as a tuple. If the function arguments
+        // weren't wrapped in a tuple, deconstruct it to get the right types
+        // for the call.
+        else
+        {
+          auto structTy = gen.getPointedStructType(rhs, /*anonymous*/ true);
+          assert(
+            structTy && structTy.getBody().size() == numArgs &&
+            "Call to function with wrong number of operands");
+          for (unsigned offset = 0, last = numArgs; offset < last; offset++)
+          {
+            auto ptr = gen.GEP(loc, rhs, offset);
+            auto val = gen.Load(loc, ptr);
+            args.push_back(val);
+          }
+        }
+      }
+
+      auto ret = gen.Call(loc, funcOp, args);
+      if (funcOp.getType().getNumResults())
+        pushOperand(ret);
+    }
+
+    /// Locals that hold a reference to an object keep it in an alloca, like
+    /// any other local. Returns the reference, loading it from the local if
+    /// needed, so that it can be used as the address of the object.
+    Value reference(Location loc, Value val)
+    {
+      if (!val || !gen.isPointer(val))
+        return val;
+      if (gen.getPointedType(val).isa<PointerType>())
+        return gen.Load(loc, val);
+      return val;
+    }
+
   public:
     ASTDefinitions(ASTConsumer& con, MLIRGenerator& gen) : ASTMLIRPass(con, gen)
     {}
@@ -247,7 +323,7 @@ namespace mlir::verona
       ScopeCleanup pop([&]() { symbolTable().popScope(); });
 
       // Check if needs to return a value at all
-      if (gen.hasTerminator(builder().getBlock()))
+      if (hasFailed() || gen.hasTerminator(builder().getBlock()))
         return;
 
       // Fetch the current function
@@ -338,6 +414,9 @@ namespace mlir::verona
     /// field access will have their own node types.
     void post(Select& node)
     {
+      if (hasFailed())
+        return;
+
       auto loc = con.getLocation(node);
       // The right-hand side of a select is always a reference (or nothing)
       auto rhs = con.lookup(node.args);
@@ -361,7 +440,7 @@ namespace mlir::verona
       }
 
       // The left-hand side of a select is always a reference (or nothing)
-      auto lhs = con.lookup(node.expr);
+      auto lhs = reference(loc, con.lookup(node.expr));
 
       // Dynamic selector, for accessing a field or calling a method
       if (auto structTy = gen.getPointedStructType(lhs))
@@ -379,8 +458,33 @@ namespace mlir::verona
           return;
         }
 
-        // FIXME: Implement dynamic dispatch of methods
-        assert(false && "Dynamic method call not implemented yet");
+        // Classes can't be subclassed, so a method selected on a class has
+        // exactly one implementation, which is called directly. Only selection
+        // through an interface will need dynamic dispatch.
+        auto& selector = node.typenames[0]->location;
+        auto className = structTy.getName().str();
+        auto funcOp = gen.lookupSymbol<FuncOp>(info.getMethod(selector.view()));
+        if (!funcOp)
+        {
+          error() << selector << "Couldn't find a field or method of this name "
+                  << "in class " << className << "." << text(selector);
+          return;
+        }
+        if (funcOp.getNumArguments() == 0)
+        {
+          error() << selector << "This method has no receiver, call it as "
+                  << className << "::" << selector.view() << "."
+                  << text(selector);
+          return;
+        }
+
+        // The receiver is passed by value, unless the method takes a pointer
+        Value self = lhs;
+        if (!funcOp.getArgument(0).getType().isa<PointerType>())
+          self = gen.AutoLoad(loc, gen.GEP(loc, lhs));
+
+        call(loc, funcOp, self, rhs);
+        return;
       }
 
       // Typenames indicate the context and the function name
@@ -396,54 +500,9 @@ namespace mlir::verona
       // Check the function table for a symbol that matches the opName
       if (auto funcOp = gen.lookupSymbol<FuncOp>(opName))
       {
-        llvm::SmallVector<Value> args;
         // Here it's guaranteed the lhs is not a selector (handled above), so if
         // there is one, it's the first argument of a function call.
-        if (lhs)
-        {
-          args.push_back(lhs);
-        }
-        if (rhs)
-        {
-          auto numArgs = funcOp.getNumArguments();
-          // Single argument isn't wrapped in a tuple, so just push it.
-          if (numArgs == 1)
-          {
-            assert(args.empty() && "lhs must be empty for single arg");
-            // If argument is indeed a tuple, dereference the pointer
-            if (gen.isStructPointer(rhs))
-            {
-              assert(
-                funcOp.getArgument(0).getType().isa<StructType>() &&
-                "Single argument type mismatch");
-
-              // Pass a a struct, not as a pointer
-              rhs = gen.GEP(loc, rhs);
-            }
-            rhs = gen.AutoLoad(loc, rhs);
-            args.push_back(rhs);
-          }
-          // Multiple arguments wrap as a tuple. If the function arguments
-          // weren't wrapped in a tuple, deconstruct it to get the right types
-          // for the call.
-          else
-          {
-            auto structTy = gen.getPointedStructType(rhs, /*anonymous*/ true);
-            assert(
-              structTy && structTy.getBody().size() == numArgs &&
-              "Call to function with wrong number of operands");
-            for (unsigned offset = 0, last = numArgs; offset < last; offset++)
-            {
-              auto ptr = gen.GEP(loc, rhs, offset);
-              auto val = gen.Load(loc, ptr);
-              args.push_back(val);
-            }
-          }
-        }
-
-        auto ret = gen.Call(loc, funcOp, args);
-        if (funcOp.getType().getNumResults())
-          pushOperand(ret);
+        call(loc, funcOp, lhs, rhs);
         return;
       }
 
@@ -489,6 +548,9 @@ namespace mlir::verona
     /// sure we match.
     void post(Assign& node)
     {
+      if (hasFailed())
+        return;
+
       auto loc = con.getLocation(node);
       Value val;
       // Value can be a reference (and the operand list must be empty)
@@ -537,11 +599,12 @@ namespace mlir::verona
 
       // If both are addresses, we need to load from the RHS to be able to
       // store into the LHS. We can't just alias (like above) because both
-      // addresses exist and have their own values and provenance.
-      val = gen.AutoLoad(val.getLoc(), val);
+      // addresses exist and have their own values and provenance. If the LHS
+      // holds a reference, the RHS is the reference to store.
+      auto addrTy = gen.getPointedType(addr);
+      val = gen.AutoLoad(val.getLoc(), reference(loc, val), addrTy);
 
       // Types of LHS and RHS must match.
-      auto addrTy = gen.getPointedType(addr);
       auto valTy = val.getType();
       assert(addrTy == valTy && "Assignment types must be the same");
 
@@ -559,9 +622,65 @@ namespace mlir::verona
       gen.Store(loc, addr, val);
     }
 
+    /// Allocates an object, in the region of `in` if there is one, and
+    /// initialises its fields from the arguments, in declaration order.
+    /// Objects that don't escape their function are moved to the stack later,
+    /// see createStackPromotionPass.
+    void post(New& node)
+    {
+      if (hasFailed())
+        return;
+
+      auto loc = con.getLocation(node);
+
+      // FIXME: The class comes from the type of the assignment until all AST
+      // nodes have types.
+      auto refTy = selectTypeFromAssign.dyn_cast_or_null<PointerType>();
+      selectTypeFromAssign = Type();
+      assert(refTy && "New must be assigned to a reference");
+      auto structTy = refTy.getElementType().dyn_cast<StructType>();
+      assert(structTy && structTy.isIdentified() && "New must create a class");
+
+      Value region;
+      if (!node.in.view().empty())
+      {
+        region = reference(loc, symbolTable().lookup(node.in.view()));
+        assert(gen.isPointer(region) && "Region must be a reference");
+      }
+      auto obj = gen.New(loc, structTy, region);
+
+      // A single argument isn't wrapped in a tuple
+      auto& info = con.classInfo.at(ClassInfo::key(structTy));
+      auto numFields = structTy.getBody().size();
+      auto args = con.lookup(node.args);
+      for (size_t i = 0; i < numFields; i++)
+      {
+        auto [offset, fieldTy] = info.getDeclaredField(i);
+        Value val;
+        if (numFields == 1)
+        {
+          val = gen.AutoLoad(loc, reference(loc, args), fieldTy);
+        }
+        else
+        {
+          assert(
+            gen.getPointedStructType(args, /*anonymous*/ true) &&
+            "New needs a tuple of fields");
+          val = gen.Load(loc, args, i);
+        }
+        assert(val.getType() == fieldTy && "New field types must match");
+        gen.Store(loc, obj, val, offset);
+      }
+
+      pushOperand(obj);
+    }
+
     /// Creates new tuples and initialise their fields
     void post(Tuple& node)
     {
+      if (hasFailed())
+        return;
+
       auto loc = con.getLocation(node);
 
       // Evaluate each tuple element
@@ -617,6 +736,8 @@ namespace mlir::verona
     ASTDefinitions def(con, con.gen);
     def.set_error(std::cerr);
     def << ast;
+    if (!def)
+      return runtimeError("Failed to lower the AST to MLIR");
 
     // TODO: MLIR passes, if needed
 
@@ -628,10 +749,11 @@ namespace mlir::verona
 
   Location ASTConsumer::getLocation(::verona::parser::NodeDef& ast)
   {
-    if (!ast.location.source)
+    auto source = ast.location.source();
+    if (!source)
       return builder().getUnknownLoc();
 
-    auto path = ast.location.source->origin;
+    auto path = source->origin;
     auto [line, column] = ast.location.linecol();
     return mlir::FileLineColLoc::get(
       builder().getIdentifier(path), line, column);
@@ -699,22 +821,37 @@ namespace mlir::verona
         // FIXME: Support unsigned values. The standard dialect only has
         // signless operations, so we restrict current tests to I* and avoid
         // U* integer types.
-        Type type = llvm::StringSwitch<Type>(name)
-                      .Case("I8", builder().getIntegerType(8))
-                      .Case("I16", builder().getIntegerType(16))
-                      .Case("I32", builder().getIntegerType(32))
-                      .Case("I64", builder().getIntegerType(64))
-                      .Case("I128", builder().getIntegerType(128))
-                      .Case("U8", builder().getIntegerType(8))
-                      .Case("U16", builder().getIntegerType(16))
-                      .Case("U32", builder().getIntegerType(32))
-                      .Case("U64", builder().getIntegerType(64))
-                      .Case("U128", builder().getIntegerType(128))
-                      .Case("ISize", builder().getIntegerType(size))
-                      .Case("USize", builder().getIntegerType(size))
-                      .Case("F32", builder().getF32Type())
-                      .Case("F64", builder().getF64Type())
-                      .Default(Type());
+        auto scalar = [&](llvm::StringRef name) {
+          return llvm::StringSwitch<Type>(name)
+            .Case("I8", builder().getIntegerType(8))
+            .Case("I16", builder().getIntegerType(16))
+            .Case("I32", builder().getIntegerType(32))
+            .Case("I64", builder().getIntegerType(64))
+            .Case("I128", builder().getIntegerType(128))
+            .Case("U8", builder().getIntegerType(8))
+            .Case("U16", builder().getIntegerType(16))
+            .Case("U32", builder().getIntegerType(32))
+            .Case("U64", builder().getIntegerType(64))
+            .Case("U128", builder().getIntegerType(128))
+            .Case("ISize", builder().getIntegerType(size))
+            .Case("USize", builder().getIntegerType(size))
+            .Case("F32", builder().getF32Type())
+            .Case("F64", builder().getF64Type())
+            .Case("Bool", builder().getI1Type())
+            .Default(Type());
+        };
+        Type type = scalar(name);
+
+        // Vectors of numbers are named after their element type and their
+        // number of lanes, as in F32x4.
+        if (!type)
+        {
+          auto [elem, lanes] = llvm::StringRef(name).rsplit('x');
+          int64_t count;
+          auto elemTy = scalar(elem);
+          if (elemTy && !lanes.getAsInteger(10, count) && (count > 1))
+            type = VectorType::get({count}, elemTy);
+        }
         // If type wasn't detected, it must be a class
         // The order of declaration doesn't matter, so we create empty
         // classes if they're not declared yet. Note: getIdentified below is a
@@ -726,6 +863,29 @@ namespace mlir::verona
         assert(type && "Type not found");
         return type;
       }
+      case Kind::IsectType:
+      {
+        // A class with a capability is a reference to an object, which `new`
+        // allocates in some region.
+        auto& I = ast.as<IsectType>();
+        Type type;
+        bool reference = false;
+        for (auto t : I.types)
+        {
+          auto kind = t->kind();
+          if (kind == Kind::Iso || kind == Kind::Mut || kind == Kind::Imm)
+          {
+            reference = true;
+            continue;
+          }
+          assert(!type && "Intersection of classes not implemented yet");
+          type = consumeType(*t);
+        }
+        assert(type && "Intersection has no type");
+        if (reference)
+          return PointerType::get(type);
+        return type;
+      }
       case Kind::TupleType:
       {
         auto T = ast.as<::verona::parser::TupleType>();
@@ -11,8 +11,11 @@
 #include "parser/ast.h"
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MathExtras.h"
 
+#include <algorithm>
 #include <stack>
 #include <string>
 
@@ -25,35 +28,75 @@ namespace mlir::verona
    * This class is used for both keeping the context while building classes as
    * well as querying field types by name later in code generation.
    *
-   * FIXME: Verona may play with field offset (ex. by size order), which needs
-   * to be done *before* we access any field from code, ie. right after
-   * declaration is finished, so the order in which they appear in the vector
-   * can change but only once. MLIR doesn't allow to change the fields of a
-   * declared structure, so this needs to be done before setting the
-   * StructureType.
+   * Fields are reordered to reduce padding when the declaration is finished,
+   * before any field is accessed from code, as MLIR doesn't allow changing
+   * the fields of a declared structure. Code finds fields by name, with
+   * getFieldType, so the offsets it uses are always those of the final order.
    */
   class ClassInfo
   {
-    /// Bind name and type for fields. Position is given by its vector offset.
+    /// Bind name and type for fields. Position is given by its vector offset,
+    /// and `declared` is its position in the declaration.
     struct Field
     {
       StringRef name;
       Type type;
+      size_t declared;
     };
 
     /// The fields, by offset order
     SmallVector<Field> fields;
 
+    /// Mangled function names of the methods, by name
+    llvm::StringMap<std::string> methods;
+
     /// The final MLIR structure type
     StructType type;
 
     /// Class name
     StringRef name;
 
-    /// Reorder fields to make structures more efficient.
+    /// Alignment of a field type in bytes, assuming natural alignment, as on
+    /// the 64-bit targets we generate code for.
+    static unsigned alignment(Type type)
+    {
+      if (auto ty = type.dyn_cast<IntegerType>())
+      {
+        auto bytes = llvm::PowerOf2Ceil(ty.getWidth()) / 8;
+        return static_cast<unsigned>(std::clamp<uint64_t>(bytes, 1, 16));
+      }
+      if (auto ty = type.dyn_cast<FloatType>())
+        return ty.getWidth() / 8;
+      if (auto ty = type.dyn_cast<ArrayType>())
+        return alignment(ty.getElementType());
+      if (auto ty = type.dyn_cast<StructType>())
+      {
+        // A structure that isn't finished yet gets a pointer's alignment.
+        if (!ty.isInitialized())
+          return 8;
+        if (ty.isPacked())
+          return 1;
+
+        unsigned align = 1;
+        for (auto field : ty.getBody())
+          align = std::max(align, alignment(field));
+        return align;
+      }
+
+      // Pointers, and anything we don't know the layout of.
+      return 8;
+    }
+
+    /// Reorder fields to make structures more efficient. Every type's size is
+    /// a multiple of its alignment, so placing fields in decreasing order of
+    /// alignment leaves no padding between them. The sort is stable, so
+    /// fields with the same alignment keep their declaration order.
     void optimizeFields()
     {
-      // TODO: Implement this.
+      std::stable_sort(
+        fields.begin(), fields.end(), [](const Field& a, const Field& b) {
+          return alignment(a.type) > alignment(b.type);
+        });
     }
 
   public:
@@ -67,7 +110,7 @@ namespace mlir::verona
     void addField(StringRef name, Type ty)
     {
       assert(!type.isInitialized() && "Can't change type after declaration");
-      fields.push_back({name, ty});
+      fields.push_back({name, ty, fields.size()});
     }
 
     /// Finalise structure and set MLIR type
@@ -121,6 +164,37 @@ namespace mlir::verona
       // Not found, return empty type
       return {pos, Type()};
     }
+
+    /// Return the position and type of the field declared at `declared`, such
+    /// as for initialising fields from the arguments of `new`
+    std::tuple<size_t, Type> getDeclaredField(size_t declared)
+    {
+      size_t pos = 0;
+      for (auto field : fields)
+      {
+        if (field.declared == declared)
+          return {pos, field.type};
+        pos++;
+      }
+
+      // Not found, return empty type
+      return {pos, Type()};
+    }
+
+    /// Adds a method, by its name and mangled function name
+    void addMethod(StringRef name, StringRef mangled)
+    {
+      methods[name] = mangled.str();
+    }
+
+    /// Return the mangled function name of a method, or empty if not found
+    StringRef getMethod(StringRef name)
+    {
+      auto it = methods.find(name);
+      if (it == methods.end())
+        return {};
+      return it->second;
+    }
   };
 
   /**
@@ -4,6 +4,8 @@
 #include "driver.h"
 
 #include "consumer.h"
+#include "escape.h"
+#include "forwarding.h"
 #include "mlir/Conversion/StandardToLLVM/ConvertStandardToLLVMPass.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
@@ -18,10 +20,29 @@
 #include "mlir/Transforms/Passes.h"
 #include "orcjit.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Instrumentation.h"
 
 #include <iostream>
 
@@ -53,8 +74,9 @@ namespace
 
 namespace mlir::verona
 {
-  Driver::Driver(unsigned optLevel)
+  Driver::Driver(unsigned optLevel, llvm::StringRef jitCache)
   : optLevel(optLevel),
+    jitCache(jitCache.str()),
     passManager(&mlirContext),
     diagnosticHandler(sourceManager, &mlirContext)
   {
@@ -63,7 +85,8 @@ namespace mlir::verona
     mlirContext.getOrLoadDialect<mlir::LLVM::LLVMDialect>();
 
     // Initialize LLVM targets.
-    // TODO: Use target triples here, for cross-compilation
+    // Only the native target is linked in, so codeGeneration can only target
+    // triples for the host's architecture.
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
   }
@@ -107,6 +130,88 @@ namespace mlir::verona
     return llvm::Error::success();
   }
 
+  llvm::Error Driver::linkLLVM(const std::string& filename)
+  {
+    assert(!llvmModule);
+
+    auto srcOrErr = llvm::MemoryBuffer::getFile(filename);
+    if (auto err = srcOrErr.getError())
+      return runtimeError(
+        "Cannot open file " + filename + ": " + err.message());
+
+    linkBuffers.push_back(std::move(*srcOrErr));
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::linkLLVM(const llvm::Module& module)
+  {
+    assert(!llvmModule);
+
+    // Modules can only be linked within a context, so go through bitcode
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(module, os);
+    linkBuffers.push_back(std::make_unique<llvm::SmallVectorMemoryBuffer>(
+      std::move(bitcode), module.getModuleIdentifier()));
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::instrumentProfile(llvm::StringRef filename)
+  {
+    assert(!llvmModule);
+
+    if (profile == Profile::Use)
+      return runtimeError("Cannot both instrument and use a profile");
+
+    profile = Profile::Generate;
+    profileFile = filename.str();
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::useProfile(llvm::StringRef filename)
+  {
+    assert(!llvmModule);
+
+    if (profile == Profile::Generate)
+      return runtimeError("Cannot both instrument and use a profile");
+    if (!llvm::sys::fs::exists(filename))
+      return runtimeError("Cannot open profile " + filename.str());
+
+    profile = Profile::Use;
+    profileFile = filename.str();
+    return llvm::Error::success();
+  }
+
+  llvm::Error Driver::applyProfile()
+  {
+    if (profile == Profile::None)
+      return llvm::Error::success();
+
+    // The profile passes pick sections and symbols for the target.
+    mlir::ExecutionEngine::setupTargetTriple(llvmModule.get());
+
+    llvm::legacy::PassManager pm;
+    if (profile == Profile::Generate)
+    {
+      // Counters for blocks and edges, and value profiles for the targets
+      // of indirect calls, which are then lowered to calls to the runtime.
+      llvm::InstrProfOptions options;
+      options.InstrProfileOutput = profileFile;
+      pm.add(llvm::createPGOInstrumentationGenLegacyPass());
+      pm.add(llvm::createInstrProfilingLegacyPass(options));
+    }
+    else
+    {
+      // Branch weights and entry counts, then promote the indirect calls
+      // whose targets the profile found to be hot.
+      pm.add(llvm::createPGOInstrumentationUseLegacyPass(profileFile));
+      pm.add(llvm::createPGOIndirectCallPromotionLegacyPass());
+    }
+    pm.run(*llvmModule);
+
+    return llvm::Error::success();
+  }
+
   llvm::Error Driver::emitMLIR(llvm::StringRef filename)
   {
     assert(mlirModule);
@@ -134,9 +239,24 @@ namespace mlir::verona
       passManager.addPass(mlir::createInlinerPass());
       passManager.addPass(mlir::createSymbolDCEPass());
 
+      // Objects that don't escape move to the stack once inlining has
+      // exposed as much of their use as it can.
       mlir::OpPassManager& funcPM = passManager.nest<mlir::FuncOp>();
+      funcPM.addPass(createStackPromotionPass());
       funcPM.addPass(mlir::createCanonicalizerPass());
       funcPM.addPass(mlir::createCSEPass());
+
+      // Locals live in allocas until LLVM promotes them. Forwarding them
+      // here, once CSE has merged their addresses, lets SCCP propagate the
+      // constants they hold.
+      if (optLevel > 1)
+      {
+        funcPM.addPass(createStoreForwardingPass());
+        funcPM.addPass(mlir::createSCCPPass());
+        funcPM.addPass(mlir::createLoopInvariantCodeMotionPass());
+        funcPM.addPass(mlir::createCanonicalizerPass());
+        funcPM.addPass(mlir::createCSEPass());
+      }
     }
 
     // If optimisation levels higher than 0, run some opts
@@ -154,11 +274,17 @@ namespace mlir::verona
   {
     assert(mlirModule);
 
-    // The lowering "pass manager"
-    passManager.addPass(mlir::createLowerToLLVMPass());
+    // The function passes are nested, so they run in parallel across the
+    // functions of the module on the context's thread pool.
+    auto err = optimiseMLIR();
+    if (err)
+      return err;
 
-    // If optimisation levels higher than 0, run some opts
-    if (mlir::failed(passManager.run(mlirModule.get())))
+    // Lower with a pass manager of its own, so that the optimisations above
+    // don't run again.
+    mlir::PassManager lowering(&mlirContext);
+    lowering.addPass(mlir::createLowerToLLVMPass());
+    if (mlir::failed(lowering.run(mlirModule.get())))
     {
       mlirModule->dump();
       return runtimeError("Failed to run some passes");
@@ -174,8 +300,44 @@ namespace mlir::verona
     if (!llvmModule)
       return runtimeError("Failed to lower to LLVM IR");
 
+    // Link in other modules, such as C++ wrappers from the interop layer,
+    // before optimisation so that their functions can be inlined.
+    for (auto& buffer : linkBuffers)
+    {
+      llvm::SMDiagnostic diag;
+      auto module = llvm::parseIR(*buffer, diag, *llvmContext);
+      if (!module)
+        return runtimeError(
+          "Cannot read LLVM IR " + buffer->getBufferIdentifier().str() +
+          ": " + diag.getMessage().str());
+      if (llvm::Linker::linkModules(*llvmModule, std::move(module)))
+        return runtimeError(
+          "Cannot link " + buffer->getBufferIdentifier().str());
+    }
+
+    // Instrumentation, and the profile's annotations, go in before the
+    // optimisations that they steer.
+    err = applyProfile();
+    if (err)
+      return err;
+
+    // Key the JIT cache on the module before it is optimised, so that a hit
+    // skips optimisation as well as code generation.
+    if (!jitCache.empty())
+    {
+      std::string key;
+      llvm::raw_string_ostream os(key);
+      llvmModule->print(os, nullptr);
+      os << "\n" << optLevel << "\n" << llvm::sys::getProcessTriple() << "\n"
+         << llvm::sys::getHostCPUName();
+      auto hash = llvm::SHA1::hash(llvm::arrayRefFromStringRef(os.str()));
+      llvmModule->setModuleIdentifier(llvm::toHex(hash, /*LowerCase=*/true));
+      jitCached =
+        llvm::orc::VeronaObjectCache(jitCache).hasObject(llvmModule.get());
+    }
+
     // Optimise if requested
-    if (optLevel)
+    if (optLevel && !jitCached)
     {
       mlir::ExecutionEngine::setupTargetTriple(llvmModule.get());
 
@@ -186,6 +348,14 @@ namespace mlir::verona
         /*targetMachine=*/nullptr);
       if (auto err = optPipeline(llvmModule.get()))
         return runtimeError("Failed to generate LLVM IR");
+
+      // The parser hands us a copy of each generic function per set of
+      // type arguments, and many lower to the same code, for example when
+      // the arguments are all pointers. Keep one body for each and make the
+      // others call or alias it.
+      llvm::legacy::PassManager merge;
+      merge.add(llvm::createMergeFunctionsPass());
+      merge.run(*llvmModule);
     }
 
     return llvm::Error::success();
@@ -212,6 +382,10 @@ namespace mlir::verona
 
   llvm::Error Driver::runLLVM(int& returnValue)
   {
+    if (profile == Profile::Generate)
+      return runtimeError(
+        "Instrumented programs need the profile runtime, emit an object");
+
     if (!llvmModule)
     {
       auto err = lowerToLLVM();
@@ -220,7 +394,9 @@ namespace mlir::verona
     }
     llvm::ExitOnError check;
 
-    auto J = llvm::orc::VeronaJIT::Create();
+    // The module identifier is the cache key, see lowerToLLVM.
+    llvm::orc::VeronaObjectCache cache(jitCache);
+    auto J = llvm::orc::VeronaJIT::Create(jitCache.empty() ? nullptr : &cache);
     if (!J)
       return J.takeError();
     auto& JIT = *J;
@@ -236,8 +412,107 @@ namespace mlir::verona
     return llvm::Error::success();
   }
 
-  llvm::Error Driver::codeGeneration(const llvm::StringRef filename)
+  llvm::Error Driver::codeGeneration(
+    const llvm::StringRef filename,
+    const llvm::StringRef triple,
+    const llvm::StringRef cpu,
+    unsigned partitions)
   {
-    return runtimeError("Not implemented yet");
+    if (!llvmModule)
+    {
+      auto err = lowerToLLVM();
+      if (err)
+        return err;
+    }
+
+    // Find the target
+    std::string targetTriple = triple.empty() ?
+      llvm::sys::getDefaultTargetTriple() :
+      llvm::Triple::normalize(triple);
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    if (!target)
+      return runtimeError("Cannot find target " + targetTriple + ": " + error);
+
+    // Use the host's CPU and features if asked to
+    std::string targetCPU = cpu.empty() ? "generic" : cpu.str();
+    llvm::SubtargetFeatures features;
+    if (targetCPU == "native")
+    {
+      targetCPU = llvm::sys::getHostCPUName().str();
+      llvm::StringMap<bool> hostFeatures;
+      if (llvm::sys::getHostCPUFeatures(hostFeatures))
+      {
+        for (auto& feature : hostFeatures)
+          features.AddFeature(feature.first(), feature.second);
+      }
+    }
+
+    // Position independent, so the object can be linked into executables
+    // and shared libraries alike. Each partition needs a machine of its own.
+    auto createMachine = [&]() {
+      llvm::TargetOptions options;
+      return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+        targetTriple,
+        targetCPU,
+        features.getString(),
+        options,
+        llvm::Reloc::PIC_,
+        llvm::None,
+        optLevel ? llvm::CodeGenOpt::Default : llvm::CodeGenOpt::None));
+    };
+    auto machine = createMachine();
+    if (!machine)
+      return runtimeError("Cannot create target machine for " + targetTriple);
+    if (!target->hasMCAsmBackend())
+      return runtimeError("Target can't emit object files");
+
+    llvmModule->setTargetTriple(targetTriple);
+    llvmModule->setDataLayout(machine->createDataLayout());
+
+    // The first partition goes to `filename` and the others next to it, as
+    // name.1.o, name.2.o and so on, which must all be linked together.
+    if (partitions == 0)
+      partitions = 1;
+    if ((partitions > 1) && (filename == "-"))
+      return runtimeError("Cannot write several partitions to stdout");
+
+    // Empty filename is null output, as for the textual outputs
+    llvm::raw_null_ostream null;
+    llvm::SmallVector<std::unique_ptr<llvm::ToolOutputFile>, 4> outs;
+    llvm::SmallVector<llvm::raw_pwrite_stream*, 4> streams;
+    for (unsigned i = 0; i < partitions; i++)
+    {
+      if (filename.empty())
+      {
+        streams.push_back(&null);
+        continue;
+      }
+
+      llvm::SmallString<128> name(filename);
+      if (i > 0)
+      {
+        auto ext = llvm::sys::path::extension(filename).str();
+        llvm::sys::path::replace_extension(name, llvm::Twine(i) + ext);
+      }
+
+      std::error_code ec;
+      outs.push_back(std::make_unique<llvm::ToolOutputFile>(
+        name, ec, llvm::sys::fs::OF_None));
+      if (ec)
+        return runtimeError("Cannot open output filename " + name.str().str());
+      streams.push_back(&outs.back()->os());
+    }
+
+    // Split the module by function and generate code for the partitions in
+    // parallel, one thread each. A single partition is emitted on this
+    // thread, as before.
+    llvm::splitCodeGen(
+      *llvmModule, streams, {}, createMachine, llvm::CGFT_ObjectFile);
+
+    for (auto& out : outs)
+      out->keep();
+
+    return llvm::Error::success();
   }
 }
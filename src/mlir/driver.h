@@ -9,6 +9,7 @@
 #include "parser/ast.h"
 
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 
 namespace mlir::verona
@@ -17,7 +18,8 @@ namespace mlir::verona
    * Main compiler API.
    *
    * The two entry points are `readAST` and `readMLIR`.
-   * The intermediate steps are `optimiseMLIR` and `loweToLLVM`.
+   * The intermediate steps are `optimiseMLIR` and `loweToLLVM`, which links
+   * in any modules passed to `linkLLVM`.
    * The final step is `codeGeneration`.
    * The testing methods are `emitMLIR`, `emitLLVM` and `runLLVM`.
    *
@@ -49,7 +51,9 @@ namespace mlir::verona
   class Driver
   {
   public:
-    Driver(unsigned optLevel = 0);
+    /// Objects that runLLVM compiles are cached in `jitCache`, if it isn't
+    /// empty, and reused by later runs on the same module.
+    Driver(unsigned optLevel = 0, llvm::StringRef jitCache = "");
 
     /// Lower an AST into an MLIR module, which is loaded in the driver.
     /// Populates mlirModule
@@ -64,6 +68,31 @@ namespace mlir::verona
     /// For testing purposes only
     llvm::Error emitMLIR(const llvm::StringRef filename);
 
+    /// Link an LLVM IR module, textual or bitcode, into the LLVM module when
+    /// it is lowered, before it is optimised. This lets C++ functions
+    /// emitted by the interop layer be inlined into Verona code.
+    /// Must be called before lowerToLLVM
+    llvm::Error linkLLVM(const std::string& filename);
+
+    /// As above, for a module in memory, which may be in another context.
+    llvm::Error linkLLVM(const llvm::Module& module);
+
+    /// Instrument the LLVM module for profile-guided optimisation. The
+    /// program counts the blocks and edges it runs, and the targets of its
+    /// indirect calls, and writes them to `filename` when it exits. It must
+    /// be linked with the LLVM profile runtime, for example with clang's
+    /// -fprofile-instr-generate, so it can't be run by runLLVM.
+    /// Must be called before lowerToLLVM
+    llvm::Error instrumentProfile(llvm::StringRef filename);
+
+    /// Optimise the LLVM module with the profile in `filename`, merged from
+    /// the output of instrumentProfile by llvm-profdata. Branch weights then
+    /// guide block layout and inlining, and the hot targets of indirect
+    /// calls are promoted to direct calls. The module must be lowered at
+    /// the same optimisation level as the instrumented one.
+    /// Must be called before lowerToLLVM
+    llvm::Error useProfile(llvm::StringRef filename);
+
     /// Optimise the MLIR module in preparation for LLVM lowering
     /// Requires mlirModule
     llvm::Error optimiseMLIR();
@@ -83,10 +112,17 @@ namespace mlir::verona
     /// For testing purposes only
     llvm::Error runLLVM(int& returnValue);
 
-    /// Emits the object code for the target
-    /// TODO: Implement this functionality, needs target-triple, etc.
-    /// Argument is the final object filename
-    llvm::Error codeGeneration(const llvm::StringRef filename);
+    /// Emit the module as an object file for the target, which defaults to
+    /// the host. The CPU defaults to a generic one for the target, and
+    /// "native" selects the host's CPU and its features. More than one
+    /// partition splits the module and emits the partitions in parallel,
+    /// into filename and then name.1.o, name.2.o and so on.
+    /// Requires llvmModule
+    llvm::Error codeGeneration(
+      const llvm::StringRef filename,
+      const llvm::StringRef triple = "",
+      const llvm::StringRef cpu = "",
+      unsigned partitions = 1);
 
   private:
     /// MLIR context.
@@ -103,10 +139,35 @@ namespace mlir::verona
     /// It gets modified as the driver progresses through its passes.
     std::unique_ptr<llvm::Module> llvmModule;
 
+    /// LLVM IR to link into llvmModule before it is optimised.
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> linkBuffers;
+
     /// Optimisation level (for both MLIR and LLVM IRs)
     unsigned optLevel;
     bool mlirOptimised = false;
 
+    /// Profile-guided optimisation, see instrumentProfile and useProfile.
+    enum class Profile
+    {
+      None,
+      Generate,
+      Use
+    };
+    Profile profile = Profile::None;
+
+    /// Profile written by an instrumented program, or read to optimise.
+    std::string profileFile;
+
+    /// Instrument or annotate llvmModule, as `profile` asks.
+    llvm::Error applyProfile();
+
+    /// Directory of the JIT's object cache, or empty for none.
+    std::string jitCache;
+
+    /// Whether the JIT cache has an object for llvmModule, in which case
+    /// lowerToLLVM doesn't optimise it.
+    bool jitCached = false;
+
     /// MLIR Pass Manager
     /// It gets configured by the constructor based on the provided arguments.
     mlir::PassManager passManager;
@@ -0,0 +1,139 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "escape.h"
+
+#include "generator.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/BuiltinOps.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace
+{
+  using namespace mlir;
+
+  bool escapes(Value ref, llvm::SmallPtrSetImpl<Operation*>& locals);
+
+  /// Whether a reference stored in `local` escapes. It doesn't if the local
+  /// is only used as an address, and nothing loaded from it escapes.
+  bool escapesLocal(Value local, llvm::SmallPtrSetImpl<Operation*>& locals)
+  {
+    for (auto* user : local.getUsers())
+    {
+      if (auto load = dyn_cast<LLVM::LoadOp>(user))
+      {
+        if (escapes(load.res(), locals))
+          return true;
+      }
+      else if (auto store = dyn_cast<LLVM::StoreOp>(user))
+      {
+        if (store.value() == local)
+          return true;
+      }
+      else if (auto gep = dyn_cast<LLVM::GEPOp>(user))
+      {
+        if ((gep.base() != local) || escapesLocal(gep.res(), locals))
+          return true;
+      }
+      else
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Whether the object `ref` points to may be reachable after its function
+  /// returns. Locals already in `locals` are being checked, or have been.
+  bool escapes(Value ref, llvm::SmallPtrSetImpl<Operation*>& locals)
+  {
+    for (auto* user : ref.getUsers())
+    {
+      if (isa<LLVM::LoadOp>(user))
+        continue;
+
+      if (auto store = dyn_cast<LLVM::StoreOp>(user))
+      {
+        if (store.value() != ref)
+          continue;
+
+        // The reference itself is stored, which is fine for a local
+        auto local = store.addr().getDefiningOp<LLVM::AllocaOp>();
+        if (!local)
+          return true;
+        if (locals.insert(local).second && escapesLocal(local.res(), locals))
+          return true;
+      }
+      else if (auto gep = dyn_cast<LLVM::GEPOp>(user))
+      {
+        if ((gep.base() != ref) || escapes(gep.res(), locals))
+          return true;
+      }
+      else if (auto cast = dyn_cast<LLVM::BitcastOp>(user))
+      {
+        if (escapes(cast.res(), locals))
+          return true;
+      }
+      else
+      {
+        // Calls, returns, and anything we don't know about
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct StackPromotion
+  : public PassWrapper<StackPromotion, OperationPass<FuncOp>>
+  {
+    void runOnOperation() override
+    {
+      auto func = getOperation();
+      if (func.isExternal())
+        return;
+
+      llvm::SmallVector<CallOp> allocs;
+      for (auto& op : func.front())
+      {
+        auto call = dyn_cast<CallOp>(op);
+        if (call && (call.getCallee() == verona::allocFunction))
+          allocs.push_back(call);
+      }
+
+      for (auto call : allocs)
+      {
+        // The generator casts the allocation to the class right away
+        auto obj = call.getResult(0);
+        if (!obj.hasOneUse())
+          continue;
+        auto cast = dyn_cast<LLVM::BitcastOp>(*obj.getUsers().begin());
+        if (!cast)
+          continue;
+
+        llvm::SmallPtrSet<Operation*, 4> locals;
+        if (escapes(cast.res(), locals))
+          continue;
+
+        // The region and size become dead, and are left to the canonicaliser
+        OpBuilder builder(call);
+        auto loc = call.getLoc();
+        Value one = builder.create<ConstantIntOp>(loc, 1, 32);
+        auto alloca = builder.create<LLVM::AllocaOp>(loc, cast.getType(), one);
+        cast.res().replaceAllUsesWith(alloca.res());
+        cast.erase();
+        call.erase();
+      }
+    }
+  };
+}
+
+namespace mlir::verona
+{
+  std::unique_ptr<Pass> createStackPromotionPass()
+  {
+    return std::make_unique<StackPromotion>();
+  }
+}
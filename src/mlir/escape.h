@@ -0,0 +1,27 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "mlir/Pass/Pass.h"
+
+#include <memory>
+
+namespace mlir::verona
+{
+  /**
+   * Stack promotion
+   *
+   * `new` allocates objects with a call to the runtime (see
+   * MLIRGenerator::New), in the region given with `@` or in a new region.
+   * An object that can't be reached once its function returns never needs
+   * to be in a region, so this pass replaces its allocation with an alloca.
+   *
+   * An object escapes if a reference to it is passed to a call, returned,
+   * or stored anywhere other than a local, or if it is loaded back from a
+   * local and then escapes. Fields can be read and written freely. Only
+   * allocations in the entry block are promoted, so that loops don't grow
+   * the stack.
+   */
+  std::unique_ptr<Pass> createStackPromotionPass();
+}
@@ -0,0 +1,143 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "forwarding.h"
+
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace
+{
+  using namespace mlir;
+
+  /// The alloca an address is derived from, or null if there isn't one.
+  LLVM::AllocaOp root(Value addr)
+  {
+    while (auto gep = addr.getDefiningOp<LLVM::GEPOp>())
+      addr = gep.base();
+    return addr.getDefiningOp<LLVM::AllocaOp>();
+  }
+
+  /// Addresses may alias unless they come from different allocas.
+  bool mayAlias(Value a, Value b)
+  {
+    auto ra = root(a);
+    auto rb = root(b);
+    return !ra || !rb || (ra == rb);
+  }
+
+  /// Forward values through memory within a block.
+  void forward(Block& block)
+  {
+    // The value known to be at each address, from a store or a load.
+    llvm::DenseMap<Value, Value> known;
+
+    for (auto& op : llvm::make_early_inc_range(block))
+    {
+      if (auto load = dyn_cast<LLVM::LoadOp>(op))
+      {
+        auto it = known.find(load.addr());
+        if (it != known.end())
+        {
+          load.res().replaceAllUsesWith(it->second);
+          load.erase();
+          continue;
+        }
+        known[load.addr()] = load.res();
+      }
+      else if (auto store = dyn_cast<LLVM::StoreOp>(op))
+      {
+        auto it = known.find(store.addr());
+        if ((it != known.end()) && (it->second == store.value()))
+        {
+          store.erase();
+          continue;
+        }
+
+        // Forget anything this store may overwrite
+        llvm::SmallVector<Value> clobbered;
+        for (auto& entry : known)
+        {
+          if (mayAlias(entry.first, store.addr()))
+            clobbered.push_back(entry.first);
+        }
+        for (auto addr : clobbered)
+          known.erase(addr);
+        known[store.addr()] = store.value();
+      }
+      else if (
+        !isa<LLVM::AllocaOp>(op) &&
+        ((op.getNumRegions() > 0) ||
+         !MemoryEffectOpInterface::hasNoEffect(&op)))
+      {
+        // Calls and anything else that may write to memory
+        known.clear();
+      }
+    }
+  }
+
+  /// Collects the users of an address, through GEPs, if they are all stores
+  /// to it, in the order they can be erased. Returns false if the address is
+  /// read or escapes.
+  bool onlyStored(Value addr, llvm::SmallVectorImpl<Operation*>& dead)
+  {
+    for (auto* user : addr.getUsers())
+    {
+      if (auto store = dyn_cast<LLVM::StoreOp>(user))
+      {
+        if (store.value() == addr)
+          return false;
+        dead.push_back(user);
+      }
+      else if (auto gep = dyn_cast<LLVM::GEPOp>(user))
+      {
+        if (!onlyStored(gep.res(), dead))
+          return false;
+        dead.push_back(user);
+      }
+      else
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  struct StoreForwarding
+  : public PassWrapper<StoreForwarding, OperationPass<FuncOp>>
+  {
+    void runOnOperation() override
+    {
+      auto func = getOperation();
+      for (auto& block : func.getBlocks())
+        forward(block);
+
+      llvm::SmallVector<LLVM::AllocaOp> allocas;
+      func.walk([&](LLVM::AllocaOp alloca) { allocas.push_back(alloca); });
+
+      for (auto alloca : allocas)
+      {
+        llvm::SmallVector<Operation*> dead;
+        if (!onlyStored(alloca.res(), dead))
+          continue;
+
+        for (auto* op : dead)
+          op->erase();
+        alloca.erase();
+      }
+    }
+  };
+}
+
+namespace mlir::verona
+{
+  std::unique_ptr<Pass> createStoreForwardingPass()
+  {
+    return std::make_unique<StoreForwarding>();
+  }
+}
@@ -0,0 +1,27 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "mlir/Pass/Pass.h"
+
+#include <memory>
+
+namespace mlir::verona
+{
+  /**
+   * Store forwarding
+   *
+   * The generator keeps every local in an alloca, and loads from it or stores
+   * to it on every access (see MLIRGenerator::AutoLoad and Store). Within a
+   * block, this pass replaces loads of an address with the value last stored
+   * to or loaded from it, and removes stores of the value already there.
+   * Allocas that are then only stored to are removed, with their stores.
+   *
+   * Addresses are compared by value, so CSE should run first to merge the
+   * GEPs that each access creates. Addresses from different allocas never
+   * alias, and anything else that might write to memory forgets what is
+   * known.
+   */
+  std::unique_ptr<Pass> createStoreForwardingPass();
+}
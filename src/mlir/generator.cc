@@ -10,6 +10,14 @@
 
 #include <string>
 
+namespace
+{
+  /// Comparisons are named after the op and its predicate, as in
+  /// "std.cmpi.slt" and "std.cmpf.olt".
+  constexpr llvm::StringLiteral cmpi = "std.cmpi.";
+  constexpr llvm::StringLiteral cmpf = "std.cmpf.";
+}
+
 namespace mlir::verona
 {
   size_t MLIRGenerator::numArithmeticOps(llvm::StringRef name)
@@ -19,8 +27,14 @@ namespace mlir::verona
     // need for generic lowering. We should probably use the LLVM dialect + LLVM
     // intrinsic calls for the rest.
 
-    // TODO: Add comparators
-    // TODO: Add llvm intrinsics
+    if (name.startswith(cmpi))
+      return symbolizeCmpIPredicate(name.drop_front(cmpi.size())) ? 2 : 0;
+    if (name.startswith(cmpf))
+      return symbolizeCmpFPredicate(name.drop_front(cmpf.size())) ? 2 : 0;
+
+    // Element-wise ops also take vectors of the same shape. LLVM intrinsics
+    // are used for what the standard dialect doesn't have, and reductions
+    // take a vector and return its element type.
     return llvm::StringSwitch<size_t>(name)
       .Case("std.absf", 1)
       .Case("std.ceilf", 1)
@@ -43,7 +57,7 @@ namespace mlir::verona
       .Case("std.and", 2)
       .Case("std.or", 2)
       .Case("std.xor", 2)
-      .Case("std.select", 2)
+      .Case("std.select", 3)
       .Case("std.shift_left", 2)
       .Case("std.shift_right_signed", 2)
       .Case("std.shift_right_unsigned", 2)
@@ -57,6 +71,31 @@ namespace mlir::verona
       .Case("std.fptoui", 1)
       .Case("std.sitofp", 1)
       .Case("std.uitofp", 1)
+      .Case("std.splat", 1)
+      .Case("llvm.intr.fabs", 1)
+      .Case("llvm.intr.sqrt", 1)
+      .Case("llvm.intr.ceil", 1)
+      .Case("llvm.intr.floor", 1)
+      .Case("llvm.intr.exp", 1)
+      .Case("llvm.intr.log", 1)
+      .Case("llvm.intr.ctpop", 1)
+      .Case("llvm.intr.bitreverse", 1)
+      .Case("llvm.intr.copysign", 2)
+      .Case("llvm.intr.minnum", 2)
+      .Case("llvm.intr.maxnum", 2)
+      .Case("llvm.intr.pow", 2)
+      .Case("llvm.intr.fma", 3)
+      .Case("llvm.intr.vector.reduce.add", 1)
+      .Case("llvm.intr.vector.reduce.mul", 1)
+      .Case("llvm.intr.vector.reduce.and", 1)
+      .Case("llvm.intr.vector.reduce.or", 1)
+      .Case("llvm.intr.vector.reduce.xor", 1)
+      .Case("llvm.intr.vector.reduce.smax", 1)
+      .Case("llvm.intr.vector.reduce.smin", 1)
+      .Case("llvm.intr.vector.reduce.umax", 1)
+      .Case("llvm.intr.vector.reduce.umin", 1)
+      .Case("llvm.intr.vector.reduce.fmax", 1)
+      .Case("llvm.intr.vector.reduce.fmin", 1)
       .Default(0);
   }
 
@@ -191,6 +230,38 @@ namespace mlir::verona
     return builder.create<LLVM::AllocaOp>(loc, pointerTy, len);
   }
 
+  Value MLIRGenerator::New(Location loc, StructType type, Value region)
+  {
+    auto pointerTy = PointerType::get(type);
+    auto bytesTy = PointerType::get(builder.getIntegerType(8));
+    auto sizeTy = builder.getI64Type();
+
+    // Declare the runtime function on first use
+    auto alloc = module->lookupSymbol<FuncOp>(allocFunction);
+    if (!alloc)
+    {
+      auto allocTy = builder.getFunctionType({bytesTy, sizeTy}, {bytesTy});
+      alloc = FuncOp::create(builder.getUnknownLoc(), allocFunction, allocTy);
+      alloc.setPrivate();
+      module->push_back(alloc);
+    }
+
+    // The size of the object is the address of the second element of an
+    // array of them at null, which LLVM folds to a constant.
+    Value null = builder.create<LLVM::NullOp>(loc, pointerTy);
+    Value one = Constant(builder.getI32Type(), 1);
+    Value end = builder.create<LLVM::GEPOp>(loc, pointerTy, null, one);
+    Value size = builder.create<LLVM::PtrToIntOp>(loc, sizeTy, end);
+
+    if (region)
+      region = builder.create<LLVM::BitcastOp>(loc, bytesTy, region);
+    else
+      region = builder.create<LLVM::NullOp>(loc, bytesTy);
+
+    auto obj = Call(loc, alloc, {region, size});
+    return builder.create<LLVM::BitcastOp>(loc, pointerTy, obj);
+  }
+
   Value MLIRGenerator::GEP(Location loc, Value addr, std::optional<int> offset)
   {
     llvm::SmallVector<Value> offsetList;
@@ -372,7 +443,6 @@ namespace mlir::verona
     // or if we declare it on the fly and then clean up when we remove the
     // call.
     auto numOps = numArithmeticOps(name);
-    // FIXME: Implement call to intrinsics, too
     assert(numOps && "Unknown arithmetic operation");
 
     auto getOperand = [this, loc, ops](size_t offset) {
@@ -381,39 +451,56 @@ namespace mlir::verona
     };
 
     llvm::SmallVector<Value> values;
-    switch (numOps)
+    if (numOps == 1)
     {
-      case 1:
-        // Update operands and return type
-        values.push_back(ops);
-        if (!retTy)
-          retTy = ops.getType();
-        break;
-      case 2:
-      {
-        auto structTy = getPointedStructType(ops, /*anonymous*/ true);
-        // Make sure this is a tuple
-        assert(
-          structTy && structTy.getBody().size() == 2 &&
-          "Binary op needs two operands");
+      // Update operands and return type
+      values.push_back(ops);
+      if (!retTy)
+        retTy = ops.getType();
+
+      // Reductions return the element type. Splats need the result type
+      // from their assignment.
+      auto vecTy = retTy.dyn_cast<VectorType>();
+      if (vecTy && name.startswith("llvm.intr.vector.reduce."))
+        retTy = vecTy.getElementType();
+    }
+    else
+    {
+      auto structTy = getPointedStructType(ops, /*anonymous*/ true);
+      // Make sure this is a tuple
+      assert(
+        structTy && structTy.getBody().size() == numOps &&
+        "Wrong number of operands");
 
-        // Get both operands from a tuple
-        auto lhs = getOperand(0);
-        auto rhs = getOperand(1);
+      // Get all operands from a tuple
+      for (size_t i = 0; i < numOps; i++)
+        values.push_back(getOperand(i));
 
-        // Make sure the types are the same
+      // Make sure the types are the same, except for the condition of a
+      // select
+      size_t first = (name == "std.select") ? 1 : 0;
+      for (size_t i = first + 1; i < numOps; i++)
+      {
         assert(
-          lhs.getType() == rhs.getType() && "Binop types must be identical");
-
-        // Update operands and return type
-        values.append({lhs, rhs});
-        if (!retTy)
-          retTy = rhs.getType();
-        break;
+          values[i].getType() == values[first].getType() &&
+          "Operand types must be identical");
       }
-      default:
-        assert(false && "Unsupported arithmetic operation");
-        return Value();
+
+      // Update return type
+      if (!retTy)
+        retTy = values.back().getType();
+    }
+
+    // Comparisons need their predicate, and return i1 or a vector of i1
+    if (name.startswith(cmpi))
+    {
+      auto pred = symbolizeCmpIPredicate(name.drop_front(cmpi.size()));
+      return builder.create<CmpIOp>(loc, *pred, values[0], values[1]);
+    }
+    if (name.startswith(cmpf))
+    {
+      auto pred = symbolizeCmpFPredicate(name.drop_front(cmpf.size()));
+      return builder.create<CmpFOp>(loc, *pred, values[0], values[1]);
     }
 
     // If the operation is known, lower as MLIR op
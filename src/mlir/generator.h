@@ -20,6 +20,11 @@ namespace mlir::verona
   using PointerType = mlir::LLVM::LLVMPointerType;
   using ArrayType = mlir::LLVM::LLVMArrayType;
 
+  /// Runtime function that allocates objects, as `i8* (i8* region, i64
+  /// size)`. A null region allocates the object in a new region, of which it
+  /// is the entry point.
+  constexpr llvm::StringLiteral allocFunction = "__verona_alloc";
+
   /**
    * MLIR Generator.
    *
@@ -119,6 +124,10 @@ namespace mlir::verona
     /// Generates an alloca (stack variable)
     Value Alloca(Location loc, Type ty);
 
+    /// Generates an allocation of an object of a class, in `region` if it is
+    /// set, or in a new region otherwise. The fields are uninitialised.
+    Value New(Location loc, StructType type, Value region = Value());
+
     /// Generates an element pointer
     Value GEP(Location loc, Value addr, std::optional<int> offset = {});
 
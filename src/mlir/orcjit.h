@@ -5,6 +5,7 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
@@ -15,11 +16,83 @@
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <memory>
 
 namespace llvm::orc
 {
+  /**
+   * Object cache for the JIT, kept on disk across runs.
+   *
+   * Objects are stored in `Dir` by module identifier, so the identifier must
+   * be a key that covers everything that affects the object: the module, the
+   * optimisation level and the target. The driver sets it to such a hash.
+   *
+   * Objects are written to a temporary file and renamed into place, so that
+   * concurrent runs never see a partial object.
+   */
+  class VeronaObjectCache : public ObjectCache
+  {
+  private:
+    std::string Dir;
+
+    SmallString<128> getPath(const Module* M)
+    {
+      SmallString<128> Path(Dir);
+      sys::path::append(Path, M->getModuleIdentifier() + ".o");
+      return Path;
+    }
+
+  public:
+    VeronaObjectCache(StringRef Dir) : Dir(Dir.str()) {}
+
+    bool hasObject(const Module* M)
+    {
+      return sys::fs::exists(getPath(M));
+    }
+
+    void notifyObjectCompiled(const Module* M, MemoryBufferRef Obj) override
+    {
+      // The cache is only an optimisation, so failing to write is ignored.
+      if (sys::fs::create_directories(Dir))
+        return;
+
+      int FD;
+      SmallString<128> Temp;
+      SmallString<128> Model(Dir);
+      sys::path::append(Model, "%%%%%%%%.tmp");
+      if (sys::fs::createUniqueFile(Model, FD, Temp))
+        return;
+
+      {
+        raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        OS << Obj.getBuffer();
+        if (OS.has_error())
+        {
+          OS.clear_error();
+          sys::fs::remove(Temp);
+          return;
+        }
+      }
+
+      if (sys::fs::rename(Temp, getPath(M)))
+        sys::fs::remove(Temp);
+    }
+
+    std::unique_ptr<MemoryBuffer> getObject(const Module* M) override
+    {
+      auto Obj = MemoryBuffer::getFile(getPath(M));
+      if (!Obj)
+        return nullptr;
+      return std::move(*Obj);
+    }
+  };
+
   /**
    * Verona JIT Executor
    *
@@ -31,6 +104,8 @@ namespace llvm::orc
    * 1. Create the JIT via static function:
    *    auto J = VeronaJIT::Create();
    *
+   *    Pass an ObjectCache to reuse objects compiled by earlier runs.
+   *
    * 2. Provide a thread-safe LLVM module:
    *    ThreadSafeModule TSM(mod, context);
    *    J->addModule(TSM);
@@ -61,7 +136,8 @@ namespace llvm::orc
     VeronaJIT(
       std::unique_ptr<ExecutionSession> ES,
       JITTargetMachineBuilder JTMB,
-      DataLayout DL)
+      DataLayout DL,
+      ObjectCache* Cache = nullptr)
     : ES(std::move(ES)),
       DL(std::move(DL)),
       Mangle(*this->ES, this->DL),
@@ -70,7 +146,7 @@ namespace llvm::orc
       CompileLayer(
         *this->ES,
         ObjectLayer,
-        std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
+        std::make_unique<ConcurrentIRCompiler>(std::move(JTMB), Cache)),
       MainJD(this->ES->createBareJITDylib("<main>"))
     {
       MainJD.addGenerator(
@@ -86,7 +162,9 @@ namespace llvm::orc
         ES->reportError(std::move(Err));
     }
 
-    static Expected<std::unique_ptr<VeronaJIT>> Create()
+    /// The cache, if any, must outlive the JIT.
+    static Expected<std::unique_ptr<VeronaJIT>>
+    Create(ObjectCache* Cache = nullptr)
     {
       auto EPC = SelfExecutorProcessControl::Create();
       if (!EPC)
@@ -102,7 +180,7 @@ namespace llvm::orc
         return DL.takeError();
 
       return std::make_unique<VeronaJIT>(
-        std::move(ES), std::move(JTMB), std::move(*DL));
+        std::move(ES), std::move(JTMB), std::move(*DL), Cache);
     }
 
     const DataLayout& getDataLayout() const
@@ -5,16 +5,16 @@
 #include "driver.h"
 #include "mlir/InitAllDialects.h"
 #include "mlir/InitAllPasses.h"
-#include "parser/anf.h"
-#include "parser/dnf.h"
+#include "parser/binary.h"
 #include "parser/parser.h"
-#include "parser/resolve.h"
+#include "parser/passes.h"
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/Path.h"
 
+#include <fstream>
 #include <iostream>
 
 using namespace std;
@@ -41,6 +41,7 @@ namespace
   {
     None,
     Verona,
+    AST,
     MLIR
   };
   /// Source file kind option
@@ -49,6 +50,8 @@ namespace
     cl::init(InputKind::None),
     cl::desc("Input type"),
     cl::values(clEnumValN(InputKind::Verona, "verona", "Verona file")),
+    cl::values(clEnumValN(
+      InputKind::AST, "ast", "Verona AST file (from verona-parser -n -b)")),
     cl::values(clEnumValN(InputKind::MLIR, "mlir", "MLIR file")));
 
   /// Optimisations enabled
@@ -63,12 +66,60 @@ namespace
   /// Which output to emit
   cl::opt<std::string> outputFmt(
     "out",
-    cl::desc("Output format [mlir, ll, jit] "
+    cl::desc("Output format [mlir, ll, o, jit] "
              "(default = 'mlir')"),
     cl::Prefix,
     cl::ZeroOrMore,
     cl::init("mlir"));
 
+  /// Target triple for object files
+  cl::opt<std::string> targetTriple(
+    "mtriple",
+    cl::desc("Target triple for object files (default = host)"),
+    cl::init(""),
+    cl::value_desc("triple"));
+
+  /// Target CPU for object files
+  cl::opt<std::string> targetCPU(
+    "mcpu",
+    cl::desc("Target CPU for object files, or native (default = generic)"),
+    cl::init(""),
+    cl::value_desc("cpu"));
+
+  /// Parallel code generation for object files
+  cl::opt<unsigned> codegenThreads(
+    "codegen-threads",
+    cl::desc("Split object files into this many partitions, generated in "
+             "parallel (default = 1)"),
+    cl::init(1),
+    cl::value_desc("n"));
+
+  /// Object cache for the JIT
+  cl::opt<std::string> jitCache(
+    "jit-cache",
+    cl::desc("Directory to cache JIT objects in across runs (default = none)"),
+    cl::init(""),
+    cl::value_desc("dir"));
+
+  /// LLVM IR to link in before optimisation, such as interop wrappers
+  cl::list<std::string> linkFiles(
+    "link",
+    cl::desc("LLVM IR files to link in before optimisation"),
+    cl::CommaSeparated,
+    cl::value_desc("filenames"));
+
+  /// Profile-guided optimisation, with the names clang uses
+  cl::opt<std::string> profileGenerate(
+    "fprofile-generate",
+    cl::desc("Instrument the program to write a raw profile to this file"),
+    cl::init(""),
+    cl::value_desc("filename"));
+  cl::opt<std::string> profileUse(
+    "fprofile-use",
+    cl::desc("Optimise with this profile, merged by llvm-profdata"),
+    cl::init(""),
+    cl::value_desc("filename"));
+
   /// Test only, redirect output to /dev/null
   cl::opt<bool> testOnly(
     "t", cl::desc("Test only (no output)"), cl::Optional, cl::init(false));
@@ -76,6 +127,20 @@ namespace
   /// Output file name (- means stdout)
   cl::opt<std::string> outputFile("o", cl::init(""), cl::desc("Output file"));
 
+  /// Print the time and nodes taken by each phase of the front end
+  cl::opt<bool> parserStats(
+    "parser-stats",
+    cl::desc("Print the time and nodes taken by each front end phase"),
+    cl::Optional,
+    cl::init(false));
+
+  /// Write the front end phases as JSON
+  cl::opt<std::string> parserStatsJson(
+    "parser-stats-json",
+    cl::desc("Write the front end phases as JSON to this file"),
+    cl::init(""),
+    cl::value_desc("filename"));
+
   /// Appends .new to extension if the new extension is the same
   void addExtension(llvm::SmallString<128>& name, llvm::StringRef ext)
   {
@@ -95,6 +160,8 @@ namespace
       llvm::StringRef filename(inputFile);
       if (filename.endswith(".verona"))
         inputKind = InputKind::Verona;
+      else if (filename.endswith(".vast"))
+        inputKind = InputKind::AST;
       else if (filename.endswith(".mlir"))
         inputKind = InputKind::MLIR;
       else if (filename == "-") // STDIN, assume Verona
@@ -170,12 +237,16 @@ int main(int argc, char** argv)
   if (inputKind == InputKind::None)
   {
     std::cerr << "ERROR: Unknown source type for '" << inputFile
-              << "'. Must be [verona, mlir]" << std::endl;
+              << "'. Must be [verona, ast, mlir]" << std::endl;
     return 1;
   }
 
-  mlir::verona::Driver driver(optLevel);
+  mlir::verona::Driver driver(
+    optLevel, outputFmt == "jit" ? jitCache.getValue() : "");
   llvm::ExitOnError check;
+  Stats phases;
+  auto measure =
+    (parserStats || !parserStatsJson.empty()) ? &phases : nullptr;
 
   // Parse the source file (verona/mlir)
   mlir::OwningModuleRef module;
@@ -186,16 +257,14 @@ int main(int argc, char** argv)
     {
       // Parse the file
       auto stdlibpath = getStdLibPath(argv[0]);
-      auto [ok, ast] = parse(inputFile, stdlibpath);
-      ok = ok && dnf::wellformed(ast);
+      auto [ok, ast] =
+        parse(inputFile, stdlibpath, std::cerr, nullptr, measure);
 
-      // Resolve types
-      ok = ok && resolve::run(ast);
-      ok = ok && resolve::wellformed(ast);
-
-      // Convert to A-norm
-      ok = ok && anf::run(ast);
-      ok = ok && anf::wellformed(ast);
+      // Resolve types and convert to A-norm
+      passes::Options options;
+      options.validate = true;
+      options.anf = true;
+      ok = ok && passes::run(ast, options, measure);
 
       if (!ok)
       {
@@ -205,7 +274,24 @@ int main(int argc, char** argv)
       }
 
       // Parse AST file into MLIR
+      Stats::Stopwatch watch;
+      check(driver.readAST(ast));
+      phases.add("mlir", watch);
+    }
+    break;
+    case InputKind::AST:
+    {
+      // Read an AST that has already been through the passes above
+      Stats::Stopwatch read;
+      auto [ok, ast] = binary::read(inputFile);
+
+      if (!ok)
+        return 1;
+
+      phases.add("read", read);
+      Stats::Stopwatch watch;
       check(driver.readAST(ast));
+      phases.add("mlir", watch);
     }
     break;
     case InputKind::MLIR:
@@ -217,6 +303,13 @@ int main(int argc, char** argv)
       return 1;
   }
 
+  for (auto& file : linkFiles)
+    check(driver.linkLLVM(file));
+  if (!profileGenerate.empty())
+    check(driver.instrumentProfile(profileGenerate));
+  if (!profileUse.empty())
+    check(driver.useProfile(profileUse));
+
   // Dumps the module in the chosen format
   if (outputFmt == "mlir")
   {
@@ -226,6 +319,11 @@ int main(int argc, char** argv)
   {
     check(driver.emitLLVM(outputFile));
   }
+  else if (outputFmt == "o")
+  {
+    check(driver.codeGeneration(
+      outputFile, targetTriple, targetCPU, codegenThreads));
+  }
   else if (outputFmt == "jit")
   {
     int returnValue = 0;
@@ -239,5 +337,20 @@ int main(int argc, char** argv)
     return 1;
   }
 
+  if (parserStats)
+    std::cerr << phases;
+
+  if (!parserStatsJson.empty())
+  {
+    std::ofstream f(parserStatsJson.c_str());
+    phases.json(f);
+
+    if (!f)
+    {
+      std::cerr << "ERROR: cannot write file " << parserStatsJson << std::endl;
+      return 1;
+    }
+  }
+
   return 0;
 }
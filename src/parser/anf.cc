@@ -1,162 +1,147 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
-#include "ident.h"
+#include "anf.h"
+
 #include "lookup.h"
 #include "resolve.h"
-#include "rewrite.h"
 
 namespace verona::parser::anf
 {
-  struct ANF : Pass<ANF>
+  ANF::ANF()
   {
-    AST_PASS;
+    name_eq = ident("==");
+    name_requires = ident("requires");
+  }
 
-    struct State
-    {
-      Node<Lambda> lambda;
-      List<Expr> anf;
-      size_t hygienic;
-    };
+  void ANF::make_trivial()
+  {
+    // Do nothing if the expression occurs outside of a lambda.
+    // TODO: these are initexprs, need to account for them somehow.
+    if (state_stack.empty())
+      return;
+
+    auto& state = state_stack.back();
+    auto expr = node_cast<Expr>(stack.back());
 
-    std::vector<State> state_stack;
-    Ident ident;
-    Location name_eq;
-    Location name_requires;
+    // Don't change params or refs.
+    if (is_kind(expr, {Kind::Param, Kind::Ref}))
+      return;
 
-    ANF()
+    if (parent()->kind() == Kind::Lambda)
     {
-      name_eq = ident("==");
-      name_requires = ident("requires");
+      // The result of this expression isn't used. Add it as-is.
+      state.anf.push_back(expr);
+      return;
     }
 
-    void make_trivial()
+    if (expr->kind() == Kind::Oftype)
     {
-      // Do nothing if the expression occurs outside of a lambda.
-      // TODO: these are initexprs, need to account for them somehow.
-      if (state_stack.empty())
-        return;
-
-      auto& state = state_stack.back();
-      auto expr = std::static_pointer_cast<Expr>(stack.back());
+      // Lift oftype nodes and leave their contents in place.
+      state.anf.push_back(expr);
+      replace(expr->as<Oftype>().expr);
+      return;
+    }
 
-      // Don't change params or refs.
-      if (is_kind(expr, {Kind::Param, Kind::Ref}))
-        return;
+    if (is_kind(expr, {Kind::Let, Kind::Var}))
+    {
+      // Lift variable declarations and leave a reference in their place.
+      state.anf.push_back(expr);
+      auto ref = make_node<Ref>();
+      ref->location = expr->location;
+      replace(ref);
+      return;
+    }
 
-      if (parent()->kind() == Kind::Lambda)
-      {
-        // The result of this expression isn't used. Add it as-is.
-        state.anf.push_back(expr);
-        return;
-      }
+    if (parent()->kind() == Kind::Assign)
+    {
+      // If this expression is the right-hand side of an assignment, leave
+      // it in place.
+      auto& asn = parent()->as<Assign>();
 
-      if (expr->kind() == Kind::Oftype)
-      {
-        // Lift oftype nodes and leave their contents in place.
-        state.anf.push_back(expr);
-        rewrite(stack, expr->as<Oftype>().expr);
+      if (asn.right == expr)
         return;
-      }
-
-      if (is_kind(expr, {Kind::Let, Kind::Var}))
-      {
-        // Lift variable declarations and leave a reference in their place.
-        state.anf.push_back(expr);
-        auto ref = std::make_shared<Ref>();
-        ref->location = expr->location;
-        rewrite(stack, ref);
-        return;
-      }
-
-      if (parent()->kind() == Kind::Assign)
-      {
-        // If this expression is the right-hand side of an assignment, leave
-        // it in place.
-        auto& asn = parent()->as<Assign>();
-
-        if (asn.right == expr)
-          return;
-      }
-
-      // Append (assign (let $x) expr) to the body.
-      auto let = std::make_shared<Let>();
-      let->location = ident();
-      state.lambda->symbol_table()->set(let->location, let);
-
-      auto asn = std::make_shared<Assign>();
-      asn->location = expr->location;
-      asn->left = let;
-      asn->right = expr;
-      state.anf.push_back(asn);
-
-      // Replace expr with (ref $x)
-      auto ref = std::make_shared<Ref>();
-      ref->location = let->location;
-
-      rewrite(stack, ref);
     }
 
-    void post(Expr& expr)
-    {
-      make_trivial();
-    }
+    // Append (assign (let $x) expr) to the body.
+    auto let = make_node<Let>();
+    let->location = ident();
+    state.lambda->symbol_table()->set(let->location, let);
 
-    void pre(Lambda& lambda)
-    {
-      state_stack.push_back(
-        {std::static_pointer_cast<Lambda>(stack.back()), {}, ident.hygienic});
-      ident.hygienic = 0;
+    auto asn = make_node<Assign>();
+    asn->location = expr->location;
+    asn->left = let;
+    asn->right = expr;
+    state.anf.push_back(asn);
 
-      // Turn patterns into parameters.
-      auto& state = state_stack.back();
+    // Replace expr with (ref $x)
+    auto ref = make_node<Ref>();
+    ref->location = let->location;
 
-      for (auto& expr : lambda.params)
-      {
-        if (expr->kind() == Kind::Param)
-          continue;
+    replace(ref);
+  }
 
-        auto param = std::make_shared<Param>();
-        param->location = ident();
-        lambda.symbol_table()->set(param->location, param);
+  void ANF::post(Expr& expr)
+  {
+    make_trivial();
+  }
 
-        auto ref = std::make_shared<Ref>();
-        ref->location = param->location;
+  void ANF::pre(Lambda& lambda)
+  {
+    state_stack.push_back(
+      {node_cast<Lambda>(stack.back()), {}, ident.hygienic});
+    ident.hygienic = 0;
 
-        auto eq = std::make_shared<TypeName>();
-        eq->location = name_eq;
+    // Turn patterns into parameters.
+    auto& state = state_stack.back();
 
-        auto eq_sel = std::make_shared<Select>();
-        eq_sel->expr = expr;
-        eq_sel->location = expr->location;
-        eq_sel->typenames.push_back(eq);
-        eq_sel->args = ref;
+    for (auto& expr : lambda.params)
+    {
+      if (expr->kind() == Kind::Param)
+        continue;
 
-        auto req = std::make_shared<TypeName>();
-        req->location = name_requires;
+      auto param = make_node<Param>();
+      param->location = ident();
+      lambda.symbol_table()->set(param->location, param);
 
-        auto req_sel = std::make_shared<Select>();
-        req_sel->location = expr->location;
-        req_sel->typenames.push_back(req);
-        req_sel->args = eq_sel;
-        state.anf.push_back(req_sel);
+      auto ref = make_node<Ref>();
+      ref->location = param->location;
 
-        expr = param;
-      }
+      auto eq = make_node<TypeName>();
+      eq->location = name_eq;
 
-      lambda.body.insert(
-        lambda.body.begin(), state.anf.begin(), state.anf.end());
-      state.anf.clear();
-    }
+      auto eq_sel = make_node<Select>();
+      eq_sel->expr = expr;
+      eq_sel->location = expr->location;
+      eq_sel->typenames.push_back(eq);
+      eq_sel->args = ref;
 
-    void post(Lambda& lambda)
-    {
-      auto& state = state_stack.back();
-      lambda.body = state.anf;
-      ident.hygienic = state.hygienic;
-      state_stack.pop_back();
-      make_trivial();
+      auto req = make_node<TypeName>();
+      req->location = name_requires;
+
+      auto req_sel = make_node<Select>();
+      req_sel->location = expr->location;
+      req_sel->typenames.push_back(req);
+      req_sel->args = eq_sel;
+      state.anf.push_back(req_sel);
+
+      expr = param;
     }
-  };
+
+    lambda.body.insert(lambda.body.begin(), state.anf.begin(), state.anf.end());
+    state.anf.clear();
+
+    // The body has at least as many expressions once it is in ANF.
+    state.anf.reserve(lambda.body.size());
+  }
+
+  void ANF::post(Lambda& lambda)
+  {
+    auto& state = state_stack.back();
+    lambda.body = std::move(state.anf);
+    ident.hygienic = state.hygienic;
+    state_stack.pop_back();
+    make_trivial();
+  }
 
   bool run(Ast& ast, std::ostream& out)
   {
@@ -165,11 +150,6 @@ namespace verona::parser::anf
     return r << ast;
   }
 
-  struct WF : Pass<WF>
-  {
-    AST_PASS;
-  };
-
   bool wellformed(Ast& ast, std::ostream& out)
   {
     WF wf;
@@ -2,10 +2,42 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "ident.h"
 #include "pass.h"
 
 namespace verona::parser::anf
 {
+  // This turns lambda bodies into A-normal form, where every expression that
+  // isn't trivial is assigned to a new variable.
+  struct ANF : Pass<ANF>
+  {
+    AST_PASS;
+
+    struct State
+    {
+      Node<Lambda> lambda;
+      List<Expr> anf;
+      size_t hygienic;
+    };
+
+    std::vector<State> state_stack;
+    Ident ident;
+    Location name_eq;
+    Location name_requires;
+
+    ANF();
+
+    void make_trivial();
+    void post(Expr& expr);
+    void pre(Lambda& lambda);
+    void post(Lambda& lambda);
+  };
+
+  struct WF : Pass<WF>
+  {
+    AST_PASS;
+  };
+
   bool run(Ast& ast, std::ostream& out = std::cerr);
   bool wellformed(Ast& ast, std::ostream& out = std::cerr);
 }
@@ -2,8 +2,53 @@
 // SPDX-License-Identifier: MIT
 #include "ast.h"
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
 namespace verona::parser
 {
+  constexpr size_t arena_chunk = 64 * 1024;
+
+  // The chunks of every thread's arena, so that they are freed at exit.
+  std::mutex arena_lock;
+  std::vector<std::unique_ptr<char[]>> arena_chunks;
+
+  thread_local uintptr_t arena_next = 0;
+  thread_local uintptr_t arena_end = 0;
+  thread_local ArenaUse arena_used;
+
+  void* arena_alloc(size_t size, size_t align)
+  {
+    arena_used.allocations++;
+    arena_used.bytes += size;
+    auto p = (arena_next + align - 1) & ~(align - 1);
+
+    if ((arena_next == 0) || (p + size > arena_end))
+    {
+      // Start a new chunk, leaving the rest of the current one unused.
+      auto len = std::max(arena_chunk, size + align);
+      auto chunk = new char[len];
+
+      {
+        std::lock_guard<std::mutex> guard(arena_lock);
+        arena_chunks.emplace_back(chunk);
+      }
+
+      arena_next = reinterpret_cast<uintptr_t>(chunk);
+      arena_end = arena_next + len;
+      p = (arena_next + align - 1) & ~(align - 1);
+    }
+
+    arena_next = p + size;
+    return reinterpret_cast<void*>(p);
+  }
+
+  ArenaUse arena_use()
+  {
+    return arena_used;
+  }
+
   const char* kindname(Kind kind)
   {
     switch (kind)
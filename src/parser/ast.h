@@ -4,8 +4,11 @@
 
 #include "lexer.h"
 
+#include <new>
 #include <optional>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace verona::parser
@@ -70,8 +73,95 @@ namespace verona::parser
 
   struct NodeDef;
 
+  // Allocate memory for a node from the arena of the calling thread. Nodes are
+  // never freed, as the AST lives until the compiler exits.
+  void* arena_alloc(size_t size, size_t align);
+
+  // The number and total size of the allocations that the calling thread has
+  // made from its arena.
+  struct ArenaUse
+  {
+    size_t allocations = 0;
+    size_t bytes = 0;
+
+    ArenaUse operator-(const ArenaUse& that) const
+    {
+      return {allocations - that.allocations, bytes - that.bytes};
+    }
+
+    ArenaUse& operator+=(const ArenaUse& that)
+    {
+      allocations += that.allocations;
+      bytes += that.bytes;
+      return *this;
+    }
+  };
+
+  ArenaUse arena_use();
+
+  // A handle to a node in the arena. It has the interface of the
+  // `std::shared_ptr` that it replaced, but doesn't own the node.
   template<typename T>
-  using Node = std::shared_ptr<T>;
+  class Node
+  {
+    T* ptr = nullptr;
+
+  public:
+    Node() = default;
+    Node(std::nullptr_t) {}
+    explicit Node(T* ptr) : ptr(ptr) {}
+
+    template<
+      typename U,
+      typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Node(const Node<U>& that) : ptr(that.get())
+    {}
+
+    T* get() const
+    {
+      return ptr;
+    }
+
+    T& operator*() const
+    {
+      return *ptr;
+    }
+
+    T* operator->() const
+    {
+      return ptr;
+    }
+
+    explicit operator bool() const
+    {
+      return ptr != nullptr;
+    }
+
+    template<typename U>
+    bool operator==(const Node<U>& that) const
+    {
+      return ptr == that.get();
+    }
+
+    template<typename U>
+    bool operator!=(const Node<U>& that) const
+    {
+      return ptr != that.get();
+    }
+  };
+
+  template<typename T, typename... Args>
+  Node<T> make_node(Args&&... args)
+  {
+    auto mem = arena_alloc(sizeof(T), alignof(T));
+    return Node<T>(new (mem) T(std::forward<Args>(args)...));
+  }
+
+  template<typename T, typename U>
+  Node<T> node_cast(const Node<U>& node)
+  {
+    return Node<T>(static_cast<T*>(node.get()));
+  }
 
   template<typename T>
   using List = std::vector<Node<T>>;
@@ -108,7 +198,11 @@ namespace verona::parser
   // TODO: anonymous interface
 
   struct Type : NodeDef
-  {};
+  {
+    // The structural hash of the type, see `dnf::hash`, or 0 if it hasn't
+    // been computed yet.
+    size_t hash = 0;
+  };
 
   struct TypeName : NodeDef
   {
@@ -193,19 +287,29 @@ namespace verona::parser
 
   struct SymbolTable
   {
-    std::unordered_map<Location, Ast> map;
+    // Keyed by the interned ID of the name, see `Location::id`.
+    std::unordered_map<uint32_t, Ast> map;
     std::vector<Node<Using>> use;
 
     std::optional<Location> set(const Location& id, Ast node)
     {
-      auto find = map.find(id);
+      auto [find, added] = map.emplace(id.id(), node);
 
-      if (find != map.end())
+      if (!added)
         return find->second->location;
 
-      map.emplace(id, node);
       return {};
     }
+
+    Ast get(const Location& id)
+    {
+      auto find = map.find(id.id());
+
+      if (find == map.end())
+        return {};
+
+      return find->second;
+    }
   };
 
   struct Expr : NodeDef
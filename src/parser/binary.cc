@@ -0,0 +1,680 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "binary.h"
+
+#include "dispatch.h"
+#include "fields.h"
+
+#include <fstream>
+#include <unordered_map>
+
+namespace verona::parser::binary
+{
+  constexpr uint32_t magic = 0x54534156; // "VAST"
+  constexpr uint32_t version = 1;
+  constexpr size_t header_size = 7 * 4;
+
+  bool is_kind_of(Kind kind, const std::initializer_list<Kind>& kinds)
+  {
+    return std::find(kinds.begin(), kinds.end(), kind) != kinds.end();
+  }
+
+  // The kinds of node that a field of type `Node<T>` can hold.
+  template<typename T>
+  bool holds(Kind kind)
+  {
+    if constexpr (std::is_same_v<T, Type>)
+    {
+      return is_kind_of(
+        kind,
+        {Kind::ThrowType,
+         Kind::UnionType,
+         Kind::IsectType,
+         Kind::TupleType,
+         Kind::FunctionType,
+         Kind::ViewType,
+         Kind::ExtractType,
+         Kind::TypeRef,
+         Kind::TypeList,
+         Kind::Iso,
+         Kind::Mut,
+         Kind::Imm,
+         Kind::Self});
+    }
+    else if constexpr (std::is_same_v<T, Expr>)
+    {
+      return (kind == Kind::Param) ||
+        ((kind >= Kind::Oftype) && (kind <= Kind::Bool));
+    }
+    else if constexpr (std::is_same_v<T, Member>)
+    {
+      return is_kind_of(
+        kind,
+        {Kind::Using,
+         Kind::TypeAlias,
+         Kind::Interface,
+         Kind::Class,
+         Kind::Module,
+         Kind::Field,
+         Kind::Function});
+    }
+    else if constexpr (std::is_same_v<T, TypeParam>)
+    {
+      return is_kind_of(kind, {Kind::TypeParam, Kind::TypeParamList});
+    }
+    else if constexpr (std::is_same_v<T, TypeName>)
+    {
+      return is_kind_of(kind, {Kind::TypeName, Kind::ModuleName});
+    }
+    else if constexpr (std::is_same_v<T, Using>)
+    {
+      return kind == Kind::Using;
+    }
+    else
+    {
+      static_assert(std::is_same_v<T, NodeDef>);
+      return true;
+    }
+  }
+
+  Ast create(Kind kind)
+  {
+    switch (kind)
+    {
+      case Kind::Using:
+        return make_node<Using>();
+
+      case Kind::TypeAlias:
+        return make_node<TypeAlias>();
+
+      case Kind::Interface:
+        return make_node<Interface>();
+
+      case Kind::Class:
+        return make_node<Class>();
+
+      case Kind::Module:
+        return make_node<Module>();
+
+      case Kind::Field:
+        return make_node<Field>();
+
+      case Kind::Param:
+        return make_node<Param>();
+
+      case Kind::TypeParam:
+        return make_node<TypeParam>();
+
+      case Kind::TypeParamList:
+        return make_node<TypeParamList>();
+
+      case Kind::Function:
+        return make_node<Function>();
+
+      case Kind::ThrowType:
+        return make_node<ThrowType>();
+
+      case Kind::UnionType:
+        return make_node<UnionType>();
+
+      case Kind::IsectType:
+        return make_node<IsectType>();
+
+      case Kind::TupleType:
+        return make_node<TupleType>();
+
+      case Kind::FunctionType:
+        return make_node<FunctionType>();
+
+      case Kind::ViewType:
+        return make_node<ViewType>();
+
+      case Kind::ExtractType:
+        return make_node<ExtractType>();
+
+      case Kind::TypeName:
+        return make_node<TypeName>();
+
+      case Kind::ModuleName:
+        return make_node<ModuleName>();
+
+      case Kind::TypeRef:
+        return make_node<TypeRef>();
+
+      case Kind::TypeList:
+        return make_node<TypeList>();
+
+      case Kind::Iso:
+        return make_node<Iso>();
+
+      case Kind::Mut:
+        return make_node<Mut>();
+
+      case Kind::Imm:
+        return make_node<Imm>();
+
+      case Kind::Self:
+        return make_node<Self>();
+
+      case Kind::Oftype:
+        return make_node<Oftype>();
+
+      case Kind::Tuple:
+        return make_node<Tuple>();
+
+      case Kind::When:
+        return make_node<When>();
+
+      case Kind::Try:
+        return make_node<Try>();
+
+      case Kind::Match:
+        return make_node<Match>();
+
+      case Kind::Lambda:
+        return make_node<Lambda>();
+
+      case Kind::Assign:
+        return make_node<Assign>();
+
+      case Kind::Select:
+        return make_node<Select>();
+
+      case Kind::Ref:
+        return make_node<Ref>();
+
+      case Kind::Let:
+        return make_node<Let>();
+
+      case Kind::Var:
+        return make_node<Var>();
+
+      case Kind::Throw:
+        return make_node<Throw>();
+
+      case Kind::New:
+        return make_node<New>();
+
+      case Kind::ObjectLiteral:
+        return make_node<ObjectLiteral>();
+
+      case Kind::EscapedString:
+        return make_node<EscapedString>();
+
+      case Kind::UnescapedString:
+        return make_node<UnescapedString>();
+
+      case Kind::Character:
+        return make_node<Character>();
+
+      case Kind::Int:
+        return make_node<Int>();
+
+      case Kind::Float:
+        return make_node<Float>();
+
+      case Kind::Hex:
+        return make_node<Hex>();
+
+      case Kind::Binary:
+        return make_node<Binary>();
+
+      case Kind::Bool:
+        return make_node<Bool>();
+      default:
+        return {};
+    }
+  }
+
+  void put_word(std::string& out, uint32_t word)
+  {
+    char bytes[4] = {
+      char(word), char(word >> 8), char(word >> 16), char(word >> 24)};
+    out.append(bytes, 4);
+  }
+
+  uint32_t get_word(const char* p)
+  {
+    auto b = reinterpret_cast<const uint8_t*>(p);
+    return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) |
+      (uint32_t(b[3]) << 24);
+  }
+
+  void put(std::string& out, size_t value)
+  {
+    while (value >= 0x80)
+    {
+      out.push_back(char((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+
+    out.push_back(char(value));
+  }
+
+  struct Writer
+  {
+    std::string data;
+    std::string kinds;
+    List<NodeDef> nodes;
+    std::unordered_map<NodeDef*, size_t> numbers;
+    std::vector<SourceDef*> sources;
+    std::unordered_map<uint32_t, size_t> source_numbers;
+    std::vector<uint32_t> names;
+    std::unordered_map<uint32_t, size_t> name_numbers;
+    NodeDef* current = nullptr;
+
+    // Nodes are numbered in the order they are found, and each node is
+    // written once, however many times it is reachable.
+    size_t number(const Ast& node)
+    {
+      if (!node)
+        return 0;
+
+      auto [find, added] = numbers.emplace(node.get(), nodes.size() + 1);
+
+      if (added)
+      {
+        nodes.push_back(node);
+        kinds.push_back(char(node->kind()));
+      }
+
+      return find->second;
+    }
+
+    size_t source(uint32_t index)
+    {
+      if (!index)
+        return 0;
+
+      auto [find, added] = source_numbers.emplace(index, sources.size() + 1);
+
+      if (added)
+        sources.push_back(source_at(index));
+
+      return find->second;
+    }
+
+    size_t name(uint32_t id)
+    {
+      auto [find, added] = name_numbers.emplace(id, names.size() + 1);
+
+      if (added)
+        names.push_back(id);
+
+      return find->second;
+    }
+
+    void write(const Location& loc)
+    {
+      put(data, source(loc.source_index));
+      put(data, loc.start);
+      put(data, uint32_t(loc.end - loc.start + 1));
+    }
+
+    void operator()() {}
+
+    template<typename T>
+    void operator()(T& node)
+    {
+      current = &node;
+      write(node.location);
+      *this << fields(node);
+
+      auto st = node.symbol_table();
+
+      if (!st)
+        return;
+
+      put(data, st->map.size());
+
+      for (auto& [id, def] : st->map)
+      {
+        put(data, name(id));
+        put(data, number(def));
+      }
+
+      *this << st->use;
+    }
+
+    Writer& operator<<(Location& loc)
+    {
+      // The location of the node itself has already been written.
+      if (&loc != &current->location)
+        write(loc);
+
+      return *this;
+    }
+
+    template<typename T>
+    Writer& operator<<(Node<T>& node)
+    {
+      put(data, number(node));
+      return *this;
+    }
+
+    template<typename T>
+    Writer& operator<<(List<T>& list)
+    {
+      put(data, list.size());
+
+      for (auto& node : list)
+        put(data, number(node));
+
+      return *this;
+    }
+  };
+
+  bool write(const Ast& ast, const std::string& file)
+  {
+    Writer w;
+    w.number(ast);
+
+    // Writing a node can number more nodes, so `nodes` grows as it is walked.
+    for (size_t i = 0; i < w.nodes.size(); i++)
+    {
+      auto node = w.nodes[i];
+      dispatch(w, node);
+    }
+
+    std::string sizes;
+    std::string text;
+
+    auto add_text = [&](std::string_view s) {
+      put(sizes, s.size());
+      text.append(s);
+    };
+
+    for (auto source : w.sources)
+    {
+      add_text(source->origin);
+      add_text(source->contents);
+    }
+
+    for (auto id : w.names)
+      add_text(interned(id));
+
+    size_t data_size = sizes.size() + w.data.size();
+
+    if ((data_size > UINT32_MAX) || (text.size() > UINT32_MAX))
+      return false;
+
+    std::string header;
+    put_word(header, magic);
+    put_word(header, version);
+    put_word(header, static_cast<uint32_t>(w.sources.size()));
+    put_word(header, static_cast<uint32_t>(w.names.size()));
+    put_word(header, static_cast<uint32_t>(w.nodes.size()));
+    put_word(header, static_cast<uint32_t>(data_size));
+    put_word(header, static_cast<uint32_t>(text.size()));
+
+    std::ofstream f(file.c_str(), std::ios::binary);
+    f << header << w.kinds << sizes << w.data << text;
+    return f.good();
+  }
+
+  struct Reader
+  {
+    const uint8_t* pos;
+    const uint8_t* end;
+    std::vector<SourceDef*> sources;
+    std::vector<uint32_t> names;
+    List<NodeDef> nodes;
+    NodeDef* current = nullptr;
+    bool ok = true;
+
+    size_t next()
+    {
+      size_t value = 0;
+
+      for (size_t shift = 0; shift < 64; shift += 7)
+      {
+        if (pos == end)
+          break;
+
+        auto byte = *pos++;
+        value |= size_t(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+          return value;
+      }
+
+      ok = false;
+      return 0;
+    }
+
+    Ast node()
+    {
+      auto n = next();
+
+      if (n > nodes.size())
+      {
+        ok = false;
+        return {};
+      }
+
+      return n ? nodes[n - 1] : Ast();
+    }
+
+    void read(Location& loc)
+    {
+      auto n = next();
+      auto start = next();
+      auto size = next();
+
+      if ((n > sources.size()) || (start > UINT32_MAX) || (size > UINT32_MAX))
+      {
+        ok = false;
+        return;
+      }
+
+      // Check the location is in its source, allowing an empty location that
+      // ends before it starts, as the lexer makes.
+      auto source = n ? sources[n - 1] : nullptr;
+      size_t len = source ? source->contents.size() : 0;
+
+      if (source && ((start > len) || (size > (len - start))))
+      {
+        ok = false;
+        return;
+      }
+
+      loc = Location(source, start, uint32_t(start + size - 1));
+    }
+
+    void operator()() {}
+
+    template<typename T>
+    void operator()(T& node)
+    {
+      *this << fields(node);
+
+      auto st = node.symbol_table();
+
+      if (!st)
+        return;
+
+      auto count = next();
+
+      for (size_t i = 0; ok && (i < count); i++)
+      {
+        auto n = next();
+        auto def = this->node();
+
+        if ((n == 0) || (n > names.size()) || !def)
+          ok = false;
+        else
+          st->map.emplace(names[n - 1], def);
+      }
+
+      *this << st->use;
+    }
+
+    Reader& operator<<(Location& loc)
+    {
+      // The location of the node itself has already been read.
+      if (&loc != &current->location)
+        read(loc);
+
+      return *this;
+    }
+
+    template<typename T>
+    Reader& operator<<(Node<T>& node)
+    {
+      auto n = this->node();
+
+      if (n && !holds<T>(n->kind()))
+        ok = false;
+      else
+        node = node_cast<T>(n);
+
+      return *this;
+    }
+
+    template<typename T>
+    Reader& operator<<(List<T>& list)
+    {
+      auto count = next();
+
+      // Each node number is at least one byte.
+      if (count > size_t(end - pos))
+      {
+        ok = false;
+        return *this;
+      }
+
+      list.reserve(count);
+
+      for (size_t i = 0; ok && (i < count); i++)
+      {
+        list.emplace_back();
+        *this << list.back();
+      }
+
+      return *this;
+    }
+  };
+
+  std::pair<bool, Ast> read(const std::string& file, std::ostream& out)
+  {
+    // The sources will refer to the text in the file, so it is kept mapped
+    // with the other sources.
+    auto contents = load_source(file);
+
+    if (!contents)
+    {
+      out << "Couldn't read file " << file << std::endl;
+      return {false, {}};
+    }
+
+    std::string_view view = contents->contents;
+
+    auto invalid = [&]() -> std::pair<bool, Ast> {
+      out << file << " isn't a valid Verona AST file" << std::endl;
+      return {false, {}};
+    };
+
+    if (view.size() < header_size)
+      return invalid();
+
+    uint32_t header[header_size / 4];
+
+    for (size_t i = 0; i < (header_size / 4); i++)
+      header[i] = get_word(view.data() + (i * 4));
+
+    if (header[0] != magic)
+      return invalid();
+
+    if (header[1] != version)
+    {
+      out << file << " is version " << header[1] << " of the AST format, but "
+          << "version " << version << " is needed" << std::endl;
+      return {false, {}};
+    }
+
+    size_t source_count = header[2];
+    size_t name_count = header[3];
+    size_t node_count = header[4];
+    size_t data_size = header[5];
+    size_t text_size = header[6];
+
+    // The sections must fill the file exactly.
+    if (
+      (view.size() - header_size) !=
+      (uint64_t(node_count) + data_size + text_size))
+    {
+      return invalid();
+    }
+
+    auto kinds = view.substr(header_size, node_count);
+    auto data = view.substr(header_size + node_count, data_size);
+    auto text = view.substr(header_size + node_count + data_size);
+
+    Reader r;
+    r.pos = reinterpret_cast<const uint8_t*>(data.data());
+    r.end = r.pos + data.size();
+
+    auto next_text = [&](std::string_view& s) {
+      auto size = r.next();
+
+      if (!r.ok || (size > text.size()))
+        return false;
+
+      s = text.substr(0, size);
+      text.remove_prefix(size);
+      return true;
+    };
+
+    for (size_t i = 0; i < source_count; i++)
+    {
+      std::string_view origin;
+      std::string_view contents;
+
+      if (!next_text(origin) || !next_text(contents))
+        return invalid();
+
+      auto source = make_source();
+      source->origin = origin;
+      source->contents = contents;
+      r.sources.push_back(source.get());
+    }
+
+    for (size_t i = 0; i < name_count; i++)
+    {
+      std::string_view name;
+
+      if (!next_text(name))
+        return invalid();
+
+      r.names.push_back(intern(name));
+    }
+
+    // Create every node first, so that fields can refer to later nodes.
+    r.nodes.reserve(node_count);
+
+    for (auto kind : kinds)
+    {
+      auto node = create(static_cast<Kind>(uint8_t(kind)));
+
+      if (!node)
+        return invalid();
+
+      r.nodes.push_back(node);
+    }
+
+    for (auto& node : r.nodes)
+    {
+      r.current = node.get();
+      r.read(node->location);
+      dispatch(r, node);
+
+      if (!r.ok)
+        return invalid();
+    }
+
+    if (!text.empty() || (r.pos != r.end))
+      return invalid();
+
+    return {true, node_count ? r.nodes.front() : Ast()};
+  }
+}
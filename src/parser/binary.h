@@ -0,0 +1,41 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "ast.h"
+
+#include <iostream>
+
+namespace verona::parser::binary
+{
+  // A binary form of an AST, so that another process, such as verona-mlir,
+  // can read an AST without parsing and running passes again. It holds the
+  // text of every source that the AST refers to, so it is self-contained.
+  //
+  // The file is a header of seven little-endian 32-bit words, followed by
+  // three sections:
+  //
+  //   header  magic, version, sources, names, nodes, data size, text size
+  //   kinds   the kind of each node, one byte each
+  //   data    the sizes of the text of each source and name, then the nodes
+  //   text    the origin and contents of each source, then each name
+  //
+  // The data is unsigned LEB128 numbers. A node is its location, its fields
+  // in the order `fieldsof` gives, and its symbol table if it has one. A
+  // location is a source number, a start, and a size. A node field is a node
+  // number, where 0 is no node and the root is 1, and a list is a count
+  // followed by that many node numbers. A symbol table is a count of names,
+  // each a name number and a node number, followed by a list of `using`
+  // nodes. Numbers for sources and names also start at 1.
+  //
+  // Reading keeps the file mapped, and the sources refer to the text in it
+  // rather than copying it. The version must change whenever `Kind` or the
+  // fields of a node change.
+
+  // Writes `ast` to `file`, returning false if it can't be written.
+  bool write(const Ast& ast, const std::string& file);
+
+  // Reads an AST from `file`, which was written by `write`.
+  std::pair<bool, Ast>
+  read(const std::string& file, std::ostream& out = std::cerr);
+}
@@ -0,0 +1,140 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "clone.h"
+
+#include "dispatch.h"
+#include "fields.h"
+
+namespace verona::parser
+{
+  // Copies by original node, with open addressing. A clone visits every node,
+  // and `std::unordered_map` would allocate for each one.
+  struct CopyMap
+  {
+    size_t bits = 10;
+    size_t count = 0;
+    std::vector<std::pair<NodeDef*, NodeDef*>> slots;
+
+    CopyMap() : slots(size_t(1) << bits) {}
+
+    size_t slot(NodeDef* node)
+    {
+      // Fibonacci hashing, which takes the well mixed high bits.
+      auto mask = slots.size() - 1;
+      auto h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+      auto i = static_cast<size_t>((h * 0x9e3779b97f4a7c15) >> (64 - bits));
+
+      while (slots[i].first && (slots[i].first != node))
+        i = (i + 1) & mask;
+
+      return i;
+    }
+
+    NodeDef* find(NodeDef* node)
+    {
+      return slots[slot(node)].second;
+    }
+
+    void insert(NodeDef* node, NodeDef* copy)
+    {
+      // Keep the load factor at most 1/2.
+      if ((++count * 2) > slots.size())
+      {
+        std::vector<std::pair<NodeDef*, NodeDef*>> prev(slots.size() * 2);
+        std::swap(slots, prev);
+        bits++;
+
+        for (auto& entry : prev)
+        {
+          if (entry.first)
+            slots[slot(entry.first)] = entry;
+        }
+      }
+
+      slots[slot(node)] = {node, copy};
+    }
+
+    template<typename T>
+    void remap(Node<T>& node)
+    {
+      auto copy = node ? find(node.get()) : nullptr;
+
+      if (copy)
+        node = Node<T>(static_cast<T*>(copy));
+    }
+  };
+
+  struct Clone
+  {
+    CopyMap map;
+    List<NodeDef> scopes;
+
+    Ast operator()()
+    {
+      return {};
+    }
+
+    template<typename T>
+    Ast operator()(T& node)
+    {
+      auto find = map.find(&node);
+
+      if (find)
+        return Ast(find);
+
+      auto copy = make_node<T>(node);
+      map.insert(&node, copy.get());
+
+      if (copy->symbol_table())
+        scopes.push_back(copy);
+
+      *this << fields(*copy);
+      return copy;
+    }
+
+    Clone& operator<<(Location& loc)
+    {
+      return *this;
+    }
+
+    template<typename T>
+    Clone& operator<<(Node<T>& node)
+    {
+      node = node_cast<T>(dispatch(*this, node));
+      return *this;
+    }
+
+    template<typename T>
+    Clone& operator<<(List<T>& list)
+    {
+      for (auto& node : list)
+        *this << node;
+
+      return *this;
+    }
+  };
+
+  Ast clone(const Ast& ast, AstPath& track)
+  {
+    Clone c;
+    auto copy = dispatch(c, ast);
+
+    // The symbol tables were copied with the nodes, so they still refer to the
+    // original definitions.
+    for (auto& scope : c.scopes)
+    {
+      auto st = scope->symbol_table();
+
+      for (auto& [id, def] : st->map)
+        c.map.remap(def);
+
+      for (auto& use : st->use)
+        c.map.remap(use);
+    }
+
+    for (auto& node : track)
+      c.map.remap(node);
+
+    return copy;
+  }
+}
@@ -0,0 +1,14 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "ast.h"
+
+namespace verona::parser
+{
+  // This returns a deep copy of `ast`. A node that is reachable more than once
+  // is copied once, and the symbol tables of the copy refer to the copied
+  // nodes. Each node in `track` that is part of `ast` is replaced with its
+  // copy.
+  Ast clone(const Ast& ast, AstPath& track);
+}
@@ -2,10 +2,217 @@
 // SPDX-License-Identifier: MIT
 #include "dnf.h"
 
-#include "pass.h"
-
 namespace verona::parser::dnf
 {
+  size_t combine(size_t seed, size_t hash)
+  {
+    return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+  }
+
+  size_t hash(const Node<Type>& type)
+  {
+    if (!type)
+      return 0;
+
+    if (type->hash)
+      return type->hash;
+
+    size_t h = static_cast<size_t>(type->kind());
+
+    switch (type->kind())
+    {
+      case Kind::TypeRef:
+      {
+        for (auto& name : type->as<TypeRef>().typenames)
+        {
+          h = combine(h, static_cast<size_t>(name->kind()));
+
+          // Module names are renamed when modules are numbered, so they are
+          // left out of the hash rather than making it stale.
+          if (name->kind() != Kind::ModuleName)
+            h = combine(h, name->location.id());
+
+          for (auto& arg : name->typeargs)
+            h = combine(h, hash(arg));
+        }
+        break;
+      }
+
+      case Kind::TypeList:
+      {
+        h = combine(h, type->location.id());
+        break;
+      }
+
+      case Kind::UnionType:
+      case Kind::IsectType:
+      {
+        // The order of the types doesn't matter.
+        size_t sum = 0;
+
+        for (auto& t : type->as<TypeOp>().types)
+          sum += combine(0, hash(t));
+
+        h = combine(h, sum);
+        break;
+      }
+
+      case Kind::TupleType:
+      {
+        for (auto& t : type->as<TypeOp>().types)
+          h = combine(h, hash(t));
+        break;
+      }
+
+      case Kind::ThrowType:
+      {
+        h = combine(h, hash(type->as<ThrowType>().type));
+        break;
+      }
+
+      case Kind::FunctionType:
+      case Kind::ViewType:
+      case Kind::ExtractType:
+      {
+        auto& pair = type->as<TypePair>();
+        h = combine(h, hash(pair.left));
+        h = combine(h, hash(pair.right));
+        break;
+      }
+
+      default:
+        break;
+    }
+
+    // 0 means the hash hasn't been computed.
+    type->hash = h ? h : 1;
+    return type->hash;
+  }
+
+  bool equal(const List<Type>& left, const List<Type>& right)
+  {
+    if (left.size() != right.size())
+      return false;
+
+    for (size_t i = 0; i < left.size(); i++)
+    {
+      if (!equal(left[i], right[i]))
+        return false;
+    }
+
+    return true;
+  }
+
+  bool contains(const List<Type>& types, const Node<Type>& type)
+  {
+    for (auto& t : types)
+    {
+      if (equal(t, type))
+        return true;
+    }
+
+    return false;
+  }
+
+  bool equal(const Node<Type>& left, const Node<Type>& right)
+  {
+    if (left == right)
+      return true;
+
+    if (!left || !right || (hash(left) != hash(right)))
+      return false;
+
+    if (left->kind() != right->kind())
+      return false;
+
+    switch (left->kind())
+    {
+      case Kind::TypeRef:
+      {
+        auto& lhs = left->as<TypeRef>().typenames;
+        auto& rhs = right->as<TypeRef>().typenames;
+
+        if (lhs.size() != rhs.size())
+          return false;
+
+        for (size_t i = 0; i < lhs.size(); i++)
+        {
+          if (
+            (lhs[i]->kind() != rhs[i]->kind()) ||
+            (lhs[i]->location.id() != rhs[i]->location.id()) ||
+            !equal(lhs[i]->typeargs, rhs[i]->typeargs))
+            return false;
+        }
+
+        return true;
+      }
+
+      case Kind::TypeList:
+        return left->location.id() == right->location.id();
+
+      case Kind::UnionType:
+      case Kind::IsectType:
+      {
+        // Neither has repeated types, so they are equal if they are the same
+        // size and every type in one is in the other.
+        auto& lhs = left->as<TypeOp>().types;
+        auto& rhs = right->as<TypeOp>().types;
+
+        if (lhs.size() != rhs.size())
+          return false;
+
+        for (auto& t : lhs)
+        {
+          if (!contains(rhs, t))
+            return false;
+        }
+
+        return true;
+      }
+
+      case Kind::TupleType:
+        return equal(left->as<TypeOp>().types, right->as<TypeOp>().types);
+
+      case Kind::ThrowType:
+        return equal(left->as<ThrowType>().type, right->as<ThrowType>().type);
+
+      case Kind::FunctionType:
+      case Kind::ViewType:
+      case Kind::ExtractType:
+      {
+        auto& lhs = left->as<TypePair>();
+        auto& rhs = right->as<TypePair>();
+        return equal(lhs.left, rhs.left) && equal(lhs.right, rhs.right);
+      }
+
+      default:
+        return true;
+    }
+  }
+
+  // Adds `type` to `types` unless an equal type is already there, and
+  // returns true if it was added.
+  bool add(List<Type>& types, const Node<Type>& type)
+  {
+    if (contains(types, type))
+      return false;
+
+    types.push_back(type);
+    return true;
+  }
+
+  // A union or intersection of one type is that type.
+  Node<Type> single(const Node<TypeOp>& op)
+  {
+    if (op->types.empty())
+      return {};
+
+    if (op->types.size() == 1)
+      return op->types.front();
+
+    return op;
+  }
+
   Location range(Node<Type>& left, Node<Type>& right)
   {
     return left->location.range(right->location);
@@ -13,8 +220,11 @@ namespace verona::parser::dnf
 
   Node<Type> single_single(Node<Type>& left, Node<Type>& right)
   {
-    // A & B
-    auto isect = std::make_shared<IsectType>();
+    // A & B, or A if they are the same
+    if (equal(left, right))
+      return left;
+
+    auto isect = make_node<IsectType>();
     isect->location = range(left, right);
     isect->types.push_back(left);
     isect->types.push_back(right);
@@ -27,14 +237,12 @@ namespace verona::parser::dnf
     auto& lhs = left->as<ThrowType>();
     auto& rhs = right->as<ThrowType>();
 
-    auto isect = std::make_shared<IsectType>();
-    isect->location = range(left, right);
-    isect->types.push_back(lhs.type);
-    isect->types.push_back(rhs.type);
+    if (equal(lhs.type, rhs.type))
+      return left;
 
-    auto th = std::make_shared<ThrowType>();
-    th->location = isect->location;
-    th->type = isect;
+    auto th = make_node<ThrowType>();
+    th->location = range(left, right);
+    th->type = conjunction(lhs.type, rhs.type);
     return th;
   }
 
@@ -43,7 +251,10 @@ namespace verona::parser::dnf
     // (A & B) & C -> A & B & C
     auto& lhs = left->as<IsectType>();
 
-    auto isect = std::make_shared<IsectType>();
+    if (contains(lhs.types, right))
+      return left;
+
+    auto isect = make_node<IsectType>();
     isect->location = range(left, right);
     isect->types = lhs.types;
     isect->types.push_back(right);
@@ -56,18 +267,25 @@ namespace verona::parser::dnf
     auto& lhs = left->as<IsectType>();
     auto& rhs = right->as<IsectType>();
 
-    auto isect = std::make_shared<IsectType>();
+    auto isect = make_node<IsectType>();
     isect->location = range(left, right);
     isect->types = lhs.types;
-    isect->types.insert(isect->types.end(), rhs.types.begin(), rhs.types.end());
+    bool added = false;
+
+    for (auto& type : rhs.types)
+      added |= add(isect->types, type);
+
+    if (!added)
+      return left;
+
     return isect;
   }
 
   Node<Type> union_other(Node<Type>& left, Node<Type>& right)
   {
-    // (A | B) & C -> (A & B) | (A & C)
+    // (A | B) & C -> (A & C) | (B & C)
     auto& lhs = left->as<UnionType>();
-    auto un = std::make_shared<UnionType>();
+    auto un = make_node<UnionType>();
     un->location = range(left, right);
 
     for (auto& type : lhs.types)
@@ -75,13 +293,10 @@ namespace verona::parser::dnf
       auto conj = conjunction(type, right);
 
       if (conj)
-        un->types.push_back(conj);
+        add(un->types, conj);
     }
 
-    if (un->types.empty())
-      return {};
-
-    return un;
+    return single(un);
   }
 
   Node<Type> union_union(Node<Type>& left, Node<Type>& right)
@@ -90,7 +305,7 @@ namespace verona::parser::dnf
     auto& lhs = left->as<UnionType>();
     auto& rhs = right->as<UnionType>();
 
-    auto un = std::make_shared<UnionType>();
+    auto un = make_node<UnionType>();
     un->location = range(left, right);
 
     for (auto& ltype : lhs.types)
@@ -100,14 +315,11 @@ namespace verona::parser::dnf
         auto conj = conjunction(ltype, rtype);
 
         if (conj)
-          un->types.push_back(conj);
+          add(un->types, conj);
       }
     }
 
-    if (un->types.empty())
-      return {};
-
-    return un;
+    return single(un);
   }
 
   Node<Type> conjunction(Node<Type>& left, Node<Type>& right)
@@ -193,7 +405,7 @@ namespace verona::parser::dnf
     if (type->kind() == Kind::UnionType)
     {
       auto& un = type->as<UnionType>();
-      auto res = std::make_shared<UnionType>();
+      auto res = make_node<UnionType>();
       res->location = type->location;
 
       for (size_t i = 0; i < un.types.size(); i++)
@@ -202,7 +414,7 @@ namespace verona::parser::dnf
 
         if (ty->kind() != Kind::ThrowType)
         {
-          auto th = std::make_shared<ThrowType>();
+          auto th = make_node<ThrowType>();
           th->location = ty->location;
           th->type = ty;
           res->types.push_back(th);
@@ -218,7 +430,7 @@ namespace verona::parser::dnf
 
     if (type->kind() != Kind::ThrowType)
     {
-      auto th = std::make_shared<ThrowType>();
+      auto th = make_node<ThrowType>();
       th->location = type->location;
       th->type = type;
       return th;
@@ -235,98 +447,94 @@ namespace verona::parser::dnf
     if (!right)
       return left;
 
-    auto un = std::make_shared<UnionType>();
+    auto un = make_node<UnionType>();
     un->location = range(left, right);
 
     if (left->kind() == Kind::UnionType)
-    {
-      auto& lhs = left->as<UnionType>().types;
-      un->types.insert(un->types.end(), lhs.begin(), lhs.end());
-    }
+      un->types = left->as<UnionType>().types;
     else
-    {
       un->types.push_back(left);
-    }
+
+    bool added = false;
 
     if (right->kind() == Kind::UnionType)
     {
-      auto& rhs = right->as<UnionType>().types;
-      un->types.insert(un->types.end(), rhs.begin(), rhs.end());
+      for (auto& type : right->as<UnionType>().types)
+        added |= add(un->types, type);
     }
     else
     {
-      un->types.push_back(right);
+      added = add(un->types, right);
     }
 
+    // Nothing new, so the left-hand side is already the union.
+    if (!added)
+      return left;
+
     return un;
   }
 
-  bool wellformed(Ast& ast, std::ostream& out)
+  void WF::pre(UnionType& un)
   {
-    struct WF : Pass<WF>
+    for (auto& ty : un.types)
     {
-      AST_PASS;
-
-      void pre(UnionType& un)
+      if (ty->kind() == Kind::UnionType)
       {
-        for (auto& ty : un.types)
-        {
-          if (ty->kind() == Kind::UnionType)
-          {
-            error() << loc()
-                    << "Union type should not contain another union type"
-                    << line();
-            return;
-          }
-        }
+        error() << loc()
+                << "Union type should not contain another union type"
+                << line();
+        return;
       }
+    }
+  }
+
+  void WF::pre(ThrowType& tt)
+  {
+    if (tt.type->kind() == Kind::UnionType)
+    {
+      error() << loc() << "Throw type should not contain a union type"
+              << line();
+      return;
+    }
 
-      void pre(ThrowType& tt)
+    if (tt.type->kind() == Kind::ThrowType)
+    {
+      error() << loc() << "Throw type should not contain another throw type"
+              << line();
+      return;
+    }
+  }
+
+  void WF::pre(IsectType& isect)
+  {
+    for (auto& ty : isect.types)
+    {
+      if (ty->kind() == Kind::UnionType)
       {
-        if (tt.type->kind() == Kind::UnionType)
-        {
-          error() << loc() << "Throw type should not contain a union type"
-                  << line();
-          return;
-        }
+        error() << loc() << "Isect type should not contain a union type"
+                << line();
+        return;
+      }
 
-        if (tt.type->kind() == Kind::ThrowType)
-        {
-          error() << loc() << "Throw type should not contain another throw type"
-                  << line();
-          return;
-        }
+      if (ty->kind() == Kind::ThrowType)
+      {
+        error() << loc() << "Isect type should not contain a throw type"
+                << line();
+        return;
       }
 
-      void pre(IsectType& isect)
+      if (ty->kind() == Kind::IsectType)
       {
-        for (auto& ty : isect.types)
-        {
-          if (ty->kind() == Kind::UnionType)
-          {
-            error() << loc() << "Isect type should not contain a union type"
-                    << line();
-            return;
-          }
-
-          if (ty->kind() == Kind::ThrowType)
-          {
-            error() << loc() << "Isect type should not contain a throw type"
-                    << line();
-            return;
-          }
-
-          if (ty->kind() == Kind::IsectType)
-          {
-            error() << loc()
-                    << "Isect type should not contain another isect type"
-                    << line();
-            return;
-          }
-        }
+        error() << loc()
+                << "Isect type should not contain another isect type"
+                << line();
+        return;
       }
-    };
+    }
+  }
 
+  bool wellformed(Ast& ast, std::ostream& out)
+  {
     WF wf;
     wf.set_error(out);
     return wf << ast;
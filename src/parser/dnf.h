@@ -2,12 +2,17 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
-#include "ast.h"
-
-#include <iostream>
+#include "pass.h"
 
 namespace verona::parser::dnf
 {
+  // Types are compared by structure, so that a type that appears more than
+  // once in a union or an intersection is kept only once. The hash of a type
+  // is kept in the node, so the types built from it don't compute it again.
+  // Types must not change after they are hashed.
+  size_t hash(const Node<Type>& type);
+  bool equal(const Node<Type>& left, const Node<Type>& right);
+
   // This distributes & over | in the type system, producing a disjunctive
   // normal form type. The two types are any two types that are in an
   // intersection type together.
@@ -22,5 +27,14 @@ namespace verona::parser::dnf
   Node<Type> disjunction(Node<Type>& left, Node<Type>& right);
 
   // This checks if types are in disjunctive normal form.
+  struct WF : Pass<WF>
+  {
+    AST_PASS;
+
+    void pre(UnionType& un);
+    void pre(ThrowType& tt);
+    void pre(IsectType& isect);
+  };
+
   bool wellformed(Ast& ast, std::ostream& out = std::cerr);
 }
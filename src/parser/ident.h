@@ -15,7 +15,7 @@ namespace verona::parser
 
     Ident() : hygienic(0)
     {
-      store = std::make_shared<SourceDef>();
+      store = make_source();
     }
 
     Location operator()(const char* text = "")
@@ -26,7 +26,7 @@ namespace verona::parser
       {
         auto h = "$" + std::to_string(hygienic++);
         auto pos = store->contents.size();
-        store->contents.append(h);
+        store->append(h);
         len = h.size();
         return {store, pos, pos + len - 1};
       }
@@ -36,7 +36,7 @@ namespace verona::parser
       if (pos == std::string::npos)
       {
         pos = store->contents.size();
-        store->contents.append(text);
+        store->append(text);
       }
 
       return {store, pos, pos + len - 1};
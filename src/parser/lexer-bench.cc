@@ -0,0 +1,131 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "lexer.h"
+#include "path.h"
+
+#include <CLI/CLI.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace verona::parser;
+
+// Lexer throughput benchmark. Each source is lexed to the end `--repeat`
+// times, and the throughput is reported in MB and tokens per second.
+// Directories are searched for .verona files recursively, so passing
+// testsuite/verona-parser covers every test input, including modules. A
+// synthetic source of `--synthetic` MB is added, built from a mix of
+// identifiers, whitespace runs, comments, and strings, as generated code
+// would have.
+
+void add_sources(const std::string& p, std::vector<Source>& sources)
+{
+  if (path::type(p) != path::Type::Directory)
+  {
+    auto source = load_source(p);
+
+    if (!source)
+      std::cerr << "Couldn't read file " << p << std::endl;
+    else
+      sources.push_back(source);
+
+    return;
+  }
+
+  auto dir = path::to_directory(p);
+
+  for (auto& file : path::files(dir))
+  {
+    if (path::extension(file) == "verona")
+      add_sources(path::join(dir, file), sources);
+  }
+
+  for (auto& sub : path::directories(dir))
+  {
+    if (!path::is_hidden(sub))
+      add_sources(path::join(dir, sub), sources);
+  }
+}
+
+Source synthetic(size_t mb)
+{
+  auto source = make_source();
+  source->origin = "<synthetic>";
+  std::string text;
+
+  for (size_t i = 0; text.size() < (mb << 20); i++)
+  {
+    text += "// A line comment, as generated code has before each item.\n";
+    text += "/* A block comment with /* nesting */ inside it. */\n";
+    text += "class Generated" + std::to_string(i) + "\n{\n";
+    text += "  some_field_name_" + std::to_string(i) + ": U64 & imm;\n";
+    text += "  create(left_operand: U64, right_operand: U64): Self\n  {\n";
+    text += "    let message = \"a string literal with \\\"escapes\\\"\";\n";
+    text += "    let raw = '\"an unescaped string literal\"';\n";
+    text += "    left_operand + right_operand * 0x1234_5678\n  }\n}\n\n";
+  }
+
+  source->append(text);
+  return source;
+}
+
+int main(int argc, char** argv)
+{
+  CLI::App app{"Verona lexer benchmark"};
+  std::vector<std::string> paths;
+  size_t repeat = 10;
+  size_t mb = 16;
+
+  app.add_option("paths", paths, "Files or directories to lex.");
+  app.add_option("-r,--repeat", repeat, "Times to lex each source.");
+  app.add_option("-s,--synthetic", mb, "Size of the synthetic source in MB.");
+
+  try
+  {
+    app.parse(argc, argv);
+  }
+  catch (const CLI::ParseError& e)
+  {
+    return app.exit(e);
+  }
+
+  std::vector<Source> sources;
+
+  for (auto& p : paths)
+    add_sources(p, sources);
+
+  auto report = [&](const std::string& name, std::vector<Source>& sources) {
+    size_t bytes = 0;
+    size_t tokens = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t r = 0; r < repeat; r++)
+    {
+      for (auto& source : sources)
+      {
+        size_t i = 0;
+        bytes += source->contents.size();
+
+        while (lex(source, i).kind != TokenKind::End)
+          tokens++;
+      }
+    }
+
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1)
+              << (bytes / t.count() / (1 << 20)) << " MB/s" << std::setw(10)
+              << (tokens / t.count() / 1e6) << " Mtok/s" << std::endl;
+  };
+
+  if (!sources.empty())
+    report("files", sources);
+
+  if (mb > 0)
+  {
+    std::vector<Source> gen{synthetic(mb)};
+    report("synthetic", gen);
+  }
+
+  return 0;
+}
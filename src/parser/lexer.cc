@@ -4,6 +4,19 @@
 
 #include "escaping.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#  include <emmintrin.h>
+#  define LEXER_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define LEXER_NEON
+#endif
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
 namespace verona::parser
 {
   constexpr uint8_t X = 0; // Invalid
@@ -71,6 +84,221 @@ namespace verona::parser
                                   {"false", TokenKind::Bool},
                                   {nullptr, TokenKind::Invalid}};
 
+  // Fast paths that skip runs of uninteresting bytes 16 at a time, for
+  // whitespace, identifiers, comments and strings. Each `Stop` class gives the
+  // bytes that end a run, tested both on one byte and on a block of 16.
+#if defined(LEXER_SSE2)
+  using Block = __m128i;
+
+  inline Block load(const char* p)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+
+  inline Block splat(char c)
+  {
+    return _mm_set1_epi8(c);
+  }
+
+  inline Block eq(Block v, char c)
+  {
+    return _mm_cmpeq_epi8(v, splat(c));
+  }
+
+  // Bytes in [lo, hi], compared unsigned. Only signed compares are available,
+  // so the bytes are biased to put `lo` at the smallest signed value.
+  inline Block in_range(Block v, uint8_t lo, uint8_t hi)
+  {
+    auto biased = _mm_add_epi8(v, splat(char(0x80 - lo)));
+    return _mm_cmplt_epi8(biased, splat(char(0x80 + hi - lo + 1)));
+  }
+
+  inline Block either(Block a, Block b)
+  {
+    return _mm_or_si128(a, b);
+  }
+
+  inline Block invert(Block v)
+  {
+    return _mm_xor_si128(v, splat(char(0xFF)));
+  }
+
+  // The index of the first set byte in `v`, or 16.
+  inline size_t first(Block v)
+  {
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(v)) | 0x10000;
+#  ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#  else
+    return static_cast<size_t>(__builtin_ctz(mask));
+#  endif
+  }
+#elif defined(LEXER_NEON)
+  using Block = uint8x16_t;
+
+  inline Block load(const char* p)
+  {
+    return vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+  }
+
+  inline Block splat(char c)
+  {
+    return vdupq_n_u8(static_cast<uint8_t>(c));
+  }
+
+  inline Block eq(Block v, char c)
+  {
+    return vceqq_u8(v, splat(c));
+  }
+
+  inline Block in_range(Block v, uint8_t lo, uint8_t hi)
+  {
+    return vcleq_u8(vsubq_u8(v, splat(char(lo))), splat(char(hi - lo)));
+  }
+
+  inline Block either(Block a, Block b)
+  {
+    return vorrq_u8(a, b);
+  }
+
+  inline Block invert(Block v)
+  {
+    return vmvnq_u8(v);
+  }
+
+  // The index of the first set byte in `v`, or 16. Narrowing each 16-bit
+  // lane by 4 bits leaves 4 bits for each byte in a 64-bit mask.
+  inline size_t first(Block v)
+  {
+    auto narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    auto mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+
+    if (mask == 0)
+      return 16;
+
+#  ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index >> 2;
+#  else
+    return static_cast<size_t>(__builtin_ctzll(mask)) >> 2;
+#  endif
+  }
+#endif
+
+  // The index of the first byte at or after `i` that ends a run of `Stop`,
+  // or the size of `s`.
+  template<typename Stop>
+  size_t skip(const std::string_view& s, size_t i)
+  {
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    while ((i + 16) <= s.size())
+    {
+      auto n = first(Stop::block(load(s.data() + i)));
+      i += n;
+
+      if (n < 16)
+        return i;
+    }
+#endif
+
+    while ((i < s.size()) && !Stop::byte(static_cast<uint8_t>(s[i])))
+      i++;
+
+    return i;
+  }
+
+  // Anything but space, tab, carriage return and newline.
+  struct NotWhitespace
+  {
+    static bool byte(uint8_t c)
+    {
+      return (c != ' ') && (c != '\t') && (c != '\r') && (c != '\n');
+    }
+
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    static Block block(Block v)
+    {
+      return invert(either(
+        either(eq(v, ' '), eq(v, '\t')), either(eq(v, '\r'), eq(v, '\n'))));
+    }
+#endif
+  };
+
+  // Anything but letters, digits, underscore and prime.
+  struct NotIdent
+  {
+    static bool byte(uint8_t c)
+    {
+      if (c >= 0x80)
+        return true;
+
+      return (lookup[c] != I) && (lookup[c] != N) && (c != '\'');
+    }
+
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    static Block block(Block v)
+    {
+      // Setting bit 5 maps upper case letters to lower case, and doesn't map
+      // anything else to a lower case letter.
+      auto lower = either(v, splat(0x20));
+      return invert(either(
+        either(in_range(lower, 'a', 'z'), in_range(v, '0', '9')),
+        either(eq(v, '_'), eq(v, '\''))));
+    }
+#endif
+  };
+
+  // The bytes that can start or end a nested comment.
+  struct CommentDelimiter
+  {
+    static bool byte(uint8_t c)
+    {
+      return (c == '/') || (c == '*');
+    }
+
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    static Block block(Block v)
+    {
+      return either(eq(v, '/'), eq(v, '*'));
+    }
+#endif
+  };
+
+  // The bytes that an escaped string treats specially.
+  struct EscapedDelimiter
+  {
+    static bool byte(uint8_t c)
+    {
+      return (c == '\"') || (c == '\\');
+    }
+
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    static Block block(Block v)
+    {
+      return either(eq(v, '\"'), eq(v, '\\'));
+    }
+#endif
+  };
+
+  // The bytes that an unescaped string treats specially.
+  struct UnescapedDelimiter
+  {
+    static bool byte(uint8_t c)
+    {
+      return (c == '\"') || (c == '\'');
+    }
+
+#if defined(LEXER_SSE2) || defined(LEXER_NEON)
+    static Block block(Block v)
+    {
+      return either(eq(v, '\"'), eq(v, '\''));
+    }
+#endif
+  };
+
   bool is_digit(char c)
   {
     return ((c >= '0') && (c <= '9')) || (c == '_');
@@ -252,6 +480,18 @@ namespace verona::parser
 
     while (++i < source->contents.size())
     {
+      // Anything but a quote or a backslash clears `backslash`.
+      auto next = skip<EscapedDelimiter>(source->contents, i);
+
+      if (next != i)
+      {
+        backslash = false;
+        i = next;
+
+        if (i == source->contents.size())
+          break;
+      }
+
       switch (source->contents[i])
       {
         case '\\':
@@ -302,6 +542,19 @@ namespace verona::parser
 
     while (++i < source->contents.size())
     {
+      // Anything but a quote or a prime resets the state.
+      auto next = skip<UnescapedDelimiter>(source->contents, i);
+
+      if (next != i)
+      {
+        state = State::Nesting;
+        count = 0;
+        i = next;
+
+        if (i == source->contents.size())
+          break;
+      }
+
       switch (source->contents[i])
       {
         case '\"':
@@ -389,14 +642,13 @@ namespace verona::parser
 
   void consume_line_comment(Source& source, size_t& i)
   {
-    while (++i < source->contents.size())
-    {
-      if (source->contents[i] == '\n')
-      {
-        i++;
-        break;
-      }
-    }
+    // The comment ends after the next newline, or at the end of the source.
+    i = source->contents.find('\n', i + 1);
+
+    if (i == std::string_view::npos)
+      i = source->contents.size();
+    else
+      i++;
   }
 
   void consume_nested_comment(Source& source, size_t& i)
@@ -413,6 +665,18 @@ namespace verona::parser
 
     while (++i < source->contents.size())
     {
+      // Anything but a slash or a star resets the state.
+      auto next = skip<CommentDelimiter>(source->contents, i);
+
+      if (next != i)
+      {
+        state = State::Other;
+        i = next;
+
+        if (i == source->contents.size())
+          break;
+      }
+
       auto c = source->contents[i];
 
       switch (c)
@@ -631,24 +895,15 @@ namespace verona::parser
   {
     auto start = i;
 
-    while (++i < source->contents.size())
-    {
-      auto c = lookup[source->contents[i]];
-
-      // Idents and numbers are valid ident continuations.
-      if ((c != I) && (c != N))
-      {
-        // Prime is the only other thing that's a valid ident continuation.
-        if ((c != Q) || (source->contents[i] != '\''))
-          break;
-      }
-    }
+    // Idents, numbers, and primes are valid ident continuations.
+    i = skip<NotIdent>(source->contents, i + 1);
 
     Token tok{TokenKind::Ident, {source, start, i - 1}};
+    auto view = source->contents.substr(start, i - start);
 
     for (auto kw = &keywords[0]; kw->text; kw++)
     {
-      if (tok.location == kw->text)
+      if (view == kw->text)
       {
         tok.kind = kw->kind;
         break;
@@ -721,7 +976,7 @@ namespace verona::parser
         case W:
         {
           // Skip whitespace.
-          i++;
+          i = skip<NotWhitespace>(source->contents, i + 1);
           break;
         }
 
@@ -141,12 +141,7 @@ namespace verona::parser
     if (!st)
       return {};
 
-    auto find = st->map.find(name);
-
-    if (find == st->map.end())
-      return {};
-
-    return find->second;
+    return st->get(name);
   }
 
   AstPaths
@@ -163,12 +158,12 @@ namespace verona::parser
 
     // Look in this node's symbol table.
     AstPaths rs;
-    auto find = st->map.find(name);
+    auto def = st->get(name);
 
-    if (find != st->map.end())
+    if (def)
     {
       AstPath r{path.begin(), path.end()};
-      r.push_back(find->second);
+      r.push_back(def);
       add(rs, r);
     }
 
@@ -182,7 +177,7 @@ namespace verona::parser
       if (!is_kind(ast, {Kind::Class, Kind::Interface}))
       {
         // Only accept `using` statements in the same file.
-        if (use->location.source->origin != name.source->origin)
+        if (use->location.source()->origin != name.source()->origin)
           continue;
 
         // Only accept `using` statements that are earlier in scope.
@@ -1,13 +1,13 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
-#include "anf.h"
-#include "dnf.h"
+#include "binary.h"
 #include "parser.h"
+#include "passes.h"
 #include "path.h"
 #include "print.h"
-#include "resolve.h"
 
 #include <CLI/CLI.hpp>
+#include <fstream>
 
 constexpr auto stdlib = "stdlib/";
 
@@ -19,11 +19,20 @@ int main(int argc, char** argv)
   bool emit_ast = false;
   bool validate = false;
   bool anf = false;
+  bool stats = false;
+  std::string stats_json;
   std::string path;
+  std::string binary;
 
   app.add_flag("-a,--ast", emit_ast, "Emit an abstract syntax tree.");
   app.add_flag("-v,--validate", validate, "Run validation passes.");
   app.add_flag("-n,--anf", anf, "Transform to ANF.");
+  app.add_flag(
+    "--stats", stats, "Print the time and nodes taken by each phase.");
+  app.add_option(
+    "--stats-json", stats_json, "Write the phases as JSON to this file.");
+  app.add_option(
+    "-b,--binary", binary, "Write the AST in binary form to this file.");
   app.add_option("path", path, "Path to the module to compile.")->required();
 
   try
@@ -36,20 +45,38 @@ int main(int argc, char** argv)
   }
 
   auto stdlibpath = path::canonical(path::join(path::executable(), stdlib));
-  auto [ok, ast] = parse(path, stdlibpath);
-  ok = ok && (!validate || dnf::wellformed(ast));
+  Stats phases;
+  auto measure = (stats || !stats_json.empty()) ? &phases : nullptr;
+  auto [ok, ast] = parse(path, stdlibpath, std::cerr, nullptr, measure);
 
-  ok = ok && resolve::run(ast);
-  ok = ok && (!validate || resolve::wellformed(ast));
+  passes::Options options;
+  options.validate = validate;
+  options.anf = anf;
+  ok = ok && passes::run(ast, options, measure);
 
-  if (anf)
+  if (stats)
+    std::cerr << phases;
+
+  if (!stats_json.empty())
   {
-    ok = ok && anf::run(ast);
-    ok = ok && (!validate || anf::wellformed(ast));
+    std::ofstream f(stats_json.c_str());
+    phases.json(f);
+
+    if (!f)
+    {
+      std::cerr << "Couldn't write file " << stats_json << std::endl;
+      ok = false;
+    }
   }
 
   if (emit_ast)
     std::cout << ast << std::endl;
 
+  if (!binary.empty() && !binary::write(ast, binary))
+  {
+    std::cerr << "Couldn't write file " << binary << std::endl;
+    ok = false;
+  }
+
   return ok ? 0 : -1;
 }
@@ -2,14 +2,22 @@
 // SPDX-License-Identifier: MIT
 #include "parser.h"
 
+#include "clone.h"
 #include "dnf.h"
 #include "escaping.h"
 #include "ident.h"
 #include "lookup.h"
 #include "path.h"
 
+#include <atomic>
 #include <cassert>
+#include <fstream>
+#include <iterator>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 namespace verona::parser
 {
@@ -22,6 +30,77 @@ namespace verona::parser
     Error,
   };
 
+  // The time spent in parts of parsing a module, when it is being measured.
+  struct ModuleTimes
+  {
+    Stats::Clock::duration read{};
+    Stats::Clock::duration lex{};
+    Stats::Clock::duration imports{};
+  };
+
+  // The file system lookups for modules made during one parse, shared by the
+  // threads that parse modules. The same module names are found from many
+  // sources, and probing for them again can be slow, such as on a network
+  // file system. Lookups are made without holding the lock, so two threads
+  // may make the same one, but only the first result is kept.
+  struct ModulePaths
+  {
+    std::mutex lock;
+
+    // Canonical paths, which are empty for paths that weren't found.
+    std::unordered_map<std::string, std::string> canonical;
+
+    // The source files of each module, from a single directory listing.
+    std::unordered_map<std::string, std::vector<std::string>> sources;
+
+    std::string find(const std::string& path)
+    {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = canonical.find(path);
+
+        if (it != canonical.end())
+          return it->second;
+      }
+
+      auto find = path::canonical(path);
+      std::lock_guard<std::mutex> guard(lock);
+      return canonical.emplace(path, find).first->second;
+    }
+
+    // The files that make up the module at `path`. A module that isn't a
+    // directory is a single file, which is only for testing.
+    const std::vector<std::string>& files(const std::string& path)
+    {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = sources.find(path);
+
+        if (it != sources.end())
+          return it->second;
+      }
+
+      std::vector<std::string> files;
+
+      if (!path::is_directory(path))
+      {
+        files.push_back(path);
+      }
+      else
+      {
+        for (auto& file : path::files(path))
+        {
+          if (ext == path::extension(file))
+            files.push_back(path::join(path, file));
+        }
+      }
+
+      // Entries are never removed, so the reference stays valid.
+      std::lock_guard<std::mutex> guard(lock);
+      return sources.emplace(path, std::move(files)).first->second;
+    }
+  };
+
   struct Parse
   {
     Source source;
@@ -36,10 +115,18 @@ namespace verona::parser
     Location name_apply;
 
     Result final_result;
-    std::vector<std::string> imports;
     std::string stdlib;
+    ModulePaths& paths;
     std::ostream& out;
 
+    // The module names found while parsing, in order, each with the canonical
+    // path of the module. Their locations are set by `parse` once the modules
+    // have been numbered.
+    std::vector<std::pair<Node<TypeName>, std::string>> module_refs;
+
+    // Set if the module is being measured.
+    ModuleTimes* times = nullptr;
+
     struct SymbolPush
     {
       Parse& parser;
@@ -52,8 +139,13 @@ namespace verona::parser
       }
     };
 
-    Parse(const std::string& stdlib, std::ostream& out)
-    : pos(0), la(0), final_result(Success), stdlib(stdlib), out(out)
+    Parse(const std::string& stdlib, ModulePaths& paths, std::ostream& out)
+    : pos(0),
+      la(0),
+      final_result(Success),
+      stdlib(stdlib),
+      paths(paths),
+      out(out)
     {
       name_apply = ident("apply");
     }
@@ -118,7 +210,7 @@ namespace verona::parser
 
     Node<Ref> ref(const Location& loc)
     {
-      auto ref = std::make_shared<Ref>();
+      auto ref = make_node<Ref>();
       ref->location = loc;
       return ref;
     }
@@ -136,10 +228,21 @@ namespace verona::parser
       return text(loc());
     }
 
+    Token lex_next()
+    {
+      if (!times)
+        return lex(source, pos);
+
+      auto begin = Stats::Clock::now();
+      auto token = lex(source, pos);
+      times->lex += Stats::Clock::now() - begin;
+      return token;
+    }
+
     bool peek(const TokenKind& kind, const char* text = nullptr)
     {
       if (la >= lookahead.size())
-        lookahead.push_back(lex(source, pos));
+        lookahead.push_back(lex_next());
 
       assert(la < lookahead.size());
 
@@ -170,7 +273,7 @@ namespace verona::parser
       assert(la == 0);
 
       if (lookahead.size() == 0)
-        return lex(source, pos);
+        return lex_next();
 
       previous = lookahead.front();
       lookahead.erase(lookahead.begin());
@@ -296,7 +399,7 @@ namespace verona::parser
         return Skip;
 
       Result r = Success;
-      auto when = std::make_shared<When>();
+      auto when = make_node<When>();
       auto st = push(when);
       when->location = previous.location;
       expr = when;
@@ -323,7 +426,7 @@ namespace verona::parser
         return Skip;
 
       Result r = Success;
-      auto tr = std::make_shared<Try>();
+      auto tr = make_node<Try>();
       auto st = push(tr);
       tr->location = previous.location;
       expr = tr;
@@ -394,7 +497,7 @@ namespace verona::parser
         return Skip;
 
       Result r = Success;
-      auto match = std::make_shared<Match>();
+      auto match = make_node<Match>();
       auto st = push(match);
       match->location = previous.location;
       expr = match;
@@ -442,7 +545,7 @@ namespace verona::parser
       if (!has(TokenKind::LParen))
         return Skip;
 
-      auto tup = std::make_shared<Tuple>();
+      auto tup = make_node<Tuple>();
       tup->location = previous.location;
       expr = tup;
 
@@ -485,7 +588,7 @@ namespace verona::parser
       if (!has(TokenKind::LBrace))
         return Skip;
 
-      auto lambda = std::make_shared<Lambda>();
+      auto lambda = make_node<Lambda>();
       auto st = push(lambda);
       lambda->location = previous.location;
       expr = lambda;
@@ -554,7 +657,7 @@ namespace verona::parser
       if (!has(TokenKind::Ident))
         return Skip;
 
-      auto ref = std::make_shared<Ref>();
+      auto ref = make_node<Ref>();
       ref->location = previous.location;
       expr = ref;
       return Success;
@@ -567,49 +670,49 @@ namespace verona::parser
       //  float / int / hex / binary / 'true' / 'false'
       if (has(TokenKind::EscapedString))
       {
-        auto con = std::make_shared<EscapedString>();
+        auto con = make_node<EscapedString>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::UnescapedString))
       {
-        auto con = std::make_shared<UnescapedString>();
+        auto con = make_node<UnescapedString>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Character))
       {
-        auto con = std::make_shared<Character>();
+        auto con = make_node<Character>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Int))
       {
-        auto con = std::make_shared<Int>();
+        auto con = make_node<Int>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Float))
       {
-        auto con = std::make_shared<Float>();
+        auto con = make_node<Float>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Hex))
       {
-        auto con = std::make_shared<Hex>();
+        auto con = make_node<Hex>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Binary))
       {
-        auto con = std::make_shared<Binary>();
+        auto con = make_node<Binary>();
         con->location = previous.location;
         expr = con;
       }
       else if (has(TokenKind::Bool))
       {
-        auto con = std::make_shared<Bool>();
+        auto con = make_node<Bool>();
         con->location = previous.location;
         expr = con;
       }
@@ -625,7 +728,7 @@ namespace verona::parser
     {
       // new <- 'new' (typebody / type typebody) ('@' ident)?
       Result r = Success;
-      auto obj = std::make_shared<ObjectLiteral>();
+      auto obj = make_node<ObjectLiteral>();
       auto st = push(obj);
       obj->location = previous.location;
       expr = obj;
@@ -673,7 +776,7 @@ namespace verona::parser
 
       // ctor <- 'new' tuple ('@' ident)?
       Result r = Success;
-      auto n = std::make_shared<New>();
+      auto n = make_node<New>();
       n->location = previous.location;
       expr = n;
 
@@ -763,7 +866,7 @@ namespace verona::parser
 
       Result r = Success;
 
-      auto sel = std::make_shared<Select>();
+      auto sel = make_node<Select>();
       sel->location = previous.location;
       sel->expr = expr;
       expr = sel;
@@ -776,7 +879,7 @@ namespace verona::parser
           return Error;
         }
 
-        auto name = std::make_shared<TypeName>();
+        auto name = make_node<TypeName>();
         name->location = previous.location;
         sel->typenames.push_back(name);
 
@@ -821,12 +924,12 @@ namespace verona::parser
       if (!ok)
         return r;
 
-      auto sel = std::make_shared<Select>();
+      auto sel = make_node<Select>();
       sel->expr = expr;
       sel->location = expr->location;
       expr = sel;
 
-      auto name = std::make_shared<TypeName>();
+      auto name = make_node<TypeName>();
       name->location = name_apply;
       sel->typenames.push_back(name);
 
@@ -896,11 +999,11 @@ namespace verona::parser
           else
           {
             // Adjacency means `expr.apply(next)`
-            auto sel = std::make_shared<Select>();
+            auto sel = make_node<Select>();
             sel->location = expr->location;
             sel->expr = expr;
 
-            auto name = std::make_shared<TypeName>();
+            auto name = make_node<TypeName>();
             name->location = name_apply;
             sel->typenames.push_back(name);
 
@@ -937,7 +1040,7 @@ namespace verona::parser
         return Error;
       }
 
-      auto let = std::make_shared<Let>();
+      auto let = make_node<Let>();
       let->location = previous.location;
       set_sym(let->location, let);
       expr = let;
@@ -955,7 +1058,7 @@ namespace verona::parser
         return Error;
       }
 
-      auto var = std::make_shared<Var>();
+      auto var = make_node<Var>();
       var->location = previous.location;
       set_sym(var->location, var);
       expr = var;
@@ -968,7 +1071,7 @@ namespace verona::parser
         return Skip;
 
       Result r = Success;
-      auto thr = std::make_shared<Throw>();
+      auto thr = make_node<Throw>();
       thr->location = previous.location;
       expr = thr;
 
@@ -1012,7 +1115,7 @@ namespace verona::parser
       if (peek(TokenKind::Colon))
       {
         rewind();
-        auto ot = std::make_shared<Oftype>();
+        auto ot = make_node<Oftype>();
         ot->expr = expr;
         expr = ot;
 
@@ -1022,7 +1125,7 @@ namespace verona::parser
 
       if (has(TokenKind::Equals))
       {
-        auto asgn = std::make_shared<Assign>();
+        auto asgn = make_node<Assign>();
         asgn->location = previous.location;
         asgn->left = expr;
         expr = asgn;
@@ -1047,7 +1150,7 @@ namespace verona::parser
       Result r;
 
       // Encode an initexpr as a zero-argument lambda
-      auto lambda = std::make_shared<Lambda>();
+      auto lambda = make_node<Lambda>();
       auto st = push(lambda);
       lambda->location = previous.location;
       expr = lambda;
@@ -1073,7 +1176,7 @@ namespace verona::parser
       if (!has(TokenKind::LParen))
         return Skip;
 
-      auto tup = std::make_shared<TupleType>();
+      auto tup = make_node<TupleType>();
       tup->location = previous.location;
       type = tup;
 
@@ -1114,31 +1217,26 @@ namespace verona::parser
 
       Result r = Success;
 
-      name = std::make_shared<ModuleName>();
+      name = make_node<ModuleName>();
       name->location = previous.location;
 
       // Look for a module relative to the current source file first.
+      auto begin = Stats::Clock::now();
       auto base = path::to_directory(escapedstring(name->location.view()));
       auto relative = path::join(source->origin, base);
       auto std = path::join(stdlib, base);
-      auto find = path::canonical(relative);
+      auto find = paths.find(relative);
 
       // Otherwise, look for a module relative to the standard library.
       if (find.empty())
-        find = path::canonical(std);
+        find = paths.find(std);
+
+      if (times)
+        times->imports += Stats::Clock::now() - begin;
 
       if (!find.empty())
       {
-        auto it = std::find(imports.begin(), imports.end(), find);
-        size_t i = it - imports.begin();
-
-        if (it == imports.end())
-        {
-          i = imports.size();
-          imports.push_back(find);
-        }
-
-        name->location = ident("$module-" + std::to_string(i));
+        module_refs.emplace_back(name, find);
       }
       else
       {
@@ -1166,7 +1264,7 @@ namespace verona::parser
         return Skip;
 
       rewind();
-      auto typeref = std::make_shared<TypeRef>();
+      auto typeref = make_node<TypeRef>();
       type = typeref;
 
       Result r = Success;
@@ -1191,7 +1289,7 @@ namespace verona::parser
           return Error;
         }
 
-        auto name = std::make_shared<TypeName>();
+        auto name = make_node<TypeName>();
         name->location = previous.location;
 
         typeref->location = name->location;
@@ -1212,7 +1310,7 @@ namespace verona::parser
       if (!ok)
         return Skip;
 
-      auto tl = std::make_shared<TypeList>();
+      auto tl = make_node<TypeList>();
       type = tl;
 
       if (!has(TokenKind::Ident))
@@ -1232,7 +1330,7 @@ namespace verona::parser
       //  'iso' / 'mut' / 'imm' / 'Self' / tupletype / typelist / typeref
       if (has(TokenKind::Iso))
       {
-        auto cap = std::make_shared<Iso>();
+        auto cap = make_node<Iso>();
         cap->location = previous.location;
         type = cap;
         return Success;
@@ -1240,7 +1338,7 @@ namespace verona::parser
 
       if (has(TokenKind::Mut))
       {
-        auto cap = std::make_shared<Mut>();
+        auto cap = make_node<Mut>();
         cap->location = previous.location;
         type = cap;
         return Success;
@@ -1248,7 +1346,7 @@ namespace verona::parser
 
       if (has(TokenKind::Imm))
       {
-        auto cap = std::make_shared<Imm>();
+        auto cap = make_node<Imm>();
         cap->location = previous.location;
         type = cap;
         return Success;
@@ -1256,7 +1354,7 @@ namespace verona::parser
 
       if (has(TokenKind::Self))
       {
-        auto self = std::make_shared<Self>();
+        auto self = make_node<Self>();
         self->location = previous.location;
         type = self;
         return Success;
@@ -1289,9 +1387,9 @@ namespace verona::parser
       while (true)
       {
         if (has(TokenKind::Symbol, "~>"))
-          pair = std::make_shared<ViewType>();
+          pair = make_node<ViewType>();
         else if (has(TokenKind::Symbol, "<~"))
-          pair = std::make_shared<ExtractType>();
+          pair = make_node<ExtractType>();
         else
           break;
 
@@ -1324,7 +1422,7 @@ namespace verona::parser
       if (!has(TokenKind::Symbol, "->"))
         return Success;
 
-      auto functype = std::make_shared<FunctionType>();
+      auto functype = make_node<FunctionType>();
       functype->location = previous.location;
       functype->left = type;
       type = functype;
@@ -1444,7 +1542,7 @@ namespace verona::parser
         {
           Result r = Success;
           has(TokenKind::Ident);
-          auto p = std::make_shared<Param>();
+          auto p = make_node<Param>();
           p->location = previous.location;
 
           if (oftype(p->type) == Error)
@@ -1508,7 +1606,7 @@ namespace verona::parser
       if (!has(TokenKind::Ident))
         return Skip;
 
-      auto field = std::make_shared<Field>();
+      auto field = make_node<Field>();
       field->location = previous.location;
       Result r = Success;
 
@@ -1542,7 +1640,7 @@ namespace verona::parser
       if (!ok)
         return Skip;
 
-      auto func = std::make_shared<Function>();
+      auto func = make_node<Function>();
       auto st = push(func);
       Result r = Success;
 
@@ -1614,9 +1712,9 @@ namespace verona::parser
       auto loc = previous.location;
 
       if (has(TokenKind::Ellipsis))
-        tp = std::make_shared<TypeParamList>();
+        tp = make_node<TypeParamList>();
       else
-        tp = std::make_shared<TypeParam>();
+        tp = make_node<TypeParam>();
 
       tp->location = loc;
 
@@ -1730,7 +1828,7 @@ namespace verona::parser
       if (!has(TokenKind::Using))
         return Skip;
 
-      auto use = std::make_shared<Using>();
+      auto use = make_node<Using>();
       use->location = previous.location;
 
       Result r;
@@ -1760,7 +1858,7 @@ namespace verona::parser
       if (!has(TokenKind::Type))
         return Skip;
 
-      auto alias = std::make_shared<TypeAlias>();
+      auto alias = make_node<TypeAlias>();
       alias->location = previous.location;
       Result r = Success;
 
@@ -1803,7 +1901,7 @@ namespace verona::parser
       if (!has(TokenKind::Interface))
         return Skip;
 
-      auto iface = std::make_shared<Interface>();
+      auto iface = make_node<Interface>();
       auto st = push(iface);
       iface->location = previous.location;
       Result r = Success;
@@ -1825,7 +1923,7 @@ namespace verona::parser
       if (!has(TokenKind::Class))
         return Skip;
 
-      auto cls = std::make_shared<Class>();
+      auto cls = make_node<Class>();
       auto st = push(cls);
       cls->location = previous.location;
       Result r = Success;
@@ -1847,7 +1945,7 @@ namespace verona::parser
       if (!has(TokenKind::Module))
         return Skip;
 
-      auto mod = std::make_shared<Module>();
+      auto mod = make_node<Module>();
       mod->location = previous.location;
       Result r = Success;
 
@@ -1953,8 +2051,12 @@ namespace verona::parser
     Result sourcefile(
       const std::string& file, Node<Class>& module, Node<Module>& moduledef)
     {
+      auto begin = Stats::Clock::now();
       auto source = load_source(file);
 
+      if (times)
+        times->read += Stats::Clock::now() - begin;
+
       if (!source)
       {
         error() << "Couldn't read file " << file << std::endl;
@@ -1992,75 +2094,273 @@ namespace verona::parser
       return final_result;
     }
 
-    // `path` can't be a reference, because `imports` may be modified during
-    // parsing.
-    Result
-    module(const std::string path, size_t module_index, Node<Class>& program)
+    Node<Class> module(const std::string& path, size_t module_index)
     {
-      auto modulename = ident("$module-" + std::to_string(module_index));
-
-      if (look_in(symbol_stack.front(), modulename))
-        return final_result;
-
       Node<Module> moduledef;
-      auto r = Success;
 
-      auto module = std::make_shared<Class>();
+      auto module = make_node<Class>();
       auto st = push(module);
-      module->id = modulename;
-      program->members.push_back(module);
-      set_sym_parent(module->id, module);
+      module->id = ident("$module-" + std::to_string(module_index));
 
-      if (!path::is_directory(path))
+      auto& files = paths.files(path);
+
+      for (auto& file : files)
+        sourcefile(file, module, moduledef);
+
+      if (files.empty())
+        error() << "No " << ext << " files found in " << path << std::endl;
+
+      if (moduledef)
       {
-        // This is only for testing.
-        r = sourcefile(path, module, moduledef);
+        module->typeparams = std::move(moduledef->typeparams);
+        module->inherits = moduledef->inherits;
       }
-      else
+
+      return module;
+    }
+  };
+
+  // A module parsed on its own, with the errors it reported.
+  struct ParsedModule
+  {
+    Node<Class> module;
+    std::vector<std::pair<Node<TypeName>, std::string>> module_refs;
+    std::stringstream errors;
+    bool ok = false;
+
+    // A new entry for the cache, if the module was parsed.
+    std::optional<ModuleCache::Entry> entry;
+
+    // If `measure` is set, the phases of parsing the module.
+    bool measure = false;
+    std::vector<Stats::Phase> phases;
+  };
+
+  size_t hash_combine(size_t seed, size_t hash)
+  {
+    return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+  }
+
+  // A hash of the names and contents of the files that `Parse::module` reads
+  // for the module at `path`.
+  size_t module_hash(const std::string& path, ModulePaths& paths)
+  {
+    auto& files = paths.files(path);
+    size_t hash = 0;
+
+    for (auto& file : files)
+    {
+      std::ifstream f(file.c_str(), std::ios::binary);
+      std::string contents(std::istreambuf_iterator<char>(f), {});
+      hash = hash_combine(hash, std::hash<std::string>()(file));
+      hash = hash_combine(hash, f.good() || f.eof());
+      hash = hash_combine(hash, std::hash<std::string>()(contents));
+    }
+
+    return hash;
+  }
+
+  void parse_module(
+    const std::string& path,
+    size_t module_index,
+    const std::string& stdlib,
+    ModulePaths& paths,
+    ParsedModule& result)
+  {
+    Stats::Stopwatch watch;
+    ModuleTimes times;
+    Parse parse(stdlib, paths, result.errors);
+
+    if (result.measure)
+      parse.times = &times;
+
+    result.module = parse.module(path, module_index);
+    result.module_refs = std::move(parse.module_refs);
+    result.ok = parse.final_result == Success;
+
+    if (result.measure)
+    {
+      // Parsing is whatever isn't reading, lexing, or looking for imports,
+      // and it makes every node.
+      auto rest = watch.time() - times.read - times.lex - times.imports;
+      result.phases.push_back({"read", path, times.read, {}});
+      result.phases.push_back({"lex", path, times.lex, {}});
+      result.phases.push_back({"imports", path, times.imports, {}});
+      result.phases.push_back({"parse", path, rest, watch.allocated()});
+    }
+  }
+
+  // Returns a copy of `module`, and replaces the module names in `refs` with
+  // their copies.
+  Node<Class> copy_module(
+    Node<Class>& module,
+    std::vector<std::pair<Node<TypeName>, std::string>>& refs)
+  {
+    AstPath track;
+
+    for (auto& ref : refs)
+      track.push_back(ref.first);
+
+    auto copy = node_cast<Class>(clone(module, track));
+
+    for (size_t i = 0; i < refs.size(); i++)
+      refs[i].first = node_cast<TypeName>(track[i]);
+
+    return copy;
+  }
+
+  void parse_module(
+    const std::string& path,
+    size_t module_index,
+    const std::string& stdlib,
+    ModulePaths& paths,
+    ModuleCache& cache,
+    ParsedModule& result)
+  {
+    // The cache is only read here, as modules are parsed concurrently. New
+    // entries are added by `parse`.
+    Stats::Stopwatch watch;
+    auto hash = module_hash(path, paths);
+    auto find = cache.modules.find(path);
+
+    if ((find == cache.modules.end()) || (find->second.hash != hash))
+    {
+      auto hash_time = watch.time();
+      parse_module(path, module_index, stdlib, paths, result);
+
+      // Keep a copy for the cache, and return the module as it was parsed.
+      Stats::Stopwatch copy;
+      auto& entry = result.entry.emplace();
+      entry.hash = hash;
+      entry.module_refs = result.module_refs;
+      entry.module = copy_module(result.module, entry.module_refs);
+      entry.errors = result.errors.str();
+      entry.ok = result.ok;
+
+      if (result.measure)
       {
-        auto files = path::files(path);
-        size_t count = 0;
+        result.phases.push_back(
+          {"cache", path, hash_time + copy.time(), copy.allocated()});
+      }
+      return;
+    }
+
+    auto& entry = find->second;
+    result.module_refs = entry.module_refs;
+    result.module = copy_module(entry.module, result.module_refs);
+    result.errors << entry.errors;
+    result.ok = entry.ok;
+
+    if (result.measure)
+      result.phases.push_back({"cache", path, watch.time(), watch.allocated()});
+  }
+
+  std::pair<bool, Ast> parse(
+    const std::string& path,
+    const std::string& stdlib,
+    std::ostream& out,
+    ModuleCache* cache,
+    Stats* stats)
+  {
+    Stats::Stopwatch watch;
+    ArenaUse allocated;
+    auto program = make_node<Class>();
+    std::vector<std::string> imports{path::canonical(path)};
+    ModulePaths paths;
+    Ident ident;
+    bool ok = true;
+
+    if (cache && (cache->stdlib != stdlib))
+    {
+      cache->stdlib = stdlib;
+      cache->modules.clear();
+    }
+
+    // Modules are parsed independently, so all the modules found so far are
+    // parsed concurrently. Merging the results in order numbers the modules
+    // they found, and reports errors, as parsing them one at a time would.
+    for (size_t first = 0; first < imports.size();)
+    {
+      std::vector<ParsedModule> parsed(imports.size() - first);
+      std::atomic<size_t> next = 0;
 
-        for (auto& file : files)
+      for (auto& p : parsed)
+        p.measure = (stats != nullptr);
+
+      auto worker = [&]() {
+        for (size_t i; (i = next++) < parsed.size();)
         {
-          if (ext != path::extension(file))
-            continue;
+          auto& path = imports[first + i];
 
-          auto filename = path::join(path, file);
-          count++;
+          if (cache)
+            parse_module(path, first + i, stdlib, paths, *cache, parsed[i]);
+          else
+            parse_module(path, first + i, stdlib, paths, parsed[i]);
+        }
+      };
 
-          if (sourcefile(filename, module, moduledef) == Error)
-            r = Error;
+      auto threads = std::min<size_t>(
+        parsed.size(), std::max(1u, std::thread::hardware_concurrency()));
+      std::vector<std::thread> pool;
+
+      for (size_t i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+
+      worker();
+
+      for (auto& t : pool)
+        t.join();
+
+      auto wave = first;
+      first = imports.size();
+
+      for (size_t i = 0; i < parsed.size(); i++)
+      {
+        auto& p = parsed[i];
+        out << p.errors.str();
+        ok = ok && p.ok;
+
+        if (stats)
+        {
+          // Modules are parsed on other threads, so their nodes are counted
+          // here rather than by `watch`.
+          for (auto& phase : p.phases)
+          {
+            allocated += phase.allocated;
+            stats->phases.push_back(phase);
+          }
         }
 
-        if (!count)
+        if (cache)
         {
-          error() << "No " << ext << " files found in " << path << std::endl;
-          r = Error;
+          auto index = wave + i;
+
+          if (p.entry)
+            cache->modules[imports[index]] = std::move(p.entry.value());
+
+          // A module from the cache may have had a different index before.
+          p.module->id = ident("$module-" + std::to_string(index));
         }
-      }
 
-      if (moduledef)
-      {
-        module->typeparams = std::move(moduledef->typeparams);
-        module->inherits = moduledef->inherits;
-      }
+        program->members.push_back(p.module);
+        program->symbol_table()->set(p.module->id, p.module);
 
-      return r;
-    }
-  };
+        for (auto& [name, find] : p.module_refs)
+        {
+          auto it = std::find(imports.begin(), imports.end(), find);
 
-  std::pair<bool, Ast>
-  parse(const std::string& path, const std::string& stdlib, std::ostream& out)
-  {
-    Parse parse(stdlib, out);
-    auto program = std::make_shared<Class>();
-    auto st = parse.push(program);
-    parse.imports.push_back(path::canonical(path));
+          if (it == imports.end())
+            it = imports.insert(it, find);
+
+          name->location =
+            ident("$module-" + std::to_string(it - imports.begin()));
+        }
+      }
+    }
 
-    for (size_t i = 0; i < parse.imports.size(); i++)
-      parse.module(parse.imports[i], i, program);
+    if (stats)
+      stats->add("parse", watch.time(), allocated);
 
-    return {parse.final_result == Success, program};
+    return {ok, program};
   }
 }
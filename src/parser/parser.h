@@ -3,13 +3,41 @@
 #pragma once
 
 #include "ast.h"
+#include "stats.h"
 
 #include <iostream>
+#include <unordered_map>
 
 namespace verona::parser
 {
+  // Parsed modules, kept from one call to `parse` to the next for incremental
+  // use, such as by an editor. Each module is keyed by its canonical path, and
+  // is parsed again only when the names or contents of its source files
+  // change. Passes rewrite the AST, so the cache keeps a copy of each module
+  // that `parse` never returns, and the program gets a copy of that instead.
+  struct ModuleCache
+  {
+    struct Entry
+    {
+      size_t hash = 0;
+      Node<Class> module;
+      std::vector<std::pair<Node<TypeName>, std::string>> module_refs;
+      std::string errors;
+      bool ok = false;
+    };
+
+    // Modules are found relative to the standard library, so the cache is
+    // emptied if it changes.
+    std::string stdlib;
+    std::unordered_map<std::string, Entry> modules;
+  };
+
+  // If `stats` isn't null, the phases of parsing each module are added to it,
+  // followed by a `parse` phase for the whole program.
   std::pair<bool, Ast> parse(
     const std::string& path,
     const std::string& stdlib,
-    std::ostream& out = std::cerr);
+    std::ostream& out = std::cerr,
+    ModuleCache* cache = nullptr,
+    Stats* stats = nullptr);
 }
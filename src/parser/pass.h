@@ -5,18 +5,40 @@
 #include "dispatch.h"
 #include "fields.h"
 
+#include <array>
+#include <chrono>
 #include <iostream>
+#include <tuple>
 
 namespace verona::parser
 {
+  // The result of the default hooks, so that `Fused` can skip them.
+  struct NoHook
+  {};
+
+  // The field of its parent that holds a node being visited, so that the node
+  // can be replaced in place, see `Pass::replace`.
+  struct Slot
+  {
+    void* field;
+    void (*set)(void* field, Ast node);
+  };
+
 #define AST_PASS \
-  void pre(NodeDef& node) {} \
-  void post(NodeDef& node) {}
+  NoHook pre(NodeDef& node) \
+  { \
+    return {}; \
+  } \
+  NoHook post(NodeDef& node) \
+  { \
+    return {}; \
+  }
 
   template<typename F>
   struct Pass
   {
     AstPath stack;
+    std::vector<Slot> slots;
     bool ok;
     std::ostream out;
 
@@ -69,11 +91,30 @@ namespace verona::parser
     Pass& operator<<(Node<T>& node)
     {
       stack.push_back(node);
+      slots.push_back({&node, &set_field<T>});
       dispatch(*this, node);
+      slots.pop_back();
       stack.pop_back();
       return *this;
     }
 
+    // Replaces the node being visited with `node`, both in the field of its
+    // parent that holds it and on the stack. The field is written directly,
+    // without searching the parent for it. Hooks must not add to a list while
+    // its elements are being visited, as that could move the field.
+    void replace(Ast node)
+    {
+      auto& slot = slots.back();
+      slot.set(slot.field, node);
+      stack.back() = node;
+    }
+
+    template<typename T>
+    static void set_field(void* field, Ast node)
+    {
+      *static_cast<Node<T>*>(field) = node_cast<T>(node);
+    }
+
     template<typename T>
     Pass& operator<<(List<T>& nodes)
     {
@@ -99,4 +140,118 @@ namespace verona::parser
       static_cast<F*>(this)->post(node);
     }
   };
+
+  // Runs several passes in one traversal of the AST. At each node, the
+  // passes' pre hooks run in order, then the fields are visited, then the
+  // post hooks run in order. As with `Pass`, once a hook replaces the node,
+  // the hooks after it don't run for that node. The default hooks from
+  // `AST_PASS` aren't called at all.
+  //
+  // This has the same result as running the passes one after another only
+  // if no pass looks at anything that an earlier pass changes after the
+  // later pass has seen it. A check that only looks at types, for example,
+  // can share a traversal with a pass that doesn't change types.
+  template<typename... Ps>
+  struct Fused : Pass<Fused<Ps...>>
+  {
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t count = sizeof...(Ps);
+
+    std::tuple<Ps...> passes;
+
+    // Passes that aren't enabled are skipped.
+    std::array<bool, count> enabled;
+
+    // If `timed` is set, the time spent in each pass's hooks is added to
+    // `time`, and the nodes they allocate to `allocated`. This reads the
+    // clock around every hook, which slows the traversal down.
+    bool timed = false;
+    std::array<Clock::duration, count> time{};
+    std::array<ArenaUse, count> allocated{};
+
+    Fused()
+    {
+      enabled.fill(true);
+    }
+
+    void set_error(std::ostream& s)
+    {
+      std::apply([&](auto&... pass) { (pass.set_error(s), ...); }, passes);
+    }
+
+    // Returns true if no enabled pass reported an error.
+    bool run(Ast& ast)
+    {
+      *this << ast;
+      return passed(std::index_sequence_for<Ps...>{});
+    }
+
+    template<typename T>
+    void pre(T& node)
+    {
+      hooks<true>(node, std::index_sequence_for<Ps...>{});
+    }
+
+    template<typename T>
+    void post(T& node)
+    {
+      hooks<false>(node, std::index_sequence_for<Ps...>{});
+    }
+
+  private:
+    template<size_t... I>
+    bool passed(std::index_sequence<I...>)
+    {
+      return (... && (!enabled[I] || std::get<I>(passes)));
+    }
+
+    template<bool Pre, typename T, size_t... I>
+    void hooks(T& node, std::index_sequence<I...>)
+    {
+      Ast check = this->stack.back();
+      (... && hook<Pre, I>(node, check));
+    }
+
+    template<bool Pre, size_t I, typename T>
+    bool hook(T& node, Ast& check)
+    {
+      auto& pass = std::get<I>(passes);
+
+      if constexpr (Pre)
+      {
+        if constexpr (std::is_same_v<decltype(pass.pre(node)), NoHook>)
+          return true;
+      }
+      else
+      {
+        if constexpr (std::is_same_v<decltype(pass.post(node)), NoHook>)
+          return true;
+      }
+
+      if (!enabled[I])
+        return true;
+
+      // Lend the traversal's stack to the pass, so that it sees the same
+      // path and can replace the node.
+      std::swap(pass.stack, this->stack);
+      std::swap(pass.slots, this->slots);
+      auto start = timed ? Clock::now() : Clock::time_point();
+      auto use = timed ? arena_use() : ArenaUse();
+
+      if constexpr (Pre)
+        pass.pre(node);
+      else
+        pass.post(node);
+
+      if (timed)
+      {
+        time[I] += Clock::now() - start;
+        allocated[I] += arena_use() - use;
+      }
+
+      std::swap(pass.slots, this->slots);
+      std::swap(pass.stack, this->stack);
+      return this->stack.back() == check;
+    }
+  };
 }
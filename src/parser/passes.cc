@@ -0,0 +1,71 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "passes.h"
+
+#include "anf.h"
+#include "dnf.h"
+#include "resolve.h"
+
+namespace verona::parser::passes
+{
+  template<typename F>
+  bool traverse(
+    F& f,
+    Ast& ast,
+    const std::array<const char*, F::count>& names,
+    Stats* stats)
+  {
+    f.timed = (stats != nullptr);
+    Stats::Stopwatch watch;
+    auto ok = f.run(ast);
+
+    if (stats)
+    {
+      auto walk = watch.time();
+      auto allocated = watch.allocated();
+
+      for (size_t i = 0; i < F::count; i++)
+      {
+        if (f.enabled[i])
+        {
+          stats->add(names[i], f.time[i], f.allocated[i]);
+          walk -= f.time[i];
+          allocated = allocated - f.allocated[i];
+        }
+      }
+
+      stats->add("traversal", walk, allocated);
+    }
+
+    return ok;
+  }
+
+  bool run(Ast& ast, const Options& options, Stats* stats, std::ostream& out)
+  {
+    // Resolving names doesn't change types, so checking that types are in
+    // DNF can share its traversal. ANF can't: it lifts expressions out of
+    // nodes that resolve still looks at from their parents, such as a
+    // selector on the left of another selector, and resolve collapses tuples
+    // that ANF would otherwise lift from.
+    Fused<dnf::WF, resolve::Resolve, resolve::WF> resolve;
+    resolve.enabled = {options.validate, true, options.validate};
+    resolve.set_error(out);
+
+    if (!traverse(
+          resolve,
+          ast,
+          {"dnf::wellformed", "resolve::run", "resolve::wellformed"},
+          stats))
+    {
+      return false;
+    }
+
+    if (!options.anf)
+      return true;
+
+    Fused<anf::ANF, anf::WF> anf;
+    anf.enabled = {true, options.validate};
+    anf.set_error(out);
+    return traverse(anf, ast, {"anf::run", "anf::wellformed"}, stats);
+  }
+}
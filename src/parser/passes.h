@@ -0,0 +1,25 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "stats.h"
+
+namespace verona::parser::passes
+{
+  struct Options
+  {
+    // Check the AST after each pass.
+    bool validate = false;
+
+    // Transform to ANF after resolving names.
+    bool anf = false;
+  };
+
+  // Runs the passes that follow parsing, sharing traversals where the passes
+  // allow it. If `stats` isn't null, each pass is added to it.
+  bool run(
+    Ast& ast,
+    const Options& options,
+    Stats* stats = nullptr,
+    std::ostream& out = std::cerr);
+}
@@ -41,7 +41,7 @@ namespace verona::parser
 
   PrettyStream& operator<<(PrettyStream& out, Location& loc)
   {
-    if (!loc.source)
+    if (!loc.source_index)
       return out << sep << "()";
 
     return out << sep << loc.view();
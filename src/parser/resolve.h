@@ -2,10 +2,33 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "ident.h"
 #include "pass.h"
 
 namespace verona::parser::resolve
 {
+  // This checks that names refer to definitions, and turns selectors that
+  // name a type into constructor calls.
+  struct Resolve : Pass<Resolve>
+  {
+    AST_PASS;
+
+    Ident ident;
+    Location name_create;
+
+    Resolve();
+
+    void post(TypeRef& tr);
+    void post(TypeList& tl);
+    void post(Select& select);
+    void post(Tuple& tuple);
+  };
+
+  struct WF : Pass<WF>
+  {
+    AST_PASS;
+  };
+
   bool run(Ast& ast, std::ostream& out = std::cerr);
   bool wellformed(Ast& ast, std::ostream& out = std::cerr);
 }
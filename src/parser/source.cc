@@ -4,12 +4,79 @@
 
 #include "path.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define USE_MMAP
+#endif
 
 namespace verona::parser
 {
+  // Sources by index, in segments that never move, so that they can be read
+  // without taking the lock.
+  constexpr size_t segment_bits = 10;
+  constexpr size_t segment_size = size_t(1) << segment_bits;
+  constexpr size_t max_segments = 4096;
+
+  std::mutex sources_lock;
+  std::vector<Source> sources;
+  std::unique_ptr<SourceDef*[]> segments[max_segments];
+
+  SourceDef* source_at(uint32_t index)
+  {
+    if (!index)
+      return nullptr;
+
+    return segments[index >> segment_bits][index & (segment_size - 1)];
+  }
+
+  // Interned names, where the ID of a name is its index in `names` plus 1.
+  std::mutex names_lock;
+  std::unordered_map<std::string_view, uint32_t> ids;
+  std::deque<std::string> names;
+
+  uint32_t intern(std::string_view name)
+  {
+    std::lock_guard<std::mutex> guard(names_lock);
+    auto find = ids.find(name);
+
+    if (find != ids.end())
+      return find->second;
+
+    // The deque doesn't move the names, so the keys stay valid.
+    auto& text = names.emplace_back(name);
+    auto id = static_cast<uint32_t>(names.size());
+    ids.emplace(text, id);
+    return id;
+  }
+
+  std::string_view interned(uint32_t id)
+  {
+    std::lock_guard<std::mutex> guard(names_lock);
+
+    if ((id == 0) || (id > names.size()))
+      return {};
+
+    return names[id - 1];
+  }
+
   std::string_view Location::view() const
   {
+    auto source = this->source();
+
     if (!source)
       return {};
 
@@ -19,25 +86,12 @@ namespace verona::parser
 
   std::pair<size_t, size_t> Location::linecol() const
   {
+    auto source = this->source();
+
     if (!source)
       return {0, 0};
 
-    std::string_view view{source->contents};
-    view = view.substr(0, start);
-    size_t line = std::count(view.begin(), view.end(), '\n') + 1;
-    size_t col;
-
-    if (line > 1)
-    {
-      auto pos = view.find_last_of('\n');
-      col = start - pos;
-    }
-    else
-    {
-      col = start + 1;
-    }
-
-    return {line, col};
+    return source->linecol(start);
   }
 
   bool Location::operator==(const char* text) const
@@ -47,16 +101,21 @@ namespace verona::parser
 
   bool Location::operator==(const Location& that) const
   {
+    if (ident && that.ident)
+      return ident == that.ident;
+
     return view() == that.view();
   }
 
   std::ostream& operator<<(std::ostream& out, const Location& loc)
   {
-    if (!loc.source)
+    auto source = loc.source();
+
+    if (!source)
       return out;
 
     auto linecol = loc.linecol();
-    return out << loc.source->origin << ":" << linecol.first << ":"
+    return out << source->origin << ":" << linecol.first << ":"
                << linecol.second << ": ";
   }
 
@@ -64,10 +123,12 @@ namespace verona::parser
   {
     auto& loc = text.loc;
 
-    if (!loc.source)
+    auto source = loc.source();
+
+    if (!source)
       return out << std::endl;
 
-    auto& contents = loc.source->contents;
+    auto& contents = source->contents;
     std::string_view view{contents};
     auto before = view.substr(0, loc.start);
     auto start = before.find_last_of('\n');
@@ -87,7 +148,7 @@ namespace verona::parser
 
     auto line = view.substr(start, end - start);
     auto col = loc.start - start;
-    auto lead = contents.substr(start, col);
+    auto lead = std::string(contents.substr(start, col));
     auto locend = loc.end > end ? end : loc.end;
 
     for (auto i = 0; i < lead.size(); i++)
@@ -101,24 +162,115 @@ namespace verona::parser
                << lead << std::string(locend - loc.start + 1, '^') << std::endl;
   }
 
+  Source make_source()
+  {
+    auto source = std::make_shared<SourceDef>();
+    std::lock_guard<std::mutex> guard(sources_lock);
+
+    // Index 0 is no source.
+    auto index = sources.size() + 1;
+
+    if (index >= max_segments * segment_size)
+      abort();
+
+    auto& segment = segments[index >> segment_bits];
+
+    if (!segment)
+      segment = std::make_unique<SourceDef*[]>(segment_size);
+
+    segment[index & (segment_size - 1)] = source.get();
+    source->index = static_cast<uint32_t>(index);
+    sources.push_back(source);
+    return source;
+  }
+
+  std::pair<size_t, size_t> SourceDef::linecol(size_t pos)
+  {
+    std::lock_guard<std::mutex> guard(lines_lock);
+
+    // Index the text appended since the last call.
+    for (; indexed < contents.size(); indexed++)
+    {
+      if (contents[indexed] == '\n')
+        lines.push_back(static_cast<uint32_t>(indexed + 1));
+    }
+
+    // The number of lines that start at or before `pos`, after the first.
+    auto after = std::upper_bound(lines.begin(), lines.end(), pos);
+    size_t line = after - lines.begin();
+
+    if (line == 0)
+      return {1, pos + 1};
+
+    return {line + 1, pos - lines[line - 1] + 1};
+  }
+
+  SourceDef::~SourceDef()
+  {
+#ifdef USE_MMAP
+    if (mapped)
+      munmap(const_cast<char*>(contents.data()), contents.size());
+#endif
+  }
+
   Source load_source(const std::string& file)
   {
-    std::ifstream f(file.c_str(), std::ios::binary | std::ios::ate);
+    auto source = make_source();
+    source->origin = path::canonical(file);
 
-    if (!f)
+#ifdef USE_MMAP
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
       return {};
 
-    auto size = f.tellg();
-    f.seekg(0, std::ios::beg);
+    // Map regular files into memory, rather than copying them.
+    struct stat st;
 
-    auto source = std::make_shared<SourceDef>();
-    source->origin = path::canonical(file);
-    source->contents.resize(size);
-    f.read(&source->contents[0], size);
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0))
+    {
+      auto size = static_cast<size_t>(st.st_size);
+      auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (p != MAP_FAILED)
+      {
+        close(fd);
+        source->contents = {static_cast<const char*>(p), size};
+        source->mapped = true;
+        return source;
+      }
+    }
+
+    // Read anything else, such as a pipe, to its end.
+    char buf[64 * 1024];
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) != 0)
+    {
+      if ((len == -1) && (errno != EINTR))
+        break;
+
+      if (len > 0)
+        source->buffer.append(buf, len);
+    }
+
+    close(fd);
+
+    if (len == -1)
+      return {};
+#else
+    std::ifstream f(file.c_str(), std::ios::binary);
 
     if (!f)
       return {};
 
+    source->buffer.assign(std::istreambuf_iterator<char>(f), {});
+
+    if (f.bad())
+      return {};
+#endif
+
+    source->contents = source->buffer;
     return source;
   }
 }
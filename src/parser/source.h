@@ -3,38 +3,106 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace verona::parser
 {
   struct SourceDef
   {
     std::string origin;
-    std::string contents;
+
+    // The text of the source, which is either `buffer` or, for a file that
+    // was mapped into memory, the mapping.
+    std::string_view contents;
+    std::string buffer;
+    bool mapped = false;
+
+    uint32_t index = 0;
+
+    // The offset of the start of each line after the first, found on the
+    // first call to `linecol` and extended when text has been appended since.
+    // Locations can be printed from any thread, so this has a lock.
+    std::mutex lines_lock;
+    std::vector<uint32_t> lines;
+    size_t indexed = 0;
+
+    SourceDef() = default;
+    SourceDef(const SourceDef&) = delete;
+    SourceDef& operator=(const SourceDef&) = delete;
+    ~SourceDef();
+
+    // Append to the text of a source that isn't mapped.
+    void append(std::string_view text)
+    {
+      assert(!mapped);
+      buffer.append(text);
+      contents = buffer;
+    }
+
+    // The 1-based line and column of the offset `pos`.
+    std::pair<size_t, size_t> linecol(size_t pos);
   };
 
   using Source = std::shared_ptr<SourceDef>;
 
+  // Returns the ID of `name`. Equal names have the same ID, so names can be
+  // compared and hashed by ID instead of by text. 0 is never an ID.
+  uint32_t intern(std::string_view name);
+
+  // Returns the name with the ID `id`, or an empty name if there isn't one.
+  std::string_view interned(uint32_t id);
+
+  // Returns the source with the index `index`, see `make_source`, or null for
+  // index 0.
+  SourceDef* source_at(uint32_t index);
+
   struct Location
   {
-    Source source;
-    uint32_t start;
-    uint32_t end;
+    // The index of the source, see `make_source`, which keeps a location to
+    // 16 bytes. 0 is no source.
+    uint32_t source_index = 0;
+    uint32_t start = 0;
+    uint32_t end = 0;
+
+    // The ID of the text, see `id`, or 0 if it hasn't been interned yet.
+    mutable uint32_t ident = 0;
 
     Location() = default;
 
-    Location(Source& source, size_t start, size_t end)
-    : source(source),
+    Location(SourceDef* source, size_t start, size_t end)
+    : source_index(source ? source->index : 0),
       start(static_cast<uint32_t>(start)),
       end(static_cast<uint32_t>(end))
     {}
 
+    Location(const Source& source, size_t start, size_t end)
+    : Location(source.get(), start, end)
+    {}
+
+    SourceDef* source() const
+    {
+      return source_at(source_index);
+    }
+
     std::string_view view() const;
     std::pair<size_t, size_t> linecol() const;
 
+    // The interned ID of the text. It is cached, so that copies made after
+    // the first call don't look it up again.
+    uint32_t id() const
+    {
+      if (!ident)
+        ident = intern(view());
+
+      return ident;
+    }
+
     bool operator==(const char* text) const;
     bool operator==(const Location& that) const;
 
@@ -51,9 +119,9 @@ namespace verona::parser
     Location range(const Location& that)
     {
       // Create a synthetic location that includes both locations.
-      assert(this->source == that.source);
+      assert(this->source_index == that.source_index);
       return Location(
-        this->source,
+        this->source(),
         std::min(this->start, that.start),
         std::max(this->end, that.end));
     }
@@ -69,6 +137,9 @@ namespace verona::parser
   std::ostream& operator<<(std::ostream& out, const Location& loc);
   std::ostream& operator<<(std::ostream& out, const text& text);
 
+  // Sources are kept until the process exits, so that locations can refer
+  // to them by index.
+  Source make_source();
   Source load_source(const std::string& file);
 }
 
@@ -0,0 +1,114 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include "stats.h"
+
+#include <iomanip>
+
+namespace verona::parser
+{
+  double as_ms(Stats::Clock::duration time)
+  {
+    return std::chrono::duration<double, std::milli>(time).count();
+  }
+
+  void json_string(std::ostream& out, const std::string& s)
+  {
+    out << '"';
+
+    for (auto c : s)
+    {
+      switch (c)
+      {
+        case '"':
+          out << "\\\"";
+          break;
+
+        case '\\':
+          out << "\\\\";
+          break;
+
+        case '\n':
+          out << "\\n";
+          break;
+
+        case '\t':
+          out << "\\t";
+          break;
+
+        default:
+        {
+          if (static_cast<unsigned char>(c) < 0x20)
+          {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << int(c) << std::dec << std::setfill(' ');
+          }
+          else
+          {
+            out << c;
+          }
+          break;
+        }
+      }
+    }
+
+    out << '"';
+  }
+
+  void Stats::json(std::ostream& out) const
+  {
+    out << "{" << std::endl << "  \"version\": 1," << std::endl
+        << "  \"phases\": [";
+
+    for (size_t i = 0; i < phases.size(); i++)
+    {
+      auto& phase = phases[i];
+      out << (i ? "," : "") << std::endl << "    {\"name\": ";
+      json_string(out, phase.name);
+      out << ", \"module\": ";
+      json_string(out, phase.module);
+      out << ", \"ms\": " << std::fixed << std::setprecision(3)
+          << as_ms(phase.time)
+          << ", \"allocations\": " << phase.allocated.allocations
+          << ", \"bytes\": " << phase.allocated.bytes << "}";
+    }
+
+    out << std::endl << "  ]" << std::endl << "}" << std::endl;
+  }
+
+  std::ostream& operator<<(std::ostream& out, const Stats& stats)
+  {
+    Stats::Clock::duration total{};
+    ArenaUse allocated;
+
+    auto line = [&](
+                  const std::string& name,
+                  Stats::Clock::duration time,
+                  const ArenaUse& use,
+                  const std::string& module) {
+      out << std::left << std::setw(24) << name << std::right << std::setw(10)
+          << std::fixed << std::setprecision(1) << as_ms(time) << " ms"
+          << std::setw(10) << use.allocations << " nodes";
+
+      if (!module.empty())
+        out << "  " << module;
+
+      out << std::endl;
+    };
+
+    for (auto& phase : stats.phases)
+    {
+      // Modules are parsed concurrently, so only phases for the whole program
+      // add up to the total.
+      if (phase.module.empty())
+      {
+        total += phase.time;
+        allocated += phase.allocated;
+      }
+
+      line(phase.name, phase.time, phase.allocated, phase.module);
+    }
+
+    line("total", total, allocated, {});
+    return out;
+  }
+}
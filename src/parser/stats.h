@@ -0,0 +1,70 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "ast.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace verona::parser
+{
+  // The time taken by each phase of the front end, and the nodes allocated
+  // during it, in the order the phases ran. Phases that happen for each
+  // module, such as lexing, name the module. Phases for the whole program,
+  // such as each pass, don't. Passes that share a traversal are measured
+  // separately, and the time spent walking the AST is a `traversal` phase.
+  struct Stats
+  {
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase
+    {
+      std::string name;
+      std::string module;
+      Clock::duration time{};
+      ArenaUse allocated;
+    };
+
+    // Measures the time and allocations of the calling thread from when it
+    // is created.
+    struct Stopwatch
+    {
+      Clock::time_point start = Clock::now();
+      ArenaUse use = arena_use();
+
+      Clock::duration time() const
+      {
+        return Clock::now() - start;
+      }
+
+      ArenaUse allocated() const
+      {
+        return arena_use() - use;
+      }
+    };
+
+    std::vector<Phase> phases;
+
+    void add(
+      const std::string& name,
+      Clock::duration time,
+      ArenaUse allocated = {},
+      const std::string& module = {})
+    {
+      phases.push_back({name, module, time, allocated});
+    }
+
+    void add(const std::string& name, const Stopwatch& watch)
+    {
+      add(name, watch.time(), watch.allocated());
+    }
+
+    // Writes the phases as JSON, for comparing one build with another.
+    void json(std::ostream& out) const;
+  };
+
+  std::ostream& operator<<(std::ostream& out, const Stats& stats);
+}
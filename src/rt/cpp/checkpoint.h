@@ -0,0 +1,110 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "parallel.h"
+#include "when.h"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  /**
+   * Images of the regions held by some cowns, all taken at the same point in
+   * the order of behaviours, see `checkpoint`.
+   */
+  template<typename T>
+  struct Checkpoint
+  {
+    /// The cowns, in the order they were acquired, each appearing once.
+    std::vector<cown_ptr<T>> cowns;
+
+    /// The image of the region of each cown, see `Region::serialize`. An
+    /// image is empty if its region could not be serialized.
+    std::vector<std::vector<std::byte>> images;
+
+    /// How long the cowns were held while the images were taken.
+    std::chrono::nanoseconds pause{0};
+
+    /// Whether the region of every cown was serialized.
+    bool ok() const
+    {
+      for (const auto& image : images)
+      {
+        if (image.empty())
+          return false;
+      }
+      return true;
+    }
+
+    /**
+     * Load the image of the `i`th cown as a new arena region, and return its
+     * Iso object, or nullptr if the image is empty. The descriptors must be
+     * those the checkpoint was taken with.
+     */
+    Object* restore(
+      size_t i, const Descriptor* const* descriptors, size_t count) const
+    {
+      const auto& image = images[i];
+      if (image.empty())
+        return nullptr;
+      return Region::deserialize(
+        ThreadAlloc::get(), image.data(), image.size(), descriptors, count);
+    }
+  };
+
+  /**
+   * Takes a consistent checkpoint of the regions held by `cowns`, and passes
+   * it to `done`:
+   *
+   *   checkpoint(cowns, descriptors, count,
+   *     [](const Account& a) { return a.root; },
+   *     [](Checkpoint<Account> c) { ... });
+   *
+   * `region` returns the Iso object of the region held by a cown. The
+   * checkpoint is a single behaviour on all the cowns, so it sees the effect
+   * of every behaviour on them that ran before it and none of those that ran
+   * after, as any other behaviour would. Only these cowns are held, and only
+   * while their regions are copied, which is split over the scheduler threads
+   * with `parallel_for`. Behaviours on other cowns keep running. `done` runs
+   * in a behaviour of its own, once the cowns are released.
+   *
+   * The cowns are acquired for writing, as serializing a region marks its
+   * objects. The same requirements as for `Region::serialize` apply to the
+   * regions: the objects must be listed in `descriptors`, must have no
+   * finalisers, and the region must have no external references.
+   */
+  template<typename T, typename R, typename F>
+  void checkpoint(
+    const std::vector<cown_ptr<T>>& cowns,
+    const Descriptor* const* descriptors,
+    size_t count,
+    R region,
+    F done)
+  {
+    when_all(cowns) << [descriptors, count, region, done](
+                         acquired_cowns<T> cs) mutable {
+      auto start = std::chrono::steady_clock::now();
+
+      Checkpoint<T> c;
+      c.images.resize(cs.size());
+      parallel_for(0, cs.size(), [&](size_t i) {
+        c.images[i] = Region::serialize(
+          ThreadAlloc::get(), region(cs[i]), descriptors, count);
+      });
+      c.pause = std::chrono::steady_clock::now() - start;
+
+      for (size_t i = 0; i < cs.size(); i++)
+        c.cowns.push_back(cs.ref(i).to_ptr());
+
+      schedule_lambda([c = std::move(c), done = std::move(done)]() mutable {
+        done(std::move(c));
+      });
+    };
+  }
+}
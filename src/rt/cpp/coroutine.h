@@ -0,0 +1,101 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * Coroutine behaviours, for C++20 builds.
+ *
+ * A function returning `behaviour_coroutine` can `co_await` the result of a
+ * promise, or the cowns of a `when`, and is resumed by the behaviour that is
+ * scheduled once the promise is fulfilled, or the cowns are acquired:
+ *
+ *   behaviour_coroutine handle(cown_ptr<A> a, Promise<int>::PromiseR r)
+ *   {
+ *     auto v = co_await std::move(r);
+ *     acquired_cown<A> acq = co_await when(a);
+ *     acq->use(v);
+ *   }
+ *
+ * The state of the coroutine lives in its frame across each step, rather
+ * than being copied into a new closure for each behaviour in the chain.
+ * Acquired cowns are only valid until the next `co_await`, when the
+ * behaviour that resumed the coroutine completes and releases them.
+ *
+ * `USE_COROUTINES` is defined if the compiler supports coroutines.
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#  define USE_COROUTINES
+#  include <coroutine>
+#  include <cstdlib>
+#  include <utility>
+
+namespace verona::rt
+{
+  /**
+   * The return type of a coroutine behaviour. The coroutine starts running
+   * immediately when it is called, and its frame is destroyed once it
+   * completes. It cannot be awaited.
+   */
+  class behaviour_coroutine
+  {
+  public:
+    struct promise_type
+    {
+      behaviour_coroutine get_return_object() noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never initial_suspend() noexcept
+      {
+        return {};
+      }
+
+      std::suspend_never final_suspend() noexcept
+      {
+        return {};
+      }
+
+      void return_void() noexcept {}
+
+      void unhandled_exception() noexcept
+      {
+        abort();
+      }
+    };
+  };
+
+  /**
+   * The closure of a behaviour that resumes a suspended coroutine. If the
+   * behaviour is dropped rather than run, see `Behaviour::Descriptor::drop`,
+   * the coroutine is destroyed instead.
+   */
+  class ResumeCoroutine
+  {
+    std::coroutine_handle<> handle;
+
+  public:
+    explicit ResumeCoroutine(std::coroutine_handle<> handle) : handle(handle)
+    {}
+
+    ResumeCoroutine(ResumeCoroutine&& other) noexcept
+    : handle(std::exchange(other.handle, nullptr))
+    {}
+
+    ResumeCoroutine(const ResumeCoroutine&) = delete;
+    ResumeCoroutine& operator=(const ResumeCoroutine&) = delete;
+    ResumeCoroutine& operator=(ResumeCoroutine&&) = delete;
+
+    ~ResumeCoroutine()
+    {
+      if (handle)
+        handle.destroy();
+    }
+
+    void operator()()
+    {
+      std::exchange(handle, nullptr).resume();
+    }
+  };
+} // namespace verona::rt
+#endif
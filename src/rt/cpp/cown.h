@@ -5,6 +5,7 @@
 #include <functional>
 #include <tuple>
 #include <utility>
+#include <vector>
 #include <verona.h>
 
 namespace verona::cpp
@@ -56,8 +57,14 @@ namespace verona::cpp
     template<typename TT>
     friend class cown_ptr;
 
+    template<typename TT>
+    friend class acquired_cowns;
+
     template<typename TT, typename... Args>
     friend cown_ptr<TT> make_cown(Args&&... ts);
+
+    template<typename TT, typename F>
+    friend std::vector<cown_ptr<TT>> make_cowns(size_t, F&&);
   };
 
   /**
@@ -163,6 +170,12 @@ namespace verona::cpp
       clear();
     }
 
+    /// Returns false for a null, or moved from, cown_ptr.
+    explicit operator bool() const
+    {
+      return allocated_cown != nullptr;
+    }
+
     // Required as acquired_cown has to reach inside.
     // Note only requires friend when implicit typename is T
     // but C++ doesn't like this.
@@ -174,8 +187,26 @@ namespace verona::cpp
     template<typename TT, typename... Args>
     friend cown_ptr<TT> make_cown(Args&&...);
 
+    template<typename TT, typename... Args>
+    friend cown_ptr<TT> make_cown_on_core(size_t, Args&&...);
+
+    template<typename TT, typename F>
+    friend std::vector<cown_ptr<TT>> make_cowns(size_t, F&&);
+
     template<typename...>
     friend class When;
+
+    template<typename>
+    friend class WhenBatch;
+
+    template<typename>
+    friend class WhenAll;
+
+    template<typename>
+    friend class cown_ref;
+
+    template<typename>
+    friend class weak_cown_ptr;
   };
 
   /* A cown_ptr<const T> is used to mark that the cown is being accessed as
@@ -198,6 +229,154 @@ namespace verona::cpp
     return cown;
   }
 
+  /**
+   * Borrowed reference to a cown, which holds no reference count, so copying
+   * and dropping it costs nothing. It is only valid while something else
+   * keeps the cown alive: the `cown_ptr` it was borrowed from, or the
+   * behaviour that acquired the cown, see `acquired_cown::ref`.
+   *
+   * It can be passed to `when` directly, as the behaviour takes its own
+   * reference count, or turned back into a `cown_ptr` to be kept. As for
+   * `cown_ptr`, a `cown_ref<const T>` acquires the cown for reading.
+   *
+   *   cown_ref<T> r = ptr;
+   *   when (r) << closure;
+   */
+  template<typename T>
+  class cown_ref
+  {
+    ActualCown<std::remove_const_t<T>>* cown = nullptr;
+
+    template<typename>
+    friend class Access;
+
+    template<typename>
+    friend class acquired_cown;
+
+    template<typename>
+    friend class cown_ref;
+
+    template<typename>
+    friend class acquired_cowns;
+
+    cown_ref(ActualCown<std::remove_const_t<T>>* cown) : cown(cown) {}
+
+  public:
+    constexpr cown_ref() = default;
+
+    cown_ref(const cown_ptr<T>& ptr) : cown(ptr.allocated_cown) {}
+
+    /// A new `cown_ptr` sharing the cown, which takes a reference count.
+    cown_ptr<std::remove_const_t<T>> to_ptr() const
+    {
+      if (cown != nullptr)
+        verona::rt::Cown::acquire(cown);
+      return cown_ptr<std::remove_const_t<T>>(cown);
+    }
+
+    /// Borrow the same cown for reading.
+    cown_ref<const T> read() const
+    {
+      return cown_ref<const T>(cown);
+    }
+
+    bool operator==(const cown_ref& other) const
+    {
+      return cown == other.cown;
+    }
+
+    bool operator==(std::nullptr_t) const
+    {
+      return cown == nullptr;
+    }
+  };
+
+  /**
+   * Weak reference to a cown, which does not keep its state alive. Once the
+   * last `cown_ptr` to the cown is dropped, its state is destroyed, and
+   * `try_lock` fails, but the weak references keep the small stub of the
+   * cown allocated until they are dropped too.
+   *
+   * Upgrading is a single atomic increment when the cown is alive, see
+   * `Object::acquire_strong_from_weak`.
+   */
+  template<typename T>
+  class weak_cown_ptr
+  {
+    ActualCown<T>* allocated_cown{nullptr};
+
+  public:
+    constexpr weak_cown_ptr() = default;
+
+    weak_cown_ptr(const cown_ptr<T>& ptr) : allocated_cown(ptr.allocated_cown)
+    {
+      if (allocated_cown != nullptr)
+        allocated_cown->weak_acquire();
+    }
+
+    weak_cown_ptr(const weak_cown_ptr& other)
+    : allocated_cown(other.allocated_cown)
+    {
+      if (allocated_cown != nullptr)
+        allocated_cown->weak_acquire();
+    }
+
+    weak_cown_ptr(weak_cown_ptr&& other) : allocated_cown(other.allocated_cown)
+    {
+      other.allocated_cown = nullptr;
+    }
+
+    weak_cown_ptr& operator=(const weak_cown_ptr& other)
+    {
+      if (this != &other)
+      {
+        clear();
+        allocated_cown = other.allocated_cown;
+        if (allocated_cown != nullptr)
+          allocated_cown->weak_acquire();
+      }
+      return *this;
+    }
+
+    weak_cown_ptr& operator=(weak_cown_ptr&& other)
+    {
+      if (this != &other)
+      {
+        clear();
+        allocated_cown = other.allocated_cown;
+        other.allocated_cown = nullptr;
+      }
+      return *this;
+    }
+
+    ~weak_cown_ptr()
+    {
+      clear();
+    }
+
+    void clear()
+    {
+      if (allocated_cown != nullptr)
+      {
+        allocated_cown->weak_release(verona::rt::ThreadAlloc::get());
+        allocated_cown = nullptr;
+      }
+    }
+
+    /**
+     * A strong reference to the cown, or a null `cown_ptr` if the cown has
+     * been collected.
+     */
+    cown_ptr<T> try_lock() const
+    {
+      if (
+        (allocated_cown != nullptr) &&
+        allocated_cown->acquire_strong_from_weak())
+        return cown_ptr<T>(allocated_cown);
+      return {};
+    }
+  };
+
   /**
    * Used to construct a new cown_ptr.
    *
@@ -214,6 +393,54 @@ namespace verona::cpp
     return cown_ptr<T>(new ActualCown<T>(std::forward<Args>(ts)...));
   }
 
+  /**
+   * Make `n` cowns, the `i`th holding the value returned by `init(i)`.
+   *
+   * Called from a behaviour, the cowns are added to the list of the core in
+   * one step, see `Cown::Batch`, which is cheaper than `n` calls to
+   * `make_cown` when many cowns are made at once.
+   */
+  template<typename T, typename F>
+  std::vector<cown_ptr<T>> make_cowns(size_t n, F&& init)
+  {
+    static_assert(
+      !std::is_const_v<T>,
+      "Cannot make a cown of const type as this conflicts with read acquire "
+      "encoding trick. If we hit this assertion, raise an issue explaining the "
+      "use case.");
+    std::vector<cown_ptr<T>> cowns;
+    cowns.reserve(n);
+
+    Cown::Batch batch;
+    for (size_t i = 0; i < n; i++)
+      cowns.emplace_back(cown_ptr<T>(new ActualCown<T>(init(i))));
+    return cowns;
+  }
+
+  /// Make `n` cowns holding default constructed values, see above.
+  template<typename T>
+  std::vector<cown_ptr<T>> make_cowns(size_t n)
+  {
+    return make_cowns<T>(n, [](size_t) { return T(); });
+  }
+
+  /**
+   * As `make_cown`, for a cown mostly used by the scheduler thread of the
+   * core `core`, counted from the first core: the pages that lie entirely
+   * within the cown are moved to the NUMA node of that core. Only cowns of a
+   * page or more, such as ones holding large buffers, are moved.
+   */
+  template<typename T, typename... Args>
+  cown_ptr<T> make_cown_on_core(size_t core, Args&&... ts)
+  {
+    auto c = make_cown<T>(std::forward<Args>(ts)...);
+    numa::place(
+      c.allocated_cown,
+      sizeof(ActualCown<T>),
+      Scheduler::core_numa_node(core));
+    return c;
+  }
+
   /**
    * Represents a cown that has been acquired in a `when` clause.
    *
@@ -249,6 +476,15 @@ namespace verona::cpp
       return cown_ptr<T>(&origin_cown);
     }
 
+    /**
+     * Borrow the underlying cown for the rest of the behaviour, without
+     * touching its reference count, unlike `cown`.
+     */
+    cown_ref<std::remove_const_t<T>> ref() const
+    {
+      return cown_ref<std::remove_const_t<T>>(&origin_cown);
+    }
+
     T& get_ref() const
     {
       if constexpr (std::is_const<T>())
@@ -0,0 +1,540 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#if defined(__linux__)
+
+#  include "../pal/epoll.h"
+#  include "when.h"
+
+#  include <arpa/inet.h>
+#  include <cassert>
+#  include <cerrno>
+#  include <deque>
+#  include <fcntl.h>
+#  include <memory>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <system_error>
+#  include <unistd.h>
+
+/**
+ * Cowns for files and TCP sockets, whose operations complete as behaviours.
+ *
+ * Sockets are non-blocking, and an operation that cannot complete waits for
+ * readiness in the event poller that the scheduler threads poll, see
+ * `io::start`, so no thread blocks on it. The completion runs as a behaviour
+ * on the I/O cown, and can be passed on to the cown that asked for it with
+ * `io::deliver_to`. Data is passed in `io::Buffer`s, which are moved rather
+ * than copied from the operation to its completion.
+ *
+ * While an operation waits for readiness, the runtime counts it as an
+ * external event source, so the runtime does not terminate.
+ *
+ *   io::start();
+ *   ...
+ *   io::read(conn, 4096, io::deliver_to(session,
+ *     [](acquired_cown<Session>& s, io::Buffer buf, int err) { ... }));
+ */
+namespace verona::cpp::io
+{
+  /**
+   * An owned byte buffer.
+   */
+  class Buffer
+  {
+    std::unique_ptr<uint8_t[]> bytes;
+    size_t cap = 0;
+    size_t len = 0;
+
+  public:
+    Buffer() = default;
+
+    explicit Buffer(size_t capacity)
+    : bytes(new uint8_t[capacity]), cap(capacity)
+    {}
+
+    uint8_t* data()
+    {
+      return bytes.get();
+    }
+
+    const uint8_t* data() const
+    {
+      return bytes.get();
+    }
+
+    /// Number of valid bytes.
+    size_t size() const
+    {
+      return len;
+    }
+
+    size_t capacity() const
+    {
+      return cap;
+    }
+
+    void resize(size_t size)
+    {
+      assert(size <= cap);
+      len = size;
+    }
+  };
+
+  /**
+   * The poller that I/O cowns wait in.
+   */
+  inline pal::EpollPoller& poller()
+  {
+    static pal::EpollPoller p;
+    return p;
+  }
+
+  /**
+   * Have the scheduler threads poll for I/O. This must be called before
+   * operations on sockets are issued.
+   */
+  inline void start()
+  {
+    Scheduler::set_event_poller(&poller());
+  }
+
+  inline void stop()
+  {
+    Scheduler::set_event_poller(nullptr);
+  }
+
+  /**
+   * Wrap a completion so that it runs as a behaviour on `requester`, rather
+   * than on the I/O cown. The values passed to the completion are moved to
+   * the new behaviour.
+   */
+  template<typename R, typename F>
+  auto deliver_to(cown_ptr<R> requester, F f)
+  {
+    return [requester = std::move(requester), f = std::move(f)](
+             auto&, auto&&... results) mutable {
+      when(requester) << [f = std::move(f),
+                          values = std::make_tuple(std::move(results)...)](
+                           acquired_cown<R> r) mutable {
+        std::apply(
+          [&](auto&&... vs) { f(r, std::move(vs)...); }, std::move(values));
+      };
+    };
+  }
+
+  /**
+   * Base of the I/O cowns that wait for readiness.
+   *
+   * Operations are queued on the cown, and run in order. The operation at
+   * the front of the queue is attempted, and, if it would block, the file
+   * descriptor is armed for a single readiness event, which schedules a
+   * behaviour to attempt it again.
+   */
+  template<typename Self>
+  class Pollable
+  {
+    struct Op
+    {
+      uint32_t events;
+
+      Op(uint32_t events) : events(events) {}
+      virtual ~Op() = default;
+
+      /// Returns false if the operation would block.
+      virtual bool attempt(acquired_cown<Self>& self) = 0;
+    };
+
+    template<typename F>
+    struct OpImpl : Op
+    {
+      F f;
+
+      OpImpl(uint32_t events, F&& f) : Op(events), f(std::move(f)) {}
+
+      bool attempt(acquired_cown<Self>& self) override
+      {
+        return f(self);
+      }
+    };
+
+    pal::EpollPoller::Registration reg;
+    bool registered = false;
+    std::deque<std::unique_ptr<Op>> ops;
+    /// Keeps the cown alive while it is armed.
+    cown_ptr<Self> waiter;
+
+    static void on_ready(void* data, uint32_t)
+    {
+      auto p = static_cast<Pollable*>(data);
+      auto self = std::move(p->waiter);
+      when(self) << [](acquired_cown<Self> a) {
+        Scheduler::remove_external_event_source();
+        a->pump(a);
+      };
+    }
+
+    void pump(acquired_cown<Self>& self)
+    {
+      while (!ops.empty())
+      {
+        if (!ops.front()->attempt(self))
+        {
+          arm(self, ops.front()->events);
+          return;
+        }
+        ops.pop_front();
+      }
+    }
+
+    void arm(acquired_cown<Self>& self, uint32_t events)
+    {
+      waiter = self.cown();
+      Scheduler::add_external_event_source();
+
+      events |= EPOLLONESHOT;
+      bool ok = registered ? poller().modify(&reg, events) :
+                             poller().add(&reg, events);
+      registered = true;
+
+      // Only fails for descriptors that epoll cannot wait for, such as
+      // regular files, which are not `Pollable`.
+      if (!ok)
+        abort();
+    }
+
+  protected:
+    int fd;
+
+    explicit Pollable(int fd) : reg{fd, on_ready, this}, fd(fd) {}
+
+    ~Pollable()
+    {
+      if (registered)
+        poller().remove(&reg);
+      ::close(fd);
+    }
+
+    /**
+     * Queue an operation on `self`. `attempt` is called with the cown
+     * acquired, until it returns true, waiting for `events` when it returns
+     * false.
+     */
+    template<typename F>
+    static void submit(cown_ptr<Self>& self, uint32_t events, F attempt)
+    {
+      when(self) << [events, attempt = std::move(attempt)](
+                      acquired_cown<Self> a) mutable {
+        bool idle = a->ops.empty();
+        a->ops.push_back(
+          std::make_unique<OpImpl<F>>(events, std::move(attempt)));
+        if (idle)
+          a->pump(a);
+      };
+    }
+
+  public:
+    Pollable(const Pollable&) = delete;
+    Pollable& operator=(const Pollable&) = delete;
+
+    /**
+     * Shut the socket down. A waiting operation completes with an error or
+     * end of file.
+     */
+    static void close(cown_ptr<Self>& self)
+    {
+      when(self) << [](acquired_cown<Self> a) {
+        ::shutdown(a->fd, SHUT_RDWR);
+      };
+    }
+  };
+
+  inline int make_nonblocking(int fd)
+  {
+    if (
+      (fd < 0) || (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0))
+      throw std::system_error(errno, std::generic_category());
+    return fd;
+  }
+
+  class TcpConnection : public Pollable<TcpConnection>
+  {
+  public:
+    /// Takes ownership of the connected socket `fd`.
+    explicit TcpConnection(int fd) : Pollable(make_nonblocking(fd)) {}
+
+    /**
+     * Connect to `port` on the IPv4 address `addr`, given in host byte
+     * order. `f(conn, err)` runs once the connection is established or has
+     * failed.
+     */
+    template<typename F>
+    static cown_ptr<TcpConnection> connect(uint32_t addr, uint16_t port, F f)
+    {
+      int fd = make_nonblocking(::socket(AF_INET, SOCK_STREAM, 0));
+      sockaddr_in sa{};
+      sa.sin_family = AF_INET;
+      sa.sin_addr.s_addr = htonl(addr);
+      sa.sin_port = htons(port);
+
+      int err = 0;
+      if (::connect(fd, (sockaddr*)&sa, sizeof(sa)) != 0)
+        err = errno;
+
+      auto conn = make_cown<TcpConnection>(fd);
+      bool waiting = (err == EINPROGRESS);
+      submit(
+        conn,
+        EPOLLOUT,
+        [waiting, err, f = std::move(f)](
+          acquired_cown<TcpConnection>& c) mutable {
+          if (waiting)
+          {
+            // Wait for the socket to become writable before checking.
+            waiting = false;
+            return false;
+          }
+
+          if (err == EINPROGRESS)
+          {
+            socklen_t len = sizeof(err);
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+          }
+          f(c, err);
+          return true;
+        });
+      return conn;
+    }
+
+    /**
+     * Read up to `max` bytes. `f(conn, buffer, err)` runs with the bytes
+     * read, which are none at end of file.
+     */
+    template<typename F>
+    static void read(cown_ptr<TcpConnection>& conn, size_t max, F f)
+    {
+      submit(
+        conn,
+        EPOLLIN | EPOLLRDHUP,
+        [max, f = std::move(f)](acquired_cown<TcpConnection>& c) mutable {
+          Buffer buf(max);
+          ssize_t n = ::recv(c->fd, buf.data(), max, 0);
+          if (n < 0)
+          {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+              return false;
+            f(c, Buffer(), errno);
+            return true;
+          }
+          buf.resize((size_t)n);
+          f(c, std::move(buf), 0);
+          return true;
+        });
+    }
+
+    /**
+     * Write all of `buf`. `f(conn, buf, err)` runs with the buffer, so that it
+     * can be reused, once it has been written or the write has failed.
+     */
+    template<typename F>
+    static void write(cown_ptr<TcpConnection>& conn, Buffer buf, F f)
+    {
+      submit(
+        conn,
+        EPOLLOUT,
+        [buf = std::move(buf), offset = (size_t)0, f = std::move(f)](
+          acquired_cown<TcpConnection>& c) mutable {
+          while (offset < buf.size())
+          {
+            ssize_t n = ::send(
+              c->fd, buf.data() + offset, buf.size() - offset, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+              if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                return false;
+              f(c, std::move(buf), errno);
+              return true;
+            }
+            offset += (size_t)n;
+          }
+          f(c, std::move(buf), 0);
+          return true;
+        });
+    }
+  };
+
+  class TcpListener : public Pollable<TcpListener>
+  {
+  public:
+    /// Takes ownership of the listening socket `fd`.
+    explicit TcpListener(int fd) : Pollable(make_nonblocking(fd)) {}
+
+    /**
+     * Listen on `port` of the IPv4 address `addr`, given in host byte order.
+     * If `port` is 0, an ephemeral port is chosen, and returned through
+     * `bound_port`. Throws `std::system_error` on failure.
+     */
+    static cown_ptr<TcpListener> listen(
+      uint32_t addr,
+      uint16_t port,
+      uint16_t* bound_port = nullptr,
+      int backlog = SOMAXCONN)
+    {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (fd < 0)
+        throw std::system_error(errno, std::generic_category());
+
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      sockaddr_in sa{};
+      sa.sin_family = AF_INET;
+      sa.sin_addr.s_addr = htonl(addr);
+      sa.sin_port = htons(port);
+      socklen_t len = sizeof(sa);
+      if (
+        (::bind(fd, (sockaddr*)&sa, sizeof(sa)) != 0) ||
+        (::listen(fd, backlog) != 0) ||
+        (getsockname(fd, (sockaddr*)&sa, &len) != 0))
+      {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category());
+      }
+
+      if (bound_port != nullptr)
+        *bound_port = ntohs(sa.sin_port);
+      return make_cown<TcpListener>(fd);
+    }
+
+    /**
+     * Accept a connection. `f(listener, conn, err)` runs with the new
+     * connection, which is empty if `err` is not 0.
+     */
+    template<typename F>
+    static void accept(cown_ptr<TcpListener>& listener, F f)
+    {
+      submit(
+        listener,
+        EPOLLIN,
+        [f = std::move(f)](acquired_cown<TcpListener>& l) mutable {
+          int fd = ::accept4(l->fd, nullptr, nullptr, SOCK_NONBLOCK);
+          if (fd < 0)
+          {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+              return false;
+            f(l, cown_ptr<TcpConnection>(), errno);
+            return true;
+          }
+          f(l, make_cown<TcpConnection>(fd), 0);
+          return true;
+        });
+    }
+  };
+
+  /**
+   * A file. Regular files are always ready, so operations run directly in a
+   * behaviour on the file, at the given offset.
+   */
+  class File
+  {
+    int fd;
+
+  public:
+    /// Takes ownership of `fd`.
+    explicit File(int fd) : fd(fd) {}
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    ~File()
+    {
+      ::close(fd);
+    }
+
+    /**
+     * Open `path` with the `open` flags `flags`. Throws `std::system_error` on
+     * failure.
+     */
+    static cown_ptr<File> open(const char* path, int flags, mode_t mode = 0644)
+    {
+      int fd = ::open(path, flags | O_CLOEXEC, mode);
+      if (fd < 0)
+        throw std::system_error(errno, std::generic_category());
+      return make_cown<File>(fd);
+    }
+
+    /**
+     * Read up to `max` bytes at `offset`. `f(file, buffer, err)` runs with
+     * the bytes read.
+     */
+    template<typename F>
+    static void read_at(cown_ptr<File>& file, off_t offset, size_t max, F f)
+    {
+      when(file) << [offset, max, f = std::move(f)](
+                      acquired_cown<File> a) mutable {
+        Buffer buf(max);
+        ssize_t n = ::pread(a->fd, buf.data(), max, offset);
+        if (n < 0)
+        {
+          f(a, Buffer(), errno);
+          return;
+        }
+        buf.resize((size_t)n);
+        f(a, std::move(buf), 0);
+      };
+    }
+
+    /**
+     * Write all of `buf` at `offset`. `f(file, buf, err)` runs with the
+     * buffer once it has been written.
+     */
+    template<typename F>
+    static void write_at(cown_ptr<File>& file, off_t offset, Buffer buf, F f)
+    {
+      when(file) << [offset, buf = std::move(buf), f = std::move(f)](
+                      acquired_cown<File> a) mutable {
+        size_t done = 0;
+        while (done < buf.size())
+        {
+          ssize_t n = ::pwrite(
+            a->fd, buf.data() + done, buf.size() - done, offset + done);
+          if (n < 0)
+          {
+            f(a, std::move(buf), errno);
+            return;
+          }
+          done += (size_t)n;
+        }
+        f(a, std::move(buf), 0);
+      };
+    }
+  };
+
+  template<typename F>
+  cown_ptr<TcpConnection> connect(uint32_t addr, uint16_t port, F f)
+  {
+    return TcpConnection::connect(addr, port, std::move(f));
+  }
+
+  template<typename F>
+  void read(cown_ptr<TcpConnection>& conn, size_t max, F f)
+  {
+    TcpConnection::read(conn, max, std::move(f));
+  }
+
+  template<typename F>
+  void write(cown_ptr<TcpConnection>& conn, Buffer buf, F f)
+  {
+    TcpConnection::write(conn, std::move(buf), std::move(f));
+  }
+
+  template<typename F>
+  void accept(cown_ptr<TcpListener>& listener, F f)
+  {
+    TcpListener::accept(listener, std::move(f));
+  }
+} // namespace verona::cpp::io
+
+#endif
@@ -5,6 +5,8 @@
 #include "vbehaviour.h"
 #include "vobject.h"
 
+#include <chrono>
+
 namespace verona::rt
 {
   class EmptyCown : public VCown<EmptyCown>
@@ -33,10 +35,30 @@ namespace verona::rt
       }
     }
 
+    static bool expired(const Behaviour* msg)
+    {
+      if constexpr (has_expired<T>::value)
+        return static_cast<const LambdaBehaviour<T>*>(msg)->fn.expired();
+      else
+      {
+        UNUSED(msg);
+        return false;
+      }
+    }
+
+    static void drop(Behaviour* msg)
+    {
+      static_cast<LambdaBehaviour<T>*>(msg)->~LambdaBehaviour<T>();
+    }
+
     static const Behaviour::Descriptor* desc()
     {
       static constexpr Behaviour::Descriptor desc = {
-        sizeof(LambdaBehaviour<T>), f, NULL};
+        sizeof(LambdaBehaviour<T>),
+        f,
+        NULL,
+        has_expired<T>::value ? expired : nullptr,
+        std::is_trivially_destructible_v<LambdaBehaviour<T>> ? nullptr : drop};
 
       return &desc;
     }
@@ -54,33 +76,246 @@ namespace verona::rt
     void operator delete[](void* p, size_t sz) = delete;
 
   public:
-    LambdaBehaviour(T fn_) : Behaviour(desc()), fn(std::move(fn_)) {}
+    LambdaBehaviour(const T& fn_) : Behaviour(desc()), fn(fn_) {}
+
+    LambdaBehaviour(T&& fn_) : Behaviour(desc()), fn(std::move(fn_)) {}
+
+    /// The closure, which may be changed until the behaviour is sent, see
+    /// `prepare_lambda_requests`.
+    T& closure()
+    {
+      return fn;
+    }
   };
 
+  /**
+   * The closures passed to `schedule_lambda` are stored in the message body,
+   * whatever their size or alignment, see `MultiMessage::Body::make`. An
+   * rvalue closure is moved into the body once and never copied, so it can
+   * capture move-only state, and an lvalue closure is copied once.
+   */
   template<TransferOwnership transfer = NoTransfer, typename T>
-  static void schedule_lambda(Cown* c, T f)
+  static void schedule_lambda(Cown* c, T&& f)
   {
-    Cown::schedule<LambdaBehaviour<T>, transfer>(c, std::forward<T>(f));
+    Cown::schedule<LambdaBehaviour<std::decay_t<T>>, transfer>(
+      c, std::forward<T>(f));
   }
 
   template<TransferOwnership transfer = NoTransfer, typename T>
-  static void schedule_lambda(size_t count, Cown** cowns, T f)
+  static void schedule_lambda(size_t count, Cown** cowns, T&& f)
   {
-    Cown::schedule<LambdaBehaviour<T>, transfer>(
+    Cown::schedule<LambdaBehaviour<std::decay_t<T>>, transfer>(
       count, cowns, std::forward<T>(f));
   }
 
   template<TransferOwnership transfer = NoTransfer, typename T>
-  static void schedule_lambda(size_t count, Request* requests, T f)
+  static void schedule_lambda(size_t count, Request* requests, T&& f)
   {
-    Cown::schedule<LambdaBehaviour<T>, transfer>(
+    Cown::schedule<LambdaBehaviour<std::decay_t<T>>, transfer>(
       count, requests, std::forward<T>(f));
   }
 
+  /**
+   * Schedules `f` on the `count` requests written by `fill` into the message
+   * body, see `Cown::schedule_requests`.
+   */
+  template<TransferOwnership transfer = NoTransfer, typename Fill, typename T>
+  static void schedule_lambda_requests(size_t count, Fill&& fill, T&& f)
+  {
+    Cown::schedule_requests<LambdaBehaviour<std::decay_t<T>>, transfer>(
+      count, std::forward<Fill>(fill), std::forward<T>(f));
+  }
+
+  /**
+   * Builds, but does not send, a behaviour running `f` on the `count`
+   * requests written by `fill`, see `Cown::prepare_requests`. Sets `held` to
+   * the closure in the message body.
+   */
+  template<typename Fill, typename T>
+  static MultiMessage::Body* prepare_lambda_requests(
+    size_t count, Fill&& fill, T&& f, std::decay_t<T>*& held)
+  {
+    using Be = LambdaBehaviour<std::decay_t<T>>;
+    auto body = Cown::prepare_requests<Be>(
+      count, std::forward<Fill>(fill), std::forward<T>(f));
+    held = &static_cast<Be&>(body->get_behaviour()).closure();
+    return body;
+  }
+
+  /**
+   * Schedules the closure returned by `make(i)` on `cowns[i]`, for each of
+   * the `count` cowns. See `Cown::schedule_many`.
+   */
+  template<TransferOwnership transfer = NoTransfer, typename Make>
+  static void schedule_lambda_many(size_t count, Cown** cowns, Make make)
+  {
+    using T = decltype(make(size_t(0)));
+    Cown::schedule_many<LambdaBehaviour<T>, transfer>(count, cowns, make);
+  }
+
   template<typename T>
-  static void schedule_lambda(T f)
+  static void schedule_lambda(T&& f)
   {
     Cown* c = new EmptyCown();
-    Cown::schedule<LambdaBehaviour<T>, YesTransfer>(c, std::forward<T>(f));
+    Cown::schedule<LambdaBehaviour<std::decay_t<T>>, YesTransfer>(
+      c, std::forward<T>(f));
+  }
+
+  /**
+   * Release the region represented by Iso object `o`, and the regions it
+   * owns, in the background.
+   *
+   * Releasing a large tree of regions inside a behaviour stalls its cowns
+   * until it is done. Instead, each region of the tree is released by a
+   * behaviour of its own, so the work is spread over the scheduler threads and
+   * interleaved with other behaviours.
+   */
+  inline void region_release_later(Object* o)
+  {
+    assert(o->debug_is_iso());
+    schedule_lambda([o]() {
+      auto& alloc = ThreadAlloc::get();
+      ObjectStack sub_regions(alloc);
+      Region::release_shallow(alloc, o, sub_regions);
+
+      while (!sub_regions.empty())
+        region_release_later(sub_regions.pop());
+    });
+  }
+
+  /**
+   * A timer that calls a closure when it fires.
+   */
+  template<class F>
+  class LambdaTimer : public Timer
+  {
+    F fn;
+
+    static void fire_fn(Timer* t)
+    {
+      auto self = static_cast<LambdaTimer*>(t);
+      self->fn();
+      self->~LambdaTimer();
+      ThreadAlloc::get().dealloc(self);
+    }
+
+  public:
+    template<typename G>
+    LambdaTimer(uint64_t due_, G&& fn_) : fn(std::forward<G>(fn_))
+    {
+      due = due_;
+      fire = fire_fn;
+    }
+  };
+
+  /**
+   * A task that calls a closure, see `schedule_task`.
+   */
+  template<class F>
+  class LambdaTask : public Task
+  {
+    F fn;
+
+    static void run_fn(Task* t)
+    {
+      auto self = static_cast<LambdaTask*>(t);
+      self->fn();
+      self->~LambdaTask();
+      ThreadAlloc::get().dealloc(self);
+    }
+
+  public:
+    template<typename G>
+    LambdaTask(G&& fn_) : fn(std::forward<G>(fn_))
+    {
+      run = run_fn;
+    }
+  };
+
+  /**
+   * Run `f` on some scheduler thread, with no cown.
+   *
+   * This is for parallel work that needs no state protected by a cown, such
+   * as fanning out the hashing of many buffers. The task is added to the
+   * task ring of this core, where it costs a single allocation, and is run
+   * between cowns or stolen by an idle scheduler thread. It is not seen by
+   * the leak detector, so `f` must not capture the only reference to a cown
+   * or region. Outside a scheduler thread, or once the ring is full, `f` is
+   * scheduled as a behaviour with `schedule_lambda` instead.
+   */
+  template<typename T>
+  static void schedule_task(T&& f)
+  {
+    using Task = LambdaTask<std::decay_t<T>>;
+    void* p = ThreadAlloc::get().alloc(sizeof(Task));
+    auto t = new (p) Task(std::forward<T>(f));
+
+    if (!Scheduler::add_task(t))
+      schedule_lambda([t]() { t->run(t); });
+  }
+
+  /**
+   * Call `f` on a scheduler thread once `delay` has passed. The timer is
+   * kept by the scheduler thread that calls this, or by some scheduler
+   * thread if this is called from outside the runtime. `f` runs between
+   * behaviours, so it should only schedule work.
+   */
+  template<typename T>
+  static void call_after(std::chrono::milliseconds delay, T&& f)
+  {
+    using Timer = LambdaTimer<std::decay_t<T>>;
+    uint64_t due = Scheduler::timer_tick() + (uint64_t)delay.count();
+    void* p = ThreadAlloc::get().alloc(sizeof(Timer));
+    auto t = new (p) Timer(due, std::forward<T>(f));
+
+    if (Scheduler::local() != nullptr)
+      Scheduler::add_timer(t);
+    else
+      schedule_lambda([t]() { Scheduler::add_timer(t); });
+  }
+
+  /**
+   * Schedule `f` once `delay` has passed.
+   */
+  template<typename T>
+  static void schedule_lambda_after(std::chrono::milliseconds delay, T&& f)
+  {
+    call_after(delay, [f = std::forward<T>(f)]() mutable {
+      schedule_lambda(std::move(f));
+    });
+  }
+
+  /**
+   * Schedule `f` on `c` once `delay` has passed. The timer holds a reference
+   * to `c` until then.
+   */
+  template<typename T>
+  static void
+  schedule_lambda_after(std::chrono::milliseconds delay, Cown* c, T&& f)
+  {
+    Cown::acquire(c);
+    call_after(delay, [c, f = std::forward<T>(f)]() mutable {
+      schedule_lambda<YesTransfer>(c, std::move(f));
+    });
+  }
+
+  /**
+   * Collect a trace region owned by the cown `c` incrementally, by scheduling
+   * one `RegionTrace::gc_step` of at most `budget` objects at a time on `c`.
+   * Each step is queued behind the behaviours already waiting for `c`, so
+   * they run between the steps. `region_of` is called on `c` before each
+   * step, and returns the Iso object of the region, or nullptr to stop
+   * collecting.
+   */
+  template<typename F>
+  static void schedule_region_gc(
+    Cown* c, F region_of, size_t budget = RegionTrace::GC_STEP_BUDGET)
+  {
+    schedule_lambda(c, [c, region_of, budget]() {
+      Object* o = region_of();
+      if (
+        (o != nullptr) && !RegionTrace::gc_step(ThreadAlloc::get(), o, budget))
+        schedule_region_gc(c, region_of, budget);
+    });
   }
 } // namespace verona::rt
@@ -0,0 +1,184 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <verona.h>
+
+namespace verona::cpp
+{
+  using namespace verona::rt;
+
+  namespace detail
+  {
+    /**
+     * The state shared by the caller of `parallel_for` and its helpers.
+     *
+     * The range is split into chunks, which are claimed from `next` by
+     * whoever gets there first. `running` counts the threads that may still
+     * be running a chunk, so the caller can wait for them.
+     */
+    template<typename F>
+    struct ParallelFor
+    {
+      F* f;
+      size_t begin;
+      size_t end;
+      size_t grain;
+      size_t chunks;
+
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> running{0};
+
+      ParallelFor(F* f, size_t begin, size_t end, size_t grain)
+      : f(f),
+        begin(begin),
+        end(end),
+        grain(grain),
+        chunks((end - begin + grain - 1) / grain)
+      {}
+
+      /**
+       * Claim and run chunks until there are none left. `f` is only used
+       * once a chunk has been claimed, so a helper that starts after the
+       * caller has returned does not touch it.
+       */
+      void work()
+      {
+        running++;
+        for (size_t c = next++; c < chunks; c = next++)
+        {
+          size_t from = begin + (c * grain);
+          size_t to = std::min(from + grain, end);
+          for (size_t i = from; i < to; i++)
+            (*f)(i);
+        }
+        running--;
+      }
+
+      bool done()
+      {
+        return running == 0;
+      }
+    };
+  }
+
+  /**
+   * Calls `f(i)` for each `i` in [begin, end), in parallel on the scheduler
+   * threads, and returns once all the calls have completed.
+   *
+   * This is intended to be called from a behaviour, to split up work on the
+   * state of the cowns it has acquired, which it keeps while the calls run.
+   * The range is split into chunks of `grain` indices. Helper behaviours are
+   * scheduled on the queue of this core, `Core::q`, where idle scheduler
+   * threads steal them. The caller and the helpers then claim chunks until
+   * there are none left, so the load is balanced. The caller only waits for
+   * helpers that are still running a chunk, never for one that has not
+   * started, so this completes even if no other thread is free.
+   *
+   * `f` may run on several threads at once, and must only access the state
+   * of the calling behaviour in ways that do not conflict across indices.
+   */
+  template<typename F>
+  void parallel_for(size_t begin, size_t end, size_t grain, F&& f)
+  {
+    if (begin >= end)
+      return;
+
+    grain = std::max<size_t>(grain, 1);
+    auto state =
+      std::make_shared<detail::ParallelFor<std::remove_reference_t<F>>>(
+        &f, begin, end, grain);
+
+    // One helper for each other scheduler thread that could take a chunk.
+    size_t threads = Scheduler::get_thread_count();
+    size_t helpers = std::min(state->chunks, std::max<size_t>(threads, 1)) - 1;
+    for (size_t h = 0; h < helpers; h++)
+      schedule_lambda([state]() { state->work(); });
+
+    state->work();
+
+#ifdef USE_SYSTEMATIC_TESTING
+    Systematic::yield_until([&state]() { return state->done(); });
+#else
+    while (!state->done())
+      snmalloc::Aal::pause();
+#endif
+  }
+
+  /**
+   * As `parallel_for` above, with a grain that splits the range into a few
+   * chunks for each scheduler thread.
+   */
+  template<typename F>
+  void parallel_for(size_t begin, size_t end, F&& f)
+  {
+    static constexpr size_t chunks_per_thread = 4;
+
+    if (begin >= end)
+      return;
+
+    size_t threads = std::max<size_t>(Scheduler::get_thread_count(), 1);
+    size_t chunks = threads * chunks_per_thread;
+    size_t grain = (end - begin + chunks - 1) / chunks;
+    parallel_for(begin, end, grain, std::forward<F>(f));
+  }
+
+  /**
+   * Collects the trace region represented by the Iso object `o` with
+   * `RegionTrace::gc`'s semantics, marking and sweeping in parallel on the
+   * scheduler threads, see `ParallelGC`.
+   *
+   * This is intended for large regions, from a behaviour that owns the
+   * region and blocks while the collection runs. The mark is split between
+   * one worker per scheduler thread, which balance the load by stealing
+   * packets of work from each other, and the sweep between segments of the
+   * rings.
+   */
+  inline void parallel_gc(Object* o)
+  {
+    auto& alloc = ThreadAlloc::get();
+    ParallelGC gc(alloc, o);
+
+    size_t threads = std::max<size_t>(Scheduler::get_thread_count(), 1);
+    parallel_for(
+      0, threads, 1, [&gc](size_t) { gc.mark(ThreadAlloc::get()); });
+
+    gc.sweep_rings(alloc);
+    parallel_for(0, gc.segments(), 1, [&gc](size_t i) {
+      gc.finalise(ThreadAlloc::get(), i);
+    });
+    parallel_for(0, gc.segments(), 1, [&gc](size_t i) {
+      gc.dealloc(ThreadAlloc::get(), i);
+    });
+    gc.finish(alloc);
+  }
+
+  /**
+   * Freezes the region represented by the Iso object `o`, and its
+   * subregions, as `freeze` does, sweeping each region in parallel on the
+   * scheduler threads, see `ParallelFreeze`.
+   *
+   * This is intended for freezing large regions from a behaviour, which
+   * blocks until the whole graph is immutable. The SCCs are still computed
+   * on the calling thread.
+   */
+  inline void parallel_freeze(Object* o)
+  {
+    auto& alloc = ThreadAlloc::get();
+    ParallelFreeze freeze(alloc, o);
+
+    while (freeze.next_region(alloc))
+    {
+      parallel_for(0, freeze.segments(), 1, [&freeze](size_t i) {
+        freeze.sweep(ThreadAlloc::get(), i);
+      });
+      parallel_for(0, freeze.segments(), 1, [&freeze](size_t i) {
+        freeze.dealloc(ThreadAlloc::get(), i);
+      });
+      freeze.finish_region(alloc);
+    }
+  }
+} // namespace verona::cpp
@@ -2,10 +2,21 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "coroutine.h"
+
+#include <atomic>
+#include <new>
+#include <utility>
 #include <variant>
+#ifdef USE_COROUTINES
+#  include <optional>
+#endif
 
 namespace verona::rt
 {
+  template<typename T>
+  class OneShotPromise;
+
   /*
    * This class defines a Promise object on top of the verona runtime.
    * A promise is a cown whose lifetime is controlled by the read and write
@@ -29,6 +40,7 @@ namespace verona::rt
     class PromiseErr
     {
       friend class Promise;
+      friend class OneShotPromise<T>;
 
       int err_code;
       PromiseErr(int code) : err_code(code) {}
@@ -95,6 +107,43 @@ namespace verona::rt
         return *this;
       }
 
+#ifdef USE_COROUTINES
+      /**
+       * Suspends the calling coroutine until the promise is fulfilled, and
+       * resumes it from the behaviour scheduled by `then`, with the value of
+       * the promise or an error. See `cpp/coroutine.h`.
+       */
+      auto operator co_await() &&
+      {
+        struct Awaiter
+        {
+          PromiseR r;
+          std::optional<std::variant<T, PromiseErr>> result;
+
+          bool await_ready() noexcept
+          {
+            return false;
+          }
+
+          void await_suspend(std::coroutine_handle<> h)
+          {
+            r.then([this, resume = ResumeCoroutine(h)](
+                     std::variant<T, PromiseErr> v) mutable {
+              result.emplace(std::move(v));
+              resume();
+            });
+          }
+
+          std::variant<T, PromiseErr> await_resume()
+          {
+            return std::move(*result);
+          }
+        };
+
+        return Awaiter{std::move(*this), std::nullopt};
+      }
+#endif
+
       template<TransferOwnership transfer = NoTransfer>
       Promise* get_promise()
       {
@@ -177,7 +226,7 @@ namespace verona::rt
         std::enable_if_t<std::is_invocable_v<F, std::variant<T, PromiseErr>>>>
     void then(F&& fn)
     {
-      schedule_lambda(this, [fn = std::move(fn), this] {
+      schedule_lambda(this, [fn = std::move(fn), this]() mutable {
         if (fulfilled)
         {
           if constexpr (std::is_trivially_copy_constructible<T>::value)
@@ -234,4 +283,248 @@ namespace verona::rt
       tmp.promise->schedule();
     }
   };
+
+  /**
+   * A promise with a single reader, for the common case of a reply that is
+   * awaited by exactly one continuation.
+   *
+   * A `OneShotPromise` is not a cown. The reader and the writer share a small
+   * state, which holds the continuation passed to `then` inline, and the
+   * value passed to `fulfill`. Whichever of the two ends completes second
+   * runs the continuation directly, on its own thread, so fulfilling the
+   * promise does not schedule a behaviour. The continuation must therefore
+   * not block, and should schedule any longer work with `when`s. As with
+   * `Promise`, the continuation gets a `PromiseErr` if the writer is dropped
+   * without fulfilling the promise.
+   *
+   * `then` and `share` consume the reader. Use `share` to get a `Promise`
+   * reader, with the cown semantics of `Promise`, when there is more than
+   * one waiter.
+   */
+  template<typename T>
+  class OneShotPromise
+  {
+  public:
+    using PromiseErr = typename Promise<T>::PromiseErr;
+
+  private:
+    /**
+     * The bits of `State::status`. The reader and the writer each set their
+     * bit once, with the bit for what they provided, if anything.
+     */
+    static constexpr uint8_t READER = 1 << 0;
+    static constexpr uint8_t CONTINUATION = 1 << 1;
+    static constexpr uint8_t WRITER = 1 << 2;
+    static constexpr uint8_t VALUE = 1 << 3;
+
+    /**
+     * Continuations that fit in this many bytes are stored in the state,
+     * larger ones are boxed.
+     */
+    static constexpr size_t inline_size = 4 * sizeof(void*);
+
+    struct State
+    {
+      std::atomic<uint8_t> status{0};
+
+      /// Runs and destroys the continuation.
+      void (*run)(State*, bool) = nullptr;
+
+      alignas(std::max_align_t) unsigned char continuation[inline_size];
+      alignas(T) unsigned char value[sizeof(T)];
+
+      T& get_value()
+      {
+        return *std::launder(reinterpret_cast<T*>(value));
+      }
+    };
+
+    template<typename F>
+    static constexpr bool fits_inline =
+      (sizeof(F) <= inline_size) && (alignof(F) <= alignof(std::max_align_t));
+
+    template<typename F>
+    static F& get_continuation(State* s)
+    {
+      if constexpr (fits_inline<F>)
+        return *std::launder(reinterpret_cast<F*>(s->continuation));
+      else
+        return **std::launder(reinterpret_cast<F**>(s->continuation));
+    }
+
+    template<typename F>
+    static void run_continuation(State* s, bool has_value)
+    {
+      F& f = get_continuation<F>(s);
+
+      if (has_value)
+        f(std::variant<T, PromiseErr>(
+          std::in_place_index<0>, std::move(s->get_value())));
+      else
+        f(std::variant<T, PromiseErr>(PromiseErr(-1)));
+
+      f.~F();
+      if constexpr (!fits_inline<F>)
+        ThreadAlloc::get().template dealloc<sizeof(F)>(&f);
+    }
+
+    /**
+     * Sets the bits of one end, and completes the promise if the other end
+     * has already set its bits.
+     */
+    static void signal(State* s, uint8_t bits, uint8_t other)
+    {
+      uint8_t status = s->status.fetch_or(bits, std::memory_order_acq_rel);
+      if ((status & other) == 0)
+        return;
+
+      status |= bits;
+      if (status & CONTINUATION)
+        s->run(s, status & VALUE);
+      if (status & VALUE)
+        s->get_value().~T();
+
+      s->~State();
+      ThreadAlloc::get().template dealloc<sizeof(State)>(s);
+    }
+
+  public:
+    /**
+     * The read end-point of the promise. It is move-only, as there is a
+     * single waiter.
+     */
+    class Reader
+    {
+      friend class OneShotPromise;
+
+      State* state;
+
+      Reader(State* s) : state(s) {}
+
+    public:
+      Reader() : state(nullptr) {}
+
+      Reader(Reader&& old) : state(std::exchange(old.state, nullptr)) {}
+
+      Reader& operator=(Reader&& old)
+      {
+        if (state)
+          signal(state, READER, WRITER);
+        state = std::exchange(old.state, nullptr);
+        return *this;
+      }
+
+      Reader(const Reader&) = delete;
+      Reader& operator=(const Reader&) = delete;
+
+      ~Reader()
+      {
+        if (state)
+          signal(state, READER, WRITER);
+      }
+
+      /**
+       * Sets the continuation of the promise. It runs here if the promise
+       * has already been fulfilled, and otherwise when it is fulfilled.
+       */
+      template<
+        typename F,
+        typename =
+          std::enable_if_t<std::is_invocable_v<F, std::variant<T, PromiseErr>>>>
+      void then(F&& fn) &&
+      {
+        using C = std::decay_t<F>;
+        assert(state != nullptr);
+
+        State* s = std::exchange(state, nullptr);
+        if constexpr (fits_inline<C>)
+        {
+          new (s->continuation) C(std::forward<F>(fn));
+        }
+        else
+        {
+          C* boxed =
+            new (ThreadAlloc::get().template alloc<sizeof(C)>())
+              C(std::forward<F>(fn));
+          new (s->continuation) C*(boxed);
+        }
+        s->run = &run_continuation<C>;
+
+        signal(s, READER | CONTINUATION, WRITER);
+      }
+
+      /**
+       * Converts this into the reader of a `Promise`, which can be copied to
+       * have several waiters. The `Promise` is fulfilled when this one is.
+       */
+      typename Promise<T>::PromiseR share() &&
+      {
+        auto pp = Promise<T>::create_promise();
+        std::move(*this).then(
+          [wp = std::move(pp.second)](std::variant<T, PromiseErr> v) mutable {
+            // Dropping the writer fails the shared promise.
+            if (std::holds_alternative<T>(v))
+              Promise<T>::fulfill(std::move(wp), std::get<T>(std::move(v)));
+          });
+        return std::move(pp.first);
+      }
+    };
+
+    /**
+     * The write end-point of the promise. A promise can be fulfilled only
+     * once.
+     */
+    class Writer
+    {
+      friend class OneShotPromise;
+
+      State* state;
+
+      Writer(State* s) : state(s) {}
+
+    public:
+      Writer() : state(nullptr) {}
+
+      Writer(Writer&& old) : state(std::exchange(old.state, nullptr)) {}
+
+      Writer& operator=(Writer&& old)
+      {
+        if (state)
+          signal(state, WRITER, READER);
+        state = std::exchange(old.state, nullptr);
+        return *this;
+      }
+
+      Writer(const Writer&) = delete;
+      Writer& operator=(const Writer&) = delete;
+
+      ~Writer()
+      {
+        if (state)
+          signal(state, WRITER, READER);
+      }
+    };
+
+    /**
+     * Create a promise and get its read and write end-points.
+     */
+    static std::pair<Reader, Writer> create_promise()
+    {
+      State* s = new (ThreadAlloc::get().template alloc<sizeof(State)>()) State;
+      return std::make_pair(Reader(s), Writer(s));
+    }
+
+    /**
+     * Fulfill the promise with a value. If the continuation has been set,
+     * it runs here before this returns.
+     */
+    static void fulfill(Writer&& wp, T&& v)
+    {
+      State* s = std::exchange(wp.state, nullptr);
+      assert(s != nullptr);
+
+      new (s->value) T(std::move(v));
+      signal(s, WRITER | VALUE, READER);
+    }
+  };
 }
@@ -0,0 +1,503 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#if defined(__linux__)
+
+#  include "io.h"
+
+#  include <any>
+#  include <cstring>
+#  include <functional>
+#  include <memory>
+#  include <type_traits>
+#  include <unordered_map>
+#  include <vector>
+
+/**
+ * Behaviours on cowns of another process, sent over a stream socket.
+ *
+ * Each process has a `remote::Host`, on which it exports the cowns that
+ * other processes may use, under ids of its choosing, and registers the
+ * handlers that they may run on them. A C++ closure cannot be sent to
+ * another process, so a remote behaviour names a handler, and carries the
+ * values it is called with, which are copied byte for byte:
+ *
+ *   // In the process that owns the accounts.
+ *   host->export_cown(1, alice);
+ *   host->export_cown(2, bob);
+ *   host->handle<Account, Account>(TRANSFER,
+ *     [](remote::Reader& r, acquired_cown<Account>& from,
+ *        acquired_cown<Account>& to) { ... r.get<int>() ... });
+ *   host->connect(fd);
+ *
+ *   // In another process.
+ *   auto link = host->connect(fd);
+ *   auto alice = remote::import<Account>(link, 1);
+ *   auto bob = remote::import<Account>(link, 2);
+ *   remote::when(alice, bob).call(TRANSFER, 100);
+ *
+ * Processes are connected by a `remote::Link` over any connected stream
+ * socket, such as a Unix domain socket pair for processes on the same host,
+ * or a TCP connection. Frames are in the byte order of the host, so both
+ * ends must share it.
+ *
+ * The behaviours sent over a link are run in the order they were sent, so
+ * two behaviours on the same remote cowns are ordered as they would be
+ * locally. The cowns of one behaviour are acquired together on the process
+ * that owns them, in the same way as local cowns. The cowns of a behaviour
+ * must therefore all be reached through the same link; acquiring cowns of
+ * several processes at once is not supported.
+ *
+ * Behaviours are appended to the send buffer of their link, and the buffer
+ * is written once the behaviours queued on the link have been appended, so
+ * behaviours sent together are batched into one write.
+ *
+ * While a link is open, it waits for data from its peer, so the runtime
+ * does not terminate. Closing a link, or reaching the end of its stream,
+ * closes the sending side, which in turn closes the link at its peer.
+ */
+namespace verona::cpp::remote
+{
+  class Host;
+
+  /**
+   * Appends values to a frame. Values are copied byte for byte, so they must
+   * be trivially copyable.
+   */
+  class Writer
+  {
+    std::vector<uint8_t>& bytes;
+
+  public:
+    explicit Writer(std::vector<uint8_t>& bytes) : bytes(bytes) {}
+
+    void put_bytes(const void* data, size_t size)
+    {
+      auto p = static_cast<const uint8_t*>(data);
+      bytes.insert(bytes.end(), p, p + size);
+    }
+
+    template<typename T>
+    void put(const T& value)
+    {
+      static_assert(
+        std::is_trivially_copyable_v<T>,
+        "Values sent to a remote cown are copied byte for byte");
+      put_bytes(&value, sizeof(T));
+    }
+  };
+
+  /**
+   * Reads the values of a behaviour, in the order they were written.
+   *
+   * The values come from another process, so a read past the end of them is
+   * not trusted to be a bug of this one: it reads zeroes, and the reader is
+   * no longer `ok`.
+   */
+  class Reader
+  {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool failed = false;
+
+  public:
+    Reader(const uint8_t* p, size_t size) : p(p), end(p + size) {}
+
+    size_t remaining() const
+    {
+      return (size_t)(end - p);
+    }
+
+    /// Whether every read so far was within the values.
+    bool ok() const
+    {
+      return !failed;
+    }
+
+    /// Returns false, and zeroes `data`, if fewer than `size` bytes remain.
+    bool get_bytes(void* data, size_t size)
+    {
+      if (size > remaining())
+      {
+        failed = true;
+        p = end;
+        memset(data, 0, size);
+        return false;
+      }
+      memcpy(data, p, size);
+      p += size;
+      return true;
+    }
+
+    template<typename T>
+    T get()
+    {
+      static_assert(
+        std::is_trivially_copyable_v<T>,
+        "Values sent to a remote cown are copied byte for byte");
+      T value;
+      get_bytes(&value, sizeof(T));
+      return value;
+    }
+  };
+
+  /**
+   * A connection to another process, see the description of this file.
+   *
+   * A frame is its length, followed by the handler id, the number of cowns
+   * and their ids, then the values of the behaviour. A frame too short for
+   * its header or its cown ids closes the link.
+   */
+  class Link
+  {
+    friend Host;
+
+    template<typename... Ts>
+    friend class When;
+
+    /// Size of each read from the socket.
+    static constexpr size_t READ_SIZE = 64 * 1024;
+
+    std::shared_ptr<Host> host;
+
+    /// The socket is used through two connections, so that the read that
+    /// waits for the peer does not hold up writes.
+    cown_ptr<io::TcpConnection> in;
+    cown_ptr<io::TcpConnection> out;
+    int out_fd;
+
+    /// Frames not yet written, and whether a flush has been scheduled.
+    std::vector<uint8_t> pending;
+    bool flush_scheduled = false;
+    bool closed = false;
+
+    /// Bytes read that do not yet make a whole frame.
+    std::vector<uint8_t> partial;
+
+  public:
+    Link(
+      std::shared_ptr<Host> host,
+      cown_ptr<io::TcpConnection> in,
+      cown_ptr<io::TcpConnection> out,
+      int out_fd)
+    : host(std::move(host)),
+      in(std::move(in)),
+      out(std::move(out)),
+      out_fd(out_fd)
+    {}
+
+    /**
+     * Close the link once the behaviours already sent over it have been
+     * written.
+     */
+    static void close(cown_ptr<Link>& link)
+    {
+      cpp::when(link) << [](acquired_cown<Link> l) { close(l); };
+    }
+
+  private:
+    static void close(acquired_cown<Link>& l)
+    {
+      if (l->closed)
+        return;
+      l->closed = true;
+      flush(l);
+    }
+
+    /**
+     * Append a frame, and schedule a flush after the behaviours already
+     * queued on the link, which may append frames of their own.
+     */
+    static void send(acquired_cown<Link>& l, std::vector<uint8_t>&& frame)
+    {
+      if (l->closed)
+      {
+        Logging::cout() << "Remote behaviour sent on a closed link"
+                        << Logging::endl;
+        return;
+      }
+
+      l->pending.insert(l->pending.end(), frame.begin(), frame.end());
+      if (l->flush_scheduled)
+        return;
+
+      l->flush_scheduled = true;
+      cpp::when(l.cown()) << [](acquired_cown<Link> l) {
+        l->flush_scheduled = false;
+        flush(l);
+      };
+    }
+
+    static void flush(acquired_cown<Link>& l)
+    {
+      if (l->pending.empty() && !l->closed)
+        return;
+
+      io::Buffer buf(l->pending.size());
+      if (!l->pending.empty())
+        memcpy(buf.data(), l->pending.data(), l->pending.size());
+      buf.resize(l->pending.size());
+      l->pending.clear();
+
+      // Writes on `out` complete in order, so the socket is shut down after
+      // the last of them.
+      bool closed = l->closed;
+      int fd = l->out_fd;
+      io::write(l->out, std::move(buf), [closed, fd](auto&, io::Buffer, int) {
+        if (closed)
+          ::shutdown(fd, SHUT_WR);
+      });
+    }
+
+    static void receive(cown_ptr<Link> link, cown_ptr<io::TcpConnection> in)
+    {
+      io::read(
+        in,
+        READ_SIZE,
+        io::deliver_to(
+          link, [](acquired_cown<Link>& l, io::Buffer buf, int err) {
+            if ((err != 0) || (buf.size() == 0))
+            {
+              // The peer has closed the link, or it has failed.
+              close(l);
+              l->host.reset();
+              return;
+            }
+
+            l->partial.insert(
+              l->partial.end(), buf.data(), buf.data() + buf.size());
+            if (!dispatch(l))
+            {
+              // The peer is not following the protocol, so stop reading
+              // from it.
+              l->partial.clear();
+              close(l);
+              l->host.reset();
+              return;
+            }
+            receive(l.cown(), l->in);
+          }));
+    }
+
+    /**
+     * Run the whole frames that have been read, in order. Returns false,
+     * after running the frames before it, if a frame is malformed.
+     */
+    static bool dispatch(acquired_cown<Link>& l);
+  };
+
+  /**
+   * A cown of another process, reached through a link.
+   */
+  template<typename T>
+  struct remote_cown
+  {
+    cown_ptr<Link> link;
+    uint64_t id;
+  };
+
+  template<typename T>
+  remote_cown<T> import(cown_ptr<Link> link, uint64_t id)
+  {
+    return {std::move(link), id};
+  }
+
+  /**
+   * The cowns and handlers that the peers of a process may use.
+   *
+   * They are all added before the first link is connected, as links read
+   * them without synchronisation. A host is kept alive by its open links,
+   * and releases its exported cowns once they have closed.
+   */
+  class Host : public std::enable_shared_from_this<Host>
+  {
+    friend Link;
+
+    using Handler = std::function<void(
+      Host&, const uint64_t* ids, size_t count, std::vector<uint8_t>&&)>;
+
+    std::unordered_map<uint64_t, std::any> cowns;
+    std::unordered_map<uint32_t, Handler> handlers;
+
+    template<typename T>
+    cown_ptr<T>* find(uint64_t id)
+    {
+      auto it = cowns.find(id);
+      if (it == cowns.end())
+        return nullptr;
+      return std::any_cast<cown_ptr<T>>(&it->second);
+    }
+
+    template<typename... Ts, size_t... Is>
+    void invoke(
+      const uint64_t* ids,
+      std::vector<uint8_t>&& values,
+      std::function<void(Reader&, acquired_cown<Ts>&...)>& f,
+      std::index_sequence<Is...>)
+    {
+      auto found = std::make_tuple(find<Ts>(ids[Is])...);
+      if (((std::get<Is>(found) == nullptr) || ...))
+      {
+        Logging::cout() << "Remote behaviour on an unknown cown"
+                        << Logging::endl;
+        return;
+      }
+
+      cpp::when(*std::get<Is>(found)...)
+        << [f, values = std::move(values)](acquired_cown<Ts>... cs) mutable {
+             Reader r(values.data(), values.size());
+             f(r, cs...);
+           };
+    }
+
+  public:
+    static std::shared_ptr<Host> create()
+    {
+      return std::make_shared<Host>();
+    }
+
+    /// Let peers use `cown` under `id`.
+    template<typename T>
+    void export_cown(uint64_t id, cown_ptr<T> cown)
+    {
+      cowns[id] = std::move(cown);
+    }
+
+    /**
+     * Let peers run `f` under `id`, on cowns of types `Ts...`. The handler is
+     * called with a reader of the values sent with the behaviour.
+     */
+    template<typename... Ts, typename F>
+    void handle(uint32_t id, F f)
+    {
+      std::function<void(Reader&, acquired_cown<Ts>&...)> g = std::move(f);
+      handlers[id] = [g = std::move(g)](
+                       Host& host,
+                       const uint64_t* ids,
+                       size_t count,
+                       std::vector<uint8_t>&& values) mutable {
+        if (count != sizeof...(Ts))
+        {
+          Logging::cout() << "Remote behaviour with the wrong number of cowns"
+                          << Logging::endl;
+          return;
+        }
+        host.invoke<Ts...>(
+          ids, std::move(values), g, std::index_sequence_for<Ts...>());
+      };
+    }
+
+    /**
+     * Connect to a peer over the connected stream socket `fd`, of which the
+     * link takes ownership. Throws `std::system_error` on failure.
+     */
+    cown_ptr<Link> connect(int fd)
+    {
+      int out_fd = ::dup(fd);
+      if (out_fd < 0)
+      {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category());
+      }
+
+      auto in = make_cown<io::TcpConnection>(fd);
+      auto out = make_cown<io::TcpConnection>(out_fd);
+      auto link = make_cown<Link>(shared_from_this(), in, out, out_fd);
+      Link::receive(link, in);
+      return link;
+    }
+  };
+
+  inline bool Link::dispatch(acquired_cown<Link>& l)
+  {
+    size_t offset = 0;
+    auto& bytes = l->partial;
+    while (bytes.size() - offset >= sizeof(uint32_t))
+    {
+      uint32_t length;
+      memcpy(&length, bytes.data() + offset, sizeof(length));
+      if (bytes.size() - offset - sizeof(length) < length)
+        break;
+
+      Reader r(bytes.data() + offset + sizeof(length), length);
+      offset += sizeof(length) + length;
+
+      auto handler = r.get<uint32_t>();
+      auto count = r.get<uint32_t>();
+      if (!r.ok() || (count > (r.remaining() / sizeof(uint64_t))))
+      {
+        Logging::cout() << "Malformed remote behaviour" << Logging::endl;
+        return false;
+      }
+
+      std::vector<uint64_t> ids(count);
+      r.get_bytes(ids.data(), count * sizeof(uint64_t));
+      std::vector<uint8_t> values(r.remaining());
+      r.get_bytes(values.data(), values.size());
+
+      auto it = l->host->handlers.find(handler);
+      if (it == l->host->handlers.end())
+      {
+        Logging::cout() << "Remote behaviour with an unknown handler "
+                        << handler << Logging::endl;
+        continue;
+      }
+      it->second(*l->host, ids.data(), count, std::move(values));
+    }
+    bytes.erase(bytes.begin(), bytes.begin() + offset);
+    return true;
+  }
+
+  /**
+   * A behaviour on remote cowns, see `remote::when`.
+   */
+  template<typename... Ts>
+  class When
+  {
+    std::tuple<remote_cown<Ts>...> cowns;
+
+  public:
+    When(remote_cown<Ts>... cowns) : cowns(std::move(cowns)...) {}
+
+    /**
+     * Run the handler `handler` of the peer on the cowns, with `args`.
+     */
+    template<typename... Args>
+    void call(uint32_t handler, const Args&... args)
+    {
+      std::vector<uint8_t> frame(sizeof(uint32_t));
+      Writer w(frame);
+      w.put(handler);
+      w.put((uint32_t)sizeof...(Ts));
+      std::apply([&](auto&... cs) { (w.put(cs.id), ...); }, cowns);
+      (w.put(args), ...);
+
+      uint32_t length = (uint32_t)(frame.size() - sizeof(uint32_t));
+      memcpy(frame.data(), &length, sizeof(length));
+
+      // The cowns are all reached through the link of the first, see the
+      // description of this file.
+      cpp::when(std::get<0>(cowns).link)
+        << [frame = std::move(frame)](acquired_cown<Link> l) mutable {
+             Link::send(l, std::move(frame));
+           };
+    }
+  };
+
+  /**
+   * Start a behaviour on cowns of another process, all reached through the
+   * same link:
+   *
+   *   remote::when(a, b).call(HANDLER, args...);
+   */
+  template<typename... Ts>
+  When<Ts...> when(remote_cown<Ts>... cowns)
+  {
+    static_assert(sizeof...(Ts) > 0, "A remote behaviour needs cowns");
+    return When<Ts...>(std::move(cowns)...);
+  }
+} // namespace verona::cpp::remote
+
+#endif
@@ -10,6 +10,17 @@ namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * Detects an `expired` method on the closure of a behaviour. See
+   * `Behaviour::Descriptor::expired`.
+   */
+  template<class T, class = void>
+  struct has_expired : std::false_type
+  {};
+  template<class T>
+  struct has_expired<T, std::void_t<decltype(&T::expired)>> : std::true_type
+  {};
+
   /***
    * This class wraps a C++ implementation of a Verona closure ("when").
    *
@@ -45,9 +56,30 @@ namespace verona::rt
       }
     }
 
+    static bool gc_expired(const Behaviour* msg)
+    {
+      if constexpr (has_expired<T>::value)
+        return (static_cast<const T*>(msg))->expired();
+      else
+      {
+        UNUSED(msg);
+        return false;
+      }
+    }
+
+    static void drop(Behaviour* msg)
+    {
+      (static_cast<T*>(msg))->~T();
+    }
+
     static const Behaviour::Descriptor* desc()
     {
-      static constexpr Behaviour::Descriptor desc = {sizeof(T), f, gc_trace};
+      static constexpr Behaviour::Descriptor desc = {
+        sizeof(T),
+        f,
+        gc_trace,
+        has_expired<T>::value ? gc_expired : nullptr,
+        std::is_trivially_destructible_v<T> ? nullptr : drop};
 
       return &desc;
     }
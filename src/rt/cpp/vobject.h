@@ -6,6 +6,7 @@
 
 #include <new>
 #include <type_traits>
+#include <utility>
 
 namespace verona::rt
 {
@@ -28,6 +29,16 @@ namespace verona::rt
   struct has_notified<T, std::void_t<decltype(&T::notified)>> : std::true_type
   {};
 
+  template<class T, class = void>
+  struct has_cown_batch_limit : std::false_type
+  {};
+  template<class T>
+  struct has_cown_batch_limit<
+    T,
+    std::void_t<decltype(std::declval<T&>().cown_batch_limit(
+      size_t(), bool(), bool()))>> : std::true_type
+  {};
+
   template<class T, class = void>
   struct has_finaliser : std::false_type
   {};
@@ -35,6 +46,33 @@ namespace verona::rt
   struct has_finaliser<T, std::void_t<decltype(&T::finaliser)>> : std::true_type
   {};
 
+  template<class T, class = void>
+  struct has_trace_fields : std::false_type
+  {};
+  template<class T>
+  struct has_trace_fields<T, std::void_t<decltype(&T::trace_fields)>>
+  : std::true_type
+  {};
+
+  /**
+   * Returns the `Descriptor::field_map` of the pointer fields at the byte
+   * `offsets` of an object. A class whose traced fields are all at fixed
+   * offsets can define
+   *
+   *   static constexpr uintptr_t trace_fields()
+   *   {
+   *     return field_map(offsetof(C, f1), offsetof(C, f2));
+   *   }
+   *
+   * so that it is traced without calling its `trace` method, which must
+   * still push the same fields.
+   */
+  template<typename... Offsets>
+  constexpr uintptr_t field_map(Offsets... offsets)
+  {
+    return (Descriptor::field_bit(offsets) | ... | 0);
+  }
+
   template<class T>
   struct has_destructor
   {
@@ -64,6 +102,20 @@ namespace verona::rt
       }
     }
 
+    static size_t
+    gc_batch_limit(Object* o, size_t limit, bool hot, bool contended)
+    {
+      if constexpr (has_cown_batch_limit<T>::value)
+        return ((T*)o)->cown_batch_limit(limit, hot, contended);
+      else
+      {
+        UNUSED(o);
+        UNUSED(hot);
+        UNUSED(contended);
+        return limit;
+      }
+    }
+
     static void gc_final(Object* o, Object* region, ObjectStack& sub_regions)
     {
       if constexpr (has_finaliser<T>::value)
@@ -81,6 +133,14 @@ namespace verona::rt
       ((T*)o)->~T();
     }
 
+    static constexpr uintptr_t gc_trace_fields()
+    {
+      if constexpr (has_trace_fields<T>::value)
+        return T::trace_fields();
+      else
+        return 0;
+    }
+
     void trace(ObjectStack&) {}
 
   public:
@@ -93,7 +153,11 @@ namespace verona::rt
                                 has_finaliser<T>::value ? gc_final : nullptr,
                                 has_notified<T>::value ? gc_notified : nullptr,
                                 has_destructor<T>::value ? gc_destructor :
-                                                           nullptr};
+                                                           nullptr,
+                                has_cown_batch_limit<T>::value ?
+                                  gc_batch_limit :
+                                  nullptr,
+                                gc_trace_fields()};
 
       return &desc;
     }
@@ -140,6 +204,13 @@ namespace verona::rt
       // region.
     }
 
+    void operator delete(void*, ArenaSource*)
+    {
+      // Should not be called directly, present to allow calling if the
+      // constructor throws an exception. The object lifetime is managed by the
+      // region.
+    }
+
     void* operator new[](size_t size) = delete;
     void operator delete[](void* p) = delete;
     void operator delete[](void* p, size_t sz) = delete;
@@ -165,6 +236,15 @@ namespace verona::rt
     {
       return api::create_fresh_region<V>(rt, V::desc());
     }
+
+    /**
+     * Create a fresh arena region whose memory comes from `source`, see
+     * `ArenaSource`.
+     */
+    void* operator new(size_t, ArenaSource* source)
+    {
+      return RegionArena::create(ThreadAlloc::get(), V::desc(), source);
+    }
   };
 
   /**
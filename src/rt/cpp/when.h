@@ -2,17 +2,87 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "coroutine.h"
 #include "cown.h"
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <tuple>
 #include <utility>
+#include <vector>
 #include <verona.h>
 
 namespace verona::cpp
 {
   using namespace verona::rt;
 
+  /**
+   * Lets the sender of a `when` drop it, if it has not started running.
+   *
+   *   cancellation_token token;
+   *   when (c).with_cancellation(token) << closure;
+   *   token.cancel();
+   *
+   * Copies of a token share their state.
+   */
+  class cancellation_token
+  {
+    std::shared_ptr<std::atomic<bool>> cancelled =
+      std::make_shared<std::atomic<bool>>(false);
+
+    template<typename... Args>
+    friend class When;
+
+  public:
+    void cancel()
+    {
+      cancelled->store(true, std::memory_order_release);
+    }
+
+    bool is_cancelled() const
+    {
+      return cancelled->load(std::memory_order_acquire);
+    }
+  };
+
+  /**
+   * Wraps the closure of a `when` with a deadline or a cancellation token.
+   * The runtime drops the behaviour without running it once it has expired,
+   * see `Behaviour::Descriptor::expired`.
+   */
+  template<typename F>
+  class ExpiringClosure
+  {
+    F f;
+    std::chrono::steady_clock::time_point deadline;
+    std::shared_ptr<const std::atomic<bool>> cancelled;
+
+  public:
+    ExpiringClosure(
+      F f,
+      std::chrono::steady_clock::time_point deadline,
+      std::shared_ptr<const std::atomic<bool>> cancelled)
+    : f(std::move(f)), deadline(deadline), cancelled(std::move(cancelled))
+    {}
+
+    void operator()()
+    {
+      f();
+    }
+
+    bool expired() const
+    {
+      if ((cancelled != nullptr) && cancelled->load(std::memory_order_acquire))
+        return true;
+
+      return (deadline != std::chrono::steady_clock::time_point::max()) &&
+        (std::chrono::steady_clock::now() >= deadline);
+    }
+  };
+
   /**
    * Used to track the type of access request by embedding const into
    * the type T, or not having const.
@@ -25,10 +95,21 @@ namespace verona::cpp
   public:
     Access(const cown_ptr<T>& c) : t(c.allocated_cown) {}
 
+    Access(const cown_ref<T>& c) : t(c.cown) {}
+
     template<typename... Args>
     friend class When;
   };
 
+  template<typename First, typename Second>
+  class WhenThen;
+
+  template<typename R, typename G, typename... Args>
+  struct ThenClosure;
+
+  template<typename F, typename Next, typename... Args>
+  class FirstStage;
+
   /**
    * Class for staging the when creation.
    *
@@ -56,12 +137,35 @@ namespace verona::cpp
     template<typename... Args2>
     friend auto when(Args2&&... args);
 
+    template<typename T>
+    friend class WhenBatch;
+
+    template<typename First, typename Second>
+    friend class WhenThen;
+
+    template<typename R, typename G, typename... Args2>
+    friend struct ThenClosure;
+
+    template<typename F, typename Next, typename... Args2>
+    friend class FirstStage;
+
     /**
      * Internally uses AcquiredCown.  The cown is only acquired after the
      * behaviour is scheduled.
      */
     std::tuple<Access<Args>...> cown_tuple;
 
+    /**
+     * The behaviour is dropped if it has not started running by this time.
+     */
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+
+    /**
+     * The behaviour is dropped if this is set before it starts running.
+     */
+    std::shared_ptr<const std::atomic<bool>> cancelled;
+
     /**
      * This uses template programming to turn the std::tuple into a C style
      * stack allocated array.
@@ -101,12 +205,28 @@ namespace verona::cpp
       return acquired_cown<C>(*c.t);
     }
 
-  public:
     /**
-     * Applies the closure to schedule the behaviour on the set of cowns.
+     * Schedule the closure `f` on the requested cowns, wrapping it if it can
+     * expire.
      */
     template<typename F>
-    void operator<<(F&& f)
+    void schedule(F&& f)
+    {
+      if (
+        (deadline == std::chrono::steady_clock::time_point::max()) &&
+        (cancelled == nullptr))
+      {
+        schedule_on_cowns(std::forward<F>(f));
+      }
+      else
+      {
+        schedule_on_cowns(ExpiringClosure<std::decay_t<F>>(
+          std::forward<F>(f), deadline, std::move(cancelled)));
+      }
+    }
+
+    template<typename F>
+    void schedule_on_cowns(F&& f)
     {
       if constexpr (sizeof...(Args) == 0)
       {
@@ -118,22 +238,460 @@ namespace verona::cpp
         array_assign(requests);
 
         verona::rt::schedule_lambda(
-          sizeof...(Args),
-          requests,
-          [f = std::forward<F>(f), cown_tuple = cown_tuple]() mutable {
-            /// Effectively converts ActualCown<T>... to
-            /// acquired_cown... .
-            auto lift_f = [f =
-                             std::forward<F>(f)](Access<Args>... args) mutable {
+          sizeof...(Args), requests, std::forward<F>(f));
+      }
+    }
+
+  public:
+    /**
+     * Drop the behaviour, if it has not started running by `d`.
+     */
+    When& with_deadline(std::chrono::steady_clock::time_point d)
+    {
+      deadline = d;
+      return *this;
+    }
+
+    /**
+     * Drop the behaviour, if `token` is cancelled before it starts running.
+     */
+    When& with_cancellation(const cancellation_token& token)
+    {
+      cancelled = token.cancelled;
+      return *this;
+    }
+
+    /**
+     * Chain a second behaviour, on the cowns `args`, which is passed the
+     * result of this one:
+     *
+     *   when(a).then(b) << [](acquired_cown<A> a) { return a->x; }
+     *                   << [](int x, acquired_cown<B> b) { b->y = x; };
+     *
+     * The second behaviour is built, and its message allocated, when the
+     * closures are given. The result is moved straight into it, and it is
+     * sent as the first returns, with no promise, cown or behaviour between
+     * them. If the first has no result, the second only takes its cowns. If
+     * the first is dropped, as it expired, so is the second.
+     */
+    template<typename... Args2>
+    auto then(Args2&&... args)
+    {
+      static_assert(sizeof...(Args) > 0, "`then` needs cowns to start from");
+      static_assert(sizeof...(Args2) > 0, "`then` needs cowns to run on");
+      auto second = when(std::forward<Args2>(args)...);
+      return WhenThen<When, decltype(second)>(
+        std::move(*this), std::move(second));
+    }
+
+#ifdef USE_COROUTINES
+    /**
+     * Suspends the calling coroutine until the cowns are acquired, and
+     * resumes it from the behaviour that holds them, see `cpp/coroutine.h`.
+     * Results in the `acquired_cown` of a single cown, or a tuple of
+     * references to the state of several cowns, as `acquired_cown` cannot be
+     * moved into a tuple. If the behaviour expires, the coroutine is
+     * destroyed rather than resumed.
+     */
+    auto operator co_await()
+    {
+      struct Awaiter
+      {
+        When w;
+
+        bool await_ready() noexcept
+        {
+          return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+          w.schedule(ResumeCoroutine(h));
+        }
+
+        auto await_resume()
+        {
+          if constexpr (sizeof...(Args) == 1)
+            return access_to_acquired<Args...>(std::get<0>(w.cown_tuple));
+          else
+            return std::apply(
+              [](Access<Args>... args) {
+                return std::tuple<Args&...>(
+                  access_to_acquired<Args>(args).get_ref()...);
+              },
+              w.cown_tuple);
+        }
+      };
+
+      return Awaiter{*this};
+    }
+#endif
+
+    /**
+     * Applies the closure to schedule the behaviour on the set of cowns.
+     */
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      if constexpr (sizeof...(Args) == 0)
+      {
+        schedule(std::forward<F>(f));
+      }
+      else
+      {
+        schedule([f = std::forward<F>(f), cown_tuple = cown_tuple]() mutable {
+          /// Effectively converts ActualCown<T>... to
+          /// acquired_cown... .
+          auto lift_f =
+            [f = std::forward<F>(f)](Access<Args>... args) mutable {
               f(access_to_acquired<Args>(args)...);
             };
 
-            std::apply(lift_f, cown_tuple);
-          });
+          std::apply(lift_f, cown_tuple);
+        });
       }
     }
   };
 
+  /**
+   * The cowns acquired by a `when_all`, passed to its closure. The cowns are
+   * in the order the runtime acquires them, not that of the request, and
+   * each cown appears once. It must not outlive the behaviour.
+   */
+  template<typename T>
+  class acquired_cowns
+  {
+    template<typename>
+    friend class WhenAll;
+
+    Request* requests;
+    size_t count;
+
+    acquired_cowns(Request* requests, size_t count)
+    : requests(requests), count(count)
+    {}
+
+  public:
+    size_t size() const
+    {
+      return count;
+    }
+
+    T& operator[](size_t i) const
+    {
+      assert(i < count);
+      auto cown = (ActualCown<std::remove_const_t<T>>*)requests[i].cown();
+      return cown->value;
+    }
+
+    /// Borrow the `i`th cown, see `cown_ref`.
+    cown_ref<T> ref(size_t i) const
+    {
+      assert(i < count);
+      return cown_ref<T>(
+        (ActualCown<std::remove_const_t<T>>*)requests[i].cown());
+    }
+  };
+
+  /**
+   * Class for staging a `when` on a number of cowns only known at runtime.
+   *
+   * Do not call directly use `when_all`
+   */
+  template<typename T>
+  class WhenAll
+  {
+    template<typename T2>
+    friend WhenAll<T2> when_all(const cown_ptr<T2>* cowns, size_t count);
+
+    const cown_ptr<T>* cowns;
+    size_t count;
+
+    WhenAll(const cown_ptr<T>* cowns, size_t count)
+    : cowns(cowns), count(count)
+    {}
+
+  public:
+    /**
+     * Applies the closure, which takes an `acquired_cowns<T>`, to schedule
+     * the behaviour on all the cowns.
+     */
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      verona::rt::schedule_lambda_requests(
+        count,
+        [this](Request* requests) {
+          for (size_t i = 0; i < count; i++)
+          {
+            Cown* c = cowns[i].allocated_cown;
+            assert(c != nullptr);
+            if constexpr (std::is_const_v<T>)
+              requests[i] = Request::read(c);
+            else
+              requests[i] = Request::write(c);
+          }
+        },
+        [f = std::forward<F>(f)]() mutable {
+          auto* body = Scheduler::local()->message_body;
+          f(acquired_cowns<T>(body->get_requests_array(), body->count));
+        });
+    }
+  };
+
+  /**
+   * Implements a `when` on `count` cowns, a number only known at runtime:
+   *
+   *   when_all(cowns, count) << [](acquired_cowns<T> cs) { ... };
+   *
+   * The requests are written straight into the message, with no other
+   * allocation, and the same cown may be given more than once. An array of
+   * `cown_ptr<const T>` acquires the cowns for reading.
+   */
+  template<typename T>
+  WhenAll<T> when_all(const cown_ptr<T>* cowns, size_t count)
+  {
+    return WhenAll<T>(cowns, count);
+  }
+
+  template<typename T>
+  WhenAll<T> when_all(const std::vector<cown_ptr<T>>& cowns)
+  {
+    return when_all(cowns.data(), cowns.size());
+  }
+
+  /**
+   * The closure of the second behaviour of `When::then`, which holds the
+   * result of the first until it runs.
+   */
+  template<typename R, typename G, typename... Args>
+  struct ThenClosure
+  {
+    std::optional<std::conditional_t<std::is_void_v<R>, bool, R>> result;
+    G g;
+    std::tuple<Access<Args>...> cown_tuple;
+
+    void operator()()
+    {
+      std::apply(
+        [this](Access<Args>... args) {
+          if constexpr (std::is_void_v<R>)
+            g(When<Args...>::access_to_acquired(args)...);
+          else
+            g(std::move(*result), When<Args...>::access_to_acquired(args)...);
+        },
+        cown_tuple);
+    }
+  };
+
+  /**
+   * The closure of the first behaviour of `When::then`, which owns the
+   * prepared message of the second until it sends it.
+   */
+  template<typename F, typename Next, typename... Args>
+  class FirstStage
+  {
+    F f;
+    Next* next_closure;
+    MultiMessage::Body* next;
+    std::tuple<Access<Args>...> cown_tuple;
+
+  public:
+    FirstStage(
+      F f,
+      Next* next_closure,
+      MultiMessage::Body* next,
+      std::tuple<Access<Args>...> cown_tuple)
+    : f(std::move(f)),
+      next_closure(next_closure),
+      next(next),
+      cown_tuple(cown_tuple)
+    {}
+
+    FirstStage(FirstStage&& other)
+    : f(std::move(other.f)),
+      next_closure(other.next_closure),
+      next(other.next),
+      cown_tuple(other.cown_tuple)
+    {
+      other.next = nullptr;
+    }
+
+    FirstStage(const FirstStage&) = delete;
+
+    ~FirstStage()
+    {
+      if (next != nullptr)
+        Cown::discard_prepared(next);
+    }
+
+    void operator()()
+    {
+      std::apply(
+        [this](Access<Args>... args) {
+          if constexpr (std::is_void_v<decltype(f(
+                          When<Args...>::access_to_acquired(args)...))>)
+            f(When<Args...>::access_to_acquired(args)...);
+          else
+            next_closure->result.emplace(
+              f(When<Args...>::access_to_acquired(args)...));
+        },
+        cown_tuple);
+
+      auto body = next;
+      next = nullptr;
+      Cown::send_prepared(body);
+    }
+  };
+
+  /**
+   * Class for staging the two behaviours of `When::then`.
+   *
+   * Do not call directly use `when(...).then(...)`
+   */
+  template<typename... Args1, typename... Args2>
+  class WhenThen<When<Args1...>, When<Args2...>>
+  {
+    When<Args1...> first;
+    When<Args2...> second;
+
+    template<typename F>
+    class Staged
+    {
+      When<Args1...> first;
+      When<Args2...> second;
+      F f;
+
+    public:
+      Staged(When<Args1...> first, When<Args2...> second, F f)
+      : first(std::move(first)), second(std::move(second)), f(std::move(f))
+      {}
+
+      /// Applies the closure of the second behaviour, and schedules both.
+      template<typename G>
+      void operator<<(G&& g)
+      {
+        using First = When<Args1...>;
+        using R = decltype(std::declval<F&>()(
+          First::access_to_acquired(std::declval<Access<Args1>>())...));
+        using Next = ThenClosure<R, std::decay_t<G>, Args2...>;
+
+        Next* next_closure;
+        auto next = verona::rt::prepare_lambda_requests(
+          sizeof...(Args2),
+          [this](Request* requests) { second.array_assign(requests); },
+          Next{std::nullopt, std::forward<G>(g), second.cown_tuple},
+          next_closure);
+
+        first.schedule(FirstStage<F, Next, Args1...>(
+          std::move(f), next_closure, next, first.cown_tuple));
+      }
+    };
+
+  public:
+    WhenThen(When<Args1...> first, When<Args2...> second)
+    : first(std::move(first)), second(std::move(second))
+    {}
+
+    /// Applies the closure of the first behaviour.
+    template<typename F>
+    Staged<std::decay_t<F>> operator<<(F&& f)
+    {
+      return Staged<std::decay_t<F>>(
+        std::move(first), std::move(second), std::forward<F>(f));
+    }
+  };
+
+  /**
+   * Class for staging a `when` on a weak reference.
+   *
+   * Do not call directly use `when_alive`
+   */
+  template<typename T>
+  class WhenAlive
+  {
+    template<typename T2>
+    friend WhenAlive<T2> when_alive(const weak_cown_ptr<T2>& cown);
+
+    cown_ptr<T> cown;
+
+    WhenAlive(cown_ptr<T> cown) : cown(std::move(cown)) {}
+
+  public:
+    /**
+     * Applies the closure, if the cown was alive. Returns false if the
+     * behaviour was dropped instead.
+     */
+    template<typename F>
+    bool operator<<(F&& f)
+    {
+      if (!cown)
+        return false;
+
+      when(cown) << std::forward<F>(f);
+      return true;
+    }
+  };
+
+  /**
+   * Implements a `when` on the cown of a weak reference, if it is still
+   * alive:
+   *
+   *   when_alive(weak) << [](acquired_cown<T> c) { ... };
+   *
+   * The behaviour holds the cown from when it is scheduled, so it runs even
+   * if the last strong reference is dropped meanwhile. If the cown has been
+   * collected, the closure is dropped without running.
+   */
+  template<typename T>
+  WhenAlive<T> when_alive(const weak_cown_ptr<T>& cown)
+  {
+    return WhenAlive<T>(cown.try_lock());
+  }
+
+  /**
+   * Class for staging a batch of single cown whens.
+   *
+   * Do not call directly use `when_batch`
+   *
+   *   when_batch (cowns) << closure;
+   *
+   * Schedules the closure on each cown of `cowns`, see `Cown::schedule_many`.
+   */
+  template<typename T>
+  class WhenBatch
+  {
+    template<typename T2>
+    friend WhenBatch<T2> when_batch(const std::vector<cown_ptr<T2>>& cowns);
+
+    const std::vector<cown_ptr<T>>& cowns;
+
+    WhenBatch(const std::vector<cown_ptr<T>>& cowns) : cowns(cowns) {}
+
+  public:
+    /**
+     * Applies the closure to schedule a behaviour on each cown.
+     */
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      std::vector<Cown*> targets;
+      targets.reserve(cowns.size());
+      for (auto& c : cowns)
+      {
+        assert(c.allocated_cown != nullptr);
+        targets.push_back(c.allocated_cown);
+      }
+
+      verona::rt::schedule_lambda_many(
+        targets.size(), targets.data(), [&](size_t i) {
+          return [f, c = Access<T>(cowns[i])]() mutable {
+            f(When<T>::template access_to_acquired<T>(c));
+          };
+        });
+    }
+  };
+
   /**
    * Template deduction guide for when.
    */
@@ -146,6 +704,9 @@ namespace verona::cpp
   template<typename T>
   Access(const cown_ptr<T>&)->Access<T>;
 
+  template<typename T>
+  Access(const cown_ref<T>&)->Access<T>;
+
   /**
    * Implements a Verona-like `when` statement.
    *
@@ -162,4 +723,71 @@ namespace verona::cpp
   {
     return When(Access(args)...);
   }
+
+  /**
+   * Class for staging a `when` that is scheduled after a delay.
+   *
+   * Do not call directly use `when_after`
+   */
+  template<typename... Args>
+  class WhenAfter
+  {
+    template<typename Rep, typename Period, typename... Args2>
+    friend auto when_after(
+      std::chrono::duration<Rep, Period> delay,
+      const cown_ptr<Args2>&... cowns);
+
+    std::chrono::milliseconds delay;
+    std::tuple<cown_ptr<Args>...> cowns;
+
+    WhenAfter(std::chrono::milliseconds delay, const cown_ptr<Args>&... cowns)
+    : delay(delay), cowns(cowns...)
+    {}
+
+  public:
+    /**
+     * Applies the closure to schedule the behaviour once the delay has
+     * passed.
+     */
+    template<typename F>
+    void operator<<(F&& f)
+    {
+      call_after(
+        delay,
+        [cowns = std::move(cowns), f = std::forward<F>(f)]() mutable {
+          std::apply(
+            [&](auto&... cs) { when(cs...) << std::move(f); }, cowns);
+        });
+    }
+  };
+
+  /**
+   * Like `when`, but the behaviour is only scheduled once `delay` has
+   * passed, rounded up to a millisecond. The cowns are held until then.
+   *
+   *   when_after(50ms, c1, c2) << closure;
+   *
+   * Pending timers keep the runtime alive. The timer is kept by the scheduler
+   * thread that calls this, which sleeps no later than it is due.
+   */
+  template<typename Rep, typename Period, typename... Args>
+  auto when_after(
+    std::chrono::duration<Rep, Period> delay, const cown_ptr<Args>&... cowns)
+  {
+    return WhenAfter<Args...>(
+      std::chrono::ceil<std::chrono::milliseconds>(delay), cowns...);
+  }
+
+  /**
+   * Schedules the same closure on each of a number of cowns, as if by
+   * `when (c) << closure` for each cown `c`, but with fewer enqueues and
+   * wake ups.
+   *
+   * Uses `<<` to apply the closure.
+   */
+  template<typename T>
+  WhenBatch<T> when_batch(const std::vector<cown_ptr<T>>& cowns)
+  {
+    return WhenBatch<T>(cowns);
+  }
 } // namespace verona::cpp
\ No newline at end of file
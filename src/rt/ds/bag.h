@@ -71,7 +71,7 @@ namespace verona::rt
     }
 
   public:
-    BagBase<E, Alloc>() : index(null_index), next_free(nullptr)
+    BagBase() : index(null_index), next_free(nullptr)
     {
       static_assert(
         sizeof(*this) == sizeof(void*) * 2,
@@ -98,6 +98,65 @@ namespace verona::rt
       next_free = hole;
     }
 
+    /**
+     * Remove `item` without leaving a hole, by moving the last element of the
+     * bag into its place. `on_move` is called with the new location of the
+     * moved element, so that anything pointing to it can be updated.
+     *
+     * This keeps iteration proportional to the number of live elements. It
+     * may only be used on a bag with no holes, i.e. one that never uses
+     * `remove`, or just after `compact`.
+     */
+    template<typename F>
+    ALWAYSINLINE void remove_compact(E* item, Alloc& alloc, F&& on_move)
+    {
+      assert(next_free == nullptr);
+
+      MaybeElem* hole = (MaybeElem*)item;
+      if (hole != index)
+      {
+        hole->item = index->item;
+        on_move(&hole->item);
+      }
+      pop(alloc);
+    }
+
+    /**
+     * Fill every hole in the bag by moving elements down from the end, and
+     * deallocate the blocks this empties. `on_move` is called with the new
+     * location of each moved element.
+     *
+     * Iterating a bag visits its holes, so a bag that has had many elements
+     * removed is slow to iterate until it is compacted. This takes time
+     * proportional to the size of the bag, including holes.
+     */
+    template<typename F>
+    void compact(Alloc& alloc, F&& on_move)
+    {
+      // Every slot above `scan` is live, so the last slot is live whenever it
+      // is above `scan`.
+      MaybeElem* scan = index;
+      while (scan != null_index)
+      {
+        MaybeElem* below = scan;
+        step(below);
+
+        if (is_hole(scan))
+        {
+          if (scan != index)
+          {
+            scan->item = index->item;
+            on_move(&scan->item);
+          }
+          pop(alloc);
+        }
+
+        scan = below;
+      }
+
+      next_free = nullptr;
+    }
+
     /// Insert an element into the bag.
     ALWAYSINLINE E* insert(E item, Alloc& alloc)
     {
@@ -133,6 +192,27 @@ namespace verona::rt
       return &(index->item);
     }
 
+    /// Remove the last slot of the bag, deallocating its block if it was
+    /// the only slot in use.
+    void pop(Alloc& alloc)
+    {
+      assert(index != null_index);
+      if (!is_first_block_elem(index - 1))
+      {
+        index--;
+        return;
+      }
+
+      Block* block = get_block(index);
+      index = block->prev.hole_ptr;
+      alloc.template dealloc<sizeof(Block)>(block);
+    }
+
+    static bool is_hole(MaybeElem* elem)
+    {
+      return (uintptr_t)elem->hole_ptr & EMPTY_MASK;
+    }
+
     static void step(MaybeElem*& elem)
     {
       elem--;
@@ -144,8 +224,7 @@ namespace verona::rt
 
     static MaybeElem* next_non_empty(MaybeElem* elem)
     {
-      while ((elem != BagBase::null_index) &&
-             ((uintptr_t)elem->hole_ptr & EMPTY_MASK))
+      while ((elem != BagBase::null_index) && is_hole(elem))
       {
         step(elem);
       }
@@ -232,7 +311,8 @@ namespace verona::rt
    * which can occur with deallocation churn, the bag maintains a freelist which
    * is threaded through the holes left in the bag.  Insertion of new items will
    * first query the freelist to see if a hole can be reused, otherwise items
-   * are bump allocated.
+   * are bump allocated. Holes can be removed with `compact`, or avoided by
+   * using `remove_compact`, at the cost of moving elements.
    *
    * To maintain an internal freelist with no additional space requirements, the
    * item `T` must be at least 1 machine word in size.
@@ -246,7 +326,7 @@ namespace verona::rt
     using iterator = typename B::iterator;
 
   public:
-    Bag<T, U, Alloc>() : BagBase<Elem, Alloc>() {}
+    Bag() : BagBase<Elem, Alloc>() {}
   };
 
   template<class T>
@@ -271,7 +351,7 @@ namespace verona::rt
     using iterator = typename B::iterator;
 
   public:
-    BagThin<T, Alloc>() : BagBase<Elem, Alloc>() {}
+    BagThin() : BagBase<Elem, Alloc>() {}
   };
 
 } // namespace verona::rt
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "../object/object.h"
+#include "swissmap.h"
 
 namespace verona::rt
 {
@@ -103,10 +104,19 @@ namespace verona::rt
      * be reinserted.
      */
     void resize(Alloc& alloc)
+    {
+      resize(alloc, capacity_shift + 1);
+    }
+
+    /**
+     * Grow the allocation to `1 << shift` slots. The entries in the previous
+     * allocation will be reinserted.
+     */
+    void resize(Alloc& alloc, uint8_t shift)
     {
       auto prev = *this;
 
-      capacity_shift++;
+      capacity_shift = shift;
       slots = (Entry*)alloc.alloc<YesZero>(capacity() * sizeof(Entry));
       filled_slots = 0;
       longest_probe = 0;
@@ -255,6 +265,20 @@ namespace verona::rt
       return ((size_t)1 << capacity_shift);
     }
 
+    /**
+     * Grow the map, if needed, so that `count` entries fit without resizing
+     * one slot at a time.
+     */
+    void reserve(Alloc& alloc, size_t count)
+    {
+      auto shift = capacity_shift;
+      while (((size_t)1 << shift) < count)
+        shift++;
+
+      if (shift != capacity_shift)
+        resize(alloc, shift);
+    }
+
     Iterator begin() const
     {
       auto it = Iterator(this, 0);
@@ -436,4 +460,15 @@ namespace verona::rt
       return out;
     }
   };
+
+  /**
+   * The map used by the runtime for remembered sets and external reference
+   * tables. This is `ObjectMap` unless `USE_SWISS_OBJECT_MAP` is defined.
+   */
+  template<typename Entry>
+#ifdef USE_SWISS_OBJECT_MAP
+  using DefaultObjectMap = SwissObjectMap<Entry>;
+#else
+  using DefaultObjectMap = ObjectMap<Entry>;
+#endif
 }
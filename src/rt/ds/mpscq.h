@@ -142,12 +142,26 @@ namespace verona::rt
      **/
     bool enqueue(T* t)
     {
-      assert(is_clear(t));
+      return enqueue_segment(t, t);
+    }
+
+    /**
+     * Enqueues (inserts) a segment of messages into the queue, with a single
+     * exchange on `back`. The messages from `first` to `last` must already be
+     * linked through `next`.
+     *
+     * Returns true if the queue was sleeping when the messages were added.
+     **/
+    bool enqueue_segment(T* first, T* last)
+    {
+      assert(is_clear(first));
+      assert(is_clear(last));
 
       invariant();
-      t->next.store(nullptr, std::memory_order_relaxed);
-      std::atomic_thread_fence(std::memory_order_release);
-      T* prev = back.exchange(t, std::memory_order_relaxed);
+      last->next.store(nullptr, std::memory_order_relaxed);
+      // Acquire, so that the write to `prev->next` below follows the reset
+      // of `prev` by `swap_stub`.
+      T* prev = back.exchange(last, std::memory_order_acq_rel);
       bool was_sleeping;
 
       yield();
@@ -155,13 +169,13 @@ namespace verona::rt
       // Pass on the notify info if set
       if (has_state(prev, NOTIFY))
       {
-        t = set_state(t, NOTIFY);
+        first = set_state(first, NOTIFY);
       }
 
       was_sleeping = has_state(prev, SLEEPING);
       prev = clear_state(prev);
 
-      prev->next.store(t, std::memory_order_relaxed);
+      prev->next.store(first, std::memory_order_relaxed);
       return was_sleeping;
     }
 
@@ -194,7 +208,7 @@ namespace verona::rt
       assert(front);
       std::atomic_thread_fence(std::memory_order_acquire);
 
-      alloc.dealloc(fnt, fnt->size());
+      fnt->dealloc(alloc);
       invariant();
 
       if (has_state(next, NOTIFY))
@@ -323,6 +337,30 @@ namespace verona::rt
       return back.compare_exchange_strong(fnt, bk, std::memory_order_release);
     }
 
+    /**
+     * Replaces the element at the front of an empty queue with `stub`, so
+     * that the last element dequeued can be freed before the next one
+     * arrives. Returns the element that was replaced, or nullptr if the queue
+     * is not empty, is not in the NONE state, or already starts with `stub`.
+     *
+     * Only safe to call from the consumer.
+     */
+    T* swap_stub(T* stub)
+    {
+      assert(is_clear(stub));
+      T* fnt = front;
+      if (fnt == stub)
+        return nullptr;
+
+      stub->next.store(nullptr, std::memory_order_relaxed);
+      T* bk = fnt;
+      if (!back.compare_exchange_strong(bk, stub, std::memory_order_acq_rel))
+        return nullptr;
+
+      front = stub;
+      return fnt;
+    }
+
     /**
      * Wakes the queue from the sleeping state. Returns true if it woke the
      * queue up, and false otherwise. Safe to call from a producer.
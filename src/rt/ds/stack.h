@@ -2,11 +2,107 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <snmalloc/snmalloc.h>
 
 namespace verona::rt
 {
+  /**
+   * Stack blocks freed by a thread, kept for reuse by the next `Stack` it
+   * creates, so that traversals such as GC and freeze don't allocate and free
+   * their blocks every time. As with the arena cache, caching is only enabled
+   * on scheduler threads, which flush the cache when they stop, so that all
+   * the memory is back with the allocator at the end of a run.
+   *
+   * The number of blocks kept adapts to the deepest stack the thread has
+   * needed, between `MIN_BLOCKS` and `MAX_BLOCKS`, so a thread that has done
+   * a large traversal keeps enough blocks for the next one.
+   */
+  class StackBlockCache
+  {
+  public:
+    /// Size of a block of any `StackThin`.
+    static constexpr size_t BLOCK_SIZE = 64 * sizeof(void*);
+
+  private:
+    static constexpr size_t MIN_BLOCKS = 4;
+    static constexpr size_t MAX_BLOCKS = 1024;
+
+    struct FreeBlock
+    {
+      FreeBlock* next;
+    };
+
+    bool enabled = false;
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+    size_t limit = MIN_BLOCKS;
+
+    static StackBlockCache& get()
+    {
+      static thread_local StackBlockCache cache;
+      return cache;
+    }
+
+  public:
+    static void enable()
+    {
+      get().enabled = true;
+    }
+
+    /// Return the cached blocks to `alloc`, and stop caching.
+    template<class Alloc>
+    static void flush(Alloc& alloc)
+    {
+      auto& cache = get();
+      cache.enabled = false;
+      while (cache.head != nullptr)
+      {
+        FreeBlock* block = cache.head;
+        cache.head = block->next;
+        alloc.template dealloc<BLOCK_SIZE>(block);
+      }
+      cache.count = 0;
+      cache.limit = MIN_BLOCKS;
+    }
+
+    /// Returns a cached block, or nullptr if there isn't one.
+    static void* acquire()
+    {
+      auto& cache = get();
+      FreeBlock* block = cache.head;
+      if (block != nullptr)
+      {
+        cache.head = block->next;
+        cache.count--;
+      }
+      return block;
+    }
+
+    /// Keep `block` for reuse. Returns false if it should be deallocated
+    /// instead, because the cache is full or disabled.
+    static bool release(void* block)
+    {
+      auto& cache = get();
+      if (!cache.enabled || (cache.count >= cache.limit))
+        return false;
+
+      auto free_block = static_cast<FreeBlock*>(block);
+      free_block->next = cache.head;
+      cache.head = free_block;
+      cache.count++;
+      return true;
+    }
+
+    /// Record that a stack needed `blocks` blocks at once.
+    static void record_peak(size_t blocks)
+    {
+      auto& cache = get();
+      cache.limit = std::min(MAX_BLOCKS, std::max(cache.limit, blocks));
+    }
+  };
+
   /**
    * This class contains the core functionality for a stack using aligned blocks
    * of memory. The stack is the size of a single pointer when empty.
@@ -209,18 +305,30 @@ namespace verona::rt
   {
     /**
      * The BackupAlloc allocates Blocks for the stack
-     * Uses a one place pool to avoid always calling the allocator.
+     * Uses a one place pool, and then the thread's StackBlockCache, to avoid
+     * always calling the allocator.
      */
     class BackupAlloc
     {
       using Block = typename StackThin<T, BackupAlloc>::Block;
+      static_assert(sizeof(Block) == StackBlockCache::BLOCK_SIZE);
 
       /// A one place pool of Block.
       Block* backup = nullptr;
 
+      /// Number of blocks in use by the stack, and the most there has been.
+      size_t live = 0;
+      size_t peak = 0;
+
       /// Allocator that blocks are supplied by.
       Alloc& underlying_alloc;
 
+      void release(Block* b)
+      {
+        if (!StackBlockCache::release(b))
+          underlying_alloc.template dealloc<sizeof(Block)>(b);
+      }
+
     public:
       BackupAlloc(Alloc& a) : underlying_alloc(a) {}
 
@@ -232,10 +340,13 @@ namespace verona::rt
           Size == sizeof(Block),
           "Allocating something not the size of a block");
 
+        peak = std::max(peak, ++live);
+
         if (backup)
           return std::exchange(backup, nullptr);
-        else
-          return underlying_alloc.template alloc<Size>();
+        if (void* b = StackBlockCache::acquire())
+          return b;
+        return underlying_alloc.template alloc<Size>();
       }
 
       /// Deallocate a stack Block.
@@ -246,16 +357,19 @@ namespace verona::rt
           Size == sizeof(Block),
           "Deallocating something not the size of a block");
 
+        live--;
+
         if (backup == nullptr)
           backup = b;
         else
-          underlying_alloc.template dealloc<Size>(b);
+          release(b);
       }
 
       ~BackupAlloc()
       {
+        StackBlockCache::record_peak(peak);
         if (backup != nullptr)
-          underlying_alloc.template dealloc<sizeof(Block)>(backup);
+          release(backup);
       }
     };
 
@@ -0,0 +1,588 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define VERONA_SWISSMAP_SSE2
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Hash map with the same interface as `ObjectMap`, laid out as a SwissTable.
+   * The key type is `K*`, where `K` is derrived from `Object`, and the `Entry`
+   * type must be either `K*` or `std::pair<K*, Value>`.
+   *
+   * Each slot has a control byte, which is either empty, deleted, or the low
+   * 7 bits of the hash of the key in the slot. Lookups probe a group of 16
+   * control bytes at a time, with SSE2 where it is available, and only compare
+   * the keys of the slots whose control byte matches.
+   *
+   * Select this over `ObjectMap` for the runtime's remembered sets and
+   * external reference tables by defining `USE_SWISS_OBJECT_MAP`, see
+   * `DefaultObjectMap`.
+   */
+  template<typename Entry>
+  class SwissObjectMap
+  {
+    using Ctrl = int8_t;
+
+    static constexpr Ctrl EMPTY = -128;
+    static constexpr Ctrl DELETED = -2;
+
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr size_t INIT_CAPACITY = GROUP_WIDTH;
+
+    Entry* slots;
+    Ctrl* ctrl;
+    size_t filled_slots = 0;
+    size_t deleted_slots = 0;
+    uint8_t capacity_shift;
+
+    /**
+     * The key type must be derrived from `Object` because a low bit is used to
+     * encode a mark bit.
+     */
+    static constexpr uintptr_t MARK_MASK = Object::ALIGNMENT >> 1;
+
+    static_assert((MARK_MASK & ~Object::MASK) == 0);
+
+    template<typename>
+    struct inspect_entry_type : std::false_type
+    {};
+    template<typename K>
+    struct inspect_entry_type<K*> : std::true_type
+    {
+      static_assert(std::is_base_of_v<Object, K>);
+      using key_type = K;
+      using value_type = key_type*;
+      using entry_view = value_type;
+      static constexpr bool is_set = true;
+    };
+    template<typename K, typename V>
+    struct inspect_entry_type<std::pair<K*, V>> : std::true_type
+    {
+      static_assert(std::is_base_of_v<Object, K>);
+      using key_type = K;
+      using value_type = V;
+      using entry_view = std::pair<key_type*, V*>;
+      static constexpr bool is_set = false;
+    };
+
+    static_assert(
+      inspect_entry_type<Entry>(),
+      "Map Entry must be K* or std::pair<K*, V>"
+      " where K is derrived from Object");
+
+    using KeyType = typename inspect_entry_type<Entry>::key_type;
+    using ValueType = typename inspect_entry_type<Entry>::value_type;
+    using EntryView = typename inspect_entry_type<Entry>::entry_view;
+    static constexpr bool is_set = inspect_entry_type<Entry>::is_set;
+
+    /**
+     * Bit masks of the slots in a group of control bytes that match.
+     */
+    struct Group
+    {
+#ifdef VERONA_SWISSMAP_SSE2
+      __m128i bytes;
+
+      Group(const Ctrl* c) : bytes(_mm_loadu_si128((const __m128i*)c)) {}
+
+      uint32_t match(Ctrl h2) const
+      {
+        return (uint32_t)_mm_movemask_epi8(
+          _mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes));
+      }
+
+      /**
+       * Empty and deleted are the only negative control bytes.
+       */
+      uint32_t match_free() const
+      {
+        return (uint32_t)_mm_movemask_epi8(bytes);
+      }
+#else
+      const Ctrl* bytes;
+
+      Group(const Ctrl* c) : bytes(c) {}
+
+      uint32_t match(Ctrl h2) const
+      {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; i++)
+          mask |= (uint32_t)(bytes[i] == h2) << i;
+        return mask;
+      }
+
+      uint32_t match_free() const
+      {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; i++)
+          mask |= (uint32_t)(bytes[i] < 0) << i;
+        return mask;
+      }
+#endif
+
+      uint32_t match_empty() const
+      {
+        return match(EMPTY);
+      }
+    };
+
+    /**
+     * Return a reference to the entry key.
+     */
+    static uintptr_t& key_of(Entry& entry)
+    {
+      if constexpr (is_set)
+        return (uintptr_t&)entry;
+      else
+        return (uintptr_t&)std::get<0>(entry);
+    }
+
+    /**
+     * Return the original key value, where the low bits have been cleared.
+     */
+    static uintptr_t unmark_key(uintptr_t key)
+    {
+      return key & ~Object::MASK;
+    }
+
+    static size_t hash_of(uintptr_t key)
+    {
+      return bits::hash(((const Object*)key)->id());
+    }
+
+    /**
+     * The control byte for a key with the given hash.
+     */
+    static Ctrl h2(size_t hash)
+    {
+      return (Ctrl)(hash & 0x7f);
+    }
+
+    size_t group_mask() const
+    {
+      return (capacity() / GROUP_WIDTH) - 1;
+    }
+
+    /**
+     * The first group to probe for a key with the given hash.
+     */
+    size_t first_group(size_t hash) const
+    {
+      return (hash >> 7) & group_mask();
+    }
+
+    /**
+     * Allocate empty slots for `capacity` entries, which must be a power of two
+     * multiple of the group width.
+     */
+    void init_alloc(Alloc& alloc, size_t capacity = INIT_CAPACITY)
+    {
+      capacity_shift = (uint8_t)bits::ctz(capacity);
+      slots = (Entry*)alloc.alloc<YesZero>(capacity * sizeof(Entry));
+      ctrl = (Ctrl*)alloc.alloc(capacity);
+      std::memset(ctrl, EMPTY, capacity);
+      filled_slots = 0;
+      deleted_slots = 0;
+    }
+
+    void dealloc_slots(Alloc& alloc)
+    {
+      alloc.dealloc(slots, capacity() * sizeof(Entry));
+      alloc.dealloc(ctrl, capacity());
+    }
+
+    /**
+     * Reinsert all the entries into new slots, dropping the deleted slots.
+     * The capacity is doubled unless the deleted slots account for enough of
+     * the load to make room.
+     */
+    void rehash(Alloc& alloc)
+    {
+      auto new_capacity = capacity();
+      if ((filled_slots + 1) * 16 > new_capacity * 7)
+        new_capacity *= 2;
+
+      rehash(alloc, new_capacity);
+    }
+
+    /**
+     * Reinsert all the entries into `new_capacity` new slots, dropping the
+     * deleted slots.
+     */
+    void rehash(Alloc& alloc, size_t new_capacity)
+    {
+      auto prev_slots = slots;
+      auto prev_ctrl = ctrl;
+      auto prev_capacity = capacity();
+
+      init_alloc(alloc, new_capacity);
+
+      for (size_t i = 0; i < prev_capacity; i++)
+      {
+        if (prev_ctrl[i] < 0)
+          continue;
+
+        auto hash = hash_of(unmark_key(key_of(prev_slots[i])));
+        auto index = find_free(hash);
+        ctrl[index] = h2(hash);
+        new (&slots[index]) Entry(std::move(prev_slots[i]));
+        prev_slots[i].~Entry();
+        filled_slots++;
+      }
+
+      alloc.dealloc(prev_slots, prev_capacity * sizeof(Entry));
+      alloc.dealloc(prev_ctrl, prev_capacity);
+    }
+
+    /**
+     * Return the index of the first empty or deleted slot in the probe
+     * sequence for the given hash.
+     */
+    size_t find_free(size_t hash) const
+    {
+      auto group = first_group(hash);
+      for (size_t step = 1;; step++)
+      {
+        auto mask = Group(&ctrl[group * GROUP_WIDTH]).match_free();
+        if (mask != 0)
+          return (group * GROUP_WIDTH) + bits::ctz(mask);
+
+        group = (group + step) & group_mask();
+      }
+    }
+
+  public:
+    /**
+     * Iterator over the entries in a `SwissObjectMap`, starting from a slot
+     * index.
+     */
+    class Iterator
+    {
+      template<typename _Entry>
+      friend class SwissObjectMap;
+
+      const SwissObjectMap* map;
+      size_t index;
+
+      Entry& entry()
+      {
+        return map->slots[index];
+      }
+
+      Iterator(const SwissObjectMap* m, size_t i) : map(m), index(i) {}
+
+    public:
+      KeyType* key()
+      {
+        return (KeyType*)unmark_key(key_of(entry()));
+      }
+
+      template<bool v = !is_set, typename = typename std::enable_if_t<v>>
+      ValueType& value()
+      {
+        return entry().second;
+      }
+
+      bool is_marked()
+      {
+        return key_of(entry()) & MARK_MASK;
+      }
+
+      void mark()
+      {
+        key_of(entry()) |= MARK_MASK;
+      }
+
+      void unmark()
+      {
+        key_of(entry()) &= ~MARK_MASK;
+      }
+
+      EntryView operator*()
+      {
+        if constexpr (is_set)
+          return key();
+        else
+          return std::make_pair(key(), &value());
+      }
+
+      Iterator& operator++()
+      {
+        while (++index < map->capacity())
+        {
+          if (map->ctrl[index] >= 0)
+            break;
+        }
+        return *this;
+      }
+
+      bool operator==(const Iterator& other) const
+      {
+        return (index == other.index) && (map == other.map);
+      }
+
+      bool operator!=(const Iterator& other) const
+      {
+        return !(*this == other);
+      }
+    };
+
+    /**
+     * Create a `SwissObjectMap` with an initial capacity for 16 entries.
+     */
+    SwissObjectMap(Alloc& alloc)
+    {
+      init_alloc(alloc);
+    }
+
+    ~SwissObjectMap()
+    {
+      dealloc(ThreadAlloc::get());
+    }
+
+    static SwissObjectMap<Entry>* create(Alloc& alloc)
+    {
+      return new (alloc.alloc<sizeof(SwissObjectMap<Entry>)>())
+        SwissObjectMap(alloc);
+    }
+
+    void dealloc(Alloc& alloc)
+    {
+      clear(alloc, true);
+      dealloc_slots(alloc);
+    }
+
+    /**
+     * Return the amount of entries in this map.
+     */
+    size_t size() const
+    {
+      return filled_slots;
+    }
+
+    /**
+     * Return the capacity for entries in the map. The map resizes once it is
+     * 7/8 full, counting deleted slots.
+     */
+    size_t capacity() const
+    {
+      return ((size_t)1 << capacity_shift);
+    }
+
+    /**
+     * Grow the map, if needed, so that `count` entries fit without resizing
+     * one slot at a time.
+     */
+    void reserve(Alloc& alloc, size_t count)
+    {
+      auto new_capacity = capacity();
+      while ((count + 1) * 8 > new_capacity * 7)
+        new_capacity *= 2;
+
+      if (new_capacity != capacity())
+        rehash(alloc, new_capacity);
+    }
+
+    Iterator begin() const
+    {
+      auto it = Iterator(this, 0);
+      if (ctrl[0] < 0)
+        ++it;
+
+      return it;
+    }
+
+    Iterator end() const
+    {
+      return Iterator(this, capacity());
+    }
+
+    /**
+     * Find an entry in the map with the given key and return an iterator to the
+     * corresponding entry. If no entry exitsts, the return value will be equal
+     * to the return value of `end()`.
+     */
+    Iterator find(const KeyType* key) const
+    {
+      if (key == nullptr)
+        return end();
+
+      const auto hash = hash_of((uintptr_t)key);
+      auto group = first_group(hash);
+      for (size_t step = 1;; step++)
+      {
+        Group g(&ctrl[group * GROUP_WIDTH]);
+        for (auto mask = g.match(h2(hash)); mask != 0; mask &= mask - 1)
+        {
+          auto index = (group * GROUP_WIDTH) + bits::ctz(mask);
+          if (unmark_key(key_of(slots[index])) == (uintptr_t)key)
+            return Iterator(this, index);
+        }
+
+        if (g.match_empty() != 0)
+          return end();
+
+        group = (group + step) & group_mask();
+      }
+    }
+
+    /**
+     * Insert an entry into the map. The first element of the returned pair will
+     * be true if a new key is inserted, and false if an existing entry is
+     * updated. The second element of the returned pair is an iterator to the
+     * inserted entry. The key of the inserted entry must not be null.
+     */
+    template<typename E>
+    std::pair<bool, Iterator> insert(Alloc& alloc, E entry)
+    {
+      if (SNMALLOC_UNLIKELY(
+            (filled_slots + deleted_slots + 1) * 8 > capacity() * 7))
+        rehash(alloc);
+
+      assert(key_of(entry) != 0);
+      assert(!(key_of(entry) & MARK_MASK));
+      const auto key = unmark_key(key_of(entry));
+      const auto hash = hash_of(key);
+      auto group = first_group(hash);
+      auto slot = capacity();
+
+      for (size_t step = 1;; step++)
+      {
+        Group g(&ctrl[group * GROUP_WIDTH]);
+        for (auto mask = g.match(h2(hash)); mask != 0; mask &= mask - 1)
+        {
+          auto index = (group * GROUP_WIDTH) + bits::ctz(mask);
+          if (unmark_key(key_of(slots[index])) == key)
+          { // Update existing entry.
+            if constexpr (!is_set)
+              slots[index].second = std::forward<E>(entry).second;
+
+            return std::make_pair(false, Iterator(this, index));
+          }
+        }
+
+        // Remember the first free slot, in case the key is not found.
+        auto free_mask = g.match_free();
+        if ((slot == capacity()) && (free_mask != 0))
+          slot = (group * GROUP_WIDTH) + bits::ctz(free_mask);
+
+        // The key would have been placed in an earlier slot if there were
+        // any, so it is not in the map.
+        if (g.match_empty() != 0)
+          break;
+
+        group = (group + step) & group_mask();
+      }
+
+      if (ctrl[slot] == DELETED)
+        deleted_slots--;
+
+      ctrl[slot] = h2(hash);
+      slots[slot] = std::forward<E>(entry);
+      filled_slots++;
+      return std::make_pair(true, Iterator(this, slot));
+    }
+
+    /**
+     * Remove an entry from the map corresponding to the given key. The return
+     * value is false if no entry was found for the key and true otherwise.
+     */
+    bool erase(const KeyType* key)
+    {
+      auto it = find(key);
+      if (it == end())
+        return false;
+
+      erase(it);
+      return true;
+    }
+
+    /**
+     * Remove an entry from the map at the given iterator position. The iterator
+     * must be valid. This operation will not invalidate the iterator.
+     */
+    void erase(Iterator& it)
+    {
+      assert(ctrl[it.index] >= 0);
+
+      it.entry().~Entry();
+      key_of(it.entry()) = 0;
+      filled_slots--;
+
+      // Probes stop at the first group with an empty slot. If this group
+      // already has one, no probe for another key passes through it, so the
+      // slot can be emptied. Otherwise it needs a tombstone.
+      auto group = it.index & ~(GROUP_WIDTH - 1);
+      if (Group(&ctrl[group]).match_empty() != 0)
+      {
+        ctrl[it.index] = EMPTY;
+      }
+      else
+      {
+        ctrl[it.index] = DELETED;
+        deleted_slots++;
+      }
+    }
+
+    /**
+     * Empty the map, removing all entries. If skip_deallocate is false, the
+     * capacity will be reset to the initial allocation size. Resetting the
+     * allocation size may significantly improve iteration performance.
+     */
+    void clear(Alloc& alloc, bool skip_deallocate = false)
+    {
+      for (auto it = begin(); it != end(); ++it)
+      {
+        it.entry().~Entry();
+        key_of(it.entry()) = 0;
+      }
+
+      std::memset(ctrl, EMPTY, capacity());
+      filled_slots = 0;
+      deleted_slots = 0;
+
+      if (!skip_deallocate && (capacity() > INIT_CAPACITY))
+      {
+        dealloc_slots(alloc);
+        init_alloc(alloc);
+      }
+    }
+
+    /**
+     * Return a string representation of the map showing empty slots (`∅`),
+     * deleted slots (`†`), and key positions with their control bytes.
+     */
+    template<typename OutStream>
+    OutStream& debug_layout(OutStream& out) const
+    {
+      out << "{";
+      for (size_t i = 0; i < capacity(); i++)
+      {
+        if (ctrl[i] == EMPTY)
+        {
+          out << " ∅";
+          continue;
+        }
+        if (ctrl[i] == DELETED)
+        {
+          out << " †";
+          continue;
+        }
+        out << " (" << ((const KeyType*)unmark_key(key_of(slots[i])))->id()
+            << ", ctrl " << (size_t)ctrl[i] << ")";
+      }
+      out << " } cap: " << capacity();
+      return out;
+    }
+  };
+}
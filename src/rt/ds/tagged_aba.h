@@ -0,0 +1,95 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * ABA protection for a pointer using a single word compare and swap, with
+   * the same interface as `snmalloc::ABA`.
+   *
+   * The pointer is packed with a counter in its top `TAG_BITS` bits, which is
+   * incremented by every successful `store_conditional`. This requires that
+   * addresses fit in the remaining bits, as they do with 48-bit virtual
+   * address spaces, but not a double-word compare and swap, which
+   * `snmalloc::ABA` needs to be lock free.
+   *
+   * Unlike a double-word counter, the counter wraps around, so a thread
+   * that is held up between `read` and `store_conditional` for exactly a
+   * multiple of 2^TAG_BITS updates could succeed when it should have failed.
+   */
+  template<typename T>
+  class TaggedABA
+  {
+  private:
+    static constexpr size_t TAG_BITS = 16;
+    static constexpr size_t ADDRESS_BITS = (sizeof(uintptr_t) * 8) - TAG_BITS;
+    static constexpr uintptr_t ADDRESS_MASK = ((uintptr_t)1 << ADDRESS_BITS) - 1;
+
+    static_assert(sizeof(uintptr_t) == 8, "Tagging requires 64-bit pointers");
+
+    std::atomic<uintptr_t> word{0};
+
+    static uintptr_t pack(T* ptr, uintptr_t tag)
+    {
+      assert(((uintptr_t)ptr & ~ADDRESS_MASK) == 0);
+      return (uintptr_t)ptr | (tag << ADDRESS_BITS);
+    }
+
+    static T* address(uintptr_t w)
+    {
+      return (T*)(w & ADDRESS_MASK);
+    }
+
+  public:
+    class Cmp
+    {
+      friend TaggedABA;
+
+      TaggedABA* parent;
+      uintptr_t old;
+
+      Cmp(TaggedABA* parent, uintptr_t old) : parent(parent), old(old) {}
+
+    public:
+      T* ptr()
+      {
+        return address(old);
+      }
+
+      /**
+       * Store `value` if nothing has been stored since the last `read` or
+       * failed `store_conditional`. On failure, this refreshes `ptr()`.
+       */
+      bool store_conditional(T* value)
+      {
+        uintptr_t tag = (old >> ADDRESS_BITS) + 1;
+        return parent->word.compare_exchange_weak(
+          old,
+          pack(value, tag),
+          std::memory_order_acq_rel,
+          std::memory_order_relaxed);
+      }
+    };
+
+    void init(T* ptr)
+    {
+      word.store(pack(ptr, 0), std::memory_order_relaxed);
+    }
+
+    Cmp read()
+    {
+      return Cmp(this, word.load(std::memory_order_acquire));
+    }
+
+    T* peek()
+    {
+      return address(word.load(std::memory_order_relaxed));
+    }
+  };
+} // namespace verona::rt
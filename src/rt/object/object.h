@@ -8,6 +8,9 @@
 #include "../test/systematic.h"
 
 #include <snmalloc/snmalloc.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <xmmintrin.h>
+#endif
 
 namespace verona::rt
 {
@@ -114,11 +117,34 @@ namespace verona::rt
 
     using DestructorFunction = void (*)(Object* o);
 
+    // Only used by cowns. Called at the end of a batch of messages with the
+    // current batch limit. `hot` is true if the batch was cut short by the
+    // limit, and `contended` is true if other cowns are waiting to run on the
+    // same core. Returns the limit for the next batch.
+    using BatchLimitFunction =
+      size_t (*)(Object* o, size_t limit, bool hot, bool contended);
+
     size_t size;
     TraceFunction trace;
     FinalFunction finaliser;
     NotifiedFunction notified = nullptr;
     DestructorFunction destructor = nullptr;
+    BatchLimitFunction batch_limit = nullptr;
+
+    // If not zero, tracing an object reads its fields from this map instead
+    // of calling `trace`: bit i is set if the i-th pointer-sized word of the
+    // object is a field to push when it is not null. Only objects whose
+    // traced fields are all at fixed offsets in the first 64 words, and hold
+    // Verona objects or null, can have a map.
+    uintptr_t field_map = 0;
+
+    /// Returns the bit of `field_map` for the field at byte `offset`.
+    static constexpr uintptr_t field_bit(size_t offset)
+    {
+      assert(offset % sizeof(Object*) == 0);
+      assert(offset / sizeof(Object*) < sizeof(uintptr_t) * 8);
+      return (uintptr_t)1 << (offset / sizeof(Object*));
+    }
     // TODO: virtual dispatch, pattern matching on type, reflection
   };
 
@@ -285,6 +311,20 @@ namespace verona::rt
       return ((std::byte*)this) - sizeof(Header);
     }
 
+    /// Hint that the header of this object will be read soon. Loops that
+    /// chase rings or stacks of objects call this on the next object before
+    /// working on the current one, so that the cache misses overlap with the
+    /// work. Define `VERONA_NO_PREFETCH` to disable, e.g. to measure it.
+    inline void prefetch() const
+    {
+#if defined(VERONA_NO_PREFETCH)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      _mm_prefetch((const char*)real_start(), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(real_start());
+#endif
+    }
+
     Object(const Object&) = delete;
     Object& operator=(const Object&) = delete;
 
@@ -437,10 +477,14 @@ namespace verona::rt
     friend class RegionTrace;
     friend class RegionArena;
     friend class RegionRc;
+    friend class RegionHybrid;
+    friend class ParallelGC;
     friend class RememberedSet;
     friend class ExternalReferenceTable;
     template<typename Entry>
     friend class ObjectMap;
+    template<typename Entry>
+    friend class SwissObjectMap;
     friend class Message;
     friend class LocalEpoch;
     friend size_t debug_get_ref_count(Object* o);
@@ -654,6 +698,30 @@ namespace verona::rt
       get_header().bits |= (uint8_t)RegionMD::MARKED;
     }
 
+    /**
+     * Marks the object if it is unmarked, with an atomic operation so that
+     * several threads can mark the same region at once. Returns true if this
+     * call marked the object.
+     **/
+    inline bool mark_atomic()
+    {
+      auto& h = get_header().rc;
+      if ((h.load(std::memory_order_relaxed) & MASK) != RegionMD::UNMARKED)
+        return false;
+
+      size_t prev =
+        h.fetch_or((uint8_t)RegionMD::MARKED, std::memory_order_relaxed);
+      return (prev & MASK) == RegionMD::UNMARKED;
+    }
+
+    /**
+     * As `get_class`, for an object that other threads may `mark_atomic`.
+     **/
+    inline RegionMD get_class_atomic()
+    {
+      return (RegionMD)(get_header().rc.load(std::memory_order_relaxed) & MASK);
+    }
+
     inline void mark_iso()
     {
       assert(get_class() == RegionMD::ISO);
@@ -884,6 +952,11 @@ namespace verona::rt
       return get_descriptor()->destructor != nullptr;
     }
 
+    inline bool has_batch_limit()
+    {
+      return get_descriptor()->batch_limit != nullptr;
+    }
+
     static inline bool is_trivial(const Descriptor* desc)
     {
       return desc->destructor == nullptr && desc->finaliser == nullptr;
@@ -905,7 +978,21 @@ namespace verona::rt
   private:
     inline void trace(ObjectStack& f) const
     {
-      get_descriptor()->trace(this, f);
+      auto desc = get_descriptor();
+      if (desc->field_map != 0)
+      {
+        // No indirect call for objects with a field map.
+        Object* const* words = (Object* const*)this;
+        for (uintptr_t m = desc->field_map; m != 0; m &= m - 1)
+        {
+          Object* p = words[bits::ctz(m)];
+          if (p != nullptr)
+            f.push(p);
+        }
+        return;
+      }
+
+      desc->trace(this, f);
     }
 
     inline void finalise(Object* region, ObjectStack& isos)
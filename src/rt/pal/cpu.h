@@ -5,6 +5,7 @@
 #include <snmalloc/snmalloc.h>
 
 #if defined(__linux__)
+#  include <dirent.h>
 #  include <sched.h>
 #  include <stdio.h>
 #  include <stdlib.h>
@@ -29,6 +30,7 @@
 #endif
 
 #include <algorithm>
+#include <cstdlib>
 #include <functional>
 #include <vector>
 
@@ -37,6 +39,91 @@ namespace verona::rt
   using namespace snmalloc;
   class Topology
   {
+  public:
+    /**
+     * How far apart two CPUs are, from the point of view of sharing caches
+     * and memory.
+     */
+    enum Distance : uint8_t
+    {
+      // Hyperthreads of the same physical core.
+      SameCore,
+      // Different physical cores on the same NUMA node.
+      SameNode,
+      // Different NUMA nodes.
+      Remote
+    };
+
+    /**
+     * Which CPUs the scheduler threads are placed on. Thread `i` runs on the
+     * `i`th of the CPUs the placement allows, in the order of `get`, wrapping
+     * around if there are more threads than CPUs.
+     *
+     * Only the CPUs the process may run on are considered, so on Linux the
+     * cpuset of the process's cgroup, and any `taskset`, are respected.
+     */
+    struct Placement
+    {
+      /// If not empty, only these CPUs, as numbered by the operating system
+      /// (on Windows, 64 per processor group).
+      std::vector<size_t> cpus;
+      /// If false, only the first CPU of each physical core.
+      bool hyperthreads = true;
+      /// If not empty, only CPUs on these NUMA nodes.
+      std::vector<size_t> nodes;
+
+      /**
+       * The placement given by the environment variables `VERONA_CPUS` and
+       * `VERONA_NUMA_NODES`, lists such as `0-3,8-11`, and
+       * `VERONA_HYPERTHREADS`, which is `0` for one thread per physical core.
+       * Unset variables do not restrict the placement.
+       */
+      static Placement from_environment()
+      {
+        Placement p;
+        if (const char* s = getenv("VERONA_CPUS"))
+          parse_list(s, p.cpus);
+        if (const char* s = getenv("VERONA_NUMA_NODES"))
+          parse_list(s, p.nodes);
+        if (const char* s = getenv("VERONA_HYPERTHREADS"))
+          p.hyperthreads = atoi(s) != 0;
+        return p;
+      }
+    };
+
+    /**
+     * Append the numbers in `s` to `out`. The list holds numbers and ranges
+     * separated by commas, such as `0-3,8-11`, as in Linux's `cpulist`.
+     * Parsing stops at the first character that does not fit.
+     */
+    static void parse_list(const char* s, std::vector<size_t>& out)
+    {
+      while (true)
+      {
+        char* end;
+        size_t first = strtoul(s, &end, 10);
+        if (end == s)
+          return;
+        s = end;
+
+        size_t last = first;
+        if (*s == '-')
+        {
+          last = strtoul(s + 1, &end, 10);
+          if (end == s + 1)
+            return;
+          s = end;
+        }
+
+        for (size_t i = first; i <= last; i++)
+          out.push_back(i);
+
+        if (*s != ',')
+          return;
+        s++;
+      }
+    }
+
   private:
     struct CPU
     {
@@ -45,6 +132,8 @@ namespace verona::rt
       size_t group;
       size_t id;
       bool hyperthread;
+      // Identifies the physical core within the package.
+      size_t core;
 
       size_t get()
       {
@@ -87,7 +176,10 @@ namespace verona::rt
       }
     };
 
+    /// The CPUs allowed by the placement, sorted.
     std::vector<CPU> cpus;
+    /// Every CPU the process may run on, sorted.
+    std::vector<CPU> all;
 
 #if defined(CPU_COUNT) && defined(CPU_ISSET)
     template<typename CPUSet>
@@ -100,12 +192,13 @@ namespace verona::rt
       uint32_t index = 0;
       uint32_t found = 0;
 
-      // TODO: CPU topology detection for Linux
+      // TODO: CPU topology detection for FreeBSD. On Linux, the topology is
+      // read from sysfs afterwards, see `read_sysfs_topology`.
       while (found < count)
       {
         if (CPU_ISSET(index, &all_cpus))
         {
-          cpus.push_back(CPU{0, 0, 0, index, false});
+          cpus.push_back(CPU{0, 0, 0, index, false, index});
           found++;
         }
 
@@ -154,7 +247,8 @@ namespace verona::rt
                     get_package(group, id, package, package_count),
                     group,
                     id,
-                    hyperthread});
+                    hyperthread,
+                    i});
 
               hyperthread = true;
             }
@@ -171,6 +265,7 @@ namespace verona::rt
       top->get_cpuset<cpu_set_t>([](cpu_set_t& all_cpus) {
         sched_getaffinity(0, sizeof(cpu_set_t), &all_cpus);
       });
+      top->read_sysfs_topology();
 #elif defined(FreeBSD_KERNEL)
       top->get_cpuset<cpuset_t>(
         [](cpuset_t& all_cpus) { CPU_COPY(cpuset_root, &all_cpus); });
@@ -193,7 +288,7 @@ namespace verona::rt
         top->cpus.reserve(core_count);
         for (uint32_t index = 0; index < core_count; index++)
         {
-          top->cpus.push_back(CPU{0, 0, 0, index, false});
+          top->cpus.push_back(CPU{0, 0, 0, index, false, index});
         }
       }
 #else
@@ -201,6 +296,33 @@ namespace verona::rt
 #endif
 
       std::sort(top->cpus.begin(), top->cpus.end());
+      top->all = top->cpus;
+      if (top->all.size() != 0)
+        top->set_placement(Placement::from_environment());
+    }
+
+    /**
+     * Restrict the CPUs returned by `get` to those allowed by `placement`.
+     * This aborts if it allows none of the CPUs the process may run on.
+     */
+    void set_placement(const Placement& placement)
+    {
+      auto contains = [](const std::vector<size_t>& v, size_t x) {
+        return v.empty() || (std::find(v.begin(), v.end(), x) != v.end());
+      };
+
+      cpus.clear();
+      for (auto& c : all)
+      {
+        if (
+          (placement.hyperthreads || !c.hyperthread) &&
+          contains(placement.cpus, c.get()) &&
+          contains(placement.nodes, c.numa_node))
+          cpus.push_back(c);
+      }
+
+      if (cpus.size() == 0)
+        abort();
     }
 
     size_t get(size_t index)
@@ -220,7 +342,166 @@ namespace verona::rt
       return cpus.size();
     }
 
+    /// The NUMA node of a CPU given by a value returned from `get`.
+    size_t numa_node(size_t cpu)
+    {
+      return find(cpu).numa_node;
+    }
+
+    /// The NUMA node of any CPU of the machine, such as one returned by
+    /// `cpu::current`, or `otherwise` if it is not known.
+    size_t numa_node_of(size_t cpu, size_t otherwise)
+    {
+      for (auto& c : all)
+      {
+        if (c.get() == cpu)
+          return c.numa_node;
+      }
+      return otherwise;
+    }
+
+    /**
+     * Returns the distance between two CPUs given by the values returned from
+     * `get`.
+     */
+    Distance distance(size_t a, size_t b)
+    {
+      const CPU& x = find(a);
+      const CPU& y = find(b);
+
+      if ((x.package == y.package) && (x.core == y.core))
+        return SameCore;
+
+      if (x.numa_node == y.numa_node)
+        return SameNode;
+
+      return Remote;
+    }
+
   private:
+    const CPU& find(size_t cpu)
+    {
+      for (auto& c : all)
+      {
+        if (c.get() == cpu)
+          return c;
+      }
+      abort();
+    }
+
+#if defined(__linux__)
+    static size_t read_sysfs(const char* format, size_t cpu, size_t otherwise)
+    {
+      char path[128];
+      snprintf(path, sizeof(path), format, cpu);
+      FILE* f = fopen(path, "r");
+      if (f == nullptr)
+        return otherwise;
+
+      size_t value;
+      if (fscanf(f, "%zu", &value) != 1)
+        value = otherwise;
+      fclose(f);
+      return value;
+    }
+
+    /**
+     * Set `nodes[cpu]` to the NUMA node of each CPU listed in the `cpulist`
+     * of a node in `/sys/devices/system/node`, which holds ranges such as
+     * `0-3,8-11`. CPUs that are not listed are left as `(size_t)-1`.
+     */
+    static void read_node_cpulists(std::vector<size_t>& nodes)
+    {
+      DIR* dir = opendir("/sys/devices/system/node");
+      if (dir == nullptr)
+        return;
+
+      while (struct dirent* entry = readdir(dir))
+      {
+        size_t node;
+        if (sscanf(entry->d_name, "node%zu", &node) != 1)
+          continue;
+
+        char path[128];
+        snprintf(
+          path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node);
+        FILE* f = fopen(path, "r");
+        if (f == nullptr)
+          continue;
+
+        char line[4096];
+        std::vector<size_t> list;
+        if (fgets(line, sizeof(line), f) != nullptr)
+          parse_list(line, list);
+        fclose(f);
+
+        for (size_t cpu : list)
+        {
+          if (cpu >= nodes.size())
+            nodes.resize(cpu + 1, (size_t)-1);
+          nodes[cpu] = node;
+        }
+      }
+      closedir(dir);
+    }
+
+    static size_t read_numa_node(size_t cpu)
+    {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%zu", cpu);
+      DIR* dir = opendir(path);
+      if (dir == nullptr)
+        return 0;
+
+      // The CPU directory contains a link to its NUMA node.
+      size_t node = 0;
+      while (struct dirent* entry = readdir(dir))
+      {
+        if (sscanf(entry->d_name, "node%zu", &node) == 1)
+          break;
+      }
+      closedir(dir);
+      return node;
+    }
+
+    void read_sysfs_topology()
+    {
+      // The node directories list their CPUs even where the CPU directories
+      // do not link to their node, so prefer them.
+      std::vector<size_t> nodes;
+      read_node_cpulists(nodes);
+
+      for (auto& cpu : cpus)
+      {
+        if ((cpu.id < nodes.size()) && (nodes[cpu.id] != (size_t)-1))
+          cpu.numa_node = nodes[cpu.id];
+        else
+          cpu.numa_node = read_numa_node(cpu.id);
+        cpu.package = read_sysfs(
+          "/sys/devices/system/cpu/cpu%zu/topology/physical_package_id",
+          cpu.id,
+          0);
+        cpu.core = read_sysfs(
+          "/sys/devices/system/cpu/cpu%zu/topology/core_id", cpu.id, cpu.id);
+      }
+
+      // Every CPU after the first on a physical core is a hyperthread.
+      for (size_t i = 0; i < cpus.size(); i++)
+      {
+        for (size_t j = 0; j < i; j++)
+        {
+          if (
+            (cpus[i].package == cpus[j].package) &&
+            (cpus[i].core == cpus[j].core))
+          {
+            cpus[i].hyperthread = true;
+            break;
+          }
+        }
+      }
+    }
+#endif
+
 #ifdef _WIN32
     static PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX
     get_info(LOGICAL_PROCESSOR_RELATIONSHIP relation, size_t& count)
@@ -322,6 +603,22 @@ namespace verona::rt
 
   namespace cpu
   {
+    /// The CPU that this thread is running on, numbered as for
+    /// `set_affinity`, or (size_t)-1 if it is not known.
+    inline size_t current()
+    {
+#if defined(_WIN32)
+      PROCESSOR_NUMBER n;
+      GetCurrentProcessorNumberEx(&n);
+      return (size_t)n.Group * 64 + n.Number;
+#elif defined(__linux__)
+      int cpu = sched_getcpu();
+      return cpu < 0 ? (size_t)-1 : (size_t)cpu;
+#else
+      return (size_t)-1;
+#endif
+    }
+
     inline void set_affinity(size_t affinity)
     {
       if (affinity == (size_t)-1)
@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#if defined(__linux__)
+
+#  include "../sched/eventpoller.h"
+
+#  include <cerrno>
+#  include <cstdint>
+#  include <stdexcept>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+
+namespace verona::rt::pal
+{
+  /**
+   * An `EventPoller` over an epoll set.
+   *
+   * Each file descriptor is registered with a handler, which is called on
+   * the polling scheduler thread when the descriptor is ready. A handler
+   * typically schedules a behaviour on the cown that owns the descriptor.
+   */
+  class EpollPoller : public EventPoller
+  {
+  public:
+    /// Called with the registered `data` and the ready epoll events.
+    using Handler = void (*)(void* data, uint32_t events);
+
+    /**
+     * A registration, which must stay alive until it is removed.
+     */
+    struct Registration
+    {
+      int fd;
+      Handler handler;
+      void* data;
+    };
+
+  private:
+    static constexpr int MAX_EVENTS = 64;
+
+    int epfd;
+    int wakefd;
+
+  public:
+    EpollPoller()
+    {
+      epfd = epoll_create1(EPOLL_CLOEXEC);
+      wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if ((epfd < 0) || (wakefd < 0))
+        throw std::runtime_error("Failed to create epoll set");
+
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.ptr = nullptr;
+      epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev);
+    }
+
+    ~EpollPoller() override
+    {
+      close(wakefd);
+      close(epfd);
+    }
+
+    /**
+     * Register `r` for `events`. Returns false, with `errno` set, on failure.
+     */
+    bool add(Registration* r, uint32_t events)
+    {
+      return ctl(EPOLL_CTL_ADD, r, events);
+    }
+
+    bool modify(Registration* r, uint32_t events)
+    {
+      return ctl(EPOLL_CTL_MOD, r, events);
+    }
+
+    bool remove(Registration* r)
+    {
+      return epoll_ctl(epfd, EPOLL_CTL_DEL, r->fd, nullptr) == 0;
+    }
+
+    size_t poll(int timeout_ms) override
+    {
+      epoll_event events[MAX_EVENTS];
+      int n = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+      if (n < 0)
+        return 0;
+
+      size_t dispatched = 0;
+      for (int i = 0; i < n; i++)
+      {
+        auto r = static_cast<Registration*>(events[i].data.ptr);
+        if (r == nullptr)
+        {
+          uint64_t count;
+          while (read(wakefd, &count, sizeof(count)) > 0)
+          {}
+          continue;
+        }
+        r->handler(r->data, events[i].events);
+        dispatched++;
+      }
+      return dispatched;
+    }
+
+    void wake() override
+    {
+      uint64_t one = 1;
+      // Only fails if the counter would overflow, and it is then non-zero.
+      (void)!write(wakefd, &one, sizeof(one));
+    }
+
+  private:
+    bool ctl(int op, Registration* r, uint32_t events)
+    {
+      epoll_event ev{};
+      ev.events = events;
+      ev.data.ptr = r;
+      return epoll_ctl(epfd, op, r->fd, &ev) == 0;
+    }
+  };
+} // namespace verona::rt::pal
+
+#endif
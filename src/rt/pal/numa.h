@@ -0,0 +1,130 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <snmalloc/snmalloc.h>
+
+#if defined(__linux__)
+#  include <linux/mempolicy.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#elif defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+
+/**
+ * Placement of memory on NUMA nodes, as numbered by `Topology`. On platforms
+ * without NUMA support the memory is allocated, but not placed.
+ */
+namespace verona::rt::numa
+{
+#if defined(__linux__)
+  /// Nodes that `mbind` is given a mask for.
+  static constexpr size_t MAX_NODES = 1024;
+
+  /// Set the policy of the pages of `[p, p + size)`, which must be page
+  /// aligned, to prefer `node`.
+  inline void bind(void* p, size_t size, size_t node, unsigned flags)
+  {
+    if (node >= MAX_NODES)
+      return;
+
+    constexpr size_t bits = sizeof(unsigned long) * 8;
+    unsigned long mask[MAX_NODES / bits] = {};
+    mask[node / bits] = 1UL << (node % bits);
+    // Errors, such as a kernel without NUMA support, leave the memory
+    // where it is.
+    syscall(SYS_mbind, p, size, MPOL_PREFERRED, mask, MAX_NODES + 1, flags);
+  }
+#endif
+
+  inline size_t page_size()
+  {
+#if defined(__linux__)
+    return (size_t)sysconf(_SC_PAGESIZE);
+#elif defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return 4096;
+#endif
+  }
+
+  /**
+   * Allocate `size` bytes whose pages are on `node`, for objects that live
+   * as long as the runtime, such as the `Core`s. The memory is page aligned
+   * and must be freed with `dealloc`.
+   */
+  inline void* alloc(size_t size, size_t node)
+  {
+#if defined(__linux__)
+    void* p = mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+    if (p == MAP_FAILED)
+      abort();
+
+    // Nothing has touched the pages yet, so none need moving.
+    bind(p, size, node, 0);
+    return p;
+#elif defined(_WIN32)
+    void* p = VirtualAllocExNuma(
+      GetCurrentProcess(),
+      nullptr,
+      size,
+      MEM_RESERVE | MEM_COMMIT,
+      PAGE_READWRITE,
+      (DWORD)node);
+    if (p == nullptr)
+      abort();
+    return p;
+#else
+    snmalloc::UNUSED(node);
+    return ::operator new(size, std::align_val_t(page_size()));
+#endif
+  }
+
+  inline void dealloc(void* p, size_t size)
+  {
+#if defined(__linux__)
+    munmap(p, size);
+#elif defined(_WIN32)
+    snmalloc::UNUSED(size);
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    snmalloc::UNUSED(size);
+    ::operator delete(p, std::align_val_t(page_size()));
+#endif
+  }
+
+  /**
+   * Move the pages that lie entirely within `[p, p + size)` to `node`. The
+   * pages that are only partly covered may hold other objects, so they are
+   * left where they are, and objects smaller than a page are not moved.
+   */
+  inline void place(void* p, size_t size, size_t node)
+  {
+#if defined(__linux__)
+    uintptr_t page = page_size();
+    uintptr_t start = ((uintptr_t)p + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)p + size) & ~(page - 1);
+    if (start < end)
+      bind((void*)start, end - start, node, MPOL_MF_MOVE);
+#else
+    snmalloc::UNUSED(p, size, node);
+#endif
+  }
+} // namespace verona::rt::numa
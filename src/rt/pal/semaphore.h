@@ -13,6 +13,7 @@
 /**
  * This constructs a platform specific semaphore.
  */
+#  include <chrono>
 #  if __has_include(<version>)
 #    include <version>
 #  endif
@@ -34,6 +35,11 @@ namespace verona::rt::pal
     {
       semaphore_.acquire();
     }
+
+    bool try_acquire_for(std::chrono::nanoseconds timeout)
+    {
+      return semaphore_.try_acquire_for(timeout);
+    }
   };
 } // namespace verona::rt::pal
 #  elif defined(__APPLE__)
@@ -64,6 +70,13 @@ namespace verona::rt::pal
     {
       dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER);
     }
+
+    bool try_acquire_for(std::chrono::nanoseconds timeout)
+    {
+      return dispatch_semaphore_wait(
+               semaphore_,
+               dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeout.count())) == 0;
+    }
   };
 } // namespace verona::rt::pal
 #  elif defined(WIN32)
@@ -94,10 +107,19 @@ namespace verona::rt::pal
     {
       WaitForSingleObject(semaphore_, INFINITE);
     }
+
+    bool try_acquire_for(std::chrono::nanoseconds timeout)
+    {
+      auto ms =
+        std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+      return WaitForSingleObject(semaphore_, (DWORD)ms) == WAIT_OBJECT_0;
+    }
   };
 } // namespace verona::rt::pal
 #  elif __has_include(<semaphore.h>)
 // Use Posix semaphores
+#    include <cerrno>
+#    include <ctime>
 #    include <semaphore.h>
 namespace verona::rt::pal
 {
@@ -155,6 +177,28 @@ namespace verona::rt::pal
         }
       }
     }
+
+    bool try_acquire_for(std::chrono::nanoseconds timeout)
+    {
+      // sem_timedwait takes an absolute time on the realtime clock.
+      timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      auto ns = (uint64_t)deadline.tv_nsec + (uint64_t)timeout.count();
+      deadline.tv_sec += (time_t)(ns / 1'000'000'000);
+      deadline.tv_nsec = (long)(ns % 1'000'000'000);
+
+      while (true)
+      {
+        if (sem_timedwait(&semaphore_, &deadline) == 0)
+          return true;
+        if (errno == EINTR)
+          continue;
+        if (errno == ETIMEDOUT)
+          return false;
+        // Failed to acquire semaphore.
+        abort();
+      }
+    }
   };
 } // namespace verona::rt::pal
 #  else
@@ -193,6 +237,27 @@ namespace verona::rt::pal
 #  endif
     }
 
+    /**
+     * Like `sleep`, but gives up after `timeout`. Returns true if woken.
+     *
+     * A call to `wake` that races with the timeout is not lost, but ends the
+     * next call to `sleep`.
+     */
+    bool sleep_for(std::chrono::nanoseconds timeout)
+    {
+#  ifndef NDEBUG
+      assert(!sleeper);
+      sleeper = true;
+#  endif
+      bool woken = sem.try_acquire_for(timeout);
+#  ifndef NDEBUG
+      if (woken)
+        waker = false;
+      sleeper = false;
+#  endif
+      return woken;
+    }
+
     /**
      * Used to wake a thread from sleep.
      *
@@ -4,28 +4,70 @@
 
 #include "threading.h"
 
+#include <functional>
 #include <list>
+#include <vector>
 
 /**
  * This constructs a platforms affinitised set of threads.
+ *
+ * The threads are started as a tree: the calling thread starts the first
+ * `FAN_OUT` threads, and each started thread starts the next `FAN_OUT`
+ * before running its body, pinned to its CPU. This brings a large pool up in
+ * logarithmic rather than linear time, as thread creation, pinning and the
+ * allocator's per-thread initialisation run in parallel. Each thread joins
+ * the threads it started once its body returns.
  */
 namespace verona::rt
 {
   class ThreadPoolBuilder
   {
-    std::list<PlatformThread> threads;
+    static constexpr size_t FAN_OUT = 2;
+
+    /// Bodies of the threads to start, bound to their arguments.
+    std::vector<std::function<void()>> bodies;
+    /// The threads started by each thread, indexed as `bodies`, with the
+    /// calling thread last. Each entry is only used by its own thread.
+    std::vector<std::list<PlatformThread>> started;
     size_t thread_count;
     size_t index = 0;
 
+    /// Start the threads below `parent` in the tree, where the calling
+    /// thread is `thread_count`.
+    void start_children(size_t parent)
+    {
+      size_t first = parent == thread_count ? 0 : (parent + 1) * FAN_OUT;
+      for (size_t i = first; (i < first + FAN_OUT) && (i < thread_count); i++)
+        started[parent].emplace_back(&run_node, this, i);
+    }
+
+    void join_children(size_t parent)
+    {
+      auto& threads = started[parent];
+      while (!threads.empty())
+      {
+        threads.front().join();
+        threads.pop_front();
+      }
+    }
+
+    static void run_node(ThreadPoolBuilder* builder, size_t i)
+    {
+      builder->start_children(i);
+      builder->bodies[i]();
+      builder->join_children(i);
+    }
+
     template<typename... Args>
     void add_thread_impl(void (*body)(Args...), Args... args)
     {
       if (index != thread_count)
       {
-        threads.emplace_back(body, args...);
+        bodies.emplace_back([=]() { body(args...); });
       }
       else
       {
+        start_children(thread_count);
         Systematic::start();
         body(args...);
       }
@@ -43,10 +85,13 @@ namespace verona::rt
     ThreadPoolBuilder(size_t thread_count)
     {
       this->thread_count = thread_count - 1;
+      bodies.reserve(this->thread_count);
+      started.resize(thread_count);
     }
 
     /**
-     * Add a thread to run in this thread pool.
+     * Add a thread to run in this thread pool. The threads start once the
+     * last one is added, which runs on the calling thread.
      */
     template<typename... Args>
     void add_thread(size_t affinity, void (*body)(Args...), Args... args)
@@ -74,12 +119,7 @@ namespace verona::rt
     {
       assert(index == thread_count + 1);
 
-      while (!threads.empty())
-      {
-        auto& thread = threads.front();
-        thread.join();
-        threads.pop_front();
-      }
+      join_children(thread_count);
     }
   };
 }
@@ -87,6 +87,24 @@ namespace verona::rt
         return new (obj) ExternalRef(ert, o);
       }
 
+      /**
+       * Create external references to `count` objects in `region`, writing
+       * them to `refs`. This is the same as calling `create` on each object,
+       * but the table only grows once.
+       */
+      static void create(
+        ExternalReferenceTable* ert,
+        Object** objects,
+        size_t count,
+        ExternalRef** refs)
+      {
+        ert->external_map->reserve(
+          ThreadAlloc::get(), ert->external_map->size() + count);
+
+        for (size_t i = 0; i < count; i++)
+          refs[i] = create(ert, objects[i]);
+      }
+
       /**
        * May only be called when `is_in` returns `true`.
        */
@@ -108,7 +126,8 @@ namespace verona::rt
     // No tracing is need for external_map, because entries in the map doesn't
     // contribute to objects RC; when an object is collected, its corresponding
     // entry in the map (if any) is removed as well.
-    using ExternalMap = ObjectMap<std::pair<Object*, ExternalRef*>>;
+    using ExternalMap =
+      DefaultObjectMap<std::pair<Object*, ExternalRef*>>;
 
     ExternalMap* external_map;
 
@@ -119,20 +138,45 @@ namespace verona::rt
 
     void dealloc(Alloc& alloc)
     {
-      for (auto it = external_map->begin(); it != external_map->end(); ++it)
-        remove_ref(alloc, it);
+      if (has_external_references())
+      {
+        for (auto it = external_map->begin(); it != external_map->end(); ++it)
+          remove_ref(alloc, it);
+      }
 
       external_map->dealloc(alloc);
       alloc.dealloc<sizeof(ExternalMap)>(external_map);
     }
 
+    bool has_external_references()
+    {
+      return external_map->size() != 0;
+    }
+
     void merge(Alloc& alloc, ExternalReferenceTable* that)
     {
+      // Most regions have no external references, so avoid walking the table.
+      if (!that->has_external_references())
+        return;
+
       for (auto e : *that->external_map)
       {
         auto* ext_ref = *e.second;
         assert(ext_ref->o);
         ext_ref->ert.store(this, std::memory_order_relaxed);
+      }
+
+      // Keep the larger of the two maps, so that only the entries of the
+      // smaller one are rehashed. Whichever map ends up in `that` is emptied
+      // of references, so deallocating it doesn't release them.
+      if (external_map->size() < that->external_map->size())
+        std::swap(external_map, that->external_map);
+
+      external_map->reserve(
+        alloc, external_map->size() + that->external_map->size());
+      for (auto e : *that->external_map)
+      {
+        auto* ext_ref = *e.second;
         *e.second = nullptr;
         insert(alloc, e.first, ext_ref);
       }
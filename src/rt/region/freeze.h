@@ -4,6 +4,9 @@
 
 #include "region.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace verona::rt
 {
   /**!freeze.md
@@ -116,9 +119,17 @@ namespace verona::rt
    * region. Rather than copy the set up front, we lazily construct it using the
    * ring in the isolated regions. Every time we break the ring, we keep track
    * of that point in the objects stack.
+   *
+   * Each entry of the objects stack starts a sublist of the ring, which runs
+   * through unreachable objects until it reaches one that was visited. The
+   * sublists are disjoint, so `ParallelFreeze` sweeps them on several threads
+   * at once. The SCC computation itself is a single depth-first search, and
+   * stays on one thread.
    */
   class Freeze
   {
+    friend class ParallelFreeze;
+
   private:
     static Object* post_order_mark(Object* o)
     {
@@ -130,217 +141,371 @@ namespace verona::rt
       return (Object*)(((uintptr_t)o) & ~(uintptr_t)1);
     }
 
-  public:
-    static void apply(Alloc& alloc, Object* o)
+    /**
+     * Prepares the region of the Iso object `p` for freezing, and pushes the
+     * heads of its rings onto `objects`.
+     */
+    template<typename Objects>
+    static RegionTrace* open_region(Alloc& alloc, Object* p, Objects& objects)
     {
-      assert(o->debug_is_iso());
+      assert(p->debug_is_iso());
 
-      ObjectStack objects(alloc);
-      ObjectStack dfs(alloc);
-      ObjectStack iso(alloc);
-      ObjectStack pending(alloc);
-      ObjectStack dealloc_regions(alloc);
+      // TODO(region): Right now we can only freeze trace regions. We'll
+      // probably need different strategies if we want to freeze other kinds
+      // of regions, e.g. copying objects out of an arena region.
+      assert(RegionTrace::is_trace_region(p->get_region()));
+      RegionTrace* reg = RegionTrace::get(p);
+      reg->gc_settle(alloc);
 
-      iso.push(o);
+      // Drop the ISO mark on the entry point.
+      p->init_next(reg);
 
-      while (!iso.empty())
-      {
-        assert(objects.empty());
-        assert(dfs.empty());
+      // Add the finaliser, and non-finaliser rings to objects.
+      objects.push(reg->next_not_root);
+      objects.push(reg->get_next());
 
-        Object* p = iso.pop();
-        assert(p->debug_is_iso());
-
-        // TODO(region): Right now we can only freeze trace regions. We'll
-        // probably need different strategies if we want to freeze other kinds
-        // of regions, e.g. copying objects out of an arena region.
-        assert(RegionTrace::is_trace_region(p->get_region()));
-        RegionTrace* reg = RegionTrace::get(p);
+      // Mark region metadata object, so sweeping does not travel through it.
+      reg->Object::mark();
+      return reg;
+    }
 
-        // Drop the ISO mark on the entry point.
-        p->init_next(reg);
+    /**
+     * Computes the SCCs of the objects reachable from `p`, the entry point of
+     * a region opened with `open_region`. The heads of the sublists of the
+     * rings are pushed onto `objects`, and the Iso objects of subregions onto
+     * `iso`.
+     */
+    template<typename Objects>
+    static void scc(Alloc& alloc, Object* p, Objects& objects, ObjectStack& iso)
+    {
+      ObjectStack dfs(alloc);
+      ObjectStack pending(alloc);
 
-        // Start with the graph entry point.
-        dfs.push(p);
+      // Start with the graph entry point.
+      dfs.push(p);
 
-        // Add the finaliser, and non-finaliser rings to objects.
-        objects.push(reg->next_not_root);
-        objects.push(reg->get_next());
+      while (!dfs.empty())
+      {
+        Object::RegionMD c;
 
-        // Mark region metadata object, so sweeping does not travel through it.
-        reg->Object::mark();
+        // Depth-first search has reached vertex q.
+        // This may be either a pre-order and post-order visit
+        Object* q_mark = dfs.pop();
+        Object* q = remove_post_order_mark(q_mark);
 
-        while (!dfs.empty())
+        if (q != q_mark)
         {
-          Object::RegionMD c;
-
-          // Depth-first search has reached vertex q.
-          // This may be either a pre-order and post-order visit
-          Object* q_mark = dfs.pop();
-          Object* q = remove_post_order_mark(q_mark);
-
-          if (q != q_mark)
+          // Finished this part of the spanning tree
+          // If this is the head of the pending list, this means we have
+          // processed all children in the spanning tree and this should now
+          // be turned into a complete SCC with ref count 1.
+          if (q == pending.peek())
           {
-            // Finished this part of the spanning tree
-            // If this is the head of the pending list, this means we have
-            // processed all children in the spanning tree and this should now
-            // be turned into a complete SCC with ref count 1.
-            if (q == pending.peek())
-            {
-              pending.pop();
-              q->root_and_class(c)->make_nonatomic_scc();
-              assert(c == Object::PENDING);
-            }
-            continue;
+            pending.pop();
+            q->root_and_class(c)->make_nonatomic_scc();
+            assert(c == Object::PENDING);
           }
+          continue;
+        }
 
-          auto r = q->root_and_class(c);
+        auto r = q->root_and_class(c);
 
-          switch (c)
+        switch (c)
+        {
+          case Object::PENDING:
           {
-            case Object::PENDING:
+            // We have found a reference back into one of the SCCs
+            // on the current path.  Collapse the path by unioning
+            // all the nodes up to that SCC.
+            auto rank = r->pending_rank();
+            while (r != (p = pending.peek()->root_and_class(c)))
             {
-              // We have found a reference back into one of the SCCs
-              // on the current path.  Collapse the path by unioning
-              // all the nodes up to that SCC.
-              auto rank = r->pending_rank();
-              while (r != (p = pending.peek()->root_and_class(c)))
+              assert(c == Object::PENDING);
+              // Rank used to keep the union/find data structure balanced
+              auto p_rank = p->pending_rank();
+              if (p_rank <= rank)
               {
-                assert(c == Object::PENDING);
-                // Rank used to keep the union/find data structure balanced
-                auto p_rank = p->pending_rank();
-                if (p_rank <= rank)
-                {
-                  p->set_scc(r);
-                  if (p_rank == rank)
-                    r->set_pending_rank(++rank);
-                }
-                else
-                {
-                  r->set_scc(p);
-                  rank = p_rank;
-                  r = p;
-                }
-                pending.pop();
+                p->set_scc(r);
+                if (p_rank == rank)
+                  r->set_pending_rank(++rank);
               }
-              break;
-            }
-
-            case Object::ISO:
-            {
-              // External Iso, process that later.
-              iso.push(q);
-              break;
+              else
+              {
+                r->set_scc(p);
+                rank = p_rank;
+                r = p;
+              }
+              pending.pop();
             }
+            break;
+          }
 
-            case Object::RC:
-            case Object::COWN:
-            {
-              Logging::cout()
-                << "External reference during freeze: " << r << Logging::endl;
-              // External reference
-              r->incref();
-              break;
-            }
+          case Object::ISO:
+          {
+            // External Iso, process that later.
+            iso.push(q);
+            break;
+          }
 
-            case Object::NONATOMIC_RC:
-            {
-              // Reference to an already complete SCC, so incref it.
-              r->incref_nonatomic();
-              break;
-            }
+          case Object::RC:
+          case Object::COWN:
+          {
+            Logging::cout()
+              << "External reference during freeze: " << r << Logging::endl;
+            // External reference
+            r->incref();
+            break;
+          }
 
-            case Object::UNMARKED:
-            {
-              // Lazily construct stack of sublists for gcing
-              objects.push(q->get_next());
-              // Clear the `has_ext_ref` bit.
-              q->clear_has_ext_ref();
-              // Add this to the current path we are exploring
-              q->set_pending();
-              pending.push(q);
-              // Push post-order mark, so we can revisit once subtree complete
-              dfs.push(post_order_mark(q));
-              // Add all the fields to the dfs
-              q->trace(dfs);
-              break;
-            }
+          case Object::NONATOMIC_RC:
+          {
+            // Reference to an already complete SCC, so incref it.
+            r->incref_nonatomic();
+            break;
+          }
 
-            default:
-              assert(0);
+          case Object::UNMARKED:
+          {
+            // Lazily construct stack of sublists for gcing
+            objects.push(q->get_next());
+            // Clear the `has_ext_ref` bit.
+            q->clear_has_ext_ref();
+            // Add this to the current path we are exploring
+            q->set_pending();
+            pending.push(q);
+            // Push post-order mark, so we can revisit once subtree complete
+            dfs.push(post_order_mark(q));
+            // Add all the fields to the dfs
+            q->trace(dfs);
+            break;
           }
+
+          default:
+            assert(0);
         }
+      }
+    }
 
-        // Finalise all the objects
-        // Move non-atomics to atomics
-        // Calculate list of things to be deallocated
-        LinkedObjectStack to_dealloc;
-        p = objects.pop();
-        while (true)
+    /**
+     * Walks the sublist of a ring starting at `p`. Unreachable objects are
+     * finalised and pushed onto `to_dealloc`, and the SCC root that ends the
+     * sublist, if any, is moved to atomic reference counting.
+     */
+    static void sweep_sublist(
+      Alloc& alloc,
+      Object* p,
+      RegionTrace* reg,
+      LinkedObjectStack& to_dealloc,
+      ObjectStack& dealloc_regions)
+    {
+      UNUSED(reg);
+      while (true)
+      {
+        switch (p->get_class())
         {
-          switch (p->get_class())
+          case Object::UNMARKED:
           {
-            case Object::UNMARKED:
-            {
-              // Node was unreachable deallocate it
-              auto next = p->get_next();
-
-              assert(p != reg);
+            // Node was unreachable deallocate it
+            auto next = p->get_next();
 
-              // ISO marker has been dropped on entry point, so
-              // can pass nullptr here.
-              p->finalise(nullptr, dealloc_regions);
-              to_dealloc.push(p);
-              // Deallocate unreachable sub-regions
-              while (!dealloc_regions.empty())
-              {
-                Object* q = dealloc_regions.pop();
-                Region::release(alloc, q);
-              }
+            assert(p != reg);
 
-              p = next;
-              continue;
-            }
-
-            case Object::NONATOMIC_RC:
+            // ISO marker has been dropped on entry point, so
+            // can pass nullptr here.
+            p->finalise(nullptr, dealloc_regions);
+            to_dealloc.push(p);
+            // Deallocate unreachable sub-regions
+            while (!dealloc_regions.empty())
             {
-              // Convert to atomic rc to allow sharing.
-              p->make_atomic();
-              break;
+              Object* q = dealloc_regions.pop();
+              Region::release(alloc, q);
             }
 
-            case Object::MARKED:
-              assert(p == reg);
-
-            case Object::RC:
-            case Object::SCC_PTR:
-              break;
+            p = next;
+            continue;
+          }
 
-            default:
-              assert(0);
+          case Object::NONATOMIC_RC:
+          {
+            // Convert to atomic rc to allow sharing.
+            p->make_atomic();
+            break;
           }
 
-          if (objects.empty())
+          case Object::MARKED:
+            assert(p == reg);
+
+          case Object::RC:
+          case Object::SCC_PTR:
             break;
 
-          p = objects.pop();
+          default:
+            assert(0);
         }
 
+        return;
+      }
+    }
+
+    static void dealloc_objects(Alloc& alloc, LinkedObjectStack& to_dealloc)
+    {
+      while (!to_dealloc.empty())
+      {
+        Object* q = to_dealloc.pop();
+        q->destructor();
+        q->dealloc(alloc);
+      }
+    }
+
+  public:
+    static void apply(Alloc& alloc, Object* o)
+    {
+      assert(o->debug_is_iso());
+
+      ObjectStack objects(alloc);
+      ObjectStack iso(alloc);
+      ObjectStack dealloc_regions(alloc);
+
+      iso.push(o);
+
+      while (!iso.empty())
+      {
+        assert(objects.empty());
+
+        Object* p = iso.pop();
+        RegionTrace* reg = open_region(alloc, p, objects);
+        scc(alloc, p, objects, iso);
+
+        // Finalise all the objects
+        // Move non-atomics to atomics
+        // Calculate list of things to be deallocated
+        LinkedObjectStack to_dealloc;
+        while (!objects.empty())
+          sweep_sublist(
+            alloc, objects.pop(), reg, to_dealloc, dealloc_regions);
+
         // Finally deallocate objects.
-        while (!to_dealloc.empty())
-        {
-          Object* q = to_dealloc.pop();
-          q->destructor();
-          q->dealloc(alloc);
-        }
+        dealloc_objects(alloc, to_dealloc);
 
         reg->discard(alloc);
         reg->dealloc(alloc);
       }
 
       assert(objects.empty());
-      assert(dfs.empty());
       assert(iso.empty());
     }
   };
+
+  /**
+   * Freezing, with the sweep of each region split into work that can run on
+   * several threads at once. This is driven by `verona::cpp::parallel_freeze`,
+   * which runs the phases in order:
+   *
+   *   ParallelFreeze freeze(alloc, o);
+   *   while (freeze.next_region(alloc))   on the calling thread
+   *   {
+   *     freeze.sweep(alloc, i)            for each i < freeze.segments(),
+   *                                       in parallel;
+   *     freeze.dealloc(alloc, i)          for each i < freeze.segments(),
+   *                                       in parallel;
+   *     freeze.finish_region(alloc)       on the calling thread.
+   *   }
+   *
+   * `next_region` computes the SCCs of the next region, see `Freeze`, which
+   * leaves the rings split into sublists. These are grouped into segments of
+   * `SEGMENT_SIZE` sublists, which are swept, moving the SCC roots to atomic
+   * reference counts and finalising unreachable objects, and then
+   * deallocated, in parallel. As for `Freeze::apply`, all finalisers of a
+   * region run before any of its objects is deallocated.
+   *
+   * Each thread passes its own allocator. The regions must not be used by
+   * anything else until the last `finish_region` returns.
+   */
+  class ParallelFreeze
+  {
+  public:
+    /**
+     * Number of sublists in a segment of the sweep.
+     */
+    static constexpr size_t SEGMENT_SIZE = 1024;
+
+  private:
+    struct Sublists : public std::vector<Object*>
+    {
+      void push(Object* p)
+      {
+        push_back(p);
+      }
+    };
+
+    // Iso objects of the regions still to freeze.
+    ObjectStack iso;
+
+    // The region being frozen, its sublists, and the unreachable objects
+    // found by sweeping each segment.
+    RegionTrace* reg = nullptr;
+    Sublists sublists;
+    std::vector<LinkedObjectStack> garbage;
+
+  public:
+    ParallelFreeze(Alloc& alloc, Object* o) : iso(alloc)
+    {
+      assert(o->debug_is_iso());
+      iso.push(o);
+    }
+
+    ParallelFreeze(const ParallelFreeze&) = delete;
+    ParallelFreeze& operator=(const ParallelFreeze&) = delete;
+
+    /**
+     * Computes the SCCs of the next region to freeze. Returns false once all
+     * regions have been frozen.
+     */
+    bool next_region(Alloc& alloc)
+    {
+      assert(reg == nullptr);
+      if (iso.empty())
+        return false;
+
+      Object* p = iso.pop();
+      reg = Freeze::open_region(alloc, p, sublists);
+      Freeze::scc(alloc, p, sublists, iso);
+      garbage.resize(segments());
+      return true;
+    }
+
+    size_t segments() const
+    {
+      return (sublists.size() + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+    }
+
+    /**
+     * Sweeps the sublists of segment `i`.
+     */
+    void sweep(Alloc& alloc, size_t i)
+    {
+      ObjectStack dealloc_regions(alloc);
+      auto end = std::min((i + 1) * SEGMENT_SIZE, sublists.size());
+      for (auto j = i * SEGMENT_SIZE; j < end; j++)
+        Freeze::sweep_sublist(
+          alloc, sublists[j], reg, garbage[i], dealloc_regions);
+    }
+
+    /**
+     * Deallocates the unreachable objects found by sweeping segment `i`.
+     */
+    void dealloc(Alloc& alloc, size_t i)
+    {
+      Freeze::dealloc_objects(alloc, garbage[i]);
+    }
+
+    void finish_region(Alloc& alloc)
+    {
+      reg->discard(alloc);
+      reg->dealloc(alloc);
+      reg = nullptr;
+      sublists.clear();
+      garbage.clear();
+    }
+  };
 } // namespace verona::rt
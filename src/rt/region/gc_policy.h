@@ -0,0 +1,97 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Heuristics deciding when a region should be collected automatically, see
+   * `Region::gc_if_needed`.
+   *
+   * A region is collected once the memory it uses has grown by `GROWTH`
+   * sixteenths since its previous collection, ignoring regions smaller than
+   * `MIN_SIZE`. With the default growth this collects when the usage doubles.
+   *
+   * If a per-process memory budget is set, the growth allowed shrinks as the
+   * memory used by the allocator approaches the budget: it falls linearly from
+   * `GROWTH` at half the budget, down to no growth at all at the budget.
+   *
+   * A region above its soft limit is collected whenever it has grown since
+   * its previous collection.
+   **/
+  class GCPolicy
+  {
+  public:
+    /**
+     * Regions using less memory than this are never collected automatically.
+     **/
+    static constexpr size_t MIN_SIZE = 64 * 1024;
+
+    /**
+     * Growth since the previous collection that triggers a collection, in
+     * sixteenths of the memory used after that collection.
+     **/
+    static constexpr size_t GROWTH = 32;
+
+  private:
+    static constexpr size_t ONE = 16;
+
+    static inline std::atomic<size_t> memory_budget{0};
+
+  public:
+    /**
+     * Sets the per-process memory budget, in bytes. Zero means no budget.
+     **/
+    static void set_memory_budget(size_t budget)
+    {
+      memory_budget.store(budget, std::memory_order_relaxed);
+    }
+
+    static size_t get_memory_budget()
+    {
+      return memory_budget.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Memory currently in use by the allocator, in bytes.
+     **/
+    static size_t memory_used()
+    {
+      return Alloc::Config::Backend::get_current_usage();
+    }
+
+    /**
+     * Returns true if a region using `current` bytes, that used `previous`
+     * bytes after its previous collection, should be collected. `soft_limit`
+     * is the region's soft limit, or zero if it has none.
+     **/
+    static bool
+    should_collect(size_t current, size_t previous, size_t soft_limit = 0)
+    {
+      if ((soft_limit != 0) && (current > soft_limit) && (current > previous))
+        return true;
+
+      size_t base = std::max(previous, MIN_SIZE);
+      size_t growth = GROWTH;
+
+      size_t budget = get_memory_budget();
+      if (budget != 0)
+      {
+        size_t used = memory_used();
+        size_t half = budget / 2;
+        if (used >= budget)
+          growth = ONE;
+        else if (used > half)
+          growth = ONE + ((GROWTH - ONE) * (budget - used)) / (budget - half);
+      }
+
+      return current * ONE > base * growth;
+    }
+  };
+} // namespace verona::rt
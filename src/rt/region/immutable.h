@@ -14,8 +14,72 @@ namespace verona::rt
     inline void mark_for_scan(Object* o, EpochMark epoch);
   } // namespace cown
 
+  /**
+   * Reference counting of immutable SCCs, through their root.
+   *
+   * Besides the shared, atomic, reference count, a thread can take biased
+   * references with `acquire_biased` and `release_biased`. These are counted
+   * non-atomically in a small thread-local table, each of whose entries holds
+   * a single shared reference to its SCC root. The local count is merged back
+   * into the shared one when the entry is evicted by another root, or when
+   * `flush_biased` is called. Scheduler threads do the latter after running
+   * each cown. Biased references that are still held then become shared
+   * references, but until then they must not be passed to another thread.
+   */
   class Immutable
   {
+  public:
+    /**
+     * Number of SCC roots a thread keeps biased reference counts for.
+     */
+    static constexpr size_t BIASED_ENTRIES = 64;
+
+  private:
+    struct BiasedCounts
+    {
+      Object* roots[BIASED_ENTRIES] = {};
+      size_t counts[BIASED_ENTRIES] = {};
+      size_t used = 0;
+    };
+
+    static BiasedCounts& biased()
+    {
+      static thread_local BiasedCounts counts;
+      return counts;
+    }
+
+    static size_t biased_index(Object* root)
+    {
+      return bits::hash(root->id()) & (BIASED_ENTRIES - 1);
+    }
+
+    /**
+     * Moves the references counted by the entry at `index` to the shared
+     * reference count, and empties the entry.
+     */
+    static void evict_biased(Alloc& alloc, size_t index)
+    {
+      auto& b = biased();
+      Object* root = b.roots[index];
+      if (root == nullptr)
+        return;
+
+      size_t count = b.counts[index];
+      b.roots[index] = nullptr;
+      b.counts[index] = 0;
+      b.used--;
+
+      // The entry already holds one shared reference.
+      if (count == 0)
+      {
+        release(alloc, root);
+        return;
+      }
+
+      while (--count > 0)
+        root->incref();
+    }
+
   public:
     static void acquire(Object* o)
     {
@@ -34,12 +98,66 @@ namespace verona::rt
       return 0;
     }
 
+    /**
+     * Takes a reference to the immutable `o` that is only counted by this
+     * thread, see `Immutable`.
+     */
+    static void acquire_biased(Object* o)
+    {
+      assert(o->debug_is_immutable());
+      auto root = o->immutable();
+      auto& b = biased();
+      auto index = biased_index(root);
+
+      if (b.roots[index] != root)
+      {
+        evict_biased(ThreadAlloc::get(), index);
+        root->incref();
+        b.roots[index] = root;
+        b.used++;
+      }
+
+      b.counts[index]++;
+    }
+
+    /**
+     * Drops a reference to the immutable `o` taken with `acquire_biased` on
+     * this thread. Other references are released as with `release`.
+     */
+    static void release_biased(Alloc& alloc, Object* o)
+    {
+      assert(o->debug_is_immutable());
+      auto root = o->immutable();
+      auto& b = biased();
+      auto index = biased_index(root);
+
+      if ((b.roots[index] == root) && (b.counts[index] != 0))
+      {
+        b.counts[index]--;
+        return;
+      }
+
+      release(alloc, root);
+    }
+
+    /**
+     * Merges all of this thread's biased reference counts into the shared
+     * ones. This releases the SCCs that only biased references kept alive.
+     */
+    static void flush_biased(Alloc& alloc)
+    {
+      auto& b = biased();
+      for (size_t i = 0; (i < BIASED_ENTRIES) && (b.used != 0); i++)
+        evict_biased(alloc, i);
+    }
+
     static void mark_and_scan(Alloc& alloc, Object* o, EpochMark epoch)
     {
       assert(o->debug_is_immutable());
       auto root = o->immutable();
 
       ObjectStack dfs(alloc);
+      ObjectStack fields(alloc);
       dfs.push(root);
 
       while (!dfs.empty())
@@ -59,7 +177,15 @@ namespace verona::rt
             // This may trace an immutable that has already been traced, as it
             // races over the epoch mark. This is ok.
             o->set_epoch(epoch);
-            o->trace(dfs);
+
+            // Fetch all the fields together, so that their misses overlap.
+            o->trace(fields);
+            while (!fields.empty())
+            {
+              Object* q = fields.pop();
+              q->prefetch();
+              dfs.push(q);
+            }
             break;
           }
 
@@ -28,6 +28,10 @@ namespace verona::rt
 
       auto result = header;
       header = header->get_next_any_mark();
+
+      // The caller works on `result`, meanwhile fetch the next one.
+      if (header != nullptr)
+        header->prefetch();
       return result;
     }
 
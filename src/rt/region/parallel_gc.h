@@ -0,0 +1,468 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "region_trace.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A full collection of a trace region, split into work that can run on
+   * several threads at once. This is driven by `verona::cpp::parallel_gc`,
+   * which runs the phases in order:
+   *
+   *   ParallelGC gc(alloc, o);
+   *   gc.mark(alloc)             on any number of threads at once;
+   *   gc.sweep_rings(alloc)      on the calling thread;
+   *   gc.finalise(alloc, i)      for each i < gc.segments(), in parallel;
+   *   gc.dealloc(alloc, i)       for each i < gc.segments(), in parallel;
+   *   gc.finish(alloc)           on the calling thread.
+   *
+   * Each thread passes its own allocator. The region must not be used by
+   * anything else until `finish` returns.
+   *
+   * Marking is a work-stealing trace. Each thread marks from its own stack,
+   * using an atomic mark so that an object is traced once. Threads that run
+   * out of work set `hungry` and wait on the pool, and busy threads then
+   * donate packets of objects from their stacks to the pool. Marking is
+   * complete when every thread that joined is waiting and the pool is empty.
+   * Threads that join late find no work and leave, so the collection does not
+   * depend on how many threads take part.
+   *
+   * Sweeping unlinks the unmarked objects from the rings on one thread, as a
+   * ring can only be split by walking it, and chains them into segments of
+   * at most `SEGMENT_SIZE` objects. Finalising, destructing and deallocating
+   * these segments, which is most of the cost of a sweep, is then done in
+   * parallel. As for `RegionTrace::sweep`, all finalisers run before any
+   * object is deallocated.
+   **/
+  class ParallelGC
+  {
+  public:
+    /**
+     * Number of objects shared at once between marking threads.
+     **/
+    static constexpr size_t PACKET_SIZE = 128;
+
+    /**
+     * Number of objects marked by a thread between checks for hungry threads.
+     **/
+    static constexpr size_t SHARE_INTERVAL = 64;
+
+    /**
+     * Maximum number of unmarked objects in a segment of the sweep.
+     **/
+    static constexpr size_t SEGMENT_SIZE = 4096;
+
+  private:
+    struct Packet
+    {
+      Packet* next;
+      size_t count;
+      Object* objects[PACKET_SIZE];
+    };
+
+    struct Segment
+    {
+      Segment* next;
+      Object* objects;
+      bool trivial;
+    };
+
+    Object* o;
+    RegionTrace* reg;
+
+    // Protects the fields below, and the RememberedSet of the region.
+    FlagWord lock;
+
+    // Packets of objects to mark.
+    Packet* pool = nullptr;
+
+    // Threads that have joined the mark, and those waiting for work.
+    size_t active = 0;
+    size_t waiting = 0;
+    bool done = false;
+
+    // Set when a thread is waiting for work.
+    std::atomic<bool> hungry{false};
+
+    // The segments of unmarked objects, in a list while they are built, and
+    // then indexed.
+    Segment* segment_list = nullptr;
+    Segment** segment_index = nullptr;
+    size_t segment_count = 0;
+
+    // Number of objects in the segment at the head of `segment_list`.
+    size_t segment_size = 0;
+
+    // Iso objects of unreachable subregions, found by finalisers.
+    StackThin<Object, Alloc> collect{};
+
+  public:
+    /**
+     * Prepares a collection of the region represented by the Iso object `o`,
+     * with its roots in the pool.
+     **/
+    ParallelGC(Alloc& alloc, Object* o) : o(o), reg(RegionTrace::get(o))
+    {
+      Logging::cout() << "Region parallel GC called for: " << o
+                      << Logging::endl;
+      reg->gc_settle(alloc);
+
+      ObjectStack f(alloc);
+      o->trace(f);
+      reg->additional_entry_points.forall([&f](Object* o) {
+        Logging::cout() << "Additional root: " << o << Logging::endl;
+        f.push(o);
+      });
+
+      while (!f.empty())
+      {
+        Packet* packet = new_packet(alloc);
+        while ((packet->count < PACKET_SIZE) && !f.empty())
+          packet->objects[packet->count++] = f.pop();
+        packet->next = pool;
+        pool = packet;
+      }
+    }
+
+    ParallelGC(const ParallelGC&) = delete;
+    ParallelGC& operator=(const ParallelGC&) = delete;
+
+    /**
+     * Mark objects of the region, with the other threads calling this, until
+     * they are all marked.
+     **/
+    void mark(Alloc& alloc)
+    {
+      {
+        FlagLock l(lock);
+        if (done)
+          return;
+        active++;
+      }
+
+      ObjectStack dfs(alloc);
+      ObjectStack remembered(alloc);
+      size_t marked = 0;
+
+      while (take(alloc, dfs))
+      {
+        while (!dfs.empty())
+        {
+          mark_object(dfs.pop(), dfs, remembered);
+
+          if (
+            (++marked % SHARE_INTERVAL == 0) &&
+            hungry.load(std::memory_order_relaxed))
+            share(alloc, dfs);
+        }
+      }
+
+      // Immutables and cowns are marked in the RememberedSet, which is not
+      // thread-safe.
+      FlagLock l(lock);
+      while (!remembered.empty())
+      {
+        Object* p = remembered.pop();
+        if (p->get_class() == Object::SCC_PTR)
+          p = p->immutable();
+        reg->RememberedSet::mark(alloc, p);
+      }
+    }
+
+    /**
+     * Unmark the live objects, and unlink the others from the rings into
+     * segments. This also accounts for the memory of the live objects, and
+     * erases the external references to trivial objects being collected.
+     **/
+    void sweep_rings(Alloc& alloc)
+    {
+      assert(done);
+      assert(pool == nullptr);
+
+      reg->current_memory_used = 0;
+      auto primary_ring = o->is_trivial() ? RegionTrace::TrivialRing :
+                                            RegionTrace::NonTrivialRing;
+
+      sweep_ring(alloc, RegionTrace::NonTrivialRing, primary_ring);
+      sweep_ring(alloc, RegionTrace::TrivialRing, primary_ring);
+
+      segment_index = (Segment**)alloc.alloc(
+        std::max<size_t>(segment_count, 1) * sizeof(Segment*));
+      size_t i = segment_count;
+      for (Segment* s = segment_list; s != nullptr; s = s->next)
+        segment_index[--i] = s;
+    }
+
+    /**
+     * Number of segments built by `sweep_rings`.
+     **/
+    size_t segments() const
+    {
+      return segment_count;
+    }
+
+    /**
+     * Run the finalisers of the objects of segment `i`.
+     **/
+    void finalise(Alloc& alloc, size_t i)
+    {
+      Segment* s = segment_index[i];
+      if (s->trivial)
+        return;
+
+      ObjectStack isos(alloc);
+      for (Object* p = s->objects; p != nullptr; p = p->get_next_any_mark())
+        p->finalise(o, isos);
+
+      if (isos.empty())
+        return;
+
+      FlagLock l(lock);
+      while (!isos.empty())
+        collect.push(isos.pop(), alloc);
+    }
+
+    /**
+     * Destruct and deallocate the objects of segment `i`, once every segment
+     * has been finalised.
+     **/
+    void dealloc(Alloc& alloc, size_t i)
+    {
+      Segment* s = segment_index[i];
+      Object* p = s->objects;
+      while (p != nullptr)
+      {
+        Object* q = p->get_next_any_mark();
+        if (!s->trivial)
+          p->destructor();
+        p->dealloc(alloc);
+        p = q;
+      }
+    }
+
+    /**
+     * Complete the collection, and release the unreachable subregions.
+     **/
+    void finish(Alloc& alloc)
+    {
+      while (segment_list != nullptr)
+      {
+        Segment* s = segment_list;
+        segment_list = s->next;
+        alloc.dealloc<sizeof(Segment)>(s);
+      }
+      alloc.dealloc(segment_index);
+      segment_index = nullptr;
+      segment_count = 0;
+
+      reg->RememberedSet::sweep(alloc);
+      reg->previous_memory_used =
+        size_to_sizeclass_full(reg->current_memory_used);
+
+      ObjectStack isos(alloc);
+      while (!collect.empty())
+        isos.push(collect.pop(alloc));
+      reg->release_unreachable(alloc, isos);
+    }
+
+  private:
+    static Packet* new_packet(Alloc& alloc)
+    {
+      auto packet = (Packet*)alloc.alloc<sizeof(Packet)>();
+      packet->next = nullptr;
+      packet->count = 0;
+      return packet;
+    }
+
+    /**
+     * As `RegionTrace::mark_object`, but immutables and cowns are added to
+     * `remembered` to be marked in the RememberedSet later.
+     **/
+    void mark_object(Object* p, ObjectStack& dfs, ObjectStack& remembered)
+    {
+      switch (p->get_class_atomic())
+      {
+        case Object::ISO:
+        case Object::MARKED:
+          break;
+
+        case Object::UNMARKED:
+          if (p->mark_atomic())
+          {
+            Logging::cout() << "Parallel mark" << p << Logging::endl;
+            p->trace(dfs);
+          }
+          break;
+
+        case Object::SCC_PTR:
+        case Object::RC:
+        case Object::COWN:
+          remembered.push(p);
+          break;
+
+        default:
+          assert(0);
+      }
+    }
+
+    /**
+     * Donate objects from `dfs` to the pool, keeping at least one.
+     **/
+    void share(Alloc& alloc, ObjectStack& dfs)
+    {
+      Object* keep = dfs.pop();
+      if (dfs.empty())
+      {
+        dfs.push(keep);
+        return;
+      }
+
+      Packet* packet = new_packet(alloc);
+      while ((packet->count < PACKET_SIZE) && !dfs.empty())
+        packet->objects[packet->count++] = dfs.pop();
+      dfs.push(keep);
+
+      FlagLock l(lock);
+      packet->next = pool;
+      pool = packet;
+      hungry.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * Move a packet from the pool to `dfs`, waiting for one if the pool is
+     * empty. Returns false once marking is complete.
+     **/
+    bool take(Alloc& alloc, ObjectStack& dfs)
+    {
+      Packet* packet = nullptr;
+      bool is_waiting = false;
+      while (true)
+      {
+        {
+          FlagLock l(lock);
+          if (pool != nullptr)
+          {
+            packet = pool;
+            pool = packet->next;
+            if (is_waiting)
+              waiting--;
+            if (waiting == 0)
+              hungry.store(false, std::memory_order_relaxed);
+            break;
+          }
+
+          if (!is_waiting)
+          {
+            is_waiting = true;
+            waiting++;
+          }
+
+          if (waiting == active)
+            done = true;
+
+          if (done)
+            return false;
+
+          hungry.store(true, std::memory_order_relaxed);
+        }
+
+        Systematic::yield();
+        Aal::pause();
+      }
+
+      for (size_t i = 0; i < packet->count; i++)
+        dfs.push(packet->objects[i]);
+      alloc.dealloc<sizeof(Packet)>(packet);
+      return true;
+    }
+
+    void add_segment(Alloc& alloc, Object* p, bool trivial)
+    {
+      if (
+        (segment_list == nullptr) || (segment_list->trivial != trivial) ||
+        (segment_size == SEGMENT_SIZE))
+        new_segment(alloc, trivial);
+
+      p->init_next(segment_list->objects);
+      segment_list->objects = p;
+      segment_size++;
+    }
+
+    void new_segment(Alloc& alloc, bool trivial)
+    {
+      auto s = (Segment*)alloc.alloc<sizeof(Segment)>();
+      s->next = segment_list;
+      s->objects = nullptr;
+      s->trivial = trivial;
+      segment_list = s;
+      segment_count++;
+      segment_size = 0;
+    }
+
+    /**
+     * As `RegionTrace::sweep_ring`, but the unmarked objects are added to
+     * segments rather than collected.
+     **/
+    void sweep_ring(
+      Alloc& alloc, RegionTrace::RingKind ring, RegionTrace::RingKind primary)
+    {
+      bool trivial = ring == RegionTrace::TrivialRing;
+      Object* prev = reg;
+      Object* p = ring == primary ? reg->get_next() : reg->next_not_root;
+
+      while (p != reg)
+      {
+        switch (p->get_class())
+        {
+          case Object::ISO:
+            // An iso is always the root, and the last thing in the ring.
+            assert(p->get_next_any_mark() == reg);
+            reg->use_memory(p->size());
+            p = reg;
+            break;
+
+          case Object::MARKED:
+            reg->use_memory(p->size());
+            p->unmark();
+            prev = p;
+            p = p->get_next();
+            break;
+
+          case Object::UNMARKED:
+          {
+            Object* q = p->get_next();
+            Logging::cout() << "Parallel sweep " << p << Logging::endl;
+
+            if (ring != primary && prev == reg)
+              reg->next_not_root = q;
+            else
+              prev->set_next(q);
+
+            if (ring != primary && reg->last_not_root == p)
+              reg->last_not_root = prev;
+
+            // p is about to be collected; remove the entry for it in the
+            // ExternalRefTable.
+            if (trivial && p->has_ext_ref())
+              reg->ExternalReferenceTable::erase(alloc, p);
+
+            add_segment(alloc, p, trivial);
+            p = q;
+            break;
+          }
+
+          default:
+            assert(0);
+        }
+      }
+    }
+  };
+} // namespace verona::rt
@@ -4,7 +4,9 @@
 
 #include "../object/object.h"
 #include "region_arena.h"
+#include "parallel_gc.h"
 #include "region_base.h"
+#include "region_hybrid.h"
 #include "region_rc.h"
 #include "region_trace.h"
 
@@ -37,6 +39,8 @@ namespace verona::rt
    *                                       |
    *   Concrete region         RegionTrace (region_trace.h)
    *   implementations         RegionArena (region_arena.h)
+   *                           RegionRc (region_rc.h)
+   *                           RegionHybrid (region_hybrid.h)
    *                                       ^
    *                                       |
    *                                Region (region.h)
@@ -93,6 +97,12 @@ namespace verona::rt
     using T = RegionRc;
   };
 
+  template<>
+  struct RegionType_to_class<RegionType::Hybrid>
+  {
+    using T = RegionHybrid;
+  };
+
   class Region
   {
   public:
@@ -110,6 +120,8 @@ namespace verona::rt
         return RegionType::Arena;
       else if (RegionRc::is_rc_region(o))
         return RegionType::Rc;
+      else if (RegionHybrid::is_hybrid_region(o))
+        return RegionType::Hybrid;
 
       abort();
     }
@@ -140,6 +152,10 @@ namespace verona::rt
             Region::cown_scan_internal<RegionArena>(
               alloc, o, f, recurse, epoch);
             break;
+          case RegionType::Hybrid:
+            Region::cown_scan_internal<RegionHybrid>(
+              alloc, o, f, recurse, epoch);
+            break;
           default:
             abort();
         }
@@ -166,6 +182,144 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Release and deallocate the region represented by Iso object `o`, but not
+     * the regions it owns. Their Iso objects are pushed onto `sub_regions`, to
+     * be released by the caller.
+     **/
+    static void
+    release_shallow(Alloc& alloc, Object* o, ObjectStack& sub_regions)
+    {
+      assert(o->debug_is_iso());
+      Region::release_internal(alloc, o, sub_regions);
+    }
+
+    /**
+     * Returns true if the region represented by Iso object `o` has grown
+     * enough since its previous collection to be collected, see `GCPolicy`.
+     **/
+    static bool should_gc(Object* o)
+    {
+      assert(o->debug_is_iso());
+      auto r = o->get_region();
+      switch (Region::get_type(r))
+      {
+        case RegionType::Trace:
+          return ((RegionTrace*)r)->should_gc();
+        case RegionType::Arena:
+          // Nothing to collect here!
+          return false;
+        case RegionType::Rc:
+          return ((RegionRc*)r)->should_gc();
+        case RegionType::Hybrid:
+          return ((RegionHybrid*)r)->should_gc();
+        default:
+          abort();
+      }
+    }
+
+    /**
+     * Collect the closed region represented by Iso object `o` if
+     * `should_gc(o)`. Returns true if the region was collected.
+     **/
+    static bool gc_if_needed(Alloc& alloc, Object* o)
+    {
+      if (!should_gc(o))
+        return false;
+
+      Logging::cout() << "Region automatic GC: " << o << Logging::endl;
+
+      auto r = o->get_region();
+      switch (Region::get_type(r))
+      {
+        case RegionType::Trace:
+          RegionTrace::gc(alloc, o);
+          break;
+        case RegionType::Hybrid:
+          RegionHybrid::gc(alloc, o);
+          break;
+        case RegionType::Rc:
+        {
+          auto reg = (RegionRc*)r;
+          reg->open(o);
+          RegionRc::gc_cycles(alloc, o, reg);
+          reg->close(o);
+          break;
+        }
+        default:
+          abort();
+      }
+      return true;
+    }
+
+    /**
+     * Returns the number of bytes of memory held by the region represented by
+     * Iso object `o`. Trace and Rc regions count their objects, while arena
+     * and hybrid regions count the arenas or chunks that hold their objects.
+     **/
+    static size_t memory_used(Object* o)
+    {
+      assert(o->debug_is_iso());
+      auto r = o->get_region();
+      switch (Region::get_type(r))
+      {
+        case RegionType::Trace:
+          return ((RegionTrace*)r)->memory_used();
+        case RegionType::Arena:
+          return ((RegionArena*)r)->memory_used();
+        case RegionType::Rc:
+          return ((RegionRc*)r)->memory_used();
+        case RegionType::Hybrid:
+          return ((RegionHybrid*)r)->memory_used();
+        default:
+          abort();
+      }
+    }
+
+    /**
+     * Returns a position-independent image of the region represented by Iso
+     * object `o`, or an empty image if it cannot be serialized. See
+     * `RegionArena::serialize`.
+     **/
+    static std::vector<std::byte> serialize(
+      Alloc& alloc,
+      Object* o,
+      const Descriptor* const* descriptors,
+      size_t count)
+    {
+      return RegionArena::serialize(alloc, o, descriptors, count);
+    }
+
+    /**
+     * Returns the Iso object of a new arena region loaded from an image made
+     * by `serialize`, or nullptr if the image is malformed. See
+     * `RegionArena::deserialize`.
+     **/
+    static Object* deserialize(
+      Alloc& alloc,
+      const void* image,
+      size_t size,
+      const Descriptor* const* descriptors,
+      size_t count)
+    {
+      return RegionArena::deserialize(alloc, image, size, descriptors, count);
+    }
+
+    /**
+     * Sets the memory limits, in bytes, of the region represented by Iso
+     * object `o`, where zero means no limit. Once the region uses more than
+     * `soft`, `should_gc` holds whenever it has grown since its previous
+     * collection; arena regions are never collected. An allocation that
+     * would take the region past `hard` calls the handler set by
+     * `RegionBase::set_limit_handler` first. Merged regions keep the limits
+     * of the region merged into.
+     **/
+    static void set_limits(Object* o, size_t soft, size_t hard)
+    {
+      assert(o->debug_is_iso());
+      o->get_region()->set_limits(soft, hard);
+    }
+
     /**
      * Returns the region metadata object for the given Iso object `o`.
      *
@@ -270,12 +424,43 @@ namespace verona::rt
           ((RegionRc*)r)->release_internal(alloc, o, collect);
           return;
         }
+        case RegionType::Hybrid:
+          ((RegionHybrid*)r)->release_internal(alloc, o, collect);
+          return;
         default:
           abort();
       }
     }
   };
 
+  inline void
+  RegionHybrid::release_unreachable(Alloc& alloc, ObjectStack& collect)
+  {
+    // `collect` contains all the iso objects to unreachable subregions.
+    // Since they are unreachable, we can just release them.
+    while (!collect.empty())
+    {
+      Object* o = collect.pop();
+      assert(o->get_region() != this);
+      Logging::cout() << "Region GC: releasing unreachable subregion: " << o
+                      << Logging::endl;
+      Region::release(alloc, o);
+    }
+  }
+
+  inline void
+  RegionArena::release_unreachable(Alloc& alloc, ObjectStack& collect)
+  {
+    while (!collect.empty())
+    {
+      Object* o = collect.pop();
+      assert(o->get_region() != this);
+      Logging::cout() << "Region arena: releasing unreachable subregion: "
+                      << o << Logging::endl;
+      Region::release(alloc, o);
+    }
+  }
+
   inline size_t debug_get_ref_count(Object* o)
   {
     return o->get_ref_count();
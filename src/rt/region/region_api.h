@@ -82,6 +82,7 @@ namespace verona::rt::api
     {
       case RegionType::Trace:
       case RegionType::Arena:
+      case RegionType::Hybrid:
         break;
       case RegionType::Rc:
         ((RegionRc*)md)->open(r);
@@ -101,6 +102,7 @@ namespace verona::rt::api
     {
       case RegionType::Trace:
       case RegionType::Arena:
+      case RegionType::Hybrid:
         break;
       case RegionType::Rc:
         ((RegionRc*)md)->close(RegionContext::get_entry_point());
@@ -159,6 +161,10 @@ namespace verona::rt::api
         RegionArena::merge(
           ThreadAlloc::get(), RegionContext::get_entry_point(), r);
         return r;
+      case RegionType::Hybrid:
+        RegionHybrid::merge(
+          ThreadAlloc::get(), RegionContext::get_entry_point(), r);
+        return r;
       case RegionType::Rc:
         abort();
     }
@@ -173,6 +179,16 @@ namespace verona::rt::api
     return ExternalRef::create(RegionContext::get_region(), o);
   }
 
+  /**
+   * Create external references to `count` objects in the current region,
+   * writing them to `refs`.
+   */
+  inline void
+  create_external_references(Object** objects, size_t count, ExternalRef** refs)
+  {
+    ExternalRef::create(RegionContext::get_region(), objects, count, refs);
+  }
+
   /**
    * Check if external reference is in the current region and still valid.
    */
@@ -207,6 +223,9 @@ namespace verona::rt::api
       case RegionType::Rc:
         return RegionRc::alloc(
           ThreadAlloc::get(), (RegionRc*)RegionContext::get_region(), d);
+      case RegionType::Hybrid:
+        return RegionHybrid::alloc(
+          ThreadAlloc::get(), RegionContext::get_entry_point(), d);
     }
     // Unreachable as case is exhaustive
     abort();
@@ -225,14 +244,21 @@ namespace verona::rt::api
   inline void incref(Object* o)
   {
     assert(Region::get_type(RegionContext::get_region()) == RegionType::Rc);
-    RegionRc::incref(o);
+    auto reg = (RegionRc*)RegionContext::get_region();
+    if (reg->is_deferred())
+      RegionRc::deferred_incref(ThreadAlloc::get(), o, reg);
+    else
+      RegionRc::incref(o);
   }
 
   inline void decref(Object* o)
   {
     assert(Region::get_type(RegionContext::get_region()) == RegionType::Rc);
-    RegionRc::decref(
-      ThreadAlloc::get(), o, (RegionRc*)RegionContext::get_region());
+    auto reg = (RegionRc*)RegionContext::get_region();
+    if (reg->is_deferred())
+      RegionRc::deferred_decref(ThreadAlloc::get(), o, reg);
+    else
+      RegionRc::decref(ThreadAlloc::get(), o, reg);
   }
 
   template<typename T = Object>
@@ -250,6 +276,9 @@ namespace verona::rt::api
       case RegionType::Rc:
         entry_point = RegionRc::create(ThreadAlloc::get(), d);
         break;
+      case RegionType::Hybrid:
+        entry_point = RegionHybrid::create(ThreadAlloc::get(), d);
+        break;
     }
     return {reinterpret_cast<T*>(entry_point)};
   }
@@ -264,6 +293,9 @@ namespace verona::rt::api
       case RegionType::Arena:
         RegionArena::swap_root(RegionContext::get_entry_point(), o);
         break;
+      case RegionType::Hybrid:
+        RegionHybrid::swap_root(RegionContext::get_entry_point(), o);
+        break;
       case RegionType::Rc:
         abort(); // TODO
         break;
@@ -288,9 +320,60 @@ namespace verona::rt::api
           RegionContext::get_entry_point(),
           (RegionRc*)RegionContext::get_region());
         break;
+      case RegionType::Hybrid:
+        RegionHybrid::gc(ThreadAlloc::get(), RegionContext::get_entry_point());
+        break;
     }
   }
 
+  /**
+   * Collect only the objects allocated in the current region since its
+   * previous collection, see `RegionTrace::gc_minor`. Other kinds of region
+   * are collected fully.
+   */
+  inline void region_collect_minor()
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::gc_minor(
+        ThreadAlloc::get(), RegionContext::get_entry_point());
+    else
+      region_collect();
+  }
+
+  /**
+   * Do a bounded step of an incremental collection of the current region, see
+   * `RegionTrace::gc_step`. Returns true if the collection is complete.
+   */
+  inline bool
+  region_collect_step(size_t budget = RegionTrace::GC_STEP_BUDGET)
+  {
+    switch (Region::get_type(RegionContext::get_region()))
+    {
+      case RegionType::Trace:
+        return RegionTrace::gc_step(
+          ThreadAlloc::get(), RegionContext::get_entry_point(), budget);
+      case RegionType::Arena:
+        // Nothing to collect here!
+        return true;
+      case RegionType::Rc:
+      case RegionType::Hybrid:
+        region_collect();
+        return true;
+    }
+    abort();
+  }
+
+  /**
+   * Must be called when a pointer to `o` is stored into a field of an object
+   * in the current region, see `RegionTrace::write_barrier`.
+   */
+  inline void write_barrier(Object* o)
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+      RegionTrace::write_barrier(
+        ThreadAlloc::get(), RegionContext::get_entry_point(), o);
+  }
+
   template<typename T = Object>
   inline void region_release(Object* r)
   {
@@ -324,6 +407,13 @@ namespace verona::rt::api
         return count;
       case RegionType::Rc:
         return ((RegionRc*)r)->get_region_size();
+      case RegionType::Hybrid:
+        for (auto p : *((RegionHybrid*)r))
+        {
+          UNUSED(p);
+          count++;
+        }
+        return count;
       default:
         abort();
     }
@@ -5,12 +5,38 @@
 #include "../object/object.h"
 #include "region_base.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
+#include <vector>
 
 namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * Memory for the arenas and large objects of an arena region, in place of
+   * the allocator, see `RegionArena::create`. A source serves a single
+   * region, and is not used again once it has been released.
+   **/
+  class ArenaSource
+  {
+  public:
+    virtual ~ArenaSource() = default;
+
+    /**
+     * Returns `size` bytes, aligned to `Object::ALIGNMENT`. This must not
+     * return nullptr.
+     **/
+    virtual void* alloc_chunk(size_t size) = 0;
+
+    /**
+     * Free all the memory returned by `alloc_chunk`. This is called once,
+     * when the region is released.
+     **/
+    virtual void release() = 0;
+  };
+
   /**
    * Please see region.h for the full documentation.
    *
@@ -38,6 +64,32 @@ namespace verona::rt
    * ensure merges are fast. If the iso object is in the large object ring,
    * then it must be in the last position, so it can point to the region
    * metadata object.
+   *
+   * Objects in an arena are never freed individually, so an arena region
+   * only grows, and its live objects become spread over mostly dead arenas.
+   * `compact` copies the live objects into fresh arenas and frees the old
+   * ones, see there for the restrictions. A region that is filled and
+   * emptied repeatedly can instead be emptied by `reset`, which keeps its Iso
+   * object and one arena for the next round.
+   *
+   * Arenas are 1 MiB by default. A region that allocates a lot can use larger
+   * arenas, see `set_arena_size`, which cuts the number of arena allocations
+   * and, as arenas are naturally aligned to their size by snmalloc, lets
+   * 2 MiB or larger arenas be backed by transparent huge pages. Only the
+   * arena size changes: objects larger than `Arena::SIZE` still go in the
+   * large object ring, so regions with different arena sizes can be merged.
+   *
+   * A region may instead take its memory from an `ArenaSource`, for instance
+   * the heap that a process shares with a sandbox, so that the data can be
+   * handed over without a copy. Such a region holds only trivial objects,
+   * and keeps no record of its memory other than in the source: releasing it
+   * runs nothing and frees the whole source, so nothing that the other side
+   * writes into the region's memory is followed. It cannot be merged,
+   * compacted, reset or serialized.
+   *
+   * On scheduler threads, freed arenas are kept in a per-thread cache, see
+   * `ArenaCache`, so creating and releasing regions does not go back to the
+   * allocator each time.
    **/
   class RegionArena : public RegionBase
   {
@@ -50,6 +102,7 @@ namespace verona::rt
     friend class Region;
     friend class RegionTrace;
     friend class RegionRc;
+    friend class ScratchArena;
 
     /**
      * An Arena is a large block of pre-allocated memory. It has an overhead of
@@ -117,6 +170,10 @@ namespace verona::rt
       friend class RegionArena::iterator;
 
     public:
+      /**
+       * The space for objects in the default, and smallest, arena. Objects
+       * larger than this are never allocated in an arena, whatever its size.
+       **/
       static constexpr size_t SIZE = 1024 * 1024 - 4 * sizeof(uintptr_t);
 
       /**
@@ -137,25 +194,38 @@ namespace verona::rt
       std::byte* non_trivial_begin;
 
       /**
-       * Pointer to the byte after the Arena. We technically don't need to
-       * store this pointer, but we have some space because `objects_begin`
-       * needs to be aligned.
+       * Pointer to the byte after the Arena, which also gives its size, see
+       * `arena_size`.
        **/
       std::byte* non_trivial_end;
 
       /**
-       * Where objects will actually be allocated.
+       * Where objects will actually be allocated. An arena larger than the
+       * default extends past the end of this array.
        **/
       alignas(Object::ALIGNMENT) std::byte objects_begin[SIZE];
 
     public:
-      Arena()
+      /**
+       * Initialises an arena occupying the `size` bytes at `this`, which
+       * must be at least `sizeof(Arena)`.
+       **/
+      Arena(size_t size = sizeof(Arena))
       : next(nullptr),
         objects_end(objects_begin),
-        non_trivial_begin(objects_begin + SIZE),
+        non_trivial_begin((std::byte*)this + size),
         non_trivial_end(non_trivial_begin)
       {
-        assert(free_space() == SIZE);
+        assert(size >= sizeof(Arena));
+        assert(free_space() >= SIZE);
+      }
+
+      /**
+       * The number of bytes allocated for this arena, including its header.
+       **/
+      inline size_t arena_size() const
+      {
+        return (size_t)(non_trivial_end - (const std::byte*)this);
       }
 
       inline size_t free_space() const
@@ -201,6 +271,99 @@ namespace verona::rt
         return o;
       }
 
+      /**
+       * Allocates `sz` bytes of raw memory, with no object header, from the
+       * trivial end of the arena. `sz` must be a multiple of
+       * `Object::ALIGNMENT`. This is used by `ScratchArena`, which never
+       * places objects in the same arena.
+       **/
+      void* alloc_bytes(size_t sz)
+      {
+        assert(debug_invariant());
+        assert(free_space() >= sz);
+        assert(bits::align_up(sz, Object::ALIGNMENT) == sz);
+
+        void* p = objects_end;
+        objects_end += sz;
+
+        assert(debug_invariant());
+        return p;
+      }
+
+      /**
+       * Forget everything allocated in the arena, so that it can be reused.
+       * Nothing in the arena is finalised or destructed.
+       **/
+      void clear()
+      {
+        next = nullptr;
+        objects_end = objects_begin;
+        non_trivial_begin = non_trivial_end;
+        assert(free_space() >= SIZE);
+      }
+
+      /**
+       * Returns true if the object `p` is allocated in this arena.
+       **/
+      bool contains(Object* p) const
+      {
+        return (p->real_start() >= objects_begin) &&
+          (p->real_start() < non_trivial_end);
+      }
+
+      /**
+       * Forget everything allocated in the arena except the object `keep`,
+       * which must be in it. `keep` is moved to where it would be if it were
+       * the only object allocated, and its new address is returned. Nothing
+       * in the arena is finalised or destructed.
+       **/
+      Object* rewind(Object* keep)
+      {
+        assert(contains(keep));
+        size_t sz = snmalloc::bits::align_up(keep->size(), Object::ALIGNMENT);
+        std::byte* from = keep->real_start();
+
+        clear();
+        std::byte* to = nullptr;
+        if (keep->is_trivial())
+        {
+          to = objects_end;
+          objects_end += sz;
+        }
+        else
+        {
+          non_trivial_begin -= sz;
+          to = non_trivial_begin;
+        }
+
+        // The header moves with the object, the two may overlap.
+        std::memmove(to, from, sz);
+        assert(debug_invariant());
+        return Object::object_start(to);
+      }
+
+      /**
+       * Calls `f` on each object in the arena: the trivial ones from the
+       * first allocated, and then the non-trivial ones from the last.
+       **/
+      template<typename F>
+      void for_each(F f)
+      {
+        for (std::byte* q = objects_begin; q != objects_end;)
+        {
+          Object* p = Object::object_start(q);
+          q += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+          f(p);
+        }
+
+        for (std::byte* q = non_trivial_begin; q != non_trivial_end;)
+        {
+          Object* p = Object::object_start(q);
+          q += snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+          f(p);
+        }
+      }
+
     private:
       bool debug_invariant() const
       {
@@ -217,6 +380,80 @@ namespace verona::rt
     };
     static_assert(sizeof(Arena) == 1024 * 1024 * sizeof(std::byte));
 
+    /**
+     * Bounds on the size of arenas, see `set_arena_size`.
+     **/
+    static constexpr size_t MIN_ARENA_BITS = 20;
+    static constexpr size_t MAX_ARENA_BITS = 30;
+    static_assert(sizeof(Arena) == bits::one_at_bit(MIN_ARENA_BITS));
+
+    /**
+     * Freed arenas kept by a thread for reuse, with one list per arena size.
+     * Caching is only enabled on scheduler threads, which flush the cache
+     * when they stop, so that all the memory is back with the allocator at
+     * the end of a run. At most `CAPACITY` bytes are kept, so the largest
+     * arenas are always returned to the allocator.
+     **/
+    struct ArenaCache
+    {
+      static constexpr size_t CAPACITY = 64 * 1024 * 1024;
+
+      bool enabled = false;
+      size_t bytes = 0;
+      Arena* bins[MAX_ARENA_BITS - MIN_ARENA_BITS + 1] = {};
+    };
+
+    static ArenaCache& arena_cache()
+    {
+      static thread_local ArenaCache cache;
+      return cache;
+    }
+
+    static Arena*& arena_bin(ArenaCache& cache, size_t size)
+    {
+      return cache.bins[bits::next_pow2_bits(size) - MIN_ARENA_BITS];
+    }
+
+    /**
+     * Returns an empty arena of `size` bytes, from the cache if possible.
+     **/
+    static Arena* acquire_arena(Alloc& alloc, size_t size)
+    {
+      auto& cache = arena_cache();
+      Arena*& bin = arena_bin(cache, size);
+      if (bin != nullptr)
+      {
+        Arena* a = bin;
+        bin = a->next;
+        a->next = nullptr;
+        cache.bytes -= size;
+        return a;
+      }
+
+      return new (alloc.alloc(size)) Arena(size);
+    }
+
+    /**
+     * Returns the arena `a` to the cache, or to `alloc` if the cache is
+     * disabled or full. Nothing in the arena is finalised or destructed.
+     **/
+    static void release_arena(Alloc& alloc, Arena* a)
+    {
+      auto& cache = arena_cache();
+      size_t size = a->arena_size();
+      if (cache.enabled && (cache.bytes + size <= ArenaCache::CAPACITY))
+      {
+        Arena*& bin = arena_bin(cache, size);
+        a->clear();
+        a->next = bin;
+        bin = a;
+        cache.bytes += size;
+        return;
+      }
+
+      alloc.dealloc(a, size);
+    }
+
     /**
      * Pointer to the linked list of arenas where objects are allocated in.
      * May be null, if all of the objects are in the large object ring.
@@ -237,11 +474,28 @@ namespace verona::rt
      **/
     Object* last_large;
 
+    /**
+     * Size of the arenas allocated by this region, see `set_arena_size`.
+     **/
+    size_t arena_size;
+
+    /**
+     * Bytes of arenas and large objects held by this region.
+     **/
+    size_t current_memory_used = 0;
+
+    /**
+     * Where the arenas and large objects come from, or nullptr for the
+     * allocator, see `ArenaSource`.
+     **/
+    ArenaSource* source = nullptr;
+
     RegionArena()
     : RegionBase(),
       first_arena(nullptr),
       last_arena(nullptr),
-      last_large(nullptr)
+      last_large(nullptr),
+      arena_size(sizeof(Arena))
     {
       init_next(this);
     }
@@ -267,6 +521,84 @@ namespace verona::rt
       return o->is_type(desc());
     }
 
+    /**
+     * Sets the size of the arenas that the region represented by the Iso
+     * object `o` allocates from now on. `size` must be a power of two from
+     * 1 MiB to 1 GiB. Arenas that are already allocated keep their size.
+     **/
+    static void set_arena_size(Object* o, size_t size)
+    {
+      assert(bits::is_pow2(size));
+      assert(size >= bits::one_at_bit(MIN_ARENA_BITS));
+      assert(size <= bits::one_at_bit(MAX_ARENA_BITS));
+      get(o)->arena_size = size;
+    }
+
+    static size_t get_arena_size(Object* o)
+    {
+      return get(o)->arena_size;
+    }
+
+    /**
+     * Returns the number of bytes held by the region: its arenas, whether or
+     * not they are full, and its large objects.
+     **/
+    size_t memory_used() const
+    {
+      return current_memory_used;
+    }
+
+    /**
+     * Returns the source that the region represented by the Iso object `o`
+     * takes its memory from, or nullptr if it uses the allocator.
+     **/
+    static ArenaSource* get_source(Object* o)
+    {
+      return get(o)->source;
+    }
+
+    /**
+     * Release the region with metadata object `reg`, which must have a
+     * source. Unlike `Region::release`, this does not read the header of the
+     * Iso object, which the other side of the source may have overwritten,
+     * so the caller keeps `reg` from when the region was created.
+     **/
+    static void release_sourced(Alloc& alloc, RegionArena* reg)
+    {
+      assert(reg->source != nullptr);
+      ObjectStack collect(alloc);
+      reg->release_internal(alloc, nullptr, collect);
+    }
+
+    /**
+     * Keep the arenas freed by this thread for reuse, see `ArenaCache`. This
+     * is called by each scheduler thread when it starts.
+     **/
+    static void enable_arena_cache()
+    {
+      arena_cache().enabled = true;
+    }
+
+    /**
+     * Return the arenas cached by this thread to `alloc`, and stop caching.
+     * This is called by each scheduler thread when it stops.
+     **/
+    static void flush_arena_cache(Alloc& alloc)
+    {
+      auto& cache = arena_cache();
+      cache.enabled = false;
+      for (auto& bin : cache.bins)
+      {
+        while (bin != nullptr)
+        {
+          Arena* a = bin;
+          bin = a->next;
+          alloc.dealloc(a, a->arena_size());
+        }
+      }
+      cache.bytes = 0;
+    }
+
     /**
      * Creates a new arena region by allocationg Object `o` of type `desc`. The
      * object is initialised as the Iso object for that region, and points to a
@@ -277,11 +609,14 @@ namespace verona::rt
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* create(Alloc& alloc, const Descriptor* desc)
+    static Object*
+    create(Alloc& alloc, const Descriptor* desc, ArenaSource* source = nullptr)
     {
       void* p = Object::register_object(
         alloc.alloc<vsizeof<RegionArena>>(), RegionArena::desc());
       RegionArena* reg = new (p) RegionArena();
+      reg->source = source;
+      assert((source == nullptr) || Object::is_trivial(desc));
 
       // o might be allocated in the arena or the large object ring.
       Object* o = reg->alloc_internal<size>(alloc, desc);
@@ -310,6 +645,7 @@ namespace verona::rt
     static Object* alloc(Alloc& alloc, Object* in, const Descriptor* desc)
     {
       RegionArena* reg = get(in);
+      assert((reg->source == nullptr) || Object::is_trivial(desc));
       Object* o = reg->alloc_internal<size>(alloc, desc);
       assert(Object::debug_is_aligned(o));
       return o;
@@ -349,6 +685,7 @@ namespace verona::rt
       RegionArena* reg = get(into);
       RegionBase* other = o->get_region();
       assert(reg != other);
+      assert(reg->source == nullptr);
 
       if (is_arena_region(other))
         reg->merge_internal((RegionArena*)other);
@@ -384,122 +721,1067 @@ namespace verona::rt
       reg->swap_root_internal(prev, next);
     }
 
-  private:
-    inline void append(Object* hd)
-    {
-      append(hd, hd);
-    }
-
     /**
-     * Inserts the object `hd` into the large object ring, right after the
-     * region metadata object. `tl` is used for merging two rings; if there is
-     * only one ring, then hd == tl.
+     * Run a compacting collection on the region represented by the Iso object
+     * `o`. The live objects in arenas are copied, in allocation order, into
+     * new arenas, and the old arenas are freed along with the unreachable
+     * objects, which are finalised and destructed first. Returns the Iso
+     * object, which moves if it was in an arena; the caller must replace its
+     * reference to `o` with the result.
+     *
+     * Objects are moved with `memcpy`, so they must not point into
+     * themselves. The pointers to moved objects are found by tracing each
+     * live object, and rewritten in the words of the object that hold them.
+     * This needs every such pointer to be stored in a field that `trace`
+     * reports. If that cannot be checked for some object, because a word
+     * holds the same value as a traced pointer without `trace` reporting it,
+     * nothing is moved or collected and `o` is returned.
+     *
+     * Nothing else may point into the region during a compaction: the region
+     * must have no external references, in which case `o` is returned
+     * unchanged, and callers must not hold pointers to its objects other than
+     * `o`.
      **/
-    inline void append(Object* hd, Object* tl)
+    static Object* compact(Alloc& alloc, Object* o)
     {
-      Object* p = get_next();
-      tl->init_next(p);
-      set_next(hd);
-      if (last_large == nullptr)
-        last_large = tl;
+      Logging::cout() << "Region compact called for: " << o << Logging::endl;
+      RegionArena* reg = get(o);
+
+      if (reg->has_external_references() || (reg->source != nullptr))
+        return o;
+
+      Relocations relocs(alloc);
+      if (!reg->compact_mark(alloc, o, relocs))
+      {
+        Logging::cout() << "Region compact abandoned for: " << o
+                        << Logging::endl;
+        for (auto p : *reg)
+        {
+          if (p->get_class() == Object::MARKED)
+            p->unmark();
+        }
+        return o;
+      }
+
+      Arena* old_arenas = reg->first_arena;
+      reg->first_arena = nullptr;
+      reg->last_arena = nullptr;
+
+      // The old arenas are deallocated by the sweep, so they are not counted
+      // against the region's limits while the live objects are copied.
+      for (Arena* a = old_arenas; a != nullptr; a = a->next)
+        reg->current_memory_used -= a->arena_size();
+
+      o = reg->evacuate(alloc, old_arenas, o);
+      reg->fix_fields(alloc, o, relocs);
+      reg->sweep_evacuated(alloc, old_arenas, o);
+      reg->RememberedSet::sweep(alloc);
+      return o;
     }
 
     /**
-     * Allocate an object of type `desc` in the region. Returns a pointer to
-     * that object.
-     *
-     * If the object is too large to fit in an arena, new memory is allocated
-     * and the object is added to the large object ring.
-     *
-     * Otherwise, we check if the last arena has space. If so, the object is
-     * allocated there. If not, we allocate a new arena.
+     * Empty the region represented by the Iso object `o`, so that it can be
+     * refilled without calling the allocator. All the objects except `o` are
+     * finalised, destructed and deallocated, and unreachable subregions are
+     * released, as for a release of the region. One arena is kept, and
+     * rewound so that it holds only `o`, if `o` is in an arena. Returns the
+     * Iso object, which moves within the kept arena if it was not the first
+     * object allocated there; the caller must replace its reference to `o`
+     * with the result.
      *
-     * TODO(region): For now, we guarantee constant-time allocation and accept
-     * that we will have fragmentation. Later, we could try other strategies,
-     * e.g. first fit or best fit.
+     * `o` itself is not finalised or destructed, and its fields are left as
+     * they are, so those that pointed to other objects of the region must be
+     * overwritten before they are used. Its references to immutables, cowns
+     * and subregions are kept. The region must have no external references.
      **/
-    template<size_t size = 0>
-    Object* alloc_internal(Alloc& alloc, const Descriptor* desc)
+    static Object* reset(Alloc& alloc, Object* o)
     {
-      assert((size == 0) || (desc->size == size));
-
-      auto sz = size == 0 ? desc->size : size;
-      if (sz > Arena::SIZE)
+      Logging::cout() << "Region reset called for: " << o << Logging::endl;
+      RegionArena* reg = get(o);
+      assert(!reg->has_external_references());
+      assert(reg->source == nullptr);
+
+      // Keep the remembered set entries that `o` refers to.
+      ObjectStack fields(alloc);
+      o->trace(fields);
+      while (!fields.empty())
       {
-        // Allocate object.
-        void* p = nullptr;
-        if constexpr (size == 0)
-          p = alloc.alloc(desc->size);
-        else
-          p = alloc.alloc<size>();
+        Object* q = fields.pop();
+        switch (q->get_class())
+        {
+          case Object::SCC_PTR:
+            reg->RememberedSet::mark(alloc, q->immutable());
+            break;
 
-        auto o = Object::register_object(p, desc);
+          case Object::RC:
+          case Object::COWN:
+            reg->RememberedSet::mark(alloc, q);
+            break;
 
-        // Add to large object ring
-        append(o);
+          default:
+            break;
+        }
+      }
 
-        return o;
+      // As for `release_internal`, all the finalisers run before any
+      // destructor.
+      ObjectStack collect(alloc);
+      for (auto it = reg->begin<NonTrivial>(); it != reg->end<NonTrivial>();
+           ++it)
+      {
+        if (*it != o)
+          (*it)->finalise(o, collect);
       }
 
-      // If we don't have an arena, or the arena does not have enough space,
-      // allocate a new arena.
-      if (last_arena == nullptr || last_arena->free_space() < sz)
+      for (auto it = reg->begin<NonTrivial>(); it != reg->end<NonTrivial>();
+           ++it)
       {
-        void* p = alloc.alloc<sizeof(Arena)>();
-        Arena* a = new (p) Arena();
+        if (*it != o)
+          (*it)->destructor();
+      }
 
-        if (last_arena == nullptr)
-        {
-          first_arena = a;
-          last_arena = a;
-        }
-        else
+      // Deallocate the large object ring, except `o`, which is always last.
+      Object* p = reg->get_next();
+      while (p != reg)
+      {
+        Object* q = p->get_next_any_mark();
+        if (p != o)
         {
-          last_arena->next = a;
-          last_arena = a;
+          reg->current_memory_used -= p->size();
+          p->dealloc(alloc);
         }
-        assert(last_arena->next == nullptr);
+        p = q;
       }
 
-      // Allocate object within that arena.
-      return last_arena->alloc_obj(desc, sz);
-    }
-
-    void merge_internal(RegionArena* other)
-    {
-      // Merge arena linked lists.
-      if (last_arena == nullptr)
+      if (in_arena(o))
       {
-        assert(first_arena == nullptr);
-        first_arena = other->first_arena;
-        last_arena = other->last_arena;
+        reg->set_next(reg);
+        reg->last_large = nullptr;
       }
       else
       {
-        if (other->first_arena != nullptr)
+        reg->set_next(o);
+        reg->last_large = o;
+      }
+
+      // Keep the arena holding `o`, or else the first one.
+      Arena* keep = reg->first_arena;
+      for (Arena* a = reg->first_arena; a != nullptr; a = a->next)
+      {
+        if (a->contains(o))
+          keep = a;
+      }
+
+      Arena* arena = reg->first_arena;
+      while (arena != nullptr)
+      {
+        Arena* q = arena->next;
+        if (arena != keep)
         {
-          assert(other->last_arena != nullptr);
-          last_arena->next = other->first_arena;
-          last_arena = other->last_arena;
+          reg->current_memory_used -= arena->arena_size();
+          release_arena(alloc, arena);
         }
+        arena = q;
       }
 
-      // Merge large object ring.
-      Object* head = other->get_next();
-      if (head != other)
-        append(head, other->last_large);
+      reg->first_arena = keep;
+      reg->last_arena = keep;
+      if (keep != nullptr)
+      {
+        if (keep->contains(o))
+        {
+          o = keep->rewind(o);
+          o->init_iso();
+          o->set_region(reg);
+        }
+        else
+        {
+          keep->clear();
+        }
+      }
 
-      assert(last_arena != nullptr ? last_arena->next == nullptr : true);
-      assert(
-        last_large != nullptr ? last_large->get_next_any_mark() == this : true);
+      reg->RememberedSet::sweep(alloc);
+      reg->release_unreachable(alloc, collect);
+      return o;
     }
 
-    void swap_root_internal(Object* oroot, Object* nroot)
+    /**
+     * The start of an image made by `serialize`. The header is followed by
+     * the size of each segment, the relocations, and the bytes of the
+     * segments. All are in the byte order of the host.
+     *
+     * Each segment holds the objects of one arena, laid out as they are at
+     * the start of the arena. An offset in the image is `i * Arena::SIZE +
+     * j` for byte `j` of segment `i`, so it is independent of where the
+     * segments are loaded. Each relocation is the offset of a word shifted
+     * left by one, with the bottom bit set if the word is the index of a
+     * descriptor, and clear if it is the offset of an object.
+     **/
+    struct ImageHeader
     {
-      assert(debug_is_in_region(nroot));
-      size_t oroot_size =
-        snmalloc::bits::align_up(oroot->size(), Object::ALIGNMENT);
-      size_t nroot_size =
+      uint64_t magic;
+      uint64_t segments;
+      uint64_t relocations;
+      /// Offset of the Iso object.
+      uint64_t iso;
+    };
+
+    static constexpr uint64_t IMAGE_MAGIC = 0x4547414d49414e52; // "RNAIMAGE"
+
+    /**
+     * Returns an image of the region represented by the Iso object `o`,
+     * which `deserialize` turns back into an arena region, in this process
+     * or another one running the same program. The region may be of any
+     * type, and is left unchanged. Returns an empty image if the region
+     * cannot be serialized.
+     *
+     * Descriptors are not the same in every process, so they are stored as
+     * their index in `descriptors`, which must hold those of every object
+     * reachable from `o`, in the same order as when deserializing.
+     *
+     * Only the fields reported by `trace` are rewritten, so, as for
+     * `compact`, every pointer to an object of the region must be in such a
+     * field. The objects reachable from `o` must all be in the region, and
+     * must have no finaliser or destructor, as they may hold resources that
+     * cannot be moved to another process. They must also fit in an arena.
+     * The region must have no external references.
+     **/
+    static std::vector<std::byte> serialize(
+      Alloc& alloc,
+      Object* o,
+      const Descriptor* const* descriptors,
+      size_t count)
+    {
+      Logging::cout() << "Region serialize called for: " << o << Logging::endl;
+      assert(o->debug_is_iso());
+      std::vector<std::byte> image;
+      RegionBase* reg = o->get_region();
+      if (
+        reg->has_external_references() ||
+        (is_arena_region(reg) && (((RegionArena*)reg)->source != nullptr)))
+        return image;
+
+      std::vector<Object*> live;
+      Relocations relocs(alloc);
+      if (image_mark(alloc, o, descriptors, count, live, relocs))
+        image = image_write(alloc, o, descriptors, count, live, relocs);
+      else
+        Logging::cout() << "Region serialize abandoned for: " << o
+                        << Logging::endl;
+
+      for (auto p : live)
+      {
+        if (p->get_class() == Object::MARKED)
+          p->unmark();
+      }
+      return image;
+    }
+
+    /**
+     * Create an arena region from the `size` bytes of `image`, made by
+     * `serialize` with the same `descriptors`, and return its Iso object.
+     * The image may be mapped straight from a file. Returns nullptr if the
+     * image is malformed.
+     *
+     * Each segment is copied into an arena as a whole, and the words listed
+     * as relocations are then rewritten, so nothing depends on the classes
+     * of the objects. The image is not otherwise checked, so it must come
+     * from a trusted source.
+     **/
+    static Object* deserialize(
+      Alloc& alloc,
+      const void* image,
+      size_t size,
+      const Descriptor* const* descriptors,
+      size_t count)
+    {
+      ImageHeader h;
+      if (size < sizeof(h))
+        return nullptr;
+      std::memcpy(&h, image, sizeof(h));
+
+      size_t words = (size - sizeof(h)) / sizeof(uint64_t);
+      if (
+        (h.magic != IMAGE_MAGIC) || (h.segments > words) ||
+        (h.relocations > words - h.segments))
+        return nullptr;
+
+      auto sizes = (const std::byte*)image + sizeof(h);
+      auto relocations = sizes + h.segments * sizeof(uint64_t);
+      auto data = relocations + h.relocations * sizeof(uint64_t);
+      size_t remaining = (size_t)(((const std::byte*)image + size) - data);
+
+      std::vector<uint64_t> lengths(h.segments);
+      if (h.segments != 0)
+        std::memcpy(lengths.data(), sizes, h.segments * sizeof(uint64_t));
+      for (auto l : lengths)
+      {
+        if ((l > Arena::SIZE) || (l > remaining) || (l % Object::ALIGNMENT))
+          return nullptr;
+        remaining -= l;
+      }
+      if (remaining != 0)
+        return nullptr;
+
+      void* p = Object::register_object(
+        alloc.alloc<vsizeof<RegionArena>>(), RegionArena::desc());
+      RegionArena* reg = new (p) RegionArena();
+
+      std::vector<std::byte*> bases(h.segments);
+      for (size_t i = 0; i < h.segments; i++)
+      {
+        bases[i] =
+          (std::byte*)reg->append_arena(alloc)->alloc_bytes(lengths[i]);
+        std::memcpy(bases[i], data, lengths[i]);
+        data += lengths[i];
+      }
+
+      auto address = [&](uint64_t at) -> std::byte* {
+        uint64_t i = at / Arena::SIZE;
+        uint64_t j = at % Arena::SIZE;
+        if ((i >= h.segments) || (j >= lengths[i]) || (j % sizeof(void*)))
+          return nullptr;
+        return bases[i] + j;
+      };
+
+      bool ok = true;
+      for (size_t i = 0; ok && (i < h.relocations); i++)
+      {
+        uint64_t r;
+        std::memcpy(&r, relocations + i * sizeof(uint64_t), sizeof(r));
+        auto word = (uintptr_t*)address(r >> 1);
+        if (word == nullptr)
+          ok = false;
+        else if ((r & 1) != 0)
+        {
+          ok = *word < count;
+          if (ok)
+            *word = (uintptr_t)descriptors[*word];
+        }
+        else
+        {
+          std::byte* target = address(*word);
+          ok = target != nullptr;
+          *word = (uintptr_t)target;
+        }
+      }
+
+      auto o = (Object*)address(h.iso);
+      if (!ok || (o == nullptr))
+      {
+        Arena* arena = reg->first_arena;
+        while (arena != nullptr)
+        {
+          Arena* q = arena->next;
+          release_arena(alloc, arena);
+          arena = q;
+        }
+        reg->dealloc(alloc);
+        return nullptr;
+      }
+
+      o->init_iso();
+      o->set_region(reg);
+      Logging::cout() << "Region deserialized: " << o << Logging::endl;
+      return o;
+    }
+
+  private:
+    /**
+     * The pointers to objects that a compaction moves, found by tracing one
+     * object. Once sorted, they can be looked up for each word of the object,
+     * to find the fields that hold them.
+     **/
+    class Relocations
+    {
+      Alloc& alloc;
+
+      // The targets, followed by, for each distinct target after `check`, the
+      // number of times it was added and the number of words holding it.
+      Object** targets = nullptr;
+      size_t* counts = nullptr;
+      size_t size = 0;
+      size_t capacity = 0;
+
+    public:
+      Relocations(Alloc& alloc) : alloc(alloc) {}
+
+      ~Relocations()
+      {
+        if (capacity != 0)
+        {
+          alloc.dealloc(targets);
+          alloc.dealloc(counts);
+        }
+      }
+
+      void clear()
+      {
+        size = 0;
+      }
+
+      bool empty() const
+      {
+        return size == 0;
+      }
+
+      void add(Object* target)
+      {
+        if (size == capacity)
+        {
+          size_t c = std::max<size_t>(capacity * 2, 16);
+          auto t = (Object**)alloc.alloc(c * sizeof(Object*));
+          auto n = (size_t*)alloc.alloc(2 * c * sizeof(size_t));
+          if (capacity != 0)
+          {
+            std::memcpy(t, targets, size * sizeof(Object*));
+            alloc.dealloc(targets);
+            alloc.dealloc(counts);
+          }
+          targets = t;
+          counts = n;
+          capacity = c;
+        }
+        targets[size++] = target;
+      }
+
+      /**
+       * Returns true if each target is held by exactly as many words of `p`
+       * as it was added, so that those words are all fields reported by
+       * `trace`.
+       **/
+      bool check(Object* p)
+      {
+        std::sort(targets, targets + size);
+        size_t distinct = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+          if ((distinct == 0) || (targets[distinct - 1] != targets[i]))
+          {
+            targets[distinct] = targets[i];
+            counts[distinct] = 0;
+            counts[capacity + distinct] = 0;
+            distinct++;
+          }
+          counts[distinct - 1]++;
+        }
+        size = distinct;
+
+        Object** words = (Object**)p;
+        for (size_t w = 0; w < word_count(p); w++)
+        {
+          size_t i = find(words[w]);
+          if (i != size)
+            counts[capacity + i]++;
+        }
+
+        for (size_t i = 0; i < size; i++)
+        {
+          if (counts[i] != counts[capacity + i])
+            return false;
+        }
+        return true;
+      }
+
+      /**
+       * Rewrite each word of `p` that holds a target with the new address of
+       * that target.
+       **/
+      void fix(Object* p)
+      {
+        Object** words = (Object**)p;
+        for_each_word(p, [&](size_t w) { words[w] = forwarded(words[w]); });
+      }
+
+      /**
+       * Call `f` with the index of each word of `p` that holds a target.
+       **/
+      template<typename F>
+      void for_each_word(Object* p, F f)
+      {
+        std::sort(targets, targets + size);
+
+        Object** words = (Object**)p;
+        for (size_t w = 0; w < word_count(p); w++)
+        {
+          if (find(words[w]) != size)
+            f(w);
+        }
+      }
+
+    private:
+      static size_t word_count(Object* p)
+      {
+        return (p->size() - sizeof(Object::Header)) / sizeof(Object*);
+      }
+
+      size_t find(Object* w)
+      {
+        Object** i = std::lower_bound(targets, targets + size, w);
+        if ((i != targets + size) && (*i == w))
+          return (size_t)(i - targets);
+        return size;
+      }
+    };
+
+    /**
+     * Returns true if the object `p` of this region is allocated in an arena
+     * rather than in the large object ring.
+     **/
+    static bool in_arena(Object* p)
+    {
+      return snmalloc::bits::align_up(p->size(), Object::ALIGNMENT) <=
+        Arena::SIZE;
+    }
+
+    /**
+     * Returns true if a field pointing to `q`, in the region represented by
+     * the Iso object `o`, needs rewriting when the region is compacted.
+     **/
+    static bool moves(Object* o, Object* q)
+    {
+      switch (q->get_class())
+      {
+        case Object::ISO:
+          return (q == o) && in_arena(q);
+
+        case Object::UNMARKED:
+        case Object::MARKED:
+          return in_arena(q);
+
+        default:
+          return false;
+      }
+    }
+
+    /**
+     * During a compaction, returns true if `q` has been moved by `evacuate`,
+     * which leaves its new address in its header, marked.
+     **/
+    static bool is_forwarded(Object* q)
+    {
+      return (q->get_class() == Object::MARKED) && in_arena(q);
+    }
+
+    static Object* forwarded(Object* q)
+    {
+      return q->get_next_any_mark();
+    }
+
+    /**
+     * Mark the objects reachable from the Iso object `o`, and the immutables
+     * and cowns they reference in the RememberedSet. Returns false if the
+     * fields of a reachable object that point to objects in arenas cannot be
+     * told apart from its other words.
+     **/
+    bool compact_mark(Alloc& alloc, Object* o, Relocations& relocs)
+    {
+      ObjectStack dfs(alloc);
+      ObjectStack fields(alloc);
+      dfs.push(o);
+
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+            if (p != o)
+              continue;
+            break;
+
+          case Object::UNMARKED:
+            p->mark();
+            break;
+
+          case Object::MARKED:
+            continue;
+
+          case Object::SCC_PTR:
+            RememberedSet::mark(alloc, p->immutable());
+            continue;
+
+          case Object::RC:
+          case Object::COWN:
+            RememberedSet::mark(alloc, p);
+            continue;
+
+          default:
+            assert(0);
+            continue;
+        }
+
+        Logging::cout() << "Compact mark" << p << Logging::endl;
+        p->trace(fields);
+        relocs.clear();
+        while (!fields.empty())
+        {
+          Object* q = fields.pop();
+          if (moves(o, q))
+            relocs.add(q);
+          dfs.push(q);
+        }
+
+        if (!relocs.empty() && !relocs.check(p))
+          return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * Copy the marked objects, and the Iso object `o`, of the arenas starting
+     * at `arenas` into new arenas, leaving their new addresses in their
+     * headers. Returns the new Iso object.
+     **/
+    Object* evacuate(Alloc& alloc, Arena* arenas, Object* o)
+    {
+      Object* iso = o;
+      for (Arena* a = arenas; a != nullptr; a = a->next)
+      {
+        a->for_each([&](Object* p) {
+          if ((p != o) && (p->get_class() != Object::MARKED))
+            return;
+
+          Object* n = alloc_internal(alloc, p->get_descriptor());
+          std::memcpy(n, p, p->size() - sizeof(Object::Header));
+          if (p == o)
+          {
+            n->init_iso();
+            n->set_region(this);
+            iso = n;
+          }
+
+          p->init_next(n);
+          p->mark();
+        });
+      }
+      return iso;
+    }
+
+    /**
+     * Rewrite the fields of the live objects that point to objects moved by
+     * `evacuate`. The live objects are now those in the arenas, and those in
+     * the large object ring that are marked, or the Iso object `o`.
+     **/
+    void fix_fields(Alloc& alloc, Object* o, Relocations& relocs)
+    {
+      ObjectStack fields(alloc);
+      for (auto p : *this)
+      {
+        if (!in_arena(p) && (p->get_class() != Object::MARKED) && (p != o))
+          continue;
+
+        p->trace(fields);
+        relocs.clear();
+        while (!fields.empty())
+        {
+          Object* q = fields.pop();
+          if (is_forwarded(q))
+            relocs.add(q);
+        }
+
+        if (!relocs.empty())
+          relocs.fix(p);
+      }
+    }
+
+    /**
+     * Collect the unreachable objects after `evacuate`: those left unmarked
+     * in the arenas starting at `arenas`, which are then deallocated, and
+     * those in the large object ring. As for `release_internal`, all the
+     * finalisers run before any destructor.
+     **/
+    void sweep_evacuated(Alloc& alloc, Arena* arenas, Object* o)
+    {
+      ObjectStack collect(alloc);
+      auto dead = [](Object* p) {
+        return !p->is_trivial() && (p->get_class() == Object::UNMARKED);
+      };
+
+      for (Arena* a = arenas; a != nullptr; a = a->next)
+      {
+        a->for_each([&](Object* p) {
+          if (dead(p))
+            p->finalise(o, collect);
+        });
+      }
+      for (Object* p = get_next(); p != this; p = p->get_next_any_mark())
+      {
+        if (dead(p))
+          p->finalise(o, collect);
+      }
+
+      for (Arena* a = arenas; a != nullptr; a = a->next)
+      {
+        a->for_each([&](Object* p) {
+          if (dead(p))
+            p->destructor();
+        });
+      }
+
+      // Deallocate the unreachable large objects, and unmark the others.
+      Object* prev = this;
+      Object* p = get_next();
+      last_large = nullptr;
+      while (p != this)
+      {
+        Object* q = p->get_next_any_mark();
+        if (p->get_class() == Object::UNMARKED)
+        {
+          Logging::cout() << "Compact sweep" << p << Logging::endl;
+          current_memory_used -= p->size();
+          p->destructor();
+          p->dealloc(alloc);
+          if (prev == this)
+            set_next(q);
+          else
+            prev->init_next(q);
+        }
+        else
+        {
+          if (p->get_class() == Object::MARKED)
+            p->unmark();
+          prev = p;
+          last_large = p;
+        }
+        p = q;
+      }
+
+      while (arenas != nullptr)
+      {
+        Arena* q = arenas->next;
+        release_arena(alloc, arenas);
+        arenas = q;
+      }
+
+      release_unreachable(alloc, collect);
+    }
+
+    /**
+     * Returns the index of `desc` in `descriptors`, or `count` if it is not
+     * there.
+     **/
+    static size_t descriptor_index(
+      const Descriptor* desc,
+      const Descriptor* const* descriptors,
+      size_t count)
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        if (descriptors[i] == desc)
+          return i;
+      }
+      return count;
+    }
+
+    /**
+     * Mark the objects reachable from the Iso object `o`, and add them, and
+     * `o`, to `live`. Returns false if one of them cannot be serialized, see
+     * `serialize`.
+     **/
+    static bool image_mark(
+      Alloc& alloc,
+      Object* o,
+      const Descriptor* const* descriptors,
+      size_t count,
+      std::vector<Object*>& live,
+      Relocations& relocs)
+    {
+      ObjectStack dfs(alloc);
+      ObjectStack fields(alloc);
+      dfs.push(o);
+
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+            if (p != o)
+              return false;
+            if (!live.empty())
+              continue;
+            break;
+
+          case Object::UNMARKED:
+            p->mark();
+            break;
+
+          case Object::MARKED:
+            continue;
+
+          default:
+            // Immutables and cowns are shared with the rest of the process.
+            return false;
+        }
+
+        live.push_back(p);
+        if (
+          !p->is_trivial() || !in_arena(p) ||
+          (descriptor_index(p->get_descriptor(), descriptors, count) == count))
+          return false;
+
+        p->trace(fields);
+        relocs.clear();
+        while (!fields.empty())
+        {
+          Object* q = fields.pop();
+          relocs.add(q);
+          dfs.push(q);
+        }
+
+        if (!relocs.empty() && !relocs.check(p))
+          return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * Lay out the objects found by `image_mark` in segments, and return the
+     * image, see `ImageHeader`.
+     **/
+    static std::vector<std::byte> image_write(
+      Alloc& alloc,
+      Object* o,
+      const Descriptor* const* descriptors,
+      size_t count,
+      std::vector<Object*>& live,
+      Relocations& relocs)
+    {
+      // The offset of the header of each object, sorted by object so that
+      // the fields can be looked up.
+      std::vector<std::pair<Object*, uint64_t>> placed;
+      std::vector<uint64_t> lengths;
+      placed.reserve(live.size());
+      for (auto p : live)
+      {
+        size_t sz = snmalloc::bits::align_up(p->size(), Object::ALIGNMENT);
+        if (lengths.empty() || (lengths.back() + sz > Arena::SIZE))
+          lengths.push_back(0);
+        placed.push_back(
+          {p, (lengths.size() - 1) * Arena::SIZE + lengths.back()});
+        lengths.back() += sz;
+      }
+      std::sort(placed.begin(), placed.end());
+
+      auto offset_of = [&](Object* q) {
+        auto it = std::lower_bound(
+          placed.begin(),
+          placed.end(),
+          std::pair<Object*, uint64_t>(q, 0));
+        assert((it != placed.end()) && (it->first == q));
+        return it->second + sizeof(Object::Header);
+      };
+
+      std::vector<uint64_t> starts(lengths.size());
+      size_t total = 0;
+      for (size_t i = 0; i < lengths.size(); i++)
+      {
+        starts[i] = total;
+        total += lengths[i];
+      }
+
+      std::vector<std::byte> data(total);
+      std::vector<uint64_t> relocations;
+      ObjectStack fields(alloc);
+      for (auto [p, at] : placed)
+      {
+        std::byte* to = data.data() + starts[at / Arena::SIZE] +
+          (at % Arena::SIZE);
+        std::memcpy(to, p->real_start(), p->size());
+
+        // The header is unmarked, with no next object, as in an arena, and
+        // the descriptor is its second word.
+        auto header = (uintptr_t*)to;
+        header[0] = 0;
+        header[1] = descriptor_index(p->get_descriptor(), descriptors, count);
+        relocations.push_back(((at + sizeof(uintptr_t)) << 1) | 1);
+
+        p->trace(fields);
+        relocs.clear();
+        while (!fields.empty())
+          relocs.add(fields.pop());
+
+        uint64_t body = at + sizeof(Object::Header);
+        auto from = (Object**)p;
+        auto words = (uintptr_t*)(to + sizeof(Object::Header));
+        relocs.for_each_word(p, [&](size_t w) {
+          words[w] = offset_of(from[w]);
+          relocations.push_back((body + w * sizeof(uintptr_t)) << 1);
+        });
+      }
+
+      ImageHeader h{
+        IMAGE_MAGIC, lengths.size(), relocations.size(), offset_of(o)};
+
+      std::vector<std::byte> image(
+        sizeof(h) + (lengths.size() + relocations.size()) * sizeof(uint64_t) +
+        total);
+      std::byte* out = image.data();
+      auto put = [&](const void* bytes, size_t size) {
+        if (size != 0)
+          std::memcpy(out, bytes, size);
+        out += size;
+      };
+      put(&h, sizeof(h));
+      put(lengths.data(), lengths.size() * sizeof(uint64_t));
+      put(relocations.data(), relocations.size() * sizeof(uint64_t));
+      put(data.data(), total);
+      return image;
+    }
+
+    /**
+     * Append an empty arena of the size of this region to its arenas.
+     **/
+    Arena* append_arena(Alloc& alloc)
+    {
+      check_limit(current_memory_used, arena_size);
+      current_memory_used += arena_size;
+      Arena* a = (source == nullptr) ?
+        acquire_arena(alloc, arena_size) :
+        new (source->alloc_chunk(arena_size)) Arena(arena_size);
+
+      if (last_arena == nullptr)
+      {
+        first_arena = a;
+        last_arena = a;
+      }
+      else
+      {
+        last_arena->next = a;
+        last_arena = a;
+      }
+      assert(last_arena->next == nullptr);
+      return a;
+    }
+
+    /**
+     * Release the unreachable subregions in `collect`, found by a compaction
+     * or a reset. This is defined in region.h, as it dispatches on the region
+     * type.
+     **/
+    void release_unreachable(Alloc& alloc, ObjectStack& collect);
+
+  private:
+    inline void append(Object* hd)
+    {
+      append(hd, hd);
+    }
+
+    /**
+     * Inserts the object `hd` into the large object ring, right after the
+     * region metadata object. `tl` is used for merging two rings; if there is
+     * only one ring, then hd == tl.
+     **/
+    inline void append(Object* hd, Object* tl)
+    {
+      Object* p = get_next();
+      tl->init_next(p);
+      set_next(hd);
+      if (last_large == nullptr)
+        last_large = tl;
+    }
+
+    /**
+     * Allocate an object of type `desc` in the region. Returns a pointer to
+     * that object.
+     *
+     * If the object is too large to fit in an arena, new memory is allocated
+     * and the object is added to the large object ring.
+     *
+     * Otherwise, we check if the last arena has space. If so, the object is
+     * allocated there. If not, we allocate a new arena.
+     *
+     * TODO(region): For now, we guarantee constant-time allocation and accept
+     * that we will have fragmentation. Later, we could try other strategies,
+     * e.g. first fit or best fit.
+     *
+     * The common case, where the last arena has space, is a pointer bump
+     * that is inlined into the caller. Everything else is in `alloc_slow`,
+     * so that the fast path stays small, even in tight allocation loops.
+     **/
+    template<size_t size = 0>
+    SNMALLOC_FAST_PATH Object*
+    alloc_internal(Alloc& alloc, const Descriptor* desc)
+    {
+      assert((size == 0) || (desc->size == size));
+
+      auto sz = size == 0 ? desc->size : size;
+      if (SNMALLOC_LIKELY(
+            (sz <= Arena::SIZE) && (last_arena != nullptr) &&
+            (last_arena->free_space() >= sz)))
+        return last_arena->alloc_obj(desc, sz);
+
+      return alloc_slow(alloc, desc, sz);
+    }
+
+    /**
+     * The slow path of `alloc_internal`, for an object of `sz` bytes that is
+     * too large for an arena, or that doesn't fit in the last arena.
+     **/
+    SNMALLOC_SLOW_PATH Object*
+    alloc_slow(Alloc& alloc, const Descriptor* desc, size_t sz)
+    {
+      if (sz > Arena::SIZE)
+      {
+        check_limit(current_memory_used, sz);
+        current_memory_used += sz;
+
+        // Allocate object.
+        void* p =
+          (source == nullptr) ? alloc.alloc(sz) : source->alloc_chunk(sz);
+        auto o = Object::register_object(p, desc);
+
+        // Add to large object ring
+        append(o);
+
+        return o;
+      }
+
+      // We don't have an arena, or the arena does not have enough space, so
+      // allocate a new arena, and the object within it.
+      return append_arena(alloc)->alloc_obj(desc, sz);
+    }
+
+    void merge_internal(RegionArena* other)
+    {
+      // Merge arena linked lists.
+      if (last_arena == nullptr)
+      {
+        assert(first_arena == nullptr);
+        first_arena = other->first_arena;
+        last_arena = other->last_arena;
+      }
+      else
+      {
+        if (other->first_arena != nullptr)
+        {
+          assert(other->last_arena != nullptr);
+          last_arena->next = other->first_arena;
+          last_arena = other->last_arena;
+        }
+      }
+
+      current_memory_used += other->current_memory_used;
+
+      // Merge large object ring.
+      Object* head = other->get_next();
+      if (head != other)
+        append(head, other->last_large);
+
+      assert(last_arena != nullptr ? last_arena->next == nullptr : true);
+      assert(
+        last_large != nullptr ? last_large->get_next_any_mark() == this : true);
+    }
+
+    void swap_root_internal(Object* oroot, Object* nroot)
+    {
+      assert(debug_is_in_region(nroot));
+      size_t oroot_size =
+        snmalloc::bits::align_up(oroot->size(), Object::ALIGNMENT);
+      size_t nroot_size =
         snmalloc::bits::align_up(nroot->size(), Object::ALIGNMENT);
 
       if (oroot_size <= Arena::SIZE)
@@ -546,12 +1828,22 @@ namespace verona::rt
      **/
     void release_internal(Alloc& alloc, Object* o, ObjectStack& collect)
     {
+      Logging::cout() << "Region release: arena region: " << o << Logging::endl;
+
+      // All the objects of a region with a source are trivial, and all its
+      // memory goes back to the source at once, so none of it is read.
+      if (source != nullptr)
+      {
+        source->release();
+        RememberedSet::sweep(alloc);
+        dealloc(alloc);
+        return;
+      }
+
       assert(o->debug_is_iso());
       // Don't trace or finalise o, we'll do it when looping over the large
       // object ring or the arena list.
 
-      Logging::cout() << "Region release: arena region: " << o << Logging::endl;
-
       // Clean up all the non-trivial objects, by running the finaliser and
       // destructor, and collecting iso regions.
       // Finalisers must provide all the isos of the current object that will
@@ -585,7 +1877,7 @@ namespace verona::rt
       while (arena != nullptr)
       {
         Arena* q = arena->next;
-        alloc.dealloc<sizeof(Arena)>(arena);
+        release_arena(alloc, arena);
         arena = q;
       }
 
@@ -630,8 +1922,11 @@ namespace verona::rt
         }
         else
         {
-          // Currenty iterating through the large object ring.
+          // Currenty iterating through the large object ring. The caller works
+          // on `ptr`, meanwhile fetch the object after it.
           ptr = next_in_ring(ptr);
+          if (ptr != nullptr)
+            ptr->get_next_any_mark()->prefetch();
         }
         return *this;
       }
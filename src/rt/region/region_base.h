@@ -17,6 +17,10 @@ namespace verona::rt
    * all the common functionality. Because of difficulties with dependencies,
    * this class is intentionally minimal and contains no helpers---it is not
    * aware of any of the concrete region implementation classes.
+   *
+   * A region may have memory limits, see `Region::set_limits`. Above its soft
+   * limit, a region is collected whenever it is checked, see `GCPolicy`.
+   * Allocating in a region past its hard limit calls the limit handler first.
    **/
 
   enum class RegionType
@@ -24,6 +28,7 @@ namespace verona::rt
     Trace,
     Arena,
     Rc,
+    Hybrid,
   };
 
   class RegionBase : public Object,
@@ -34,6 +39,7 @@ namespace verona::rt
     friend class RegionTrace;
     friend class RegionArena;
     friend class RegionRc;
+    friend class RegionHybrid;
 
   public:
     enum IteratorType
@@ -43,9 +49,76 @@ namespace verona::rt
       AllObjects,
     };
 
+    /**
+     * Called when an allocation of `size` bytes would take a region using
+     * `used` bytes past its hard limit. If the handler returns, the
+     * allocation goes ahead, so it must throw, abort, or accept the overrun.
+     **/
+    using LimitHandler = void (*)(RegionBase* r, size_t used, size_t size);
+
     RegionBase() : Object() {}
 
+    /**
+     * Sets the handler called by all regions that exceed their hard limit.
+     * Without a handler, exceeding a hard limit aborts.
+     **/
+    static void set_limit_handler(LimitHandler handler)
+    {
+      limit_handler() = handler;
+    }
+
+    /**
+     * Sets the memory limits of this region, in bytes. Zero means no limit.
+     **/
+    void set_limits(size_t soft, size_t hard)
+    {
+      assert((soft == 0) || (hard == 0) || (soft <= hard));
+      soft_limit = soft;
+      hard_limit = hard;
+    }
+
+    size_t get_soft_limit() const
+    {
+      return soft_limit;
+    }
+
+    size_t get_hard_limit() const
+    {
+      return hard_limit;
+    }
+
   private:
+    size_t soft_limit = 0;
+    size_t hard_limit = 0;
+
+    static LimitHandler& limit_handler()
+    {
+      static LimitHandler handler = nullptr;
+      return handler;
+    }
+
+    /**
+     * Called by the region before it grows from `used` to `used + size`
+     * bytes for an allocation.
+     **/
+    inline void check_limit(size_t used, size_t size)
+    {
+      if (SNMALLOC_UNLIKELY((hard_limit != 0) && (used + size > hard_limit)))
+        limit_exceeded(used, size);
+    }
+
+    void limit_exceeded(size_t used, size_t size)
+    {
+      Logging::cout() << "Region limit exceeded: " << this << " using " << used
+                      << " allocating " << size << Logging::endl;
+
+      LimitHandler handler = limit_handler();
+      if (handler == nullptr)
+        abort();
+
+      handler(this, used, size);
+    }
+
     inline void dealloc(Alloc& alloc)
     {
       ExternalReferenceTable::dealloc(alloc);
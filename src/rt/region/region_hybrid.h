@@ -0,0 +1,957 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "gc_policy.h"
+#include "region_base.h"
+
+#include <cstddef>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Please see region.h for the full documentation.
+   *
+   * This is a concrete implementation of a region that is garbage collected
+   * by tracing, like RegionTrace, but bump-allocates its small trivial objects
+   * in chunks, like RegionArena. This class inherits from RegionBase, but it
+   * cannot call any of the static methods in Region.
+   *
+   * Trivial objects (ie. those with no destructor and no finaliser) of at most
+   * `BUMP_SIZE` bytes are allocated in chunks. As in an arena, the next
+   * pointer of an object in a chunk is null. Each chunk has two bitmaps, with
+   * a bit per `Object::ALIGNMENT` bytes of the chunk:
+   *   - `live`, the objects that were allocated since, or survived, the
+   *     previous collection, and
+   *   - `marks`, the objects marked by the current collection.
+   * So marking an object in a chunk does not write to the object. At the end
+   * of a collection the marks become the live objects, and a chunk without
+   * any marks is returned to the allocator. The memory of a dead object in a
+   * chunk that is still in use is not reused.
+   *
+   * All other objects are allocated by snmalloc and placed into the object
+   * ring, a circular linked list of objects accessed via the Object::next
+   * pointer. As for the large object ring of RegionArena, this ring mixes both
+   * trivial and non-trivial objects, and if the iso object is in the ring then
+   * it must be in the last position, so it can point to the region metadata
+   * object. We keep a pointer to the last object in the ring, to ensure merges
+   * are fast.
+   **/
+  class RegionHybrid : public RegionBase
+  {
+  public:
+    // Need to foward declare so Chunk can declare a friend class.
+    template<IteratorType type>
+    class iterator;
+
+    /**
+     * Trivial objects of at most this size, in bytes, are bump-allocated in
+     * chunks.
+     **/
+    static constexpr size_t BUMP_SIZE = 1024;
+
+    /**
+     * The size of a chunk, which is also its alignment.
+     **/
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+  private:
+    friend class Region;
+    friend class RegionTrace;
+    friend class RegionRc;
+
+    /**
+     * A Chunk is a block of `CHUNK_SIZE` bytes, aligned to its size, so the
+     * chunk of an object can be found from the object's address. It has an
+     * overhead of two pointers and two bitmaps, with a bit per granule of
+     * `Object::ALIGNMENT` bytes in each bitmap. An object's bits are those of
+     * the granule where its header starts.
+     *
+     * Objects are allocated from the beginning of the chunk, and `top` points
+     * to the first byte after the last object.
+     **/
+    class Chunk
+    {
+      template<IteratorType type>
+      friend class RegionHybrid::iterator;
+      friend class RegionHybrid;
+
+      static constexpr size_t BITS = bits::BITS;
+
+      /**
+       * Number of granules in a chunk, rounded down to whole bitmap words.
+       * Each granule uses `Object::ALIGNMENT` bytes and two bits, after the
+       * header of the chunk.
+       **/
+      static constexpr size_t GRANULES =
+        (((CHUNK_SIZE - 4 * sizeof(uintptr_t)) * 8) /
+         (8 * Object::ALIGNMENT + 2)) /
+        BITS * BITS;
+
+      static constexpr size_t WORDS = GRANULES / BITS;
+
+    public:
+      static constexpr size_t SIZE = GRANULES * Object::ALIGNMENT;
+
+      /**
+       * Pointer to next chunk in the linked list.
+       **/
+      Chunk* next;
+
+    private:
+      /**
+       * Pointer to one past the last allocated object, i.e. where the next
+       * object will be allocated, assuming sufficient space.
+       **/
+      std::byte* top;
+
+      size_t live[WORDS];
+      size_t marks[WORDS];
+
+      /**
+       * Where objects will actually be allocated.
+       **/
+      alignas(Object::ALIGNMENT) std::byte objects_begin[SIZE];
+
+    public:
+      Chunk() : next(nullptr), top(objects_begin), live{}, marks{} {}
+
+      inline static Chunk* of(Object* o)
+      {
+        return (Chunk*)((uintptr_t)o->real_start() & ~(CHUNK_SIZE - 1));
+      }
+
+      inline size_t free_space() const
+      {
+        return (size_t)((objects_begin + SIZE) - top);
+      }
+
+      /**
+       * Allocates an object of type `desc` within the chunk. `sz` is how much
+       * space the object will take up, accounting for padding to ensure
+       * alignment. The object is live until the next collection.
+       **/
+      Object* alloc_obj(const Descriptor* desc, size_t sz)
+      {
+        assert(free_space() >= sz);
+
+        void* p = top;
+        top += sz;
+
+        auto o = Object::register_object(p, desc);
+        o->init_next(nullptr);
+        set(live, index(o));
+        return o;
+      }
+
+      /**
+       * Mark `o`. Returns false if it was already marked.
+       **/
+      inline bool mark(Object* o)
+      {
+        size_t i = index(o);
+        if (test(marks, i))
+          return false;
+
+        set(marks, i);
+        return true;
+      }
+
+    private:
+      inline size_t index(Object* o) const
+      {
+        assert((o->real_start() >= objects_begin) && (o->real_start() < top));
+        return (size_t)(o->real_start() - objects_begin) / Object::ALIGNMENT;
+      }
+
+      inline Object* object_at(size_t i)
+      {
+        return Object::object_start(objects_begin + (i * Object::ALIGNMENT));
+      }
+
+      /**
+       * The number of bitmap words that cover allocated objects.
+       **/
+      inline size_t words_used() const
+      {
+        size_t granules = (size_t)(top - objects_begin) / Object::ALIGNMENT;
+        return (granules + BITS - 1) / BITS;
+      }
+
+      /**
+       * Returns the index of the first live object at or after index `i`, or
+       * `GRANULES` if there is none.
+       **/
+      size_t next_live(size_t i) const
+      {
+        size_t w = i / BITS;
+        size_t used = words_used();
+        if (w >= used)
+          return GRANULES;
+
+        size_t word = live[w] & (~(size_t)0 << (i % BITS));
+        while (word == 0)
+        {
+          if (++w >= used)
+            return GRANULES;
+          word = live[w];
+        }
+        return (w * BITS) + bits::ctz(word);
+      }
+
+      inline static bool test(const size_t* bitmap, size_t i)
+      {
+        return (bitmap[i / BITS] & ((size_t)1 << (i % BITS))) != 0;
+      }
+
+      inline static void set(size_t* bitmap, size_t i)
+      {
+        bitmap[i / BITS] |= (size_t)1 << (i % BITS);
+      }
+    };
+    static_assert(sizeof(Chunk) <= CHUNK_SIZE);
+
+    /**
+     * Pointer to the linked list of chunks where small trivial objects are
+     * allocated. May be null.
+     **/
+    Chunk* first_chunk;
+
+    /**
+     * Pointer to the last chunk in the linked list of chunks, which is the
+     * one objects are allocated in. May be null.
+     **/
+    Chunk* last_chunk;
+
+    /**
+     * Pointer to the last (possibly iso) object in the object ring, or null if
+     * the ring is empty. We use the Object::next pointer for the "first"
+     * object in the ring.
+     **/
+    Object* last_ring;
+
+    // Memory usage in the region. Each chunk counts as `CHUNK_SIZE`.
+    size_t current_memory_used = 0;
+
+    // Memory usage in the region after the previous collection.
+    size_t previous_memory_used = 0;
+
+    RegionHybrid()
+    : RegionBase(), first_chunk(nullptr), last_chunk(nullptr), last_ring(nullptr)
+    {
+      init_next(this);
+    }
+
+    static const Descriptor* desc()
+    {
+      static constexpr Descriptor desc = {
+        vsizeof<RegionHybrid>, nullptr, nullptr, nullptr};
+
+      return &desc;
+    }
+
+  public:
+    inline static RegionHybrid* get(Object* o)
+    {
+      assert(o->debug_is_iso());
+      assert(is_hybrid_region(o->get_region()));
+      return (RegionHybrid*)o->get_region();
+    }
+
+    inline static bool is_hybrid_region(Object* o)
+    {
+      return o->is_type(desc());
+    }
+
+    /**
+     * Returns true if objects of type `desc` are allocated in chunks.
+     **/
+    inline static bool is_bumped(const Descriptor* desc)
+    {
+      return Object::is_trivial(desc) &&
+        (bits::align_up(desc->size, Object::ALIGNMENT) <= BUMP_SIZE);
+    }
+
+    /**
+     * Creates a new hybrid region by allocating Object `o` of type `desc`. The
+     * object is initialised as the Iso object for that region, and points to a
+     * newly created Region metadata object. Returns a pointer to `o`.
+     *
+     * The default template parameter `size = 0` is to avoid writing two
+     * definitions which differ only in one line. This overload works because
+     * every object must contain a descriptor, so 0 is not a valid size.
+     **/
+    template<size_t size = 0>
+    static Object* create(Alloc& alloc, const Descriptor* desc)
+    {
+      void* p = Object::register_object(
+        alloc.alloc<vsizeof<RegionHybrid>>(), RegionHybrid::desc());
+      RegionHybrid* reg = new (p) RegionHybrid();
+
+      // o might be allocated in a chunk or the object ring.
+      Object* o = reg->alloc_internal<size>(alloc, desc);
+      assert(Object::debug_is_aligned(o));
+
+      o->init_iso();
+      o->set_region(reg);
+      assert(
+        reg->last_ring != nullptr ?
+          reg->last_ring->get_next_any_mark() == reg :
+          true);
+
+      return o;
+    }
+
+    /**
+     * Allocates an object `o` of type `desc` in the region represented by the
+     * Iso object `in`. `o` will be allocated in a chunk or the object ring.
+     * Returns a pointer to `o`.
+     *
+     * The default template parameter `size = 0` is to avoid writing two
+     * definitions which differ only in one line. This overload works because
+     * every object must contain a descriptor, so 0 is not a valid size.
+     **/
+    template<size_t size = 0>
+    static Object* alloc(Alloc& alloc, Object* in, const Descriptor* desc)
+    {
+      RegionHybrid* reg = get(in);
+      Object* o = reg->alloc_internal<size>(alloc, desc);
+      assert(Object::debug_is_aligned(o));
+      return o;
+    }
+
+    /**
+     * Insert the Object `o` into the RememberedSet of `into`'s region.
+     *
+     * If ownership of a reference count is being transfered to the region,
+     * pass the template argument `transfer = YesTransfer`.
+     **/
+    template<TransferOwnership transfer = NoTransfer>
+    static void insert(Alloc& alloc, Object* into, Object* o)
+    {
+      assert(o->debug_is_immutable() || o->debug_is_cown());
+      RegionHybrid* reg = get(into);
+
+      Object::RegionMD c;
+      o = o->root_and_class(c);
+      reg->RememberedSet::insert<transfer>(alloc, o);
+    }
+
+    /**
+     * Merges `o`'s region into `into`'s region. Both regions must be separate
+     * and be hybrid regions.
+     **/
+    static void merge(Alloc& alloc, Object* into, Object* o)
+    {
+      assert(o->debug_is_iso());
+      RegionHybrid* reg = get(into);
+      RegionBase* other = o->get_region();
+      assert(reg != other);
+
+      if (is_hybrid_region(other))
+        reg->merge_internal(o, (RegionHybrid*)other);
+      else
+        abort();
+
+      // Merge the ExternalRefTable and RememberedSet.
+      reg->ExternalReferenceTable::merge(alloc, other);
+      reg->RememberedSet::merge(alloc, other);
+
+      // Now we can deallocate the other region's metadata object.
+      other->dealloc(alloc);
+    }
+
+    /**
+     * Swap the Iso (root) Object of a region, `prev`, with another Object
+     * within that region, `next`.
+     **/
+    static void swap_root(Object* prev, Object* next)
+    {
+      assert(prev != next);
+      assert(prev->debug_is_iso());
+      assert(next->debug_is_mutable());
+      assert(prev->get_region() != next);
+
+      RegionHybrid* reg = get(prev);
+      reg->swap_root_internal(prev, next);
+    }
+
+    /**
+     * Run a garbage collection on the region represented by the Object `o`.
+     * Only `o`'s region will be GC'd; we ignore pointers to Immutables and
+     * other regions.
+     **/
+    static void gc(Alloc& alloc, Object* o)
+    {
+      Logging::cout() << "Region GC called for: " << o << Logging::endl;
+      assert(o->debug_is_iso());
+      assert(is_hybrid_region(o->get_region()));
+
+      RegionHybrid* reg = get(o);
+      ObjectStack f(alloc);
+      ObjectStack collect(alloc);
+
+      reg->mark(alloc, o, f);
+      reg->sweep(alloc, o, collect);
+      reg->release_unreachable(alloc, collect);
+    }
+
+    /**
+     * Returns true if the region has grown enough since its previous
+     * collection to be collected, see `GCPolicy`.
+     **/
+    bool should_gc() const
+    {
+      return GCPolicy::should_collect(
+        current_memory_used, previous_memory_used, soft_limit);
+    }
+
+    /**
+     * Returns the number of bytes of objects in the region. This includes
+     * the whole of each chunk that bump-allocated objects are placed in.
+     **/
+    size_t memory_used() const
+    {
+      return current_memory_used;
+    }
+
+  private:
+    inline void append(Object* hd)
+    {
+      append(hd, hd);
+    }
+
+    /**
+     * Inserts the object `hd` into the object ring, right after the region
+     * metadata object. `tl` is used for merging two rings; if there is only
+     * one ring, then hd == tl.
+     **/
+    inline void append(Object* hd, Object* tl)
+    {
+      Object* p = get_next();
+      tl->init_next(p);
+      set_next(hd);
+      if (last_ring == nullptr)
+        last_ring = tl;
+    }
+
+    /**
+     * Allocate an object of type `desc` in the region. Returns a pointer to
+     * that object.
+     *
+     * Small trivial objects are allocated in the last chunk, or in a new chunk
+     * if it does not have enough space. Other objects are allocated by
+     * snmalloc and added to the object ring.
+     **/
+    template<size_t size = 0>
+    Object* alloc_internal(Alloc& alloc, const Descriptor* desc)
+    {
+      assert((size == 0) || (desc->size == size));
+
+      if (!is_bumped(desc))
+      {
+        check_limit(current_memory_used, desc->size);
+        void* p = nullptr;
+        if constexpr (size == 0)
+          p = alloc.alloc(desc->size);
+        else
+          p = alloc.alloc<size>();
+
+        auto o = Object::register_object(p, desc);
+        append(o);
+        use_memory(desc->size);
+        return o;
+      }
+
+      size_t sz = bits::align_up(desc->size, Object::ALIGNMENT);
+      if (last_chunk == nullptr || last_chunk->free_space() < sz)
+      {
+        check_limit(current_memory_used, CHUNK_SIZE);
+        void* p = alloc.alloc<CHUNK_SIZE>();
+        assert(((uintptr_t)p & (CHUNK_SIZE - 1)) == 0);
+        Chunk* c = new (p) Chunk();
+
+        if (last_chunk == nullptr)
+          first_chunk = c;
+        else
+          last_chunk->next = c;
+        last_chunk = c;
+        use_memory(CHUNK_SIZE);
+      }
+
+      return last_chunk->alloc_obj(desc, sz);
+    }
+
+    void merge_internal(Object* o, RegionHybrid* other)
+    {
+      // Clear the iso bit on `o`, if it's in a chunk. Otherwise, it's the last
+      // object of the other ring, and will point to some other object.
+      if (is_bumped(o->get_descriptor()))
+        o->init_next(nullptr);
+
+      // Merge chunk linked lists.
+      if (other->first_chunk != nullptr)
+      {
+        if (last_chunk == nullptr)
+          first_chunk = other->first_chunk;
+        else
+          last_chunk->next = other->first_chunk;
+        last_chunk = other->last_chunk;
+      }
+
+      // Merge object ring.
+      Object* head = other->get_next();
+      if (head != other)
+        append(head, other->last_ring);
+
+      // Update memory usage.
+      current_memory_used += other->current_memory_used;
+      previous_memory_used += other->previous_memory_used;
+
+      assert(last_chunk != nullptr ? last_chunk->next == nullptr : true);
+      assert(
+        last_ring != nullptr ? last_ring->get_next_any_mark() == this : true);
+    }
+
+    void swap_root_internal(Object* oroot, Object* nroot)
+    {
+      assert(debug_is_in_region(nroot));
+      bool nroot_in_ring = !is_bumped(nroot->get_descriptor());
+
+      if (is_bumped(oroot->get_descriptor()))
+      {
+        // Old root is inside a chunk, so we set its next to nullptr.
+        oroot->init_next(nullptr);
+      }
+      else
+      {
+        // Old root is in the object ring.
+        assert(oroot == last_ring);
+        if (!nroot_in_ring)
+        {
+          // Clear the iso bit on the old root.
+          oroot->init_next(this);
+        }
+      }
+
+      // New root is in the object ring, need to move it to the last position
+      // in the ring. Don't do anything if it's already last.
+      if (nroot != last_ring && nroot_in_ring)
+      {
+        Object* x = get_next();
+        Object* y = nroot->get_next();
+        last_ring->init_next(x);
+        set_next(y);
+        last_ring = nroot;
+      }
+
+      // Doesn't matter where the new root is, we have to set its iso bit and
+      // have it point to the region metadata object.
+      nroot->init_iso();
+      nroot->set_region(this);
+
+      assert(
+        last_ring != nullptr ? last_ring->get_next_any_mark() == this : true);
+    }
+
+    /**
+     * Scan through the region and mark all objects reachable from the iso
+     * object `o`. We don't follow pointers to subregions. Also will trace
+     * from anything already in `dfs`.
+     **/
+    void mark(Alloc& alloc, Object* o, ObjectStack& dfs)
+    {
+      // The iso object is never marked, but its chunk must survive.
+      if (is_bumped(o->get_descriptor()))
+        Chunk::of(o)->mark(o);
+
+      o->trace(dfs);
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          case Object::MARKED:
+            break;
+
+          case Object::UNMARKED:
+            if (is_bumped(p->get_descriptor()))
+            {
+              if (!Chunk::of(p)->mark(p))
+                break;
+            }
+            else
+            {
+              p->mark();
+            }
+
+            Logging::cout() << "Mark" << p << Logging::endl;
+            p->trace(dfs);
+            break;
+
+          case Object::SCC_PTR:
+            p = p->immutable();
+            RememberedSet::mark(alloc, p);
+            break;
+
+          case Object::RC:
+          case Object::COWN:
+            RememberedSet::mark(alloc, p);
+            break;
+
+          default:
+            assert(0);
+        }
+      }
+    }
+
+    /**
+     * Sweep and deallocate all unmarked objects in the region. If we find an
+     * unmarked object that points to a subregion, we add it to `collect` so we
+     * can release it later.
+     *
+     * The object ring is swept first, as its finalisers and destructors could
+     * refer to objects in the chunks.
+     **/
+    void sweep(Alloc& alloc, Object* o, ObjectStack& collect)
+    {
+      current_memory_used = 0;
+
+      sweep_ring(alloc, o, collect);
+      sweep_chunks(alloc);
+
+      RememberedSet::sweep(alloc);
+      previous_memory_used = current_memory_used;
+    }
+
+    void sweep_ring(Alloc& alloc, Object* o, ObjectStack& collect)
+    {
+      Object* prev = this;
+      Object* p = get_next();
+      LinkedObjectStack gc;
+
+      // Note: we don't use the iterator because we need to remove and
+      // deallocate objects from the ring.
+      while (p != this)
+      {
+        switch (p->get_class())
+        {
+          case Object::ISO:
+          {
+            // An iso is always the root, and the last thing in the ring.
+            assert(p == o);
+            assert(p->get_next_any_mark() == this);
+            use_memory(p->size());
+            p = this;
+            break;
+          }
+
+          case Object::MARKED:
+          {
+            use_memory(p->size());
+            p->unmark();
+            prev = p;
+            p = p->get_next();
+            break;
+          }
+
+          case Object::UNMARKED:
+          {
+            Object* q = p->get_next();
+            Logging::cout() << "Sweep " << p << Logging::endl;
+
+            // p is about to be collected; remove the entry for it in the
+            // ExternalRefTable.
+            if (p->has_ext_ref())
+              ExternalReferenceTable::erase(alloc, p);
+
+            if (!p->is_trivial())
+              p->finalise(o, collect);
+
+            prev->set_next(q);
+            if (last_ring == p)
+              last_ring = (prev == this) ? nullptr : prev;
+
+            // We can't deallocate the object yet, as other objects'
+            // finalisers may look at it.
+            gc.push(p);
+            p = q;
+            break;
+          }
+
+          default:
+            assert(0);
+        }
+      }
+
+      while (!gc.empty())
+      {
+        Object* q = gc.pop();
+        q->destructor();
+        q->dealloc(alloc);
+      }
+    }
+
+    /**
+     * Sweep every chunk, deallocating the chunks without any marked object.
+     **/
+    void sweep_chunks(Alloc& alloc)
+    {
+      Chunk* prev = nullptr;
+      Chunk* c = first_chunk;
+
+      while (c != nullptr)
+      {
+        Chunk* next = c->next;
+        if (sweep_chunk(alloc, c))
+        {
+          if (prev == nullptr)
+            first_chunk = next;
+          else
+            prev->next = next;
+          alloc.dealloc<CHUNK_SIZE>(c);
+        }
+        else
+        {
+          use_memory(CHUNK_SIZE);
+          prev = c;
+        }
+        c = next;
+      }
+
+      last_chunk = prev;
+    }
+
+    /**
+     * Sweep the chunk `c`: live objects that are not marked are dead. The
+     * marks become the live objects. Returns true if the chunk has no live
+     * objects left.
+     **/
+    bool sweep_chunk(Alloc& alloc, Chunk* c)
+    {
+      bool empty = true;
+      size_t used = c->words_used();
+
+      for (size_t w = 0; w < used; w++)
+      {
+        size_t dead = c->live[w] & ~c->marks[w];
+        while (dead != 0)
+        {
+          Object* p = c->object_at((w * Chunk::BITS) + bits::ctz(dead));
+          dead &= dead - 1;
+
+          // Trivial objects have no finaliser or destructor, so only their
+          // entry in the ExternalRefTable needs removing.
+          if (p->has_ext_ref())
+            ExternalReferenceTable::erase(alloc, p);
+        }
+
+        c->live[w] = c->marks[w];
+        c->marks[w] = 0;
+        empty &= (c->live[w] == 0);
+      }
+
+      return empty;
+    }
+
+    /**
+     * Release the unreachable subregions in `collect`, which have been found
+     * by a sweep.
+     *
+     * This needs to dispatch on every kind of region, so it is defined in
+     * region.h.
+     **/
+    void release_unreachable(Alloc& alloc, ObjectStack& collect);
+
+    /**
+     * Release and deallocate all objects within the region represented by the
+     * Iso Object `o`.
+     *
+     * Note: this does not release subregions. Use Region::release instead.
+     **/
+    void release_internal(Alloc& alloc, Object* o, ObjectStack& collect)
+    {
+      assert(o->debug_is_iso());
+
+      Logging::cout() << "Region release: hybrid region: " << o
+                      << Logging::endl;
+
+      // Run all the finalisers before any destructor, as for RegionArena.
+      // Only objects in the ring can have either.
+      for (auto it = begin<NonTrivial>(); it != end<NonTrivial>(); ++it)
+      {
+        (*it)->finalise(o, collect);
+      }
+
+      for (auto it = begin<NonTrivial>(); it != end<NonTrivial>(); ++it)
+      {
+        (*it)->destructor();
+      }
+
+      // Now we can deallocate the object ring.
+      Object* p = get_next();
+      while (p != this)
+      {
+        Object* q = p->get_next_any_mark();
+        p->dealloc(alloc);
+        p = q;
+      }
+
+      // Deallocate chunks.
+      Chunk* c = first_chunk;
+      while (c != nullptr)
+      {
+        Chunk* q = c->next;
+        alloc.dealloc<CHUNK_SIZE>(c);
+        c = q;
+      }
+
+      // Sweep the RememberedSet, to ensure destructors are called.
+      RememberedSet::sweep(alloc);
+
+      // Deallocate RegionHybrid
+      // Don't need to deallocate `o`, since it was in a chunk or the ring.
+      dealloc(alloc);
+    }
+
+    void use_memory(size_t size)
+    {
+      current_memory_used += size;
+    }
+
+  public:
+    template<IteratorType type = AllObjects>
+    class iterator
+    {
+      friend class RegionHybrid;
+
+      static_assert(
+        type == Trivial || type == NonTrivial || type == AllObjects);
+
+      iterator(RegionHybrid* r)
+      : reg(r),
+        chunk(type == NonTrivial ? nullptr : r->first_chunk),
+        index(0),
+        ptr(nullptr)
+      {
+        ptr = next_in_chunks();
+        if (ptr == nullptr)
+          ptr = next_in_ring(reg);
+      }
+
+      iterator(RegionHybrid* r, Chunk* c, Object* p)
+      : reg(r), chunk(c), index(0), ptr(p)
+      {}
+
+    public:
+      iterator operator++()
+      {
+        if (chunk != nullptr)
+        {
+          // Currently iterating through the chunks.
+          index++;
+          ptr = next_in_chunks();
+          if (ptr == nullptr)
+            ptr = next_in_ring(reg);
+        }
+        else
+        {
+          // Currenty iterating through the object ring.
+          ptr = next_in_ring(ptr);
+        }
+        return *this;
+      }
+
+      inline bool operator!=(const iterator& other) const
+      {
+        assert(reg == other.reg);
+        return ptr != other.ptr;
+      }
+
+      inline Object* operator*() const
+      {
+        return ptr;
+      }
+
+    private:
+      RegionHybrid* reg;
+      Chunk* chunk;
+      size_t index;
+      Object* ptr;
+
+      /**
+       * Starting from granule `index` of the current `chunk`, return a pointer
+       * to the first live object in the chunk list, or nullptr if there is
+       * none. Chunks only contain trivial objects.
+       *
+       * This method updates both the current `chunk` and `index`.
+       **/
+      inline Object* next_in_chunks()
+      {
+        while (chunk != nullptr)
+        {
+          index = chunk->next_live(index);
+          if (index != Chunk::GRANULES)
+            return chunk->object_at(index);
+
+          chunk = chunk->next;
+          index = 0;
+        }
+        return nullptr;
+      }
+
+      /**
+       * Starting from object `p` in the object ring, return a pointer to the
+       * next appropriate Object. If no object is found, return nullptr.
+       *
+       * `p` may be `reg`, which means starting at the beginning of the ring.
+       **/
+      inline Object* next_in_ring(Object* p) const
+      {
+        Object* q = p->get_next_any_mark();
+        while (q != reg)
+        {
+          bool cond;
+          if constexpr (type == Trivial)
+            cond = q->is_trivial();
+          else if constexpr (type == NonTrivial)
+            cond = !q->is_trivial();
+          else
+            cond = true;
+
+          if (cond)
+            return q;
+          q = q->get_next_any_mark();
+        }
+        return nullptr;
+      }
+    };
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> begin()
+    {
+      return {this};
+    }
+
+    template<IteratorType type = AllObjects>
+    inline iterator<type> end()
+    {
+      return {this, nullptr, nullptr};
+    }
+
+  private:
+    bool debug_is_in_region(Object* o)
+    {
+      for (auto p : *this)
+      {
+        if (p == o)
+          return true;
+      }
+      return false;
+    }
+  };
+} // namespace verona::rt
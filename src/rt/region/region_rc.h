@@ -7,6 +7,9 @@
 #include "region_base.h"
 #include "region_trace.h"
 
+#include <algorithm>
+#include <tuple>
+
 namespace verona::rt
 {
   using namespace snmalloc;
@@ -26,6 +29,17 @@ namespace verona::rt
    * (`FINALIZER_MASK`) to quickly deduce whether an object is trivial or
    * non-trivial.
    *
+   * Objects whose reference count is decremented without reaching zero are
+   * buffered as possible roots of garbage cycles. Once `CANDIDATE_THRESHOLD`
+   * candidates have been buffered, `decref` runs a cycle collection over the
+   * whole batch, so that cyclic garbage is reclaimed without waiting for an
+   * explicit `gc_cycles`.
+   *
+   * In deferred mode, see `set_deferred`, increments and decrements are
+   * instead logged in a thread-local buffer. The log is coalesced when the
+   * region is closed, collected, or the buffer fills, so that only the net
+   * change to each object's reference count touches its header.
+   *
    **/
   class RegionRc : public RegionBase
   {
@@ -45,8 +59,44 @@ namespace verona::rt
     // Memory usage in the region.
     size_t current_memory_used = 0;
 
+    // Memory usage in the region after the previous cycle collection.
+    size_t previous_memory_used = 0;
+
     size_t region_size = 0;
 
+    // Number of objects pushed onto the Lins stack since the previous cycle
+    // collection.
+    size_t candidates = 0;
+
+    // Number of objects deallocated by their reference count reaching zero,
+    // and by cycle collection, respectively.
+    size_t freed_by_rc = 0;
+    size_t freed_by_cycles = 0;
+
+    // Whether increments and decrements are logged, see `set_deferred`.
+    bool deferred = false;
+
+    /**
+     * Reference count changes of a region in deferred mode, that have not
+     * been applied yet. Each entry is an object pointer, with the low bit set
+     * for a decrement.
+     **/
+    struct RcLog
+    {
+      static constexpr size_t CAPACITY = 512;
+      static constexpr uintptr_t DECREF = 1;
+
+      RegionRc* region = nullptr;
+      size_t count = 0;
+      uintptr_t entries[CAPACITY];
+    };
+
+    static RcLog& get_log()
+    {
+      static thread_local RcLog pending;
+      return pending;
+    }
+
     RegionRc() : RegionBase() {}
 
     static const Descriptor* desc()
@@ -58,6 +108,11 @@ namespace verona::rt
     }
 
   public:
+    /**
+     * Number of buffered cycle candidates at which `decref` collects cycles.
+     **/
+    static constexpr size_t CANDIDATE_THRESHOLD = 1024;
+
     inline static RegionRc* get(Object* o)
     {
       assert(o->debug_is_iso());
@@ -70,6 +125,16 @@ namespace verona::rt
       return region_size;
     }
 
+    size_t get_freed_by_rc() const
+    {
+      return freed_by_rc;
+    }
+
+    size_t get_freed_by_cycles() const
+    {
+      return freed_by_cycles;
+    }
+
     inline static bool is_rc_region(Object* o)
     {
       return o->is_type(desc());
@@ -121,6 +186,7 @@ namespace verona::rt
     {
       assert((size == 0) || (size == desc->size));
       assert(reg != nullptr);
+      reg->check_limit(reg->current_memory_used, desc->size);
 
       void* p = nullptr;
       if constexpr (size == 0)
@@ -148,6 +214,7 @@ namespace verona::rt
     void close(Object* o)
     {
       assert(o->get_class() == RegionMD::OPEN_ISO);
+      flush(ThreadAlloc::get());
       entry_point_count = o->get_ref_count();
       o->set_region(this);
     }
@@ -166,6 +233,8 @@ namespace verona::rt
     /// Decrements the reference count of `o`. The object `in` is the entry
     /// point to the region that contains `o`. If `decref` is called on an
     /// object with only one reference, then the object will be deallocated.
+    /// Otherwise, `o` becomes a candidate for cycle collection, which is run
+    /// once enough candidates have been buffered.
     static bool decref(Alloc& alloc, Object* o, RegionRc* reg)
     {
       if (decref_inner(o))
@@ -178,10 +247,93 @@ namespace verona::rt
       {
         o->set_rc_colour(RcColour::BLACK);
         reg->lins_stack.push(o, alloc);
+
+        if (++reg->candidates >= CANDIDATE_THRESHOLD)
+          reg->collect_cycles(alloc);
       }
       return false;
     }
 
+    /**
+     * Switches deferred reference counting on or off for this region. While
+     * it is on, `deferred_incref` and `deferred_decref` only log the change,
+     * and the reference counts read with `get_ref_count` may be stale until
+     * the log is flushed.
+     **/
+    void set_deferred(Alloc& alloc, bool on)
+    {
+      if (!on)
+        flush(alloc);
+      deferred = on;
+    }
+
+    bool is_deferred() const
+    {
+      return deferred;
+    }
+
+    /// Logs an increment of the reference count of `o`, see `set_deferred`.
+    static void deferred_incref(Alloc& alloc, Object* o, RegionRc* reg)
+    {
+      assert(reg->deferred);
+      reg->log_change(alloc, (uintptr_t)o);
+    }
+
+    /// Logs a decrement of the reference count of `o`, see `set_deferred`.
+    static void deferred_decref(Alloc& alloc, Object* o, RegionRc* reg)
+    {
+      assert(reg->deferred);
+      reg->log_change(alloc, (uintptr_t)o | RcLog::DECREF);
+    }
+
+    /**
+     * Applies the net reference count changes logged for this region, if the
+     * thread-local log holds any.
+     *
+     * Increments are applied before decrements, so an object is only
+     * deallocated once every reference logged to it has been dropped.
+     **/
+    void flush(Alloc& alloc)
+    {
+      auto& pending = get_log();
+      if (pending.region != this)
+        return;
+
+      // Move the entries out of the log first: a decrement can run a
+      // finaliser or a cycle collection, which logs or flushes again.
+      uintptr_t entries[RcLog::CAPACITY];
+      auto end =
+        std::copy(pending.entries, pending.entries + pending.count, entries);
+      pending.region = nullptr;
+      pending.count = 0;
+
+      // Objects are more than one byte apart, so sorting puts all the entries
+      // of an object next to each other.
+      std::sort(entries, end);
+
+      for (auto run = entries; run != end;)
+      {
+        auto [o, net, next] = coalesce(run, end);
+        for (; net > 0; net--)
+          incref(o);
+        run = next;
+      }
+
+      for (auto run = entries; run != end;)
+      {
+        auto [o, net, next] = coalesce(run, end);
+        for (; net < 0; net++)
+        {
+          if (decref(alloc, o, this))
+          {
+            assert(net == -1);
+            break;
+          }
+        }
+        run = next;
+      }
+    }
+
     /// Get the reference count of `o`. The object `in` is the entry point to
     /// the region that contains `o`.
     static size_t get_ref_count(Object* o)
@@ -220,22 +372,34 @@ namespace verona::rt
      *
      *  3. o's subgraph is re-traced a final time, and any remaining red objects
      *  are deallocated.
+     *
+     * `decref` also runs this on its own once `CANDIDATE_THRESHOLD` objects
+     * have been pushed onto the Lins stack.
      **/
     static void gc_cycles(Alloc& alloc, Object* o, RegionRc* reg)
     {
       assert(o->get_class() == RegionMD::OPEN_ISO);
       UNUSED(o);
-      ObjectStack jump_stack(alloc);
-      while (!reg->lins_stack.empty())
-      {
-        auto p = reg->lins_stack.pop(alloc);
+      reg->flush(alloc);
+      reg->collect_cycles(alloc);
+    }
 
-        if (p->get_rc_colour() == RcColour::BLACK)
-        {
-          mark_red(alloc, p, reg, jump_stack);
-          scan(alloc, p, reg, jump_stack);
-        }
-      }
+    /**
+     * Returns true if the region has grown enough since its previous cycle
+     * collection to be collected, see `GCPolicy`.
+     **/
+    bool should_gc() const
+    {
+      return GCPolicy::should_collect(
+        current_memory_used, previous_memory_used, soft_limit);
+    }
+
+    /**
+     * Returns the number of bytes of objects in the region.
+     **/
+    size_t memory_used() const
+    {
+      return current_memory_used;
     }
 
     /**
@@ -248,6 +412,10 @@ namespace verona::rt
     {
       open(o);
       assert(o->get_class() == RegionMD::OPEN_ISO);
+
+      // Apply the changes logged for this region, so the counts below are
+      // exact and the thread-local log no longer refers to it.
+      flush(alloc);
       if (!decref_inner(o))
       {
         abort();
@@ -318,6 +486,54 @@ namespace verona::rt
     }
 
   private:
+    void log_change(Alloc& alloc, uintptr_t entry)
+    {
+      auto& pending = get_log();
+      if (pending.region != this || pending.count == RcLog::CAPACITY)
+      {
+        if (pending.region != nullptr)
+          pending.region->flush(alloc);
+        pending.region = this;
+      }
+      pending.entries[pending.count++] = entry;
+    }
+
+    /**
+     * Sums the entries for the object logged at `run`. Returns the object, its
+     * net reference count change, and the first entry for the next object.
+     **/
+    static std::tuple<Object*, ptrdiff_t, uintptr_t*>
+    coalesce(uintptr_t* run, uintptr_t* end)
+    {
+      auto o = *run & ~RcLog::DECREF;
+      ptrdiff_t net = 0;
+      for (; run != end && (*run & ~RcLog::DECREF) == o; run++)
+        net += ((*run & RcLog::DECREF) != 0) ? -1 : 1;
+      return {(Object*)o, net, run};
+    }
+
+    /**
+     * Runs the Lins algorithm, see `gc_cycles`, from every candidate on the
+     * Lins stack.
+     **/
+    void collect_cycles(Alloc& alloc)
+    {
+      ObjectStack jump_stack(alloc);
+      while (!lins_stack.empty())
+      {
+        auto p = lins_stack.pop(alloc);
+
+        if (p->get_rc_colour() == RcColour::BLACK)
+        {
+          mark_red(alloc, p, this, jump_stack);
+          scan(alloc, p, this, jump_stack);
+        }
+      }
+
+      candidates = 0;
+      previous_memory_used = current_memory_used;
+    }
+
     void release_cycles(
       Alloc& alloc, Object* o, LinkedObjectStack& gc, ObjectStack& collect)
     {
@@ -568,6 +784,8 @@ namespace verona::rt
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        reg->freed_by_cycles += 1;
+        reg->current_memory_used -= o->size();
         o->destructor();
         o->dealloc(alloc);
       }
@@ -636,6 +854,8 @@ namespace verona::rt
       {
         Object* o = gc.pop();
         reg->region_size -= 1;
+        reg->freed_by_rc += 1;
+        reg->current_memory_used -= o->size();
         o->destructor();
         o->dealloc(alloc);
       }
@@ -661,6 +881,8 @@ namespace verona::rt
           ((RegionArena*)r)->release_internal(alloc, o, sub_regions);
         else if (RegionRc::is_rc_region(r))
           ((RegionRc*)r)->release_internal(alloc, o, sub_regions);
+        else if (RegionHybrid::is_hybrid_region(r))
+          ((RegionHybrid*)r)->release_internal(alloc, o, sub_regions);
         else
           abort();
       }
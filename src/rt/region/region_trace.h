@@ -3,8 +3,10 @@
 #pragma once
 
 #include "../object/object.h"
+#include "gc_policy.h"
 #include "region_arena.h"
 #include "region_base.h"
+#include "region_hybrid.h"
 
 namespace verona::rt
 {
@@ -44,10 +46,30 @@ namespace verona::rt
    * Note that we use the "last" pointer to ensure constant-time merging of two
    * rings. We avoid a "last" pointer for the primary ring, since the iso
    * object is the last object, and we always have a pointer to it.
+   *
+   * Besides a full collection, `gc`, a region can be collected incrementally
+   * by calling `gc_step` repeatedly, for instance from successive behaviours
+   * on the owning cown. Each step does a bounded amount of marking or
+   * sweeping. While marking, pointers stored into objects of the region must
+   * be passed to `write_barrier`, which shades them so that marking does not
+   * miss objects that were moved behind its frontier. Objects allocated while
+   * marking are allocated marked. Operations that restructure the region
+   * (merging, swapping the root, freezing, releasing and a full `gc`)
+   * abandon an incremental collection in progress.
+   *
+   * Outside of an incremental collection, new objects are placed in the
+   * nursery: two lists, one per kind of object, that are not yet part of the
+   * rings. A minor collection, `gc_minor`, only traces and sweeps the
+   * nursery, starting from the objects that have been passed to
+   * `write_barrier` since the previous collection. The survivors are then
+   * promoted, by appending the lists to the rings. Any other collection, or
+   * operation that restructures the region, first promotes the whole
+   * nursery.
    **/
   class RegionTrace : public RegionBase
   {
     friend class Freeze;
+    friend class ParallelGC;
     friend class Region;
     friend class RegionRc;
 
@@ -58,6 +80,13 @@ namespace verona::rt
       NonTrivialRing,
     };
 
+    enum class GCPhase : uint8_t
+    {
+      Idle,
+      Mark,
+      Sweep
+    };
+
     // Circular linked list ("secondary ring") for trivial objects if the root
     // is trivial, or vice versa.
     Object* next_not_root;
@@ -72,8 +101,39 @@ namespace verona::rt
     // Stack of stack based entry points into the region.
     StackThin<Object, Alloc> additional_entry_points{};
 
+    // Phase of the incremental collection, see `gc_step`.
+    GCPhase gc_phase = GCPhase::Idle;
+
+    // Objects still to be marked by the incremental collection.
+    StackThin<Object, Alloc> gray{};
+
+    // Position of the incremental sweep: the ring being swept, the next object
+    // to sweep, and the object before it in the ring.
+    RingKind sweep_kind = NonTrivialRing;
+    Object* sweep_prev = nullptr;
+    Object* sweep_p = nullptr;
+
+    // Objects of the non-trivial ring that have been finalised by the
+    // incremental sweep, but not yet destructed.
+    LinkedObjectStack sweep_gc;
+
+    // The nursery, indexed by RingKind: the first and last objects of a list
+    // of the objects allocated since the previous collection, ending in this
+    // region metadata object.
+    Object* young[2];
+    Object* young_last[2];
+
+    // Objects passed to `write_barrier` since the previous collection, which
+    // are the roots of a minor collection. These may include old objects.
+    StackThin<Object, Alloc> remembered_young{};
+
     explicit RegionTrace()
-    : RegionBase(), next_not_root(this), last_not_root(this)
+    : RegionBase(),
+      next_not_root(this),
+      last_not_root(this),
+      previous_memory_used(size_to_sizeclass_full(GCPolicy::MIN_SIZE)),
+      young{this, this},
+      young_last{this, this}
     {}
 
     static const Descriptor* desc()
@@ -85,6 +145,11 @@ namespace verona::rt
     }
 
   public:
+    /**
+     * Default amount of work done by `gc_step`, in objects marked or swept.
+     **/
+    static constexpr size_t GC_STEP_BUDGET = 4096;
+
     inline static RegionTrace* get(Object* o)
     {
       assert(o->debug_is_iso());
@@ -144,6 +209,7 @@ namespace verona::rt
       RegionTrace* reg = get(in);
 
       assert(reg != nullptr);
+      reg->check_limit(reg->current_memory_used, desc->size);
 
       void* p = nullptr;
       if constexpr (size == 0)
@@ -154,8 +220,24 @@ namespace verona::rt
       auto o = (Object*)Object::register_object(p, desc);
       assert(Object::debug_is_aligned(o));
 
-      // Add to the ring.
-      reg->append(o);
+      // Add to the nursery, or to the ring during an incremental collection.
+      if (reg->gc_phase == GCPhase::Idle)
+      {
+        reg->append_young(o);
+      }
+      else
+      {
+        reg->append(o);
+
+        // Objects allocated during an incremental collection may need to be
+        // marked, so they are not swept. The sweep then accounts for them.
+        if (reg->allocate_marked(o))
+        {
+          o->mark();
+          if (reg->gc_phase == GCPhase::Sweep)
+            return o;
+        }
+      }
 
       // GC heuristics.
       reg->use_memory(desc->size);
@@ -201,6 +283,8 @@ namespace verona::rt
         if (!other_trace->additional_entry_points.empty())
           abort();
 
+        reg->gc_settle(alloc);
+        other_trace->gc_settle(alloc);
         reg->merge_internal(o, other_trace);
 
         // Merge the ExternalReferenceTable and RememberedSet.
@@ -228,6 +312,7 @@ namespace verona::rt
       assert(prev->get_region() != next);
 
       RegionTrace* reg = get(prev);
+      reg->gc_settle(ThreadAlloc::get());
       reg->swap_root_internal(prev, next);
     }
 
@@ -243,6 +328,8 @@ namespace verona::rt
       assert(is_trace_region(o->get_region()));
 
       RegionTrace* reg = get(o);
+      reg->gc_settle(alloc);
+
       ObjectStack f(alloc);
       ObjectStack collect(alloc);
 
@@ -254,29 +341,180 @@ namespace verona::rt
 
       reg->mark(alloc, o, f);
       reg->sweep(alloc, o, collect);
+      reg->release_unreachable(alloc, collect);
+    }
 
-      // `collect` contains all the iso objects to unreachable subregions.
-      // Since they are unreachable, we can just release them.
-      while (!collect.empty())
+    /**
+     * Do a bounded step of an incremental garbage collection on the region
+     * represented by the Object `o`, starting a new collection if none is in
+     * progress. At most `budget` objects are marked or swept. Returns true if
+     * this step completed the collection.
+     *
+     * Between steps, pointers stored into the region must be passed to
+     * `write_barrier`. Steps should not be run while the region is being
+     * mutated, for example while a behaviour holds pointers into the region
+     * on its stack, as those are not roots of the collection.
+     **/
+    static bool
+    gc_step(Alloc& alloc, Object* o, size_t budget = GC_STEP_BUDGET)
+    {
+      assert(o->debug_is_iso());
+      assert(is_trace_region(o->get_region()));
+      assert(budget > 0);
+
+      RegionTrace* reg = get(o);
+
+      if (reg->gc_phase == GCPhase::Idle)
       {
-        o = collect.pop();
-        assert(o->debug_is_iso());
-        Logging::cout() << "Region GC: releasing unreachable subregion: " << o
+        Logging::cout() << "Region incremental GC started for: " << o
                         << Logging::endl;
+        reg->promote_young(alloc);
+        reg->gc_phase = GCPhase::Mark;
 
-        // Note that we need to dispatch because `r` is a different region
-        // metadata object.
-        RegionBase* r = o->get_region();
-        assert(r != reg);
+        ObjectStack f(alloc);
+        o->trace(f);
+        reg->additional_entry_points.forall([&f](Object* o) { f.push(o); });
+        reg->push_gray(alloc, f);
+      }
 
-        // Unfortunately, we can't use Region::release_internal because of a
-        // circular dependency between header files.
-        if (RegionTrace::is_trace_region(r))
-          ((RegionTrace*)r)->release_internal(alloc, o, collect);
-        else if (RegionArena::is_arena_region(r))
-          ((RegionArena*)r)->release_internal(alloc, o, collect);
-        else
-          abort();
+      if (reg->gc_phase == GCPhase::Mark)
+      {
+        if (!reg->mark_step(alloc, budget))
+          return false;
+
+        reg->gc_phase = GCPhase::Sweep;
+        reg->current_memory_used = 0;
+        reg->start_sweep_ring(o, NonTrivialRing);
+      }
+
+      ObjectStack collect(alloc);
+      bool done = reg->sweep_step(alloc, o, budget, collect);
+      reg->release_unreachable(alloc, collect);
+
+      if (done)
+      {
+        Logging::cout() << "Region incremental GC completed for: " << o
+                        << Logging::endl;
+        reg->RememberedSet::sweep(alloc);
+        reg->previous_memory_used =
+          size_to_sizeclass_full(reg->current_memory_used);
+        reg->gc_phase = GCPhase::Idle;
+      }
+
+      return done;
+    }
+
+    /**
+     * Run a minor garbage collection on the region represented by the Object
+     * `o`, which only collects the nursery, i.e. the objects allocated since
+     * the previous collection. Objects of the nursery survive if they are
+     * reachable from the objects passed to `write_barrier` since then, and
+     * are promoted to the rings of the region.
+     *
+     * This is only sound if every pointer stored into an object of the region
+     * since the previous collection has been passed to `write_barrier`.
+     **/
+    static void gc_minor(Alloc& alloc, Object* o)
+    {
+      Logging::cout() << "Region minor GC called for: " << o << Logging::endl;
+      assert(o->debug_is_iso());
+      assert(is_trace_region(o->get_region()));
+
+      RegionTrace* reg = get(o);
+
+      // The nursery is empty during an incremental collection.
+      if (reg->gc_phase != GCPhase::Idle)
+        return;
+
+      // The nursery is marked, and objects are unmarked as they are found to
+      // be reachable. Old objects are unmarked, so the trace stops at them.
+      for (Object* p : reg->young)
+      {
+        for (; p != reg; p = p->get_next_any_mark())
+          p->mark();
+      }
+
+      ObjectStack f(alloc);
+      while (!reg->remembered_young.empty())
+        f.push(reg->remembered_young.pop(alloc));
+
+      while (!f.empty())
+      {
+        Object* p = f.pop();
+        if (p->get_class() == Object::MARKED)
+        {
+          Logging::cout() << "Minor mark" << p << Logging::endl;
+          p->unmark();
+          p->trace(f);
+        }
+      }
+
+      // As for a full sweep, finalise the non-trivial objects first.
+      ObjectStack collect(alloc);
+      reg->sweep_young<NonTrivialRing>(alloc, o, collect);
+      reg->sweep_young<TrivialRing>(alloc, o, collect);
+      reg->promote_young(alloc);
+      reg->release_unreachable(alloc, collect);
+    }
+
+    /**
+     * Returns true if an incremental collection of the region represented by
+     * the Object `o` is in progress.
+     **/
+    static bool gc_in_progress(Object* o)
+    {
+      return get(o)->gc_phase != GCPhase::Idle;
+    }
+
+    /**
+     * Returns true if the region has grown enough since its previous
+     * collection to be collected, see `GCPolicy`. Always false while an
+     * incremental collection is in progress, as that collection will reset
+     * the memory usage when it completes.
+     **/
+    bool should_gc() const
+    {
+      if (gc_phase != GCPhase::Idle)
+        return false;
+
+      return GCPolicy::should_collect(
+        current_memory_used,
+        sizeclass_full_to_size(previous_memory_used),
+        soft_limit);
+    }
+
+    /**
+     * Returns the number of bytes of objects in the region. This is an
+     * underestimate while an incremental collection is sweeping.
+     **/
+    size_t memory_used() const
+    {
+      return current_memory_used;
+    }
+
+    /**
+     * Must be called when a pointer to `target` is stored into a field of an
+     * object in the region represented by the Iso object `in`. While an
+     * incremental collection is marking, `target` is shaded, so that it is
+     * marked even if the object it was stored into has already been traced.
+     * Otherwise, `target` is remembered as a root of the next minor
+     * collection.
+     **/
+    static void write_barrier(Alloc& alloc, Object* in, Object* target)
+    {
+      RegionTrace* reg = get(in);
+      if (target == nullptr)
+        return;
+
+      if (SNMALLOC_UNLIKELY(reg->gc_phase == GCPhase::Mark))
+      {
+        if (target->get_class() != Object::MARKED)
+          reg->gray.push(target, alloc);
+      }
+      else if (
+        reg->has_young() && (target->get_class() == Object::UNMARKED))
+      {
+        reg->remembered_young.push(target, alloc);
       }
     }
 
@@ -287,6 +525,7 @@ namespace verona::rt
     {
       RegionTrace* reg = get(entry);
       reg->additional_entry_points.push(o, alloc);
+      write_barrier(alloc, entry, o);
     }
 
     /// Remove object `o` from the additional root stack of the region
@@ -316,6 +555,14 @@ namespace verona::rt
     {
       Object* p = get_next();
 
+      // If the incremental sweep is at the start of this ring, then the new
+      // objects are placed before it.
+      RingKind kind = hd->is_trivial() ? TrivialRing : NonTrivialRing;
+      if (
+        (gc_phase == GCPhase::Sweep) && (sweep_kind == kind) &&
+        (sweep_prev == this))
+        sweep_prev = tl;
+
       if (hd->is_trivial() == p->is_trivial())
       {
         tl->init_next(p);
@@ -331,6 +578,96 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Returns true if the object `o`, that has just been allocated, must be
+     * marked so the incremental collection in progress does not sweep it.
+     * That is while marking, or while sweeping if the sweep has not reached
+     * `o`'s ring yet. The sweep of the non-trivial ring comes first.
+     **/
+    bool allocate_marked(Object* o)
+    {
+      return (gc_phase == GCPhase::Mark) ||
+        ((gc_phase == GCPhase::Sweep) && (sweep_kind == NonTrivialRing) &&
+         o->is_trivial());
+    }
+
+    /**
+     * Inserts the object `o` at the start of the nursery list of its kind.
+     **/
+    void append_young(Object* o)
+    {
+      RingKind kind = o->is_trivial() ? TrivialRing : NonTrivialRing;
+      o->init_next(young[kind]);
+      if (young_last[kind] == this)
+        young_last[kind] = o;
+      young[kind] = o;
+    }
+
+    bool has_young() const
+    {
+      return (young[TrivialRing] != this) || (young[NonTrivialRing] != this);
+    }
+
+    /**
+     * Move the nursery into the rings, and forget the roots of the next minor
+     * collection.
+     **/
+    void promote_young(Alloc& alloc)
+    {
+      for (RingKind kind : {NonTrivialRing, TrivialRing})
+      {
+        if (young[kind] != this)
+        {
+          append(young[kind], young_last[kind]);
+          young[kind] = this;
+          young_last[kind] = this;
+        }
+      }
+
+      while (!remembered_young.empty())
+        remembered_young.pop(alloc);
+    }
+
+    /**
+     * Sweep the nursery list of kind `ring` after the trace of a minor
+     * collection, which leaves the unreachable objects marked.
+     **/
+    template<RingKind ring>
+    void sweep_young(Alloc& alloc, Object* o, ObjectStack& collect)
+    {
+      Object* prev = this;
+      Object* p = young[ring];
+      LinkedObjectStack gc;
+
+      young_last[ring] = this;
+      while (p != this)
+      {
+        Object* q = p->get_next_any_mark();
+
+        if (p->get_class() == Object::MARKED)
+        {
+          Logging::cout() << "Minor sweep " << p << Logging::endl;
+          p->unmark();
+          current_memory_used -= p->size();
+          sweep_object<ring>(alloc, p, o, &gc, collect);
+
+          if (prev == this)
+            young[ring] = q;
+          else
+            prev->set_next(q);
+        }
+        else
+        {
+          prev = p;
+          young_last[ring] = p;
+        }
+
+        p = q;
+      }
+
+      destruct_swept(alloc, gc);
+    }
+
     void merge_internal(Object* o, RegionTrace* other)
     {
       assert(o->get_region() == other);
@@ -350,7 +687,7 @@ namespace verona::rt
       current_memory_used += other->current_memory_used;
 
       previous_memory_used = size_to_sizeclass_full(
-        sizeclass_full_to_size(other->previous_memory_used) +
+        sizeclass_full_to_size(previous_memory_used) +
         sizeclass_full_to_size(other->previous_memory_used));
     }
 
@@ -402,36 +739,72 @@ namespace verona::rt
     {
       o->trace(dfs);
       while (!dfs.empty())
+        mark_object(alloc, dfs.pop(), dfs);
+    }
+
+    /**
+     * Mark `p`, if it is an unmarked object in this region, and push the
+     * objects it references to `dfs`. Immutables and cowns are marked in the
+     * RememberedSet.
+     **/
+    void mark_object(Alloc& alloc, Object* p, ObjectStack& dfs)
+    {
+      switch (p->get_class())
       {
-        Object* p = dfs.pop();
-        switch (p->get_class())
-        {
-          case Object::ISO:
-          case Object::MARKED:
-            break;
-
-          case Object::UNMARKED:
-            Logging::cout() << "Mark" << p << Logging::endl;
-            p->mark();
-            p->trace(dfs);
-            break;
-
-          case Object::SCC_PTR:
-            p = p->immutable();
-            RememberedSet::mark(alloc, p);
-            break;
-
-          case Object::RC:
-          case Object::COWN:
-            RememberedSet::mark(alloc, p);
-            break;
-
-          default:
-            assert(0);
-        }
+        case Object::ISO:
+        case Object::MARKED:
+          break;
+
+        case Object::UNMARKED:
+          Logging::cout() << "Mark" << p << Logging::endl;
+          p->mark();
+          p->trace(dfs);
+          break;
+
+        case Object::SCC_PTR:
+          p = p->immutable();
+          RememberedSet::mark(alloc, p);
+          break;
+
+        case Object::RC:
+        case Object::COWN:
+          RememberedSet::mark(alloc, p);
+          break;
+
+        default:
+          assert(0);
       }
     }
 
+    /**
+     * Move the contents of `f` onto the gray stack of the incremental
+     * collection.
+     **/
+    void push_gray(Alloc& alloc, ObjectStack& f)
+    {
+      while (!f.empty())
+        gray.push(f.pop(), alloc);
+    }
+
+    /**
+     * Mark objects from the gray stack, until it is empty or `budget` is
+     * used up. Returns true if marking is complete.
+     **/
+    bool mark_step(Alloc& alloc, size_t& budget)
+    {
+      ObjectStack f(alloc);
+      while (!gray.empty())
+      {
+        if (budget == 0)
+          return false;
+
+        mark_object(alloc, gray.pop(alloc), f);
+        push_gray(alloc, f);
+        budget--;
+      }
+      return true;
+    }
+
     enum class SweepAll
     {
       Yes,
@@ -517,77 +890,214 @@ namespace verona::rt
       // Note: we don't use the iterator because we need to remove and
       // deallocate objects from the rings.
       while (p != this)
+        p = sweep_next<ring, sweep_all>(
+          alloc, o, primary_ring, prev, p, gc, collect);
+
+      // Deallocate the objects, if not done in first pass.
+      destruct_swept(alloc, gc);
+    }
+
+    /**
+     * Sweep the object `p` of `ring`, which follows `prev`, and return the
+     * next object of the ring. `prev` is updated to be the object before the
+     * returned one.
+     **/
+    template<RingKind ring, SweepAll sweep_all>
+    Object* sweep_next(
+      Alloc& alloc,
+      Object* o,
+      RingKind primary_ring,
+      Object*& prev,
+      Object* p,
+      LinkedObjectStack& gc,
+      ObjectStack& collect)
+    {
+      switch (p->get_class())
       {
-        switch (p->get_class())
+        case Object::ISO:
         {
-          case Object::ISO:
+          // An iso is always the root, and the last thing in the ring.
+          assert(p->get_next_any_mark() == this);
+          assert(p->get_region() == this);
+
+          // The ISO is considered marked, unless we're releasing the
+          // entire region anyway.
+          if constexpr (sweep_all == SweepAll::Yes)
           {
-            // An iso is always the root, and the last thing in the ring.
-            assert(p->get_next_any_mark() == this);
-            assert(p->get_region() == this);
-
-            // The ISO is considered marked, unless we're releasing the
-            // entire region anyway.
-            if constexpr (sweep_all == SweepAll::Yes)
-            {
-              sweep_object<ring>(alloc, p, o, &gc, collect);
-            }
-            else
-            {
-              use_memory(p->size());
-            }
-
-            p = this;
-            break;
+            sweep_object<ring>(alloc, p, o, &gc, collect);
           }
-
-          case Object::MARKED:
+          else
           {
-            assert(sweep_all == SweepAll::No);
             use_memory(p->size());
-            p->unmark();
-            prev = p;
-            p = p->get_next();
-            break;
           }
 
-          case Object::UNMARKED:
-          {
-            Object* q = p->get_next();
-            Logging::cout() << "Sweep " << p << Logging::endl;
-            sweep_object<ring>(alloc, p, o, &gc, collect);
+          return this;
+        }
 
-            if (ring != primary_ring && prev == this)
-              next_not_root = q;
-            else
-              prev->set_next(q);
+        case Object::MARKED:
+        {
+          assert(sweep_all == SweepAll::No);
+          Object* q = p->get_next();
+          q->prefetch();
+          use_memory(p->size());
+          p->unmark();
+          prev = p;
+          return q;
+        }
 
-            if (ring != primary_ring && last_not_root == p)
-              last_not_root = prev;
+        case Object::UNMARKED:
+        {
+          Object* q = p->get_next();
+          q->prefetch();
+          Logging::cout() << "Sweep " << p << Logging::endl;
+          sweep_object<ring>(alloc, p, o, &gc, collect);
 
-            p = q;
-            break;
-          }
+          if (ring != primary_ring && prev == this)
+            next_not_root = q;
+          else
+            prev->set_next(q);
 
-          default:
-            assert(0);
+          if (ring != primary_ring && last_not_root == p)
+            last_not_root = prev;
+
+          return q;
         }
+
+        default:
+          assert(0);
+          return this;
       }
+    }
 
-      // Deallocate the objects, if not done in first pass.
-      if constexpr (ring == NonTrivialRing)
+    /**
+     * Destruct and deallocate the objects of the non-trivial ring that have
+     * been finalised by a sweep.
+     **/
+    void destruct_swept(Alloc& alloc, LinkedObjectStack& gc)
+    {
+      while (!gc.empty())
+      {
+        Object* q = gc.pop();
+        q->destructor();
+        q->dealloc(alloc);
+      }
+    }
+
+    /**
+     * Position the incremental sweep at the start of `ring`.
+     **/
+    void start_sweep_ring(Object* o, RingKind ring)
+    {
+      RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
+      sweep_kind = ring;
+      sweep_prev = this;
+      sweep_p = ring == primary_ring ? get_next() : next_not_root;
+    }
+
+    /**
+     * Sweep objects from the position of the incremental sweep, until both
+     * rings are swept or `budget` is used up. The non-trivial ring is swept
+     * first, and its finalised objects are destructed once it is complete, as
+     * for a full sweep. Returns true if the sweep is complete.
+     **/
+    bool
+    sweep_step(Alloc& alloc, Object* o, size_t& budget, ObjectStack& collect)
+    {
+      RingKind primary_ring = o->is_trivial() ? TrivialRing : NonTrivialRing;
+
+      while (budget > 0)
       {
-        while (!gc.empty())
+        if (sweep_p == this)
         {
-          Object* q = gc.pop();
-          q->destructor();
-          q->dealloc(alloc);
+          if (sweep_kind == TrivialRing)
+            return true;
+
+          destruct_swept(alloc, sweep_gc);
+          start_sweep_ring(o, TrivialRing);
+          continue;
         }
+
+        if (sweep_kind == NonTrivialRing)
+          sweep_p = sweep_next<NonTrivialRing, SweepAll::No>(
+            alloc, o, primary_ring, sweep_prev, sweep_p, sweep_gc, collect);
+        else
+          sweep_p = sweep_next<TrivialRing, SweepAll::No>(
+            alloc, o, primary_ring, sweep_prev, sweep_p, sweep_gc, collect);
+
+        budget--;
       }
-      else
+
+      return (sweep_kind == TrivialRing) && (sweep_p == this);
+    }
+
+    /**
+     * Abandon the incremental collection in progress, if any, leaving all the
+     * objects of the region unmarked. Entries of the RememberedSet that have
+     * been marked are kept until the next collection.
+     **/
+    void gc_abandon(Alloc& alloc)
+    {
+      if (gc_phase == GCPhase::Idle)
+        return;
+
+      Logging::cout() << "Region incremental GC abandoned for: " << this
+                      << Logging::endl;
+
+      while (!gray.empty())
+        gray.pop(alloc);
+
+      destruct_swept(alloc, sweep_gc);
+
+      for (auto p : *this)
       {
-        UNUSED(o);
-        UNUSED(collect);
+        if (p->get_class() == Object::MARKED)
+          p->unmark();
+      }
+
+      gc_phase = GCPhase::Idle;
+    }
+
+    /**
+     * Abandon the incremental collection in progress, if any, and promote the
+     * nursery, so that all the objects of the region are unmarked and in its
+     * two rings.
+     **/
+    void gc_settle(Alloc& alloc)
+    {
+      gc_abandon(alloc);
+      promote_young(alloc);
+    }
+
+    /**
+     * Release the unreachable subregions in `collect`, which have been found
+     * by a sweep.
+     **/
+    void release_unreachable(Alloc& alloc, ObjectStack& collect)
+    {
+      // `collect` contains all the iso objects to unreachable subregions.
+      // Since they are unreachable, we can just release them.
+      while (!collect.empty())
+      {
+        Object* o = collect.pop();
+        assert(o->debug_is_iso());
+        Logging::cout() << "Region GC: releasing unreachable subregion: " << o
+                        << Logging::endl;
+
+        // Note that we need to dispatch because `r` is a different region
+        // metadata object.
+        RegionBase* r = o->get_region();
+        assert(r != this);
+
+        // Unfortunately, we can't use Region::release_internal because of a
+        // circular dependency between header files.
+        if (RegionTrace::is_trace_region(r))
+          ((RegionTrace*)r)->release_internal(alloc, o, collect);
+        else if (RegionArena::is_arena_region(r))
+          ((RegionArena*)r)->release_internal(alloc, o, collect);
+        else if (RegionHybrid::is_hybrid_region(r))
+          ((RegionHybrid*)r)->release_internal(alloc, o, collect);
+        else
+          abort();
       }
     }
 
@@ -613,6 +1123,8 @@ namespace verona::rt
 
       Logging::cout() << "Region release: trace region: " << o << Logging::endl;
 
+      gc_settle(alloc);
+
       // Sweep everything, including the entrypoint.
       sweep<SweepAll::Yes>(alloc, o, collect);
 
@@ -633,54 +1145,65 @@ namespace verona::rt
       static_assert(
         type == Trivial || type == NonTrivial || type == AllObjects);
 
-      iterator(RegionTrace* r) : reg(r)
-      {
-        Object* q = r->get_next();
-        if constexpr (type == Trivial)
-          ptr = q->is_trivial() ? q : r->next_not_root;
-        else if constexpr (type == NonTrivial)
-          ptr = !q->is_trivial() ? q : r->next_not_root;
-        else
-          ptr = q;
+      /**
+       * The number of lists visited: the rings, and the nursery lists, of the
+       * requested kinds.
+       **/
+      static constexpr size_t LISTS = type == AllObjects ? 4 : 2;
 
-        // If the next object is the region metadata object, then there was
-        // nothing to iterate over.
-        if (ptr == r)
-          ptr = nullptr;
+      iterator(RegionTrace* r) : reg(r), ptr(r), list(0)
+      {
+        next_list();
       }
 
-      iterator(RegionTrace* r, Object* p) : reg(r), ptr(p) {}
+      iterator(RegionTrace* r, Object* p) : reg(r), ptr(p), list(LISTS) {}
 
-    public:
-      iterator operator++()
+      Object* list_head(size_t i) const
       {
-        Object* q = ptr->get_next_any_mark();
-        if (q != reg)
+        Object* q = reg->get_next();
+        if constexpr (type == Trivial)
         {
-          ptr = q;
-          return *this;
+          if (i == 0)
+            return q->is_trivial() ? q : reg->next_not_root;
+          return reg->young[TrivialRing];
         }
+        else if constexpr (type == NonTrivial)
+        {
+          if (i == 0)
+            return !q->is_trivial() ? q : reg->next_not_root;
+          return reg->young[NonTrivialRing];
+        }
+        else
+        {
+          Object* heads[LISTS] = {q,
+                                  reg->next_not_root,
+                                  reg->young[NonTrivialRing],
+                                  reg->young[TrivialRing]};
+          return heads[i];
+        }
+      }
 
-        if constexpr (type == AllObjects)
+      /**
+       * Move to the first object of the next non-empty list, or to the end.
+       **/
+      void next_list()
+      {
+        while (ptr == reg)
         {
-          if (ptr != reg->last_not_root && reg->next_not_root != reg)
-          {
-            // We finished the primary ring and there's a secondary ring to
-            // switch to.
-            assert(ptr->debug_is_iso());
-            ptr = reg->next_not_root;
-          }
-          else
+          if (list == LISTS)
           {
-            // We finished the secondary ring, so we're done.
             ptr = nullptr;
+            return;
           }
+          ptr = list_head(list++);
         }
-        else
-        {
-          // We finished a ring and don't care about the other ring.
-          ptr = nullptr;
-        }
+      }
+
+    public:
+      iterator operator++()
+      {
+        ptr = ptr->get_next_any_mark();
+        next_list();
         return *this;
       }
 
@@ -698,6 +1221,7 @@ namespace verona::rt
     private:
       RegionTrace* reg;
       Object* ptr;
+      size_t list;
     };
 
     template<IteratorType type = AllObjects>
@@ -19,7 +19,7 @@ namespace verona::rt
     friend class RegionArena;
 
   private:
-    using HashSet = ObjectMap<Object*>;
+    using HashSet = DefaultObjectMap<Object*>;
     HashSet* hash_set;
 
   public:
@@ -33,10 +33,22 @@ namespace verona::rt
     }
 
     /**
-     * Add the objects from another set to this set.
+     * Add the objects from another set to this set. The other set may be left
+     * with any of the entries, so it must only be deallocated afterwards.
      */
     void merge(Alloc& alloc, RememberedSet* that)
     {
+      if (that->hash_set->size() == 0)
+        return;
+
+      // The references can be moved with the whole table.
+      if (hash_set->size() == 0)
+      {
+        std::swap(hash_set, that->hash_set);
+        return;
+      }
+
+      hash_set->reserve(alloc, hash_set->size() + that->hash_set->size());
       for (auto* e : *that->hash_set)
       {
         // If q is already present in this, decref, otherwise insert.
@@ -113,6 +125,9 @@ namespace verona::rt
      */
     void discard(Alloc& alloc, bool release = true)
     {
+      if (hash_set->size() == 0)
+        return;
+
       for (auto it = hash_set->begin(); it != hash_set->end(); ++it)
       {
         if (release)
@@ -0,0 +1,183 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+#include "region_arena.h"
+
+#include <cstddef>
+#include <type_traits>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * A bump allocator for temporary data that dies together, such as the
+   * scratch data of a behaviour.
+   *
+   * Memory is bump-allocated from the same 1 MiB arenas as `RegionArena`. No
+   * objects are registered, so nothing is finalised or destructed: `reset`
+   * simply forgets everything that was allocated. The arenas in use are then
+   * kept for the next round of allocations, up to `CACHED_ARENAS`, so a
+   * steady state of allocations and resets does not call the allocator.
+   *
+   * Allocations that are too large for an arena are made individually, and
+   * deallocated by `reset`.
+   **/
+  class ScratchArena
+  {
+    using Arena = RegionArena::Arena;
+
+    /**
+     * The number of empty arenas kept by `reset` for reuse.
+     **/
+    static constexpr size_t CACHED_ARENAS = 4;
+
+    /**
+     * Header of an allocation that is too large for an arena.
+     **/
+    struct alignas(Object::ALIGNMENT) Large
+    {
+      Large* next;
+    };
+
+    /**
+     * Arenas in use, most recent first. Only the first has free space that
+     * will be used.
+     **/
+    Arena* used = nullptr;
+
+    /**
+     * Empty arenas, ready to be used.
+     **/
+    Arena* cached = nullptr;
+    size_t cached_count = 0;
+
+    /**
+     * Allocations that are too large for an arena.
+     **/
+    Large* large = nullptr;
+
+  public:
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    ~ScratchArena()
+    {
+      assert(used == nullptr);
+      assert(cached == nullptr);
+      assert(large == nullptr);
+    }
+
+    /**
+     * Allocates `size` bytes, aligned to `Object::ALIGNMENT`. The memory is
+     * valid until the next `reset`.
+     **/
+    void* alloc(Alloc& alloc, size_t size)
+    {
+      size = bits::align_up(size, Object::ALIGNMENT);
+
+      if (SNMALLOC_UNLIKELY(size > Arena::SIZE))
+      {
+        auto l = (Large*)alloc.alloc(sizeof(Large) + size);
+        l->next = large;
+        large = l;
+        return l + 1;
+      }
+
+      if ((used == nullptr) || (used->free_space() < size))
+      {
+        Arena* a = cached;
+        if (a != nullptr)
+        {
+          cached = a->next;
+          cached_count--;
+        }
+        else
+        {
+          a = new (alloc.alloc<sizeof(Arena)>()) Arena();
+        }
+
+        a->next = used;
+        used = a;
+      }
+
+      return used->alloc_bytes(size);
+    }
+
+    /**
+     * Allocates and constructs a `T`. Its destructor is never run, so it must
+     * be trivially destructible.
+     **/
+    template<typename T, typename... Args>
+    T* make(Alloc& alloc, Args&&... args)
+    {
+      static_assert(
+        std::is_trivially_destructible_v<T>,
+        "Scratch data is never destructed");
+      static_assert(
+        alignof(T) <= Object::ALIGNMENT, "Alignment not supported, yet!");
+
+      return new (this->alloc(alloc, sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Forget everything that was allocated. Arenas are kept for reuse, up to
+     * `CACHED_ARENAS`, and the rest are returned to `alloc`.
+     **/
+    void reset(Alloc& alloc)
+    {
+      while (large != nullptr)
+      {
+        Large* l = large;
+        large = l->next;
+        alloc.dealloc(l);
+      }
+
+      while (used != nullptr)
+      {
+        Arena* a = used;
+        used = a->next;
+
+        if (cached_count < CACHED_ARENAS)
+        {
+          a->clear();
+          a->next = cached;
+          cached = a;
+          cached_count++;
+        }
+        else
+        {
+          alloc.dealloc<sizeof(Arena)>(a);
+        }
+      }
+    }
+
+    /**
+     * Forget everything that was allocated, and return all the arenas to
+     * `alloc`.
+     **/
+    void flush(Alloc& alloc)
+    {
+      reset(alloc);
+
+      while (cached != nullptr)
+      {
+        Arena* a = cached;
+        cached = a->next;
+        alloc.dealloc<sizeof(Arena)>(a);
+      }
+      cached_count = 0;
+    }
+
+    /**
+     * Returns true if nothing has been allocated since the last `reset`.
+     **/
+    bool empty() const
+    {
+      return (used == nullptr) && (large == nullptr);
+    }
+  };
+} // namespace verona::rt
@@ -31,6 +31,15 @@ namespace verona::rt
     // Indicate if the content of the noticeboard is std::is_fundamental
     bool is_fundamental;
 
+    // Set while a value is staged by `Noticeboard::stage`.
+    bool is_staged = false;
+    // The value staged by `Noticeboard::stage`.
+    CT staged = 0;
+    // The next noticeboard staged by the running behaviour.
+    BaseNoticeboard* next_staged = nullptr;
+    // Publishes `staged`, set by `Noticeboard`.
+    void (*publish)(BaseNoticeboard*, Alloc&) = nullptr;
+
     template<typename T>
     void put(T v)
     {
@@ -45,6 +54,24 @@ namespace verona::rt
       return *(T*)content;
     }
 
+  public:
+    /**
+     * Publish the values staged on the noticeboards in `list`, and empty it.
+     * This is called when the behaviour that staged them completes.
+     */
+    static void publish_staged(Alloc& alloc, BaseNoticeboard*& list)
+    {
+      while (list != nullptr)
+      {
+        BaseNoticeboard* nb = list;
+        list = nb->next_staged;
+        nb->next_staged = nullptr;
+        nb->is_staged = false;
+        nb->publish(nb, alloc);
+      }
+    }
+
+  protected:
 #ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
     std::deque<CT> update_buffer;
 
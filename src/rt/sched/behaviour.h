@@ -51,6 +51,10 @@ namespace verona::rt
    *
    * The trace is used during leak detection to allow the closure state to be
    * scanned.
+   *
+   * Optionally, it can also provide an `expired` method, and a `drop` method.
+   * Once all the cowns have been acquired, an expired behaviour is dropped
+   * rather than run, and its cowns are released straight away.
    **/
   class Behaviour
   {
@@ -62,6 +66,7 @@ namespace verona::rt
     {
       using Function = void (*)(Behaviour*);
       using TraceFunction = void (*)(const Behaviour*, ObjectStack&);
+      using ExpiredFunction = bool (*)(const Behaviour*);
 
       size_t size;
 
@@ -77,6 +82,19 @@ namespace verona::rt
        **/
       TraceFunction trace;
 
+      /**
+       * Returns true if the behaviour should no longer run, for instance
+       * because its deadline has passed or it has been cancelled. May be
+       * null, if the behaviour always runs.
+       **/
+      ExpiredFunction expired = nullptr;
+
+      /**
+       * Finalise the state of a behaviour that is not run, because it has
+       * expired. May be null, if the behaviour has only trivial state.
+       **/
+      Function drop = nullptr;
+
       static void empty_behaviour_f(Behaviour*) {}
       static void empty_behaviour_trace(const Behaviour*, ObjectStack&) {}
       static const Descriptor* empty()
@@ -109,6 +127,19 @@ namespace verona::rt
       get_descriptor()->trace(this, st);
     }
 
+    inline bool is_expired() const
+    {
+      auto expired = get_descriptor()->expired;
+      return (expired != nullptr) && expired(this);
+    }
+
+    inline void drop()
+    {
+      auto drop = get_descriptor()->drop;
+      if (drop != nullptr)
+        drop(this);
+    }
+
     inline const Descriptor* get_descriptor() const
     {
       return descriptor;
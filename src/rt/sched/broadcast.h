@@ -0,0 +1,188 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../region/immutable.h"
+#include "cown.h"
+#include "epoch.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  enum class BroadcastRead
+  {
+    /// A value was read.
+    Value,
+    /// Every value published so far has been read.
+    Empty,
+    /// Values were overwritten before they were read, see
+    /// `Broadcast::Subscription::missed`.
+    Lagged,
+  };
+
+  /**
+   * A stream of immutables, published by the behaviours of a single cown, in
+   * which every subscriber sees every value, rather than only the latest as
+   * with a `Noticeboard`.
+   *
+   * The last `CAPACITY` values are kept in a ring. Each subscriber keeps its
+   * own read index in a `Subscription`, so publishing is the same amount of
+   * work however many subscribers there are, instead of one message per
+   * subscriber. A subscriber that falls more than `CAPACITY` values behind
+   * misses the oldest ones, and is told so by `read`.
+   *
+   * As with `Noticeboard`, the reference a slot holds is released through
+   * `Epoch::dec_in_epoch` when the slot is overwritten, so a reader only
+   * needs an epoch to take its own reference. The owning cown must pass this
+   * to `trace`.
+   */
+  template<typename T, size_t CAPACITY = 64>
+  class Broadcast
+  {
+    static_assert(snmalloc::bits::is_pow2(CAPACITY));
+    static constexpr size_t MASK = CAPACITY - 1;
+    /// Sequence number of a slot that is being overwritten.
+    static constexpr size_t WRITING = ~(size_t)0;
+
+    struct Slot
+    {
+      /// Index of the value in `content`, or `WRITING`.
+      std::atomic<size_t> seq{WRITING};
+      std::atomic<T*> content{nullptr};
+    };
+
+    Slot slots[CAPACITY];
+    /// Index of the next value to publish.
+    std::atomic<size_t> tail{0};
+
+  public:
+    class Subscription
+    {
+      friend Broadcast;
+
+      size_t next;
+
+      Subscription(size_t next) : next(next) {}
+
+    public:
+      /// Number of values this subscriber has missed by lagging.
+      size_t missed = 0;
+    };
+
+    Broadcast() = default;
+    Broadcast(const Broadcast&) = delete;
+    Broadcast& operator=(const Broadcast&) = delete;
+
+    /**
+     * Returns a subscription that starts with the next value published.
+     */
+    Subscription subscribe() const
+    {
+      return Subscription(tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Number of published values that `sub` has not read. This is more than
+     * `CAPACITY` if it has lagged.
+     */
+    size_t backlog(const Subscription& sub) const
+    {
+      return tail.load(std::memory_order_acquire) - sub.next;
+    }
+
+    bool is_lagging(const Subscription& sub) const
+    {
+      return backlog(sub) > CAPACITY;
+    }
+
+    /**
+     * Publishes the immutable `o`, taking over a reference to it. Only
+     * behaviours on the owning cown may call this.
+     */
+    void publish(Alloc& alloc, T* o)
+    {
+      assert(o->debug_is_immutable());
+      size_t t = tail.load(std::memory_order_relaxed);
+      Slot& slot = slots[t & MASK];
+
+      slot.seq.store(WRITING, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      T* prev = slot.content.exchange(o, std::memory_order_relaxed);
+      slot.seq.store(t, std::memory_order_release);
+      tail.store(t + 1, std::memory_order_release);
+
+      if (prev != nullptr)
+      {
+        Epoch e(alloc);
+        Logging::cout() << "Broadcast " << this << " overwriting " << prev
+                        << Logging::endl;
+        e.dec_in_epoch(prev);
+      }
+    }
+
+    /**
+     * Reads the next value for `sub` into `out`, with a reference that the
+     * caller must release. If `sub` has lagged, this skips to the oldest
+     * value still held, adds the skipped values to `sub.missed`, and returns
+     * `Lagged` without reading.
+     */
+    BroadcastRead read(Alloc& alloc, Subscription& sub, T*& out)
+    {
+      while (true)
+      {
+        size_t t = tail.load(std::memory_order_acquire);
+        if (sub.next == t)
+          return BroadcastRead::Empty;
+
+        if (t - sub.next > CAPACITY)
+        {
+          sub.missed += t - CAPACITY - sub.next;
+          sub.next = t - CAPACITY;
+          return BroadcastRead::Lagged;
+        }
+
+        Slot& slot = slots[sub.next & MASK];
+        {
+          Epoch e(alloc);
+          size_t seq = slot.seq.load(std::memory_order_acquire);
+          T* p = slot.content.load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (
+            (seq != sub.next) ||
+            (slot.seq.load(std::memory_order_relaxed) != seq))
+          {
+            // Overwritten while reading, so recheck for lag.
+            continue;
+          }
+          // The epoch keeps `p` alive even if the slot is overwritten now.
+          p->incref();
+          out = p;
+        }
+
+        // As for `Noticeboard::peek`, reading is receiving a message, so the
+        // value must be scanned if the leak detector is running.
+        if (Scheduler::should_scan())
+        {
+          ObjectStack f(alloc);
+          out->trace(f);
+          Cown::scan_stack(alloc, Scheduler::epoch(), f);
+        }
+
+        sub.next++;
+        return BroadcastRead::Value;
+      }
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      for (auto& slot : slots)
+      {
+        T* p = slot.content.load(std::memory_order_relaxed);
+        if (p != nullptr)
+          st.push(p);
+      }
+    }
+  };
+} // namespace verona::rt
@@ -2,11 +2,15 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include "injector.h"
 #include "mpmcq.h"
+#include "runring.h"
 #include "schedulerstats.h"
+#include "task.h"
 
 #include <atomic>
 #include <snmalloc/snmalloc.h>
+#include <vector>
 
 namespace verona::rt
 {
@@ -16,9 +20,47 @@ namespace verona::rt
   public:
     size_t affinity = 0;
     T* token_cown = nullptr;
+    /// Stub of the high priority queue. Unlike `token_cown` it plays no part
+    /// in the leak detector.
+    T* high_token_cown = nullptr;
+    /// Stub of the pinned queue. It takes the place of `token_cown` for that
+    /// queue in the leak detector, see `SchedulerThread::n_pinned_tokens`.
+    T* pinned_token_cown = nullptr;
     MPMCQ<T> q;
+    /// Cowns with high priority. This queue is consulted before `q`.
+    MPMCQ<T> q_high;
+    /// Cowns pinned to this core, see `Cown::pin`. Only the threads of this
+    /// core take cowns from this queue, so they are never stolen.
+    MPMCQ<T> q_pinned;
+#ifdef USE_RUN_RING
+    /// Cowns rescheduled on this core by its own scheduler thread, which are
+    /// taken before `q`. See `SchedulerThread::schedule_fifo`.
+    RunRing<T> ring;
+#endif
+    /// Tasks scheduled by the scheduler thread of this core, see `Task`.
+    RunRing<Task> tasks;
     std::atomic<Core<T>*> next = nullptr;
 
+    /// Injection queues of external threads, see `Injector`.
+    std::atomic<Injector<T>*> injectors = nullptr;
+    /// Number of `injectors` claimed by an external thread.
+    std::atomic<size_t> injector_count = 0;
+
+    /// The other cores in the order they should be stolen from: hyperthreads
+    /// of the same physical core, then the same NUMA node, then remote ones.
+    std::vector<Core<T>*> victims;
+    /// Index in `victims` of the first core on a remote NUMA node.
+    size_t first_remote = 0;
+
+    /// Set while the scheduler thread of this core is retired by an elastic
+    /// pool. See `ThreadPool::set_elastic`.
+    std::atomic<bool> retired = false;
+
+    /// Approximate number of cowns waiting in the queues of this core. This
+    /// is incremented before a cown is enqueued, and decremented after it is
+    /// dequeued, so it cannot underflow.
+    std::atomic<size_t> queued = 0;
+
     /// Progress and synchronization between the threads.
     //  These counters represent progress on a CPU core, not necessarily on
     //  the core's queue. This is necessary to take into account core-stealing
@@ -35,23 +77,101 @@ namespace verona::rt
     // `list`. This is atomic as other threads can collect the body of the
     // cown managed from this thread.  They cannot collect the actual cown
     // allocation.  The ratio of free_cowns to total_cowns is used to
-    // determine when to walk the `list` to collect the stubs.
+    // determine when to collect the stubs in `free_list`.
     std::atomic<size_t> free_cowns = 0;
 
     SchedulerStats stats;
 
+    /// The cowns of this core, linked through `next` and `prev`. Cowns are
+    /// only added and removed by the scheduler thread of this core.
     std::atomic<T*> list = nullptr;
 
+    /// Cowns bound to this core by a helper thread of the system monitor,
+    /// linked through `next`, that are yet to be added to `list` by the
+    /// scheduler thread of the core. Any thread can add to it, see
+    /// `add_pending`.
+    std::atomic<T*> pending = nullptr;
+
+    /// The cowns of `list` whose weak count has dropped to zero, linked
+    /// through `next_free`, so that their stubs are collected without walking
+    /// `list`. Any thread can add to it, see `add_free`.
+    std::atomic<T*> free_list = nullptr;
+
+    /// The next cown of `list` to reschedule in the scan started by
+    /// `start_scan`, or null once the scan is over.
+    T* scan_next = nullptr;
+
   public:
-    Core() : token_cown{T::create_token_cown()}, q{token_cown}
+    Core()
+    : token_cown{T::create_token_cown()},
+      high_token_cown{T::create_token_cown()},
+      pinned_token_cown{T::create_token_cown()},
+      q{token_cown},
+      q_high{high_token_cown},
+      q_pinned{pinned_token_cown}
     {
       token_cown->set_owning_core(this);
+      high_token_cown->set_owning_core(this);
+      pinned_token_cown->set_owning_core(this);
+    }
+
+    ~Core()
+    {
+      Injector<T>::destroy(this);
     }
 
-    ~Core() {}
+    /// The position of `other` in the order this core steals from. This core
+    /// itself comes first.
+    size_t distance_rank(Core<T>* other)
+    {
+      if (other == this)
+        return 0;
+
+      for (size_t i = 0; i < victims.size(); i++)
+      {
+        if (victims[i] == other)
+          return i + 1;
+      }
+
+      return victims.size() + 1;
+    }
+
+    /// The order in which paused threads are woken for work on this core.
+    /// Threads of retired cores come after all the others, unless cowns are
+    /// waiting in `q_pinned`, which only the thread of this core can run.
+    size_t wake_rank(Core<T>* other)
+    {
+      if ((other == this) && !q_pinned.nothing_old())
+        return 0;
+
+      size_t rank = distance_rank(other);
+      if (other->retired.load(std::memory_order_relaxed))
+        rank += victims.size() + 2;
+      return rank;
+    }
+
+    /// The queue that `cown` should be scheduled on, if this is its core.
+    MPMCQ<T>& queue_for(T* cown)
+    {
+      if (cown->is_pinned())
+        return q_pinned;
+      return cown->is_high_priority() ? q_high : q;
+    }
+
+    /// See `MPMCQ::nothing_old`. All queues must have been flushed through.
+    bool nothing_old()
+    {
+#ifdef USE_RUN_RING
+      if (!ring.empty())
+        return false;
+#endif
+      return q_high.nothing_old() && q.nothing_old() &&
+        q_pinned.nothing_old() && tasks.empty() && Injector<T>::empty(this);
+    }
 
     void collect(Alloc& alloc)
     {
+      flush_pending();
       T* head = list.exchange(nullptr);
       T* tail = head;
       T* cown = head;
@@ -68,6 +188,7 @@ namespace verona::rt
 
     void try_collect(Alloc& alloc, EpochMark epoch)
     {
+      flush_pending();
       T* head = list.exchange(nullptr);
       T* tail = head;
       T* cown = head;
@@ -82,20 +203,27 @@ namespace verona::rt
         add_cowns(head, tail);
     }
 
-    void scan()
+    /// Starts a scan of the cowns of this core, see `scan`.
+    void start_scan()
     {
-      T* head = list.exchange(nullptr);
-      T* tail = head;
-      T* p = head;
-      while (p != nullptr)
+      flush_pending();
+      scan_next = list.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Reschedules up to `batch` more cowns of the scan started by
+     * `start_scan`, so that the leak detector scans the ones that are not
+     * already scheduled. Returns true once every cown has been reached.
+     */
+    bool scan(size_t batch)
+    {
+      for (; (scan_next != nullptr) && (batch > 0); batch--)
       {
-        if (p->can_lifo_schedule())
-          p->reschedule();
-        tail = p;
-        p = p->next;
+        if (scan_next->can_lifo_schedule())
+          scan_next->reschedule();
+        scan_next = scan_next->next;
       }
-      if (tail != nullptr)
-        add_cowns(head, tail);
+      return scan_next == nullptr;
     }
 
     /**
@@ -103,11 +231,7 @@ namespace verona::rt
      */
     void add_cown(T* cown)
     {
-      cown->next = list;
-      while (!list.compare_exchange_weak(cown->next, cown))
-      {
-        cown->next = list;
-      }
+      add_cowns(cown, cown);
     }
 
     /*
@@ -116,11 +240,69 @@ namespace verona::rt
     void add_cowns(T* head, T* tail)
     {
       assert(head != nullptr && tail != nullptr);
+      head->prev = nullptr;
       tail->next = list;
       while (!list.compare_exchange_weak(tail->next, head))
       {
         tail->next = list;
       }
+      if (tail->next != nullptr)
+        tail->next->prev = tail;
+    }
+
+    /**
+     * Atomically add a segment of cowns, linked through `next`, to `pending`.
+     */
+    void add_pending(T* head, T* tail)
+    {
+      assert(head != nullptr && tail != nullptr);
+      tail->next = pending;
+      while (!pending.compare_exchange_weak(tail->next, head))
+      {
+        tail->next = pending;
+      }
+    }
+
+    /**
+     * Move the cowns of `pending` to the list. The scheduler thread of the
+     * core calls this before it walks the list, and after `drain_free` when
+     * it removes the cowns drained, so that each of them is in the list.
+     */
+    void flush_pending()
+    {
+      T* head = pending.exchange(nullptr);
+      if (head == nullptr)
+        return;
+
+      T* tail = head;
+      while (tail->next != nullptr)
+      {
+        tail->next->prev = tail;
+        tail = tail->next;
+      }
+      add_cowns(head, tail);
+    }
+
+    /**
+     * Remove `cown` from the list, without walking it.
+     */
+    void remove_cown(T* cown)
+    {
+      if (cown->prev == nullptr)
+      {
+        assert(list == cown);
+        list = cown->next;
+      }
+      else
+      {
+        cown->prev->next = cown->next;
+      }
+
+      if (cown->next != nullptr)
+        cown->next->prev = cown->prev;
+
+      if (scan_next == cown)
+        scan_next = cown->next;
     }
 
     /*
@@ -128,7 +310,28 @@ namespace verona::rt
      * */
     T* drain()
     {
+      flush_pending();
       return list.exchange(nullptr);
     }
+
+    /**
+     * Add `cown`, whose weak count has dropped to zero, to `free_list`.
+     */
+    void add_free(T* cown)
+    {
+      cown->next_free = free_list;
+      while (!free_list.compare_exchange_weak(cown->next_free, cown))
+      {
+        cown->next_free = free_list;
+      }
+    }
+
+    /*
+     * Take ownership of the entire content of the free list.
+     * */
+    T* drain_free()
+    {
+      return free_list.exchange(nullptr);
+    }
   };
 }
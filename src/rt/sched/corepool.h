@@ -3,6 +3,7 @@
 #pragma once
 
 #include "core.h"
+#include "pal/numa.h"
 #include "pal/threading.h"
 
 #ifdef USE_SYSTEM_MONITOR
@@ -25,28 +26,117 @@ namespace verona::rt
     Core<T>* first_core = nullptr;
     size_t core_count = 0;
 
+    /**
+     * Allocate a core on the NUMA node of the CPU `affinity`, so that its
+     * queues and counters are local to the scheduler thread that runs it.
+     */
+    static Core<T>* make_core(size_t affinity)
+    {
+      size_t node = topology.get().numa_node(affinity);
+      void* p = numa::alloc(sizeof(Core<T>), node);
+      auto c = new (p) Core<T>;
+      c->affinity = affinity;
+      return c;
+    }
+
+    static void delete_core(Core<T>* c)
+    {
+      c->~Core<T>();
+      numa::dealloc(c, sizeof(Core<T>));
+    }
+
   public:
     void init(size_t count)
     {
       core_count = count;
-      first_core = new Core<T>;
+      first_core = make_core(topology.get().get(count));
       Core<T>* t = first_core;
 
-      while (true)
+      while (count > 1)
       {
-        t->affinity = topology.get().get(count);
-        if (count > 1)
-        {
-          t->next = new Core<T>;
-          t = t->next;
-          count--;
-        }
-        else
+        count--;
+        t->next = make_core(topology.get().get(count));
+        t = t->next;
+      }
+      t->next = first_core;
+
+      init_victims();
+    }
+
+    /// Restrict the CPUs the cores are placed on, see `Topology::Placement`.
+    static void set_placement(const Topology::Placement& placement)
+    {
+      topology.get().set_placement(placement);
+    }
+
+    /// The NUMA node of the CPU of `core`.
+    static size_t numa_node(Core<T>* core)
+    {
+      return topology.get().numa_node(core->affinity);
+    }
+
+    /**
+     * The core for an external thread running on `cpu` to inject cowns into,
+     * see `Injector`. This is the core with the fewest claimed injectors on
+     * the NUMA node of `cpu`, or of all cores if none is on that node.
+     */
+    Core<T>* injection_core(size_t cpu)
+    {
+      if (first_core == nullptr)
+        return nullptr;
+
+      auto& top = topology.get();
+      size_t node = top.numa_node_of(cpu, (size_t)-1);
+      Core<T>* best = nullptr;
+      bool best_local = false;
+      size_t best_count = 0;
+      Core<T>* c = first_core;
+      do
+      {
+        bool local = top.numa_node(c->affinity) == node;
+        size_t count = c->injector_count.load(std::memory_order_relaxed);
+        if (
+          (best == nullptr) || (local && !best_local) ||
+          ((local == best_local) && (count < best_count)))
         {
-          t->next = first_core;
-          break;
+          best = c;
+          best_local = local;
+          best_count = count;
         }
-      }
+        c = c->next;
+      } while (c != first_core);
+      return best;
+    }
+
+    /**
+     * Order the other cores of each core by their distance, keeping the ring
+     * order between cores at the same distance.
+     */
+    void init_victims()
+    {
+      auto& top = topology.get();
+      Core<T>* c = first_core;
+      do
+      {
+        c->victims.clear();
+        for (Core<T>* v = c->next; v != c; v = v->next)
+          c->victims.push_back(v);
+
+        std::stable_sort(
+          c->victims.begin(), c->victims.end(), [&](Core<T>* a, Core<T>* b) {
+            return top.distance(c->affinity, a->affinity) <
+              top.distance(c->affinity, b->affinity);
+          });
+
+        c->first_remote = 0;
+        while ((c->first_remote < c->victims.size()) &&
+               (top.distance(
+                  c->affinity, c->victims[c->first_remote]->affinity) !=
+                Topology::Remote))
+          c->first_remote++;
+
+        c = c->next;
+      } while (c != first_core);
     }
 
     void clear()
@@ -58,11 +148,11 @@ namespace verona::rt
       while (core != first_core)
       {
         Core<T>* next = core->next;
-        delete core;
+        delete_core(core);
         count++;
         core = next;
       }
-      delete first_core;
+      delete_core(first_core);
       count++;
       first_core = nullptr;
       assert(count == core_count);
@@ -9,7 +9,13 @@
 #include "../test/systematic.h"
 #include "base_noticeboard.h"
 #include "core.h"
+#ifdef USE_COWN_PROFILER
+#  include "cownprofiler.h"
+#endif
 #include "multimessage.h"
+#ifdef USE_PERF_COUNTERS
+#  include "perfcounters.h"
+#endif
 #include "schedulerthread.h"
 
 #include <algorithm>
@@ -27,6 +33,7 @@ namespace verona::rt
     Systematic::yield();
   }
 
+#ifdef USE_ENQUEUE_LOCK
   struct EnqueueLock
   {
     std::atomic<bool> locked = false;
@@ -49,6 +56,77 @@ namespace verona::rt
       locked.store(false, std::memory_order_release);
     }
   };
+#else
+  /**
+   * A multi-message's place in the queue of multi-messages waiting to enqueue
+   * on a cown. The nodes live on the stack of the sending thread, and each
+   * waiting thread only spins on its own node.
+   */
+  struct EnqueueNode
+  {
+    std::atomic<EnqueueNode*> next{nullptr};
+    std::atomic<bool> waiting{true};
+  };
+
+  /**
+   * Orders the multi-messages enqueueing on a cown.
+   *
+   * A multi-message must be enqueued on all of its cowns before any later
+   * multi-message can overtake it on any of them, otherwise two behaviours
+   * could be ordered differently on two cowns and wait for each other. In the
+   * first phase, `fast_send` joins the queue of every cown in the sorted order
+   * of the requests with a single exchange each, and only waits if there is a
+   * predecessor still enqueueing on that cown. In the second phase, it
+   * enqueues the messages, handing off each cown to its successor as soon as
+   * its message has been enqueued.
+   */
+  struct EnqueueQueue
+  {
+    std::atomic<EnqueueNode*> tail{nullptr};
+
+    void join(EnqueueNode& node)
+    {
+      auto prev = tail.exchange(&node, std::memory_order_acq_rel);
+      if (prev == nullptr)
+        return;
+
+      prev->next.store(&node, std::memory_order_release);
+      while (node.waiting.load(std::memory_order_acquire))
+      {
+        yield();
+      }
+    }
+
+    void leave(EnqueueNode& node)
+    {
+      auto next = node.next.load(std::memory_order_acquire);
+      if (next == nullptr)
+      {
+        auto expected = &node;
+        if (tail.compare_exchange_strong(
+              expected, nullptr, std::memory_order_acq_rel))
+          return;
+
+        // A successor has joined, but not yet linked itself to this node.
+        while ((next = node.next.load(std::memory_order_acquire)) == nullptr)
+        {
+          yield();
+        }
+      }
+      next->waiting.store(false, std::memory_order_release);
+    }
+  };
+#endif
+
+  /**
+   * Scheduling priority of a cown. High priority cowns are scheduled on a
+   * separate queue of each core, that is consulted first.
+   */
+  enum class Priority : uint8_t
+  {
+    Normal,
+    High
+  };
 
   /**
    * A cown, or concurrent owner, encapsulates a set of resources that may be
@@ -120,6 +198,36 @@ namespace verona::rt
   {
     using MessageBody = MultiMessage::Body;
 
+    /**
+     * Read-only behaviours whose last cown, this one, was acquired while
+     * processing a batch of messages in `run`. A run of consecutive readers
+     * is dispatched together by `run_readers`.
+     **/
+    struct ReadBatch
+    {
+      static constexpr size_t capacity = 8;
+
+      MessageBody* bodies[capacity];
+      EpochMark epochs[capacity];
+      size_t count = 0;
+
+      void add(MessageBody* body, EpochMark e)
+      {
+        assert(count < capacity);
+        bodies[count] = body;
+        epochs[count] = e;
+        count++;
+      }
+
+      /// Returns true if `next`, the next message in the queue, may extend
+      /// the run of readers.
+      bool can_add(MultiMessage* next)
+      {
+        return (count < capacity) && (next != nullptr) &&
+          next->get_request()->is_read();
+      }
+    };
+
   public:
     enum TryFastSend
     {
@@ -133,10 +241,10 @@ namespace verona::rt
 
       if (initialise)
       {
-        auto& alloc = ThreadAlloc::get();
         auto epoch = Scheduler::alloc_epoch();
         set_epoch(epoch);
-        queue.init(stub_msg(alloc));
+        stub.body = nullptr;
+        queue.init(&stub);
         CownThread* local = Scheduler::local();
 
         if (local != nullptr)
@@ -144,8 +252,14 @@ namespace verona::rt
           if (local->core == nullptr)
             abort();
           set_owning_core(local->core);
-          local->core->add_cown(this);
-          local->core->total_cowns++;
+          if (batch != nullptr)
+          {
+            batch->add(this);
+          }
+          else
+          {
+            local->bind_cowns(this, this, 1);
+          }
         }
         else
         {
@@ -155,14 +269,70 @@ namespace verona::rt
       }
     }
 
+    /**
+     * While a `Batch` is alive, the cowns that this scheduler thread
+     * allocates are linked into a private segment, which is added to the
+     * list of its core, and counted, once when the batch ends. This saves
+     * the atomic updates of the list and its count for each cown, when many
+     * are allocated at once, see `make_cowns`.
+     *
+     * Batches must not be nested. Cowns allocated outside a scheduler thread
+     * are not linked until they first run, so a batch has no effect there.
+     */
+    class Batch
+    {
+      Cown* head = nullptr;
+      Cown* tail = nullptr;
+      size_t count = 0;
+
+      friend Cown;
+
+      void add(Cown* cown)
+      {
+        cown->prev = nullptr;
+        cown->next = head;
+        if (head != nullptr)
+          head->prev = cown;
+        else
+          tail = cown;
+        head = cown;
+        count++;
+      }
+
+    public:
+      Batch()
+      {
+        assert(Cown::batch == nullptr);
+        Cown::batch = this;
+      }
+
+      Batch(const Batch&) = delete;
+      Batch& operator=(const Batch&) = delete;
+
+      ~Batch()
+      {
+        Cown::batch = nullptr;
+        if (head == nullptr)
+          return;
+
+        Scheduler::local()->bind_cowns(head, tail, count);
+      }
+    };
+
   private:
     friend class MultiMessage;
     friend CownThread;
     friend Core<Cown>;
 
+    /// The batch that cowns allocated by this thread are added to, if any.
+    inline static thread_local Batch* batch = nullptr;
+
     template<typename T>
     friend class Noticeboard;
 
+    template<typename T, size_t CAPACITY>
+    friend class Broadcast;
+
     template<typename T>
     friend class MPMCQ;
 
@@ -174,7 +344,6 @@ namespace verona::rt
       uint64_t epoch_when_popped{NO_EPOCH_SET};
     };
 
-    // Seven pointer overhead compared to an object.
     verona::rt::MPSCQ<MultiMessage> queue{};
 
     // Used for garbage collection of cyclic cowns only.
@@ -183,6 +352,10 @@ namespace verona::rt
     // collect again when the weak reference count hits 0.
     std::atomic<uintptr_t> core_status{0};
     Cown* next{nullptr};
+    Cown* prev{nullptr};
+
+    /// Link in the `free_list` of the owning core.
+    Cown* next_free{nullptr};
 
     /**
      * Cown's weak reference count.  This keeps the cown itself alive, but not
@@ -198,7 +371,70 @@ namespace verona::rt
      */
     ReadRefCount read_ref_count;
 
+#ifdef USE_ENQUEUE_LOCK
     EnqueueLock enqueue_lock;
+#else
+    EnqueueQueue enqueue_queue;
+#endif
+
+    /**
+     * Backpressure state.  A cown is overloaded when more than
+     * `overload_threshold` messages are pending in its queue. Behaviours that
+     * send to an overloaded cown have their write-acquired cowns muted, that
+     * is, parked by the scheduler thread until the overloaded cown has
+     * drained.
+     *
+     * A cown with pending multi-messages is never muted, and a muted cown is
+     * unmuted when it is sent a multi-message. So no other cown can be
+     * waiting to acquire a muted cown, and muting cannot cause a deadlock.
+     *
+     * `dequeued` is only written by the scheduler thread running this cown.
+     * The counters wrap, and only their difference is used, so 32 bits are
+     * enough for any queue that fits in memory.
+     **/
+    static constexpr size_t overload_threshold = 1024;
+    std::atomic<uint32_t> enqueued{0};
+    std::atomic<uint32_t> dequeued{0};
+    std::atomic<uint32_t> pending_multi{0};
+
+#ifdef USE_COWN_PROFILER
+    /// The slot of this cown in `CownProfiler`, if this cown still owns it.
+    std::atomic<CownProfileSlot*> profile{nullptr};
+    /// Tick at which a behaviour acquired this cown for writing, and started
+    /// waiting for its other cowns, or zero.
+    uint64_t blocked_since = 0;
+#endif
+
+    /**
+     * The maximum number of messages processed by the next call to `run`.
+     * This adapts to the load on the core running this cown, see
+     * `next_batch_limit`, unless the descriptor provides its own policy.
+     * Only accessed by the scheduler thread running this cown.
+     **/
+    uint32_t batch_limit = initial_batch_limit;
+
+    std::atomic<bool> muted{false};
+    std::atomic<Priority> priority{Priority::Normal};
+    /// Set if `home_core` is fixed, see `pin`.
+    std::atomic<bool> pinned{false};
+
+    /**
+     * The core that last ran this cown. Wakeups are routed to it, as the state
+     * of the cown is likely to still be in the caches of that core, see
+     * `SchedulerThread::schedule_fifo`. Unlike `owning_core`, which is fixed
+     * when the cown first runs and only determines the list it is collected
+     * from, this follows the cown when it is stolen.
+     **/
+    std::atomic<Core<Cown>*> home_core{nullptr};
+
+    /**
+     * The first element of `queue` once the cown has gone to sleep, see
+     * `try_sleep`. Otherwise the last message processed would stay at the
+     * front of the queue, and keep its whole behaviour body alive until the
+     * next message arrives. Each cown needs its own stub, as the queue links
+     * through it.
+     **/
+    MultiMessage stub;
 
     static Cown* create_token_cown()
     {
@@ -238,6 +474,106 @@ namespace verona::rt
     }
 
   public:
+    static constexpr size_t min_batch_limit = 10;
+    static constexpr size_t initial_batch_limit = 100;
+    static constexpr size_t max_batch_limit = 10'000;
+
+    /**
+     * The default batch policy. The batch limit is halved if other cowns are
+     * waiting to run on this core, so that they are not delayed by a busy
+     * cown. Otherwise, it is doubled if the queue still had messages when the
+     * batch ended, so that a busy cown running alone is not rescheduled for
+     * every few messages.
+     **/
+    static size_t next_batch_limit(size_t limit, bool hot, bool contended)
+    {
+      if (contended)
+        return (std::max)(limit / 2, min_batch_limit);
+      if (hot)
+        return (std::min)(limit * 2, max_batch_limit);
+      return limit;
+    }
+
+    size_t get_batch_limit()
+    {
+      return batch_limit;
+    }
+
+    /**
+     * Set the scheduling priority of this cown. This takes effect the next
+     * time the cown is scheduled. A high priority cown runs before the normal
+     * priority cowns waiting on the same core, but a normal priority cown is
+     * still run after every few high priority ones, see
+     * `SchedulerThread::dequeue`.
+     **/
+    void set_priority(Priority p)
+    {
+      priority.store(p, std::memory_order_relaxed);
+    }
+
+    bool is_high_priority()
+    {
+      return priority.load(std::memory_order_relaxed) == Priority::High;
+    }
+
+    Core<Cown>* get_home_core()
+    {
+      return home_core.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Pin this cown to core `c`. It is then only run by the scheduler thread
+     * of that core, from a queue of the core that is never stolen from, see
+     * `Core::q_pinned`, so its state stays in the caches of that core. Other
+     * cowns are still stolen as usual. This takes the place of the priority
+     * of the cown, and takes effect the next time the cown is scheduled. A
+     * behaviour on several cowns runs where the last of them is acquired, so
+     * only behaviours on pinned cowns alone are sure to run on that core.
+     *
+     * This must not race with the cown being run, so it should be called
+     * before the cown is first scheduled, or from a behaviour on the cown.
+     **/
+    void pin(Core<Cown>* c)
+    {
+      home_core.store(c, std::memory_order_relaxed);
+      pinned.store(true, std::memory_order_release);
+    }
+
+    /// Pin this cown to the core of the calling scheduler thread.
+    void pin()
+    {
+      pin(Scheduler::local()->core);
+    }
+
+    /// Let this cown be stolen again, see `pin`.
+    void unpin()
+    {
+      pinned.store(false, std::memory_order_relaxed);
+    }
+
+    bool is_pinned()
+    {
+      return pinned.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Record that this cown is running on core `c`. Returns true if the cown
+     * last ran on a different core. The home core of a pinned cown does not
+     * move.
+     **/
+    bool move_home_core(Core<Cown>* c)
+    {
+      if (is_pinned())
+        return false;
+
+      auto prev = home_core.load(std::memory_order_relaxed);
+      if (prev == c)
+        return false;
+
+      home_core.store(c, std::memory_order_relaxed);
+      return prev != nullptr;
+    }
+
 #ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
     std::vector<BaseNoticeboard*> noticeboards;
 
@@ -331,7 +667,8 @@ namespace verona::rt
                           << Logging::endl;
           // The cown may have already been swept, just remove weak count, let
           // sweeping/cown stub collection deal with the rest.
-          a->weak_count.fetch_sub(1);
+          if (a->weak_count.fetch_sub(1) == 1)
+            a->free_stub();
           return;
         }
       }
@@ -367,14 +704,27 @@ namespace verona::rt
         // Register that the epoch should be moved on
         {
           Epoch e(alloc);
-          e.add_pressure();
+          e.add_pressure(size());
         }
-        // Tell owning thread that it has a free cown to collect.
-        t->free_cowns++;
-        yield();
+        free_stub();
       }
     }
 
+    /**
+     * Tell the owning thread that it has a free cown to collect, once the
+     * weak count has dropped to zero.
+     **/
+    void free_stub()
+    {
+      auto* t = owning_core();
+      if (t == nullptr)
+        return;
+
+      t->free_cowns++;
+      t->add_free(this);
+      yield();
+    }
+
     void weak_acquire()
     {
       Logging::cout() << "Cown " << this << " weak acquire" << Logging::endl;
@@ -444,8 +794,43 @@ namespace verona::rt
       // TODO Make this assertion pass.
       // assert(can_lifo_schedule() || Scheduler::debug_not_running());
 
-      auto* core = Scheduler::round_robin();
-      CownThread::schedule_lifo(core, this);
+      CownThread::inject(this);
+    }
+
+    /**
+     * Schedule this cown, which a behaviour has just made runnable, to run on
+     * this scheduler thread once the current cown has run, see
+     * `SchedulerThread::schedule_next`.
+     **/
+    void schedule_next()
+    {
+      CownThread* t = Scheduler::local();
+
+      if (t != nullptr)
+      {
+        t->schedule_next(this);
+        return;
+      }
+
+      schedule();
+    }
+
+    /**
+     * Reschedule this cown as its readers start to run on this scheduler
+     * thread. It is preferably put on the queue of another core, so that
+     * another scheduler thread carries on with its queue, and runs further
+     * readers in parallel, see `SchedulerThread::reader_core`.
+     **/
+    void schedule_reader()
+    {
+      CownThread* t = Scheduler::local();
+      if (t != nullptr)
+      {
+        t->schedule_reader(this);
+        return;
+      }
+
+      schedule();
     }
 
   private:
@@ -512,13 +897,120 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Number of messages in the queue of this cown. As the messages are
+     * counted before being enqueued, this can be an overestimate, but never
+     * an underestimate.
+     **/
+    size_t queue_length()
+    {
+      // Read `dequeued` first, so it cannot overtake `enqueued`.
+      auto d = dequeued.load(std::memory_order_acquire);
+      return (uint32_t)(enqueued.load(std::memory_order_relaxed) - d);
+    }
+
+    void count_dequeue(MultiMessage* m)
+    {
+#ifdef USE_COWN_PROFILER
+      size_t length = queue_length();
+      auto* slot =
+        profile_slot(length >= CownProfiler::get_queue_threshold());
+      if (slot != nullptr)
+        CownProfiler::max_queue(slot, length);
+#endif
+
+      dequeued.store(
+        dequeued.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+
+      if (m->get_body()->count > 1)
+        pending_multi.fetch_sub(1);
+    }
+
+    bool is_overloaded()
+    {
+      return queue_length() > overload_threshold;
+    }
+
+#ifdef USE_COWN_PROFILER
+    /**
+     * The slot of this cown in `CownProfiler`, which is claimed if this cown
+     * is not tracked and `track` is true. Returns null if this cown is not
+     * tracked.
+     **/
+    CownProfileSlot* profile_slot(bool track)
+    {
+      auto* slot = profile.load(std::memory_order_relaxed);
+      if (CownProfiler::owns(slot, this))
+        return slot;
+
+      if (!track)
+        return nullptr;
+
+      slot = CownProfiler::track(this, get_descriptor());
+      profile.store(slot, std::memory_order_relaxed);
+      return slot;
+    }
+
+    /**
+     * Record the time the cowns written by `body`, other than this one, were
+     * held waiting for this cown.
+     **/
+    void profile_blocked(MessageBody& body)
+    {
+      uint64_t now = Aal::tick();
+      for (size_t i = 0; i < body.count; i++)
+      {
+        Request request = body.get_requests_array()[i];
+        Cown* cown = request.cown();
+        if ((cown == nullptr) || (cown == this) || request.is_read())
+          continue;
+
+        // Skip a cown that has not recorded when it was acquired.
+        uint64_t since = cown->blocked_since;
+        if (since == 0)
+          continue;
+        cown->blocked_since = 0;
+
+        auto* slot = cown->profile_slot(true);
+        if (slot != nullptr)
+          CownProfiler::blocked(slot, now > since ? now - since : 0);
+      }
+    }
+#endif
+
+    /**
+     * Mark this cown as muted.  Returns false if the cown could not be muted,
+     * in which case the caller remains responsible for rescheduling it.
+     **/
+    bool try_mute()
+    {
+      muted.store(true);
+      yield();
+
+      // Another cown may be waiting to acquire this cown.
+      if (pending_multi.load() == 0)
+        return true;
+
+      // If this fails, then a concurrent multi-message send has unmuted and
+      // rescheduled this cown.
+      return !muted.exchange(false);
+    }
+
+    /**
+     * Clear the muted flag.  Returns true if this call unmuted the cown, in
+     * which case the caller must reschedule it.
+     **/
+    bool try_unmute()
+    {
+      return muted.load(std::memory_order_relaxed) && muted.exchange(false);
+    }
+
     void cown_notified()
     {
       // This is not a message make sure we know that.
-      // TODO: Back pressure.  This means that a notification that sends to
-      // an overloaded cown will not mute this cown.  We could set up a fake
-      // message structure, or alter how the backpressure system determines
-      // which is/are the currently active cowns.
+      // A notification that sends to an overloaded cown will not mute this
+      // cown, as only the cowns of a running behaviour can be muted.
       Scheduler::local()->message_body = nullptr;
       notified();
     }
@@ -541,16 +1033,32 @@ namespace verona::rt
      *     message.
      * (2) We sent the message to the last cown. There are no further cowns to
      *     acquire, so we schedule the last cown so it can handle the
-     *     multi-message behaviour.
-     *     TODO: It would be semantically valid to execute the behaviour without
-     *     rescheduling. However, for fairness, it is better to reschedule in
-     *     case the behaviour executes for a very long time.
+     *     multi-message behaviour.  If inline behaviours are enabled, then
+     *     the behaviour is instead run immediately on this scheduler thread,
+     *     see `run_inline`.
+     *
+     * Before sending any messages, the enqueue of every cown is acquired in
+     * order, so that all cowns observe multi-messages in a consistent order,
+     * see `EnqueueQueue`. If USE_ENQUEUE_LOCK is defined, a spin lock per cown
+     * is used instead.
      **/
     static void fast_send(MultiMessage::Body* body, EpochMark epoch)
     {
       auto& alloc = ThreadAlloc::get();
       const auto last = body->count - 1;
 
+#ifndef USE_ENQUEUE_LOCK
+      static constexpr size_t stack_nodes = 8;
+      EnqueueNode stack[stack_nodes];
+      EnqueueNode* nodes = stack;
+      if (body->count > stack_nodes)
+      {
+        nodes = (EnqueueNode*)alloc.alloc(body->count * sizeof(EnqueueNode));
+        for (size_t i = 0; i < body->count; i++)
+          new (&nodes[i]) EnqueueNode();
+      }
+#endif
+
       // First acquire all the locks if a multimessage
       if (body->count > 1)
       {
@@ -559,7 +1067,11 @@ namespace verona::rt
           auto next = body->get_requests_array()[i];
           Logging::cout() << "Will try to acquire lock " << next.cown()
                           << Logging::endl;
+#ifdef USE_ENQUEUE_LOCK
           next.cown()->enqueue_lock.lock();
+#else
+          next.cown()->enqueue_queue.join(nodes[i]);
+#endif
           yield();
           Logging::cout() << "Acquired lock " << next.cown() << Logging::endl;
         }
@@ -568,7 +1080,7 @@ namespace verona::rt
       size_t loop_end = body->count;
       for (size_t i = 0; i < loop_end; i++)
       {
-        auto m = MultiMessage::make_message(alloc, body, epoch);
+        auto m = MultiMessage::make_message(alloc, body, epoch, i);
         auto next = body->get_requests_array()[i].cown();
         Logging::cout() << "MultiMessage " << m << ": fast requesting " << next
                         << ", index " << i << " loop end " << loop_end
@@ -576,23 +1088,46 @@ namespace verona::rt
 
         auto needs_sched = next->try_fast_send(m);
         if (loop_end > 1)
+        {
+#ifdef USE_ENQUEUE_LOCK
           next->enqueue_lock.unlock();
+#else
+          next->enqueue_queue.leave(nodes[i]);
+          // All the nodes have left their queues.
+          if ((i == last) && (nodes != stack))
+            alloc.dealloc(nodes);
+#endif
+        }
 
         if (!needs_sched)
         {
           Logging::cout() << "try fast send found busy cown " << body
                           << " loop iteration " << i << " cown " << next
                           << Logging::endl;
+
+          // Sending to an overloaded cown mutes the senders once the current
+          // behaviour completes.
+          if (next->is_overloaded())
+          {
+            auto* local = Scheduler::local();
+            if (local != nullptr)
+              local->note_overloaded(next);
+          }
           continue;
         }
 
         Logging::cout() << "Will schedule cown " << next << Logging::endl;
         if (i == last)
         {
-          next->schedule();
+          if (!next->run_inline(alloc, m))
+            next->schedule_next();
           return;
         }
 
+#ifdef USE_COWN_PROFILER
+        if (!body->get_requests_array()[i].is_read())
+          next->blocked_since = Aal::tick();
+#endif
         body->exec_count_down.fetch_sub(1);
 
         // The cown was asleep, so we have acquired it now. Dequeue the
@@ -604,6 +1139,7 @@ namespace verona::rt
         const auto* m2 = next->queue.dequeue(alloc);
         assert(m == m2);
         UNUSED(m2);
+        next->count_dequeue(m);
 
         Request r = body->get_requests_array()[i];
         if (r.is_read())
@@ -614,6 +1150,81 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Called by `fast_send` when it has acquired the last cown of a
+     * multi-message, that is, this cown was asleep and `m` is the first
+     * message in its queue.  If inline behaviours are enabled, and the depth
+     * and budget of inline execution on this scheduler thread allow it, the
+     * message is processed immediately rather than going through the
+     * scheduler queue.
+     *
+     * Returns false, if the caller should schedule this cown as normal.
+     **/
+    bool run_inline(Alloc& alloc, MultiMessage* m)
+    {
+      auto* local = Scheduler::local();
+      if ((local == nullptr) || !local->can_run_inline())
+        return false;
+
+      // Cowns that have not been bound to a core are bound by the scheduler
+      // thread when they are first run.
+      if (owning_core() == nullptr)
+        return false;
+
+      if (is_pinned() && (get_home_core() != local->core))
+        return false;
+
+      // As in `run`, a write must wait for any outstanding readers. The last
+      // reader will schedule this cown.
+      Request* request = m->get_request();
+      assert(request->cown() == this);
+      if (!request->is_read() && !read_ref_count.try_write())
+        return true;
+
+      Logging::cout() << "Run inline MultiMessage " << m << " on cown " << this
+                      << Logging::endl;
+
+      if (move_home_core(local->core))
+        local->core->stats.migrate();
+
+      bool notify = false;
+      auto* m2 = queue.dequeue(alloc, notify);
+      assert(m == m2);
+      UNUSED(m2);
+      count_dequeue(m);
+
+      auto frame = local->enter_inline();
+      if (notify)
+        cown_notified();
+      bool reschedule = run_step(m);
+      local->exit_inline(frame);
+      yield();
+
+      if (!reschedule)
+        return true;
+
+      // Put the cown back to sleep if possible, otherwise schedule it to
+      // process its remaining messages.
+      notify = false;
+      if (
+        Scheduler::should_scan() || Scheduler::in_prescan() ||
+        !queue.mark_sleeping(alloc, notify))
+      {
+        if (notify)
+        {
+          auto* body = local->message_body;
+          cown_notified();
+          local->message_body = body;
+        }
+        schedule();
+        return true;
+      }
+
+      Logging::cout() << "Unschedule cown " << this << Logging::endl;
+      Cown::release(alloc, this);
+      return true;
+    }
+
     /**
      * This method implements an optimized multi-message send to a cown. A
      * sleeping cown will not be reschdeuled because we want to immediately
@@ -627,6 +1238,14 @@ namespace verona::rt
       yield();
 #endif
       Logging::cout() << "Enqueue MultiMessage " << m << Logging::endl;
+      const bool multi = m->get_body()->count > 1;
+      enqueued.fetch_add(1, std::memory_order_relaxed);
+#ifdef USE_COWN_PROFILER
+      if (auto* slot = profile_slot(false))
+        slot->arrivals.fetch_add(1, std::memory_order_relaxed);
+#endif
+      if (multi)
+        pending_multi.fetch_add(1);
       bool needs_scheduling = queue.enqueue(m);
       Logging::cout() << "Enqueued MultiMessage " << m << " needs scheduling? "
                       << needs_scheduling << Logging::endl;
@@ -635,6 +1254,37 @@ namespace verona::rt
       {
         Cown::acquire(this);
       }
+      else if (multi && try_unmute())
+      {
+        // Other cowns may have to wait for this cown to process the message.
+        Logging::cout() << "Unmuted by multi-message " << this
+                        << Logging::endl;
+        schedule();
+      }
+      return needs_scheduling;
+    }
+
+    /**
+     * Enqueue a segment of `n` single-cown messages, from `first` to `last`,
+     * on this cown. Returns true if the cown was asleep and needs scheduling.
+     **/
+    bool
+    try_fast_send_segment(MultiMessage* first, MultiMessage* last, size_t n)
+    {
+      Logging::cout() << "Enqueue " << n << " MultiMessages " << first << " to "
+                      << last << Logging::endl;
+      enqueued.fetch_add(n, std::memory_order_relaxed);
+#ifdef USE_COWN_PROFILER
+      if (auto* slot = profile_slot(false))
+        slot->arrivals.fetch_add(n, std::memory_order_relaxed);
+#endif
+      bool needs_scheduling = queue.enqueue_segment(first, last);
+      Logging::cout() << "Enqueued MultiMessages " << first << " to " << last
+                      << " needs scheduling? " << needs_scheduling
+                      << Logging::endl;
+      yield();
+      if (needs_scheduling)
+        Cown::acquire(this);
       return needs_scheduling;
     }
 
@@ -646,8 +1296,11 @@ namespace verona::rt
      *
      * Otherwise, all cowns have been acquired and we can execute the message
      * behaviour.
+     *
+     * If `readers` is given, a read-only acquire that completes a behaviour
+     * is added to it rather than run, see `run_readers`.
      **/
-    bool run_step(MultiMessage* m)
+    bool run_step(MultiMessage* m, ReadBatch* readers = nullptr)
     {
       MultiMessage::Body& body = *(m->get_body());
       Alloc& alloc = ThreadAlloc::get();
@@ -657,11 +1310,15 @@ namespace verona::rt
       Logging::cout() << "MultiMessage " << m << " acquired " << this
                       << " epoch " << e << Logging::endl;
 
+      bool scanning = Scheduler::should_scan();
+      if (Scheduler::local() != nullptr)
+        Scheduler::local()->core->stats.message(scanning);
+
       // If we are in should_scan, and we observe a message in this epoch,
       // then all future messages must have been sent while in pre-scan or
       // later. Thus any messages that weren't implicitly scanned on send,
       // will be counted as inflight
-      if (Scheduler::should_scan() && e == Scheduler::local()->send_epoch)
+      if (scanning && e == Scheduler::local()->send_epoch)
       {
         // TODO: Investigate systematic testing coverage here.
         if (get_epoch_mark() != Scheduler::local()->send_epoch)
@@ -671,10 +1328,17 @@ namespace verona::rt
         }
       }
 
-      // Find this cown in the list of cowns to acquire
-      Request* request = body.get_requests_array();
-      while (request->cown() != this)
-        request++;
+      // The first cown to process a message of a sampled behaviour ends its
+      // queueing delay.
+      if (SNMALLOC_UNLIKELY(body.scheduled != 0))
+      {
+        uint64_t none = 0;
+        body.first_acquired.compare_exchange_strong(none, Aal::tick());
+      }
+
+      Request* request = m->get_request();
+      assert(request->cown() == this);
+      EventTrace::event(TraceEvent::Acquire, (uintptr_t)this);
 
       bool schedule_after_behaviour = true;
       if (request->is_read())
@@ -682,18 +1346,52 @@ namespace verona::rt
         read_ref_count.add_read();
         if (body.exec_count_down.fetch_sub(1) > 1)
           return true;
-        else
-          // In this case, this thread will execute the behaviour
-          // but another thread can still read this cown, so reschedule
-          // it before executing the behaviour and do not reschedule it after.
-          schedule_after_behaviour = false;
+
+        if (readers != nullptr)
+        {
+          readers->add(&body, e);
+          return true;
+        }
+
+        // In this case, this thread will execute the behaviour
+        // but another thread can still read this cown, so reschedule
+        // it before executing the behaviour and do not reschedule it after.
+        schedule_after_behaviour = false;
       }
       else
       { // request->mode == AccessMode::WRITE
+#ifdef USE_COWN_PROFILER
+        // Read by the thread that acquires the last cown of the behaviour.
+        blocked_since = Aal::tick();
+#endif
         if (body.exec_count_down.fetch_sub(1) > 1)
           return false;
+#ifdef USE_COWN_PROFILER
+        blocked_since = 0;
+#endif
       }
 
+      prepare_behaviour(body, e);
+
+      // The message `m` will be deallocated when the next scheduler thread
+      // picks up a message, so wait until after all the possible uses of `m` to
+      // reschedule this cown.
+      if (!schedule_after_behaviour)
+        schedule_reader();
+
+      return run_behaviour(
+        body, !request->is_read(), schedule_after_behaviour);
+    }
+
+    /**
+     * Called once all the cowns of `body` have been acquired, before this
+     * cown may be rescheduled. `e` is the epoch of the message that completed
+     * the acquire.
+     **/
+    void prepare_behaviour(MessageBody& body, EpochMark e)
+    {
+      Alloc& alloc = ThreadAlloc::get();
+
       if (e == EpochMark::EPOCH_NONE)
       {
         // decrement counter as it must have been incremented earlier for the
@@ -705,7 +1403,7 @@ namespace verona::rt
       {
         if (e != Scheduler::local()->send_epoch)
         {
-          Logging::cout() << "Trace message: " << m << Logging::endl;
+          Logging::cout() << "Trace message: " << &body << Logging::endl;
 
           // Scan cowns for this message, as they may not have been scanned
           // yet.
@@ -725,21 +1423,110 @@ namespace verona::rt
         }
         else
         {
-          Logging::cout() << "Trace message not required: " << m << " (" << e
-                          << ")" << Logging::endl;
+          Logging::cout() << "Trace message not required: " << &body << " ("
+                          << e << ")" << Logging::endl;
         }
       }
+    }
 
-      Scheduler::local()->message_body = &body;
+    /**
+     * Collect the regions directly held by the cowns that `body` acquired for
+     * writing, if they have grown enough since their previous collection, see
+     * `Region::gc_if_needed`. Called when the behaviour has completed, before
+     * its cowns are released.
+     **/
+    static void collect_regions(Alloc& alloc, MessageBody& body)
+    {
+      ObjectStack f(alloc);
+      for (size_t i = 0; i < body.count; i++)
+      {
+        Request request = body.get_requests_array()[i];
+        if ((request.cown() != nullptr) && !request.is_read())
+          request.cown()->trace(f);
+      }
 
-      // The message `m` will be deallocated when the next scheduler thread
-      // picks up a message, so wait until after all the possible uses of `m` to
-      // reschedule this cown.
-      if (!schedule_after_behaviour)
-        schedule();
+      while (!f.empty())
+      {
+        Object* o = f.pop();
+        if (o->get_class() == RegionMD::ISO)
+          Region::gc_if_needed(alloc, o);
+      }
+    }
 
-      // Run the behaviour.
-      body.get_behaviour().f();
+    /**
+     * Run the behaviour of `body`, and release its cowns. `this_is_write` is
+     * whether this cown was acquired for writing. If
+     * `schedule_after_behaviour` is false, this cown has already been
+     * rescheduled, and is only rescheduled again if this was the last reader
+     * before a write.
+     *
+     * Returns false, if this cown should not be rescheduled.
+     **/
+    bool run_behaviour(
+      MessageBody& body, bool this_is_write, bool schedule_after_behaviour)
+    {
+      Alloc& alloc = ThreadAlloc::get();
+      auto* local = Scheduler::local();
+      local->message_body = &body;
+#ifdef USE_COWN_PROFILER
+      profile_blocked(body);
+#endif
+
+      // Run the behaviour, unless it has expired while waiting for its cowns.
+      // An expired behaviour is dropped, and its cowns are released below as
+      // if it had run.
+      Behaviour& behaviour = body.get_behaviour();
+      EventTrace::event(TraceEvent::BehaviourStart, (uintptr_t)this);
+      if (SNMALLOC_UNLIKELY(behaviour.is_expired()))
+      {
+        Logging::cout() << "MultiMessage " << &body << " expired"
+                        << Logging::endl;
+        behaviour.drop();
+      }
+      else if (SNMALLOC_UNLIKELY(body.scheduled != 0))
+      {
+        uint64_t start = Aal::tick();
+        behaviour.f();
+        LatencyStats::record(
+          behaviour.get_descriptor(),
+          body.scheduled,
+          body.first_acquired.load(std::memory_order_relaxed),
+          start,
+          Aal::tick());
+        local->core->stats.behaviour();
+      }
+#ifdef USE_PERF_COUNTERS
+      else if (PerfCounts start; SNMALLOC_UNLIKELY(
+                 PerfStats::start_behaviour(start)))
+      {
+        behaviour.f();
+        PerfStats::end_behaviour(behaviour.get_descriptor(), start);
+        local->core->stats.behaviour();
+      }
+#endif
+      else
+      {
+        behaviour.f();
+        local->core->stats.behaviour();
+      }
+      EventTrace::event(TraceEvent::BehaviourEnd);
+
+      // The scratch memory and staged noticeboards of a behaviour run inline
+      // belong to the enclosing behaviour, which is still running.
+      if (local->inline_depth == 0)
+      {
+        local->scratch.reset(alloc);
+        if (local->staged_noticeboards != nullptr)
+          BaseNoticeboard::publish_staged(alloc, local->staged_noticeboards);
+      }
+
+      if (SNMALLOC_UNLIKELY(Scheduler::get_auto_region_gc()))
+        collect_regions(alloc, body);
+
+      // If the behaviour sent to an overloaded cown, then the write-acquired
+      // cowns are muted rather than rescheduled below.
+      Cown* mute_target = local->take_mute_target();
+      local->message_body = nullptr;
 
       for (size_t i = 0; i < body.count; i++)
       {
@@ -747,7 +1534,7 @@ namespace verona::rt
           Cown::release(alloc, body.get_requests_array()[i].cown());
       }
 
-      Logging::cout() << "MultiMessage " << m << " completed and running on "
+      Logging::cout() << "MultiMessage " << &body << " completed and running on "
                       << this << Logging::endl;
 
       //  Reschedule the writeable cowns (read-only cowns are not unscheduled
@@ -758,8 +1545,12 @@ namespace verona::rt
         Cown* cown = request.cown();
         if (cown)
         {
+          EventTrace::event(TraceEvent::Release, (uintptr_t)cown);
           if (!request.is_read() && cown != this)
-            cown->schedule();
+          {
+            if (!local->mute(cown, mute_target))
+              cown->schedule();
+          }
           else if (request.is_read())
           {
             // If this read is the last read of a cown, and that cown's next
@@ -780,11 +1571,50 @@ namespace verona::rt
         }
       }
 
-      alloc.dealloc(&body);
+      if (mute_target != nullptr)
+      {
+        // This cown is parked by the scheduler thread rather than being
+        // rescheduled.
+        if (
+          this_is_write && schedule_after_behaviour &&
+          local->mute(this, mute_target))
+          schedule_after_behaviour = false;
+
+        Cown::release(alloc, mute_target);
+      }
+
+      body.release(alloc);
 
       return schedule_after_behaviour;
     }
 
+    /**
+     * Run the read-only behaviours collected in `readers` by `run_step`. As
+     * for a single reader, this cown is rescheduled before they run, so that
+     * other scheduler threads can carry on with its queue, but only once for
+     * the whole run of readers.
+     *
+     * Returns true, if this thread should carry on processing this cown, as
+     * the last of the readers found a write waiting.
+     **/
+    bool run_readers(ReadBatch& readers)
+    {
+      Logging::cout() << "Run " << readers.count << " readers on cown " << this
+                      << Logging::endl;
+
+      for (size_t i = 0; i < readers.count; i++)
+        prepare_behaviour(*readers.bodies[i], readers.epochs[i]);
+
+      schedule_reader();
+
+      bool reschedule = false;
+      for (size_t i = 0; i < readers.count; i++)
+        reschedule |= run_behaviour(*readers.bodies[i], false, false);
+
+      readers.count = 0;
+      return reschedule;
+    }
+
   public:
     template<
       class Behaviour,
@@ -802,32 +1632,148 @@ namespace verona::rt
       typename... Args>
     static void schedule(size_t count, Cown** cowns, Args&&... args)
     {
-      // TODO Remove vector allocation here.  This is a temporary fix to
-      // as we transition to using Request through the code base.
+      schedule_requests<Behaviour, transfer>(
+        count,
+        [&](Request* requests) {
+          for (size_t i = 0; i < count; ++i)
+            requests[i] = Request::write(cowns[i]);
+        },
+        std::forward<Args>(args)...);
+    }
+
+    /**
+     * Schedules a single-cown behaviour on each of `count` cowns. The
+     * behaviour for `cowns[i]` is constructed from `make(i)`.
+     *
+     * Consecutive entries for the same cown are enqueued on it as one
+     * segment, with a single exchange on its queue, and idle scheduler
+     * threads are woken once for the batch rather than once per cown.
+     *
+     * Pass `transfer = YesTransfer` as a template argument if the caller is
+     * transfering ownership of a reference count for each entry of `cowns`
+     * to this method.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      typename Make>
+    static void schedule_many(size_t count, Cown** cowns, Make&& make)
+    {
+      static_assert(std::is_base_of_v<Behaviour, Be>);
+      Logging::cout() << "Schedule " << count
+                      << " behaviours of type: " << typeid(Be).name()
+                      << Logging::endl;
+
       auto& alloc = ThreadAlloc::get();
-      Request* requests = (Request*)alloc.alloc(count * sizeof(Request));
+      auto sched = Scheduler::local();
+      auto epoch = sched == nullptr ? EpochMark::EPOCH_A : Scheduler::epoch();
+      bool prev = (sched == nullptr) ? false : sched->enter_batch();
 
-      for (size_t i = 0; i < count; ++i)
-        requests[i] = Request::write(cowns[i]);
+      for (size_t i = 0; i < count;)
+      {
+        Cown* cown = cowns[i];
+        MultiMessage* first = nullptr;
+        MultiMessage* last = nullptr;
+        size_t j = i;
 
-      schedule<Behaviour, transfer, Args...>(
-        count, requests, std::forward<Args>(args)...);
+        // Link the messages for consecutive entries for this cown.
+        for (; (j < count) && (cowns[j] == cown); j++)
+        {
+          if constexpr (transfer == NoTransfer)
+            Cown::acquire(cown);
+
+          auto body = MultiMessage::Body::make<Be>(alloc, 1, make(j));
+          body->get_requests_array()[0] = Request::write(cown);
 
-      alloc.dealloc(requests);
+          if (epoch == EpochMark::EPOCH_NONE)
+            Scheduler::record_inflight_message();
+
+          auto m = MultiMessage::make_message(alloc, body, epoch);
+          if (last == nullptr)
+            first = m;
+          else
+            last->next.store(m, std::memory_order_relaxed);
+          last = m;
+        }
+
+        if (cown->try_fast_send_segment(first, last, j - i))
+        {
+          cown->schedule();
+        }
+        else if (cown->is_overloaded() && (sched != nullptr))
+        {
+          // Sending to an overloaded cown mutes the senders once the current
+          // behaviour completes.
+          sched->note_overloaded(cown);
+        }
+
+        i = j;
+      }
+
+      if (sched != nullptr)
+        sched->exit_batch(prev);
     }
 
     /**
      * Sends a multi-message to the first cown we want to acquire.
      *
+     * `requests` may be in any order, and may name a cown more than once:
+     * the cowns are acquired in a canonical order, and once each, for
+     * writing if any of their requests writes, see `schedule_requests`.
+     *
      * Pass `transfer = YesTransfer` as a template argument if the
      * caller is transfering ownership of a reference count on each cown to
-     *this method.
+     * this method, one for each request, including the repeated ones.
      **/
     template<
       class Be,
       TransferOwnership transfer = NoTransfer,
       typename... Args>
     static void schedule(size_t count, Request* requests, Args&&... args)
+    {
+      schedule_requests<Be, transfer>(
+        count,
+        [&](Request* sort) {
+          memcpy(sort, requests, count * sizeof(Request));
+        },
+        std::forward<Args>(args)...);
+    }
+
+    /**
+     * As `schedule` above, but `fill` writes the `count` requests straight
+     * into the message body, so that the caller needs no array of its own.
+     *
+     * The requests are sorted in place, and repeated requests for a cown are
+     * merged into one, for writing if any of them writes, so the behaviour
+     * may hold fewer than `count` cowns, see `MultiMessage::Body::count`.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      typename Fill,
+      typename... Args>
+    static void schedule_requests(size_t count, Fill&& fill, Args&&... args)
+    {
+      send_prepared(prepare_requests<Be, transfer>(
+        count, std::forward<Fill>(fill), std::forward<Args>(args)...));
+    }
+
+    /**
+     * The first half of `schedule_requests`: builds the message body of the
+     * behaviour, and takes its reference counts on the cowns, but does not
+     * send it. The body must be passed to exactly one of `send_prepared`
+     * and `discard_prepared`.
+     *
+     * This lets a behaviour be built before the one that schedules it runs,
+     * see `When::then`.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      typename Fill,
+      typename... Args>
+    static MultiMessage::Body*
+    prepare_requests(size_t count, Fill&& fill, Args&&... args)
     {
       static_assert(std::is_base_of_v<Behaviour, Be>);
       Logging::cout() << "Schedule behaviour of type: " << typeid(Be).name()
@@ -838,8 +1784,45 @@ namespace verona::rt
       auto body =
         MultiMessage::Body::make<Be>(alloc, count, std::forward<Args>(args)...);
 
+      return prepare_body<transfer>(
+        alloc, body, count, std::forward<Fill>(fill));
+    }
+
+    /**
+     * As `prepare_requests`, for a behaviour laid out by compiled code rather
+     * than by a C++ type, see `MultiMessage::Body::make_raw`. The caller
+     * writes the captured state after the `Behaviour` header of
+     * `body->get_behaviour()`, then sends the body with `send_prepared`.
+     *
+     * This is the entry point for code generated for `when`: the closure is
+     * built straight into the message body, with no other allocation.
+     **/
+    template<TransferOwnership transfer = NoTransfer>
+    static MultiMessage::Body* prepare_raw(
+      size_t count,
+      Request* requests,
+      const Behaviour::Descriptor* desc,
+      size_t align)
+    {
+      auto& alloc = ThreadAlloc::get();
+      auto body = MultiMessage::Body::make_raw(alloc, count, desc, align);
+
+      return prepare_body<transfer>(alloc, body, count, [&](Request* sort) {
+        memcpy(sort, requests, count * sizeof(Request));
+      });
+    }
+
+  private:
+    /**
+     * Fills in the requests of a new body, merges repeated requests for a
+     * cown, and takes the reference counts on the cowns.
+     **/
+    template<TransferOwnership transfer, typename Fill>
+    static MultiMessage::Body* prepare_body(
+      Alloc& alloc, MultiMessage::Body* body, size_t count, Fill&& fill)
+    {
       auto* sort = body->get_requests_array();
-      memcpy(sort, requests, count * sizeof(Request));
+      fill(sort);
 
 #ifdef USE_SYSTEMATIC_TESTING
       std::sort(&sort[0], &sort[count], [](Request& a, Request& b) {
@@ -851,12 +1834,45 @@ namespace verona::rt
       });
 #endif
 
+      size_t unique = 0;
+      for (size_t i = 0; i < count; i++)
+      {
+        if ((unique == 0) || (sort[unique - 1].cown() != sort[i].cown()))
+        {
+          sort[unique++] = sort[i];
+          continue;
+        }
+
+        if (!sort[i].is_read())
+          sort[unique - 1] = Request::write(sort[i].cown());
+        if constexpr (transfer == YesTransfer)
+          Cown::release(alloc, sort[i].cown());
+      }
+
+      if (unique != count)
+      {
+        count = unique;
+        body->count = unique;
+        body->exec_count_down.store(unique, std::memory_order_relaxed);
+      }
+
       if constexpr (transfer == NoTransfer)
       {
         for (size_t i = 0; i < count; i++)
           Cown::acquire(sort[i].cown());
       }
 
+      return body;
+    }
+
+  public:
+    /// Send a body built by `prepare_requests`.
+    static void send_prepared(MultiMessage::Body* body)
+    {
+      // Sampled latencies are measured from the send.
+      if (body->scheduled != 0)
+        body->scheduled = Aal::tick();
+
       // TODO what if this thread is external.
       //  EPOCH_A okay as currently only sending externally, before we start
       //  and thus its okay.
@@ -874,6 +1890,22 @@ namespace verona::rt
       fast_send(body, epoch);
     }
 
+    /**
+     * Drop a body built by `prepare_requests` without running it, as if it
+     * had expired, and release its cowns.
+     **/
+    static void discard_prepared(MultiMessage::Body* body)
+    {
+      auto& alloc = ThreadAlloc::get();
+      body->get_behaviour().drop();
+
+      auto* requests = body->get_requests_array();
+      for (size_t i = 0; i < body->count; i++)
+        Cown::release(alloc, requests[i].cown());
+
+      body->release(alloc);
+    }
+
     /**
      * This processes a batch of messages on a cown.
      *
@@ -896,26 +1928,31 @@ namespace verona::rt
       auto until = queue.peek_back();
       yield(); // Reading global state in peek_back().
 
-      static constexpr size_t batch_limit = 100;
+      const size_t limit = batch_limit;
       auto notified_called = false;
       auto notify = false;
 
       MultiMessage* curr = nullptr;
       size_t batch_size = 0;
+      ReadBatch readers;
       do
       {
         assert(!queue.is_sleeping());
 
         curr = queue.peek();
 
-        if (curr != nullptr)
+        // A run of readers ends at anything other than another read.
+        if ((readers.count != 0) && !readers.can_add(curr))
         {
-          auto* body = curr->get_body();
+          if (!run_readers(readers))
+            return false;
+          curr = queue.peek();
+        }
 
-          // find us in the list of cowns to acquire
-          Request* request = body->get_requests_array();
-          while (request->cown() != this)
-            request++;
+        if (curr != nullptr)
+        {
+          Request* request = curr->get_request();
+          assert(request->cown() == this);
 
           // Attempt to process a write, if it fails stop processing the message
           // queue.
@@ -924,6 +1961,8 @@ namespace verona::rt
         }
 
         curr = queue.dequeue(alloc, notify);
+        if (curr != nullptr)
+          count_dequeue(curr);
 
         if (!notified_called && notify)
         {
@@ -959,10 +1998,13 @@ namespace verona::rt
           //      This is designed to be effective if a cown is receiving a lot
           //      of messages.
           if (batch_size != 0)
+          {
+            Scheduler::local()->core->stats.batch(batch_size);
             return true;
+          }
 
           // Reschedule if cown does not go to sleep.
-          if (!queue.mark_sleeping(alloc, notify))
+          if (!try_sleep(alloc, notify))
           {
             if (notify)
             {
@@ -994,14 +2036,33 @@ namespace verona::rt
         // A function that returns false indicates that the cown should not
         // be rescheduled, even if it has pending work. This also means the
         // cown's queue should not be marked as empty, even if it is.
-        if (!run_step(curr))
+        if (!run_step(curr, &readers))
           return false;
 
-      } while ((curr != until) && (batch_size < batch_limit));
+      } while ((curr != until) && (batch_size < limit));
 
+      if ((readers.count != 0) && !run_readers(readers))
+        return false;
+
+      Scheduler::local()->core->stats.batch(batch_size);
+      update_batch_limit(batch_size >= limit);
       return true;
     }
 
+    /**
+     * Called at the end of a batch that is going to be rescheduled. `hot` is
+     * true if the batch was cut short by the batch limit.
+     **/
+    void update_batch_limit(bool hot)
+    {
+      bool contended = Scheduler::local()->has_waiting_work();
+      size_t limit = has_batch_limit() ?
+        get_descriptor()->batch_limit(this, batch_limit, hot, contended) :
+        next_batch_limit(batch_limit, hot, contended);
+      batch_limit = (uint32_t)(std::min)(
+        (std::max)(limit, (size_t)1), (size_t)UINT32_MAX);
+    }
+
     bool try_collect(Alloc& alloc, EpochMark epoch)
     {
       Logging::cout() << "try_collect: " << this << " (" << get_epoch_mark()
@@ -1128,11 +2189,11 @@ namespace verona::rt
       // Now we may run our destructor.
       destructor();
 
-      auto* stub = queue.destroy();
+      auto* fnt = queue.destroy();
       // All messages must have been run by the time the cown is collected.
-      assert(stub->next.load(std::memory_order_relaxed) == nullptr);
+      assert(fnt->next.load(std::memory_order_relaxed) == nullptr);
 
-      alloc.dealloc<sizeof(MultiMessage)>(stub);
+      fnt->dealloc(alloc);
     }
 
     bool release_early()
@@ -1172,14 +2233,57 @@ namespace verona::rt
     }
 
     /**
-     * Create a `MultiMessage` that is never sent or processed.
-     */
-    static MultiMessage* stub_msg(Alloc& alloc)
+     * As `MPSCQ::mark_sleeping`, but first puts `stub` back at the front of
+     * the queue if it is empty, and frees the last message processed, so
+     * that an idle cown does not keep the body of its last behaviour alive.
+     **/
+    bool try_sleep(Alloc& alloc, bool& notify)
     {
-      return MultiMessage::make_message(alloc, nullptr, EpochMark::EPOCH_NONE);
+      auto* last = queue.swap_stub(&stub);
+      if (last != nullptr)
+        last->dealloc(alloc);
+      return queue.mark_sleeping(alloc, notify);
     }
   };
 
+#ifndef USE_COWN_PROFILER
+  // Programs may have millions of cowns, most of them idle, so fields added
+  // to `Cown` should be packed with the existing ones rather than grow it.
+  static_assert(sizeof(Cown) <= 128, "Cown exceeds its size budget");
+#endif
+
+  namespace scratch
+  {
+    /**
+     * Allocates `size` bytes of scratch memory for the running behaviour.
+     * The memory is bump-allocated from arenas cached by the scheduler
+     * thread, and is reclaimed all at once when the behaviour completes, so
+     * it must not be freed, or referenced once the behaviour has returned.
+     * This includes across a suspension of a coroutine behaviour.
+     **/
+    inline void* alloc(size_t size)
+    {
+      auto* local = Scheduler::local();
+      assert(local != nullptr);
+      assert(local->message_body != nullptr);
+      return local->scratch.alloc(ThreadAlloc::get(), size);
+    }
+
+    /**
+     * Allocates and constructs a `T` in scratch memory for the running
+     * behaviour, see `alloc`. `T` must be trivially destructible.
+     **/
+    template<typename T, typename... Args>
+    T* make(Args&&... args)
+    {
+      auto* local = Scheduler::local();
+      assert(local != nullptr);
+      assert(local->message_body != nullptr);
+      return local->scratch.make<T>(
+        ThreadAlloc::get(), std::forward<Args>(args)...);
+    }
+  } // namespace scratch
+
   namespace cown
   {
     inline void release(Alloc& alloc, Cown* o)
@@ -0,0 +1,272 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <snmalloc/snmalloc.h>
+#include <vector>
+
+namespace verona::rt
+{
+  /**
+   * Contention counters of a cown tracked by `CownProfiler`.
+   *
+   * A slot is claimed by a cown by setting `owner`, and the cown keeps a
+   * pointer to it. A slot is given back by `CownProfiler::top` once its cown
+   * has been idle for a whole report, after which the cown no longer owns it
+   * and must be tracked again.
+   */
+  struct CownProfileSlot
+  {
+    /// The cown, only used as an identity and never dereferenced.
+    std::atomic<const void*> owner = nullptr;
+    std::atomic<const Descriptor*> descriptor = nullptr;
+    /// Messages sent to the cown.
+    std::atomic<size_t> arrivals = 0;
+    /// Longest queue of the cown, when one of its messages was processed.
+    std::atomic<size_t> max_queue = 0;
+    /// Number of behaviours that acquired the cown for writing and then
+    /// waited for their other cowns, and the ticks they waited in total.
+    std::atomic<size_t> blocked = 0;
+    std::atomic<uint64_t> blocked_ticks = 0;
+
+    /// `arrivals` and `blocked` at the previous report.
+    size_t reported_arrivals = 0;
+    size_t reported_blocked = 0;
+  };
+
+  /**
+   * Profiler of the contention on cowns, built with `USE_COWN_PROFILER`.
+   *
+   * A cown is tracked once its queue grows to `queue_threshold` messages, or
+   * once it is held by a behaviour waiting for its other cowns, see the
+   * `exec_count_down` of `Cown::run_step`. Tracked cowns count the messages
+   * sent to them, their longest queue, and the time they were held by
+   * behaviours waiting for other cowns.
+   *
+   * The counters live in a fixed table, so that the profiler holds no
+   * reference to the cowns, and tracking stops while the table is full.
+   * `top` reports the most contended cowns, tagged with their descriptor,
+   * and can be called periodically by the scheduler threads, see
+   * `set_report`.
+   */
+  class CownProfiler
+  {
+  public:
+    static constexpr size_t CAPACITY = 256;
+
+    /// A tracked cown, as reported by `top`.
+    struct Entry
+    {
+      const void* cown;
+      const Descriptor* descriptor;
+      /// Messages sent to the cown per second since the previous report.
+      double arrival_rate;
+      size_t max_queue;
+      size_t blocked;
+      uint64_t blocked_ticks;
+    };
+
+  private:
+    inline static CownProfileSlot slots[CAPACITY];
+    /// Number of slots with an owner, so that a full table is not searched.
+    inline static std::atomic<size_t> used = 0;
+    inline static std::atomic<size_t> queue_threshold = 16;
+
+    inline static snmalloc::FlagWord report_lock;
+    inline static std::chrono::steady_clock::time_point last_report =
+      std::chrono::steady_clock::now();
+
+    inline static std::ostream* report_stream = nullptr;
+    inline static size_t report_count = 10;
+    inline static std::chrono::nanoseconds report_interval{0};
+    inline static std::atomic<int64_t> next_report = 0;
+
+  public:
+    static void set_queue_threshold(size_t n)
+    {
+      queue_threshold.store(n, std::memory_order_relaxed);
+    }
+
+    static size_t get_queue_threshold()
+    {
+      return queue_threshold.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Claim a slot for `cown`, or return null if the table is full.
+     */
+    static CownProfileSlot* track(const void* cown, const Descriptor* desc)
+    {
+      if (used.load(std::memory_order_relaxed) >= CAPACITY)
+        return nullptr;
+
+      for (auto& s : slots)
+      {
+        const void* none = nullptr;
+        if (
+          (s.owner.load(std::memory_order_relaxed) == nullptr) &&
+          s.owner.compare_exchange_strong(none, cown))
+        {
+          used.fetch_add(1, std::memory_order_relaxed);
+          s.descriptor.store(desc, std::memory_order_relaxed);
+          return &s;
+        }
+      }
+      return nullptr;
+    }
+
+    /**
+     * Returns true if `slot` is still owned by `cown`.
+     */
+    static bool owns(CownProfileSlot* slot, const void* cown)
+    {
+      return (slot != nullptr) &&
+        (slot->owner.load(std::memory_order_relaxed) == cown);
+    }
+
+    static void max_queue(CownProfileSlot* slot, size_t length)
+    {
+      if (length > slot->max_queue.load(std::memory_order_relaxed))
+        slot->max_queue.store(length, std::memory_order_relaxed);
+    }
+
+    static void blocked(CownProfileSlot* slot, uint64_t ticks)
+    {
+      slot->blocked.fetch_add(1, std::memory_order_relaxed);
+      slot->blocked_ticks.fetch_add(ticks, std::memory_order_relaxed);
+    }
+
+    /**
+     * The `n` most contended tracked cowns, by time held by waiting
+     * behaviours and then by longest queue. This starts a new report: the
+     * arrival rates are measured from the previous one, and the slots of
+     * the cowns that were idle since then are given back.
+     */
+    static std::vector<Entry> top(size_t n)
+    {
+      snmalloc::FlagLock f(report_lock);
+
+      auto now = std::chrono::steady_clock::now();
+      double seconds =
+        std::chrono::duration<double>(now - last_report).count();
+      last_report = now;
+
+      std::vector<Entry> entries;
+      for (auto& s : slots)
+      {
+        const void* cown = s.owner.load(std::memory_order_relaxed);
+        if (cown == nullptr)
+          continue;
+
+        size_t arrivals = s.arrivals.load(std::memory_order_relaxed);
+        size_t blocked = s.blocked.load(std::memory_order_relaxed);
+        size_t new_arrivals = arrivals - s.reported_arrivals;
+        bool idle = (new_arrivals == 0) && (blocked == s.reported_blocked);
+        s.reported_arrivals = arrivals;
+        s.reported_blocked = blocked;
+
+        entries.push_back(
+          {cown,
+           s.descriptor.load(std::memory_order_relaxed),
+           seconds > 0 ? (double)new_arrivals / seconds : 0.0,
+           s.max_queue.load(std::memory_order_relaxed),
+           blocked,
+           s.blocked_ticks.load(std::memory_order_relaxed)});
+
+        if (idle)
+          release(s);
+      }
+
+      std::sort(entries.begin(), entries.end(), [](Entry& a, Entry& b) {
+        if (a.blocked_ticks != b.blocked_ticks)
+          return a.blocked_ticks > b.blocked_ticks;
+        return a.max_queue > b.max_queue;
+      });
+      if (entries.size() > n)
+        entries.resize(n);
+      return entries;
+    }
+
+    /// Write `top(n)` to `o`, one cown per line.
+    static void report(std::ostream& o, size_t n)
+    {
+      auto entries = top(n);
+      o << "Contended cowns: " << entries.size() << std::endl;
+      for (auto& e : entries)
+      {
+        o << "  cown " << e.cown << " descriptor " << e.descriptor
+          << " arrivals/s " << e.arrival_rate << " max queue " << e.max_queue
+          << " blocked " << e.blocked << " blocked ticks " << e.blocked_ticks
+          << std::endl;
+      }
+    }
+
+    /**
+     * Have the scheduler threads write `report(*o, n)` every `interval`, or
+     * stop if `o` is null. This must not be called concurrently with the
+     * scheduler threads.
+     */
+    static void
+    set_report(std::ostream* o, std::chrono::milliseconds interval, size_t n)
+    {
+      report_stream = o;
+      report_interval = interval;
+      report_count = n;
+      next_report.store(
+        (std::chrono::steady_clock::now() + interval)
+          .time_since_epoch()
+          .count(),
+        std::memory_order_relaxed);
+    }
+
+    /**
+     * Called periodically by the scheduler threads. Writes the report of
+     * `set_report` if it is due, on a single thread.
+     */
+    static void maybe_report()
+    {
+      if (report_stream == nullptr)
+        return;
+
+      auto now = std::chrono::steady_clock::now();
+      int64_t due = next_report.load(std::memory_order_relaxed);
+      if (now.time_since_epoch().count() < due)
+        return;
+
+      int64_t next = (now + report_interval).time_since_epoch().count();
+      if (next_report.compare_exchange_strong(due, next))
+        report(*report_stream, report_count);
+    }
+
+    /// Forget all the tracked cowns, which are tracked again as needed.
+    static void clear()
+    {
+      snmalloc::FlagLock f(report_lock);
+      for (auto& s : slots)
+        release(s);
+    }
+
+  private:
+    static void release(CownProfileSlot& s)
+    {
+      if (s.owner.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+      s.arrivals.store(0, std::memory_order_relaxed);
+      s.max_queue.store(0, std::memory_order_relaxed);
+      s.blocked.store(0, std::memory_order_relaxed);
+      s.blocked_ticks.store(0, std::memory_order_relaxed);
+      s.reported_arrivals = 0;
+      s.reported_blocked = 0;
+      s.descriptor.store(nullptr, std::memory_order_relaxed);
+      s.owner.store(nullptr, std::memory_order_release);
+      used.fetch_sub(1, std::memory_order_relaxed);
+    }
+  };
+} // namespace verona::rt
@@ -7,6 +7,7 @@
 #include "../test/logging.h"
 #include "region/immutable.h"
 
+#include <algorithm>
 #include <snmalloc/snmalloc.h>
 
 namespace verona::rt
@@ -33,9 +34,42 @@ namespace verona::rt
     static void set(uint64_t e)
     {
       global_epoch().store(e, std::memory_order_release);
+      advances()++;
+    }
+
+    static std::atomic<size_t>& advances()
+    {
+      static std::atomic<size_t> advances;
+      return advances;
+    }
+
+    static size_t& sensible_bytes()
+    {
+      static size_t sensible_bytes = 8 * 1024;
+      return sensible_bytes;
+    }
+
+    static size_t& urgent_bytes()
+    {
+      static size_t urgent_bytes = 64 * 1024;
+      return urgent_bytes;
     }
 
   public:
+    /**
+     * Sets when a thread leaving an epoch tries to advance the global epoch:
+     * once the memory it has deferred to the current epoch, and the pressure
+     * added with `Epoch::add_pressure`, exceed `sensible` bytes. Above
+     * `urgent` bytes, it also ejects the threads that hold the epoch back.
+     * Lower values reclaim memory sooner, at the cost of more contention on
+     * the global epoch.
+     */
+    static void set_thresholds(size_t sensible, size_t urgent)
+    {
+      sensible_bytes() = sensible;
+      urgent_bytes() = urgent < sensible ? sensible : urgent;
+    }
+
     static uint64_t get()
     {
       return global_epoch().load(std::memory_order_acquire);
@@ -85,10 +119,12 @@ namespace verona::rt
     // Providing heuristic for advancing the epoch. Currently, we only look at
     // one slot to determine if we should advance the epoch (see
     // advance_is_sensible()), but we keep the history here so that better
-    // heuristic could be applied later.
+    // heuristic could be applied later. Pressure is in bytes.
     size_t pressure[4] = {0, 0, 0, 0};
     size_t unusable[4] = {0, 0, 0, 0};
     size_t to_dec[4] = {0, 0, 0, 0};
+    // Bytes held by `delete_list` and `dec_list` in each slot.
+    size_t pending[4] = {0, 0, 0, 0};
     uint8_t index = 0;
 
     std::atomic<uint64_t> epoch = EJECTED_BIT;
@@ -97,11 +133,12 @@ namespace verona::rt
     template<typename T, bool predicate(LocalEpoch* p, T t)>
     static bool forall(T t);
 
-    void add_to_delete_list(void* p)
+    void add_to_delete_list(void* p, size_t size)
     {
       delete_list.enqueue((InnerNode*)p);
       (*get_unusable(2))++;
-      (*get_pressure(2))++;
+      (*get_pressure(2)) += size;
+      (*get_pending(2)) += size;
       debug_check_count();
     }
 
@@ -111,6 +148,11 @@ namespace verona::rt
       node->o = p;
       dec_list.enqueue((InnerNode*)node);
       (*get_to_dec(2))++;
+      // The size of the whole graph that may be released is not known, so
+      // this only counts its root.
+      size_t size = sizeof(DecNode) + p->size();
+      (*get_pressure(2)) += size;
+      (*get_pending(2)) += size;
       debug_check_count();
     }
 
@@ -154,6 +196,11 @@ namespace verona::rt
       return &to_dec[(index + i) & 3];
     }
 
+    size_t* get_pending(uint8_t i)
+    {
+      return &pending[(index + i) & 3];
+    }
+
     void advance_epoch(Alloc& alloc)
     {
       debug_check_count();
@@ -186,21 +233,21 @@ namespace verona::rt
         *cell = 0;
       }
 
+      *get_pending(0) = 0;
       index = (index + 1) & 3;
     }
 
-    void add_pressure()
+    void add_pressure(size_t size)
     {
-      (*get_pressure(2))++;
+      (*get_pressure(2)) += size;
     }
 
-    // TODO: Add a proper heuristic here
     bool advance_is_sensible()
     {
 #ifdef USE_SYSTEMATIC_TESTING
       return Systematic::coin(4);
 #else
-      return *get_pressure(2) > 128;
+      return *get_pressure(2) > GlobalEpoch::sensible_bytes();
 #endif
     }
 
@@ -209,10 +256,20 @@ namespace verona::rt
 #ifdef USE_SYSTEMATIC_TESTING
       return Systematic::coin(7);
 #else
-      return *get_pressure(2) > 1024;
+      return *get_pressure(2) > GlobalEpoch::urgent_bytes();
 #endif
     }
 
+    /// Number of epochs the global epoch is ahead of this thread, or zero if
+    /// this thread has been ejected.
+    uint64_t lag()
+    {
+      auto e = get_epoch();
+      if ((e & EJECTED_BIT) != 0)
+        return 0;
+      return (GlobalEpoch::get() - e) & ~EJECTED_BIT;
+    }
+
     uint64_t get_epoch()
     {
       return epoch.load(std::memory_order_acquire);
@@ -400,6 +457,23 @@ namespace verona::rt
     }
   };
 
+  /**
+   * A snapshot of the memory waiting for the epochs to advance, see
+   * `Epoch::get_stats`.
+   */
+  struct EpochStats
+  {
+    /// Bytes deferred with `delete_in_epoch` and `dec_in_epoch`, and not yet
+    /// reclaimed. This does not include what the deferred decrements free.
+    size_t pending_bytes = 0;
+    /// Number of deferred deletions and decrements.
+    size_t pending_count = 0;
+    /// The most epochs any thread is behind the global epoch.
+    uint64_t max_lag = 0;
+    /// Number of times the global epoch has advanced.
+    size_t advances = 0;
+  };
+
   class Epoch
   {
   private:
@@ -428,9 +502,11 @@ namespace verona::rt
       yield();
     }
 
-    void add_pressure()
+    /// Counts `size` bytes, that will be reclaimed once the epoch advances,
+    /// towards the thresholds for advancing it.
+    void add_pressure(size_t size)
     {
-      local_epoch->add_pressure();
+      local_epoch->add_pressure(size);
     }
 
     uint64_t get_local_epoch_epoch()
@@ -440,7 +516,7 @@ namespace verona::rt
 
     void delete_in_epoch(void* object)
     {
-      local_epoch->add_to_delete_list(object);
+      local_epoch->add_to_delete_list(object, alloc.alloc_size(object));
     }
 
     void dec_in_epoch(Object* object)
@@ -468,5 +544,114 @@ namespace verona::rt
         curr = LocalEpochPool::iterate(curr);
       }
     }
+
+    /**
+     * Sums the memory waiting for reclamation over all threads. The counts of
+     * other threads are read without synchronisation, so this is only
+     * approximate while they run.
+     */
+    static EpochStats get_stats()
+    {
+      EpochStats stats;
+      stats.advances = GlobalEpoch::advances().load(std::memory_order_relaxed);
+
+      auto curr = LocalEpochPool::iterate();
+      while (curr != nullptr)
+      {
+        for (int i = 0; i < 4; i++)
+        {
+          stats.pending_bytes += curr->pending[i];
+          stats.pending_count += curr->unusable[i] + curr->to_dec[i];
+        }
+        stats.max_lag = std::max(stats.max_lag, curr->lag());
+
+        curr = LocalEpochPool::iterate(curr);
+      }
+
+      return stats;
+    }
+  };
+
+  /**
+   * Holds a reference to an immutable object graph, which readers use without
+   * touching its reference count.
+   *
+   * A reader enters an `Epoch` and calls `read`. The result stays valid while
+   * that epoch is held, as the reference dropped by `update` or `clear` is
+   * only released, through `Epoch::dec_in_epoch`, once every thread has left
+   * the epochs in which it could have been read. A reader that needs the
+   * immutable for longer must acquire its own reference while in the epoch.
+   *
+   * This is intended for read-heavy immutables shared by many behaviours,
+   * whose reference count would otherwise be contended by every reader.
+   *
+   * The held reference is released by `clear`, or, if the holder is a cown
+   * that passes this to `trace`, when that cown is collected.
+   */
+  template<typename T>
+  class EpochImmutable
+  {
+  private:
+    std::atomic<T*> content{nullptr};
+
+  public:
+    EpochImmutable() = default;
+
+    /**
+     * Takes over a reference to the immutable `o`.
+     */
+    explicit EpochImmutable(T* o) : content(o)
+    {
+      assert((o == nullptr) || o->debug_is_immutable());
+    }
+
+    EpochImmutable(const EpochImmutable&) = delete;
+    EpochImmutable& operator=(const EpochImmutable&) = delete;
+
+    /**
+     * Returns the immutable, without taking a reference to it. This must only
+     * be used while `e` is held.
+     */
+    T* read(Epoch& e) const
+    {
+      UNUSED(e);
+      return content.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Replaces the immutable with `o`, taking over a reference to it. The
+     * reference to the previous immutable is released once no reader can be
+     * using it.
+     */
+    void update(Epoch& e, T* o)
+    {
+      assert((o == nullptr) || o->debug_is_immutable());
+      T* prev = content.exchange(o, std::memory_order_acq_rel);
+      if (prev != nullptr)
+      {
+        Logging::cout() << "Epoch immutable: releasing " << prev
+                        << Logging::endl;
+        e.dec_in_epoch(prev);
+      }
+    }
+
+    /**
+     * Drops the held reference, as `update` does.
+     */
+    void clear(Alloc& alloc)
+    {
+      if (content.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+      Epoch e(alloc);
+      update(e, nullptr);
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      T* p = content.load(std::memory_order_relaxed);
+      if (p != nullptr)
+        st.push(p);
+    }
   };
 } // namespace verona::rt
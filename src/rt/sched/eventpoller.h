@@ -0,0 +1,36 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstddef>
+
+namespace verona::rt
+{
+  /**
+   * A source of external events, such as I/O readiness, that the scheduler
+   * threads poll themselves, see `ThreadPool::set_event_poller`.
+   *
+   * Events are dispatched on the polling scheduler thread, so the behaviours
+   * that handle them are scheduled on its core, without waking another
+   * thread.
+   */
+  class EventPoller
+  {
+  public:
+    virtual ~EventPoller() = default;
+
+    /**
+     * Dispatch the events that are ready, waiting up to `timeout_ms`
+     * milliseconds for one if none are, or indefinitely if it is negative.
+     * Returns the number of events dispatched. Only one thread polls at a
+     * time.
+     */
+    virtual size_t poll(int timeout_ms) = 0;
+
+    /**
+     * Make a `poll` that is waiting, or the next one, return. This may be
+     * called from any thread.
+     */
+    virtual void wake() = 0;
+  };
+} // namespace verona::rt
@@ -0,0 +1,265 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  enum class TraceEvent : uint8_t
+  {
+    /// A behaviour starts running on the cown in the argument.
+    BehaviourStart,
+    BehaviourEnd,
+    /// The cown in the argument processes a message for a behaviour.
+    Acquire,
+    /// The cown in the argument is released by a behaviour.
+    Release,
+    /// A cown is stolen from the core whose affinity is the argument.
+    Steal,
+    PauseStart,
+    PauseEnd,
+    /// The thread moves to the `ThreadState::State` in the argument.
+    LDPhase,
+  };
+
+  /**
+   * Ring of the most recent trace events of one thread, see `EventTrace`.
+   *
+   * Only the owning thread writes, and publishes each event by advancing
+   * `head`. Readers copy the entries and then discard the ones the owner may
+   * have overwritten meanwhile, so the buffer needs no lock.
+   */
+  class TraceBuffer : public snmalloc::Pooled<TraceBuffer>
+  {
+  public:
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    struct Entry
+    {
+      uint64_t tick;
+      uint64_t arg : 56;
+      uint64_t kind : 8;
+    };
+
+  private:
+    friend class EventTrace;
+    static_assert(snmalloc::bits::is_pow2(CAPACITY));
+
+    inline static std::atomic<size_t> next_id = 0;
+
+    /// Number of events ever written.
+    std::atomic<size_t> head = 0;
+    /// Track of this buffer in the exported trace.
+    size_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    Entry entries[CAPACITY];
+
+    void add(TraceEvent kind, uintptr_t arg)
+    {
+      size_t h = head.load(std::memory_order_relaxed);
+      entries[h & (CAPACITY - 1)] = {
+        snmalloc::Aal::tick(), arg, (uint64_t)kind};
+      head.store(h + 1, std::memory_order_release);
+    }
+
+    /**
+     * Call `f` on each entry of the buffer, oldest first, that cannot have
+     * been overwritten while it was copied.
+     */
+    template<typename F>
+    void for_each(F&& f)
+    {
+      size_t h = head.load(std::memory_order_acquire);
+      size_t first = h > CAPACITY ? h - CAPACITY : 0;
+      for (size_t i = first; i < h; i++)
+      {
+        Entry e = entries[i & (CAPACITY - 1)];
+        // The owner may be writing the slot of event `head`, which is that
+        // of event `head - CAPACITY`.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (i + CAPACITY <= head.load(std::memory_order_relaxed))
+          continue;
+        f(e);
+      }
+    }
+  };
+
+  using TraceBufferPool = snmalloc::Pool<TraceBuffer, snmalloc::Alloc::Config>;
+
+  /**
+   * Timeline of scheduling events, off by default, for viewing the
+   * scheduling of a running program.
+   *
+   * While tracing is on, see `start` and `stop`, each thread records its
+   * events in a `TraceBuffer` taken from a pool the first time it needs one.
+   * While it is off, recording an event is a single relaxed load. Each
+   * buffer keeps the last `TraceBuffer::CAPACITY` events of its thread.
+   *
+   * `write_chrome_json` exports the events in the Chrome trace event format,
+   * which Perfetto and `chrome://tracing` open as a timeline per thread.
+   */
+  class EventTrace
+  {
+  private:
+    inline static std::atomic<bool> enabled = false;
+    inline static uint64_t start_tick = 0;
+    inline static uint64_t stop_tick = 0;
+    inline static std::chrono::steady_clock::time_point start_time;
+    inline static std::chrono::steady_clock::time_point stop_time;
+
+    class ThreadLocalTrace
+    {
+    public:
+      TraceBuffer* buffer = nullptr;
+
+      ~ThreadLocalTrace()
+      {
+        if (buffer != nullptr)
+          TraceBufferPool::release(buffer);
+      }
+    };
+
+    static TraceBuffer* local()
+    {
+      static thread_local ThreadLocalTrace mine;
+      if (SNMALLOC_UNLIKELY(mine.buffer == nullptr))
+        mine.buffer = TraceBufferPool::acquire();
+      return mine.buffer;
+    }
+
+  public:
+    /**
+     * Start recording events. Only the events after the last call to `start`
+     * are exported.
+     */
+    static void start()
+    {
+      start_time = std::chrono::steady_clock::now();
+      start_tick = snmalloc::Aal::tick();
+      enabled.store(true, std::memory_order_release);
+    }
+
+    /// Stop recording events. Events being recorded may still complete.
+    static void stop()
+    {
+      enabled.store(false, std::memory_order_release);
+      stop_time = std::chrono::steady_clock::now();
+      stop_tick = snmalloc::Aal::tick();
+    }
+
+    static bool is_enabled()
+    {
+      return enabled.load(std::memory_order_relaxed);
+    }
+
+    static void event(TraceEvent kind, uintptr_t arg = 0)
+    {
+      if (SNMALLOC_LIKELY(!is_enabled()))
+        return;
+
+      local()->add(kind, arg);
+    }
+
+    /**
+     * Call `f(id, entry)` with each event recorded since the last `start`,
+     * where `id` identifies the thread, in the order each thread recorded
+     * them.
+     */
+    template<typename F>
+    static void for_each(F&& f)
+    {
+      auto curr = TraceBufferPool::iterate();
+      while (curr != nullptr)
+      {
+        curr->for_each([&](const TraceBuffer::Entry& e) {
+          if (e.tick >= start_tick)
+            f(curr->id, e);
+        });
+        curr = TraceBufferPool::iterate(curr);
+      }
+    }
+
+    /**
+     * Write the events since the last `start` as a Chrome trace event JSON
+     * document, with timestamps in microseconds since `start`. This should
+     * be called after `stop`, otherwise it only reflects the events recorded
+     * so far.
+     */
+    static void write_chrome_json(std::ostream& o)
+    {
+      // Convert ticks to microseconds with the wall time of the trace.
+      bool running = is_enabled();
+      auto end_time = running ? std::chrono::steady_clock::now() : stop_time;
+      uint64_t end_tick = running ? snmalloc::Aal::tick() : stop_tick;
+      double us =
+        (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+          end_time - start_time)
+          .count() /
+        1000.0;
+      double us_per_tick =
+        end_tick > start_tick ? us / (double)(end_tick - start_tick) : 0.0;
+
+      o << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      bool first = true;
+      for_each([&](size_t id, const TraceBuffer::Entry& e) {
+        const char* name = "";
+        const char* phase = "i";
+        const char* arg = nullptr;
+        switch ((TraceEvent)e.kind)
+        {
+          case TraceEvent::BehaviourStart:
+            name = "behaviour";
+            phase = "B";
+            arg = "cown";
+            break;
+          case TraceEvent::BehaviourEnd:
+            name = "behaviour";
+            phase = "E";
+            break;
+          case TraceEvent::Acquire:
+            name = "acquire";
+            arg = "cown";
+            break;
+          case TraceEvent::Release:
+            name = "release";
+            arg = "cown";
+            break;
+          case TraceEvent::Steal:
+            name = "steal";
+            arg = "victim";
+            break;
+          case TraceEvent::PauseStart:
+            name = "pause";
+            phase = "B";
+            break;
+          case TraceEvent::PauseEnd:
+            name = "pause";
+            phase = "E";
+            break;
+          case TraceEvent::LDPhase:
+            name = "ld";
+            arg = "state";
+            break;
+        }
+
+        if (!first)
+          o << ",";
+        first = false;
+
+        o << "\n{\"name\":\"" << name << "\",\"ph\":\"" << phase
+          << "\",\"pid\":0,\"tid\":" << id
+          << ",\"ts\":" << ((double)(e.tick - start_tick) * us_per_tick);
+        if (phase[0] == 'i')
+          o << ",\"s\":\"t\"";
+        if (arg != nullptr)
+          o << ",\"args\":{\"" << arg << "\":" << (uint64_t)e.arg << "}";
+        o << "}";
+      });
+      o << "\n]}" << std::endl;
+    }
+  };
+} // namespace verona::rt
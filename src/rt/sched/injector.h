@@ -0,0 +1,160 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "runring.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  template<class T>
+  class Core;
+
+  /**
+   * Injection queue of a thread that is not a scheduler thread, such as an
+   * I/O thread, for the cowns it schedules.
+   *
+   * Each external thread claims an injector on a core of its NUMA node, and
+   * pushes the cowns it makes runnable onto the `RunRing` of that injector,
+   * rather than onto the `MPMCQ` of a different core for every cown. The
+   * scheduler threads take the injected cowns in batches once their own
+   * queues are empty, and every `INJECT_INTERVAL` cowns otherwise, see
+   * `SchedulerThread::take_injected`. Other threads take them one at a
+   * time when stealing from the core.
+   *
+   * The injectors of a core are never removed from its list until the core
+   * is destroyed, so the list is walked without further synchronisation. An
+   * injector released by a thread that exits is claimed by the next external
+   * thread to start on its core.
+   */
+  template<class T>
+  class Injector
+  {
+  public:
+    /// Number of cowns an injector holds before the `InjectPolicy` of the
+    /// pool applies.
+    static constexpr size_t CAPACITY = 1024;
+
+  private:
+    RunRing<T, CAPACITY> ring;
+
+    /// Next injector of the same core.
+    Injector* next = nullptr;
+
+    /// Set while an external thread owns this injector, and pushes to it.
+    std::atomic<bool> claimed{true};
+
+    Injector(Core<T>* core) : core(core) {}
+
+  public:
+    /// The core that the cowns of this injector are scheduled on.
+    Core<T>* const core;
+
+    /**
+     * Claim an injector of `c` for the calling thread, reusing one that has
+     * been released if there is one.
+     *
+     * A new injector is first touched by the calling thread, so its pages
+     * are on the NUMA node of that thread.
+     */
+    static Injector* claim(Core<T>* c)
+    {
+      c->injector_count.fetch_add(1, std::memory_order_relaxed);
+      for (Injector* i = c->injectors.load(std::memory_order_acquire);
+           i != nullptr;
+           i = i->next)
+      {
+        bool expected = false;
+        if (i->claimed.compare_exchange_strong(
+              expected, true, std::memory_order_acquire))
+          return i;
+      }
+
+      auto i = new Injector(c);
+      i->next = c->injectors.load(std::memory_order_relaxed);
+      while (!c->injectors.compare_exchange_weak(
+        i->next, i, std::memory_order_release, std::memory_order_relaxed))
+      {}
+      return i;
+    }
+
+    /**
+     * Give up ownership of this injector. The cowns it still holds are taken
+     * by the scheduler threads as usual.
+     */
+    void release()
+    {
+      core->injector_count.fetch_sub(1, std::memory_order_relaxed);
+      claimed.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Add `cown`. Only the thread that has claimed this injector may call
+     * this. Returns false if the injector is full.
+     */
+    bool push(T* cown)
+    {
+      return ring.push(cown);
+    }
+
+    bool full()
+    {
+      return ring.full();
+    }
+
+    /**
+     * Take at most `max` cowns from the injectors of `c`, one from each in
+     * turn, and call `f` on each. Returns the number of cowns taken.
+     */
+    template<typename F>
+    static size_t take(Core<T>* c, size_t max, F&& f)
+    {
+      size_t count = 0;
+      bool more = true;
+      while (more && (count < max))
+      {
+        more = false;
+        for (Injector* i = c->injectors.load(std::memory_order_acquire);
+             (i != nullptr) && (count < max);
+             i = i->next)
+        {
+          T* cown = i->ring.pop();
+          if (cown != nullptr)
+          {
+            f(cown);
+            count++;
+            more = true;
+          }
+        }
+      }
+      return count;
+    }
+
+    /// Returns true if no injector of `c` holds a cown.
+    static bool empty(Core<T>* c)
+    {
+      for (Injector* i = c->injectors.load(std::memory_order_acquire);
+           i != nullptr;
+           i = i->next)
+      {
+        if (!i->ring.empty())
+          return false;
+      }
+      return true;
+    }
+
+    /// Free the injectors of `c`, once no thread can use them.
+    static void destroy(Core<T>* c)
+    {
+      Injector* i = c->injectors.exchange(nullptr, std::memory_order_acquire);
+      while (i != nullptr)
+      {
+        Injector* n = i->next;
+        delete i;
+        i = n;
+      }
+    }
+  };
+} // namespace verona::rt
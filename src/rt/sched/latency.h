@@ -0,0 +1,249 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "behaviour.h"
+
+#include <atomic>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Histogram of durations in ticks, with buckets whose width grows with
+   * their value, as in an HDR histogram.
+   *
+   * Values below `SUB` have a bucket each. Above that, each power of two is
+   * split into `SUB` buckets, so a bucket is within 1/`SUB` of the values it
+   * holds. Any thread can record concurrently.
+   */
+  class LatencyHistogram
+  {
+  public:
+    static constexpr size_t SUB_BITS = 2;
+    static constexpr size_t SUB = 1 << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+  private:
+    std::atomic<size_t> counts[BUCKETS] = {};
+
+  public:
+    static size_t bucket(uint64_t value)
+    {
+      if (value < SUB)
+        return value;
+
+      size_t exp = 63 - snmalloc::bits::clz(value);
+      size_t sub = (value >> (exp - SUB_BITS)) & (SUB - 1);
+      return ((exp - SUB_BITS + 1) * SUB) + sub;
+    }
+
+    /// The smallest value of bucket `b`.
+    static uint64_t lower_bound(size_t b)
+    {
+      if (b < SUB)
+        return b;
+
+      size_t exp = (b / SUB) + SUB_BITS - 1;
+      return ((uint64_t)1 << exp) | ((uint64_t)(b % SUB) << (exp - SUB_BITS));
+    }
+
+    void record(uint64_t value)
+    {
+      counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t count(size_t b) const
+    {
+      return counts[b].load(std::memory_order_relaxed);
+    }
+
+    size_t total() const
+    {
+      size_t sum = 0;
+      for (size_t b = 0; b < BUCKETS; b++)
+        sum += count(b);
+      return sum;
+    }
+
+    /**
+     * The lower bound of the bucket holding the value of rank `fraction` of
+     * the total, for instance 0.99 for the 99th percentile. Returns 0 if
+     * nothing has been recorded.
+     */
+    uint64_t percentile(double fraction) const
+    {
+      size_t n = total();
+      if (n == 0)
+        return 0;
+
+      size_t rank = (size_t)(fraction * (double)(n - 1));
+      size_t seen = 0;
+      for (size_t b = 0; b < BUCKETS; b++)
+      {
+        seen += count(b);
+        if (seen > rank)
+          return lower_bound(b);
+      }
+      return lower_bound(BUCKETS - 1);
+    }
+
+    void clear()
+    {
+      for (auto& c : counts)
+        c.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * The latencies of the sampled behaviours of one descriptor, in ticks of
+   * `Aal::tick`.
+   */
+  struct BehaviourLatency
+  {
+    /// Null for the entry shared by descriptors that did not fit in the
+    /// table of `LatencyStats`.
+    std::atomic<const Behaviour::Descriptor*> descriptor = nullptr;
+    /// From scheduling the behaviour to processing its message on the first
+    /// cown.
+    LatencyHistogram queueing;
+    /// From the first cown to the last cown of the behaviour being acquired.
+    LatencyHistogram acquisition;
+    /// Running the behaviour.
+    LatencyHistogram execution;
+  };
+
+  /**
+   * Latency histograms of behaviours, per descriptor.
+   *
+   * One in `set_sampling` behaviours, counted per scheduling thread, is
+   * stamped when it is scheduled, see `MultiMessage::Body::make`, and its
+   * latencies are recorded when it runs, see `Cown::run_behaviour`. Sampling
+   * is off by default. The other behaviours only pay for reading the rate
+   * and a thread-local counter when they are scheduled.
+   *
+   * The histograms live in a fixed table, so recording never allocates.
+   * Descriptors beyond its capacity share a last entry.
+   */
+  class LatencyStats
+  {
+  public:
+    static constexpr size_t CAPACITY = 64;
+
+  private:
+    inline static std::atomic<size_t> rate = 0;
+    inline static thread_local size_t since_sample = 0;
+    inline static BehaviourLatency entries[CAPACITY + 1];
+
+    /// Ticks from `from` to `to`, which may have been read on different
+    /// cores, whose counters can be slightly out of step.
+    static uint64_t elapsed(uint64_t from, uint64_t to)
+    {
+      return to > from ? to - from : 0;
+    }
+
+  public:
+    /// Sample one in `one_in` behaviours, or none if it is 0.
+    static void set_sampling(size_t one_in)
+    {
+      rate.store(one_in, std::memory_order_relaxed);
+    }
+
+    static size_t get_sampling()
+    {
+      return rate.load(std::memory_order_relaxed);
+    }
+
+    /// Returns true if the behaviour being scheduled should be sampled.
+    static bool sample()
+    {
+      size_t r = rate.load(std::memory_order_relaxed);
+      if (SNMALLOC_LIKELY(r == 0))
+        return false;
+
+      if (++since_sample < r)
+        return false;
+
+      since_sample = 0;
+      return true;
+    }
+
+    /**
+     * The histograms of `descriptor`, which are added to the table the first
+     * time they are needed.
+     */
+    static BehaviourLatency& get(const Behaviour::Descriptor* descriptor)
+    {
+      size_t start = (((uintptr_t)descriptor >> 4) * 0x9E3779B97F4A7C15) >>
+        (64 - snmalloc::bits::ctz(CAPACITY));
+      for (size_t i = 0; i < CAPACITY; i++)
+      {
+        auto& e = entries[(start + i) & (CAPACITY - 1)];
+        const Behaviour::Descriptor* d =
+          e.descriptor.load(std::memory_order_acquire);
+        if (d == nullptr)
+        {
+          if (
+            e.descriptor.compare_exchange_strong(
+              d, descriptor, std::memory_order_acq_rel) ||
+            (d == descriptor))
+            return e;
+        }
+        else if (d == descriptor)
+        {
+          return e;
+        }
+      }
+      return entries[CAPACITY];
+    }
+
+    /**
+     * Record a sampled behaviour of `descriptor`, scheduled at `scheduled`,
+     * whose first cown was acquired at `first`, which started running at
+     * `start` and finished at `end`.
+     */
+    static void record(
+      const Behaviour::Descriptor* descriptor,
+      uint64_t scheduled,
+      uint64_t first,
+      uint64_t start,
+      uint64_t end)
+    {
+      // A behaviour run without its messages being processed has no queueing
+      // or acquisition delay.
+      if (first == 0)
+        first = start;
+
+      auto& e = get(descriptor);
+      e.queueing.record(elapsed(scheduled, first));
+      e.acquisition.record(elapsed(first, start));
+      e.execution.record(elapsed(start, end));
+    }
+
+    /**
+     * Call `f` with each `BehaviourLatency` that has recorded a behaviour,
+     * including the shared one, whose descriptor is null.
+     */
+    template<typename F>
+    static void for_each(F&& f)
+    {
+      for (auto& e : entries)
+      {
+        if (e.execution.total() != 0)
+          f(e);
+      }
+    }
+
+    /// Clear all the histograms. Other threads may still be recording.
+    static void clear()
+    {
+      for (auto& e : entries)
+      {
+        e.queueing.clear();
+        e.acquisition.clear();
+        e.execution.clear();
+      }
+    }
+  };
+} // namespace verona::rt
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "epoch.h"
+#ifdef USE_TAGGED_MPMCQ
+#  include "../ds/tagged_aba.h"
+#endif
 
 namespace verona::rt
 {
@@ -26,7 +29,10 @@ namespace verona::rt
    *
    *   - ABA protection from snmalloc - this will use LL/SC or Double-word
    *     compare and swap.  This ensures that the same element can be added
-   *     to the queue multiple times without leading to ABA issues.
+   *     to the queue multiple times without leading to ABA issues. Where
+   *     neither is available, snmalloc falls back to a spin lock, so
+   *     `USE_TAGGED_MPMCQ` selects `TaggedABA` instead, which only needs a
+   *     single word compare and swap.
    *   - Memory safety, the underlying elements of the queue my also be
    *     deallocated however, if this occurs, then we could potentially access
    *     decommitted memory with the optimistic concurrency. To protect against
@@ -56,7 +62,11 @@ namespace verona::rt
     std::atomic<T*> back;
     // Multi-threaded end of the "queue" requires ABA protection.
     // Used for work stealing and posting new work from another thread.
+#ifdef USE_TAGGED_MPMCQ
+    TaggedABA<T> front;
+#else
     snmalloc::ABA<T> front;
+#endif
 
     T* unmask(T* tagged_ptr)
     {
@@ -90,18 +100,29 @@ namespace verona::rt
      * completed.
      */
     void enqueue(Alloc& alloc, T* node)
+    {
+      enqueue_segment(alloc, node, node);
+    }
+
+    /**
+     * Enqueue a segment of nodes, from `first` to `last`, with a single
+     * exchange on `back`.  The nodes must already be linked through
+     * `next_in_queue`.  As with `enqueue`, this is not linearisable with
+     * respect to dequeue, but the nodes of a segment are never interleaved
+     * with other enqueues.
+     */
+    void enqueue_segment(Alloc& alloc, T* first, T* last)
     {
       UNUSED(alloc);
-      auto unmasked_node = unmask(node);
-      unmasked_node->next_in_queue = nullptr;
+      unmask(last)->next_in_queue = nullptr;
       std::atomic_thread_fence(std::memory_order_release);
       auto unmasked_back =
-        unmask(back.exchange(node, std::memory_order_relaxed));
+        unmask(back.exchange(last, std::memory_order_relaxed));
       // The element we are writing into must have made its next pointer null
       // before exchanging into the structure, as the element cannot be removed
       // if it has a null next pointer, we know the write is safe.
       assert(unmasked_back->next_in_queue == nullptr);
-      unmasked_back->next_in_queue.store(node, std::memory_order_relaxed);
+      unmasked_back->next_in_queue.store(first, std::memory_order_relaxed);
     }
 
     void enqueue_front(Alloc& alloc, T* node)
@@ -158,6 +179,80 @@ namespace verona::rt
       return fnt;
     }
 
+    /**
+     * Take a segment of up to `max` elements from the front of the queue, with
+     * a single update of `front`.  The segment stops before the first token,
+     * and never includes the last element of the queue, so it may be shorter
+     * than `max`.  Returns the first element, or nullptr if the front of the
+     * queue is a token or has no successor; like `dequeue` this may
+     * spuriously fail.  `count` is set to the number of elements.
+     *
+     * Only the returned element is popped as by `dequeue`.  The rest of the
+     * segment, from `rest` to `last`, is still linked through `next_in_queue`
+     * and must be passed to `enqueue_segment` of some queue, as the elements
+     * may still be read by concurrent dequeues of this queue.  If the segment
+     * has one element, `rest` and `last` are set to nullptr.
+     */
+    T* dequeue_segment(
+      Alloc& alloc, size_t max, T*& rest, T*& last, size_t& count)
+    {
+      assert(max > 0);
+      T* next;
+      T* fnt;
+      T* end;
+      size_t n;
+
+      // Hold epoch to ensure that the values read from the queue cannot be
+      // deallocated during this operation, see `dequeue`.
+      Epoch e(alloc);
+      uint64_t epoch = e.get_local_epoch_epoch();
+
+      auto cmp = front.read();
+      do
+      {
+        fnt = cmp.ptr();
+        // Tokens are left to `dequeue`.
+        if (is_bit_set(fnt))
+          return nullptr;
+
+        end = fnt;
+        n = 1;
+        next = fnt->next_in_queue;
+        if (next == nullptr)
+          return nullptr;
+
+        // If the update of `front` succeeds, nothing was dequeued while
+        // walking, so these elements were still linked in the queue.
+        while ((n < max) && !is_bit_set(next))
+        {
+          T* after = next->next_in_queue;
+          if (after == nullptr)
+            break;
+          end = next;
+          next = after;
+          n++;
+        }
+      } while (!cmp.store_conditional(next));
+
+      assert(epoch != T::NO_EPOCH_SET);
+
+      if (n == 1)
+      {
+        rest = nullptr;
+        last = nullptr;
+      }
+      else
+      {
+        rest = fnt->next_in_queue;
+        last = end;
+      }
+      count = n;
+
+      // This may overwrite `next_in_queue`, so must follow reading `rest`.
+      fnt->epoch_when_popped = epoch;
+      return fnt;
+    }
+
     // The callers are expected to guarantee no one is attempting to access the
     // queue concurrently.
     void destroy(Alloc& alloc)
@@ -5,6 +5,7 @@
 #include "../ds/mpscq.h"
 #include "../object/object.h"
 #include "behaviour.h"
+#include "latency.h"
 
 #include <snmalloc/snmalloc.h>
 
@@ -18,18 +19,41 @@ namespace verona::rt
      * This represents a message that is sent to a behaviour.
      *
      * The layout requires that after the allocation there is space for
-     * `count` cown pointers, and then the behaviour's body.
+     * `count` cown pointers, then the `count` messages that are sent to those
+     * cowns, and then the behaviour's body.
      *
-     * This layout allows the message body to be single allocation even though
-     * there are multiple different sized pieces.
+     * This layout allows a behaviour to be a single allocation however many
+     * cowns it is sent to, even though there are multiple different sized
+     * pieces. The behaviour, including all the state captured by its closure,
+     * lives in the body, at `behaviour_offset`, which is padded for
+     * over-aligned behaviours.
+     *
+     * A message stays in its cown's queue after it has been processed, until
+     * the cown processes its next message, see `MPSCQ::dequeue`, so the body
+     * is reference counted. The behaviour holds one reference until it has
+     * run, and each message that is made holds one until it is freed.
      */
     struct Body
     {
       std::atomic<size_t> exec_count_down;
       size_t count;
+      size_t messages_offset;
+      size_t behaviour_offset;
+      std::atomic<size_t> references{1};
+      /// Tick at which the behaviour was scheduled if it is sampled, see
+      /// `LatencyStats`, and zero otherwise.
+      uint64_t scheduled = 0;
+      /// Tick at which the message to the first cown was processed, if the
+      /// behaviour is sampled.
+      std::atomic<uint64_t> first_acquired = 0;
 
     private:
-      Body(size_t count) : exec_count_down(count), count(count) {}
+      Body(size_t count, size_t messages_offset, size_t behaviour_offset)
+      : exec_count_down(count),
+        count(count),
+        messages_offset(messages_offset),
+        behaviour_offset(behaviour_offset)
+      {}
 
     public:
       /**
@@ -40,30 +64,84 @@ namespace verona::rt
         return snmalloc::pointer_offset<Request>(this, sizeof(Body));
       }
 
+      MultiMessage* get_messages_array()
+      {
+        return snmalloc::pointer_offset<MultiMessage>(this, messages_offset);
+      }
+
       Behaviour& get_behaviour()
       {
-        return *snmalloc::pointer_offset<Behaviour>(
-          this, sizeof(Body) + sizeof(Request) * count);
+        return *snmalloc::pointer_offset<Behaviour>(this, behaviour_offset);
+      }
+
+      /**
+       * Drop a reference to the body, and free it if that was the last. The
+       * behaviour drops its reference once it has run or been discarded.
+       */
+      void release(Alloc& alloc)
+      {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          alloc.dealloc(this);
       }
 
       /**
        * Allocates a message body with sufficient space for the
        * cowns_array and the behaviour.  This does not initialise the cowns
        * array.
+       *
+       * The arguments are forwarded to the constructor of the behaviour, so
+       * a closure passed as an rvalue is moved once, straight into the body.
        */
       template<typename Be, typename... Args>
-      static Body* make(Alloc& alloc, size_t count, Args... args)
+      static Body* make(Alloc& alloc, size_t count, Args&&... args)
       {
-        size_t size = sizeof(Body) + (sizeof(Request) * count) + sizeof(Be);
-
-        // Create behaviour
-        auto body = new (alloc.alloc(size)) Body(count);
+        auto body = allocate(alloc, count, sizeof(Be), alignof(Be));
         new ((Be*)&(body->get_behaviour())) Be(std::forward<Args>(args)...);
+        return body;
+      }
 
-        static_assert(
-          alignof(Be) <= sizeof(void*), "Alignment not supported, yet!");
-        static_assert(
-          sizeof(Body) % alignof(Be) == 0, "Alignment not supported, yet!");
+      /**
+       * As `make`, for a behaviour whose type is not known here, such as one
+       * laid out by compiled Verona code. The behaviour is `desc->size` bytes
+       * aligned to `align`, and only its `Behaviour` header is constructed:
+       * the caller writes the captured state that follows the header in
+       * place, before the body is sent.
+       */
+      static Body* make_raw(
+        Alloc& alloc,
+        size_t count,
+        const Behaviour::Descriptor* desc,
+        size_t align)
+      {
+        assert(bits::is_pow2(align));
+        assert(align >= alignof(Behaviour));
+        assert(desc->size >= sizeof(Behaviour));
+
+        auto body = allocate(alloc, count, desc->size, align);
+        new (&body->get_behaviour()) Behaviour(desc);
+        return body;
+      }
+
+    private:
+      static Body*
+      allocate(Alloc& alloc, size_t count, size_t size, size_t align)
+      {
+        static_assert(alignof(MultiMessage) <= alignof(Request));
+        size_t messages_offset = sizeof(Body) + (sizeof(Request) * count);
+        size_t messages_end = messages_offset + (sizeof(MultiMessage) * count);
+
+        // The allocation is only known to be aligned for the Body, so leave
+        // room to align an over-aligned behaviour.
+        size_t padding = align > alignof(Body) ? align - alignof(Body) : 0;
+        void* p = alloc.alloc(messages_end + padding + size);
+
+        size_t offset =
+          bits::align_up((uintptr_t)p + messages_end, align) - (uintptr_t)p;
+
+        auto body = new (p) Body(count, messages_offset, offset);
+
+        if (SNMALLOC_UNLIKELY(LatencyStats::sample()))
+          body->scheduled = Aal::tick();
 
         return body;
       }
@@ -84,9 +162,29 @@ namespace verona::rt
       return result;
     }
 
-    static MultiMessage* make(Alloc& alloc, EpochMark epoch, Body* body)
+    /**
+     * The request of the cown that this message was sent to.
+     */
+    inline Request* get_request()
+    {
+      // The message is at the same index in the messages array of the body
+      // as its request is in the requests array.
+      auto* b = get_body();
+      return &b->get_requests_array()[this - b->get_messages_array()];
+    }
+
+    /**
+     * Makes the message for request `index` of `body`, in the body.
+     */
+    static MultiMessage*
+    make(Alloc& alloc, EpochMark epoch, Body* body, size_t index)
     {
-      auto msg = (MultiMessage*)alloc.alloc<sizeof(MultiMessage)>();
+      UNUSED(alloc);
+      assert(body != nullptr);
+      assert(index < body->count);
+      body->references.fetch_add(1, std::memory_order_relaxed);
+
+      auto msg = &body->get_messages_array()[index];
       msg->body = body;
       msg->set_epoch(epoch);
       return msg;
@@ -116,17 +214,28 @@ namespace verona::rt
       assert(get_epoch() == e);
     }
 
-    static MultiMessage* make_message(Alloc& alloc, Body* body, EpochMark epoch)
+    /**
+     * Make the message for the cown of request `index` of `body`.
+     */
+    static MultiMessage*
+    make_message(Alloc& alloc, Body* body, EpochMark epoch, size_t index = 0)
     {
-      MultiMessage* m = make(alloc, epoch, body);
+      MultiMessage* m = make(alloc, epoch, body, index);
       Logging::cout() << "MultiMessage " << m << " payload " << body << " ("
                       << epoch << ")" << Logging::endl;
       return m;
     }
 
-    inline size_t size()
+    /**
+     * Frees this message, by dropping its reference to its body. The only
+     * message without a body is the stub embedded in each cown, see
+     * `Cown::stub`, which is freed with the cown.
+     */
+    void dealloc(Alloc& alloc)
     {
-      return sizeof(MultiMessage);
+      auto* b = get_body();
+      if (b != nullptr)
+        b->release(alloc);
     }
   };
 } // namespace verona::rt
@@ -3,11 +3,13 @@
 #pragma once
 
 #include "../ds/forward_list.h"
+#include "../region/freeze.h"
 #include "../region/region.h"
 #include "../sched/epoch.h"
 #include "../sched/schedulerthread.h"
 #include "../test/logging.h"
 
+#include <cstring>
 #include <queue>
 
 namespace verona::rt
@@ -19,6 +21,7 @@ namespace verona::rt
     Noticeboard(T content_)
     {
       is_fundamental = std::is_fundamental_v<T>;
+      publish = publish_staged_value;
       put(content_);
     }
 
@@ -35,6 +38,9 @@ namespace verona::rt
         auto p = get<T>();
         if (p)
           st.push(p);
+
+        if (is_staged)
+          st.push(get_staged());
       }
       else
       {
@@ -72,6 +78,41 @@ namespace verona::rt
 #endif
     }
 
+    /**
+     * Like `update`, but only the last value staged by the running behaviour
+     * is published, once the behaviour completes. The values it replaces were
+     * never seen by readers, so they are released without waiting for an
+     * epoch. Outside of a behaviour, this is `update`.
+     */
+    void stage(Alloc& alloc, T new_o)
+    {
+      if constexpr (!std::is_fundamental_v<T>)
+      {
+        assert(new_o->debug_is_immutable());
+      }
+
+      auto local = Scheduler::local();
+      if ((local == nullptr) || (local->message_body == nullptr))
+      {
+        update(alloc, new_o);
+        return;
+      }
+
+      if (is_staged)
+      {
+        if constexpr (!std::is_fundamental_v<T>)
+          Immutable::release(alloc, get_staged());
+      }
+      else
+      {
+        is_staged = true;
+        next_staged = local->staged_noticeboards;
+        local->staged_noticeboards = this;
+      }
+
+      std::memcpy(&staged, &new_o, sizeof(T));
+    }
+
     T peek(Alloc& alloc)
     {
       if constexpr (std::is_fundamental_v<T>)
@@ -108,5 +149,140 @@ namespace verona::rt
         return local_content;
       }
     }
+
+  private:
+    T get_staged() const
+    {
+      T v;
+      std::memcpy(&v, &staged, sizeof(T));
+      return v;
+    }
+
+    static void publish_staged_value(BaseNoticeboard* nb, Alloc& alloc)
+    {
+      auto self = static_cast<Noticeboard<T>*>(nb);
+      self->update(alloc, self->get_staged());
+    }
+  };
+
+  /**
+   * A noticeboard for a trivially copyable `T` of any size, that readers copy
+   * out without any reference counting or epoch.
+   *
+   * Only behaviours on the owning cown may `update` it. Updates bump a
+   * sequence number before and after writing, and a reader retries its copy
+   * if the sequence number was odd or changed while it copied.
+   */
+  template<typename T>
+  class SeqNoticeboard
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    static constexpr size_t WORDS =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> words[WORDS];
+
+    void store(const T& v)
+    {
+      uint64_t buf[WORDS] = {};
+      std::memcpy(buf, &v, sizeof(T));
+      for (size_t i = 0; i < WORDS; i++)
+        words[i].store(buf[i], std::memory_order_relaxed);
+    }
+
+  public:
+    SeqNoticeboard(const T& v)
+    {
+      store(v);
+    }
+
+    void update(const T& v)
+    {
+      uint64_t s = seq.load(std::memory_order_relaxed);
+      seq.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      store(v);
+      seq.store(s + 2, std::memory_order_release);
+    }
+
+    T peek() const
+    {
+      uint64_t buf[WORDS];
+      while (true)
+      {
+        uint64_t s = seq.load(std::memory_order_acquire);
+        if ((s & 1) == 0)
+        {
+          for (size_t i = 0; i < WORDS; i++)
+            buf[i] = words[i].load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (seq.load(std::memory_order_relaxed) == s)
+            break;
+        }
+        Aal::pause();
+      }
+
+      T v;
+      std::memcpy(&v, buf, sizeof(T));
+      return v;
+    }
+  };
+
+  /**
+   * A noticeboard of the versions of a persistent immutable structure.
+   *
+   * Only behaviours on the owning cown may `publish`. Each version is built
+   * in a new trace region, whose objects may point to those of `latest()`, or
+   * to any other object reachable from it. Publishing freezes only the new
+   * region: the objects it shares with the previous version are already
+   * immutable, so freezing just takes a reference to each of their SCCs. An
+   * update that replaces a path through a tree therefore freezes only that
+   * path. Readers `peek` the latest version as for `Noticeboard`, without
+   * scheduling on the owner, and release it with `Immutable::release`.
+   */
+  class VersionedNoticeboard : public Noticeboard<Object*>
+  {
+    // The owner's reference to the latest version, which keeps the objects
+    // shared by the version being built alive until it is published.
+    Object* current;
+
+  public:
+    /// Takes the reference to `initial`, which must be immutable.
+    VersionedNoticeboard(Object* initial)
+    : Noticeboard<Object*>(initial), current(initial)
+    {
+      assert(initial->debug_is_immutable());
+      initial->incref();
+    }
+
+    void trace(ObjectStack& st) const
+    {
+      Noticeboard<Object*>::trace(st);
+      st.push(current);
+    }
+
+    /**
+     * The latest version, for the owning cown. The reference is borrowed,
+     * and is valid until the next `publish`.
+     */
+    Object* latest() const
+    {
+      return current;
+    }
+
+    /**
+     * Freezes the region of the Iso object `o` and publishes it as the latest
+     * version, taking the reference to it.
+     */
+    void publish(Alloc& alloc, Object* o)
+    {
+      Freeze::apply(alloc, o);
+      o->incref();
+      update(alloc, o);
+      Immutable::release(alloc, current);
+      current = o;
+    }
   };
 } // namespace verona::rt
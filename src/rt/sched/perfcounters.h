@@ -0,0 +1,375 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "behaviour.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <snmalloc/snmalloc.h>
+
+#ifdef __linux__
+#  include <cstring>
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace verona::rt
+{
+  enum class PerfEvent : size_t
+  {
+    Cycles,
+    Instructions,
+    /// Misses of the last level cache, which include the accesses that go
+    /// to another socket.
+    LLCMisses,
+    BranchMisses,
+    Count,
+  };
+
+  static constexpr size_t PERF_EVENTS = (size_t)PerfEvent::Count;
+
+  /// Values of the hardware counters of `PerfEvent`.
+  struct PerfCounts
+  {
+    uint64_t values[PERF_EVENTS] = {};
+
+    uint64_t operator[](PerfEvent e) const
+    {
+      return values[(size_t)e];
+    }
+  };
+
+  /**
+   * Group of the hardware counters of `PerfEvent` for the calling thread,
+   * opened with `perf_event_open`, which are all read at once. The counters
+   * only count user mode. The group is invalid if the counters could not be
+   * opened, for instance without the permission to, see
+   * `perf_event_paranoid`, on a machine without them, or on other platforms
+   * than Linux.
+   */
+  class PerfCounterGroup
+  {
+    int fds[PERF_EVENTS];
+
+  public:
+    PerfCounterGroup()
+    {
+      for (auto& fd : fds)
+        fd = -1;
+
+#ifdef __linux__
+      static constexpr uint64_t configs[PERF_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+
+      for (size_t i = 0; i < PERF_EVENTS; i++)
+      {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fds[i] = (int)syscall(
+          __NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+        if (fds[i] < 0)
+        {
+          close_all();
+          return;
+        }
+      }
+
+      ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    ~PerfCounterGroup()
+    {
+      close_all();
+    }
+
+    bool valid() const
+    {
+      return fds[0] >= 0;
+    }
+
+    /// Read the counters into `c`. Returns false if the group is invalid.
+    bool read(PerfCounts& c)
+    {
+#ifdef __linux__
+      if (!valid())
+        return false;
+
+      struct
+      {
+        uint64_t nr;
+        uint64_t values[PERF_EVENTS];
+      } data;
+
+      if (::read(fds[0], &data, sizeof(data)) != (ssize_t)sizeof(data))
+        return false;
+
+      for (size_t i = 0; i < PERF_EVENTS; i++)
+        c.values[i] = data.values[i];
+      return true;
+#else
+      UNUSED(c);
+      return false;
+#endif
+    }
+
+  private:
+    void close_all()
+    {
+      for (auto& fd : fds)
+      {
+#ifdef __linux__
+        if (fd >= 0)
+          close(fd);
+#endif
+        fd = -1;
+      }
+    }
+  };
+
+  /// Counters summed over the samples of one descriptor, see `PerfStats`.
+  struct PerfEntry
+  {
+    /// Null for the entry shared by descriptors that did not fit in the
+    /// table of `PerfStats`.
+    std::atomic<const Behaviour::Descriptor*> descriptor = nullptr;
+    std::atomic<uint64_t> samples = 0;
+    std::atomic<uint64_t> values[PERF_EVENTS] = {};
+
+    void add(const PerfCounts& from, const PerfCounts& to)
+    {
+      samples.fetch_add(1, std::memory_order_relaxed);
+      for (size_t i = 0; i < PERF_EVENTS; i++)
+        values[i].fetch_add(
+          to.values[i] - from.values[i], std::memory_order_relaxed);
+    }
+
+    uint64_t get(PerfEvent e) const
+    {
+      return values[(size_t)e].load(std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+      samples.store(0, std::memory_order_relaxed);
+      for (auto& v : values)
+        v.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * Hardware counters of the scheduler threads, built with
+   * `USE_PERF_COUNTERS`.
+   *
+   * One in `set_sampling` batches of messages run by `Cown::run`, and one in
+   * `set_sampling` behaviours, counted per scheduler thread, are measured by
+   * reading the counters of the thread before and after them. Batches are
+   * summed together, and behaviours per descriptor, so that the IPC and
+   * cache misses of each behaviour type can be compared. Sampling is off by
+   * default. Each thread opens its counters the first time it samples, and
+   * records nothing if it cannot.
+   *
+   * Reading the counters is a system call, so the sampling rate should keep
+   * it well away from every behaviour.
+   */
+  class PerfStats
+  {
+  public:
+    static constexpr size_t CAPACITY = 64;
+
+  private:
+    inline static std::atomic<size_t> rate = 0;
+    inline static thread_local size_t batches_since_sample = 0;
+    inline static thread_local size_t behaviours_since_sample = 0;
+    inline static PerfEntry batch_entry;
+    inline static PerfEntry entries[CAPACITY + 1];
+
+    static bool sample(size_t& since)
+    {
+      size_t r = rate.load(std::memory_order_relaxed);
+      if (SNMALLOC_LIKELY(r == 0))
+        return false;
+
+      if (++since < r)
+        return false;
+
+      since = 0;
+      return true;
+    }
+
+    static PerfCounterGroup& local()
+    {
+      static thread_local PerfCounterGroup group;
+      return group;
+    }
+
+  public:
+    /// Sample one in `one_in` batches and behaviours, or none if it is 0.
+    static void set_sampling(size_t one_in)
+    {
+      rate.store(one_in, std::memory_order_relaxed);
+    }
+
+    static size_t get_sampling()
+    {
+      return rate.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns true, with the counters of this thread in `start`, if the
+     * batch about to run should be sampled.
+     */
+    static bool start_batch(PerfCounts& start)
+    {
+      return sample(batches_since_sample) && local().read(start);
+    }
+
+    static void end_batch(const PerfCounts& start)
+    {
+      PerfCounts end;
+      if (local().read(end))
+        batch_entry.add(start, end);
+    }
+
+    /// As `start_batch`, for a behaviour.
+    static bool start_behaviour(PerfCounts& start)
+    {
+      return sample(behaviours_since_sample) && local().read(start);
+    }
+
+    static void
+    end_behaviour(const Behaviour::Descriptor* descriptor, PerfCounts& start)
+    {
+      PerfCounts end;
+      if (local().read(end))
+        get(descriptor).add(start, end);
+    }
+
+    /**
+     * The counters of `descriptor`, which are added to the table the first
+     * time they are needed.
+     */
+    static PerfEntry& get(const Behaviour::Descriptor* descriptor)
+    {
+      size_t start = (((uintptr_t)descriptor >> 4) * 0x9E3779B97F4A7C15) >>
+        (64 - snmalloc::bits::ctz(CAPACITY));
+      for (size_t i = 0; i < CAPACITY; i++)
+      {
+        auto& e = entries[(start + i) & (CAPACITY - 1)];
+        const Behaviour::Descriptor* d =
+          e.descriptor.load(std::memory_order_acquire);
+        if (d == nullptr)
+        {
+          if (
+            e.descriptor.compare_exchange_strong(
+              d, descriptor, std::memory_order_acq_rel) ||
+            (d == descriptor))
+            return e;
+        }
+        else if (d == descriptor)
+        {
+          return e;
+        }
+      }
+      return entries[CAPACITY];
+    }
+
+    static const PerfEntry& batches()
+    {
+      return batch_entry;
+    }
+
+    /**
+     * Call `f` with each `PerfEntry` of a descriptor that has recorded a
+     * behaviour, including the shared one, whose descriptor is null.
+     */
+    template<typename F>
+    static void for_each(F&& f)
+    {
+      for (auto& e : entries)
+      {
+        if (e.samples.load(std::memory_order_relaxed) != 0)
+          f(e);
+      }
+    }
+
+    /// Write the batches and each descriptor, per sample, one per line.
+    static void print(std::ostream& o)
+    {
+      auto line = [&](const PerfEntry& e) {
+        uint64_t n = e.samples.load(std::memory_order_relaxed);
+        uint64_t cycles = e.get(PerfEvent::Cycles);
+        o << " samples " << n << " cycles " << (n ? cycles / n : 0) << " ipc "
+          << (cycles ? (double)e.get(PerfEvent::Instructions) / cycles : 0.0)
+          << " llc misses " << (n ? e.get(PerfEvent::LLCMisses) / n : 0)
+          << " branch misses " << (n ? e.get(PerfEvent::BranchMisses) / n : 0)
+          << std::endl;
+      };
+
+      o << "batches";
+      line(batch_entry);
+      for_each([&](const PerfEntry& e) {
+        o << "descriptor " << e.descriptor.load(std::memory_order_relaxed);
+        line(e);
+      });
+    }
+
+    /**
+     * Write the sums of the counters in the Prometheus text exposition
+     * format, see `ThreadPool::write_stats_prometheus`. Batches have the
+     * descriptor label "batch".
+     */
+    static void write_prometheus(std::ostream& o)
+    {
+      static constexpr const char* names[PERF_EVENTS] = {
+        "cycles", "instructions", "llc_misses", "branch_misses"};
+
+      auto metric = [&](const char* name, const char* help, auto value) {
+        o << "# HELP verona_perf_" << name << "_total " << help << "\n";
+        o << "# TYPE verona_perf_" << name << "_total counter\n";
+        o << "verona_perf_" << name << "_total{descriptor=\"batch\"} "
+          << value(batch_entry) << "\n";
+        for_each([&](const PerfEntry& e) {
+          o << "verona_perf_" << name << "_total{descriptor=\""
+            << e.descriptor.load(std::memory_order_relaxed) << "\"} "
+            << value(e) << "\n";
+        });
+      };
+
+      metric(
+        "samples", "Sampled batches or behaviours", [](const PerfEntry& e) {
+          return e.samples.load(std::memory_order_relaxed);
+        });
+      for (size_t i = 0; i < PERF_EVENTS; i++)
+        metric(names[i], "Sampled hardware counter", [i](const PerfEntry& e) {
+          return e.values[i].load(std::memory_order_relaxed);
+        });
+    }
+
+    /// Clear all the counters. Other threads may still be recording.
+    static void clear()
+    {
+      batch_entry.clear();
+      for (auto& e : entries)
+        e.clear();
+    }
+  };
+} // namespace verona::rt
@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Bounded ring of cowns, filled by a single thread and emptied by any
+   * thread, in FIFO order.
+   *
+   * This is the local run queue of a core with `USE_RUN_RING`: its scheduler
+   * thread pushes the cowns it reschedules, and pops them back, touching an
+   * array rather than the `next_in_queue` fields of the cowns. Thieves take
+   * from the same end as the owner with a compare and swap on `head`. A push
+   * fails when the ring is full, and the cown must then be scheduled on the
+   * core's `MPMCQ`.
+   *
+   * Cowns are not read through the ring until they have been popped, so,
+   * unlike `MPMCQ`, the ring needs no epoch protection.
+   *
+   * The same ring holds the cowns of an `Injector`, and the tasks of a core,
+   * see `Task`.
+   */
+  template<class T, size_t CAPACITY = 256>
+  class RunRing
+  {
+  private:
+    static_assert(snmalloc::bits::is_pow2(CAPACITY));
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    /// Index of the next cown to pop. Only increases.
+    alignas(64) std::atomic<size_t> head{0};
+    /// Index of the next slot to fill. Only written by the owner.
+    alignas(64) std::atomic<size_t> tail{0};
+
+    std::atomic<T*> slots[CAPACITY];
+
+  public:
+    /**
+     * Add `cown` to the ring. Only the owner may call this. Returns false if
+     * the ring is full.
+     */
+    bool push(T* cown)
+    {
+      size_t t = tail.load(std::memory_order_relaxed);
+      // Acquire, so that a thief has read the slot before it is reused.
+      if (t - head.load(std::memory_order_acquire) >= CAPACITY)
+        return false;
+
+      slots[t & MASK].store(cown, std::memory_order_relaxed);
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Take the oldest cown of the ring, or return nullptr if it is empty.
+     */
+    T* pop()
+    {
+      size_t h = head.load(std::memory_order_acquire);
+      while (h != tail.load(std::memory_order_acquire))
+      {
+        // The slot cannot be reused by the owner until `head` moves past it,
+        // in which case the compare and swap fails.
+        T* cown = slots[h & MASK].load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(
+              h, h + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+          return cown;
+      }
+      return nullptr;
+    }
+
+    /// Returns true if a push by the owner would fail.
+    bool full()
+    {
+      return tail.load(std::memory_order_relaxed) -
+        head.load(std::memory_order_acquire) >=
+        CAPACITY;
+    }
+
+    bool empty()
+    {
+      return head.load(std::memory_order_acquire) ==
+        tail.load(std::memory_order_acquire);
+    }
+  };
+} // namespace verona::rt
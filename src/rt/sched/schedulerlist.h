@@ -64,7 +64,8 @@ namespace verona::rt
     // Applies f on all active and free threads.
     // WARNING: do not call other methods on the list or we end up with
     // deadlock.
-    void forall(void (*f)(T* elem))
+    template<typename F>
+    void forall(F&& f)
     {
       snmalloc::FlagLock lock(m);
       T* t = active.get_head();
@@ -2,105 +2,381 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <snmalloc/snmalloc.h>
+#include <vector>
 
 namespace verona::rt
 {
   using namespace snmalloc;
-  class SchedulerStats
+
+  /**
+   * A copy of the counters of a `SchedulerStats`, see
+   * `ThreadPool::snapshot_stats`.
+   */
+  struct SchedulerSnapshot
+  {
+    /// Buckets of the batch size histogram. Bucket `i` counts the batches of
+    /// `2^i` to `2^(i+1) - 1` messages, and the last one all larger batches.
+    static constexpr size_t BATCH_BUCKETS = 16;
+    /// Buckets of the steal distance histogram. Bucket `i` counts the steals
+    /// from the victims of rank `2^i` to `2^(i+1) - 1`, see
+    /// `Core::distance_rank`, and the last one all further victims.
+    static constexpr size_t STEAL_BUCKETS = 8;
+
+    /// Affinity of the core, or `SIZE_MAX` for a sum over cores.
+    size_t core = SIZE_MAX;
+    size_t behaviours = 0;
+    size_t messages = 0;
+    size_t scan_messages = 0;
+    size_t batches[BATCH_BUCKETS] = {};
+    /// Cowns waiting in the queues of the core when the snapshot was taken.
+    size_t queued = 0;
+    size_t steals = 0;
+    size_t remote_steals = 0;
+    size_t steal_distances[STEAL_BUCKETS] = {};
+    size_t lifo = 0;
+    size_t pauses = 0;
+    uint64_t pause_ticks = 0;
+    size_t unpauses = 0;
+    size_t mutes = 0;
+    size_t unmutes = 0;
+    size_t migrates = 0;
+    size_t homes = 0;
+    size_t ld_cycles = 0;
+    uint64_t ld_ticks = 0;
+
+    static size_t bucket(size_t n, size_t buckets)
+    {
+      if (n == 0)
+        return 0;
+      return std::min<size_t>(63 - bits::clz(n), buckets - 1);
+    }
+
+    void add(const SchedulerSnapshot& that)
+    {
+      behaviours += that.behaviours;
+      messages += that.messages;
+      scan_messages += that.scan_messages;
+      for (size_t i = 0; i < BATCH_BUCKETS; i++)
+        batches[i] += that.batches[i];
+      queued += that.queued;
+      steals += that.steals;
+      remote_steals += that.remote_steals;
+      for (size_t i = 0; i < STEAL_BUCKETS; i++)
+        steal_distances[i] += that.steal_distances[i];
+      lifo += that.lifo;
+      pauses += that.pauses;
+      pause_ticks += that.pause_ticks;
+      unpauses += that.unpauses;
+      mutes += that.mutes;
+      unmutes += that.unmutes;
+      migrates += that.migrates;
+      homes += that.homes;
+      // Every thread takes part in every run of the leak detector, so the
+      // longest of their times is the wall time of the runs.
+      ld_cycles = std::max(ld_cycles, that.ld_cycles);
+      ld_ticks = std::max(ld_ticks, that.ld_ticks);
+    }
+
+    /**
+     * Write `snapshots` in the Prometheus text exposition format, with one
+     * sample per core labelled by its affinity. Histogram buckets are
+     * labelled by their lower bound.
+     */
+    static void
+    write_prometheus(std::ostream& o, const std::vector<SchedulerSnapshot>& s)
+    {
+      auto counter = [&](const char* name, const char* help, auto field) {
+        o << "# HELP verona_" << name << " " << help << "\n";
+        o << "# TYPE verona_" << name << " counter\n";
+        for (auto& c : s)
+          o << "verona_" << name << "{core=\"" << c.core << "\"} " << c.*field
+            << "\n";
+      };
+
+      auto histogram = [&](
+                         const char* name,
+                         const char* help,
+                         const char* label,
+                         auto field,
+                         size_t buckets) {
+        o << "# HELP verona_" << name << " " << help << "\n";
+        o << "# TYPE verona_" << name << " counter\n";
+        for (auto& c : s)
+        {
+          for (size_t i = 0; i < buckets; i++)
+            o << "verona_" << name << "{core=\"" << c.core << "\"," << label
+              << "=\"" << ((size_t)1 << i) << "\"} " << (c.*field)[i] << "\n";
+        }
+      };
+
+      counter(
+        "behaviours_total", "Behaviours run", &SchedulerSnapshot::behaviours);
+      counter(
+        "messages_total", "Messages processed", &SchedulerSnapshot::messages);
+      counter(
+        "scan_messages_total",
+        "Messages processed while scanning for the leak detector",
+        &SchedulerSnapshot::scan_messages);
+      histogram(
+        "batches_total",
+        "Cown batches by number of messages",
+        "size",
+        &SchedulerSnapshot::batches,
+        BATCH_BUCKETS);
+
+      o << "# HELP verona_queued Cowns waiting in the queues of the core\n";
+      o << "# TYPE verona_queued gauge\n";
+      for (auto& c : s)
+        o << "verona_queued{core=\"" << c.core << "\"} " << c.queued << "\n";
+
+      counter("steals_total", "Cowns stolen", &SchedulerSnapshot::steals);
+      counter(
+        "remote_steals_total",
+        "Cowns stolen from another NUMA node",
+        &SchedulerSnapshot::remote_steals);
+      histogram(
+        "steal_distance_total",
+        "Cowns stolen by rank of the victim",
+        "rank",
+        &SchedulerSnapshot::steal_distances,
+        STEAL_BUCKETS);
+      counter("lifo_total", "LIFO schedules", &SchedulerSnapshot::lifo);
+      counter("pauses_total", "Thread pauses", &SchedulerSnapshot::pauses);
+      counter(
+        "pause_ticks_total",
+        "Ticks spent paused",
+        &SchedulerSnapshot::pause_ticks);
+      counter("unpauses_total", "Thread wakes", &SchedulerSnapshot::unpauses);
+      counter("mutes_total", "Cowns muted", &SchedulerSnapshot::mutes);
+      counter("unmutes_total", "Cowns unmuted", &SchedulerSnapshot::unmutes);
+      counter(
+        "migrates_total", "Cowns migrated", &SchedulerSnapshot::migrates);
+      counter(
+        "homes_total",
+        "Cowns returned to their home core",
+        &SchedulerSnapshot::homes);
+      counter(
+        "ld_cycles_total",
+        "Leak detector runs",
+        &SchedulerSnapshot::ld_cycles);
+      counter(
+        "ld_ticks_total",
+        "Ticks spent in the leak detector",
+        &SchedulerSnapshot::ld_ticks);
+    }
+  };
+
+  /**
+   * Counters of the work done on a core. These are always on, and read while
+   * the scheduler threads run by `ThreadPool::snapshot_stats`.
+   *
+   * The counters are relaxed atomics, so that they can be read concurrently.
+   * Those only written by the scheduler thread of the core are incremented
+   * with a plain load and store rather than a read-modify-write, and the
+   * stats sit on cache lines of their own. With `USE_SCHED_STATS`, the sum of
+   * the counters of all cores is also printed as CSV when the process
+   * exits.
+   */
+  class alignas(64) SchedulerStats
   {
   private:
-#ifdef USE_SCHED_STATS
-    size_t steal_count = 0;
-    size_t pause_count = 0;
-    std::atomic<size_t> unpause_count = 0;
-    std::atomic<size_t> lifo_count = 0;
-#endif
+    using Counter = std::atomic<size_t>;
+
+    Counter steal_count = 0;
+    Counter remote_steal_count = 0;
+    Counter steal_distance[SchedulerSnapshot::STEAL_BUCKETS] = {};
+    Counter pause_count = 0;
+    Counter pause_ticks = 0;
+    Counter mute_count = 0;
+    Counter unmute_count = 0;
+    Counter migrate_count = 0;
+    Counter home_count = 0;
+    Counter ld_count = 0;
+    Counter ld_ticks = 0;
+    Counter behaviour_count = 0;
+    Counter message_count = 0;
+    Counter scan_message_count = 0;
+    Counter batch_count[SchedulerSnapshot::BATCH_BUCKETS] = {};
+
+    // Written by other threads than the one of this core.
+    alignas(64) Counter unpause_count = 0;
+    Counter lifo_count = 0;
+
+    /// Increment a counter only this core writes.
+    static void bump(Counter& c, size_t n = 1)
+    {
+      c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static size_t read(const Counter& c)
+    {
+      return c.load(std::memory_order_relaxed);
+    }
 
   public:
     ~SchedulerStats()
 #ifdef USE_SCHED_STATS
     {
+      // The sum over the cores is printed once, when the process exits.
+      struct Total
+      {
+        SchedulerSnapshot sum;
+
+        ~Total()
+        {
+          print(std::cout, sum);
+        }
+      };
       static snmalloc::FlagWord lock;
-      static SchedulerStats global;
+      static Total global;
 
-      if (this != &global)
-      {
-        FlagLock f(lock);
-        global.add(*this);
-      }
-      else
-      {
-        print(std::cout);
-      }
+      SchedulerSnapshot s;
+      snapshot(s);
+      FlagLock f(lock);
+      global.sum.add(s);
     }
 #else
       = default;
 #endif
 
-    void steal()
+    /// A cown stolen from the victim of rank `distance`.
+    void steal(size_t distance)
     {
-#ifdef USE_SCHED_STATS
-      steal_count++;
-#endif
+      bump(steal_count);
+      bump(steal_distance[SchedulerSnapshot::bucket(
+        distance, SchedulerSnapshot::STEAL_BUCKETS)]);
     }
 
-    void pause()
+    void remote_steal()
     {
-#ifdef USE_SCHED_STATS
-      pause_count++;
-#endif
+      bump(remote_steal_count);
+    }
+
+    /// A pause of the scheduler thread that lasted `ticks`.
+    void pause(uint64_t ticks)
+    {
+      bump(pause_count);
+      bump(pause_ticks, ticks);
     }
 
     void unpause()
     {
-#ifdef USE_SCHED_STATS
-      unpause_count++;
-#endif
+      unpause_count.fetch_add(1, std::memory_order_relaxed);
     }
 
     void lifo()
     {
-#ifdef USE_SCHED_STATS
-      lifo_count++;
-#endif
+      lifo_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void mute()
+    {
+      bump(mute_count);
     }
 
-    void add(SchedulerStats& that)
+    void unmute()
     {
-      UNUSED(that);
+      bump(unmute_count);
+    }
 
-#ifdef USE_SCHED_STATS
-      steal_count += that.steal_count;
-      pause_count += that.pause_count;
-      unpause_count += that.unpause_count;
-      lifo_count += that.lifo_count;
-#endif
+    void migrate()
+    {
+      bump(migrate_count);
+    }
+
+    void home()
+    {
+      bump(home_count);
     }
 
-    void print(std::ostream& o, uint64_t dumpid = 0)
+    /// A run of the leak detector that this thread took part in for `ticks`.
+    void ld(uint64_t ticks)
+    {
+      bump(ld_count);
+      bump(ld_ticks, ticks);
+    }
+
+    void behaviour()
+    {
+      bump(behaviour_count);
+    }
+
+    /// A message processed, on the slow path of the leak detector if `scan`.
+    void message(bool scan)
+    {
+      bump(message_count);
+      if (scan)
+        bump(scan_message_count);
+    }
+
+    /// A batch of `size` messages processed by a cown.
+    void batch(size_t size)
+    {
+      bump(batch_count[SchedulerSnapshot::bucket(
+        size, SchedulerSnapshot::BATCH_BUCKETS)]);
+    }
+
+    /**
+     * Copy the counters into `s`. Each counter is read atomically, but not
+     * all of them at the same instant.
+     */
+    void snapshot(SchedulerSnapshot& s) const
+    {
+      s.behaviours = read(behaviour_count);
+      s.messages = read(message_count);
+      s.scan_messages = read(scan_message_count);
+      for (size_t i = 0; i < SchedulerSnapshot::BATCH_BUCKETS; i++)
+        s.batches[i] = read(batch_count[i]);
+      s.steals = read(steal_count);
+      s.remote_steals = read(remote_steal_count);
+      for (size_t i = 0; i < SchedulerSnapshot::STEAL_BUCKETS; i++)
+        s.steal_distances[i] = read(steal_distance[i]);
+      s.lifo = read(lifo_count);
+      s.pauses = read(pause_count);
+      s.pause_ticks = read(pause_ticks);
+      s.unpauses = read(unpause_count);
+      s.mutes = read(mute_count);
+      s.unmutes = read(unmute_count);
+      s.migrates = read(migrate_count);
+      s.homes = read(home_count);
+      s.ld_cycles = read(ld_count);
+      s.ld_ticks = read(ld_ticks);
+    }
+
+    static void print(std::ostream& o, const SchedulerSnapshot& s)
     {
       UNUSED(o);
-      UNUSED(dumpid);
+      UNUSED(s);
 
 #ifdef USE_SCHED_STATS
       CSVStream csv(&o);
 
-      if (dumpid == 0)
-      {
-        // Output headers for initial dump
-        // Keep in sync with data dump
-        csv << "SchedulerStats"
-            << "DumpID"
-            << "Steal"
-            << "LIFO"
-            << "Pause"
-            << "Unpause" << csv.endl;
-      }
-
-      csv << "SchedulerStats" << dumpid << steal_count << lifo_count
-          << pause_count << unpause_count << csv.endl;
+      // Keep in sync with data dump
+      csv << "SchedulerStats"
+          << "Steal"
+          << "RemoteSteal"
+          << "LIFO"
+          << "Pause"
+          << "PauseTicks"
+          << "Unpause"
+          << "Mute"
+          << "Unmute"
+          << "Migrate"
+          << "Home"
+          << "LD"
+          << "LDTicks"
+          << "Behaviours"
+          << "Messages"
+          << "ScanMessages" << csv.endl;
+
+      csv << "SchedulerStats" << s.steals << s.remote_steals << s.lifo
+          << s.pauses << s.pause_ticks << s.unpauses << s.mutes << s.unmutes
+          << s.migrates << s.homes << s.ld_cycles << s.ld_ticks
+          << s.behaviours << s.messages << s.scan_messages << csv.endl;
 #endif
     }
   };
@@ -3,19 +3,35 @@
 #pragma once
 
 #include "core.h"
+#ifdef USE_COWN_PROFILER
+#  include "cownprofiler.h"
+#endif
 #include "ds/dllist.h"
+#include "eventtrace.h"
+#ifdef USE_PERF_COUNTERS
+#  include "perfcounters.h"
+#endif
 #include "ds/hashmap.h"
 #include "ds/mpscq.h"
+#include "ds/stack.h"
 #include "mpmcq.h"
 #include "object/object.h"
+#include "region/immutable.h"
+#include "region/scratch_arena.h"
 #include "schedulerlist.h"
 #include "schedulerstats.h"
+#include "task.h"
 #include "threadpool.h"
+#include "timerwheel.h"
 
+#include <chrono>
 #include <snmalloc/snmalloc.h>
+#include <thread>
 
 namespace verona::rt
 {
+  class BaseNoticeboard;
+
   /**
    * There is typically one scheduler thread pinned to each physical CPU core.
    * Each scheduler thread is responsible for running cowns in its queue and
@@ -42,23 +58,71 @@ namespace verona::rt
     friend T;
     friend DLList<SchedulerThread<T>>;
     friend SchedulerList<SchedulerThread<T>>;
+#ifdef USE_SYSTEM_MONITOR
+    friend SysMonitor<Scheduler>;
+#endif
 
     template<typename Owner>
     friend class Noticeboard;
 
     static constexpr uint64_t TSC_QUIESCENCE_TIMEOUT = 1'000'000;
 
+    /// Maximum nesting of behaviours run inline by `Cown::run_inline`. This
+    /// bounds the stack use of inline execution.
+    static constexpr size_t INLINE_DEPTH_LIMIT = 8;
+
+    /// Maximum number of behaviours run inline, before the scheduler thread
+    /// returns to its queue. This bounds the unfairness of inline execution.
+    static constexpr size_t INLINE_BUDGET = 100;
+
+    /// Maximum number of consecutive cowns taken from `run_next`, before the
+    /// next cown is taken from the queue. This bounds the unfairness of the
+    /// slot, as cowns that wake each other could otherwise keep it forever.
+    static constexpr size_t RUN_NEXT_LIMIT = 16;
+
+    /// Maximum number of consecutive cowns taken from the high priority
+    /// queue, before a normal priority cown is run. This prevents starvation
+    /// of the normal priority cowns.
+    static constexpr size_t HIGH_PRIORITY_BURST = 8;
+
+#ifdef USE_RUN_RING
+    /// Maximum number of consecutive cowns taken from the ring of this core,
+    /// before `q` and its token are consulted.
+    static constexpr size_t RING_BURST = 16;
+#endif
+
+    /// Maximum number of consecutive tasks run by the scheduler loop, before
+    /// the next cown is taken from the queue. See `run_task`.
+    static constexpr size_t TASK_BURST = 16;
+
+    /// Number of cowns taken from the queues of this core, before the cowns
+    /// injected by external threads are taken even if the queues are not
+    /// empty. See `take_injected`.
+    static constexpr size_t INJECT_INTERVAL = 32;
+
+    /// Maximum number of injected cowns taken from this core at once.
+    static constexpr size_t INJECT_BATCH = 64;
+
+    /// A cown is woken up on this core rather than its home core, if the home
+    /// core has this many more cowns waiting.
+    static constexpr size_t HOME_CORE_SLACK = 8;
+
+    /// Number of the nearest cores considered by `reader_core`.
+    static constexpr size_t READER_CORES = 4;
+
     Core<T>* core = nullptr;
 #ifdef USE_SYSTEMATIC_TESTING
     friend class ThreadSyncSystematic<SchedulerThread>;
     Systematic::Local* local_systematic{nullptr};
 #else
     friend class ThreadSync<SchedulerThread>;
-    LocalSync local_sync{};
+    LocalSync<SchedulerThread> local_sync{};
 #endif
 
     Alloc* alloc = nullptr;
     Core<T>* victim = nullptr;
+    /// Index of `victim` in `core->victims`.
+    size_t victim_index = 0;
 
     bool running = true;
 
@@ -66,10 +130,33 @@ namespace verona::rt
     // process before reaching its LD checkpoint (`n_ld_tokens == 0`).
     uint8_t n_ld_tokens = 0;
 
+    /// As `n_ld_tokens`, for the stub of `Core::q_pinned`. Pinned cowns stay
+    /// in their queue during the leak detector, as they cannot be moved to
+    /// `q` where they could be stolen.
+    uint8_t n_pinned_tokens = 0;
+
+    /// Set while the cowns of `core` are being rescheduled for the leak
+    /// detector, a batch at a time. The LD checkpoint is counted from the end
+    /// of the scan.
+    bool scan_pending = false;
+
+    /// Tick at which this thread last left `NotInLD`.
+    uint64_t ld_start = 0;
+
     bool should_steal_for_fairness = false;
 
+    /// Times the token of the core has been reached since the last steal for
+    /// fairness, see `ThreadPool::set_fair_policy`.
+    size_t fair_tokens = 0;
+
+    /// Tick of the last steal for fairness.
+    uint64_t last_fair_steal = 0;
+
     std::atomic<bool> scheduled_unscanned_cown = false;
 
+    /// Messages sent and received while the epoch is `EPOCH_NONE`.
+    InflightCounter inflight;
+
     EpochMark send_epoch = EpochMark::EPOCH_A;
     EpochMark prev_epoch = EpochMark::EPOCH_B;
 
@@ -78,6 +165,84 @@ namespace verona::rt
     /// The MessageBody of a running behaviour.
     typename T::MessageBody* message_body = nullptr;
 
+    /// An overloaded cown that the running behaviour has sent a message to.
+    T* mute_target = nullptr;
+
+    /// Cowns muted by this scheduler thread. Each muted cown is pushed
+    /// immediately after the overloaded cown that caused it to be muted.
+    StackThin<T, Alloc> mute_set;
+
+    /// Current nesting of behaviours run inline.
+    size_t inline_depth = 0;
+
+    /// Remaining behaviours that may be run inline before the next cown is
+    /// taken from the queue.
+    size_t inline_budget = INLINE_BUDGET;
+
+    /// A cown woken by a behaviour on this thread, to be run as soon as the
+    /// current cown has run, without going through the queue of the core. See
+    /// `schedule_next`.
+    T* run_next = nullptr;
+
+    /// Number of consecutive cowns taken from `run_next`.
+    size_t run_next_count = 0;
+
+    /// Number of consecutive cowns taken from a high priority queue.
+    size_t high_priority_run = 0;
+
+    /// Number of cowns taken from the queues of this core since its injected
+    /// cowns were last taken.
+    size_t inject_run = 0;
+
+    /// Number of consecutive tasks run by the scheduler loop.
+    size_t task_run = 0;
+
+    /// Set if the last cown taken from the queues of this core was pinned to
+    /// it, so that pinned and other cowns take turns, see `dequeue_pinned`.
+    bool pinned_turn = false;
+
+#ifdef USE_RUN_RING
+    /// Number of consecutive cowns taken from the ring of this core.
+    size_t ring_run = 0;
+#endif
+
+    /// Scratch memory of the running behaviour, see `scratch::alloc`. It is
+    /// reset once the outermost behaviour on this thread completes.
+    ScratchArena scratch;
+
+    /// Noticeboards with a value staged by the running behaviour, published
+    /// once it completes. See `Noticeboard::stage`.
+    BaseNoticeboard* staged_noticeboards = nullptr;
+
+    /// Timers added on this thread, in milliseconds of the steady clock. See
+    /// `schedule_lambda_after`.
+    TimerWheel timers;
+
+    /// Set while a batch of behaviours is scheduled by `Cown::schedule_many`.
+    /// Unpausing is then deferred to the end of the batch.
+    bool defer_unpause = false;
+
+    /// The core that a cown was last scheduled on while unpausing was
+    /// deferred, or nullptr if no unpause is pending.
+    Core<T>* deferred_unpause = nullptr;
+
+#ifdef USE_SYSTEM_MONITOR
+    /// Number of cowns run by this thread, sampled by the system monitor.
+    std::atomic<size_t> batches{0};
+
+    /// Set while this thread is running a cown.
+    std::atomic<bool> busy{false};
+
+    /// For a helper thread, the stuck thread that it was started for.
+    std::atomic<SchedulerThread*> helping_for{nullptr};
+
+    /// Set by the system monitor once the stuck thread has made progress.
+    std::atomic<bool> leave_requested{false};
+
+    /// Set once this helper has been removed from the pool.
+    bool leaving = false;
+#endif
+
     /// SchedulerList pointers.
     SchedulerThread<T>* prev = nullptr;
     SchedulerThread<T>* next = nullptr;
@@ -101,42 +266,485 @@ namespace verona::rt
       this->core = core;
     }
 
+    /// Returns true if other cowns are waiting to run on this core.
+    bool has_waiting_work()
+    {
+      return !core->nothing_old();
+    }
+
+    /// The queue of core `c` that `a` should be scheduled on. While the leak
+    /// detector is running, every cown that is not pinned is scheduled with
+    /// normal priority, so that the high priority queue drains and cannot
+    /// hold back the protocol.
+    MPMCQ<T>& queue_for(Core<T>* c, T* a)
+    {
+      if (in_ld() && !a->is_pinned())
+        return c->q;
+      return c->queue_for(a);
+    }
+
+    /**
+     * The core that `a` should be scheduled on. This is the core that last ran
+     * it, unless that core is much busier than this one. Cowns are only
+     * scheduled on this core while the leak detector is running. A pinned
+     * cown is always scheduled on its core.
+     **/
+    Core<T>* wakeup_core(T* a)
+    {
+      Core<T>* home = a->get_home_core();
+      if (a->is_pinned())
+        return home;
+
+      if (
+        (home == nullptr) || (home == core) ||
+        home->retired.load(std::memory_order_relaxed) || in_ld() ||
+        Scheduler::should_scan() || Scheduler::in_prescan())
+        return core;
+
+      if (
+        home->queued.load(std::memory_order_relaxed) >
+        core->queued.load(std::memory_order_relaxed) + HOME_CORE_SLACK)
+        return core;
+
+      return home;
+    }
+
+    /**
+     * Take a cown from the queues of `c`. The high priority queue is
+     * consulted first, unless it has been used for the last
+     * `HIGH_PRIORITY_BURST` cowns.
+     **/
+    T* dequeue(Core<T>* c)
+    {
+      // Checking for an empty queue is cheaper than a dequeue, and the high
+      // priority queue is usually empty.
+      T* cown = nullptr;
+      bool high = !c->q_high.nothing_old();
+      if (high && (high_priority_run < HIGH_PRIORITY_BURST))
+        cown = c->q_high.dequeue(*alloc);
+
+      if (cown != nullptr)
+      {
+        high_priority_run++;
+      }
+      else
+      {
+        high_priority_run = 0;
+        if ((c == core) && (++inject_run >= INJECT_INTERVAL))
+          cown = take_injected(c);
+        if ((cown == nullptr) && (c == core))
+          cown = dequeue_pinned();
+#ifdef USE_RUN_RING
+        if (cown == nullptr)
+          cown = dequeue_ring(c);
+#endif
+        if (cown == nullptr)
+          cown = c->q.dequeue(*alloc);
+        if ((cown == nullptr) && high)
+          cown = c->q_high.dequeue(*alloc);
+        if (cown == nullptr)
+          cown = take_injected(c);
+      }
+
+      // Tokens are not counted.
+      if ((cown != nullptr) && !has_thread_bit(cown))
+        c->queued.fetch_sub(1, std::memory_order_relaxed);
+      return cown;
+    }
+
+    /**
+     * Take a cown pinned to this core, see `Cown::pin`. While other cowns are
+     * waiting in `q`, this only takes one on every other call, so that
+     * neither kind of cown holds back the other.
+     **/
+    T* dequeue_pinned()
+    {
+      if (core->q_pinned.nothing_old())
+        return nullptr;
+
+      pinned_turn = !pinned_turn;
+      if (!pinned_turn && !core->q.nothing_old())
+        return nullptr;
+
+      return core->q_pinned.dequeue(*alloc);
+    }
+
+    /**
+     * Take a cown injected by external threads on `c`, see `Injector`.
+     *
+     * From this core, up to `INJECT_BATCH` cowns are taken at once. The first
+     * is returned, and the rest are moved to the queue of this core, where
+     * they are already counted in `queued`. A single cown is taken from other
+     * cores, and during the leak detector, as in `steal_from`.
+     **/
+    T* take_injected(Core<T>* c)
+    {
+      if (c == core)
+        inject_run = 0;
+
+      if (c->injectors.load(std::memory_order_relaxed) == nullptr)
+        return nullptr;
+
+      size_t max = INJECT_BATCH;
+      if (
+        (c != core) || in_ld() || Scheduler::should_scan() ||
+        Scheduler::in_prescan())
+        max = 1;
+
+      T* cown = nullptr;
+      T* rest = nullptr;
+      T* last = nullptr;
+      size_t count = Injector<T>::take(c, max, [&](T* n) {
+        if (cown == nullptr)
+          cown = n;
+        else if (rest == nullptr)
+          rest = n;
+        else
+          last->next_in_queue.store(n, std::memory_order_relaxed);
+
+        if (n != cown)
+          last = n;
+      });
+
+      if (rest != nullptr)
+      {
+        c->q.enqueue_segment(*alloc, rest, last);
+        Logging::cout() << "Moved " << count - 1 << " injected cowns"
+                        << Logging::endl;
+      }
+      return cown;
+    }
+
+#ifdef USE_RUN_RING
+    /**
+     * Take a cown from the ring of `c`, unless this thread has taken the last
+     * `RING_BURST` cowns of its own core from it.
+     **/
+    T* dequeue_ring(Core<T>* c)
+    {
+      if (c != core)
+        return c->ring.pop();
+
+      if (ring_run >= RING_BURST)
+      {
+        ring_run = 0;
+        return nullptr;
+      }
+
+      T* cown = core->ring.pop();
+      ring_run = (cown == nullptr) ? 0 : ring_run + 1;
+      return cown;
+    }
+#endif
+
+    /**
+     * Steal from `victim`. Up to half of the cowns waiting on the victim,
+     * bounded by `ThreadPool::set_steal_batch`, are taken from its queue in
+     * one go. The first is returned to be run, and the rest are moved to the
+     * queue of this core.
+     *
+     * A single cown is stolen from the high priority queue, and during the
+     * leak detector, where moving cowns would bypass the tracking of
+     * unscanned cowns in `schedule_fifo`.
+     **/
+    T* steal_from(Core<T>* victim)
+    {
+      size_t max = victim->queued.load(std::memory_order_relaxed) / 2;
+      max = std::min(max, Scheduler::get().steal_batch);
+      if (
+        (max < 2) || in_ld() || Scheduler::should_scan() ||
+        Scheduler::in_prescan() || !victim->q_high.nothing_old())
+        return dequeue(victim);
+
+      T* rest;
+      T* last;
+      size_t count;
+      T* cown = victim->q.dequeue_segment(*alloc, max, rest, last, count);
+      if (cown == nullptr)
+        return dequeue(victim);
+
+      high_priority_run = 0;
+      if (count > 1)
+      {
+        core->queued.fetch_add(count - 1, std::memory_order_relaxed);
+        core->q.enqueue_segment(*alloc, rest, last);
+        Logging::cout() << "Moved " << count - 1 << " stolen cowns from "
+                        << victim->affinity << Logging::endl;
+      }
+      victim->queued.fetch_sub(count, std::memory_order_relaxed);
+      return cown;
+    }
+
     inline void stop()
     {
       running = false;
     }
 
     inline void schedule_fifo(T* a)
+    {
+      Core<T>* target = wakeup_core(a);
+      if (target != core)
+        core->stats.home();
+      schedule_fifo(a, target);
+    }
+
+    /**
+     * Schedule `a`, a cown that a behaviour on this thread has just made
+     * runnable, to run on this thread once the current cown has run. The
+     * cown previously in the slot, if any, is moved to the queue.
+     *
+     * The slot is a cheaper `schedule_fifo`: the cown does not go through the
+     * queue of the core, and is run while the state it shares with the
+     * current behaviour is still in this thread's cache. It is only used for
+     * cowns that would be scheduled on this core anyway, and not while the
+     * leak detector is running, as the slot is invisible to it.
+     **/
+    void schedule_next(T* a)
+    {
+      if (
+        in_ld() || Scheduler::should_scan() || Scheduler::in_prescan() ||
+        a->is_high_priority() ||
+        (Scheduler::has_leak_detector && !a->scanned(send_epoch)) ||
+        (wakeup_core(a) != core))
+      {
+        schedule_fifo(a);
+        return;
+      }
+
+      Logging::cout() << "Schedule cown " << a << " to run next"
+                      << Logging::endl;
+      assert(!a->queue.is_sleeping());
+      if (run_next != nullptr)
+        schedule_fifo(run_next);
+      run_next = a;
+      core->stats.lifo();
+    }
+
+    /**
+     * Take the cown in `run_next`, if any. After `RUN_NEXT_LIMIT`
+     * consecutive cowns from the slot, the cown is moved to the queue
+     * instead, so that the queue is not starved.
+     **/
+    T* take_run_next()
+    {
+      T* cown = run_next;
+      if (cown == nullptr)
+        return nullptr;
+
+      run_next = nullptr;
+      if (++run_next_count > RUN_NEXT_LIMIT)
+      {
+        run_next_count = 0;
+        schedule_fifo(cown);
+        return nullptr;
+      }
+      return cown;
+    }
+
+    /**
+     * The core that `a`, a cown whose readers are about to run on this
+     * thread, should be rescheduled on, so that another scheduler thread can
+     * carry on with its queue and run further readers in parallel. This is
+     * the least loaded of the nearest cores on this NUMA node, unless it is
+     * much busier than this one.
+     **/
+    Core<T>* reader_core()
+    {
+      if (in_ld() || Scheduler::should_scan() || Scheduler::in_prescan())
+        return core;
+
+      size_t limit = core->victims.size();
+      if (core->first_remote != 0)
+        limit = core->first_remote;
+      limit = std::min(limit, READER_CORES);
+
+      Core<T>* target = core;
+      size_t least = core->queued.load(std::memory_order_relaxed) +
+        HOME_CORE_SLACK;
+      for (size_t i = 0; i < limit; i++)
+      {
+        Core<T>* c = core->victims[i];
+        if (c->retired.load(std::memory_order_relaxed))
+          continue;
+
+        size_t queued = c->queued.load(std::memory_order_relaxed);
+        if (queued <= least)
+        {
+          target = c;
+          least = queued;
+        }
+      }
+      return target;
+    }
+
+    /**
+     * Schedule `a`, whose readers are about to run on this thread, see
+     * `reader_core`.
+     **/
+    void schedule_reader(T* a)
+    {
+      if (a->is_pinned())
+        schedule_fifo(a);
+      else
+        schedule_fifo(a, reader_core());
+    }
+
+    /**
+     * Schedule `a` on the queue of `target`, from this thread.
+     **/
+    void schedule_fifo(T* a, Core<T>* target)
     {
       Logging::cout() << "Enqueue cown " << a << " (" << a->get_epoch_mark()
                       << ")" << Logging::endl;
 
       // Scheduling on this thread, from this thread.
-      if (!a->scanned(send_epoch))
+      if (Scheduler::has_leak_detector && !a->scanned(send_epoch))
       {
         Logging::cout() << "Enqueue unscanned cown " << a << Logging::endl;
         scheduled_unscanned_cown = true;
       }
       assert(!a->queue.is_sleeping());
-      core->q.enqueue(*alloc, a);
+      target->queued.fetch_add(1, std::memory_order_relaxed);
+#ifdef USE_RUN_RING
+      // The ring is not used while the leak detector is running, so that it
+      // drains before the LD checkpoint. Only the thread of the core may push
+      // to it, not a helper started by the system monitor. Other threads may
+      // take from it, so pinned cowns do not use it.
+      if (
+        (target != core) || in_ld() || a->is_high_priority() ||
+        a->is_pinned() || is_helper() || !core->ring.push(a))
+#endif
+        queue_for(target, a).enqueue(*alloc, a);
+
+      if (defer_unpause)
+      {
+        deferred_unpause = target;
+        return;
+      }
+
+      if (Scheduler::get().unpause(target))
+        core->stats.unpause();
+    }
+
+    /**
+     * Defer the unpause of `schedule_fifo` until `exit_batch`. Returns
+     * whether unpausing was already deferred, to be passed to `exit_batch`.
+     */
+    bool enter_batch()
+    {
+      bool prev = defer_unpause;
+      defer_unpause = true;
+      return prev;
+    }
+
+    void exit_batch(bool prev)
+    {
+      if (prev)
+        return;
 
-      if (Scheduler::get().unpause())
+      defer_unpause = false;
+      if (deferred_unpause == nullptr)
+        return;
+
+      Core<T>* target = deferred_unpause;
+      deferred_unpause = nullptr;
+      if (Scheduler::get().unpause(target))
+        core->stats.unpause();
+    }
+
+    /**
+     * Add `t` to the task ring of this core, see `Task`. Returns false if
+     * the ring is full, or this is a helper thread, which may not push to it.
+     */
+    bool add_task(Task* t)
+    {
+      if (is_helper() || !core->tasks.push(t))
+        return false;
+
+      if (defer_unpause)
+        deferred_unpause = core;
+      else if (Scheduler::get().unpause(core))
         core->stats.unpause();
+      return true;
+    }
+
+    /**
+     * Run a task from the task ring of `c`. Returns false if there was none.
+     */
+    bool run_task(Core<T>* c)
+    {
+      Task* t = c->tasks.pop();
+      if (t == nullptr)
+        return false;
+
+      core->progress_counter++;
+#ifdef USE_SYSTEM_MONITOR
+      busy.store(true, std::memory_order_relaxed);
+#endif
+      t->run(t);
+#ifdef USE_SYSTEM_MONITOR
+      batches.fetch_add(1, std::memory_order_relaxed);
+      busy.store(false, std::memory_order_relaxed);
+#endif
+      return true;
+    }
+
+    /**
+     * Schedule `a` from a thread that is not a scheduler thread, through the
+     * injector of that thread, see `Injector`. A cown with high priority, a
+     * pinned cown, or one that does not fit in a full injector under
+     * `InjectPolicy::Overflow`, is scheduled with `schedule_lifo` instead.
+     */
+    static void inject(T* a)
+    {
+      Injector<T>* i = Scheduler::injector();
+      if ((i == nullptr) || a->is_high_priority() || a->is_pinned())
+      {
+        schedule_lifo(Scheduler::round_robin(), a);
+        return;
+      }
+
+      // Counted before it can be taken, so that `queued` cannot underflow.
+      Core<T>* c = i->core;
+      c->queued.fetch_add(1, std::memory_order_relaxed);
+
+      bool pushed = i->push(a);
+      while (!pushed && Scheduler::inject_should_block())
+      {
+        std::this_thread::yield();
+        pushed = i->push(a);
+      }
+
+      if (!pushed)
+      {
+        c->queued.fetch_sub(1, std::memory_order_relaxed);
+        schedule_lifo(c, a);
+        return;
+      }
+
+      Logging::cout() << "Injected cown " << a << " onto " << c->affinity
+                      << Logging::endl;
+
+      if (Scheduler::get().unpause(c))
+        c->stats.unpause();
     }
 
     static inline void schedule_lifo(Core<T>* c, T* a)
     {
       // A lifo scheduled cown is coming from an external source, such as
       // asynchronous I/O.
+      if (a->is_pinned())
+        c = a->get_home_core();
       Logging::cout() << "LIFO scheduling cown " << a << " onto " << c->affinity
                       << Logging::endl;
-      c->q.enqueue_front(ThreadAlloc::get(), a);
+      c->queued.fetch_add(1, std::memory_order_relaxed);
+      c->queue_for(a).enqueue_front(ThreadAlloc::get(), a);
       Logging::cout() << "LIFO scheduled cown " << a << " onto " << c->affinity
                       << Logging::endl;
 
       c->stats.lifo();
 
-      if (Scheduler::get().unpause())
+      if (Scheduler::get().unpause(c))
         c->stats.unpause();
     }
 
@@ -159,8 +767,10 @@ namespace verona::rt
 
       Scheduler::local() = this;
       alloc = &ThreadAlloc::get();
+      RegionArena::enable_arena_cache();
+      StackBlockCache::enable();
       assert(core != nullptr);
-      victim = core->next;
+      reset_victim();
       T* cown = nullptr;
       core->servicing_threads++;
 
@@ -170,6 +780,13 @@ namespace verona::rt
 
       while (true)
       {
+#ifdef USE_SYSTEM_MONITOR
+        if (
+          (cown == nullptr) &&
+          leave_requested.load(std::memory_order_relaxed) && try_leave())
+          break;
+#endif
+
         if (
           (core->total_cowns < (core->free_cowns << 1))
 #ifdef USE_SYSTEMATIC_TESTING
@@ -178,18 +795,40 @@ namespace verona::rt
         )
           collect_cown_stubs();
 
+        if (fair_period_elapsed())
+          should_steal_for_fairness = true;
+
         if (should_steal_for_fairness)
         {
           if (cown == nullptr)
           {
             should_steal_for_fairness = false;
+            last_fair_steal = Aal::tick();
             fast_steal(cown);
           }
         }
 
+        // Muted cowns are not scanned, so they are all released while the
+        // leak detector is running.
+        if (!mute_set.empty())
+          unmute(in_ld());
+
+        fire_timers();
+
+        if ((cown == nullptr) && (task_run < TASK_BURST) && run_task(core))
+        {
+          task_run++;
+          continue;
+        }
+        task_run = 0;
+
+        if (cown == nullptr)
+          cown = take_run_next();
+
         if (cown == nullptr)
         {
-          cown = core->q.dequeue(*alloc);
+          run_next_count = 0;
+          cown = dequeue(core);
           if (cown != nullptr)
             Logging::cout()
               << "Pop cown " << clear_thread_bit(cown) << Logging::endl;
@@ -243,11 +882,37 @@ namespace verona::rt
           core->progress_counter++;
         core->last_worker = systematic_id;
 
+        if (cown->move_home_core(core))
+          core->stats.migrate();
+
+        inline_budget = INLINE_BUDGET;
+#ifdef USE_PERF_COUNTERS
+        PerfCounts batch_start;
+        bool sampled = PerfStats::start_batch(batch_start);
+#endif
+#ifdef USE_SYSTEM_MONITOR
+        busy.store(true, std::memory_order_relaxed);
+#endif
         bool reschedule = cown->run(*alloc, state);
+#ifdef USE_SYSTEM_MONITOR
+        batches.fetch_add(1, std::memory_order_relaxed);
+        busy.store(false, std::memory_order_relaxed);
+#endif
+#ifdef USE_PERF_COUNTERS
+        if (SNMALLOC_UNLIKELY(sampled))
+          PerfStats::end_batch(batch_start);
+#endif
+
+        // Biased references must not outlive the behaviours that took them.
+        Immutable::flush_biased(*alloc);
 
         if (reschedule)
         {
-          if (should_steal_for_fairness)
+          // A cown pinned while it was waiting on another core goes back to
+          // its own core.
+          if (
+            should_steal_for_fairness ||
+            (cown->is_pinned() && (cown->get_home_core() != core)))
           {
             schedule_fifo(cown);
             cown = nullptr;
@@ -259,7 +924,12 @@ namespace verona::rt
             // otherwise run this cown again. Don't push to the queue
             // immediately to avoid another thread stealing our only cown.
 
-            T* n = core->q.dequeue(*alloc);
+            T* n = take_run_next();
+            if (n == nullptr)
+            {
+              run_next_count = 0;
+              n = dequeue(core);
+            }
 
             if (n != nullptr)
             {
@@ -268,7 +938,7 @@ namespace verona::rt
             }
             else
             {
-              if (core->q.nothing_old())
+              if (core->nothing_old())
               {
                 Logging::cout() << "Queue empty" << Logging::endl;
                 // We have effectively reached token cown.
@@ -300,13 +970,26 @@ namespace verona::rt
         yield();
       }
 
+      assert(run_next == nullptr);
+#ifdef USE_SYSTEM_MONITOR
+      if (leaving)
+      {
+        leave();
+        return;
+      }
+#endif
       Logging::cout() << "Begin teardown (phase 1)" << Logging::endl;
 
-      if (core != nullptr)
+      // A helper leaves the cowns of its core to the thread of the core.
+      if ((core != nullptr) && !is_helper())
       {
         core->collect(*alloc);
       }
 
+      scratch.flush(*alloc);
+      RegionArena::flush_arena_cache(*alloc);
+      StackBlockCache::flush(*alloc);
+
       Logging::cout() << "End teardown (phase 1)" << Logging::endl;
 
       Epoch(ThreadAlloc::get()).flush_local();
@@ -327,7 +1010,14 @@ namespace verona::rt
         {
           Logging::cout() << "Destroying core " << core->affinity
                           << Logging::endl;
+#ifdef USE_RUN_RING
+          assert(core->ring.empty());
+#endif
+          assert(Injector<T>::empty(core));
+          assert(core->tasks.empty());
           core->q.destroy(*alloc);
+          core->q_high.destroy(*alloc);
+          core->q_pinned.destroy(*alloc);
         }
       }
       Systematic::finished_thread();
@@ -337,6 +1027,209 @@ namespace verona::rt
       Scheduler::local() = nullptr;
     }
 
+    /// Returns true if this is a helper thread started by the system monitor,
+    /// which shares its core with the thread of that core.
+    bool is_helper()
+    {
+#ifdef USE_SYSTEM_MONITOR
+      return helping_for.load(std::memory_order_relaxed) != nullptr;
+#else
+      return false;
+#endif
+    }
+
+    /**
+     * Add the cowns from `head` to `tail`, which are owned by the core of
+     * this thread, to the list of the core. Only the scheduler thread of the
+     * core edits that list, so a helper sharing the core leaves them in
+     * `pending` for it.
+     */
+    void bind_cowns(T* head, T* tail, size_t count)
+    {
+      if (is_helper())
+        core->add_pending(head, tail);
+      else
+        core->add_cowns(head, tail);
+      core->total_cowns += count;
+    }
+
+#ifdef USE_SYSTEM_MONITOR
+    /**
+     * If this is a helper thread holding no work of its own, remove it from
+     * the pool. Returns true if it has been removed, after which it must
+     * `leave` without running anything else.
+     */
+    bool try_leave()
+    {
+      if (
+        (helping_for.load(std::memory_order_relaxed) == nullptr) ||
+        !mute_set.empty() || !timers.empty() || (run_next != nullptr) ||
+        in_ld())
+        return false;
+
+      leaving = Scheduler::get().remove_helper(this);
+      return leaving;
+    }
+
+    /**
+     * Leave the pool, once removed from it by `try_leave`. Unlike teardown,
+     * the cowns and queues of the core stay with its other threads.
+     */
+    void leave()
+    {
+      Logging::cout() << "Helper thread leaving core " << core->affinity
+                      << Logging::endl;
+
+      scratch.flush(*alloc);
+      RegionArena::flush_arena_cache(*alloc);
+      StackBlockCache::flush(*alloc);
+      Epoch(ThreadAlloc::get()).flush_local();
+
+      auto val = core->servicing_threads.fetch_sub(1);
+      assert(val > 1);
+      UNUSED(val);
+
+      leaving = false;
+      leave_requested.store(false, std::memory_order_relaxed);
+      Scheduler::local() = nullptr;
+
+      // The monitor may borrow this thread again once it is free.
+      helping_for.store(nullptr, std::memory_order_release);
+      Scheduler::get().threads.move_active_to_free(this);
+    }
+#endif
+
+    /**
+     * Record that the running behaviour has sent a message to the overloaded
+     * cown `receiver`.  Only the first overloaded cown is recorded, and
+     * nothing is muted while the leak detector is running.
+     **/
+    void note_overloaded(T* receiver)
+    {
+      if ((message_body == nullptr) || (mute_target != nullptr) || in_ld())
+        return;
+
+      T::acquire(receiver);
+      mute_target = receiver;
+    }
+
+    /**
+     * Returns the overloaded cown recorded for the running behaviour, if any.
+     * The caller takes ownership of the reference count.
+     **/
+    T* take_mute_target()
+    {
+      T* target = mute_target;
+      mute_target = nullptr;
+      return target;
+    }
+
+    /**
+     * Park `cown` off the scheduler queue until `receiver` is no longer
+     * overloaded. The caller must have acquired `cown` for writing, so that it
+     * would otherwise be rescheduled.
+     *
+     * Returns false, if the cown should be rescheduled as normal.
+     **/
+    bool mute(T* cown, T* receiver)
+    {
+      if (
+        (receiver == nullptr) || (cown == receiver) || cown->is_overloaded() ||
+        in_ld())
+        return false;
+
+      // The entry holds a reference to both cowns, as the muted cown can be
+      // unmuted by other threads.
+      T::acquire(receiver);
+      T::acquire(cown);
+      mute_set.push(receiver, *alloc);
+      mute_set.push(cown, *alloc);
+
+      if (!cown->try_mute())
+        return false;
+
+      Logging::cout() << "Mute cown " << cown << " on overloaded " << receiver
+                      << Logging::endl;
+      core->stats.mute();
+      return true;
+    }
+
+    /**
+     * Reschedule the muted cowns whose receiver is no longer overloaded, or
+     * every muted cown if `all` is set.
+     **/
+    void unmute(bool all)
+    {
+      StackThin<T, Alloc> keep;
+
+      while (!mute_set.empty())
+      {
+        T* cown = mute_set.pop(*alloc);
+        T* receiver = mute_set.pop(*alloc);
+
+        if (!all && cown->muted && receiver->is_overloaded())
+        {
+          keep.push(receiver, *alloc);
+          keep.push(cown, *alloc);
+          continue;
+        }
+
+        if (cown->try_unmute())
+        {
+          Logging::cout() << "Unmute cown " << cown << Logging::endl;
+          core->stats.unmute();
+          schedule_fifo(cown);
+        }
+
+        T::release(*alloc, cown);
+        T::release(*alloc, receiver);
+      }
+
+      mute_set = keep;
+    }
+
+    /**
+     * Returns true if a behaviour can be run inline on this thread.
+     *
+     * This is not permitted while the leak detector is running, as the inline
+     * behaviour bypasses the checks performed before running a cown.
+     **/
+    bool can_run_inline()
+    {
+      return Scheduler::get().inline_behaviours &&
+        (inline_depth < INLINE_DEPTH_LIMIT) && (inline_budget > 0) &&
+        !in_ld() && !Scheduler::should_scan() && !Scheduler::in_prescan();
+    }
+
+    /**
+     * State of the enclosing behaviour that is saved while a behaviour is run
+     * inline.
+     **/
+    struct InlineFrame
+    {
+      typename T::MessageBody* message_body;
+      T* mute_target;
+    };
+
+    InlineFrame enter_inline()
+    {
+      assert(can_run_inline());
+      inline_depth++;
+      inline_budget--;
+      InlineFrame frame{message_body, mute_target};
+      message_body = nullptr;
+      mute_target = nullptr;
+      return frame;
+    }
+
+    void exit_inline(InlineFrame frame)
+    {
+      assert(mute_target == nullptr);
+      inline_depth--;
+      message_body = frame.message_body;
+      mute_target = frame.mute_target;
+    }
+
     bool fast_steal(T*& result)
     {
       // auto cur_victim = victim;
@@ -345,7 +1238,7 @@ namespace verona::rt
       // Try to steal from the victim thread.
       if (victim != core)
       {
-        cown = victim->q.dequeue(*alloc);
+        cown = dequeue(victim);
 
         if (cown != nullptr)
         {
@@ -358,11 +1251,46 @@ namespace verona::rt
       }
 
       // We were unable to steal, move to the next victim thread.
-      victim = victim->next;
+      next_victim(false);
 
       return false;
     }
 
+    /**
+     * Start stealing from the nearest core.
+     **/
+    void reset_victim()
+    {
+      victim_index = 0;
+      victim = core->victims.empty() ? core : core->victims[0];
+    }
+
+    /**
+     * Move `victim` to the next core in the order of `Core::victims`. Cores on
+     * remote NUMA nodes are only visited if `remote` is set, or if there are
+     * no other cores on this NUMA node.
+     **/
+    void next_victim(bool remote)
+    {
+      size_t limit = core->victims.size();
+      if (!remote && (core->first_remote != 0))
+        limit = core->first_remote;
+
+      if (limit == 0)
+      {
+        victim = core;
+        return;
+      }
+
+      victim_index = (victim_index + 1) % limit;
+      victim = core->victims[victim_index];
+    }
+
+    bool is_remote_victim()
+    {
+      return (victim != core) && (victim_index >= core->first_remote);
+    }
+
     void dec_n_ld_tokens()
     {
       assert(n_ld_tokens == 1 || n_ld_tokens == 2);
@@ -370,16 +1298,33 @@ namespace verona::rt
       n_ld_tokens--;
     }
 
+    /**
+     * Called when a thread that was woken from a pause has found work on `c`.
+     * Only one thread is woken when work is scheduled, so if there is more
+     * work on `c`, the wake up is passed on to the nearest paused thread.
+     */
+    void pass_on_wake(Core<T>* c)
+    {
+      if (!c->nothing_old() && Scheduler::get().wake_one(c))
+        core->stats.unpause();
+    }
+
     T* steal()
     {
       uint64_t tsc = Aal::tick();
       T* cown;
+      // Set once this thread has been paused and woken again.
+      bool woken = false;
+      reset_victim();
 
       while (running)
       {
         yield();
 
-        if (core->q.nothing_old())
+        if (!mute_set.empty())
+          unmute(in_ld());
+
+        if (core->nothing_old())
         {
           n_ld_tokens = 0;
         }
@@ -387,28 +1332,54 @@ namespace verona::rt
         // Participate in the cown LD protocol.
         ld_protocol();
 
+        fire_timers();
+
         // Check if some other thread has pushed work on our queue.
-        cown = core->q.dequeue(*alloc);
+        cown = dequeue(core);
 
         if (cown != nullptr)
+        {
+          if (woken)
+            pass_on_wake(core);
           return cown;
+        }
+
+        // Tasks pushed since the loop last looked, and those of the victim,
+        // are run here, as `steal` only returns cowns.
+        if (run_task(core) || ((victim != core) && run_task(victim)))
+        {
+          tsc = Aal::tick();
+          continue;
+        }
 
         // Try to steal from the victim thread.
         if (victim != core)
         {
-          cown = victim->q.dequeue(*alloc);
+          cown = steal_from(victim);
 
           if (cown != nullptr)
           {
-            core->stats.steal();
+            if (woken)
+              pass_on_wake(victim);
+            core->stats.steal(victim_index + 1);
+            EventTrace::event(TraceEvent::Steal, victim->affinity);
+            if (is_remote_victim())
+              core->stats.remote_steal();
             Logging::cout() << "Stole cown " << clear_thread_bit(cown)
                             << " from " << victim->affinity << Logging::endl;
             return cown;
           }
         }
 
-        // We were unable to steal, move to the next victim thread.
-        victim = victim->next;
+        // We were unable to steal, move to the next victim thread. Remote
+        // cores are only stolen from once this thread has been looking for
+        // work for a while.
+#ifdef USE_SYSTEMATIC_TESTING
+        next_victim(Systematic::coin());
+#else
+        next_victim(
+          (Aal::tick() - tsc) >= Scheduler::get().remote_steal_delay);
+#endif
 
 #ifdef USE_SYSTEMATIC_TESTING
         // Only try to pause with 1/(2^5) probability
@@ -429,18 +1400,86 @@ namespace verona::rt
 #endif
 
         // Enter sleep only if we aren't executing the leak detector currently.
-        if (state == ThreadState::NotInLD)
+        if (!in_ld())
         {
+          maybe_want_ld(LDTrigger::Idle);
+          if (in_ld())
+            continue;
+
+          // Never pause while holding muted cowns, as nothing would wake this
+          // thread once their receivers have drained.
+          if (!mute_set.empty())
+          {
+            unmute(true);
+            continue;
+          }
+
+          // Dispatch ready external events before pausing, so their
+          // behaviours are scheduled on this core.
+          if (Scheduler::get().poll_events(0))
+            continue;
+
+          // Sleep no later than the next timer is due.
+          auto timeout = std::chrono::milliseconds::max();
+          if (!timers.empty())
+          {
+            uint64_t now = Scheduler::timer_tick();
+            uint64_t due = timers.next_due();
+            if (due <= now)
+              continue;
+            timeout = std::chrono::milliseconds(due - now);
+          }
+
+#ifdef USE_SYSTEM_MONITOR
+          // A helper leaves rather than pausing.
+          if (try_leave())
+            return nullptr;
+#endif
+
           // We've been spinning looking for work for some time. While paused,
           // our running flag may be set to false, in which case we terminate.
-          if (Scheduler::get().pause())
-            core->stats.pause();
+          uint64_t pause_start = Aal::tick();
+          EventTrace::event(TraceEvent::PauseStart);
+          bool paused = Scheduler::get().pause(timeout);
+          EventTrace::event(TraceEvent::PauseEnd);
+          if (paused)
+          {
+            core->stats.pause(Aal::tick() - pause_start);
+            woken = true;
+          }
         }
       }
 
+      assert(mute_set.empty());
       return nullptr;
     }
 
+    void add_timer(Timer* t)
+    {
+      if (timers.empty())
+        timers.reset(Scheduler::timer_tick());
+      timers.add(t);
+      Scheduler::get().pending_timers++;
+    }
+
+    /**
+     * Fire the timers that are due. Each schedules its behaviour, on this
+     * core where it can.
+     */
+    void fire_timers()
+    {
+      if (timers.empty())
+        return;
+
+      size_t fired =
+        timers.advance(Scheduler::timer_tick(), [](Timer* t) { t->fire(t); });
+      if (fired != 0)
+      {
+        Logging::cout() << "Fired " << fired << " timers" << Logging::endl;
+        Scheduler::get().pending_timers -= fired;
+      }
+    }
+
     bool has_thread_bit(T* cown)
     {
       return (uintptr_t)cown & 1;
@@ -451,6 +1490,35 @@ namespace verona::rt
       return (T*)((uintptr_t)cown & ~(uintptr_t)1);
     }
 
+    /**
+     * The token of this core has been reached. Steal for fairness if the
+     * spacing of `ThreadPool::set_fair_policy` has been reached too.
+     */
+    void fair_token_reached()
+    {
+      auto& s = Scheduler::get();
+      if (!s.fair || (s.fair_token_spacing == 0))
+        return;
+
+      if (++fair_tokens < s.fair_token_spacing)
+        return;
+
+      fair_tokens = 0;
+      Logging::cout() << "Should steal for fairness!" << Logging::endl;
+      should_steal_for_fairness = true;
+    }
+
+    /// Returns true if the period of `ThreadPool::set_fair_policy` has gone
+    /// by since the last steal for fairness.
+    bool fair_period_elapsed()
+    {
+      auto& s = Scheduler::get();
+      if (!s.fair || (s.fair_period == 0))
+        return false;
+
+      return (Aal::tick() - last_fair_steal) >= s.fair_period;
+    }
+
     /**
      * Some preliminaries required before we start processing messages
      *
@@ -468,20 +1536,45 @@ namespace verona::rt
         auto unmasked = clear_thread_bit(cown);
         Core<T>* owning_core = unmasked->owning_core();
 
+        // Only the threads of the core take from its pinned queue.
+        if (unmasked == owning_core->pinned_token_cown)
+        {
+          assert(owning_core == core);
+          if (n_pinned_tokens > 0)
+            n_pinned_tokens--;
+
+          owning_core->q_pinned.enqueue(*alloc, cown);
+          return false;
+        }
+
+        // The stub of a high priority queue plays no part in the leak
+        // detector, but is used for fairness in the same way as the token.
+        if (unmasked == owning_core->high_token_cown)
+        {
+          if (owning_core == core)
+            fair_token_reached();
+
+          owning_core->q_high.enqueue(*alloc, cown);
+          return false;
+        }
+
         if (owning_core == core)
         {
-          if (Scheduler::get().fair)
-          {
-            Logging::cout() << "Should steal for fairness!" << Logging::endl;
-            should_steal_for_fairness = true;
-          }
+          fair_token_reached();
 
-          if (n_ld_tokens > 0)
+          // The checkpoint also requires cowns scheduled with high priority
+          // before the leak detector started to have been run.
+          if ((n_ld_tokens > 0) && core->q_high.nothing_old())
           {
             dec_n_ld_tokens();
           }
 
           Logging::cout() << "Reached token" << Logging::endl;
+
+          maybe_want_ld(LDTrigger::Periodic);
+#ifdef USE_COWN_PROFILER
+          CownProfiler::maybe_report();
+#endif
         }
         else
         {
@@ -501,8 +1594,7 @@ namespace verona::rt
         Logging::cout() << "Bind cown to core: " << core << Logging::endl;
         assert(core != nullptr);
         cown->set_owning_core(core);
-        core->add_cown(cown);
-        core->total_cowns++;
+        bind_cowns(cown, cown, 1);
       }
 
       return true;
@@ -510,6 +1602,9 @@ namespace verona::rt
 
     void want_ld()
     {
+      if constexpr (!Scheduler::has_leak_detector)
+        return;
+
       if (state == ThreadState::NotInLD)
       {
         Logging::cout() << "==============================================="
@@ -525,9 +1620,44 @@ namespace verona::rt
       }
     }
 
+    /// Starts the leak detector if the pool has the `trigger` policy and it
+    /// is due, see `ThreadPool::set_ld_trigger`.
+    void maybe_want_ld(LDTrigger trigger)
+    {
+      if constexpr (!Scheduler::has_leak_detector)
+        return;
+
+      if ((state == ThreadState::NotInLD) && Scheduler::claim_ld(trigger))
+      {
+        Logging::cout() << "Automatic LD" << Logging::endl;
+        want_ld();
+      }
+    }
+
     bool ld_checkpoint_reached()
     {
-      return n_ld_tokens == 0;
+#ifdef USE_RUN_RING
+      if (!core->ring.empty())
+        return false;
+#endif
+      // An empty pinned queue has effectively passed its stub, which is only
+      // taken while the queue has cowns, see `dequeue_pinned`.
+      if (core->q_pinned.nothing_old())
+        n_pinned_tokens = 0;
+
+      return !scan_pending && (n_ld_tokens == 0) && (n_pinned_tokens == 0);
+    }
+
+    /// Reschedules the next batch of the scan of the cowns of this core.
+    void scan_step()
+    {
+      if (is_helper() || core->scan(Scheduler::get_ld_scan_batch()))
+      {
+        scan_pending = false;
+        n_ld_tokens = 2;
+        n_pinned_tokens = 2;
+        Logging::cout() << "Enqueued LD check point" << Logging::endl;
+      }
     }
 
     /**
@@ -537,6 +1667,12 @@ namespace verona::rt
      **/
     void ld_protocol()
     {
+      if constexpr (!Scheduler::has_leak_detector)
+        return;
+
+      if (scan_pending)
+        scan_step();
+
       // Set state to BelieveDone_Vote when we think we've finished scanning.
       if ((state == ThreadState::AllInScan) && ld_checkpoint_reached())
       {
@@ -639,6 +1775,16 @@ namespace verona::rt
       }
     }
 
+    /// Returns true while this thread takes part in a run of the leak
+    /// detector, which never starts without `Scheduler::has_leak_detector`.
+    bool in_ld()
+    {
+      if constexpr (Scheduler::has_leak_detector)
+        return state != ThreadState::NotInLD;
+      else
+        return false;
+    }
+
     bool in_sweep_state()
     {
       return state == ThreadState::Sweep;
@@ -648,6 +1794,20 @@ namespace verona::rt
     {
       Logging::cout() << "Scheduler state change: " << state << " -> " << snext
                       << Logging::endl;
+      EventTrace::event(TraceEvent::LDPhase, (uintptr_t)snext);
+
+      if ((state == ThreadState::NotInLD) && (snext != ThreadState::NotInLD))
+      {
+        ld_start = Aal::tick();
+      }
+      else if (
+        (state != ThreadState::NotInLD) && (snext == ThreadState::NotInLD))
+      {
+        uint64_t now = Aal::tick();
+        core->stats.ld(now - ld_start);
+        Scheduler::ld_finished(now);
+      }
+
       state = snext;
     }
 
@@ -670,18 +1830,22 @@ namespace verona::rt
                                                         EpochMark::EPOCH_B;
       Logging::cout() << "send_epoch (2): " << send_epoch << Logging::endl;
 
-      // Send empty messages to all cowns that can be LIFO scheduled.
-
+      // Send empty messages to all cowns that can be LIFO scheduled, a batch
+      // at a time so that behaviours keep running on this thread. A helper
+      // scans nothing, as the thread of its core scans the cowns of the core.
       assert(core != nullptr);
-      core->scan();
-      n_ld_tokens = 2;
+      if (!is_helper())
+        core->start_scan();
+      scan_pending = true;
       scheduled_unscanned_cown = false;
-      Logging::cout() << "Enqueued LD check point" << Logging::endl;
+      scan_step();
     }
 
     void collect_cowns()
     {
       assert(core != nullptr);
+      if (is_helper())
+        return;
       core->try_collect(*alloc, send_epoch);
     }
 
@@ -701,7 +1865,20 @@ namespace verona::rt
         default:;
       }
 
+      // The list of cowns of the core is only edited by the thread of the
+      // core, not by a helper sharing it, see `bind_cowns`.
+      if (is_helper())
+        return;
+
       assert(core != nullptr);
+      if constexpr (!during_teardown)
+      {
+        collect_free_stubs();
+        return;
+      }
+
+      // Every stub is collected below.
+      core->drain_free();
       T* _list = core->drain();
       T** list = &_list;
       T** p = &_list;
@@ -714,6 +1891,7 @@ namespace verona::rt
       {
         count++;
         T* c = *p;
+        c->prev = tail;
         // Collect cown stubs when the weak count is zero.
         if (c->weak_count == 0 || during_teardown)
         {
@@ -769,5 +1947,45 @@ namespace verona::rt
                       << " Total cowns " << this->core->total_cowns
                       << Logging::endl;
     }
+
+    /**
+     * Collect the stubs of the cowns in the free list of this core, without
+     * walking all the cowns of the core. Stubs that may still be reached by
+     * a thread in an earlier epoch are kept for a later call.
+     */
+    void collect_free_stubs()
+    {
+      T* c = core->drain_free();
+      core->flush_pending();
+      size_t removed_count = 0;
+
+      while (c != nullptr)
+      {
+        T* n = c->next_free;
+        assert(c->weak_count == 0);
+        Logging::cout() << "Stub collect cown " << c << Logging::endl;
+        auto epoch = c->epoch_when_popped;
+        if (epoch == T::NO_EPOCH_SET || GlobalEpoch::is_outdated(epoch))
+        {
+          removed_count++;
+          core->remove_cown(c);
+          Logging::cout() << "Stub collected cown " << c << Logging::endl;
+          c->dealloc(*alloc);
+        }
+        else
+        {
+          Logging::cout() << "Cown " << c << " not outdated." << Logging::endl;
+          core->add_free(c);
+        }
+        c = n;
+      }
+
+      core->free_cowns -= removed_count;
+      core->total_cowns -= removed_count;
+
+      Logging::cout() << "Stub collected " << removed_count << " cowns"
+                      << " Free cowns " << core->free_cowns << " Total cowns "
+                      << core->total_cowns << Logging::endl;
+    }
   };
 } // namespace verona::rt
@@ -0,0 +1,229 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "pal/threading.h"
+#include "test/logging.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef USE_SYSTEMATIC_TESTING
+#  error "The system monitor does not support systematic testing"
+#endif
+
+namespace verona::rt
+{
+  /**
+   * Detects scheduler threads stuck in a long running behaviour, such as one
+   * blocked in a call into a C library, and starts a helper thread on the
+   * core of each, so that the other cowns waiting on that core still run.
+   *
+   * The monitor is a thread of its own, started by `ThreadPool::run` when
+   * the runtime is built with `USE_SYSTEM_MONITOR`. Every `INTERVAL` it
+   * samples the scheduler threads. A thread is stuck if it has been running
+   * the same batch of behaviours since the last sample, while no thread has
+   * made progress on the cowns of its core, see `Core::progress_counter`,
+   * and cowns are waiting on that core.
+   *
+   * A helper is an extra scheduler thread on the same core. As every thread
+   * votes in the leak detector, helpers only join and leave the pool while
+   * it is not running. A helper leaves once the thread it was started for
+   * has made progress, or when it runs out of work rather than pausing. The
+   * helpers that have left are kept, and borrowed for the next stuck thread.
+   */
+  template<class P>
+  class SysMonitor
+  {
+    using Thread = typename P::Thread;
+    using CoreType = typename P::CoreType;
+
+    /// Interval between samples of the scheduler threads.
+    static constexpr auto INTERVAL = std::chrono::milliseconds(10);
+
+    /// Maximum number of helper threads in the pool at once.
+    static constexpr size_t MAX_HELPERS = 64;
+
+    struct Sample
+    {
+      /// `Thread::batches` at the last sample.
+      size_t batches = 0;
+      /// The helper started for this thread, while it is stuck.
+      Thread* helper = nullptr;
+    };
+
+    /// The startup function of the pool, which helpers run too.
+    std::function<void()> startup;
+
+    std::unordered_map<Thread*, Sample> samples;
+    std::unordered_map<CoreType*, size_t> progress;
+
+    /// The platform thread of each helper that has been started.
+    std::unordered_map<Thread*, PlatformThread> helper_threads;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    PlatformThread thread;
+
+    static void call_startup(SysMonitor* monitor)
+    {
+      monitor->startup();
+    }
+
+    static void run_helper(SysMonitor* monitor, Thread* h)
+    {
+      cpu::set_affinity(h->core->affinity);
+      Thread::run(h, &call_startup, monitor);
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (!cv.wait_for(lock, INTERVAL, [this] { return stopping; }))
+        sample();
+    }
+
+    void sample()
+    {
+      auto& pool = P::get();
+      if (P::is_teardown_in_progress())
+        return;
+
+      // Cores with cowns waiting, on which no progress has been made.
+      std::unordered_set<CoreType*> stalled;
+      CoreType* c = P::first_core();
+      do
+      {
+        size_t counter = c->progress_counter.load(std::memory_order_relaxed);
+        auto& last = progress[c];
+        if (
+          (counter == last) && (c->queued.load(std::memory_order_relaxed) != 0))
+          stalled.insert(c);
+        last = counter;
+        c = c->next;
+      } while (c != P::first_core());
+
+      // Decide under the lock of the thread list, and start helpers after,
+      // as that takes the lock again.
+      std::vector<Thread*> stuck;
+      size_t helpers = 0;
+      pool.threads.forall([&](Thread* t) {
+        if (t->helping_for.load(std::memory_order_acquire) != nullptr)
+          helpers++;
+
+        auto& s = samples[t];
+        size_t batches = t->batches.load(std::memory_order_relaxed);
+        bool progressed = batches != s.batches;
+        s.batches = batches;
+
+        if (s.helper != nullptr)
+        {
+          // Once the thread has made progress, its helper leaves. A helper
+          // may also have left already, as it ran out of work.
+          if (s.helper->helping_for.load(std::memory_order_acquire) != t)
+            s.helper = nullptr;
+          else if (progressed)
+          {
+            s.helper->leave_requested.store(true, std::memory_order_relaxed);
+            s.helper = nullptr;
+          }
+          return;
+        }
+
+        if (!progressed && t->busy.load(std::memory_order_relaxed))
+          stuck.push_back(t);
+      });
+
+      for (auto t : stuck)
+      {
+        if (helpers == MAX_HELPERS)
+          break;
+
+        // One helper is started for a core at a time.
+        if ((stalled.erase(t->core) != 0) && start_helper(t))
+          helpers++;
+      }
+    }
+
+    /**
+     * Start a helper thread on the core of `stuck`, borrowing one that has
+     * left the pool if there is one.
+     */
+    bool start_helper(Thread* stuck)
+    {
+      auto& pool = P::get();
+      Thread* h = pool.threads.pop_free();
+      if (h == nullptr)
+      {
+        h = new Thread;
+        h->systematic_id = pool.systematic_ids++;
+      }
+
+      if (!pool.add_helper(h, stuck->core))
+      {
+        pool.threads.add_free(h);
+        return false;
+      }
+
+      Logging::cout() << "Start helper " << h->systematic_id << " for "
+                      << stuck->systematic_id << " on core "
+                      << stuck->core->affinity << Logging::endl;
+
+      h->leave_requested.store(false, std::memory_order_relaxed);
+      h->helping_for.store(stuck, std::memory_order_release);
+      samples[stuck].helper = h;
+
+      // A borrowed helper has left the pool, but its platform thread may
+      // still be returning.
+      auto& platform = helper_threads[h];
+      if (platform.joinable())
+        platform.join();
+      platform = PlatformThread(&run_helper, this, h);
+      return true;
+    }
+
+  public:
+    /**
+     * Start monitoring. Helpers run `f(args...)` when they start, as the
+     * threads of the pool do.
+     *
+     * A helper may borrow a thread from the free list of the pool, so this
+     * must be called before the pool takes its threads from that list. The
+     * pool's threads only start once it has taken all of them, and the
+     * monitor only starts helpers for threads that are running.
+     */
+    template<typename... Args>
+    SysMonitor(void (*f)(Args...), Args... args)
+    : startup([=]() { f(args...); }), thread(&SysMonitor::run, this)
+    {}
+
+    /**
+     * Stop sampling, and wait for the helper threads. This is called once
+     * the threads started by the pool have finished, so any helper still in
+     * the pool has taken part in teardown.
+     */
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+      }
+      cv.notify_one();
+      thread.join();
+
+      for (auto& [h, platform] : helper_threads)
+      {
+        if (platform.joinable())
+          platform.join();
+      }
+      helper_threads.clear();
+    }
+  };
+}
@@ -0,0 +1,21 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+namespace verona::rt
+{
+  /**
+   * Work that needs no cown, see `schedule_task`. `run` is called once by
+   * whichever scheduler thread takes the task, and is responsible for
+   * freeing it.
+   *
+   * Unlike a behaviour, a task is not a message: it holds no cowns, goes
+   * through no `MPSCQ`, and is not seen by the leak detector. It waits in the
+   * task ring of a core, `Core::tasks`, from which idle scheduler threads
+   * steal.
+   */
+  struct Task
+  {
+    void (*run)(Task*) = nullptr;
+  };
+} // namespace verona::rt
@@ -12,9 +12,15 @@
 #endif
 
 #include "corepool.h"
+#include "eventpoller.h"
+#ifdef USE_PERF_COUNTERS
+#  include "perfcounters.h"
+#endif
 #include "schedulerlist.h"
+#include "timerwheel.h"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <snmalloc/snmalloc.h>
@@ -26,6 +32,68 @@ namespace verona::rt
 
   using namespace snmalloc;
 
+  /// When the scheduler threads start the leak detector without a call to
+  /// `want_ld`. See `ThreadPool::set_ld_trigger`.
+  enum class LDTrigger
+  {
+    /// Only when `want_ld` is called.
+    Manual,
+    /// When a scheduler thread runs out of work.
+    Idle,
+    /// When a scheduler thread reaches the token of its queue.
+    Periodic,
+  };
+
+  /// What an external thread does when its injector is full. See
+  /// `ThreadPool::set_inject_policy`.
+  enum class InjectPolicy
+  {
+    /// Schedule the cown on the queue of a core instead.
+    Overflow,
+    /// Wait until a scheduler thread has taken cowns from the injector, so
+    /// that an overloaded runtime pushes back on the external thread.
+    Block,
+  };
+
+  /**
+   * The messages sent and received by a scheduler thread while the epoch is
+   * `EPOCH_NONE`, see `ThreadPool::no_inflight_messages`. Only the thread
+   * writes them, so they are incremented with a plain load and store rather
+   * than a read-modify-write, and sit on a cache line of their own.
+   */
+  class alignas(64) InflightCounter
+  {
+  private:
+    std::atomic<size_t> sent{0};
+    std::atomic<size_t> received{0};
+
+    static void bump(std::atomic<size_t>& c)
+    {
+      c.store(c.load(std::memory_order_relaxed) + 1);
+    }
+
+  public:
+    void send()
+    {
+      bump(sent);
+    }
+
+    void receive()
+    {
+      bump(received);
+    }
+
+    size_t sent_count() const
+    {
+      return sent.load();
+    }
+
+    size_t received_count() const
+    {
+      return received.load();
+    }
+  };
+
   // Threadpool instantiated with <SchedulerThread<Cown>, Cown>
   template<class T, class C>
   class ThreadPool
@@ -33,6 +101,12 @@ namespace verona::rt
   private:
     friend T;
     friend void verona::rt::yield();
+#ifdef USE_SYSTEM_MONITOR
+    friend SysMonitor<ThreadPool<T, C>>;
+
+    using Thread = T;
+    using CoreType = Core<C>;
+#endif
 
     static constexpr uint64_t TSC_PAUSE_SLOP = 1'000'000;
     static constexpr uint64_t TSC_UNPAUSE_SLOP = TSC_PAUSE_SLOP / 2;
@@ -40,12 +114,6 @@ namespace verona::rt
     bool detect_leaks = true;
     size_t incarnation = 1;
 
-    /**
-     * Number of messages that have been sent that may not be visible to a
-     *thread in a Scan state.
-     **/
-    std::atomic<size_t> inflight_count = 0;
-
     /**
      * Used to represent the current pause_epoch.
      *
@@ -58,9 +126,21 @@ namespace verona::rt
      * Used to track unpause calls.  Threads unpausing
      * attempt to catch unpause_epoch up to pause_epoch,
      * and thus ensure threads are running.
+     *
+     * Catching up only wakes a single thread when work is scheduled, so
+     * other threads may remain paused with the epochs equal.  These are woken
+     * by `wake_one` as the woken threads find more work.
      */
     std::atomic<uint64_t> unpause_epoch{0};
 
+    /**
+     * The number of single wake ups in `unpause` that left other threads
+     * paused once the epochs were equal. While it is not zero, `unpause`
+     * wakes those threads even though the epochs are equal, so that it only
+     * takes the lock when a wake up was actually skipped.
+     */
+    std::atomic<size_t> skipped_wakes{0};
+
 #ifdef USE_SYSTEMATIC_TESTING
     ThreadSyncSystematic<T> sync;
 #else
@@ -80,10 +160,69 @@ namespace verona::rt
     /// quiescence.
     size_t external_event_sources = 0;
 
+    /// Polled by scheduler threads before they pause. See `set_event_poller`.
+    std::atomic<EventPoller*> event_poller{nullptr};
+    /// Set while a thread is polling `event_poller`.
+    std::atomic<bool> polling{false};
+    /// Set while the last active thread waits in `event_poller`, rather than
+    /// pausing, so that `unpause` knows to wake it.
+    std::atomic<bool> poll_blocked{false};
+
+    /// Timers waiting in the timer wheels of the scheduler threads. Like
+    /// external event sources, they prevent teardown.
+    std::atomic<size_t> pending_timers{0};
+
     bool teardown_in_progress = false;
 
     bool fair = false;
 
+    /// See `set_fair_policy`.
+    size_t fair_token_spacing = 1;
+    uint64_t fair_period = 0;
+
+    /// Run behaviours on the sending scheduler thread when the send acquires
+    /// the last of their cowns. See `Cown::run_inline`.
+    bool inline_behaviours = false;
+
+    /// Collect the regions held by the write-acquired cowns of a behaviour
+    /// when it completes, if they have grown enough. See
+    /// `Cown::collect_regions`.
+    bool auto_region_gc = false;
+
+    /// The pool shrinks to this number of scheduler threads when it is mostly
+    /// paused. See `set_elastic`.
+    size_t min_threads = SIZE_MAX;
+
+    /// Number of cores whose scheduler thread has been retired. Protected by
+    /// the `sync` lock.
+    size_t retired_cores = 0;
+
+    /// Number of ticks a scheduler thread looks for work on its own NUMA node,
+    /// before it also steals from remote NUMA nodes.
+    uint64_t remote_steal_delay = 100'000;
+
+    /// Maximum number of cowns taken from a victim in one steal. See
+    /// `set_steal_batch`.
+    size_t steal_batch = 32;
+
+    /// See `set_inject_policy`.
+    InjectPolicy inject_policy = InjectPolicy::Overflow;
+
+    /// See `set_ld_trigger`.
+    LDTrigger ld_trigger = LDTrigger::Manual;
+    uint64_t ld_interval = 0;
+
+    /// Tick from which the leak detector may next be started by
+    /// `ld_trigger`.
+    std::atomic<uint64_t> ld_next_tick = 0;
+
+    /// `total_progress()` when the leak detector last finished.
+    std::atomic<size_t> ld_progress = 0;
+
+    /// Maximum number of cowns rescheduled by each step of the scan of a
+    /// core. See `set_ld_scan_batch`.
+    size_t ld_scan_batch = 4096;
+
     ThreadState state;
 
     /// Pool of cores shared by the scheduler threads.
@@ -104,6 +243,78 @@ namespace verona::rt
       return get().core_pool.first_core;
     }
 
+    /**
+     * The NUMA node of the `index`th core, counted from the first core and
+     * wrapping around, or 0 if there are no cores.
+     */
+    static size_t core_numa_node(size_t index)
+    {
+      Core<C>* c = first_core();
+      if (c == nullptr)
+        return 0;
+
+      for (size_t i = 0; i < index; i++)
+        c = c->next;
+      return CorePool<ThreadPool<T, C>, C>::numa_node(c);
+    }
+
+    /**
+     * Read the counters of every core, see `SchedulerStats`. This can be
+     * called while the scheduler threads run, but not concurrently with
+     * `init` or teardown, and is empty if there are no cores.
+     */
+    static std::vector<SchedulerSnapshot> snapshot_stats()
+    {
+      std::vector<SchedulerSnapshot> snapshots;
+      Core<C>* first = first_core();
+      if (first == nullptr)
+        return snapshots;
+
+      Core<C>* c = first;
+      do
+      {
+        SchedulerSnapshot& s = snapshots.emplace_back();
+        c->stats.snapshot(s);
+        s.core = c->affinity;
+        s.queued = c->queued.load(std::memory_order_relaxed);
+        c = c->next;
+      } while (c != first);
+
+      return snapshots;
+    }
+
+    /// The sum of `snapshot_stats` over the cores.
+    static SchedulerSnapshot total_stats()
+    {
+      SchedulerSnapshot total;
+      for (auto& s : snapshot_stats())
+        total.add(s);
+      return total;
+    }
+
+    /// Write `snapshot_stats` in the Prometheus text exposition format.
+    static void write_stats_prometheus(std::ostream& o)
+    {
+      SchedulerSnapshot::write_prometheus(o, snapshot_stats());
+#ifdef USE_PERF_COUNTERS
+      PerfStats::write_prometheus(o);
+#endif
+    }
+
+    /**
+     * False if the runtime is built with `USE_NO_LEAK_DETECTOR`, for programs
+     * that release all of their cowns. The leak detector then never starts,
+     * and its checks are compiled out of the scheduling paths, see
+     * `should_scan`, `in_prescan` and `SchedulerThread::in_ld`. Cycles of
+     * cowns are never collected, and are reported as leaks at teardown if
+     * `set_detect_leaks` is set.
+     */
+#ifdef USE_NO_LEAK_DETECTOR
+    static constexpr bool has_leak_detector = false;
+#else
+    static constexpr bool has_leak_detector = true;
+#endif
+
     static void set_detect_leaks(bool b)
     {
       get().detect_leaks = b;
@@ -114,26 +325,50 @@ namespace verona::rt
       return get().detect_leaks;
     }
 
+    /**
+     * Record a message sent while the epoch is `EPOCH_NONE`, which may not be
+     * visible to a thread in a Scan state. Such messages are only sent and
+     * received by scheduler threads, which count them in their own
+     * `InflightCounter` so that the message path does not share a cache line
+     * across cores.
+     */
     static void record_inflight_message()
     {
-      Logging::cout() << "Increase inflight count: " << get().inflight_count + 1
-                      << Logging::endl;
-      local()->scheduled_unscanned_cown = true;
-      get().inflight_count++;
+      auto* t = local();
+      Logging::cout() << "Increase inflight count" << Logging::endl;
+      t->scheduled_unscanned_cown = true;
+      t->inflight.send();
     }
 
     static void recv_inflight_message()
     {
-      Logging::cout() << "Decrease inflight count: " << get().inflight_count - 1
-                      << Logging::endl;
-      get().inflight_count--;
+      auto* t = local();
+      assert(t != nullptr);
+      Logging::cout() << "Decrease inflight count" << Logging::endl;
+      t->inflight.receive();
     }
 
+    /**
+     * Whether no message recorded by `record_inflight_message` is still in
+     * flight. Called by the leak detector when voting.
+     *
+     * A message is counted as received on one thread after it is counted as
+     * sent on another, so the counters of all threads are not read at a
+     * single instant. Instead, every received count is read before any sent
+     * count: a message received by the time its receive is read was sent by
+     * the time its send is read, so the sums are equal only if no message was
+     * in flight between the two passes.
+     */
     static bool no_inflight_messages()
     {
-      Logging::cout() << "Check inflight count: " << get().inflight_count
+      auto& threads = get().threads;
+      size_t received = 0;
+      size_t sent = 0;
+      threads.forall([&](T* t) { received += t->inflight.received_count(); });
+      threads.forall([&](T* t) { sent += t->inflight.sent_count(); });
+      Logging::cout() << "Check inflight count: " << sent - received
                       << Logging::endl;
-      return get().inflight_count == 0;
+      return sent == received;
     }
 
     /// Increment the external event source count. A non-zero count will prevent
@@ -177,6 +412,77 @@ namespace verona::rt
                       << (prev_count - 1) << ")" << Logging::endl;
     }
 
+    /**
+     * Have the scheduler threads poll `poller` for external events before
+     * they pause, and dispatch them on their own core. While there are
+     * external event sources and no work, the last active thread waits in
+     * `poller` instead of pausing.
+     *
+     * Replacing the poller waits for any poll of the previous one to finish,
+     * so once this returns, none of its events are being dispatched.
+     */
+    static void set_event_poller(EventPoller* poller)
+    {
+      Logging::cout() << "Set event poller: " << poller << Logging::endl;
+      auto& s = get();
+      auto prev = s.event_poller.exchange(poller, std::memory_order_acq_rel);
+      if (prev == nullptr)
+        return;
+
+      prev->wake();
+      while (s.polling.load(std::memory_order_acquire))
+        Aal::pause();
+    }
+
+    /// The current tick of the timer wheels: milliseconds of the steady clock.
+    static uint64_t timer_tick()
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+    }
+
+    /**
+     * Add `t` to the task ring of the core of this scheduler thread. Returns
+     * false if it was not added, as this is not a scheduler thread or the
+     * ring is full.
+     */
+    static bool add_task(Task* t)
+    {
+      T* l = local();
+      return (l != nullptr) && l->add_task(t);
+    }
+
+    /**
+     * Add `t`, due at the tick `t->due`, to the timer wheel of this scheduler
+     * thread. Must be called on a scheduler thread.
+     */
+    static void add_timer(Timer* t)
+    {
+      assert(local() != nullptr);
+      local()->add_timer(t);
+    }
+
+    /**
+     * Poll the event poller, if there is one and no other thread is polling
+     * it. Returns true if any events were dispatched.
+     */
+    bool poll_events(int timeout_ms)
+    {
+      if (event_poller.load(std::memory_order_relaxed) == nullptr)
+        return false;
+
+      if (polling.exchange(true, std::memory_order_seq_cst))
+        return false;
+
+      size_t n = 0;
+      auto poller = event_poller.load(std::memory_order_seq_cst);
+      if (poller != nullptr)
+        n = poller->poll(timeout_ms);
+      polling.store(false, std::memory_order_release);
+      return n != 0;
+    }
+
     static void set_fair(bool fair)
     {
       Logging::cout() << "Set fair: " << fair << Logging::endl;
@@ -184,6 +490,266 @@ namespace verona::rt
       s.fair = fair;
     }
 
+    /**
+     * Choose when a fair scheduler thread steals, see `set_fair`.
+     *
+     * A thread steals every `token_spacing` times the token of its core is
+     * reached, that is once every cown queued ahead of the token has run
+     * that many times. A spacing of 0 never steals on the token. With a
+     * non-zero `period`, a thread also steals once `period` ticks have gone
+     * by since its last steal, however long its queue is.
+     *
+     * Throughput workloads may space the token out to migrate fewer cowns,
+     * latency workloads may add a period to bound how long a cown waits.
+     */
+    static void set_fair_policy(size_t token_spacing, uint64_t period = 0)
+    {
+      Logging::cout() << "Set fair policy: " << token_spacing << " tokens, "
+                      << period << " ticks" << Logging::endl;
+      auto& s = get();
+      s.fair_token_spacing = token_spacing;
+      s.fair_period = period;
+    }
+
+    static void set_inline_behaviours(bool inline_behaviours)
+    {
+      Logging::cout() << "Set inline behaviours: " << inline_behaviours
+                      << Logging::endl;
+      get().inline_behaviours = inline_behaviours;
+    }
+
+    static bool get_inline_behaviours()
+    {
+      return get().inline_behaviours;
+    }
+
+    static void set_auto_region_gc(bool auto_region_gc)
+    {
+      Logging::cout() << "Set auto region gc: " << auto_region_gc
+                      << Logging::endl;
+      get().auto_region_gc = auto_region_gc;
+    }
+
+    static bool get_auto_region_gc()
+    {
+      return get().auto_region_gc;
+    }
+
+    /// Number of scheduler threads, or zero if the pool is not initialised.
+    static size_t get_thread_count()
+    {
+      return get().thread_count;
+    }
+
+    /**
+     * Number of scheduler threads that have not been retired, see
+     * `set_elastic`. Threads retire and rejoin concurrently, so this is only
+     * a snapshot.
+     */
+    static size_t get_serving_thread_count()
+    {
+      Core<C>* first = first_core();
+      if ((get().thread_count == 0) || (first == nullptr))
+        return 0;
+
+      size_t count = 0;
+      Core<C>* c = first;
+      do
+      {
+        if (!c->retired.load(std::memory_order_relaxed))
+          count++;
+        c = c->next;
+      } while (c != first);
+      return count;
+    }
+
+    /**
+     * Choose the CPUs the scheduler threads run on, see
+     * `Topology::Placement`. This takes effect at the next `init`, and
+     * overrides the placement read from the environment.
+     */
+    static void set_placement(const Topology::Placement& placement)
+    {
+      Logging::cout() << "Set placement" << Logging::endl;
+      CorePool<ThreadPool<T, C>, C>::set_placement(placement);
+    }
+
+    static void set_remote_steal_delay(uint64_t ticks)
+    {
+      Logging::cout() << "Set remote steal delay: " << ticks << Logging::endl;
+      get().remote_steal_delay = ticks;
+    }
+
+    /**
+     * Let a scheduler thread that runs out of work take up to `batch` cowns
+     * from a victim in one steal: up to half of the cowns waiting there. The
+     * first is run, and the rest are moved to the queue of the thief. A batch
+     * of 1 steals a single cown at a time.
+     */
+    static void set_steal_batch(size_t batch)
+    {
+      Logging::cout() << "Set steal batch: " << batch << Logging::endl;
+      get().steal_batch = batch == 0 ? 1 : batch;
+    }
+
+    /**
+     * Let external threads wait for space in their injector, rather than
+     * overflowing onto the queue of a core, see `InjectPolicy`.
+     */
+    static void set_inject_policy(InjectPolicy policy)
+    {
+      Logging::cout() << "Set inject policy: " << (int)policy << Logging::endl;
+      get().inject_policy = policy;
+    }
+
+    /**
+     * Returns true if the injector of the calling external thread is full,
+     * so that it may reject new work rather than submit it. A behaviour may
+     * schedule several cowns, so this does not guarantee that the next
+     * submission fits.
+     */
+    static bool inject_full()
+    {
+      Injector<C>* i = injector();
+      return (i != nullptr) && i->full();
+    }
+
+    /**
+     * Returns true if the calling external thread should wait for its
+     * injector to drain, rather than overflowing onto the queue of a core.
+     */
+    static bool inject_should_block()
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      return false;
+#else
+      // Before the runtime starts, nothing drains the injector.
+      return (get().inject_policy == InjectPolicy::Block) &&
+        (get().state.get_active_threads() != 0);
+#endif
+    }
+
+    /**
+     * The injector of the calling thread, see `Injector`. It is claimed on
+     * its first use in each run of the runtime, and released when the thread
+     * exits. Returns nullptr on a scheduler thread, or if there are no cores.
+     */
+    static Injector<C>* injector()
+    {
+      struct Claim
+      {
+        size_t incarnation = 0;
+        Injector<C>* injector = nullptr;
+
+        ~Claim()
+        {
+          if ((injector != nullptr) && (incarnation == get().incarnation))
+            injector->release();
+        }
+      };
+      static thread_local Claim claim;
+
+      if (local() != nullptr)
+        return nullptr;
+
+      if (claim.incarnation != get().incarnation)
+      {
+        claim.incarnation = get().incarnation;
+        Core<C>* c = get().core_pool.injection_core(cpu::current());
+        claim.injector = c == nullptr ? nullptr : Injector<C>::claim(c);
+      }
+      return claim.injector;
+    }
+
+    /**
+     * Let the scheduler threads start the leak detector on their own, on the
+     * `trigger` policy. A run is only started once `interval` ticks have
+     * passed since the previous run ended, and cowns have run since then, so
+     * that an idle runtime does not keep running the leak detector. Explicit
+     * calls to `want_ld` are not limited.
+     */
+    static void set_ld_trigger(LDTrigger trigger, uint64_t interval)
+    {
+      Logging::cout() << "Set LD trigger: " << (int)trigger << " interval "
+                      << interval << Logging::endl;
+      get().ld_trigger = trigger;
+      get().ld_interval = interval;
+    }
+
+    /**
+     * Reschedule at most `batch` cowns of a core for the leak detector at a
+     * time, between running behaviours, rather than all the cowns of the core
+     * at once.
+     */
+    static void set_ld_scan_batch(size_t batch)
+    {
+      Logging::cout() << "Set LD scan batch: " << batch << Logging::endl;
+      get().ld_scan_batch = batch == 0 ? 1 : batch;
+    }
+
+    static size_t get_ld_scan_batch()
+    {
+      return get().ld_scan_batch;
+    }
+
+    /// Returns true if the caller should start the leak detector under the
+    /// `trigger` policy, in which case no other thread is told to until the
+    /// interval has passed again.
+    static bool claim_ld(LDTrigger trigger)
+    {
+      auto& s = get();
+      if (s.ld_trigger != trigger)
+        return false;
+
+      uint64_t now = Aal::tick();
+      uint64_t next = s.ld_next_tick.load(std::memory_order_relaxed);
+      if (now < next)
+        return false;
+
+      if (s.total_progress() == s.ld_progress.load(std::memory_order_relaxed))
+        return false;
+
+      return s.ld_next_tick.compare_exchange_strong(next, now + s.ld_interval);
+    }
+
+    /// Called by each scheduler thread when a run of the leak detector ends
+    /// at tick `now`.
+    static void ld_finished(uint64_t now)
+    {
+      auto& s = get();
+      s.ld_next_tick.store(now + s.ld_interval, std::memory_order_relaxed);
+      s.ld_progress.store(s.total_progress(), std::memory_order_relaxed);
+    }
+
+    /// Sum of the progress counters of the cores.
+    size_t total_progress()
+    {
+      size_t sum = 0;
+      Core<C>* c = core_pool.first_core;
+      do
+      {
+        sum += c->progress_counter.load(std::memory_order_relaxed);
+        c = c->next;
+      } while (c != core_pool.first_core);
+      return sum;
+    }
+
+    /**
+     * Let the pool shrink to `min_threads` scheduler threads when it is
+     * mostly paused, and grow back under load.
+     *
+     * A scheduler thread that pauses while more than `min_threads` threads
+     * are serving cores is retired: its core no longer receives cowns woken
+     * on other threads or from external sources, and it is only woken once no
+     * other paused thread can take new work. It rejoins the pool when it is
+     * woken. The leak detector and teardown still wake retired threads.
+     */
+    static void set_elastic(size_t min_threads)
+    {
+      Logging::cout() << "Set elastic: " << min_threads << Logging::endl;
+      get().min_threads = min_threads == 0 ? 1 : min_threads;
+    }
+
     static bool is_teardown_in_progress()
     {
       return get().teardown_in_progress;
@@ -210,6 +776,16 @@ namespace verona::rt
         nonlocal = nonlocal->next;
       }
 
+      // Skip cores with a retired thread, unless every core is retired.
+      for (Core<C>* c = nonlocal; c->retired.load(std::memory_order_relaxed);)
+      {
+        c = c->next;
+        if (c == nonlocal)
+          break;
+        if (!c->retired.load(std::memory_order_relaxed))
+          nonlocal = c;
+      }
+
       return nonlocal;
     }
 
@@ -243,6 +819,9 @@ namespace verona::rt
 
     static bool should_scan()
     {
+      if constexpr (!has_leak_detector)
+        return false;
+
       T* t = local();
 
       if (t == nullptr)
@@ -267,6 +846,9 @@ namespace verona::rt
 
     static bool in_prescan()
     {
+      if constexpr (!has_leak_detector)
+        return false;
+
       T* t = local();
 
       if (t == nullptr)
@@ -281,6 +863,9 @@ namespace verona::rt
      **/
     static bool debug_in_prescan()
     {
+      if constexpr (!has_leak_detector)
+        return false;
+
       T* t = local();
 
       if (t == nullptr)
@@ -336,6 +921,9 @@ namespace verona::rt
     template<typename... Args>
     void run_with_startup(void (*startup)(Args...), Args... args)
     {
+#ifdef USE_SYSTEM_MONITOR
+      SysMonitor<ThreadPool<T, C>> monitor(startup, args...);
+#endif
       {
         ThreadPoolBuilder builder(thread_count);
 
@@ -348,11 +936,18 @@ namespace verona::rt
           if (t == nullptr)
             abort();
           t->set_core(curr_core);
+          // Move the thread's state, where it fits whole pages, next to its
+          // core.
+          numa::place(
+            t, sizeof(T), CorePool<ThreadPool<T, C>, C>::numa_node(curr_core));
           threads.add_active(t);
           builder.add_thread(t->core->affinity, &T::run, t, startup, args...);
           curr_core = curr_core->next;
         }
       }
+#ifdef USE_SYSTEM_MONITOR
+      monitor.stop();
+#endif
       Logging::cout() << "All threads stopped" << Logging::endl;
       threads.dealloc_lists();
       Logging::cout() << "All threads deallocated" << Logging::endl;
@@ -362,6 +957,7 @@ namespace verona::rt
       Object::reset_ids();
 #endif
       thread_count = 0;
+      retired_cores = 0;
       state.reset<ThreadState::NotInLD>();
 
       Epoch::flush(ThreadAlloc::get());
@@ -388,7 +984,7 @@ namespace verona::rt
       {
         Logging::cout() << "Checking for pending work on thread " << c->affinity
                         << Logging::endl;
-        if (!c->q.nothing_old())
+        if (!c->nothing_old())
         {
           Logging::cout() << "Found pending work!" << Logging::endl;
           return true;
@@ -400,10 +996,17 @@ namespace verona::rt
       return false;
     }
 
-    bool pause()
+    /**
+     * Pause this thread, if there is no work, for at most `timeout`. Returns
+     * true if it paused, or the runtime is tearing down.
+     */
+    bool pause(
+      std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
     {
+      bool timed = timeout != std::chrono::milliseconds::max();
       // Snapshot unpause_epoch, so we can detect a racing unpause.
       auto local_unpause_epoch = unpause_epoch.load(std::memory_order_relaxed);
+      bool wait_in_poller = false;
 
       yield();
 
@@ -439,39 +1042,94 @@ namespace verona::rt
         if (value > 1)
         {
           state.dec_active_threads();
+          bool retired = retire(local()->core);
           Logging::cout() << "Pausing" << Logging::endl;
-          h.pause(); // Spurious wake-ups are safe.
+          if (timed)
+            h.pause_for(timeout);
+          else
+            h.pause(); // Spurious wake-ups are safe.
           Logging::cout() << "Unpausing" << Logging::endl;
+          if (retired)
+            unretire(local()->core);
           state.inc_active_threads();
           return true;
         }
 
-        // There are external sources should wait for external wake ups.
-        if (external_event_sources != 0)
+        // There are external sources or timers should wait for external
+        // wake ups or timers to fire.
+        if ((external_event_sources != 0) || (pending_timers != 0))
         {
-          Logging::cout() << "Pausing last thread" << Logging::endl;
-          h.pause(); // Spurious wake-ups are safe.
-          Logging::cout() << "Unpausing last thread" << Logging::endl;
-          return true;
+          // This thread must not be counted as active while paused, as an
+          // external wake up may only resume a different thread.
+          state.dec_active_threads();
+          // With an event poller, wait in it instead, outside of the lock.
+          if (event_poller.load(std::memory_order_relaxed) != nullptr)
+          {
+            poll_blocked.store(true, std::memory_order_seq_cst);
+            wait_in_poller = true;
+          }
+          if (!wait_in_poller)
+          {
+            Logging::cout() << "Pausing last thread" << Logging::endl;
+            if (timed)
+              h.pause_for(timeout);
+            else
+              h.pause(); // Spurious wake-ups are safe.
+            Logging::cout() << "Unpausing last thread" << Logging::endl;
+            state.inc_active_threads();
+            return true;
+          }
         }
+        else
+        {
+          Logging::cout() << "Teardown beginning" << Logging::endl;
+          // Used to handle deallocating all the state of the threads.
+          teardown_in_progress = true;
 
-        Logging::cout() << "Teardown beginning" << Logging::endl;
-        // Used to handle deallocating all the state of the threads.
-        teardown_in_progress = true;
+          // Tell all threads to stop looking for work.
+          threads.forall([](T* thread) { thread->stop(); });
+          Logging::cout() << "Teardown: all threads stopped" << Logging::endl;
 
-        // Tell all threads to stop looking for work.
-        threads.forall([](T* thread) { thread->stop(); });
-        Logging::cout() << "Teardown: all threads stopped" << Logging::endl;
+          h.unpause_all();
+          Logging::cout() << "cv_notify_all() for teardown" << Logging::endl;
+        }
+      }
 
-        h.unpause_all();
-        Logging::cout() << "cv_notify_all() for teardown" << Logging::endl;
+      if (wait_in_poller)
+      {
+        // An unpause that catches up `unpause_epoch` after this check sees
+        // `poll_blocked`, and wakes the poller.
+        bool unpaused =
+          local_unpause_epoch != unpause_epoch.load(std::memory_order_seq_cst);
+#ifdef USE_SYSTEMATIC_TESTING
+        // Blocking would stop the other threads from being scheduled.
+        unpaused = true;
+#endif
+        int poll_timeout = -1;
+        if (unpaused)
+          poll_timeout = 0;
+        else if (timed)
+          poll_timeout = (int)std::min<int64_t>(timeout.count(), INT32_MAX);
+        Logging::cout() << "Waiting in event poller" << Logging::endl;
+        poll_events(poll_timeout);
+        poll_blocked.store(false, std::memory_order_relaxed);
+        Logging::cout() << "Woken from event poller" << Logging::endl;
+        state.inc_active_threads();
+        return true;
       }
+
       Logging::cout() << "Teardown: all threads beginning teardown"
                       << Logging::endl;
       return true;
     }
 
-    bool unpause()
+    /**
+     * Called after work has been added to ensure that it is picked up.
+     *
+     * If `near` is given, at most one paused thread is woken, preferring the
+     * one nearest to `near`. Otherwise, every paused thread is woken.
+     */
+    bool unpause(Core<C>* near = nullptr)
     {
       Logging::cout() << "unpause()" << Logging::endl;
 
@@ -487,7 +1145,25 @@ namespace verona::rt
       // Exit early if we think no threads are trying to sleep.
       // Our work will be visible to any thread at this point.
       if (local_unpause_epoch == local_pause_epoch)
-        return false;
+      {
+        // Threads left asleep by previous single wake ups are not tracked by
+        // the epochs, so wake them as if they had just paused.
+        if (!take_skipped_wakes(near == nullptr) || !sync.has_waiters())
+          return false;
+
+        if (near != nullptr)
+        {
+          Logging::cout() << "Wake one remaining thread near "
+                          << near->affinity << Logging::endl;
+          sync.unpause_one(local(), near);
+        }
+        else
+        {
+          Logging::cout() << "Wake remaining threads" << Logging::endl;
+          sync.unpause_all(local());
+        }
+        return true;
+      }
 
       yield();
 
@@ -508,14 +1184,138 @@ namespace verona::rt
       {
         // This grabs the scheduler lock to ensure threads have seen CAS before
         // we notify.
-        Logging::cout() << "Wake all threads" << Logging::endl;
-        sync.unpause_all(local());
+        if (near != nullptr)
+        {
+          Logging::cout() << "Wake one thread near " << near->affinity
+                          << Logging::endl;
+          sync.unpause_one(local(), near);
+          if (sync.has_waiters())
+            skipped_wakes.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+          Logging::cout() << "Wake all threads" << Logging::endl;
+          sync.unpause_all(local());
+        }
+
+        // The last active thread may be waiting in the event poller rather
+        // than paused. Either it sees the compare and swap above before it
+        // waits, or this sees `poll_blocked`.
+        if (poll_blocked.load(std::memory_order_seq_cst))
+        {
+          auto poller = event_poller.load(std::memory_order_acquire);
+          if (poller != nullptr)
+            poller->wake();
+        }
         return true;
       }
       // Another thread won the CAS race, and is responsible for waking up.
       return false;
     }
 
+    /**
+     * Take one of `skipped_wakes`, or all of them if `all` is set. Returns
+     * false if there were none.
+     */
+    bool take_skipped_wakes(bool all)
+    {
+      size_t n = skipped_wakes.load(std::memory_order_relaxed);
+      while (n != 0)
+      {
+        size_t left = all ? 0 : n - 1;
+        if (skipped_wakes.compare_exchange_weak(
+              n, left, std::memory_order_relaxed))
+          return true;
+      }
+      return false;
+    }
+
+    /**
+     * Wake the paused thread nearest to `near`, if there is one.
+     *
+     * This is used by a thread that has been woken to pass the wake up on,
+     * when it finds more work than it can take.
+     */
+    bool wake_one(Core<C>* near)
+    {
+      if (!sync.has_waiters())
+        return false;
+
+      Logging::cout() << "Pass on wake up near " << near->affinity
+                      << Logging::endl;
+      sync.unpause_one(local(), near);
+      return true;
+    }
+
+    /**
+     * Retire the scheduler thread of `c`, if more than `min_threads` threads
+     * are serving cores. Must hold the `sync` lock.
+     *
+     * The queues of `c` do not need draining, as the thread only pauses once
+     * `check_for_work` has found them empty. Cowns that are enqueued on `c`
+     * concurrently are either stolen by the remaining threads, or wake a
+     * retired thread when no other thread is paused.
+     */
+    bool retire(Core<C>* c)
+    {
+      if ((thread_count - retired_cores) <= min_threads)
+        return false;
+
+      Logging::cout() << "Retire core " << c->affinity << Logging::endl;
+      c->retired.store(true, std::memory_order_relaxed);
+      retired_cores++;
+      return true;
+    }
+
+    /// Must hold the `sync` lock.
+    void unretire(Core<C>* c)
+    {
+      Logging::cout() << "Unretire core " << c->affinity << Logging::endl;
+      c->retired.store(false, std::memory_order_relaxed);
+      retired_cores--;
+    }
+
+#ifdef USE_SYSTEM_MONITOR
+    /**
+     * Add `t` to the pool, as a helper thread on `core`. See `SysMonitor`.
+     *
+     * This fails while the leak detector is running, as the number of threads
+     * voting in it cannot change, and once teardown has begun.
+     */
+    bool add_helper(T* t, Core<C>* core)
+    {
+      auto h = sync.handle(local());
+      if (teardown_in_progress || (state.get_state() != ThreadState::NotInLD))
+        return false;
+
+      Logging::cout() << "Add helper thread on core " << core->affinity
+                      << Logging::endl;
+      t->set_core(core);
+      thread_count++;
+      state.add_thread();
+      threads.add_active(t);
+      return true;
+    }
+
+    /**
+     * Remove the helper thread `t` from the thread count of the pool. It
+     * moves itself to the free list once it has left. As for `add_helper`,
+     * this fails while the leak detector is running, and during teardown.
+     */
+    bool remove_helper(T* t)
+    {
+      auto h = sync.handle(local());
+      if (teardown_in_progress || (state.get_state() != ThreadState::NotInLD))
+        return false;
+
+      Logging::cout() << "Remove helper thread on core " << t->core->affinity
+                      << Logging::endl;
+      thread_count--;
+      state.remove_thread();
+      return true;
+    }
+#endif
+
     void init_barrier()
     {
       state.set_barrier(thread_count);
@@ -303,6 +303,22 @@ namespace verona::rt
       internal_state.active_threads = thread_count;
     }
 
+    /// A thread joins the pool while it is running.
+    /// @warn Should be holding the threadpool lock.
+    void add_thread()
+    {
+      internal_state.barrier_count++;
+      internal_state.active_threads++;
+    }
+
+    /// A thread leaves the pool while it is running, see `add_thread`.
+    /// @warn Should be holding the threadpool lock.
+    void remove_thread()
+    {
+      internal_state.barrier_count--;
+      internal_state.active_threads--;
+    }
+
     /// @warn Should be holding the threadpool lock.
     size_t exit_thread()
     {
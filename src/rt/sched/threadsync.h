@@ -5,6 +5,8 @@
 #include "../pal/semaphore.h"
 #include "test/logging.h"
 
+#include <chrono>
+
 /**
  * This file contains the synchronisation implementation for suspending
  * and resuming threads.  It is design to be a thin wrapper that could
@@ -90,17 +92,20 @@ namespace verona::rt
     }
   };
 
+  template<class T>
   struct LocalSync
   {
     pal::SleepHandle sem;
-    LocalSync* next{nullptr};
+    T* next{nullptr};
   };
 
   template<class T>
   class ThreadSync
   {
     SchedulerLock lock;
-    LocalSync* waiters = nullptr;
+    /// Paused threads. Only modified while holding `lock`, but read without
+    /// it by `has_waiters`.
+    std::atomic<T*> waiters{nullptr};
 
     void unlock()
     {
@@ -111,21 +116,43 @@ namespace verona::rt
       {
         Logging::cout() << "Pending unpause" << Logging::endl;
 
-        auto* curr = waiters;
-        waiters = nullptr;
+        T* curr = waiters.exchange(nullptr, std::memory_order_relaxed);
         // Subsequent unpause requests can be ignored as there are no more
         // waiters as we have held the lock continuously.
         lock.unlock_unpause();
         // Don't need to hold the lock to wake up the waiters.
         while (curr != nullptr)
         {
-          auto next = curr->next;
-          curr->sem.wake();
+          auto next = curr->local_sync.next;
+          curr->local_sync.sem.wake();
           curr = next;
         }
       }
     }
 
+    /**
+     * Unlink `t` from the paused threads. Returns false if it was not paused.
+     * Must hold the lock.
+     */
+    bool remove_waiter(T* t)
+    {
+      T* prev = nullptr;
+      for (T* curr = waiters.load(std::memory_order_relaxed); curr != nullptr;
+           curr = curr->local_sync.next)
+      {
+        if (curr == t)
+        {
+          if (prev == nullptr)
+            waiters.store(t->local_sync.next, std::memory_order_relaxed);
+          else
+            prev->local_sync.next = t->local_sync.next;
+          return true;
+        }
+        prev = curr;
+      }
+      return false;
+    }
+
   public:
     void unpause_all(T*)
     {
@@ -135,6 +162,60 @@ namespace verona::rt
       Logging::cout() << "Unpause all done" << Logging::endl;
     }
 
+    /**
+     * Wake up a single paused thread, preferring the one whose core is
+     * nearest to `near` in its stealing order (see `Core::wake_rank`).
+     */
+    template<typename C>
+    void unpause_one(T*, C* near)
+    {
+      Logging::cout() << "Unpause one" << Logging::endl;
+      lock.lock();
+
+      // Find the waiter nearest to `near`, and unlink it.
+      T* prev = nullptr;
+      T* best = nullptr;
+      T* best_prev = nullptr;
+      size_t best_rank = SIZE_MAX;
+      for (T* curr = waiters.load(std::memory_order_relaxed); curr != nullptr;
+           curr = curr->local_sync.next)
+      {
+        size_t rank = near->wake_rank(curr->core);
+        if (rank < best_rank)
+        {
+          best = curr;
+          best_prev = prev;
+          best_rank = rank;
+        }
+        prev = curr;
+      }
+
+      if (best != nullptr)
+      {
+        if (best_prev == nullptr)
+          waiters.store(best->local_sync.next, std::memory_order_relaxed);
+        else
+          best_prev->local_sync.next = best->local_sync.next;
+      }
+
+      // Releasing the lock may wake every other waiter, if an unpause of all
+      // threads raced with this one.
+      unlock();
+
+      // Don't need to hold the lock to wake up the waiter.
+      if (best != nullptr)
+        best->local_sync.sem.wake();
+      Logging::cout() << "Unpause one done" << Logging::endl;
+    }
+
+    /**
+     * Returns true if some thread may be paused.
+     */
+    bool has_waiters()
+    {
+      return waiters.load(std::memory_order_relaxed) != nullptr;
+    }
+
     class ThreadSyncHandle
     {
       T* thread;
@@ -161,8 +242,8 @@ namespace verona::rt
       void pause()
       {
         Logging::cout() << "Add to list of waiters" << Logging::endl;
-        thread->local_sync.next = sync.waiters;
-        sync.waiters = &(thread->local_sync);
+        thread->local_sync.next = sync.waiters.load(std::memory_order_relaxed);
+        sync.waiters.store(thread, std::memory_order_relaxed);
         sync.unlock();
 
         Logging::cout() << "Sleep" << Logging::endl;
@@ -172,6 +253,33 @@ namespace verona::rt
         sync.lock.lock();
       }
 
+      /**
+       * Pause this thread for at most `timeout`.
+       */
+      void pause_for(std::chrono::nanoseconds timeout)
+      {
+        Logging::cout() << "Add to list of waiters" << Logging::endl;
+        thread->local_sync.next = sync.waiters.load(std::memory_order_relaxed);
+        sync.waiters.store(thread, std::memory_order_relaxed);
+        sync.unlock();
+
+        Logging::cout() << "Sleep for " << timeout.count() << "ns"
+                        << Logging::endl;
+        bool woken = thread->local_sync.sem.sleep_for(timeout);
+        Logging::cout() << "Awake!" << Logging::endl;
+
+        sync.lock.lock();
+
+        // If a waker has already taken this thread off the list, its wake up
+        // is on the way, and must be consumed before sleeping again.
+        if (!woken && !sync.remove_waiter(thread))
+        {
+          sync.unlock();
+          thread->local_sync.sem.sleep();
+          sync.lock.lock();
+        }
+      }
+
       ThreadSyncHandle(T* thread, ThreadSync& sync) : thread(thread), sync(sync)
       {
         sync.lock.lock();
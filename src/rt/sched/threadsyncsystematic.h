@@ -4,8 +4,11 @@
 #pragma once
 #include "test/logging.h"
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 /**
  * This file contains the synchronisation implementation for suspending
@@ -27,6 +30,9 @@ namespace verona::rt
     /// ignore.
     size_t unpause_incarnation = 0;
 
+    /// Paused threads that can be woken by `unpause_one`.
+    std::vector<T*> waiters;
+
     void acquire()
     {
       auto guard = [&]() { return !m; };
@@ -37,6 +43,7 @@ namespace verona::rt
   public:
     class ThreadSyncHandle
     {
+      T* me;
       ThreadSyncSystematic& sync;
       bool wake_on_exit = false;
 
@@ -59,11 +66,15 @@ namespace verona::rt
         assert(sync.m == true);
         sync.m = false;
 
+        sync.waiters.push_back(me);
+
         auto incarnation = sync.unpause_incarnation;
         // Copy for capture by value
         auto sync_ptr = &sync;
-        auto guard = [incarnation, sync_ptr]() {
-          return incarnation != sync_ptr->unpause_incarnation;
+        auto thread = me;
+        auto guard = [incarnation, sync_ptr, thread]() {
+          return (incarnation != sync_ptr->unpause_incarnation) ||
+            !sync_ptr->is_waiting(thread);
         };
         // Guard should not hold here.
         assert(!guard());
@@ -72,7 +83,21 @@ namespace verona::rt
         sync.acquire();
       }
 
-      ThreadSyncHandle(ThreadSyncSystematic& sync) : sync(sync) {}
+      /**
+       * Pause this thread for at most `timeout`. Time does not advance
+       * predictably under systematic testing, so this only yields.
+       */
+      void pause_for(std::chrono::nanoseconds timeout)
+      {
+        UNUSED(timeout);
+        assert(sync.m == true);
+        sync.m = false;
+        Systematic::yield();
+        sync.acquire();
+      }
+
+      ThreadSyncHandle(T* me, ThreadSyncSystematic& sync) : me(me), sync(sync)
+      {}
 
       ~ThreadSyncHandle()
       {
@@ -84,6 +109,7 @@ namespace verona::rt
           // Treat as a yield pointer if thread is under systematic testing
           // control.
           sync.unpause_incarnation++;
+          sync.waiters.clear();
           Systematic::yield();
         }
       }
@@ -97,9 +123,8 @@ namespace verona::rt
      */
     ThreadSyncHandle handle(T* me)
     {
-      UNUSED(me);
       acquire();
-      return ThreadSyncHandle(*this);
+      return ThreadSyncHandle(me, *this);
     }
 
     /**
@@ -109,5 +134,43 @@ namespace verona::rt
     {
       handle(me).unpause_all();
     }
+
+    /**
+     * This unpauses the paused thread whose core is nearest to `near`.
+     */
+    template<typename C>
+    void unpause_one(T* me, C* near)
+    {
+      auto h = handle(me);
+
+      auto best = waiters.end();
+      size_t best_rank = SIZE_MAX;
+      for (auto it = waiters.begin(); it != waiters.end(); it++)
+      {
+        size_t rank = near->wake_rank((*it)->core);
+        if (rank < best_rank)
+        {
+          best = it;
+          best_rank = rank;
+        }
+      }
+
+      if (best != waiters.end())
+        waiters.erase(best);
+    }
+
+    /**
+     * Returns true if some thread may be paused.
+     */
+    bool has_waiters()
+    {
+      return !waiters.empty();
+    }
+
+  private:
+    bool is_waiting(T* t)
+    {
+      return std::find(waiters.begin(), waiters.end(), t) != waiters.end();
+    }
   };
 }
@@ -0,0 +1,194 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * An entry of a `TimerWheel`. `fire` is called once the wheel reaches
+   * `due`, and is responsible for freeing the timer.
+   */
+  struct Timer
+  {
+    Timer* next = nullptr;
+    /// Tick at which the timer fires.
+    uint64_t due = 0;
+    void (*fire)(Timer*) = nullptr;
+  };
+
+  /**
+   * A hierarchical timer wheel, with `LEVELS` levels of 64 slots.
+   *
+   * A timer is placed in the lowest level whose span covers the highest bit
+   * in which its due tick differs from the current tick, and moved down a
+   * level each time the wheel reaches the start of its slot, until it fires
+   * from level 0. Adding a timer is constant time, and advancing costs a
+   * constant per tick plus a constant per timer moved or fired.
+   *
+   * Timers due further ahead than the wheel spans are kept in a separate
+   * list, which is re-examined whenever the wheel reaches the start of a slot
+   * of the top level.
+   *
+   * The wheel is owned by one scheduler thread, and is not thread safe.
+   */
+  class TimerWheel
+  {
+    static constexpr size_t LEVEL_BITS = 6;
+    static constexpr size_t SLOTS = 1 << LEVEL_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr size_t LEVELS = 4;
+
+    Timer* slots[LEVELS][SLOTS] = {};
+    /// Timers due beyond the span of the wheel.
+    Timer* far = nullptr;
+    /// The last tick processed. Every timer due at or before it has fired.
+    uint64_t now = 0;
+    size_t count = 0;
+
+    static size_t shift(size_t level)
+    {
+      return level * LEVEL_BITS;
+    }
+
+    void place(Timer* t)
+    {
+      uint64_t diff = t->due ^ now;
+      size_t level = 0;
+      if (diff != 0)
+        level = (63 - snmalloc::bits::clz(diff)) / LEVEL_BITS;
+
+      Timer** head;
+      if (level >= LEVELS)
+        head = &far;
+      else
+        head = &slots[level][(t->due >> shift(level)) & SLOT_MASK];
+
+      t->next = *head;
+      *head = t;
+    }
+
+    void replace_all(Timer* list)
+    {
+      while (list != nullptr)
+      {
+        Timer* next = list->next;
+        place(list);
+        list = next;
+      }
+    }
+
+  public:
+    bool empty() const
+    {
+      return count == 0;
+    }
+
+    size_t size() const
+    {
+      return count;
+    }
+
+    /**
+     * Set the current tick of an empty wheel.
+     */
+    void reset(uint64_t tick)
+    {
+      assert(empty());
+      now = tick;
+    }
+
+    /**
+     * Add `t`. A timer that is already due fires on the next tick.
+     */
+    void add(Timer* t)
+    {
+      if (t->due <= now)
+        t->due = now + 1;
+      count++;
+      place(t);
+    }
+
+    /**
+     * Fire every timer due up to `tick`, in order of due tick, passing each
+     * to `fire`. Returns the number of timers fired.
+     */
+    template<typename F>
+    size_t advance(uint64_t tick, F&& fire)
+    {
+      size_t fired = 0;
+      while (now < tick)
+      {
+        if (count == 0)
+        {
+          now = tick;
+          break;
+        }
+
+        now++;
+
+        // Move the timers of the slots that this tick starts down a level.
+        for (size_t level = 1; level < LEVELS; level++)
+        {
+          if ((now & ((uint64_t(1) << shift(level)) - 1)) != 0)
+            break;
+
+          auto& slot = slots[level][(now >> shift(level)) & SLOT_MASK];
+          Timer* list = slot;
+          slot = nullptr;
+          replace_all(list);
+
+          if (level == LEVELS - 1)
+          {
+            list = far;
+            far = nullptr;
+            replace_all(list);
+          }
+        }
+
+        auto& slot = slots[0][now & SLOT_MASK];
+        Timer* list = slot;
+        slot = nullptr;
+        while (list != nullptr)
+        {
+          Timer* next = list->next;
+          assert(list->due == now);
+          count--;
+          fired++;
+          fire(list);
+          list = next;
+        }
+      }
+      return fired;
+    }
+
+    /**
+     * A tick by which the next timer is due, and no later than the tick at
+     * which it must be moved down a level. This may be earlier than the
+     * timer is due. Returns UINT64_MAX if the wheel is empty.
+     */
+    uint64_t next_due() const
+    {
+      if (count == 0)
+        return UINT64_MAX;
+
+      for (size_t level = 0; level < LEVELS; level++)
+      {
+        uint64_t digit = (now >> shift(level)) & SLOT_MASK;
+        for (uint64_t i = digit + 1; i < SLOTS; i++)
+        {
+          if (slots[level][i] != nullptr)
+          {
+            uint64_t group = now >> shift(level + 1) << shift(level + 1);
+            return group | (i << shift(level));
+          }
+        }
+      }
+
+      // Only far timers, which are examined at the next slot of the top level.
+      return ((now >> shift(LEVELS - 1)) + 1) << shift(LEVELS - 1);
+    }
+  };
+} // namespace verona::rt
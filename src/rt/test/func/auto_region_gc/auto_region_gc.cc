@@ -0,0 +1,108 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the automatic collection of regions held by cowns, see
+ * `Cown::collect_regions`, and the heuristics deciding when to collect, see
+ * `GCPolicy`.
+ *
+ * A chain of behaviours on a cown each allocate garbage in the trace region
+ * held by the cown. With automatic collection, each behaviour allocates
+ * enough for the region to be collected when it completes, so the next
+ * behaviour only finds the live objects. Without it, the garbage accumulates.
+ */
+#include <test/harness.h>
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct RegionCown : public VCown<RegionCown>
+{
+  Node* root;
+
+  RegionCown() : root(new (RegionType::Trace) Node) {}
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(root);
+  }
+};
+
+static constexpr size_t live = 10;
+static constexpr size_t garbage = 20000;
+static constexpr size_t rounds = 10;
+
+void allocate(RegionCown* c, size_t round, bool collected)
+{
+  UsingRegion rr(c->root);
+
+  if (round == 0)
+  {
+    check(debug_size() == 1);
+    for (size_t i = 0; i < live; i++)
+    {
+      auto n = new Node;
+      n->next = c->root->next;
+      c->root->next = n;
+    }
+  }
+  else
+  {
+    size_t expected = 1 + live + (collected ? 0 : round * garbage);
+    check(debug_size() == expected);
+  }
+
+  for (size_t i = 0; i < garbage; i++)
+    new Node;
+
+  if (round + 1 < rounds)
+    schedule_lambda(
+      c, [c, round, collected]() { allocate(c, round + 1, collected); });
+}
+
+void test_auto_region_gc(bool collected)
+{
+  Scheduler::set_auto_region_gc(collected);
+
+  auto c = new RegionCown;
+  schedule_lambda(c, [c, collected]() { allocate(c, 0, collected); });
+  Cown::release(ThreadAlloc::get(), c);
+}
+
+void test_policy()
+{
+  constexpr size_t min = GCPolicy::MIN_SIZE;
+
+  // Without a budget, a region is collected when its usage doubles.
+  check(!GCPolicy::should_collect(2 * min, 0));
+  check(GCPolicy::should_collect(2 * min + 1, 0));
+  check(!GCPolicy::should_collect(8 * min, 4 * min));
+  check(GCPolicy::should_collect(8 * min + 1, 4 * min));
+
+  // Over the budget, a region is collected whenever it grows.
+  GCPolicy::set_memory_budget(1);
+  check(!GCPolicy::should_collect(min, 0));
+  check(GCPolicy::should_collect(min + 1, 0));
+  check(GCPolicy::should_collect(4 * min + 1, 4 * min));
+  GCPolicy::set_memory_budget(0);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  test_policy();
+
+  harness.run(test_auto_region_gc, true);
+  harness.run(test_auto_region_gc, false);
+
+  return 0;
+}
@@ -7,6 +7,8 @@
 #include "unordered_set"
 #include "verona.h"
 
+#include <vector>
+
 using namespace snmalloc;
 using namespace verona::rt;
 
@@ -110,8 +112,98 @@ void test_bag_base()
   }
 }
 
+void test_bag_compact()
+{
+  using E = BagElem<uintptr_t, uintptr_t>;
+  using B = BagBase<E, Alloc>;
+  auto& alloc = ThreadAlloc::get();
+
+  // Enough elements to span several blocks.
+  const uintptr_t NUM_OBJECTS = 1000;
+
+  {
+    B bag;
+    std::vector<E*> items;
+    for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+      items.push_back(bag.insert({nullptr, i}, alloc));
+
+    // Leave holes everywhere, including at the end of the bag and in whole
+    // blocks.
+    for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+    {
+      if ((i % 3 != 0) || (i > 500 && i < 800) || (i > 990))
+        bag.remove(items[i]);
+    }
+
+    size_t moved = 0;
+    bag.compact(alloc, [&](E* e) {
+      items[e->metadata] = e;
+      moved++;
+    });
+    check(moved > 0);
+
+    // Every remaining element is still reachable from its handle, and the
+    // iterator sees no holes.
+    std::unordered_set<uintptr_t> seen;
+    for (auto entry : bag)
+    {
+      check(items[entry->metadata] == entry);
+      seen.insert(entry->metadata);
+    }
+    for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+    {
+      bool live = (i % 3 == 0) && !(i > 500 && i < 800) && !(i > 990);
+      check(seen.count(i) == (live ? 1 : 0));
+    }
+
+    // The freelist is empty after compaction, so new elements go at the end.
+    auto last = bag.insert({nullptr, NUM_OBJECTS}, alloc);
+    check(*bag.begin() == last);
+    bag.dealloc(alloc);
+  }
+
+  {
+    B bag;
+    std::vector<E*> items;
+    for (uintptr_t i = 0; i < NUM_OBJECTS; i++)
+      items.push_back(bag.insert({nullptr, i}, alloc));
+
+    // Remove from the front, the end and the middle.
+    size_t count = NUM_OBJECTS;
+    auto on_move = [&](E* e) { items[e->metadata] = e; };
+    for (uintptr_t i = 0; i < NUM_OBJECTS; i += 2)
+    {
+      bag.remove_compact(items[i], alloc, on_move);
+      count--;
+    }
+
+    size_t seen = 0;
+    for (auto entry : bag)
+    {
+      check(entry->metadata % 2 == 1);
+      check(items[entry->metadata] == entry);
+      seen++;
+    }
+    check(seen == count);
+
+    // Empty the bag completely, which frees all its blocks.
+    for (uintptr_t i = 1; i < NUM_OBJECTS; i += 2)
+      bag.remove_compact(items[i], alloc, on_move);
+
+    for (auto entry : bag)
+    {
+      UNUSED(entry);
+      check(false);
+    }
+    bag.dealloc(alloc);
+  }
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+}
+
 int main(int, char**)
 {
   test_bag_base();
+  test_bag_compact();
   return 0;
 }
@@ -0,0 +1,112 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the adaptive batch limit of `Cown::run`.
+ *
+ * A producer floods a cown using the default batch policy and a cown that
+ * overrides the policy through `VCown`. The test checks that the default
+ * limit stays within its bounds, and that the override is used for every
+ * batch after the first.
+ */
+#include <test/harness.h>
+
+static constexpr size_t message_count = 1000;
+static constexpr size_t fixed_limit = 3;
+
+static std::atomic<size_t> received = 0;
+static size_t expected = 0;
+
+struct Default : public VCown<Default>
+{};
+
+struct Fixed : public VCown<Fixed>
+{
+  size_t cown_batch_limit(size_t, bool, bool)
+  {
+    return fixed_limit;
+  }
+};
+
+struct Receive : public VBehaviour<Receive>
+{
+  Cown* c;
+
+  Receive(Cown* c) : c(c) {}
+
+  void f()
+  {
+    size_t limit = c->get_batch_limit();
+    if (c->get_descriptor() == Fixed::desc())
+    {
+      check((limit == Cown::initial_batch_limit) || (limit == fixed_limit));
+    }
+    else
+    {
+      check(
+        (limit >= Cown::min_batch_limit) && (limit <= Cown::max_batch_limit));
+    }
+    received++;
+  }
+};
+
+struct Produce : public VBehaviour<Produce>
+{
+  Cown* a;
+  Cown* b;
+
+  Produce(Cown* a, Cown* b) : a(a), b(b) {}
+
+  void f()
+  {
+    for (size_t i = 0; i < message_count; i++)
+    {
+      Cown::schedule<Receive>(a, a);
+      Cown::schedule<Receive>(b, b);
+    }
+
+    auto& alloc = ThreadAlloc::get();
+    Cown::release(alloc, a);
+    Cown::release(alloc, b);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(a);
+    st.push(b);
+  }
+};
+
+void test_policy()
+{
+  using C = Cown;
+  check(C::next_batch_limit(100, true, false) == 200);
+  check(C::next_batch_limit(100, false, false) == 100);
+  check(C::next_batch_limit(100, true, true) == 50);
+  check(C::next_batch_limit(100, false, true) == 50);
+  check(
+    C::next_batch_limit(C::max_batch_limit, true, false) == C::max_batch_limit);
+  check(
+    C::next_batch_limit(C::min_batch_limit, true, true) == C::min_batch_limit);
+}
+
+void test_batch_limit()
+{
+  // Check the previous seed ran to completion.
+  check(received == expected);
+  received = 0;
+  expected = 2 * message_count;
+
+  auto* producer = new Default;
+  Cown::schedule<Produce>(producer, new Default, new Fixed);
+  Cown::release(ThreadAlloc::get(), producer);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  test_policy();
+  harness.run(test_batch_limit);
+  check(received == expected);
+  return 0;
+}
@@ -0,0 +1,128 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests biased reference counting of immutables, see
+ * `Immutable::acquire_biased`. Biased references are only counted by the
+ * thread that took them, and are merged into the shared reference count when
+ * flushed, explicitly or by a scheduler thread after running a cown. The
+ * harness checks that nothing leaks.
+ */
+#include <test/harness.h>
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+Node* make_immutable()
+{
+  auto* o = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(o);
+    o->next = new Node;
+    o->next->next = o;
+  }
+  freeze(o);
+  return o;
+}
+
+void test_counts()
+{
+  auto& alloc = ThreadAlloc::get();
+  auto* o = make_immutable();
+  check(o->debug_test_rc(1));
+
+  // The first biased reference takes one shared reference, whichever object
+  // of the SCC it is taken through.
+  Immutable::acquire_biased(o);
+  Immutable::acquire_biased(o->next);
+  Immutable::acquire_biased(o);
+  check(o->debug_test_rc(2));
+
+  for (size_t i = 0; i < 3; i++)
+    Immutable::release_biased(alloc, o);
+  check(o->debug_test_rc(2));
+
+  // Once there are no biased references, flushing drops the shared one.
+  Immutable::flush_biased(alloc);
+  check(o->debug_test_rc(1));
+
+  // Biased references still held when flushing become shared references.
+  Immutable::acquire_biased(o);
+  Immutable::acquire_biased(o);
+  Immutable::flush_biased(alloc);
+  check(o->debug_test_rc(3));
+  Immutable::release_biased(alloc, o);
+  Immutable::release(alloc, o);
+  check(o->debug_test_rc(1));
+
+  Immutable::release(alloc, o);
+}
+
+void test_eviction()
+{
+  auto& alloc = ThreadAlloc::get();
+  static constexpr size_t count = Immutable::BIASED_ENTRIES * 2;
+  Node* os[count];
+  for (auto& o : os)
+    o = make_immutable();
+
+  // More roots than entries, so some evict others, which must not lose any
+  // references.
+  for (auto o : os)
+  {
+    Immutable::acquire_biased(o);
+    Immutable::acquire_biased(o);
+  }
+
+  for (auto o : os)
+  {
+    Immutable::release_biased(alloc, o);
+    Immutable::release_biased(alloc, o);
+  }
+
+  Immutable::flush_biased(alloc);
+  for (auto o : os)
+  {
+    check(o->debug_test_rc(1));
+    Immutable::release(alloc, o);
+  }
+}
+
+/**
+ * A behaviour drops the last shared reference while it holds a biased one,
+ * so the immutable is only freed when the scheduler flushes the biased counts
+ * after running the cown.
+ */
+void test_scheduler_flush()
+{
+  auto* o = make_immutable();
+  schedule_lambda([o]() {
+    auto& alloc = ThreadAlloc::get();
+    Immutable::acquire_biased(o);
+    Immutable::release(alloc, o);
+    check(o->debug_test_rc(1));
+    Immutable::release_biased(alloc, o);
+  });
+}
+
+void test_biased_rc()
+{
+  test_counts();
+  test_eviction();
+  test_scheduler_flush();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_biased_rc);
+  return 0;
+}
@@ -0,0 +1,120 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests streaming immutables through a `Broadcast`.
+ *
+ * A source cown publishes a numbered sequence of frozen messages, one per
+ * behaviour, into a small ring. Subscriber cowns poll the ring and check that
+ * they see the messages in order, with gaps only where `read` reported that
+ * they lagged, and that every message is either read or counted as missed.
+ * The harness checks that every message is released.
+ */
+#include <test/harness.h>
+
+static constexpr size_t messages = 100;
+static constexpr size_t subscribers = 4;
+
+struct Msg : public V<Msg>
+{
+  size_t index;
+
+  Msg(size_t index) : index(index) {}
+};
+
+struct Source : public VCown<Source>
+{
+  Broadcast<Msg, 8> channel;
+  size_t published = 0;
+
+  void trace(ObjectStack& st) const
+  {
+    channel.trace(st);
+  }
+};
+
+struct Subscriber : public VCown<Subscriber>
+{
+  Source* source;
+  Broadcast<Msg, 8>::Subscription sub;
+  size_t received = 0;
+  size_t expected = 0;
+  size_t polls = 0;
+
+  Subscriber(Source* source)
+  : source(source), sub(source->channel.subscribe())
+  {
+    Cown::acquire(source);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(source);
+  }
+};
+
+void publish(Source* s)
+{
+  auto msg = new (RegionType::Trace) Msg(s->published++);
+  freeze(msg);
+  s->channel.publish(ThreadAlloc::get(), msg);
+
+  if (s->published < messages)
+    schedule_lambda(s, [s]() { publish(s); });
+}
+
+void poll(Subscriber* r)
+{
+  auto& alloc = ThreadAlloc::get();
+  Msg* msg;
+  size_t missed = r->sub.missed;
+
+  while (true)
+  {
+    auto result = r->source->channel.read(alloc, r->sub, msg);
+    if (result == BroadcastRead::Empty)
+      break;
+
+    if (result == BroadcastRead::Lagged)
+    {
+      check(r->sub.missed > missed);
+      r->expected += r->sub.missed - missed;
+      missed = r->sub.missed;
+      continue;
+    }
+
+    check(msg->index == r->expected);
+    r->expected++;
+    r->received++;
+    Immutable::release(alloc, msg);
+  }
+
+  if (r->received + r->sub.missed < messages)
+  {
+    check(++r->polls < 10'000'000);
+    schedule_lambda(r, [r]() { poll(r); });
+  }
+}
+
+void test_broadcast()
+{
+  auto& alloc = ThreadAlloc::get();
+  auto s = new Source;
+
+  for (size_t i = 0; i < subscribers; i++)
+  {
+    auto r = new Subscriber(s);
+    schedule_lambda(r, [r]() { poll(r); });
+    Cown::release(alloc, r);
+  }
+
+  schedule_lambda(s, [s]() { publish(s); });
+  Cown::release(alloc, s);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_broadcast);
+  return 0;
+}
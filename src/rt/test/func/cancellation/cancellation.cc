@@ -0,0 +1,93 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests dropping behaviours that expire before they run, see
+ * `When::with_deadline` and `When::with_cancellation`.
+ *
+ * Behaviours that have expired by the time they acquire their cowns must not
+ * run, but their closure state must still be destroyed, and the following
+ * behaviours on the same cowns must still run.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::atomic<size_t> live_state = 0;
+
+/// Closure state that tracks whether it has been destroyed.
+struct State
+{
+  State()
+  {
+    live_state++;
+  }
+
+  State(const State&)
+  {
+    live_state++;
+  }
+
+  ~State()
+  {
+    live_state--;
+  }
+};
+
+void test_cancellation()
+{
+  // Check the previous seed destroyed all the closure state.
+  check(live_state == 0);
+
+  auto a = make_cown<Counter>();
+  auto b = make_cown<Counter>();
+  auto past = std::chrono::steady_clock::now();
+  auto future = past + std::chrono::hours(1);
+
+  when(a).with_deadline(past) <<
+    [s = State()](acquired_cown<Counter>) { check(false); };
+
+  when(a, b).with_deadline(future) <<
+    [s = State()](acquired_cown<Counter> a, acquired_cown<Counter> b) {
+      a->count++;
+      b->count++;
+    };
+
+  cancellation_token cancelled;
+  cancelled.cancel();
+  when(a, b).with_cancellation(cancelled) <<
+    [s = State()](acquired_cown<Counter>, acquired_cown<Counter>) {
+      check(false);
+    };
+
+  // Cancel a behaviour that is queued behind the running one.
+  cancellation_token token;
+  when(b) << [token](acquired_cown<Counter> b) mutable {
+    b->count++;
+    token.cancel();
+  };
+  when(b).with_cancellation(token) <<
+    [s = State()](acquired_cown<Counter>) { check(false); };
+
+  when().with_deadline(past) << [s = State()]() { check(false); };
+
+  when(read(a), read(b)) <<
+    [](acquired_cown<const Counter> a, acquired_cown<const Counter> b) {
+      check(a->count == 1);
+      check(b->count == 2);
+    };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_cancellation);
+  check(live_state == 0);
+  return 0;
+}
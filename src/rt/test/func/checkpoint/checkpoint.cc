@@ -0,0 +1,130 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests taking a consistent checkpoint of the regions held by cowns,
+ * see `checkpoint`.
+ *
+ * Each account holds its balance as a list of coins in a region. Transfers
+ * take a coin from the region of one account and add one to that of
+ * another, while checkpoints of all the accounts are taken. Each checkpoint
+ * is loaded back, and must hold every coin exactly once, as it sees either
+ * all or none of each transfer.
+ */
+#include "test/xoroshiro.h"
+
+#include <cpp/checkpoint.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t accounts = 16;
+static constexpr size_t coins = 10;
+static constexpr size_t transfers = 200;
+static constexpr size_t checkpoints = 5;
+
+struct Coin : public V<Coin>
+{
+  Coin* next = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Account
+{
+  Coin* root;
+
+  Account() : root(new (RegionType::Trace) Coin)
+  {
+    UsingRegion rr(root);
+    for (size_t i = 0; i < coins; i++)
+      deposit(new Coin);
+  }
+
+  ~Account()
+  {
+    region_release(root);
+  }
+
+  void deposit(Coin* c)
+  {
+    c->next = root->next;
+    root->next = c;
+  }
+};
+
+static size_t count_coins(Coin* root)
+{
+  size_t n = 0;
+  for (Coin* c = root->next; c != nullptr; c = c->next)
+    n++;
+  return n;
+}
+
+void check_checkpoint(Checkpoint<Account> c)
+{
+  const Descriptor* descriptors[] = {Coin::desc()};
+  check(c.ok());
+  check(c.cowns.size() == accounts);
+
+  size_t total = 0;
+  for (size_t i = 0; i < c.images.size(); i++)
+  {
+    auto* root = (Coin*)c.restore(i, descriptors, 1);
+    check(root != nullptr);
+    total += count_coins(root);
+    region_release(root);
+  }
+  check(total == accounts * coins);
+}
+
+void test_checkpoint(SystematicTestHarness* harness)
+{
+  static const Descriptor* descriptors[] = {Coin::desc()};
+  auto all = make_cowns<Account>(accounts);
+
+  xoroshiro::p128r32 rng(harness->current_seed());
+  for (size_t t = 0; t < transfers; t++)
+  {
+    size_t from = rng.next() % accounts;
+    size_t to = rng.next() % accounts;
+    if (from == to)
+      continue;
+
+    // The coin is dropped from one region, where it is left as garbage, and
+    // a new one is allocated in the other.
+    when(all[from], all[to])
+      << [](acquired_cown<Account> a, acquired_cown<Account> b) {
+           {
+             UsingRegion rr(a->root);
+             Coin* c = a->root->next;
+             if (c == nullptr)
+               return;
+             a->root->next = c->next;
+           }
+           UsingRegion rr(b->root);
+           b->deposit(new Coin);
+         };
+
+    if ((t % (transfers / checkpoints)) == 0)
+    {
+      checkpoint(
+        all,
+        descriptors,
+        1,
+        [](const Account& a) { return a.root; },
+        check_checkpoint);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_checkpoint, &harness);
+  return 0;
+}
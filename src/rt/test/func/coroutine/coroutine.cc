@@ -0,0 +1,111 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests coroutine behaviours, see `cpp/coroutine.h`. They need a C++20
+ * build, so this test does nothing otherwise.
+ *
+ * Coroutines await promises and the cowns of `when`s, and check that they
+ * are resumed with the value of the promise, or with the cowns acquired in
+ * order with the other behaviours on those cowns. A coroutine whose `when`
+ * expires must be destroyed rather than resumed.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+#ifdef USE_COROUTINES
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+static std::atomic<size_t> completed = 0;
+static std::atomic<size_t> live_frames = 0;
+
+/// Counts the coroutine frames that have not been destroyed.
+struct Frame
+{
+  Frame()
+  {
+    live_frames++;
+  }
+
+  ~Frame()
+  {
+    live_frames--;
+  }
+};
+
+behaviour_coroutine
+chain(cown_ptr<Counter> a, cown_ptr<Counter> b, Promise<int>::PromiseR r)
+{
+  Frame frame;
+
+  auto v = co_await std::move(r);
+  check(std::holds_alternative<int>(v));
+  int value = std::get<int>(v);
+
+  {
+    acquired_cown<Counter> acq = co_await when(a);
+    acq->count += value;
+  }
+
+  {
+    auto [acq_a, acq_b] = co_await when(a, read(b));
+    check(acq_a.count >= (size_t)value);
+    check(acq_b.count == 1);
+    acq_a.count++;
+  }
+
+  co_await when();
+  completed++;
+}
+
+behaviour_coroutine expired(cown_ptr<Counter> a)
+{
+  Frame frame;
+
+  co_await when(a).with_deadline(std::chrono::steady_clock::now());
+  check(false);
+}
+
+void test_coroutine()
+{
+  // Check the previous seed completed all the coroutines.
+  check(live_frames == 0);
+  completed = 0;
+
+  auto a = make_cown<Counter>();
+  auto b = make_cown<Counter>();
+
+  when(b) << [](acquired_cown<Counter> b) { b->count++; };
+
+  for (int i = 1; i <= 3; i++)
+  {
+    auto pp = Promise<int>::create_promise();
+    chain(a, b, std::move(pp.first));
+
+    schedule_lambda([wp = std::move(pp.second), i]() mutable {
+      Promise<int>::fulfill(std::move(wp), std::move(i));
+    });
+  }
+
+  expired(a);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_coroutine);
+  check(completed == 3);
+  check(live_frames == 0);
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#ifndef USE_COWN_PROFILER
+#  define USE_COWN_PROFILER
+#endif
+
+/**
+ * This tests the cown contention profiler, see `CownProfiler`.
+ *
+ * Before the scheduler threads start, a burst of behaviours is queued on a
+ * hot cown, followed by behaviours on the hot cown and each of a few other
+ * cowns. The other cown, or the hot cown, of each of those is held while it
+ * waits for the other. A last behaviour on the hot cown checks that the
+ * queue of the hot cown and the waits have been reported.
+ */
+#include <cpp/when.h>
+#include <sstream>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t burst = 64;
+static constexpr size_t others = 8;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_profile()
+{
+  size_t max_queue = 0;
+  size_t blocked = 0;
+  for (auto& e : CownProfiler::top(CownProfiler::CAPACITY))
+  {
+    check(e.descriptor != nullptr);
+    max_queue = std::max(max_queue, e.max_queue);
+    blocked += e.blocked;
+  }
+
+  check(max_queue >= burst);
+  check(blocked >= others);
+
+  // The cowns that waited are still tracked, as they were not idle before
+  // the previous report.
+  std::stringstream o;
+  CownProfiler::report(o, 1);
+  check(o.str().find("Contended cowns: 1") != std::string::npos);
+}
+
+void test_cown_profiler()
+{
+  CownProfiler::clear();
+  CownProfiler::set_queue_threshold(1);
+
+  auto hot = make_cown<Counter>();
+  for (size_t i = 0; i < burst; i++)
+    when(hot) << [](acquired_cown<Counter> h) { h->count++; };
+
+  for (size_t i = 0; i < others; i++)
+  {
+    auto other = make_cown<Counter>();
+    when(hot, other) << [](acquired_cown<Counter> h, acquired_cown<Counter> o) {
+      h->count++;
+      o->count++;
+    };
+  }
+
+  when(hot) << [](acquired_cown<Counter> h) {
+    check(h->count == burst + others);
+    check_profile();
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_cown_profiler);
+  return 0;
+}
@@ -0,0 +1,51 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests borrowed references to cowns, see `cown_ref`.
+ *
+ * A behaviour borrows the cown it holds, and schedules more behaviours on it
+ * through the borrowed reference, for writing and for reading. One reference
+ * is turned back into a `cown_ptr` and kept by a closure. The leak detector
+ * checks that no reference count was lost or leaked.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void test_cown_ref()
+{
+  auto c = make_cown<Counter>();
+  cown_ref<Counter> borrowed = c;
+  check(borrowed == cown_ref<Counter>(c));
+  check(!(borrowed == nullptr));
+
+  when(borrowed) << [](acquired_cown<Counter> c) {
+    c->count++;
+    cown_ref<Counter> self = c.ref();
+
+    for (size_t i = 0; i < 10; i++)
+      when(self) << [](acquired_cown<Counter> c) { c->count++; };
+
+    when(self.read()) << [](acquired_cown<const Counter> c) {
+      check(c->count == 11);
+    };
+
+    when() << [kept = self.to_ptr()]() {
+      when(kept) << [](acquired_cown<Counter> c) { check(c->count == 11); };
+    };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_cown_ref);
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests that `Cown::schedule` merges repeated requests for a cown.
+ *
+ * Behaviours are scheduled on request arrays that name the same cowns
+ * several times, for reading and writing, in any order. Each behaviour
+ * checks that it holds each cown once, in address order, for writing if any
+ * request for it was a write, and that writers are mutually exclusive. Some
+ * behaviours are given a reference count for every request, including the
+ * repeated ones, which the runtime must release.
+ */
+#include <test/harness.h>
+
+static constexpr size_t cown_count = 4;
+
+struct Counter : public VCown<Counter>
+{
+  std::atomic<size_t> writers = 0;
+};
+
+static Counter* counters[cown_count];
+
+/// The cowns a behaviour should hold, and whether it writes them.
+struct Expected
+{
+  size_t count = 0;
+  Cown* cowns[cown_count];
+  bool writes[cown_count];
+};
+
+struct Check : public VBehaviour<Check>
+{
+  size_t expected_count;
+  Cown* expected[cown_count];
+  bool writes[cown_count];
+
+  Check(const Expected& e) : expected_count(e.count)
+  {
+    for (size_t j = 0; j < e.count; j++)
+    {
+      expected[j] = e.cowns[j];
+      writes[j] = e.writes[j];
+    }
+  }
+
+  void f()
+  {
+    auto* body = Scheduler::local()->message_body;
+    auto* requests = body->get_requests_array();
+    check(body->count == expected_count);
+
+    for (size_t i = 0; i < body->count; i++)
+    {
+      if (i > 0)
+        check(requests[i - 1].cown() != requests[i].cown());
+
+      size_t j = 0;
+      while (expected[j] != requests[i].cown())
+        j++;
+      check(requests[i].is_read() == !writes[j]);
+
+      if (writes[j])
+        check(((Counter*)expected[j])->writers++ == 0);
+    }
+
+    yield();
+
+    for (size_t j = 0; j < expected_count; j++)
+    {
+      if (writes[j])
+        ((Counter*)expected[j])->writers--;
+    }
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    for (size_t j = 0; j < expected_count; j++)
+      st.push(expected[j]);
+  }
+};
+
+template<TransferOwnership transfer>
+void schedule(std::vector<Request> requests)
+{
+  Expected e;
+  for (auto r : requests)
+  {
+    if constexpr (transfer == YesTransfer)
+      Cown::acquire(r.cown());
+
+    size_t j = 0;
+    while ((j < e.count) && (e.cowns[j] != r.cown()))
+      j++;
+    if (j == e.count)
+    {
+      e.cowns[j] = r.cown();
+      e.writes[j] = false;
+      e.count++;
+    }
+    e.writes[j] |= !r.is_read();
+  }
+
+  Cown::schedule<Check, transfer>(requests.size(), requests.data(), e);
+}
+
+void test_dedup()
+{
+  for (auto& c : counters)
+    c = new Counter;
+
+  auto [a, b, c, d] = counters;
+  auto r = [](Cown* c) { return Request::read(c); };
+  auto w = [](Cown* c) { return Request::write(c); };
+  for (size_t i = 0; i < 10; i++)
+  {
+    schedule<NoTransfer>({w(a), w(a)});
+    schedule<NoTransfer>({r(a), r(b), r(a)});
+    schedule<NoTransfer>({r(c), w(b), w(c), r(b)});
+    schedule<YesTransfer>({w(d), r(a), w(d), r(d)});
+    schedule<YesTransfer>({r(a), r(b), r(c), r(d), w(b), r(a)});
+  }
+
+  auto& alloc = ThreadAlloc::get();
+  for (auto* c : counters)
+    Cown::release(alloc, c);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_dedup);
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests an elastic scheduler pool, see `ThreadPool::set_elastic`.
+ *
+ * An external thread sends bursts of work to a number of cowns, with pauses
+ * between the bursts in which the pool can shrink. Each burst needs the pool
+ * to grow again. The test checks that every behaviour runs, that the pool
+ * shrinks to a single serving thread before each burst and after the last
+ * one, and that it grows during each burst when there is more than one core.
+ */
+#include <random>
+#include <test/harness.h>
+
+static constexpr size_t cown_count = 8;
+static constexpr size_t burst_size = 50;
+
+static std::atomic<size_t> received = 0;
+static size_t expected = 0;
+static std::atomic<size_t> grown = 0;
+static size_t expected_grown = 0;
+
+/**
+ * Wait for up to `limit` for the number of serving scheduler threads to
+ * satisfy `pred`, and return whether it did. On a scheduler thread, this
+ * yields so that systematic testing runs the other threads.
+ */
+template<typename P>
+static bool wait_for_serving(P pred, std::chrono::milliseconds limit)
+{
+  auto start = std::chrono::steady_clock::now();
+  while (!pred(Scheduler::get_serving_thread_count()))
+  {
+    if ((std::chrono::steady_clock::now() - start) > limit)
+      return false;
+    if (Scheduler::local() != nullptr)
+      yield();
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return true;
+}
+
+struct A : public VCown<A>
+{};
+
+void test_elastic(SystematicTestHarness* harness, size_t bursts)
+{
+  // Check the previous seed ran to completion, and grew for every burst.
+  check(received == expected);
+  check(grown == expected_grown);
+  received = 0;
+  grown = 0;
+  expected = bursts * burst_size * cown_count;
+  expected_grown = (harness->cores == 1) ? 0 : bursts;
+
+  schedule_lambda([harness, bursts]() {
+    Scheduler::add_external_event_source();
+
+    A* cowns[cown_count];
+    for (size_t i = 0; i < cown_count; i++)
+      cowns[i] = new A;
+
+    size_t cores = harness->cores;
+    harness->external_thread([bursts, cowns, cores]() {
+      std::mt19937 rng;
+      rng.seed(1);
+      std::uniform_int_distribution<> dist(1, 20);
+      for (size_t b = 0; b < bursts; b++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(dist(rng)));
+
+        // The pool is idle, so all but one thread retire.
+        check(wait_for_serving(
+          [](size_t n) { return n == 1; }, std::chrono::seconds(10)));
+
+        // The first behaviour of the burst holds the only serving thread
+        // until the rest of the burst has woken another one.
+        schedule_lambda(cowns[0], [cores]() {
+          if (cores == 1)
+            return;
+          if (wait_for_serving(
+                [](size_t n) { return n > 1; }, std::chrono::seconds(10)))
+            grown++;
+        });
+
+        for (size_t j = 0; j < burst_size; j++)
+        {
+          for (auto* a : cowns)
+            schedule_lambda(a, []() { received++; });
+        }
+      }
+
+      // And shrinks again once the last burst is done.
+      std::this_thread::sleep_for(std::chrono::milliseconds(dist(rng)));
+      check(wait_for_serving(
+        [](size_t n) { return n == 1; }, std::chrono::seconds(10)));
+
+      for (auto* a : cowns)
+        schedule_lambda(a, [a]() { Cown::release(ThreadAlloc::get(), a); });
+
+      schedule_lambda([]() { Scheduler::remove_external_event_source(); });
+    });
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  size_t bursts = harness.opt.is<size_t>("--bursts", 5);
+
+  Scheduler::set_elastic(1);
+  harness.run(test_elastic, &harness, bursts);
+  check(received == expected);
+  check(grown == expected_grown);
+  Scheduler::set_elastic(SIZE_MAX);
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests sharing an immutable through an `EpochImmutable`.
+ *
+ * A config cown holds a frozen table, which behaviours on the config replace
+ * with newer versions. Readers on other cowns read the table within an epoch,
+ * without touching its reference count, and check that the versions they see
+ * never go backwards. The harness checks that every version is released.
+ */
+#include <test/harness.h>
+
+static constexpr size_t versions = 20;
+static constexpr size_t readers = 8;
+static constexpr size_t reads = 10;
+
+struct Table : public V<Table>
+{
+  size_t version;
+  Table* next = nullptr;
+
+  Table(size_t version) : version(version) {}
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+Table* make_table(size_t version)
+{
+  auto t = new (RegionType::Trace) Table(version);
+  {
+    UsingRegion rr(t);
+    t->next = new Table(version);
+  }
+  return freeze(t);
+}
+
+struct Config : public VCown<Config>
+{
+  EpochImmutable<Table> table;
+
+  Config() : table(make_table(0)) {}
+
+  void trace(ObjectStack& st) const
+  {
+    table.trace(st);
+  }
+};
+
+struct Reader : public VCown<Reader>
+{
+  Config* config;
+  size_t last = 0;
+
+  Reader(Config* config) : config(config)
+  {
+    Cown::acquire(config);
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(config);
+  }
+};
+
+void read(Reader* r)
+{
+  Epoch e(ThreadAlloc::get());
+  Table* t = r->config->table.read(e);
+  check(t->next->version == t->version);
+  check(t->version >= r->last);
+  check(t->version <= versions);
+  r->last = t->version;
+}
+
+void test_epoch_immutable()
+{
+  auto& alloc = ThreadAlloc::get();
+  auto config = new Config;
+
+  for (size_t i = 0; i < readers; i++)
+  {
+    auto r = new Reader(config);
+    for (size_t j = 0; j < reads; j++)
+      schedule_lambda(r, [r]() { read(r); });
+    Cown::release(alloc, r);
+  }
+
+  for (size_t v = 1; v <= versions; v++)
+  {
+    schedule_lambda(config, [config, v]() {
+      Epoch e(ThreadAlloc::get());
+      config->table.update(e, make_table(v));
+    });
+  }
+
+  Cown::release(alloc, config);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_epoch_immutable);
+  return 0;
+}
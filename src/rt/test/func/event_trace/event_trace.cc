@@ -0,0 +1,95 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the timeline of scheduling events, see `EventTrace`.
+ *
+ * With tracing on, behaviours run on one and on two cowns. The last one
+ * stops tracing, and checks that each earlier behaviour has started and
+ * ended, that the cowns of each were acquired and released, and that the
+ * export is a Chrome trace event document.
+ */
+#include <cpp/when.h>
+#include <sstream>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t behaviours = 50;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_trace()
+{
+  EventTrace::stop();
+
+  size_t starts = 0;
+  size_t ends = 0;
+  size_t acquires = 0;
+  size_t releases = 0;
+  EventTrace::for_each([&](size_t, const TraceBuffer::Entry& e) {
+    switch ((TraceEvent)e.kind)
+    {
+      case TraceEvent::BehaviourStart:
+        starts++;
+        break;
+      case TraceEvent::BehaviourEnd:
+        ends++;
+        break;
+      case TraceEvent::Acquire:
+        acquires++;
+        break;
+      case TraceEvent::Release:
+        releases++;
+        break;
+      default:
+        break;
+    }
+  });
+
+  // Each behaviour on `a` and `b` acquires and releases both cowns. The
+  // last behaviour has started, and acquired its cowns, but not ended.
+  check(starts >= (behaviours * 2) + 1);
+  check(ends >= behaviours * 2);
+  check(acquires >= (behaviours * 3) + 2);
+  check(releases >= behaviours * 3);
+
+  std::stringstream o;
+  EventTrace::write_chrome_json(o);
+  auto text = o.str();
+  check(text.find("\"traceEvents\":[") != text.npos);
+  check(text.find("\"name\":\"behaviour\",\"ph\":\"B\"") != text.npos);
+  check(text.find("\"name\":\"acquire\",\"ph\":\"i\"") != text.npos);
+}
+
+void test_event_trace()
+{
+  EventTrace::start();
+
+  auto a = make_cown<Counter>();
+  auto b = make_cown<Counter>();
+
+  for (size_t i = 0; i < behaviours; i++)
+  {
+    when(a) << [](acquired_cown<Counter> a) { a->count++; };
+    when(a, b) << [](acquired_cown<Counter> a, acquired_cown<Counter> b) {
+      a->count++;
+      b->count++;
+    };
+  }
+
+  when(a, b) << [](acquired_cown<Counter> a, acquired_cown<Counter>) {
+    check(a->count == behaviours * 2);
+    check_trace();
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_event_trace);
+  return 0;
+}
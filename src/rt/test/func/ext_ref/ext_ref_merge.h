@@ -59,9 +59,72 @@ namespace ext_ref_merge
     snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
   }
 
+  template<RegionType region_type>
+  void bulk_test()
+  {
+    using T = C;
+    static constexpr size_t count = 100;
+
+    auto& alloc = ThreadAlloc::get();
+    (void)alloc;
+
+    auto r1 = new (region_type) T;
+    ExternalRef* wref1;
+    {
+      UsingRegion ur(r1);
+      wref1 = create_external_reference(r1);
+    }
+
+    auto r2 = new (region_type) T;
+    Object* objects[count];
+    ExternalRef* wrefs[count];
+    {
+      UsingRegion ur(r2);
+      T* last = r2;
+      for (size_t i = 0; i < count; i++)
+      {
+        last->f1 = new T;
+        last = last->f1;
+        objects[i] = last;
+      }
+
+      create_external_references(objects, count, wrefs);
+      for (size_t i = 0; i < count; i++)
+      {
+        check(is_external_reference_valid(wrefs[i]));
+        check(use_external_reference(wrefs[i]) == objects[i]);
+      }
+    }
+
+    // r2 has more external references than r1, so the merge keeps its table.
+    {
+      UsingRegion ur(r1);
+      merge(r2);
+      r1->f1 = r2;
+
+      check(is_external_reference_valid(wref1));
+      check(use_external_reference(wref1) == r1);
+      for (size_t i = 0; i < count; i++)
+      {
+        check(is_external_reference_valid(wrefs[i]));
+        check(use_external_reference(wrefs[i]) == objects[i]);
+      }
+    }
+
+    Immutable::release(alloc, wref1);
+    for (auto wref : wrefs)
+      Immutable::release(alloc, wref);
+
+    region_release(r1);
+
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
   void run_test()
   {
     basic_test<RegionType::Trace>();
     basic_test<RegionType::Arena>();
+    bulk_test<RegionType::Trace>();
+    bulk_test<RegionType::Arena>();
   }
 }
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <vector>
+
 namespace verona::rt
 {
   /**
@@ -16,6 +18,16 @@ namespace verona::rt
 
     ~Topology(){};
 
+    /**
+     * Which CPUs to use. The helper ignores it.
+     */
+    struct Placement
+    {
+      std::vector<size_t> cpus;
+      bool hyperthreads = true;
+      std::vector<size_t> nodes;
+    };
+
     /**
      * Signals the the start of the Topology usage.
      * No calls should be made to Topology::get before calling this method.
@@ -29,10 +41,56 @@ namespace verona::rt
     {
       return index;
     }
+
+    void set_placement(const Placement&) {}
+
+    /**
+     * Returns the NUMA node of a CPU ID returned by Topology::get().
+     */
+    size_t numa_node(size_t)
+    {
+      return 0;
+    }
+
+    /**
+     * Returns the NUMA node of any CPU ID, such as one returned by
+     * cpu::current(), or the second argument if it is not known.
+     */
+    size_t numa_node_of(size_t, size_t)
+    {
+      return 0;
+    }
+
+    /**
+     * How far apart two CPUs are, used to order work stealing.
+     */
+    enum Distance : uint8_t
+    {
+      SameCore,
+      SameNode,
+      Remote
+    };
+
+    /**
+     * Returns the distance between two CPU IDs returned by Topology::get().
+     */
+    Distance distance(size_t, size_t)
+    {
+      return SameNode;
+    }
   };
 
   namespace cpu
   {
+    /**
+     * Returns the ID of the CPU the current thread is running on, or
+     * (size_t)-1 if it is not known.
+     */
+    inline size_t current()
+    {
+      return (size_t)-1;
+    }
+
     /**
      * Moves the current thread onto the CPU with the given ID.
      * This ID is one returned by Topology::get() earlier.
@@ -69,9 +69,87 @@ void basic_test()
   Cown::release(alloc, b);
 }
 
+/**
+ * A number of high priority cowns loop, while a normal priority cown also
+ * loops. The normal priority cown must make progress while the high priority
+ * cowns are still running.
+ */
+static constexpr int high_count = 4;
+static std::atomic<int> high_running = 0;
+static A* normal = nullptr;
+// Steps taken by `normal`, which the high priority cowns read without
+// holding it.
+static std::atomic<int> normal_steps = 0;
+
+struct HighLoop : public VBehaviour<HighLoop>
+{
+  A* a;
+  HighLoop(A* a) : a(a) {}
+
+  void f()
+  {
+    if (a->count-- > 0)
+    {
+      Cown::schedule<HighLoop>(a, a);
+      return;
+    }
+
+    if (--high_running == 0)
+    {
+      check(normal_steps > 0);
+      Cown::release(ThreadAlloc::get(), normal);
+    }
+  }
+};
+
+struct NormalLoop : public VBehaviour<NormalLoop>
+{
+  A* a;
+  NormalLoop(A* a) : a(a) {}
+
+  void f()
+  {
+    if ((a->count > 0) && (high_running > 0))
+    {
+      a->count--;
+      normal_steps++;
+      Cown::schedule<NormalLoop>(a, a);
+    }
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(a);
+  }
+};
+
+void priority_test()
+{
+  auto& alloc = ThreadAlloc::get();
+
+  // The count of the high priority cowns is large enough that they are
+  // always waiting, and `normal` is only run by starvation protection.
+  high_running = high_count;
+  normal_steps = 0;
+  normal = new A(high_count);
+  Cown::acquire(normal);
+  Cown::schedule<NormalLoop>(normal, normal);
+  Cown::release(alloc, normal);
+
+  for (int i = 0; i < high_count; i++)
+  {
+    auto a = new A(i);
+    a->count = start_count * 10;
+    a->set_priority(Priority::High);
+    Cown::schedule<HighLoop>(a, a);
+    Cown::release(alloc, a);
+  }
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
   harness.run(basic_test);
+  harness.run(priority_test);
   return 0;
 }
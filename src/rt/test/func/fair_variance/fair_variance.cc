@@ -20,6 +20,7 @@ struct A : public VCown<A>
 
 int constexpr n_cowns = 6;
 double elapsed_secs[n_cowns];
+Priority priority = Priority::Normal;
 
 struct Loop : public VBehaviour<Loop>
 {
@@ -62,6 +63,7 @@ struct Spawn : public VBehaviour<Spawn>
     for (int i = 0; i < n_cowns; ++i)
     {
       auto a = new A(i);
+      a->set_priority(priority);
       Cown::schedule<Loop>(a, a);
       Cown::release(alloc, a);
     }
@@ -91,16 +93,14 @@ void assert_variance()
   UNUSED(max);
 }
 
-int main()
+void run(size_t spacing, uint64_t period, Priority p)
 {
-#ifdef USE_SYSTEMATIC_TESTING
-  std::cout << "This test does not make sense to run systematically."
-            << std::endl;
-#else
   size_t cores = 2;
   Scheduler& sched = Scheduler::get();
   sched.init(cores);
   sched.set_fair(true);
+  sched.set_fair_policy(spacing, period);
+  priority = p;
 
   auto& alloc = ThreadAlloc::get();
   (void)alloc;
@@ -111,7 +111,33 @@ int main()
   Cown::release(alloc, b);
   sched.run();
   snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+
+  auto result = std::minmax_element(elapsed_secs, elapsed_secs + n_cowns);
+  printf(
+    "spacing %zu, period %llu: slowest cown took %f\n",
+    spacing,
+    (unsigned long long)period,
+    *result.second);
   assert_variance();
+}
+
+int main()
+{
+#ifdef USE_SYSTEMATIC_TESTING
+  std::cout << "This test does not make sense to run systematically."
+            << std::endl;
+#else
+  // Cowns of the same priority class should be scheduled fairly, whether
+  // they are scheduled on the normal or the high priority queue, with the
+  // token spacing and period of any fairness policy.
+  std::pair<size_t, uint64_t> policies[] = {
+    {1, 0}, {8, 0}, {0, 1'000'000}, {8, 1'000'000}};
+
+  for (auto [spacing, period] : policies)
+  {
+    for (auto p : {Priority::Normal, Priority::High})
+      run(spacing, period, p);
+  }
 
   puts("done");
 #endif
@@ -0,0 +1,126 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests tracing objects through the field map of their descriptor, see
+ * `Descriptor::field_map`, instead of their `trace` method.
+ *
+ * A region holds a list of nodes, traced through their field map, that point
+ * to leaves traced through their `trace` method. Collecting the region must
+ * keep exactly the objects reachable from the root, and freezing and
+ * releasing it must free them all.
+ */
+#include <test/harness.h>
+
+static size_t live_count = 0;
+
+struct Leaf : public V<Leaf>
+{
+  Leaf* next = nullptr;
+
+  Leaf()
+  {
+    live_count++;
+  }
+
+  ~Leaf()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  size_t value = 0;
+  Leaf* leaf = nullptr;
+
+  Node()
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+
+  static constexpr uintptr_t trace_fields()
+  {
+    return field_map(offsetof(Node, next), offsetof(Node, leaf));
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+
+    if (leaf != nullptr)
+      st.push(leaf);
+  }
+};
+
+static constexpr size_t list = 1000;
+
+void test_field_map()
+{
+  auto& alloc = ThreadAlloc::get();
+
+  check(Node::desc()->field_map != 0);
+  check(Leaf::desc()->field_map == 0);
+
+  auto* root = new (RegionType::Trace) Node;
+  {
+    UsingRegion rr(root);
+
+    Node* last = root;
+    for (size_t i = 0; i < list; i++)
+    {
+      auto n = new Node;
+      n->value = i;
+      if (i % 2 == 0)
+      {
+        n->leaf = new Leaf;
+        n->leaf->next = new Leaf;
+      }
+      last->next = n;
+      last = n;
+
+      // Garbage, some of which points into the list.
+      auto g = new Node;
+      g->next = n;
+      g->leaf = new Leaf;
+    }
+
+    check(live_count == 1 + list * 4);
+    region_collect();
+    check(live_count == 1 + list * 2);
+  }
+
+  size_t i = 0;
+  for (Node* n = root->next; n != nullptr; n = n->next)
+  {
+    check(n->value == i);
+    check((n->leaf != nullptr) == (i % 2 == 0));
+    i++;
+  }
+  check(i == list);
+
+  freeze(root);
+  check(live_count == 1 + list * 2);
+  Immutable::release(alloc, root);
+  check(live_count == 0);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_field_map);
+  return 0;
+}
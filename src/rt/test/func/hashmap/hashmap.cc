@@ -12,9 +12,8 @@
 using namespace snmalloc;
 using namespace verona::rt;
 
-template<typename Entry, typename Model>
-bool model_check(
-  const ObjectMap<Entry>& map, const Model& model, std::stringstream& err)
+template<typename Map, typename Model>
+bool model_check(const Map& map, const Model& model, std::stringstream& err)
 {
   map.debug_layout(err) << "\n";
 
@@ -59,10 +58,11 @@ bool model_check(
 struct Key : public VCown<Key>
 {};
 
+template<template<typename> typename Map>
 bool test(size_t seed)
 {
   auto& alloc = ThreadAlloc::get();
-  ObjectMap<std::pair<Key*, int32_t>> map(alloc);
+  Map<std::pair<Key*, int32_t>> map(alloc);
   std::unordered_map<Key*, int32_t> model;
 
   xoroshiro::p128r64 rng{seed};
@@ -163,7 +163,12 @@ int main(int argc, char** argv)
   for (size_t seed = harness.seed_lower; seed <= harness.seed_upper; seed++)
   {
     std::cout << "seed: " << seed << std::endl;
-    if (!test(seed))
+    if (!test<ObjectMap>(seed))
+      return 1;
+
+    debug_check_empty<snmalloc::Alloc::Config>();
+
+    if (!test<SwissObjectMap>(seed))
       return 1;
 
     debug_check_empty<snmalloc::Alloc::Config>();
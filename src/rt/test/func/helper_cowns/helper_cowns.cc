@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#ifndef USE_SYSTEMATIC_TESTING
+#  ifndef USE_SYSTEM_MONITOR
+#    define USE_SYSTEM_MONITOR
+#  endif
+#endif
+
+/**
+ * This tests making cowns on a core shared by a stuck scheduler thread and a
+ * helper of the system monitor, see `SysMonitor` and
+ * `SchedulerThread::bind_cowns`.
+ *
+ * On a single core, a behaviour makes and drops cowns until the behaviours
+ * it queued behind itself have run, which needs a helper. Those make and
+ * drop cowns too, one at a time and in batches, so that the helper binds
+ * cowns to the core while the stuck thread adds and frees cowns of its own.
+ * The collection of cown stubs and the leak detector then walk the cowns of
+ * the core.
+ *
+ * The system monitor does not support systematic testing, so this only runs
+ * in the concurrent build.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t queued = 16;
+static constexpr size_t batch = 100;
+
+struct Value
+{
+  size_t value = 0;
+};
+
+static std::atomic<size_t> helped = 0;
+
+void test_helper_cowns()
+{
+  helped = 0;
+
+  when(make_cown<Value>()) << [](acquired_cown<Value>) {
+    for (size_t i = 0; i < queued; i++)
+    {
+      when(make_cown<Value>()) << [](acquired_cown<Value>) {
+        auto cowns = make_cowns<Value>(batch);
+        for (auto& c : cowns)
+          when(c) << [](acquired_cown<Value> v) { check(v->value == 0); };
+        for (size_t j = 0; j < batch; j++)
+          make_cown<Value>();
+        helped++;
+      };
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (
+      (helped < queued) &&
+      ((std::chrono::steady_clock::now() - start) < std::chrono::seconds(10)))
+    {
+      make_cown<Value>();
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    check(helped == queued);
+  };
+}
+
+int main(int argc, char** argv)
+{
+#ifdef USE_SYSTEM_MONITOR
+  SystematicTestHarness harness(argc, argv);
+  harness.cores = 1;
+  harness.run(test_helper_cowns);
+#else
+  UNUSED(argc);
+  UNUSED(argv);
+#endif
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the injection of cowns by external threads, see `Injector`.
+ *
+ * Several external threads each schedule more behaviours on new cowns than
+ * fit in an injector, so that every behaviour makes a cown runnable from
+ * outside the runtime. This is run with each `InjectPolicy`, and every
+ * behaviour must run exactly once.
+ */
+#include <test/harness.h>
+
+struct Counter : public VCown<Counter>
+{};
+
+static constexpr size_t THREADS = 4;
+static constexpr size_t BEHAVIOURS = 2 * Injector<Cown>::CAPACITY;
+
+struct Total
+{
+  std::atomic<size_t> count{0};
+
+  ~Total()
+  {
+    check(count == THREADS * BEHAVIOURS);
+  }
+};
+
+void inject(std::shared_ptr<Total> total)
+{
+  auto& alloc = ThreadAlloc::get();
+  size_t full = 0;
+
+  for (size_t i = 0; i < BEHAVIOURS; i++)
+  {
+    if (Scheduler::inject_full())
+      full++;
+
+    auto c = new (alloc) Counter;
+    schedule_lambda(c, [total]() { total->count++; });
+    Cown::release(alloc, c);
+  }
+
+  Logging::cout() << "Injector full " << full << " times" << Logging::endl;
+  schedule_lambda(Scheduler::remove_external_event_source);
+}
+
+void test(SystematicTestHarness* harness)
+{
+  auto total = std::make_shared<Total>();
+
+  schedule_lambda([harness, total]() {
+    for (size_t i = 0; i < THREADS; i++)
+    {
+      Scheduler::add_external_event_source();
+      harness->external_thread([total]() { inject(total); });
+    }
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  Scheduler::set_inject_policy(InjectPolicy::Overflow);
+  harness.run(test, &harness);
+
+  Scheduler::set_inject_policy(InjectPolicy::Block);
+  harness.run(test, &harness);
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests running behaviours inline on the sending scheduler thread, see
+ * `Cown::run_inline`.
+ *
+ * A number of chains of behaviours are started.  Each step acquires one or two
+ * cowns, and sends the next step of the chain. When the
+ * next step can acquire all of its cowns immediately, it is run inline, up to
+ * the nesting limit.  The test checks that behaviours on the same cown are
+ * still mutually exclusive, and that every step of every chain runs.
+ */
+#include <test/harness.h>
+
+static constexpr size_t cown_count = 7;
+static constexpr size_t chain_count = 4;
+static constexpr size_t chain_length = 200;
+
+static std::atomic<size_t> steps = 0;
+static size_t expected_steps = 0;
+static std::atomic<size_t> running_chains = 0;
+
+struct Counter : public VCown<Counter>
+{
+  std::atomic<size_t> running = 0;
+};
+
+static Counter* counters[cown_count];
+
+struct Step : public VBehaviour<Step>
+{
+  size_t chain;
+  size_t index;
+  Request requests[2];
+  size_t count;
+
+  Step(size_t chain_, size_t index_, Request* requests_, size_t count_)
+  : chain(chain_), index(index_), count(count_)
+  {
+    for (size_t i = 0; i < count; i++)
+      requests[i] = requests_[i];
+  }
+
+  void f()
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      auto* c = (Counter*)requests[i].cown();
+      check(c->running++ == 0);
+    }
+
+    yield();
+    steps++;
+
+    if (index + 1 < chain_length)
+      send(chain, index + 1);
+    else if (--running_chains == 0)
+      release_counters();
+
+    for (size_t i = 0; i < count; i++)
+    {
+      auto* c = (Counter*)requests[i].cown();
+      c->running--;
+    }
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    // Any step may send to any of the counters.
+    for (auto* c : counters)
+      st.push(c);
+  }
+
+  static void release_counters()
+  {
+    auto& alloc = ThreadAlloc::get();
+    for (auto* c : counters)
+      Cown::release(alloc, c);
+  }
+
+  static void send(size_t chain, size_t index)
+  {
+    // Vary the number of cowns along the chain. Consecutive steps use
+    // different cowns, so that the next step can often be acquired
+    // immediately.
+    Request requests[2];
+    size_t count = ((index + chain) % 3 == 0) ? 1 : 2;
+    for (size_t i = 0; i < count; i++)
+      requests[i] =
+        Request::write(counters[(chain + (2 * index) + i) % cown_count]);
+
+    Cown::schedule<Step>(count, requests, chain, index, requests, count);
+  }
+};
+
+void test_inline_behaviours()
+{
+  // Check the previous seed ran to completion.
+  check(steps == expected_steps);
+  steps = 0;
+  expected_steps = chain_count * chain_length;
+
+  Scheduler::set_inline_behaviours(true);
+
+  // The counters are released by the last step of the last chain.
+  for (size_t i = 0; i < cown_count; i++)
+    counters[i] = new Counter;
+
+  running_chains = chain_count;
+  for (size_t c = 0; c < chain_count; c++)
+    Step::send(c, 0);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_inline_behaviours);
+  check(steps == expected_steps);
+  Scheduler::set_inline_behaviours(false);
+  return 0;
+}
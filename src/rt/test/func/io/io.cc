@@ -0,0 +1,128 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the I/O cowns of `cpp/io.h`.
+ *
+ * A client connects to a listener over loopback, and sends messages that the
+ * server echoes back. The echoes are delivered to a session cown, which
+ * checks them and sends the next message. A file is written, and read back
+ * from the completion of the write.
+ */
+#include <cpp/io.h>
+#include <cstring>
+#include <string>
+#include <test/harness.h>
+
+#if defined(__linux__)
+using namespace verona::cpp;
+
+static constexpr size_t rounds = 10;
+static const char message[] = "hello from verona";
+
+struct Session
+{
+  size_t echoed = 0;
+};
+
+io::Buffer make_message()
+{
+  io::Buffer buf(sizeof(message));
+  memcpy(buf.data(), message, sizeof(message));
+  buf.resize(sizeof(message));
+  return buf;
+}
+
+bool is_message(const io::Buffer& buf)
+{
+  return (buf.size() == sizeof(message)) &&
+    (memcmp(buf.data(), message, sizeof(message)) == 0);
+}
+
+void serve(cown_ptr<io::TcpConnection> conn)
+{
+  io::read(conn, 64, [](auto& c, io::Buffer buf, int err) {
+    check(err == 0);
+    // The client has closed the connection.
+    if (buf.size() == 0)
+      return;
+
+    auto self = c.cown();
+    io::write(self, std::move(buf), [](auto& c, io::Buffer, int err) {
+      check(err == 0);
+      serve(c.cown());
+    });
+  });
+}
+
+void ping(cown_ptr<io::TcpConnection> conn, cown_ptr<Session> session)
+{
+  io::write(
+    conn, make_message(), [](auto&, io::Buffer, int err) { check(err == 0); });
+
+  io::read(
+    conn,
+    64,
+    io::deliver_to(
+      session,
+      [conn](acquired_cown<Session>& s, io::Buffer buf, int err) mutable {
+        check(err == 0);
+        check(is_message(buf));
+        if (++s->echoed < rounds)
+          ping(conn, s.cown());
+        else
+          io::TcpConnection::close(conn);
+      }));
+}
+
+void test_tcp()
+{
+  uint16_t port;
+  auto listener = io::TcpListener::listen(INADDR_LOOPBACK, 0, &port);
+  io::accept(listener, [](auto&, cown_ptr<io::TcpConnection> conn, int err) {
+    check(err == 0);
+    serve(conn);
+  });
+
+  auto conn = io::connect(
+    INADDR_LOOPBACK, port, [](auto&, int err) { check(err == 0); });
+  ping(conn, make_cown<Session>());
+}
+
+void test_file()
+{
+  static std::string path =
+    "/tmp/verona_io_test_" + std::to_string(getpid());
+  auto file = io::File::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC);
+
+  io::File::write_at(file, 0, make_message(), [](auto& f, io::Buffer, int err) {
+    check(err == 0);
+    auto self = f.cown();
+    io::File::read_at(self, 0, 64, [](auto&, io::Buffer buf, int err) {
+      check(err == 0);
+      check(is_message(buf));
+      unlink(path.c_str());
+    });
+  });
+}
+
+void test_io()
+{
+  io::start();
+  test_tcp();
+  test_file();
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_io);
+  io::stop();
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
@@ -51,6 +51,64 @@ void lambda_cown()
   Cown::release(ThreadAlloc::get(), c);
 }
 
+/// Vector state that needs more than pointer alignment.
+struct alignas(64) Lanes
+{
+  float v[16];
+};
+
+void lambda_aligned()
+{
+  Lanes lanes{};
+  lanes.v[15] = 42;
+
+  auto f = [lanes]() {
+    check(((uintptr_t)&lanes % alignof(Lanes)) == 0);
+    check(lanes.v[15] == 42);
+  };
+
+  schedule_lambda(f);
+
+  // Vary the number of requests before the behaviour in the body.
+  TestCown* cowns[3] = {new TestCown, new TestCown, new TestCown};
+  for (size_t count = 1; count <= 3; count++)
+    schedule_lambda(count, (Cown**)cowns, f);
+
+  for (auto c : cowns)
+    Cown::release(ThreadAlloc::get(), c);
+}
+
+/// Counts how often a closure is copied and moved on its way to the body.
+struct Counted
+{
+  static inline size_t copies = 0;
+  static inline size_t moves = 0;
+
+  Counted() = default;
+
+  Counted(const Counted&)
+  {
+    copies++;
+  }
+
+  Counted(Counted&&)
+  {
+    moves++;
+  }
+};
+
+void lambda_move_only()
+{
+  Counted::copies = 0;
+  Counted::moves = 0;
+
+  schedule_lambda([c = Counted(), p = make_unique<int>(42)]() {
+    check(*p == 42);
+    check(Counted::copies == 0);
+    check(Counted::moves == 1);
+  });
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -59,6 +117,8 @@ int main(int argc, char** argv)
   harness.run(lambda_cown);
   harness.run(lambda_args);
   harness.run(lambda_smart);
+  harness.run(lambda_aligned);
+  harness.run(lambda_move_only);
 
   return 0;
 }
@@ -0,0 +1,76 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the latency histograms of sampled behaviours, see
+ * `LatencyStats`.
+ *
+ * With every behaviour sampled, behaviours on one and on two cowns are
+ * scheduled, and a last behaviour checks that each of the earlier ones has
+ * been recorded once in every histogram.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t behaviours = 50;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_latency()
+{
+  size_t queueing = 0;
+  size_t acquisition = 0;
+  size_t execution = 0;
+  LatencyStats::for_each([&](BehaviourLatency& e) {
+    queueing += e.queueing.total();
+    acquisition += e.acquisition.total();
+    execution += e.execution.total();
+    check(e.execution.percentile(0.5) <= e.execution.percentile(0.99));
+  });
+
+  // The behaviours on `a`, on `a` and `b`, and the last one on `b` have all
+  // completed.
+  check(execution >= (behaviours * 2) + 1);
+  check(queueing == execution);
+  check(acquisition == execution);
+
+  LatencyStats::set_sampling(0);
+}
+
+void test_latency()
+{
+  LatencyStats::clear();
+  LatencyStats::set_sampling(1);
+
+  auto a = make_cown<Counter>();
+  auto b = make_cown<Counter>();
+
+  for (size_t i = 0; i < behaviours; i++)
+  {
+    when(a) << [](acquired_cown<Counter> a) { a->count++; };
+    when(a, b) << [](acquired_cown<Counter> a, acquired_cown<Counter> b) {
+      a->count++;
+      b->count++;
+    };
+  }
+
+  when(b) << [](acquired_cown<Counter>) {};
+
+  when(a, b) << [](acquired_cown<Counter> a, acquired_cown<Counter> b) {
+    check(a->count == behaviours * 2);
+    check(b->count == behaviours);
+    check_latency();
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_latency);
+  return 0;
+}
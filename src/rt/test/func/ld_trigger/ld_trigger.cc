@@ -0,0 +1,77 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests starting the leak detector without calling `want_ld`, see
+ * `ThreadPool::set_ld_trigger`, with the scan of each core spread over many
+ * small batches, see `ThreadPool::set_ld_scan_batch`.
+ *
+ * Pairs of cowns that reference each other are released, so only the leak
+ * detector can collect them. A spinning cown keeps the scheduler threads busy
+ * until they have all been collected.
+ */
+#include <test/harness.h>
+
+static constexpr size_t pairs = 20;
+static std::atomic<size_t> collected = 0;
+
+struct Peer : public VCown<Peer>
+{
+  Peer* other = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (other != nullptr)
+      st.push(other);
+  }
+
+  void finaliser(Object*, ObjectStack&)
+  {
+    collected++;
+  }
+};
+
+struct Spinner : public VCown<Spinner>
+{
+  size_t spins = 0;
+};
+
+void spin(Spinner* s)
+{
+  s->spins++;
+  if (collected < pairs * 2)
+  {
+    check(s->spins < 10'000'000);
+    schedule_lambda(s, [s]() { spin(s); });
+  }
+}
+
+template<LDTrigger trigger>
+void test_ld_trigger()
+{
+  auto& alloc = ThreadAlloc::get();
+  Scheduler::set_ld_trigger(trigger, 0);
+  Scheduler::set_ld_scan_batch(2);
+  collected = 0;
+
+  for (size_t i = 0; i < pairs; i++)
+  {
+    auto a = new Peer;
+    auto b = new Peer;
+    // Each holds the only reference to the other.
+    a->other = b;
+    b->other = a;
+  }
+
+  auto s = new Spinner;
+  schedule_lambda(s, [s]() { spin(s); });
+  Cown::release(alloc, s);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_ld_trigger<LDTrigger::Periodic>);
+  harness.run(test_ld_trigger<LDTrigger::Idle>);
+  return 0;
+}
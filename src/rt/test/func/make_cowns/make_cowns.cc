@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests making many cowns at once, see `make_cowns`.
+ *
+ * Cowns are made both outside the runtime, where they are bound to a core
+ * when they first run, and inside a behaviour, where they are added to the
+ * list of its core in one batch. Each cown is then run, and dropped, so that
+ * the leak detector and the collection of cown stubs walk the batches.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t count = 1000;
+
+struct Value
+{
+  size_t value;
+};
+
+void run_all(std::vector<cown_ptr<Value>> cowns)
+{
+  for (size_t i = 0; i < cowns.size(); i++)
+    when(cowns[i]) << [i](acquired_cown<Value> c) { check(c->value == i); };
+}
+
+void test_make_cowns()
+{
+  run_all(make_cowns<Value>(count, [](size_t i) { return Value{i}; }));
+
+  auto empty = make_cowns<Value>(0);
+  check(empty.empty());
+
+  auto c = make_cown<Value>();
+  when(c) << [](acquired_cown<Value>) {
+    run_all(make_cowns<Value>(count, [](size_t i) { return Value{i}; }));
+    // Another batch on the same thread, once the first has ended.
+    auto defaults = make_cowns<Value>(count);
+    for (auto& d : defaults)
+      when(d) << [](acquired_cown<Value> d) { check(d->value == 0); };
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_make_cowns);
+  return 0;
+}
@@ -3,10 +3,16 @@
 #include "memory.h"
 
 #include "memory_alloc.h"
+#include "memory_compact.h"
 #include "memory_gc.h"
+#include "memory_hybrid.h"
+#include "memory_image.h"
 #include "memory_iterator.h"
+#include "memory_limits.h"
 #include "memory_merge.h"
 #include "memory_rc.h"
+#include "memory_source.h"
+#include "memory_stack.h"
 // #include "memory_subregion.h"
 #include "memory_swap_root.h"
 
@@ -58,7 +64,13 @@ int main(int argc, char** argv)
   memory_swap_root::run_test();
   memory_merge::run_test();
   memory_gc::run_test();
+  memory_hybrid::run_test();
+  memory_compact::run_test();
+  memory_image::run_test();
+  memory_source::run_test();
   memory_rc::run_test();
+  memory_limits::run_test();
+  memory_stack::run_test();
   // memory_subregion::run_test();
 
   test_dealloc();
@@ -0,0 +1,288 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_compact
+{
+  constexpr auto region_type = RegionType::Arena;
+
+  // More small objects than fit into two arenas.
+  constexpr size_t many = 3 * 1024 * 1024 / vsizeof<C3>;
+
+  /**
+   * Allocating only unreachable objects, in arenas and in the large object
+   * ring, which should all get collected.
+   **/
+  void test_garbage()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (region_type) C1;
+    {
+      UsingRegion rr(o);
+      allocs<0, C1, F1, LargeC2, XLargeF2, C1, F1>();
+      check(debug_size() == 7);
+    }
+
+    o = (C1*)RegionArena::compact(alloc, o);
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 1);
+    }
+    check(live_count == 0);
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * Compacting a list that spans several arenas, interleaved with garbage.
+   * The live objects, including the Iso object, move, and the pointers to
+   * them are rewritten, including those back to the Iso object.
+   **/
+  void test_list()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (region_type) F3;
+    size_t finals = 0;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = o->c1;
+        c->f1 = o;
+        o->c1 = c;
+
+        new C3;
+        if (i % 100 == 0)
+        {
+          c->f2 = new F3;
+          new F3;
+          finals++;
+        }
+      }
+      check(debug_size() == 1 + 2 * (many + finals));
+    }
+    check(live_count == (int)(1 + 2 * finals));
+
+    auto* r = (F3*)RegionArena::compact(alloc, o);
+    check(r != o);
+    check(live_count == (int)(1 + finals));
+
+    {
+      UsingRegion rr(r);
+      check(debug_size() == 1 + many + finals);
+
+      size_t length = 0;
+      size_t found = 0;
+      for (C3* c = r->c1; c != nullptr; c = c->c1)
+      {
+        check(c->f1 == (F3*)r);
+        if (c->f2 != nullptr)
+          found++;
+        length++;
+      }
+      check(length == many);
+      check(found == finals);
+
+      // Drop the second half of the list, and compact again.
+      C3* c = r->c1;
+      for (size_t i = 1; i < many / 2; i++)
+        c = c->c1;
+      c->c1 = nullptr;
+    }
+
+    r = (F3*)RegionArena::compact(alloc, r);
+    {
+      UsingRegion rr(r);
+      size_t length = 0;
+      for (C3* c = r->c1; c != nullptr; c = c->c1)
+        length++;
+      check(length == many / 2);
+    }
+
+    region_release(r);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    check(live_count == 0);
+  }
+
+  /**
+   * A region with external references is not compacted.
+   **/
+  void test_external_reference()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (region_type) C1;
+    ExternalRef* e;
+    {
+      UsingRegion rr(o);
+      o->f1 = new C1;
+      new C1;
+      e = create_external_reference(o->f1);
+    }
+
+    check(RegionArena::compact(alloc, o) == o);
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 3);
+    }
+
+    Immutable::release(alloc, e);
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * A region with 4 MiB arenas, into which a region with default arenas is
+   * merged, keeps all its objects through a compaction.
+   **/
+  void test_arena_size()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (region_type) C3;
+    RegionArena::set_arena_size(o, 4 * 1024 * 1024);
+    check(RegionArena::get_arena_size(o) == 4 * 1024 * 1024);
+
+    auto* other = new (region_type) C3;
+    check(RegionArena::get_arena_size(other) == sizeof(RegionArena::Arena));
+    {
+      UsingRegion rr(other);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = other->c1;
+        other->c1 = c;
+      }
+    }
+
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = o->c1;
+        o->c1 = c;
+        new C3;
+      }
+      merge(other);
+      o->c2 = other;
+      check(debug_size() == 2 + 3 * many);
+    }
+
+    o = (C3*)RegionArena::compact(alloc, o);
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 2 + 2 * many);
+      check(RegionArena::get_arena_size(o) == 4 * 1024 * 1024);
+    }
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * With the arena cache enabled, as on a scheduler thread, a new region
+   * reuses the arena of a released one, and the cache holds on to it until
+   * flushed.
+   **/
+  void test_arena_cache()
+  {
+    auto& alloc = ThreadAlloc::get();
+    RegionArena::enable_arena_cache();
+
+    auto* o = new (region_type) C1;
+    Object* first = o;
+    region_release(o);
+
+    o = new (region_type) C1;
+    check(o == first);
+    region_release(o);
+
+    RegionArena::flush_arena_cache(alloc);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * Resetting a region releases everything but the Iso object and its
+   * subregions, round after round. This still holds after the root is
+   * swapped for an object that is not the first in its arena, which then
+   * moves within the kept arena.
+   **/
+  void test_reset()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (region_type) F3;
+    auto* sub = new (region_type) F3;
+    o->f2 = sub;
+
+    for (size_t round = 0; round < 3; round++)
+    {
+      {
+        UsingRegion rr(o);
+        for (size_t i = 0; i < many; i++)
+        {
+          auto c = new C3;
+          c->c1 = o->c1;
+          o->c1 = c;
+          if (i % 100 == 0)
+          {
+            c->f2 = new F3;
+            c->f2->f1 = new (region_type) F3;
+          }
+        }
+      }
+      check(live_count == (int)(2 + 2 * ((many + 99) / 100)));
+
+      o = (F3*)RegionArena::reset(alloc, o);
+      o->c1 = nullptr;
+      check(live_count == 2);
+      check(o->debug_is_iso());
+      check(o->f2 == sub);
+      {
+        UsingRegion rr(o);
+        check(debug_size() == 1);
+      }
+    }
+
+    F3* n;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = o->c1;
+        o->c1 = c;
+      }
+      new F3;
+      n = new F3;
+      n->f2 = o->f2;
+      o->f2 = nullptr;
+      set_entry_point(n);
+    }
+
+    n = (F3*)RegionArena::reset(alloc, n);
+    check(live_count == 2);
+    check(n->debug_is_iso());
+    check(n->f2 == sub);
+    {
+      UsingRegion rr(n);
+      check(debug_size() == 1);
+    }
+
+    region_release(n);
+    check(live_count == 0);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  void run_test()
+  {
+    test_garbage();
+    test_list();
+    test_external_reference();
+    test_arena_size();
+    test_arena_cache();
+    test_reset();
+  }
+}
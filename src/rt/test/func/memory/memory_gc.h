@@ -564,6 +564,181 @@ namespace memory_gc
     snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
   }
 
+  /**
+   * Collect incrementally, with a small budget per step, while mutating the
+   * region between steps.
+   **/
+  void test_incremental()
+  {
+    // An object is moved behind the marking frontier, which only the write
+    // barrier can tell the collector about.
+    {
+      auto* o = new (RegionType::Trace) C;
+      {
+        UsingRegion rr(o);
+
+        auto* a = new C;
+        auto* b = new C;
+        auto* d = new C;
+        auto* x = new C;
+        new C; // garbage
+
+        // o -> a -> b -> d -> x
+        o->f1 = a;
+        a->f1 = b;
+        b->f1 = d;
+        d->f1 = x;
+
+        // Marks a, but not b.
+        check(!region_collect_step(1));
+        check(RegionTrace::gc_in_progress(o));
+
+        // x is now only reachable from a, which has already been marked.
+        a->f2 = x;
+        write_barrier(x);
+        d->f1 = nullptr;
+
+        // Allocated during marking, so it survives the collection.
+        b->f2 = new C;
+        write_barrier(b->f2);
+
+        while (!region_collect_step(1))
+        {}
+        check(!RegionTrace::gc_in_progress(o));
+        check(debug_size() == 6);
+
+        region_collect();
+        check(debug_size() == 6);
+      }
+
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    }
+
+    // Two rings, with allocations in both between every step.
+    {
+      auto* o = new (RegionType::Trace) Fx;
+      {
+        UsingRegion rr(o);
+
+        o->f1 = new Fx;
+        o->f1->c1 = new Cx;
+        o->c1 = new Cx;
+        o->c1->f1 = new Fx;
+        allocs<0, Fx, Cx, Fx, Cx, Cx>(); // unreachable
+        check(debug_size() == 10);
+
+        // Allocations during a collection are not collected by it.
+        size_t steps = 1;
+        check(!region_collect_step(1));
+        do
+        {
+          allocs<0, Fx, Cx>(); // unreachable
+          steps++;
+        } while (!region_collect_step(1));
+
+        check(debug_size() == 5 + (2 * (steps - 1)));
+
+        region_collect();
+        check(debug_size() == 5);
+      }
+
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    }
+
+    // Abandon collections that are marking or sweeping, by collecting the
+    // whole region, or releasing it.
+    for (size_t budget = 1; budget < 8; budget += 2)
+    {
+      auto* o = new (RegionType::Trace) Fx;
+      {
+        UsingRegion rr(o);
+
+        o->f1 = new Fx;
+        o->f1->f1 = new Fx;
+        o->c1 = new Cx;
+        allocs<0, Fx, Cx, Fx, Cx>(); // unreachable
+
+        check(!region_collect_step(budget));
+        region_collect();
+        check(!RegionTrace::gc_in_progress(o));
+        check(debug_size() == 4);
+
+        allocs<0, Fx, Cx>(); // unreachable
+        check(!region_collect_step(budget));
+      }
+
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    }
+  }
+
+  /**
+   * Minor collections only collect the objects allocated since the previous
+   * collection, keeping those reachable from the objects passed to the write
+   * barrier.
+   **/
+  void test_minor()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) Fx;
+    {
+      UsingRegion rr(o);
+
+      o->f1 = new Fx;
+      write_barrier(o->f1);
+      o->c1 = new Cx;
+      write_barrier(o->c1);
+      // Stores into objects of the nursery need not be passed to the write
+      // barrier, as long as those objects are.
+      o->c1->c1 = new Cx;
+      allocs<0, Fx, Cx, Fx>(); // unreachable
+      check(debug_size() == 7);
+
+      int live = live_count;
+      region_collect_minor();
+      check(live_count == live - 2);
+      check(debug_size() == 4);
+
+      // Garbage that has been promoted is left to a full collection.
+      o->c1 = nullptr;
+
+      // A young object referenced from an old object other than the root.
+      o->f1->f2 = new Fx;
+      write_barrier(o->f1->f2);
+      o->c2 = new Cx;
+      write_barrier(o->c2);
+      allocs<0, Fx, Cx>(); // unreachable
+
+      region_collect_minor();
+      check(debug_size() == 6);
+      region_collect();
+      check(debug_size() == 4);
+
+      // A young object only reachable from an additional root.
+      auto* r = new Cx;
+      r->c1 = new Cx;
+      allocs<0, Fx, Cx>(); // unreachable
+      RegionTrace::push_additional_root(o, r, alloc);
+      region_collect_minor();
+      check(debug_size() == 6);
+
+      RegionTrace::pop_additional_root(o, r, alloc);
+      region_collect();
+      check(debug_size() == 4);
+
+      // An incremental collection promotes the whole nursery first.
+      allocs<0, Fx, Cx>(); // unreachable
+      while (!region_collect_step())
+      {}
+      check(debug_size() == 4);
+    }
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
   void run_test()
   {
     test_basic();
@@ -573,5 +748,7 @@ namespace memory_gc
     test_cycles();
     test_merge();
     test_swap_root();
+    test_incremental();
+    test_minor();
   }
 }
\ No newline at end of file
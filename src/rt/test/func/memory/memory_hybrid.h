@@ -0,0 +1,141 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_hybrid
+{
+  constexpr auto region_type = RegionType::Hybrid;
+  using C = C1;
+  using F = F1;
+  using LC = LargeC2;
+  using XF = XLargeF2;
+
+  using Cx = C3;
+  using Fx = F3;
+
+  // More small trivial objects than fit into two chunks.
+  constexpr size_t many = 3 * RegionHybrid::CHUNK_SIZE / sizeof(Cx);
+
+  /**
+   * Allocating only unreachable objects, in chunks and in the object ring,
+   * which should all get collected.
+   **/
+  void test_garbage()
+  {
+    auto* o = new (region_type) C;
+    {
+      UsingRegion rr(o);
+
+      allocs<0, C, F, LC, XF, C, C, F>();
+      check(debug_size() == 8);
+      region_collect();
+      check(debug_size() == 1); // only o is left
+
+      for (size_t i = 0; i < many; i++)
+        new Cx;
+      check(debug_size() == 1 + many);
+      region_collect();
+      check(debug_size() == 1);
+    }
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    check(live_count == 0);
+  }
+
+  /**
+   * Allocating a list of small trivial objects that spans several chunks,
+   * and then dropping parts of it. Chunks that become empty are deallocated,
+   * and the dead objects of the others are skipped by the iterator.
+   **/
+  void test_chunks()
+  {
+    auto* o = new (region_type) Fx;
+    {
+      UsingRegion rr(o);
+
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new Cx;
+        c->c1 = o->c1;
+        o->c1 = c;
+      }
+      o->f1 = new Fx;
+      o->f1->f1 = o;
+
+      check(debug_size() == 2 + many);
+      region_collect();
+      check(debug_size() == 2 + many); // nothing collected
+
+      // Drop every other object of the list, so every chunk survives.
+      for (Cx* c = o->c1; c != nullptr; c = c->c1)
+      {
+        if (c->c1 != nullptr)
+          c->c1 = c->c1->c1;
+      }
+      region_collect();
+      check(debug_size() == 2 + (many + 1) / 2);
+
+      // Keep only the last object allocated, so the earlier chunks are
+      // deallocated.
+      o->c1->c1 = nullptr;
+      region_collect();
+      check(debug_size() == 3);
+
+      int live = live_count;
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 2);
+      check(live_count == live - 1);
+
+      o->c1 = nullptr;
+      region_collect();
+      check(debug_size() == 1); // only o is left
+    }
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    check(live_count == 0);
+  }
+
+  /**
+   * Objects in chunks that are reachable from objects in the ring, and the
+   * other way around, survive collections.
+   **/
+  void test_mixed()
+  {
+    auto* o = new (region_type) Cx;
+    {
+      UsingRegion rr(o);
+
+      auto* f = new Fx;
+      auto* c = new Cx;
+      o->c1 = c;
+      c->f1 = f;
+      f->c1 = new Cx;
+      f->f1 = new Fx;
+      allocs<0, Cx, Fx, LC>();
+
+      check(debug_size() == 8);
+      region_collect();
+      check(debug_size() == 5);
+
+      c->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 2);
+    }
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+    check(live_count == 0);
+  }
+
+  void run_test()
+  {
+    test_garbage();
+    test_chunks();
+    test_mixed();
+  }
+}
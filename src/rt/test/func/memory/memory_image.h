@@ -0,0 +1,142 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_image
+{
+  // More small objects than fit into two arenas.
+  constexpr size_t many = 3 * 1024 * 1024 / vsizeof<C3>;
+
+  /**
+   * A list that spans several arenas, with pointers back to the Iso object,
+   * is loaded from its image as an arena region. Unreachable objects are
+   * left out, and the original region is unchanged.
+   **/
+  void test_round_trip(RegionType type)
+  {
+    auto& alloc = ThreadAlloc::get();
+    const Descriptor* descriptors[] = {C1::desc(), C3::desc()};
+
+    auto* o = new (type) C3;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = o->c1;
+        c->c2 = o;
+        o->c1 = c;
+        new C1;
+      }
+      o->c1->c1->c2 = o->c1;
+    }
+
+    auto image = Region::serialize(alloc, o, descriptors, 2);
+    check(!image.empty());
+
+    auto* r = (C3*)Region::deserialize(
+      alloc, image.data(), image.size(), descriptors, 2);
+    check((r != nullptr) && (r != o));
+    check(Region::get_type(r) == RegionType::Arena);
+    {
+      UsingRegion rr(r);
+      check(debug_size() == 1 + many);
+
+      size_t length = 0;
+      for (C3* c = r->c1; c != nullptr; c = c->c1)
+      {
+        check(c->get_descriptor() == C3::desc());
+        check(c->c2 == ((length == 1) ? r->c1 : r));
+        length++;
+      }
+      check(length == many);
+    }
+
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 1 + 2 * many);
+      check(o->c1->c1->c2 == o->c1);
+    }
+
+    region_release(o);
+    region_release(r);
+    image = {};
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * Regions that cannot be moved to another process have no image: those
+   * with objects that have finalisers, with objects whose descriptor is not
+   * listed, or with external references. Trying leaves the region usable.
+   **/
+  void test_refused()
+  {
+    auto& alloc = ThreadAlloc::get();
+    const Descriptor* descriptors[] = {C3::desc()};
+
+    auto* o = new (RegionType::Arena) C3;
+    {
+      UsingRegion rr(o);
+      o->c1 = new C3;
+      o->f1 = new F3;
+    }
+    check(Region::serialize(alloc, o, descriptors, 1).empty());
+
+    o->f1 = nullptr;
+    check(!Region::serialize(alloc, o, descriptors, 1).empty());
+
+    ExternalRef* e;
+    {
+      UsingRegion rr(o);
+      o->c2 = (C3*)new C1;
+      check(Region::serialize(alloc, o, descriptors, 1).empty());
+      o->c2 = nullptr;
+      e = create_external_reference(o->c1);
+    }
+    check(Region::serialize(alloc, o, descriptors, 1).empty());
+
+    Immutable::release(alloc, e);
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * Images that are cut short, or are not images, are not loaded.
+   **/
+  void test_malformed()
+  {
+    auto& alloc = ThreadAlloc::get();
+    const Descriptor* descriptors[] = {C3::desc()};
+
+    auto* o = new (RegionType::Arena) C3;
+    {
+      UsingRegion rr(o);
+      o->c1 = new C3;
+    }
+    auto image = Region::serialize(alloc, o, descriptors, 1);
+    region_release(o);
+
+    check(
+      Region::deserialize(
+        alloc, image.data(), image.size() - 1, descriptors, 1) == nullptr);
+    check(
+      Region::deserialize(alloc, image.data(), 8, descriptors, 1) == nullptr);
+
+    image[0] = std::byte(~(uint8_t)image[0]);
+    check(
+      Region::deserialize(alloc, image.data(), image.size(), descriptors, 1) ==
+      nullptr);
+    image = {};
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  void run_test()
+  {
+    test_round_trip(RegionType::Arena);
+    test_round_trip(RegionType::Trace);
+    test_refused();
+    test_malformed();
+  }
+}
@@ -303,6 +303,7 @@ namespace memory_iterator
   {
     test_simple<RegionType::Trace>();
     test_simple<RegionType::Arena>();
+    test_simple<RegionType::Hybrid>();
 
     test_iterator<RegionType::Trace>();
     test_iterator<RegionType::Arena>();
@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_limits
+{
+  /**
+   * Each kind of region reports the memory it holds, which grows as objects
+   * are allocated.
+   **/
+  template<RegionType region_type>
+  void test_memory_used()
+  {
+    auto* o = new (region_type) C1;
+    size_t before = Region::memory_used(o);
+    check(before >= vsizeof<C1>);
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 1000; i++)
+      {
+        auto c = new C1;
+        c->f1 = o->f1;
+        o->f1 = c;
+      }
+    }
+    size_t after = Region::memory_used(o);
+    check(after >= 1001 * vsizeof<C1>);
+
+    if constexpr (
+      (region_type == RegionType::Trace) || (region_type == RegionType::Rc))
+      check(after == 1001 * vsizeof<C1>);
+
+    if constexpr (region_type == RegionType::Arena)
+      check(after == sizeof(RegionArena::Arena));
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * Above its soft limit, a trace region is collected as soon as it has
+   * grown, before the usual growth heuristic would collect it.
+   **/
+  void test_soft_limit()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) C1;
+    size_t live;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 4000; i++)
+      {
+        auto c = new C1;
+        c->f1 = o->f1;
+        o->f1 = c;
+      }
+      region_collect();
+      live = Region::memory_used(o);
+
+      // Garbage, growing the region by half.
+      for (size_t i = 0; i < 2000; i++)
+        new C1;
+    }
+    check(!Region::should_gc(o));
+
+    Region::set_limits(o, live + live / 4, 0);
+    check(Region::should_gc(o));
+    check(Region::gc_if_needed(alloc, o));
+    check(Region::memory_used(o) == live);
+    check(!Region::should_gc(o));
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  static size_t limit_calls = 0;
+
+  void on_limit(RegionBase*, size_t used, size_t size)
+  {
+    check(used + size > 4 * 1024 * 1024);
+    limit_calls++;
+  }
+
+  /**
+   * Allocations that would take a region past its hard limit call the limit
+   * handler, which here lets them go ahead.
+   **/
+  template<RegionType region_type>
+  void test_hard_limit()
+  {
+    RegionBase::set_limit_handler(on_limit);
+    limit_calls = 0;
+
+    auto* o = new (region_type) C1;
+    Region::set_limits(o, 0, 4 * 1024 * 1024);
+    {
+      UsingRegion rr(o);
+      while (Region::memory_used(o) <= 4 * 1024 * 1024)
+      {
+        check(limit_calls == 0);
+        auto c = new C1;
+        c->f1 = o->f1;
+        o->f1 = c;
+      }
+    }
+    check(limit_calls == 1);
+
+    region_release(o);
+    RegionBase::set_limit_handler(nullptr);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  void run_test()
+  {
+    test_memory_used<RegionType::Trace>();
+    test_memory_used<RegionType::Arena>();
+    test_memory_used<RegionType::Rc>();
+    test_memory_used<RegionType::Hybrid>();
+    test_soft_limit();
+    test_hard_limit<RegionType::Trace>();
+    test_hard_limit<RegionType::Arena>();
+    test_hard_limit<RegionType::Hybrid>();
+    test_hard_limit<RegionType::Rc>();
+  }
+}
@@ -305,11 +305,38 @@ namespace memory_merge
         test_merge_helper<region_type>(r1, r2);
       }
     }
+    else if constexpr (region_type == RegionType::Hybrid)
+    {
+      // Chunk linked lists: empty x singleton
+      // Object rings: multiple x singleton
+      {
+        auto* r1 = alloc_region<F, LC>(region_type);
+        auto* r2 = alloc_region<C, F>(region_type);
+        test_merge_helper<region_type>(r1, r2);
+      }
+
+      // Chunk linked lists: singleton x empty
+      // Object rings: empty x multiple
+      {
+        auto* r1 = alloc_region<C, C>(region_type);
+        auto* r2 = alloc_region<F, F>(region_type);
+        test_merge_helper<region_type>(r1, r2);
+      }
+
+      // Chunk linked lists: singleton x singleton
+      // Object rings: singleton x empty
+      {
+        auto* r1 = alloc_region<C, XC>(region_type);
+        auto* r2 = alloc_region<C, C>(region_type);
+        test_merge_helper<region_type>(r1, r2);
+      }
+    }
   }
 
   void run_test()
   {
     test_merge<RegionType::Trace>();
     test_merge<RegionType::Arena>();
+    test_merge<RegionType::Hybrid>();
   }
 }
\ No newline at end of file
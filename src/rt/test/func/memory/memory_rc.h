@@ -294,9 +294,101 @@ namespace memory_rc
     snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
   }
 
+  /**
+   * Dropping enough cycles for `decref` to collect them as a batch, without
+   * calling `region_collect`, and counting how objects were freed.
+   **/
+  void test_candidates()
+  {
+    constexpr size_t cycles = RegionRc::CANDIDATE_THRESHOLD;
+    auto* o = new (RegionType::Rc) C;
+    {
+      UsingRegion rc(o);
+
+      // A list that is freed by reference counting alone.
+      o->f1 = new C;
+      o->f1->f1 = new C;
+
+      // cycles: (o1 -> o2 -> o1)
+      for (size_t i = 0; i < cycles - 1; i++)
+      {
+        auto* o1 = new C;
+        auto* o2 = new C;
+        o1->f1 = o2;
+        o2->f1 = o1;
+        incref(o1);
+        decref(o1);
+      }
+      check(debug_size() == 3 + 2 * (cycles - 1));
+
+      auto* f = o->f1;
+      o->f1 = nullptr;
+      decref(f);
+      check(debug_size() == 1 + 2 * (cycles - 1));
+
+      // The last candidate triggers a cycle collection.
+      auto* o1 = new C;
+      o1->f1 = o1;
+      incref(o1);
+      decref(o1);
+      check(debug_size() == 1);
+    }
+
+    auto* reg = RegionRc::get(o);
+    check(reg->get_freed_by_rc() == 2);
+    check(reg->get_freed_by_cycles() == 2 * (cycles - 1) + 1);
+
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  /**
+   * In deferred mode, reference count changes are only applied, coalesced,
+   * when the log fills or the region is closed.
+   **/
+  void test_deferred()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Rc) C;
+    RegionRc::get(o)->set_deferred(alloc, true);
+    {
+      UsingRegion rc(o);
+
+      auto* o1 = new C;
+      o1->f1 = new C;
+      o->f1 = o1;
+
+      // Temporary copies that cancel out, across several flushes of the log.
+      for (size_t i = 0; i < 1000; i++)
+      {
+        incref(o1);
+        decref(o1);
+      }
+      check(RegionRc::get_ref_count(o1) == 1);
+
+      incref(o1);
+      o->f2 = o1;
+      o->f1 = nullptr;
+      decref(o1);
+      o->f2 = nullptr;
+      decref(o1);
+      check(debug_size() == 3);
+    }
+
+    auto* reg = RegionRc::get(o);
+    check(reg->get_region_size() == 1);
+    check(reg->get_freed_by_rc() == 2);
+
+    reg->set_deferred(alloc, false);
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
   void run_test()
   {
     test_basic();
     test_cycles();
+    test_candidates();
+    test_deferred();
   }
 }
@@ -0,0 +1,98 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+#include <vector>
+
+namespace memory_source
+{
+  /**
+   * Hands out memory from the allocator, and records it.
+   **/
+  struct RecordingSource : public ArenaSource
+  {
+    std::vector<std::pair<void*, size_t>> chunks;
+    size_t bytes = 0;
+    bool released = false;
+
+    void* alloc_chunk(size_t size) override
+    {
+      void* p = ThreadAlloc::get().alloc(size);
+      chunks.emplace_back(p, size);
+      bytes += size;
+      return p;
+    }
+
+    void release() override
+    {
+      check(!released);
+      for (auto [p, size] : chunks)
+        ThreadAlloc::get().dealloc(p, size);
+      released = true;
+    }
+
+    bool contains(void* p)
+    {
+      for (auto [q, size] : chunks)
+      {
+        if ((p >= q) && (p < (std::byte*)q + size))
+          return true;
+      }
+      return false;
+    }
+  };
+
+  // More small objects than fit into two arenas.
+  constexpr size_t many = 3 * 1024 * 1024 / vsizeof<C3>;
+
+  /**
+   * All the objects of a region with a source, large or not, are in the
+   * memory of the source, which is freed as a whole when the region is
+   * released. The region cannot be compacted or serialized.
+   **/
+  void test_source()
+  {
+    auto& alloc = ThreadAlloc::get();
+    RecordingSource source;
+
+    auto* o = new (&source) C3;
+    check(Region::get_type(o) == RegionType::Arena);
+    check(RegionArena::get_source(o) == &source);
+    check(source.contains(o));
+
+    C2<2 * 1024 * 1024>* large;
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < many; i++)
+      {
+        auto c = new C3;
+        c->c1 = o->c1;
+        o->c1 = c;
+      }
+      large = new C2<2 * 1024 * 1024>;
+      check(debug_size() == 2 + many);
+    }
+
+    check(source.contains(large));
+    for (C3* c = o->c1; c != nullptr; c = c->c1)
+      check(source.contains(c));
+    // At least three arenas, and the large object.
+    check(source.chunks.size() >= 4);
+    check(Region::memory_used(o) == source.bytes);
+
+    check(RegionArena::compact(alloc, o) == o);
+    const Descriptor* descriptors[] = {C3::desc()};
+    check(Region::serialize(alloc, o, descriptors, 1).empty());
+
+    region_release(o);
+    check(source.released);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  void run_test()
+  {
+    test_source();
+  }
+}
@@ -0,0 +1,51 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_stack
+{
+  /**
+   * With the stack block cache enabled, as on a scheduler thread, stacks keep
+   * their blocks for the next stack on the thread, and flushing the cache
+   * gives them all back to the allocator.
+   **/
+  void test_block_cache()
+  {
+    auto& alloc = ThreadAlloc::get();
+    StackBlockCache::enable();
+
+    auto* o = new C1;
+    for (size_t round = 0; round < 3; round++)
+    {
+      ObjectStack st(alloc);
+      for (size_t i = 0; i < 1000; i++)
+        st.push(o);
+
+      while (!st.empty())
+        check(st.pop() == o);
+    }
+
+    // Collecting and releasing a region use the cached blocks.
+    {
+      UsingRegion rr(o);
+      for (size_t i = 0; i < 1000; i++)
+      {
+        auto* c = new C1;
+        c->f1 = o->f1;
+        o->f1 = c;
+      }
+      region_collect();
+    }
+    region_release(o);
+
+    StackBlockCache::flush(alloc);
+    snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  }
+
+  void run_test()
+  {
+    test_block_cache();
+  }
+}
@@ -196,11 +196,28 @@ namespace memory_swap_root
       // Multiple objects in the ring. New root is after region metadata object.
       test_swap_root_helper<region_type, XC, 2, XC, XC, XC>();
     }
+    else if constexpr (region_type == RegionType::Hybrid)
+    {
+      // Both objects in the same chunk.
+      test_swap_root_helper<region_type, C, 0, C>();
+
+      // Old root in the ring, new root in a chunk.
+      test_swap_root_helper<region_type, F, 0, C>();
+
+      // Old root in a chunk, new root in the ring.
+      // Multiple objects in the ring. New root is in the middle of the ring.
+      test_swap_root_helper<region_type, C, 1, F, LC, XC>();
+
+      // Both objects in the ring. Old root must be last object in the ring.
+      // Multiple objects in the ring. New root is somewhere in the middle.
+      test_swap_root_helper<region_type, F, 1, F, F, LC>();
+    }
   }
 
   void run_test()
   {
     test_swap_root<RegionType::Trace>();
     test_swap_root<RegionType::Arena>();
+    test_swap_root<RegionType::Hybrid>();
   }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: MIT
 
 #include "./noticeboard_basic.h"
+#include "./noticeboard_coalesce.h"
 #include "./noticeboard_primitive_weak.h"
 #include "./noticeboard_weak.h"
 
@@ -13,5 +14,6 @@ int main(int argc, char** argv)
   harness.run(noticeboard_basic::run_test);
   harness.run(noticeboard_weak::run_test);
   harness.run(noticeboard_primitive_weak::run_test);
+  harness.run(noticeboard_coalesce::run_test);
   return 0;
 }
@@ -0,0 +1,126 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#include <test/harness.h>
+
+/**
+ * This tests `Noticeboard::stage`, which only publishes the last value staged
+ * by a behaviour, and `SeqNoticeboard`, which readers copy out without
+ * reference counts.
+ */
+namespace noticeboard_coalesce
+{
+  struct C : public V<C>
+  {
+  public:
+    int x = 0;
+
+    C(int x_) : x(x_) {}
+  };
+
+  struct DB : public VCown<DB>
+  {
+  public:
+    Noticeboard<Object*> box;
+
+    DB(Object* c) : box{c}
+    {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+      register_noticeboard(&box);
+#endif
+    }
+
+    void trace(ObjectStack& fields) const
+    {
+      box.trace(fields);
+    }
+  };
+
+  static constexpr int updates = 100;
+
+  struct Triple
+  {
+    uint64_t a;
+    uint64_t b;
+    uint64_t sum;
+  };
+
+  struct Writer : public VCown<Writer>
+  {
+  public:
+    SeqNoticeboard<Triple> board{Triple{0, 0, 0}};
+    uint64_t n = 0;
+  };
+
+  struct Reader : public VCown<Reader>
+  {
+  public:
+    Writer* writer;
+    size_t reads = 0;
+
+    Reader(Writer* w) : writer(w)
+    {
+      Cown::acquire(w);
+    }
+
+    void trace(ObjectStack& fields) const
+    {
+      fields.push(writer);
+    }
+  };
+
+  void write(Writer* w)
+  {
+    w->n++;
+    w->board.update(Triple{w->n, w->n * 3, w->n * 4});
+    if (w->n < updates)
+      schedule_lambda(w, [w]() { write(w); });
+  }
+
+  void read(Reader* r)
+  {
+    auto t = r->writer->board.peek();
+    check(t.a + t.b == t.sum);
+    check(t.a <= updates);
+    if (++r->reads < updates)
+      schedule_lambda(r, [r]() { read(r); });
+  }
+
+  void run_test()
+  {
+    Alloc& alloc = ThreadAlloc::get();
+
+    C* c = new (RegionType::Trace) C(0);
+    freeze(c);
+    DB* db = new DB(c);
+
+    schedule_lambda(db, [db]() {
+      auto& alloc = ThreadAlloc::get();
+      for (int i = 1; i <= updates; i++)
+      {
+        C* next = new (RegionType::Trace) C(i);
+        freeze(next);
+        db->box.stage(alloc, next);
+      }
+    });
+
+    // Runs after the staging behaviour has completed, so sees its last value.
+    schedule_lambda(db, [db]() {
+      auto& alloc = ThreadAlloc::get();
+      auto o = (C*)db->box.peek(alloc);
+      check(o->x == updates);
+      Immutable::release(alloc, o);
+    });
+
+    Cown::release(alloc, db);
+
+    auto w = new Writer;
+    schedule_lambda(w, [w]() { write(w); });
+    for (size_t i = 0; i < 3; i++)
+    {
+      auto r = new Reader(w);
+      schedule_lambda(r, [r]() { read(r); });
+      Cown::release(alloc, r);
+    }
+    Cown::release(alloc, w);
+  }
+}
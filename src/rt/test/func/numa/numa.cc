@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the NUMA placement of cowns, see `make_cown_on_core`.
+ *
+ * A cown spanning several pages is made on each core, and each behaviour
+ * checks its contents survived the move. Small cowns are not moved, but are
+ * still usable.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Buffer
+{
+  size_t data[4096];
+
+  Buffer(size_t seed)
+  {
+    for (size_t i = 0; i < std::size(data); i++)
+      data[i] = seed + i;
+  }
+};
+
+struct Small
+{
+  size_t value;
+};
+
+void test_numa()
+{
+  for (size_t core = 0; core < 8; core++)
+  {
+    auto b = make_cown_on_core<Buffer>(core, core);
+    when(b) << [core](acquired_cown<Buffer> b) {
+      for (size_t i = 0; i < std::size(b->data); i++)
+        check(b->data[i] == core + i);
+    };
+
+    auto s = make_cown_on_core<Small>(core, Small{core});
+    when(s) << [core](acquired_cown<Small> s) { check(s->value == core); };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_numa);
+  return 0;
+}
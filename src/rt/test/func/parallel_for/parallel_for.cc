@@ -0,0 +1,69 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests splitting the work of a behaviour over the scheduler threads,
+ * see `parallel_for`.
+ *
+ * A behaviour updates every element of an array owned by its cown with
+ * `parallel_for`, including a nested `parallel_for`, and the following
+ * behaviour checks that each element was updated exactly once, and that all
+ * the updates completed before the first behaviour released the cown.
+ */
+#include <cpp/parallel.h>
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t size = 1000;
+static constexpr size_t rows = 10;
+
+struct Data
+{
+  std::atomic<size_t> values[size];
+  std::atomic<size_t> table[rows][rows];
+
+  Data()
+  {
+    for (auto& v : values)
+      v = 0;
+    for (auto& row : table)
+      for (auto& v : row)
+        v = 0;
+  }
+};
+
+void test_parallel_for()
+{
+  auto data = make_cown<Data>();
+
+  when(data) << [](acquired_cown<Data> d) {
+    parallel_for(0, size, 7, [&d](size_t i) { d->values[i] += i; });
+
+    // The default grain, and a range that does not start at zero.
+    parallel_for(size / 2, size, [&d](size_t i) { d->values[i] += 1; });
+
+    parallel_for(0, rows, 1, [&d](size_t i) {
+      parallel_for(0, rows, 3, [&d, i](size_t j) { d->table[i][j] += 1; });
+    });
+
+    // An empty range.
+    parallel_for(size, size, 1, [](size_t) { check(false); });
+  };
+
+  when(data) << [](acquired_cown<Data> d) {
+    for (size_t i = 0; i < size; i++)
+      check(d->values[i] == i + (i >= size / 2 ? 1 : 0));
+    for (auto& row : d->table)
+      for (auto& v : row)
+        check(v == 1);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_parallel_for);
+  return 0;
+}
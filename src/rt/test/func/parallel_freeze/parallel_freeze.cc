@@ -0,0 +1,114 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests freezing a region with its sweep split across the scheduler
+ * threads, see `parallel_freeze` and `ParallelFreeze`.
+ *
+ * A behaviour builds a region holding a long list, with back edges in its
+ * first half so that it forms one large SCC, and a subregion. It also
+ * allocates garbage, some of which holds subregions. It then freezes the
+ * region in parallel, and checks that exactly the garbage was collected, that
+ * the list is immutable with the expected SCCs, and that releasing it frees
+ * everything.
+ */
+#include <cpp/parallel.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static std::atomic<size_t> live_count = 0;
+
+struct Node : public V<Node>
+{
+  Node* next = nullptr;
+  Node* back = nullptr;
+  Object* sub = nullptr;
+
+  Node()
+  {
+    live_count++;
+  }
+
+  ~Node()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+
+    if (back != nullptr)
+      st.push(back);
+
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& sub_regions)
+  {
+    Object::add_sub_region(sub, region, sub_regions);
+  }
+};
+
+// More sublists than fit in a few segments of the sweep.
+static constexpr size_t list = 4 * ParallelFreeze::SEGMENT_SIZE + 100;
+
+void freeze_region()
+{
+  auto& alloc = ThreadAlloc::get();
+  auto* root = new (RegionType::Trace) Node;
+  Node* middle = nullptr;
+  {
+    UsingRegion rr(root);
+
+    Node* last = root;
+    for (size_t i = 0; i < list; i++)
+    {
+      auto n = new Node;
+      last->next = n;
+      if (i < list / 2)
+        n->back = last;
+      else if (middle == nullptr)
+        middle = n;
+      last = n;
+
+      // Garbage, some of which holds a subregion.
+      auto g = new Node;
+      if (i % 100 == 0)
+        g->sub = new (RegionType::Trace) Node;
+    }
+
+    root->sub = new (RegionType::Trace) Node;
+  }
+
+  check(live_count == 2 + (list * 2) + (list + 99) / 100);
+
+  parallel_freeze(root);
+  check(root->debug_is_immutable());
+  check(live_count == 2 + list);
+
+  // The first half of the list is in the root's SCC, the rest are separate
+  // SCCs, each referenced once.
+  check(root->next->debug_immutable_root() == root->debug_immutable_root());
+  check(middle->debug_immutable_root() == middle);
+  check(middle->debug_rc() == 1);
+  check(root->sub->debug_immutable_root() == root->sub);
+
+  Immutable::release(alloc, root);
+  check(live_count == 0);
+}
+
+void test_parallel_freeze()
+{
+  schedule_lambda([]() { freeze_region(); });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_parallel_freeze);
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests collecting a trace region on several scheduler threads, see
+ * `parallel_gc` and `ParallelGC`.
+ *
+ * A behaviour on the cown holding a region builds a tree of trivial objects
+ * and a list of non-trivial ones, along with garbage of both kinds, some of
+ * which holds subregions. It then collects the region in parallel, and checks
+ * that exactly the garbage was collected, as `RegionTrace::gc` would, before
+ * dropping parts of the live objects and collecting again.
+ */
+#include <cpp/parallel.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static std::atomic<size_t> live_count = 0;
+
+struct Node : public V<Node>
+{
+  Node* left = nullptr;
+  Node* right = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (left != nullptr)
+      st.push(left);
+
+    if (right != nullptr)
+      st.push(right);
+  }
+};
+
+struct Final : public V<Final>
+{
+  Final* next = nullptr;
+  Node* node = nullptr;
+  Object* sub = nullptr;
+
+  Final()
+  {
+    live_count++;
+  }
+
+  ~Final()
+  {
+    live_count--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+
+    if (node != nullptr)
+      st.push(node);
+
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& sub_regions)
+  {
+    Object::add_sub_region(sub, region, sub_regions);
+  }
+};
+
+struct RegionCown : public VCown<RegionCown>
+{
+  Final* root;
+
+  RegionCown() : root(new (RegionType::Trace) Final) {}
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(root);
+  }
+};
+
+static constexpr size_t depth = 12;
+static constexpr size_t tree = (1 << depth) - 1;
+static constexpr size_t list = 5000;
+
+Node* make_tree(size_t d)
+{
+  if (d == 0)
+    return nullptr;
+
+  auto n = new Node;
+  n->left = make_tree(d - 1);
+  n->right = make_tree(d - 1);
+  return n;
+}
+
+void collect(RegionCown* c)
+{
+  UsingRegion rr(c->root);
+  Final* root = c->root;
+
+  root->node = make_tree(depth);
+  for (size_t i = 0; i < list; i++)
+  {
+    auto f = new Final;
+    f->next = root->next;
+    root->next = f;
+
+    // Garbage, some of which holds a subregion.
+    new Node;
+    new Node;
+    auto g = new Final;
+    if (i % 100 == 0)
+      g->sub = new (RegionType::Trace) Final;
+  }
+
+  check(debug_size() == 1 + tree + (list * 4));
+  check(live_count == 1 + list * 2 + list / 100);
+
+  parallel_gc(root);
+  check(debug_size() == 1 + tree + list);
+  check(live_count == 1 + list);
+
+  // Drop a subtree and the end of the list.
+  root->node->left = nullptr;
+  Final* f = root->next;
+  for (size_t i = 1; i < list / 2; i++)
+    f = f->next;
+  f->next = nullptr;
+
+  parallel_gc(root);
+  check(debug_size() == 1 + (tree + 1) / 2 + list / 2);
+  check(live_count == 1 + list / 2);
+
+  // A parallel collection leaves the region as a sequential one does.
+  region_collect();
+  check(debug_size() == 1 + (tree + 1) / 2 + list / 2);
+}
+
+void test_parallel_gc()
+{
+  auto c = new RegionCown;
+  schedule_lambda(c, [c]() { collect(c); });
+  Cown::release(ThreadAlloc::get(), c);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_parallel_gc);
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#ifndef USE_PERF_COUNTERS
+#  define USE_PERF_COUNTERS
+#endif
+
+/**
+ * This tests the sampling of hardware counters, see `PerfStats`.
+ *
+ * Every batch and behaviour is sampled. A last behaviour checks that the
+ * behaviours were attributed to their descriptor, and that the report and
+ * the Prometheus export include them. Where the counters cannot be opened,
+ * such as in a container without the permission to, it checks that nothing
+ * was recorded instead.
+ */
+#include <cpp/when.h>
+#include <sstream>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t behaviours = 100;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_counters()
+{
+  PerfStats::set_sampling(0);
+
+  size_t samples = 0;
+  uint64_t instructions = 0;
+  PerfStats::for_each([&](const PerfEntry& e) {
+    samples += e.samples.load(std::memory_order_relaxed);
+    instructions += e.get(PerfEvent::Instructions);
+  });
+
+  PerfCounterGroup group;
+  if (!group.valid())
+  {
+    check(samples == 0);
+    return;
+  }
+
+  check(samples >= behaviours);
+  check(instructions != 0);
+  check(PerfStats::batches().samples.load(std::memory_order_relaxed) != 0);
+
+  std::stringstream o;
+  PerfStats::print(o);
+  check(o.str().find("batches samples") != std::string::npos);
+
+  std::stringstream p;
+  Scheduler::write_stats_prometheus(p);
+  check(p.str().find("verona_perf_cycles_total") != std::string::npos);
+}
+
+void test_perf_counters()
+{
+  PerfStats::clear();
+  PerfStats::set_sampling(1);
+
+  auto c = make_cown<Counter>();
+  for (size_t i = 0; i < behaviours; i++)
+    when(c) << [](acquired_cown<Counter> c) { c->count++; };
+
+  when(c) << [](acquired_cown<Counter> c) {
+    check(c->count == behaviours);
+    check_counters();
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_perf_counters);
+  return 0;
+}
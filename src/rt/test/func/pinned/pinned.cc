@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests `Cown::pin`.
+ *
+ * Shard cowns are pinned to every core. Each shard is visited by chains of
+ * behaviours that alternate between the shard and an unpinned cown, which
+ * runs wherever it is stolen to. Some chains are started from an external
+ * thread. Every behaviour on a shard must run on the same scheduler thread,
+ * that of the core it is pinned to.
+ */
+#include <test/harness.h>
+#include <thread>
+
+static constexpr size_t SHARDS_PER_CORE = 4;
+static constexpr size_t CHAINS = 4;
+static constexpr size_t HOPS = 20;
+
+struct Total
+{
+  std::atomic<size_t> count{0};
+  size_t expected;
+
+  Total(size_t expected) : expected(expected) {}
+
+  ~Total()
+  {
+    check(count == expected);
+  }
+};
+
+struct Shard : public VCown<Shard>
+{
+  std::thread::id thread;
+  bool visited = false;
+
+  void visit()
+  {
+    if (!visited)
+    {
+      thread = std::this_thread::get_id();
+      visited = true;
+    }
+    check(thread == std::this_thread::get_id());
+  }
+};
+
+struct Load : public VCown<Load>
+{};
+
+/// Takes over a reference to both `s` and `l`.
+void hop(Shard* s, Load* l, size_t n, std::shared_ptr<Total> total)
+{
+  s->visit();
+  total->count++;
+  if (n == 0)
+  {
+    auto& alloc = ThreadAlloc::get();
+    Cown::release(alloc, s);
+    Cown::release(alloc, l);
+    return;
+  }
+
+  schedule_lambda(l, [s, l, n, total]() {
+    schedule_lambda(s, [s, l, n, total]() { hop(s, l, n - 1, total); });
+  });
+}
+
+/// Takes over a reference to `s`.
+void start(Shard* s, std::shared_ptr<Total> total)
+{
+  auto l = new Load;
+  schedule_lambda(s, [s, l, total]() { hop(s, l, HOPS, total); });
+}
+
+void test(SystematicTestHarness* harness)
+{
+  std::vector<Shard*> shards;
+  Core<Cown>* first = Scheduler::first_core();
+  Core<Cown>* c = first;
+  do
+  {
+    for (size_t i = 0; i < SHARDS_PER_CORE; i++)
+    {
+      auto s = new Shard;
+      s->pin(c);
+      shards.push_back(s);
+    }
+    c = c->next;
+  } while (c != first);
+
+  auto total =
+    std::make_shared<Total>(shards.size() * 2 * CHAINS * (HOPS + 1));
+
+  for (auto s : shards)
+  {
+    for (size_t i = 0; i < 2 * CHAINS; i++)
+      Cown::acquire(s);
+    for (size_t i = 0; i < CHAINS; i++)
+      start(s, total);
+  }
+
+  schedule_lambda([harness, shards, total]() {
+    Scheduler::add_external_event_source();
+    harness->external_thread([shards, total]() {
+      for (auto s : shards)
+      {
+        for (size_t i = 0; i < CHAINS; i++)
+          start(s, total);
+      }
+      schedule_lambda(Scheduler::remove_external_event_source);
+    });
+  });
+
+  auto& alloc = ThreadAlloc::get();
+  for (auto s : shards)
+    Cown::release(alloc, s);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test, &harness);
+  return 0;
+}
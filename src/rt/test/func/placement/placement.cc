@@ -0,0 +1,52 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests restricting the CPUs of the scheduler threads, see
+ * `Topology::Placement`.
+ *
+ * The placement allows a single CPU, so every core must be placed on it,
+ * however many threads the harness starts.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static size_t only_cpu;
+
+struct Empty
+{};
+
+void test_placement()
+{
+  auto c = make_cown<Empty>();
+  when(c) << [](acquired_cown<Empty>) {
+    Core<Cown>* first = Scheduler::first_core();
+    Core<Cown>* core = first;
+    do
+    {
+      check(core->affinity == only_cpu);
+      core = core->next;
+    } while (core != first);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  Topology top;
+  Topology::init(&top);
+
+  std::vector<size_t> list;
+  Topology::parse_list("0-2,5", list);
+  check(list == std::vector<size_t>({0, 1, 2, 5}));
+
+  only_cpu = top.get(top.size() - 1);
+  Topology::Placement placement;
+  placement.cpus.push_back(only_cpu);
+  Scheduler::set_placement(placement);
+
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_placement);
+  return 0;
+}
@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 
+#include <array>
 #include <test/harness.h>
 
 using namespace std;
@@ -136,6 +137,121 @@ void promise_transfer2()
   auto rp2 = Promise<int>::PromiseR(p2, YesTransfer);
 }
 
+using OneShot = OneShotPromise<int>;
+
+void check_value(std::variant<int, OneShot::PromiseErr> val)
+{
+  if (std::holds_alternative<int>(val))
+  {
+    auto v = std::get<int>(std::move(val));
+    Logging::cout() << v << std::endl;
+    check(v == 42);
+  }
+  else
+  {
+    Logging::cout() << "Got promise error" << std::endl;
+    abort();
+  }
+}
+
+void oneshot_test()
+{
+  auto pp = OneShot::create_promise();
+  auto rp = std::move(pp.first);
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    OneShot::fulfill(std::move(wp), 42);
+  });
+
+  std::move(rp).then(check_value);
+}
+
+void oneshot_fulfilled_first()
+{
+  auto pp = OneShot::create_promise();
+  OneShot::fulfill(std::move(pp.second), 42);
+
+  // Runs the continuation here.
+  bool ran = false;
+  std::move(pp.first).then([&ran](std::variant<int, OneShot::PromiseErr> val) {
+    check_value(std::move(val));
+    ran = true;
+  });
+  check(ran);
+}
+
+void oneshot_no_reader()
+{
+  auto pp = OneShot::create_promise();
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    OneShot::fulfill(std::move(wp), 42);
+  });
+}
+
+void oneshot_no_writer()
+{
+  auto pp = OneShot::create_promise();
+  auto rp = std::move(pp.first);
+
+  std::move(rp).then([](std::variant<int, OneShot::PromiseErr> val) {
+    if (std::holds_alternative<int>(val))
+    {
+      Logging::cout() << std::get<int>(val) << std::endl;
+      abort();
+    }
+    else
+    {
+      Logging::cout() << "Got promise error" << std::endl;
+    }
+  });
+}
+
+void oneshot_smart_pointer()
+{
+  using P = OneShotPromise<unique_ptr<int>>;
+  auto pp = P::create_promise();
+  auto wp = std::move(pp.second);
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    P::fulfill(std::move(wp), make_unique<int>(42));
+  });
+
+  // A continuation too large to be stored inline.
+  std::array<size_t, 16> padding{};
+  std::move(pp.first).then(
+    [padding](std::variant<unique_ptr<int>, P::PromiseErr> a) {
+      check(padding[0] == 0);
+      if (std::holds_alternative<unique_ptr<int>>(a))
+      {
+        auto p = std::get<unique_ptr<int>>(std::move(a));
+        Logging::cout() << *p << std::endl;
+      }
+      else
+      {
+        Logging::cout() << "Got promise error" << std::endl;
+        abort();
+      }
+    });
+}
+
+void oneshot_share()
+{
+  auto pp = OneShot::create_promise();
+  auto wp = std::move(pp.second);
+  auto rp = std::move(pp.first).share();
+  auto rp2 = rp;
+
+  schedule_lambda([wp = std::move(wp)]() mutable {
+    OneShot::fulfill(std::move(wp), 42);
+  });
+
+  rp.then(check_value);
+  rp2.then(check_value);
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -146,5 +262,12 @@ int main(int argc, char** argv)
   harness.run(promise_smart_pointer);
   harness.run(promise_transfer2);
 
+  harness.run(oneshot_test);
+  harness.run(oneshot_fulfilled_first);
+  harness.run(oneshot_no_reader);
+  harness.run(oneshot_no_writer);
+  harness.run(oneshot_smart_pointer);
+  harness.run(oneshot_share);
+
   return 0;
 }
@@ -0,0 +1,250 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests enqueueing segments of nodes on `MPSCQ` and `MPMCQ`, see
+ * `enqueue_segment`, and dequeueing segments from `MPMCQ`, see
+ * `dequeue_segment`.
+ *
+ * A number of behaviours concurrently enqueue numbered segments of varying
+ * length on both queues. The last behaviour to complete drains the queues,
+ * and the test checks that every node was enqueued exactly once, that the
+ * nodes of each segment are contiguous, and that the segments of each
+ * producer are in order. The `MPMCQ` is drained with a mix of `dequeue` and
+ * `dequeue_segment`.
+ */
+#include <test/harness.h>
+
+static constexpr size_t producer_count = 4;
+static constexpr size_t segment_count = 20;
+static constexpr size_t max_segment_length = 5;
+
+/// A node of either queue. Each node records its producer, segment, and
+/// position within the segment.
+struct Node
+{
+  static constexpr auto NO_EPOCH_SET = (std::numeric_limits<uint64_t>::max)();
+
+  std::atomic<Node*> next{nullptr};
+  std::atomic<Node*> next_in_queue{nullptr};
+  uint64_t epoch_when_popped{NO_EPOCH_SET};
+
+  size_t producer = 0;
+  size_t segment = 0;
+  size_t index = 0;
+  size_t length = 0;
+
+  void dealloc(Alloc& alloc)
+  {
+    alloc.dealloc<sizeof(Node)>(this);
+  }
+
+  static Node* make(size_t producer, size_t segment, size_t index, size_t len)
+  {
+    auto n = new (ThreadAlloc::get().alloc<sizeof(Node)>()) Node;
+    n->producer = producer;
+    n->segment = segment;
+    n->index = index;
+    n->length = len;
+    return n;
+  }
+};
+
+static MPSCQ<Node> mpscq;
+static MPMCQ<Node>* mpmcq;
+
+static std::atomic<size_t> remaining = 0;
+static bool drained = true;
+
+void drain_mpscq();
+void drain_mpmcq();
+
+static size_t segment_length(size_t producer, size_t segment)
+{
+  return ((producer + (segment * 3)) % max_segment_length) + 1;
+}
+
+struct Produce : public VBehaviour<Produce>
+{
+  size_t producer;
+
+  Produce(size_t producer) : producer(producer) {}
+
+  void f()
+  {
+    auto& alloc = ThreadAlloc::get();
+    for (size_t s = 0; s < segment_count; s++)
+    {
+      size_t len = segment_length(producer, s);
+      Node* first[2] = {nullptr, nullptr};
+      Node* last[2] = {nullptr, nullptr};
+
+      for (size_t i = 0; i < len; i++)
+      {
+        for (size_t q = 0; q < 2; q++)
+        {
+          Node* n = Node::make(producer, s, i, len);
+          if (last[q] == nullptr)
+            first[q] = n;
+          else if (q == 0)
+            last[q]->next.store(n, std::memory_order_relaxed);
+          else
+            last[q]->next_in_queue.store(n, std::memory_order_relaxed);
+          last[q] = n;
+        }
+      }
+
+      mpscq.enqueue_segment(first[0], last[0]);
+      yield();
+      mpmcq->enqueue_segment(alloc, first[1], last[1]);
+      yield();
+    }
+
+    if (--remaining == 0)
+    {
+      drain_mpscq();
+      drain_mpmcq();
+      drained = true;
+    }
+  }
+};
+
+/**
+ * Checks the sequence of nodes dequeued from a queue.
+ */
+struct Checker
+{
+  size_t next_segment[producer_count] = {};
+  Node* previous = nullptr;
+  size_t count = 0;
+
+  void operator()(Node* n)
+  {
+    if (n->index == 0)
+    {
+      // A new segment starts once the previous one is complete.
+      if (previous != nullptr)
+        check(previous->index + 1 == previous->length);
+      check(n->segment == next_segment[n->producer]);
+      next_segment[n->producer]++;
+    }
+    else
+    {
+      check(previous != nullptr);
+      check(previous->producer == n->producer);
+      check(previous->segment == n->segment);
+      check(previous->index + 1 == n->index);
+    }
+    previous = n;
+    count++;
+  }
+
+  void finish()
+  {
+    check((previous == nullptr) || (previous->index + 1 == previous->length));
+    size_t expected = 0;
+    for (size_t p = 0; p < producer_count; p++)
+    {
+      check(next_segment[p] == segment_count);
+      for (size_t s = 0; s < segment_count; s++)
+        expected += segment_length(p, s);
+    }
+    check(count == expected);
+  }
+};
+
+void drain_mpscq()
+{
+  auto& alloc = ThreadAlloc::get();
+  Checker checker;
+
+  // Dequeue deallocates the stub, and each returned node once the next one
+  // is dequeued.
+  while (Node* n = mpscq.dequeue(alloc))
+    checker(n);
+  checker.finish();
+
+  Node* front = mpscq.destroy();
+  front->dealloc(alloc);
+}
+
+void drain_mpmcq()
+{
+  auto& alloc = ThreadAlloc::get();
+  Checker checker;
+  Node* token = nullptr;
+
+  while (true)
+  {
+    // Alternate between taking segments and single nodes.
+    Node* rest;
+    Node* last;
+    size_t count = 0;
+    Node* n = ((checker.count % 2) == 0) ?
+      mpmcq->dequeue_segment(alloc, max_segment_length, rest, last, count) :
+      nullptr;
+    if (n != nullptr)
+    {
+      check((count > 0) && (count <= max_segment_length));
+      check((count == 1) == (rest == nullptr));
+      checker(n);
+      n->dealloc(alloc);
+
+      // No other thread is using the queue, so the rest of the segment can
+      // be deallocated rather than enqueued elsewhere.
+      n = rest;
+      for (size_t i = 1; i < count; i++)
+      {
+        check(((uintptr_t)n & 1) == 0);
+        check((i + 1 < count) || (n == last));
+        Node* next = n->next_in_queue;
+        checker(n);
+        n->dealloc(alloc);
+        n = next;
+      }
+      continue;
+    }
+
+    n = mpmcq->dequeue(alloc);
+    if (n == nullptr)
+      break;
+
+    if (((uintptr_t)n & 1) != 0)
+    {
+      // Put the token back at the end, so it is last in the queue.
+      token = n;
+      mpmcq->enqueue(alloc, token);
+      continue;
+    }
+    checker(n);
+    n->dealloc(alloc);
+  }
+  checker.finish();
+
+  check(token != nullptr);
+  mpmcq->destroy(alloc);
+  delete mpmcq;
+  mpmcq = nullptr;
+}
+
+void test_queue_segment()
+{
+  // Check the previous seed ran to completion.
+  check(drained);
+  drained = false;
+  remaining = producer_count;
+
+  mpscq.init(Node::make(0, 0, 0, 0));
+  mpmcq = new MPMCQ<Node>(Node::make(0, 0, 0, 0));
+
+  for (size_t p = 0; p < producer_count; p++)
+    Cown::schedule<Produce, YesTransfer>(new EmptyCown, p);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_queue_segment);
+  check(drained);
+  return 0;
+}
@@ -0,0 +1,136 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests behaviours that are laid out by compiled code rather than by a
+ * C++ type, see `Cown::prepare_raw`.
+ *
+ * Each behaviour is a descriptor followed by its captured variables, written
+ * straight into the message body, as the code generated for `when` does.
+ * Deposits on one account run in order, and a transfer that names its
+ * accounts in either order holds both of them.
+ */
+#include <test/harness.h>
+
+static constexpr size_t deposit_count = 100;
+
+static std::atomic<size_t> checked = 0;
+
+struct Account : public VCown<Account>
+{
+  size_t balance = 0;
+};
+
+/// The layout of a `when (account) { account.balance += amount }`: the
+/// descriptor of the behaviour, then the captured variables.
+struct Deposit
+{
+  const Behaviour::Descriptor* descriptor;
+  Account* account;
+  size_t amount;
+};
+
+void deposit_f(Behaviour* b)
+{
+  auto d = reinterpret_cast<Deposit*>(b);
+  d->account->balance += d->amount;
+}
+
+/// The accounts are held through the requests of the behaviour, not through
+/// the captured pointers, so there is nothing to trace.
+void no_trace(const Behaviour*, ObjectStack&) {}
+
+static const Behaviour::Descriptor deposit_desc = {
+  sizeof(Deposit), deposit_f, no_trace};
+
+/// The layout of a `when (from, to) { ... }` that moves `amount`.
+struct Transfer
+{
+  const Behaviour::Descriptor* descriptor;
+  Account* from;
+  Account* to;
+  size_t amount;
+};
+
+void transfer_f(Behaviour* b)
+{
+  auto t = reinterpret_cast<Transfer*>(b);
+  check(t->from->balance >= t->amount);
+  t->from->balance -= t->amount;
+  t->to->balance += t->amount;
+}
+
+static const Behaviour::Descriptor transfer_desc = {
+  sizeof(Transfer), transfer_f, no_trace};
+
+struct Check : public VBehaviour<Check>
+{
+  Account* account;
+  size_t expected;
+
+  Check(Account* account, size_t expected)
+  : account(account), expected(expected)
+  {}
+
+  void f()
+  {
+    check(account->balance == expected);
+    checked++;
+  }
+};
+
+void deposit(Account* account, size_t amount)
+{
+  Request request = Request::write(account);
+  auto body = Cown::prepare_raw(1, &request, &deposit_desc, alignof(Deposit));
+  auto& d = reinterpret_cast<Deposit&>(body->get_behaviour());
+  d.account = account;
+  d.amount = amount;
+  Cown::send_prepared(body);
+}
+
+void transfer(Account* from, Account* to, size_t amount, bool swap)
+{
+  Request requests[2] = {Request::write(from), Request::write(to)};
+  if (swap)
+    std::swap(requests[0], requests[1]);
+
+  auto body = Cown::prepare_raw(2, requests, &transfer_desc, alignof(Transfer));
+  auto& t = reinterpret_cast<Transfer&>(body->get_behaviour());
+  t.from = from;
+  t.to = to;
+  t.amount = amount;
+  Cown::send_prepared(body);
+}
+
+void test_raw_behaviour()
+{
+  // Check the previous seed ran to completion.
+  check((checked == 0) || (checked == 2));
+  checked = 0;
+
+  auto* a = new Account;
+  auto* b = new Account;
+
+  for (size_t i = 1; i <= deposit_count; i++)
+    deposit(a, i);
+
+  size_t total = deposit_count * (deposit_count + 1) / 2;
+  transfer(a, b, 10, false);
+  transfer(b, a, 5, true);
+
+  Cown::schedule<Check>(a, a, total - 5);
+  Cown::schedule<Check>(b, b, 5);
+
+  auto& alloc = ThreadAlloc::get();
+  Cown::release(alloc, a);
+  Cown::release(alloc, b);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_raw_behaviour);
+  check(checked == 2);
+  return 0;
+}
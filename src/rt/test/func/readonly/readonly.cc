@@ -72,8 +72,38 @@ void test_read_only_fast_send()
     };
 }
 
+static std::atomic<size_t> reads = 0;
+
+void test_read_batch()
+{
+  // Runs of readers longer than a batch, separated by writes, that may be
+  // dispatched together by `Cown::run_readers`.
+  static constexpr size_t runs = 3;
+  static constexpr size_t readers = 20;
+
+  reads = 0;
+  cown_ptr<Account> account = make_cown<Account>(0);
+
+  for (size_t r = 0; r < runs; r++)
+  {
+    for (size_t i = 0; i < readers; i++)
+    {
+      when(read(account)) << [r](acquired_cown<const Account> account) {
+        check(account->balance == (int)r);
+        reads++;
+      };
+    }
+
+    when(account) << [r](acquired_cown<Account> account) {
+      check(reads == (r + 1) * readers);
+      account->balance++;
+    };
+  }
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
   harness.run(test_read_only);
+  harness.run(test_read_batch);
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Releases trees of regions in the background, with `region_release_later`.
+ * The harness checks that every region has been deallocated once the
+ * scheduler has finished.
+ */
+#include <test/harness.h>
+
+struct Node : public V<Node>
+{
+  // In the same region.
+  Node* next = nullptr;
+  // The root of a sub-region.
+  Node* sub = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+
+    if (sub != nullptr)
+      st.push(sub);
+  }
+
+  void finaliser(Object* region, ObjectStack& sub_regions)
+  {
+    Object::add_sub_region(sub, region, sub_regions);
+  }
+};
+
+/**
+ * Builds a tree of 2^(depth+1)-1 regions, each with two objects.
+ */
+Node* make_tree(Alloc& alloc, size_t depth)
+{
+  auto* root = new (alloc) Node;
+  root->next = new (alloc, root) Node;
+
+  if (depth > 0)
+  {
+    root->sub = make_tree(alloc, depth - 1);
+    root->next->sub = make_tree(alloc, depth - 1);
+  }
+
+  return root;
+}
+
+void release_tree()
+{
+  region_release_later(make_tree(ThreadAlloc::get(), 6));
+}
+
+void release_from_behaviour()
+{
+  schedule_lambda([]() {
+    auto& alloc = ThreadAlloc::get();
+    for (size_t i = 0; i < 4; i++)
+      region_release_later(make_tree(alloc, 4));
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(release_tree);
+  harness.run(release_from_behaviour);
+
+  return 0;
+}
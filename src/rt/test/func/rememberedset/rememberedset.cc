@@ -151,6 +151,60 @@ void merge_test()
   snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
 }
 
+/**
+ * Merging when one of the remembered sets is empty moves the other's table
+ * without touching the reference counts.
+ */
+template<RegionType region_type>
+void merge_empty_test()
+{
+  using RegionClass = typename RegionType_to_class<region_type>::T;
+
+  auto& alloc = ThreadAlloc::get();
+
+  auto create_imm = []() {
+    auto* o = new (RegionType::Trace) C1;
+    freeze(o);
+    return o;
+  };
+  auto* o1 = create_imm();
+  auto* o2 = create_imm();
+
+  // Into an empty set.
+  auto r1 = new (region_type) C1;
+  auto r2 = new (region_type) C1;
+  RegionClass::template insert<YesTransfer>(alloc, r2, o1);
+  {
+    UsingRegion rr(r1);
+    merge(r2);
+  }
+  check(o1->debug_rc() == 1);
+
+  // From an empty set.
+  auto r3 = new (region_type) C1;
+  {
+    UsingRegion rr(r1);
+    merge(r3);
+  }
+  check(o1->debug_rc() == 1);
+
+  // Both sets non-empty, sharing an entry.
+  auto r4 = new (region_type) C1;
+  RegionClass::template insert<YesTransfer>(alloc, r4, o2);
+  RegionClass::insert(alloc, r4, o1);
+  check(o1->debug_rc() == 2);
+  {
+    UsingRegion rr(r1);
+    merge(r4);
+  }
+  check(o1->debug_rc() == 1 && o2->debug_rc() == 1);
+
+  // Releasing the region releases both immutables.
+  region_release(r1);
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+}
+
 int main(int argc, char** argv)
 {
   (void)argc;
@@ -162,5 +216,8 @@ int main(int argc, char** argv)
   merge_test<RegionType::Trace>();
   merge_test<RegionType::Arena>();
 
+  merge_empty_test<RegionType::Trace>();
+  merge_empty_test<RegionType::Arena>();
+
   return 0;
 }
\ No newline at end of file
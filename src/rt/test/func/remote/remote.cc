@@ -0,0 +1,186 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the remote cowns of `cpp/remote.h`.
+ *
+ * Two hosts in the same process stand for two processes, connected by a Unix
+ * domain socket pair. The client sends transfers between two accounts of the
+ * server, which acquire both accounts at once, and appends to a log that
+ * checks the behaviours run in the order they were sent. Once the client
+ * closes its link, the server closes its own, and releases the accounts,
+ * which check their balances. The runtime then terminates.
+ *
+ * A second test writes frames to the server by hand. A frame with fewer
+ * values than its handler reads runs with a reader that is no longer ok. A
+ * frame with more cown ids than fit in it closes the link, and the frames
+ * after it are not run.
+ */
+#include <cpp/remote.h>
+#include <test/harness.h>
+
+#if defined(__linux__)
+using namespace verona::cpp;
+
+static constexpr size_t transfers = 200;
+static constexpr int initial = 1000;
+
+enum : uint32_t
+{
+  TRANSFER,
+  APPEND,
+  SHORT,
+};
+
+struct Account
+{
+  int balance = initial;
+  int expected;
+
+  Account(int expected) : expected(expected) {}
+
+  ~Account()
+  {
+    check(balance == expected);
+  }
+};
+
+struct Log
+{
+  uint64_t next = 0;
+
+  ~Log()
+  {
+    check(next == transfers);
+  }
+};
+
+void serve(std::shared_ptr<remote::Host> host, int fd)
+{
+  // Even transfers go from alice to bob, and odd ones back, so alice gains
+  // one for each pair.
+  int gain = (int)transfers / 2;
+  host->export_cown(1, make_cown<Account>(initial + gain));
+  host->export_cown(2, make_cown<Account>(initial - gain));
+  host->export_cown(3, make_cown<Log>());
+
+  host->handle<Account, Account>(
+    TRANSFER,
+    [](
+      remote::Reader& r,
+      acquired_cown<Account>& from,
+      acquired_cown<Account>& to) {
+      auto amount = r.get<int>();
+      from->balance -= amount;
+      to->balance += amount;
+      check(r.remaining() == 0);
+    });
+
+  host->handle<Log>(APPEND, [](remote::Reader& r, acquired_cown<Log>& log) {
+    check(r.get<uint64_t>() == log->next);
+    log->next++;
+  });
+
+  host->connect(fd);
+}
+
+void test_remote()
+{
+  io::start();
+
+  int fds[2];
+  check(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+  auto server = remote::Host::create();
+  serve(server, fds[0]);
+
+  auto client = remote::Host::create();
+  auto link = client->connect(fds[1]);
+  auto alice = remote::import<Account>(link, 1);
+  auto bob = remote::import<Account>(link, 2);
+  auto log = remote::import<Log>(link, 3);
+
+  for (size_t i = 0; i < transfers; i++)
+  {
+    if (i % 2 == 0)
+      remote::when(alice, bob).call(TRANSFER, (int)i);
+    else
+      remote::when(bob, alice).call(TRANSFER, (int)i);
+    remote::when(log).call(APPEND, (uint64_t)i);
+  }
+
+  remote::Link::close(link);
+}
+
+struct Seen
+{
+  size_t frames = 0;
+
+  ~Seen()
+  {
+    check(frames == 1);
+  }
+};
+
+/// Append a frame with the header fields given, and then `values`.
+static void put_frame(
+  std::vector<uint8_t>& bytes,
+  uint32_t handler,
+  uint32_t count,
+  const std::vector<uint64_t>& ids,
+  const std::vector<uint8_t>& values = {})
+{
+  std::vector<uint8_t> frame(sizeof(uint32_t));
+  remote::Writer w(frame);
+  w.put(handler);
+  w.put(count);
+  for (auto id : ids)
+    w.put(id);
+  w.put_bytes(values.data(), values.size());
+
+  uint32_t length = (uint32_t)(frame.size() - sizeof(uint32_t));
+  memcpy(frame.data(), &length, sizeof(length));
+  bytes.insert(bytes.end(), frame.begin(), frame.end());
+}
+
+void test_malformed()
+{
+  io::start();
+
+  int fds[2];
+  check(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+  auto server = remote::Host::create();
+  server->export_cown(1, make_cown<Seen>());
+  server->handle<Seen>(SHORT, [](remote::Reader& r, acquired_cown<Seen>& s) {
+    // The frame has two bytes of values, too few for a uint64_t.
+    check(r.remaining() == 2);
+    check(r.get<uint64_t>() == 0);
+    check(!r.ok());
+    s->frames++;
+  });
+  server->connect(fds[0]);
+
+  std::vector<uint8_t> bytes;
+  put_frame(bytes, SHORT, 1, {1}, {0xff, 0xff});
+  // Claims far more cown ids than the frame holds.
+  put_frame(bytes, SHORT, 0xffffffff, {1});
+  put_frame(bytes, SHORT, 1, {1}, {0xff, 0xff});
+  check(::write(fds[1], bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+  ::close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_remote);
+  harness.run(test_malformed);
+  io::stop();
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the scheduler counters, see `ThreadPool::snapshot_stats`.
+ *
+ * A chain of behaviours runs on a cown, and the last one reads the counters
+ * of all cores, which must account for at least the behaviours and messages
+ * of the chain before it, and writes them in the Prometheus format.
+ */
+#include <cpp/when.h>
+#include <sstream>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t behaviours = 100;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void check_stats()
+{
+  auto snapshots = Scheduler::snapshot_stats();
+  check(!snapshots.empty());
+
+  SchedulerSnapshot total;
+  for (auto& s : snapshots)
+  {
+    check(s.core != SIZE_MAX);
+    total.add(s);
+  }
+
+  check(total.behaviours >= behaviours);
+  check(total.messages >= behaviours);
+
+  size_t batches = 0;
+  for (auto b : total.batches)
+    batches += b;
+  check(batches >= 1);
+
+  size_t stolen = 0;
+  for (auto d : total.steal_distances)
+    stolen += d;
+  check(stolen == total.steals);
+
+  std::stringstream o;
+  Scheduler::write_stats_prometheus(o);
+  auto text = o.str();
+  check(text.find("# TYPE verona_behaviours_total counter") != text.npos);
+  check(text.find("verona_queued{core=") != text.npos);
+}
+
+void test_sched_stats()
+{
+  auto c = make_cown<Counter>();
+
+  for (size_t i = 0; i < behaviours; i++)
+    when(c) << [](acquired_cown<Counter> c) { c->count++; };
+
+  when(c) << [](acquired_cown<Counter> c) {
+    check(c->count == behaviours);
+    check_stats();
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_sched_stats);
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests the scratch memory of behaviours, see `scratch::alloc`.
+ *
+ * Behaviours on the same cown fill scratch memory with a pattern, including
+ * allocations that span several arenas and allocations too large for an
+ * arena, and check that the memory is aligned and that the pattern is intact
+ * before they return.
+ */
+#include <cstring>
+#include <iterator>
+#include <test/harness.h>
+
+struct TestCown : public VCown<TestCown>
+{};
+
+struct Point
+{
+  size_t x;
+  size_t y;
+
+  Point(size_t x, size_t y) : x(x), y(y) {}
+};
+
+static constexpr size_t small = 1000;
+static constexpr size_t medium = 300 * 1024;
+static constexpr size_t large = 3 * 1024 * 1024;
+
+void fill(size_t seed)
+{
+  // The medium allocations do not all fit into one arena.
+  size_t sizes[] = {1, small, medium, medium, medium, medium, large, small};
+  uint8_t* blocks[std::size(sizes)];
+
+  for (size_t i = 0; i < std::size(sizes); i++)
+  {
+    blocks[i] = (uint8_t*)scratch::alloc(sizes[i]);
+    check(((uintptr_t)blocks[i] % Object::ALIGNMENT) == 0);
+    memset(blocks[i], (int)(seed + i), sizes[i]);
+  }
+
+  Point* points[small];
+  for (size_t i = 0; i < small; i++)
+    points[i] = scratch::make<Point>(i, seed);
+
+  for (size_t i = 0; i < std::size(sizes); i++)
+    for (size_t j = 0; j < sizes[i]; j++)
+      check(blocks[i][j] == (uint8_t)(seed + i));
+
+  for (size_t i = 0; i < small; i++)
+    check((points[i]->x == i) && (points[i]->y == seed));
+}
+
+void test_scratch()
+{
+  auto c = new TestCown;
+
+  for (size_t seed = 0; seed < 10; seed++)
+  {
+    schedule_lambda(c, [seed]() { fill(seed); });
+    schedule_lambda([seed]() { fill(seed); });
+  }
+
+  Cown::release(ThreadAlloc::get(), c);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_scratch);
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests `schedule_task`.
+ *
+ * A behaviour fans out more tasks than fit in the task ring of its core, each
+ * of which schedules a further task, so tasks are added from both behaviours
+ * and tasks, overflow onto behaviours, and are stolen by other threads. Tasks
+ * are also scheduled from outside the runtime. Every task must run exactly
+ * once.
+ */
+#include <test/harness.h>
+
+static constexpr size_t TASKS = 1000;
+
+struct Total
+{
+  std::atomic<size_t> count{0};
+  size_t expected;
+
+  Total(size_t expected) : expected(expected) {}
+
+  ~Total()
+  {
+    check(count == expected);
+  }
+};
+
+void fan_out(std::shared_ptr<Total> total)
+{
+  for (size_t i = 0; i < TASKS; i++)
+  {
+    schedule_task([total]() {
+      total->count++;
+      schedule_task([total]() { total->count++; });
+    });
+  }
+}
+
+void test_behaviour()
+{
+  auto total = std::make_shared<Total>(2 * TASKS);
+  schedule_lambda([total]() { fan_out(total); });
+}
+
+void test_external()
+{
+  auto total = std::make_shared<Total>(2 * TASKS);
+  fan_out(total);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_behaviour);
+  harness.run(test_external);
+  return 0;
+}
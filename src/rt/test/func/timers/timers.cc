@@ -0,0 +1,77 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests delayed behaviours, see `when_after` and
+ * `schedule_lambda_after`.
+ *
+ * Behaviours are scheduled with a range of delays, both from outside the
+ * runtime and from inside behaviours, including chains of delayed behaviours
+ * that each schedule the next. Each checks that its delay has passed. The
+ * runtime must stay alive until all of them have run, although there is no
+ * other work while they wait, and the log must only be collected once they
+ * have all run.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+using namespace std::chrono;
+
+static constexpr size_t delays[] = {0, 1, 3, 10, 25};
+static constexpr size_t chain_length = 5;
+
+struct Log
+{
+  size_t count = 0;
+
+  ~Log()
+  {
+    check(count == std::size(delays) + chain_length);
+  }
+};
+
+static steady_clock::time_point start;
+
+void check_elapsed(size_t delay_ms, steady_clock::time_point since)
+{
+  // Ticks are whole milliseconds, so a timer may fire up to one millisecond
+  // early by the clock.
+  check(steady_clock::now() - since + 1ms >= milliseconds(delay_ms));
+}
+
+void chain(cown_ptr<Log> log, size_t remaining)
+{
+  auto since = steady_clock::now();
+  when_after(2ms, log) << [log, remaining, since](acquired_cown<Log> l) {
+    check_elapsed(2, since);
+    l->count++;
+    if (remaining > 1)
+      chain(log, remaining - 1);
+  };
+}
+
+void test_timers()
+{
+  start = steady_clock::now();
+  auto log = make_cown<Log>();
+
+  for (auto d : delays)
+  {
+    when_after(milliseconds(d), log) << [d](acquired_cown<Log> l) {
+      check_elapsed(d, start);
+      l->count++;
+    };
+  }
+
+  schedule_lambda_after(5ms, []() { check_elapsed(5, start); });
+
+  when(log) << [log](acquired_cown<Log>) { chain(log, chain_length); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_timers);
+  return 0;
+}
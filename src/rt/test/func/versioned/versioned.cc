@@ -0,0 +1,165 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests publishing the versions of a persistent structure on a
+ * `VersionedNoticeboard`.
+ *
+ * The structure is a node that points to a fixed number of leaves. Each
+ * update builds a new node in a region of its own, that points to all the
+ * leaves of the previous version but one, which it replaces with a new leaf
+ * holding one more. Only the new node and leaf are frozen; the other leaves
+ * are shared with the previous version. Readers peek at the versions while
+ * they are published, and each must hold as many as its version number in
+ * total, and be no older than the one seen before.
+ */
+#include "test/xoroshiro.h"
+
+#include <test/harness.h>
+
+static constexpr size_t leaves = 8;
+static constexpr size_t updates = 100;
+static constexpr size_t readers = 4;
+static constexpr size_t peeks = 50;
+
+struct Leaf : public V<Leaf>
+{
+  size_t value;
+
+  Leaf(size_t value) : value(value) {}
+
+  void trace(ObjectStack&) const {}
+};
+
+struct Node : public V<Node>
+{
+  size_t version;
+  Leaf* leaf[leaves] = {};
+
+  Node(size_t version) : version(version) {}
+
+  void trace(ObjectStack& st) const
+  {
+    for (auto l : leaf)
+      st.push(l);
+  }
+};
+
+struct Store : public VCown<Store>
+{
+  VersionedNoticeboard board;
+  xoroshiro::p128r32 rng;
+  size_t n = 0;
+
+  Store(Object* initial, size_t seed) : board(initial), rng(seed)
+  {
+#ifdef USE_SYSTEMATIC_TESTING_WEAK_NOTICEBOARDS
+    register_noticeboard(&board);
+#endif
+  }
+
+  void trace(ObjectStack& fields) const
+  {
+    board.trace(fields);
+  }
+};
+
+struct Update : public VBehaviour<Update>
+{
+  Store* store;
+
+  Update(Store* store) : store(store) {}
+
+  void f()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* old = (Node*)store->board.latest();
+    size_t i = store->rng.next() % leaves;
+
+    auto* node = new (RegionType::Trace) Node(old->version + 1);
+    {
+      UsingRegion rr(node);
+      for (size_t j = 0; j < leaves; j++)
+        node->leaf[j] = old->leaf[j];
+      node->leaf[i] = new Leaf(old->leaf[i]->value + 1);
+    }
+
+    store->board.publish(alloc, node);
+    check(node->debug_is_immutable());
+
+    if (++store->n < updates)
+      Cown::schedule<Update>(store, store);
+  }
+};
+
+struct Reader : public VCown<Reader>
+{
+  Store* store;
+  size_t seen = 0;
+  size_t n = 0;
+
+  Reader(Store* store) : store(store) {}
+
+  void trace(ObjectStack& fields) const
+  {
+    fields.push(store);
+  }
+};
+
+struct Peek : public VBehaviour<Peek>
+{
+  Reader* reader;
+
+  Peek(Reader* reader) : reader(reader) {}
+
+  void f()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* node = (Node*)reader->store->board.peek(alloc);
+
+    size_t total = 0;
+    for (auto l : node->leaf)
+      total += l->value;
+    check(total == node->version);
+    check(node->version >= reader->seen);
+    reader->seen = node->version;
+
+    Immutable::release(alloc, node);
+
+    if (++reader->n < peeks)
+      Cown::schedule<Peek>(reader, reader);
+  }
+};
+
+void test_versioned(SystematicTestHarness* harness)
+{
+  auto& alloc = ThreadAlloc::get();
+
+  auto* node = new (RegionType::Trace) Node(0);
+  {
+    UsingRegion rr(node);
+    for (auto& l : node->leaf)
+      l = new Leaf(0);
+  }
+  freeze(node);
+
+  auto* store = new Store(node, harness->current_seed());
+  Cown::schedule<Update>(store, store);
+
+  for (size_t i = 0; i < readers; i++)
+  {
+    Cown::acquire(store);
+    auto* reader = new Reader(store);
+    Cown::schedule<Peek>(reader, reader);
+    Cown::release(alloc, reader);
+  }
+
+  Cown::release(alloc, store);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_versioned, &harness);
+  return 0;
+}
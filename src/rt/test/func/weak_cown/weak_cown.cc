@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests weak references to cowns, see `weak_cown_ptr`.
+ *
+ * A weak reference is upgraded while the cown is alive, and a behaviour is
+ * scheduled through it with `when_alive`. Once the last strong reference
+ * is dropped, the state of the cown is destroyed, upgrading fails, and
+ * behaviours scheduled through the weak reference are dropped. The harness
+ * checks that the stubs are freed once the weak references are dropped too.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static std::atomic<size_t> live = 0;
+
+struct Session
+{
+  size_t hits = 0;
+
+  Session()
+  {
+    live++;
+  }
+
+  ~Session()
+  {
+    live--;
+  }
+};
+
+void test_weak_cown()
+{
+  auto strong = make_cown<Session>();
+  weak_cown_ptr<Session> weak = strong;
+  weak_cown_ptr<Session> copy = weak;
+
+  auto upgraded = copy.try_lock();
+  check(upgraded);
+  upgraded.clear();
+
+  check(when_alive(weak) << [](acquired_cown<Session> s) { s->hits++; });
+
+  when(strong) << [weak](acquired_cown<Session> s) {
+    check(s->hits == 1);
+    check(weak.try_lock());
+  };
+}
+
+void test_dead_cown()
+{
+  when() << []() {
+    auto strong = make_cown<Session>();
+    weak_cown_ptr<Session> weak = strong;
+    check(live == 1);
+
+    // Nothing else holds the cown, so this collects its state.
+    strong.clear();
+    check(live == 0);
+    check(!weak.try_lock());
+    check(!(when_alive(weak) << [](acquired_cown<Session>) { check(false); }));
+  };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_weak_cown);
+  harness.run(test_dead_cown);
+  return 0;
+}
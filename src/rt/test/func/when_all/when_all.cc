@@ -0,0 +1,78 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests `when_all`, which acquires a number of cowns only known at
+ * runtime.
+ *
+ * Transactions move an amount between a random set of accounts, which may
+ * name the same account more than once. The total must be unchanged, and
+ * each behaviour must see each account once. Readers of all the accounts
+ * check the total as the transactions run.
+ */
+#include "test/xoroshiro.h"
+
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t accounts = 64;
+static constexpr size_t transactions = 200;
+static constexpr size_t initial = 100;
+
+struct Account
+{
+  size_t balance = initial;
+};
+
+void check_total(acquired_cowns<const Account> cs)
+{
+  check(cs.size() == accounts);
+  size_t total = 0;
+  for (size_t i = 0; i < cs.size(); i++)
+    total += cs[i].balance;
+  check(total == accounts * initial);
+}
+
+void test_when_all(SystematicTestHarness* harness)
+{
+  auto all = make_cowns<Account>(accounts);
+  std::vector<cown_ptr<const Account>> readers(all.begin(), all.end());
+
+  xoroshiro::p128r32 rng(harness->current_seed());
+  for (size_t t = 0; t < transactions; t++)
+  {
+    std::vector<cown_ptr<Account>> picked;
+    size_t n = 1 + rng.next() % accounts;
+    for (size_t i = 0; i < n; i++)
+      picked.push_back(all[rng.next() % accounts]);
+
+    when_all(picked) << [](acquired_cowns<Account> cs) {
+      for (size_t i = 1; i < cs.size(); i++)
+        check(&cs[i - 1] != &cs[i]);
+
+      // Move one from each account to the first.
+      for (size_t i = 1; i < cs.size(); i++)
+      {
+        if (cs[i].balance > 0)
+        {
+          cs[i].balance--;
+          cs[0].balance++;
+        }
+      }
+    };
+
+    if ((t % 50) == 0)
+      when_all(readers) << check_total;
+  }
+
+  when_all(readers) << check_total;
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_when_all, &harness);
+  return 0;
+}
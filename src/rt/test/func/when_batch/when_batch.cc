@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests scheduling batches of behaviours, see `Cown::schedule_many` and
+ * `when_batch`.
+ *
+ * Batches are sent to a set of cowns, where each cown appears several times
+ * in a row, so its behaviours are enqueued as one segment. The test checks
+ * that every behaviour runs exactly once, and that the behaviours of a batch
+ * run after the behaviours sent to the same cowns before it.
+ */
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+static constexpr size_t cown_count = 6;
+static constexpr size_t repeats = 4;
+static constexpr size_t rounds = 10;
+
+struct Counter
+{
+  size_t count = 0;
+};
+
+void test_when_batch()
+{
+  std::vector<cown_ptr<Counter>> counters;
+  for (size_t i = 0; i < cown_count; i++)
+    counters.push_back(make_cown<Counter>());
+
+  std::vector<cown_ptr<Counter>> batch;
+  for (auto& c : counters)
+  {
+    for (size_t r = 0; r < repeats; r++)
+      batch.push_back(c);
+  }
+
+  for (size_t round = 0; round < rounds; round++)
+  {
+    when_batch(batch) << [round](acquired_cown<Counter> c) {
+      // All the behaviours of the previous rounds have run.
+      check(c->count >= round * repeats);
+      check(c->count < (round + 1) * repeats);
+      c->count++;
+    };
+  }
+
+  for (auto& c : counters)
+  {
+    when(c) << [](acquired_cown<Counter> c) {
+      check(c->count == rounds * repeats);
+    };
+  }
+}
+
+static std::atomic<size_t> received = 0;
+static size_t expected = 0;
+
+void test_schedule_many()
+{
+  // Check the previous seed ran to completion.
+  check(received == expected);
+  received = 0;
+  expected = cown_count * repeats;
+
+  Cown* cowns[cown_count * repeats];
+  for (size_t i = 0; i < cown_count; i++)
+  {
+    auto* c = new EmptyCown;
+    for (size_t r = 0; r < repeats; r++)
+      cowns[(i * repeats) + r] = c;
+  }
+
+  schedule_lambda_many(
+    cown_count * repeats, cowns, [](size_t) { return []() { received++; }; });
+
+  for (size_t i = 0; i < cown_count; i++)
+    Cown::release(ThreadAlloc::get(), cowns[i * repeats]);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_when_batch);
+  harness.run(test_schedule_many);
+  check(received == expected);
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This tests chaining behaviours with `When::then`.
+ *
+ * A pipeline passes a value through a chain of stages, each on its own cown,
+ * moving the result of each stage into the next. A move-only result checks
+ * that it is never copied, and a stage without a result only passes on the
+ * order. A chain whose first behaviour expires checks that the second is
+ * dropped, and its cowns released, without running.
+ */
+#include <cpp/when.h>
+#include <memory>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Stage
+{
+  size_t seen = 0;
+};
+
+void test_pipeline()
+{
+  auto a = make_cown<Stage>();
+  auto b = make_cown<Stage>();
+  auto c = make_cown<Stage>();
+
+  for (size_t i = 0; i < 10; i++)
+  {
+    when(a).then(b) << [i](acquired_cown<Stage> a) {
+      a->seen++;
+      return std::make_unique<size_t>(i);
+    } << [c](std::unique_ptr<size_t> v, acquired_cown<Stage> b) {
+      b->seen++;
+      when(read(b)).then(c) << [x = *v](acquired_cown<const Stage>) {
+        return x * 2;
+      } << [](size_t x, acquired_cown<Stage> c) { c->seen += x; };
+    };
+  }
+
+  when(a).then(a, b) << [](acquired_cown<Stage> a) { check(a->seen == 10); }
+                     << [](acquired_cown<Stage>, acquired_cown<Stage> b) {
+                          check(b->seen == 10);
+                        };
+}
+
+void test_expired()
+{
+  auto a = make_cown<Stage>();
+  auto b = make_cown<Stage>();
+
+  when(a)
+      .with_deadline(std::chrono::steady_clock::time_point::min())
+      .then(b)
+    << [](acquired_cown<Stage>) { return 1; }
+    << [](int, acquired_cown<Stage>) { check(false); };
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_pipeline);
+  harness.run(test_expired);
+  return 0;
+}
@@ -2,9 +2,11 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <list>
+#include <vector>
 #include <test/opt.h>
 #include <verona.h>
 
@@ -61,7 +63,16 @@ inline void busy_loop(size_t u_sec)
 
 class SystematicTestHarness
 {
+  /// Run time and schedule of a seed, see `--profile`.
+  struct SeedProfile
+  {
+    size_t seed;
+    microseconds time;
+    Systematic::Counters counters;
+  };
+
   size_t seed = 0;
+  std::vector<SeedProfile> profiles;
   /**
    * External threads created during execution can only be joined once
    * sched.run() is finished. Not joining on these threads can lead to a race
@@ -79,6 +90,15 @@ public:
   opt::Opt opt;
 
   bool detect_leaks;
+  /**
+   * With `--profile`, the run time of each seed is measured and the slowest
+   * `--profile_top` seeds are reported at the end, with the thread switches
+   * of systematic testing. A systematic seed replays the same schedule, so a
+   * slow schedule found this way can be reproduced with `--seed <seed>
+   * --seed_count 1 --profile`, whose timing is that of the real runtime code
+   * but serialised by systematic testing.
+   */
+  bool profile;
   size_t cores;
   size_t seed_lower;
   size_t seed_upper;
@@ -126,6 +146,7 @@ public:
     cores = opt.is<size_t>("--cores", 4);
 
     detect_leaks = !opt.has("--allow_leaks");
+    profile = opt.has("--profile");
     Scheduler::set_detect_leaks(detect_leaks);
 
 #if defined(_WIN32) && defined(CI_BUILD)
@@ -155,6 +176,7 @@ public:
 #else
       UNUSED(seed);
 #endif
+      auto seed_start = high_resolution_clock::now();
       sched.init(cores);
 
       f(std::forward<Args>(args)...);
@@ -173,6 +195,17 @@ public:
 
       Logging::cout() << "External threads joined" << std::endl;
 
+      if (profile)
+      {
+        auto time = duration_cast<microseconds>(
+          high_resolution_clock::now() - seed_start);
+        auto counters = Systematic::get_counters();
+        profiles.push_back({seed, time, counters});
+        std::cout << "Seed " << seed << ": " << time.count() << " us, "
+                  << counters.switches << " switches, " << counters.yields
+                  << " yields" << std::endl;
+      }
+
       if (detect_leaks)
         snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
       high_resolution_clock::time_point t1 = high_resolution_clock::now();
@@ -181,9 +214,38 @@ public:
                 << std::endl;
     }
 
+    if (profile)
+      report_profiles();
+
     std::cout << "Test Harness Finished!" << std::endl;
   }
 
+  /// Report the slowest seeds, compared to the median.
+  void report_profiles()
+  {
+    if (profiles.empty())
+      return;
+
+    std::sort(profiles.begin(), profiles.end(), [](auto& a, auto& b) {
+      return a.time > b.time;
+    });
+    auto median = profiles[profiles.size() / 2].time;
+    size_t top = std::min(opt.is<size_t>("--profile_top", 10), profiles.size());
+
+    std::cout << "Slowest " << top << " of " << profiles.size()
+              << " seeds, median " << median.count() << " us:" << std::endl;
+    for (size_t i = 0; i < top; i++)
+    {
+      auto& p = profiles[i];
+      std::cout << "  --seed " << p.seed << ": " << p.time.count() << " us ("
+                << ((double)p.time.count() /
+                    (double)std::max<int64_t>(median.count(), 1))
+                << "x median), " << p.counters.switches << " switches, "
+                << p.counters.yields << " yields" << std::endl;
+    }
+    profiles.clear();
+  }
+
   /**
    * Add an external thread to the system, which will be joined after
    * sched.run() finishes. Do not create any verona::PlatformThread or
@@ -11,10 +11,14 @@
  * higher rate than they could process the messages. The muted proxies may also
  * experience similar queue growth if the backpressure is not corretly
  * propagated from the receiver set.
+ *
+ * The benchmark fails if the number of pending messages exceeds
+ * `--max_depth` (zero disables the check).
  */
 
 #include "test/log.h"
 #include "test/opt.h"
+#include "test/queuedepth.h"
 #include "verona.h"
 
 #include <chrono>
@@ -26,6 +30,7 @@ struct Receiver;
 struct Proxy;
 static std::vector<Receiver*> receiver_set;
 static std::vector<Proxy*> proxy_chain;
+static QueueDepth depth;
 
 struct Receiver : public VCown<Receiver>
 {
@@ -38,6 +43,7 @@ struct Receive : public VBehaviour<Receive>
 {
   void f()
   {
+    depth.receive();
     auto& r = *receiver_set[0];
     r.msgs++;
     if ((r.msgs % Receiver::report_count) != 0)
@@ -79,6 +85,8 @@ struct Forward : public VBehaviour<Forward>
 
   void f()
   {
+    depth.receive();
+    depth.send();
     if (proxy != proxy_chain.back())
     {
       auto* next = proxy_chain[proxy->index + 1];
@@ -120,6 +128,7 @@ struct Send : public VBehaviour<Send>
 
   void f()
   {
+    depth.send();
     if (proxy_chain.size() > 0)
       Cown::schedule<Forward>(proxy_chain[0], proxy_chain[0]);
     else
@@ -139,6 +148,7 @@ int main(int argc, char** argv)
   auto receivers = opt.is<size_t>("--receivers", 1);
   auto proxies = opt.is<size_t>("--proxies", 0);
   auto duration = opt.is<size_t>("--duration", 10'000);
+  auto max_depth = opt.is<size_t>("--max_depth", 100'000);
   logger::cout() << "cores: " << cores << ", senders: " << senders
                  << ", receivers: " << receivers << ", duration: " << duration
                  << "ms" << std::endl;
@@ -204,4 +214,8 @@ int main(int argc, char** argv)
 
   sched.run();
   thr.join();
+
+  if (!depth.check(std::chrono::milliseconds(duration), max_depth))
+    return 1;
+  return 0;
 }
@@ -10,10 +10,14 @@
  * relationships between senders and receivers. All receivers must also maintain
  * high load signals despite constantly participating in multi-messages with
  * different sets of cowns.
+ *
+ * The benchmark fails if the number of pending messages exceeds
+ * `--max_depth` (zero disables the check).
  */
 
 #include "test/log.h"
 #include "test/opt.h"
+#include "test/queuedepth.h"
 #include "test/xoroshiro.h"
 #include "verona.h"
 
@@ -22,6 +26,8 @@
 using namespace verona::rt;
 using timer = std::chrono::high_resolution_clock;
 
+static QueueDepth depth;
+
 struct Receiver : public VCown<Receiver>
 {
   size_t msgs = 0;
@@ -50,6 +56,7 @@ struct Receive : public VBehaviour<Receive>
 
   void f()
   {
+    depth.receive();
     for (size_t i = 0; i < receiver_count; i++)
     {
       auto& r = *receivers[i];
@@ -111,6 +118,7 @@ struct Send : public VBehaviour<Send>
         i++;
     }
 
+    depth.send();
     Cown::schedule<Receive>(
       receiver_count, (Cown**)receivers, receivers, receiver_count);
 
@@ -127,6 +135,7 @@ int main(int argc, char** argv)
   const auto senders = opt.is<size_t>("--senders", 100);
   const auto receivers = opt.is<size_t>("--receivers", 10);
   const auto duration = opt.is<size_t>("--duration", 10'000);
+  const auto max_depth = opt.is<size_t>("--max_depth", 100'000);
   logger::cout() << "cores: " << cores << ", senders: " << senders
                  << ", receivers: " << receivers << ", duration: " << duration
                  << "ms" << std::endl;
@@ -161,4 +170,8 @@ int main(int argc, char** argv)
     Cown::release(alloc, r);
 
   sched.run();
+
+  if (!depth.check(std::chrono::milliseconds(duration), max_depth))
+    return 1;
+  return 0;
 }
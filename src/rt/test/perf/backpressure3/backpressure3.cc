@@ -9,10 +9,14 @@
  *
  * A correct implementation of backpressure must ensure that the receivers make
  * progress despite requiring their muted senders to do so.
+ *
+ * The benchmark fails if the number of pending messages exceeds
+ * `--max_depth` (zero disables the check).
  */
 
 #include "test/log.h"
 #include "test/opt.h"
+#include "test/queuedepth.h"
 #include "test/xoroshiro.h"
 #include "verona.h"
 
@@ -21,6 +25,8 @@
 using namespace verona::rt;
 using timer = std::chrono::high_resolution_clock;
 
+static QueueDepth depth;
+
 struct Sender;
 
 struct Receiver : public VCown<Receiver>
@@ -51,8 +57,10 @@ struct Receive : public VBehaviour<Receive>
   void f()
   {
     auto& alloc = ThreadAlloc::get();
+    depth.receive();
     if (s == nullptr)
     {
+      depth.send();
       s = r->senders[r->rng.next() % r->senders.size()];
       auto** cowns = (Cown**)alloc.alloc<2 * sizeof(Cown*)>();
       cowns[0] = (Cown*)r;
@@ -102,6 +110,7 @@ struct Send : public VBehaviour<Send>
 
   void f()
   {
+    depth.send();
     Cown::schedule<Receive>(s->receiver, s->receiver);
 
     if ((timer::now() - s->start) < s->duration)
@@ -119,6 +128,7 @@ int main(int argc, char** argv)
   const auto senders = opt.is<size_t>("--senders", 100);
   const auto duration =
     std::chrono::milliseconds(opt.is<size_t>("--duration", 10'000));
+  const auto max_depth = opt.is<size_t>("--max_depth", 100'000);
 
   logger::cout() << "cores: " << cores << ", senders: " << senders
                  << ", duration: " << duration.count() << "ms" << std::endl;
@@ -149,5 +159,7 @@ int main(int argc, char** argv)
 
   sched.run();
 
+  if (!depth.check(duration, max_depth))
+    return 1;
   return 0;
 }
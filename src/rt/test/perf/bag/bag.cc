@@ -0,0 +1,100 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark measures iterating a bag after most of its elements have
+ * been removed, which leaves holes that the iterator has to skip, and again
+ * after the bag has been compacted. It also compares removal with `remove`
+ * against `remove_compact`.
+ */
+#include "ds/bag.h"
+
+#include <iomanip>
+#include <test/harness.h>
+#include <test/measuretime.h>
+#include <test/opt.h>
+#include <test/xoroshiro.h>
+#include <vector>
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+using E = BagElem<uintptr_t, uintptr_t>;
+using B = BagBase<E, Alloc>;
+
+size_t iterate(const char* name, B& bag, size_t live)
+{
+  size_t sum = 0;
+  MeasureTime m;
+  m << "iterate " << name << std::setw(10) << live;
+  for (auto entry : bag)
+    sum += entry->metadata;
+  return sum;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto entries = opt.is<size_t>("--entries", 1'000'000);
+  const auto keep = opt.is<size_t>("--keep", 16);
+  const auto seed = opt.is<size_t>("--seed", 5489);
+
+  auto& alloc = ThreadAlloc::get();
+  xoroshiro::p128r64 rng(seed);
+
+  // Remove all but one in `keep` elements, in a random order.
+  std::vector<uintptr_t> order;
+  for (uintptr_t i = 0; i < entries; i++)
+    order.push_back(i);
+  for (size_t i = order.size() - 1; i > 0; i--)
+    std::swap(order[i], order[rng.next() % (i + 1)]);
+  order.resize(entries - (entries / keep));
+  const size_t live = entries - order.size();
+
+  {
+    B bag;
+    std::vector<E*> items;
+    for (uintptr_t i = 0; i < entries; i++)
+      items.push_back(bag.insert({0, i}, alloc));
+
+    {
+      MeasureTime m;
+      m << "remove          " << std::setw(10) << order.size();
+      for (auto i : order)
+        bag.remove(items[i]);
+    }
+
+    size_t before = iterate("with holes ", bag, live);
+
+    {
+      MeasureTime m;
+      m << "compact         " << std::setw(10) << entries;
+      bag.compact(alloc, [&](E* e) { items[e->metadata] = e; });
+    }
+
+    size_t after = iterate("compacted  ", bag, live);
+    check(before == after);
+    bag.dealloc(alloc);
+  }
+
+  {
+    B bag;
+    std::vector<E*> items;
+    for (uintptr_t i = 0; i < entries; i++)
+      items.push_back(bag.insert({0, i}, alloc));
+
+    {
+      MeasureTime m;
+      m << "remove_compact  " << std::setw(10) << order.size();
+      for (auto i : order)
+        bag.remove_compact(
+          items[i], alloc, [&](E* e) { items[e->metadata] = e; });
+    }
+
+    iterate("no holes   ", bag, live);
+    bag.dealloc(alloc);
+  }
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
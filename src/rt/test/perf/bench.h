@@ -0,0 +1,222 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <test/opt.h>
+#include <vector>
+#include <verona.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+// Must follow windows.h
+#  include <psapi.h>
+#  pragma comment(lib, "psapi.lib")
+#else
+#  include <sys/resource.h>
+#endif
+
+/**
+ * Common driver for benchmarks, see `test/perf/suite`.
+ *
+ * Each scenario passed to `run` is run on each core count from
+ * `--min_cores` to `--cores`, doubling, first `--warmup` times without
+ * recording, then `--repeats` times. A scenario schedules the work of one
+ * run, and returns the number of operations it performs, which
+ * `sched.run()` then completes. Scenarios may also record the latency of
+ * their operations with `record_latency`.
+ *
+ * Operations that do not need the scheduler threads, such as those on
+ * regions, are timed on the calling thread with `measure` instead.
+ *
+ * `report` writes a line per recorded run, with the throughput, the median
+ * and 99th percentile latencies and the peak resident set size of the
+ * process, as JSON with `--json`, CSV with `--csv`, or text otherwise.
+ * Progress is written to `std::cerr`, so that the report can be redirected.
+ */
+class BenchHarness
+{
+public:
+  struct Result
+  {
+    std::string name;
+    size_t cores;
+    size_t repeat;
+    double seconds;
+    size_t ops;
+    /// Operations per second.
+    double throughput;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    size_t rss_kb;
+  };
+
+  opt::Opt opt;
+  size_t min_cores;
+  size_t max_cores;
+  size_t warmup;
+  size_t repeats;
+  /// Multiplier of the size of the scenarios.
+  size_t scale;
+
+private:
+  verona::rt::LatencyHistogram latency;
+  std::vector<Result> results;
+
+  static size_t peak_rss_kb()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+      return 0;
+    return pmc.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#  ifdef __APPLE__
+    // Reported in bytes rather than kilobytes.
+    return (size_t)usage.ru_maxrss / 1024;
+#  else
+    return (size_t)usage.ru_maxrss;
+#  endif
+#endif
+  }
+
+  void add_result(
+    const std::string& name,
+    size_t cores,
+    size_t repeat,
+    std::chrono::steady_clock::duration time,
+    size_t ops)
+  {
+    double seconds = std::chrono::duration<double>(time).count();
+    results.push_back(
+      {name,
+       cores,
+       repeat,
+       seconds,
+       ops,
+       seconds > 0 ? (double)ops / seconds : 0.0,
+       latency.percentile(0.5),
+       latency.percentile(0.99),
+       peak_rss_kb()});
+  }
+
+public:
+  BenchHarness(int argc, const char* const* argv) : opt(argc, argv)
+  {
+    max_cores = opt.is<size_t>("--cores", 4);
+    min_cores = std::min(opt.is<size_t>("--min_cores", 1), max_cores);
+    warmup = opt.is<size_t>("--warmup", 1);
+    repeats = opt.is<size_t>("--repeats", 3);
+    scale = opt.is<size_t>("--scale", 1);
+  }
+
+  /// Record the latency of an operation. This may be called by any thread.
+  void record_latency(std::chrono::nanoseconds ns)
+  {
+    latency.record((uint64_t)ns.count());
+  }
+
+  template<typename F>
+  void run(const char* name, F&& setup)
+  {
+    for (size_t cores = min_cores;; cores = std::min(cores * 2, max_cores))
+    {
+      for (size_t i = 0; i < warmup + repeats; i++)
+      {
+        std::cerr << name << ": cores " << cores << ", run " << i
+                  << std::endl;
+
+        auto& sched = verona::rt::Scheduler::get();
+#ifdef USE_SYSTEMATIC_TESTING
+        verona::rt::Systematic::set_seed(i + 1);
+#endif
+        sched.init(cores);
+        latency.clear();
+        size_t ops = setup(cores);
+
+        auto start = std::chrono::steady_clock::now();
+        sched.run();
+        auto end = std::chrono::steady_clock::now();
+
+        snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+
+        if (i < warmup)
+          continue;
+
+        add_result(name, cores, i - warmup, end - start, ops);
+      }
+
+      if (cores == max_cores)
+        break;
+    }
+  }
+
+  /**
+   * Time `f` on the calling thread, `--warmup` times without recording and
+   * then `--repeats` times. `f` returns the number of operations it
+   * performed, and is reported as running on one core.
+   */
+  template<typename F>
+  void measure(const std::string& name, F&& f)
+  {
+    for (size_t i = 0; i < warmup + repeats; i++)
+    {
+      std::cerr << name << ": run " << i << std::endl;
+
+      latency.clear();
+      auto start = std::chrono::steady_clock::now();
+      size_t ops = f();
+      auto end = std::chrono::steady_clock::now();
+
+      if (i >= warmup)
+        add_result(name, 1, i - warmup, end - start, ops);
+    }
+  }
+
+  /// Write the results, and return the exit code of the driver.
+  int report()
+  {
+    auto& o = std::cout;
+    if (opt.has("--json"))
+    {
+      o << "[";
+      for (size_t i = 0; i < results.size(); i++)
+      {
+        auto& r = results[i];
+        o << (i == 0 ? "\n" : ",\n") << "  {\"benchmark\": \"" << r.name
+          << "\", \"cores\": " << r.cores << ", \"repeat\": " << r.repeat
+          << ", \"seconds\": " << r.seconds << ", \"ops\": " << r.ops
+          << ", \"throughput\": " << r.throughput
+          << ", \"p50_ns\": " << r.p50_ns << ", \"p99_ns\": " << r.p99_ns
+          << ", \"rss_kb\": " << r.rss_kb << "}";
+      }
+      o << "\n]" << std::endl;
+    }
+    else if (opt.has("--csv"))
+    {
+      o << "benchmark,cores,repeat,seconds,ops,throughput,p50_ns,p99_ns,rss_kb"
+        << std::endl;
+      for (auto& r : results)
+      {
+        o << r.name << "," << r.cores << "," << r.repeat << "," << r.seconds
+          << "," << r.ops << "," << r.throughput << "," << r.p50_ns << ","
+          << r.p99_ns << "," << r.rss_kb << std::endl;
+      }
+    }
+    else
+    {
+      for (auto& r : results)
+      {
+        o << r.name << " cores " << r.cores << " repeat " << r.repeat << ": "
+          << r.throughput << " ops/s, p50 " << r.p50_ns << "ns, p99 "
+          << r.p99_ns << "ns, rss " << r.rss_kb << "KB" << std::endl;
+      }
+    }
+    return 0;
+  }
+};
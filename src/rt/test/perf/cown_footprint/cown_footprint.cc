@@ -0,0 +1,82 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark reports the memory used by each idle cown, for programs
+ * with millions of them.
+ *
+ * It allocates `--cowns` cowns, then runs one behaviour on each in turn,
+ * each behaviour sending the next one. Every cown has received a message,
+ * and has gone back to sleep, by the time the last behaviour runs and
+ * measures the memory used by the allocator. The memory of a behaviour
+ * should be reused by the next one, rather than be kept by the cown that
+ * ran it.
+ *
+ * The runtime has a single core, so that each cown is asleep before the next
+ * behaviour runs.
+ */
+#include "test/opt.h"
+#include "verona.h"
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+struct Cell : public VCown<Cell>
+{};
+
+/// State captured by each behaviour, to give it a realistic size.
+using Payload = std::array<uint64_t, 8>;
+
+std::vector<Cell*> cells;
+size_t baseline;
+
+void report()
+{
+  auto used = Alloc::Config::Backend::get_current_usage() - baseline;
+  std::cout << "Cowns: " << cells.size() << std::endl;
+  std::cout << "sizeof(Cown): " << sizeof(Cown) << std::endl;
+  std::cout << "Bytes per idle cown: " << used / cells.size() << std::endl;
+
+  auto& alloc = ThreadAlloc::get();
+  for (auto c : cells)
+    Cown::release(alloc, c);
+  cells.clear();
+}
+
+void visit(size_t i, Payload payload)
+{
+  if (i + 1 == cells.size())
+  {
+    report();
+    return;
+  }
+
+  payload[i % payload.size()]++;
+  schedule_lambda(cells[i + 1], [i, payload]() { visit(i + 1, payload); });
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto cowns = opt.is<size_t>("--cowns", 1'000'000);
+
+  auto& sched = Scheduler::get();
+  sched.init(1);
+
+  schedule_lambda([cowns]() {
+    cells.reserve(cowns);
+    baseline = Alloc::Config::Backend::get_current_usage();
+    for (size_t i = 0; i < cowns; i++)
+      cells.push_back(new Cell);
+
+    schedule_lambda(cells[0], []() { visit(0, Payload{}); });
+  });
+
+  sched.run();
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
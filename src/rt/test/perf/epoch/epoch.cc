@@ -58,8 +58,62 @@ void test_epoch()
   (void)old;
 }
 
-int main(int, char**)
+/**
+ * Deletes many small objects, the size of queue nodes, in bursts of `burst`
+ * per epoch, and reports how far reclamation falls behind under the given
+ * thresholds for advancing the epoch.
+ */
+void test_epoch_bulk(size_t sensible, size_t urgent, size_t burst)
 {
+  auto& alloc = ThreadAlloc::get();
+  constexpr size_t count = 10000000;
+  constexpr size_t size = 32;
+
+  GlobalEpoch::set_thresholds(sensible, urgent);
+  size_t advances = Epoch::get_stats().advances;
+  EpochStats max;
+
+  {
+    MeasureTime m;
+    m << "bulk sensible " << sensible << " urgent " << urgent << " burst "
+      << burst;
+
+    for (size_t n = 0; n < count; n += burst)
+    {
+      {
+        Epoch e(alloc);
+        for (size_t i = 0; i < burst; i++)
+          e.delete_in_epoch(alloc.alloc<size>());
+      }
+
+      auto stats = Epoch::get_stats();
+      max.pending_bytes = std::max(max.pending_bytes, stats.pending_bytes);
+      max.max_lag = std::max(max.max_lag, stats.max_lag);
+    }
+
+    Epoch::flush(alloc);
+  }
+
+  std::cout << "  advances " << Epoch::get_stats().advances - advances
+            << ", max pending bytes " << max.pending_bytes << ", max lag "
+            << max.max_lag << std::endl;
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  if (opt.has("--bulk"))
+  {
+    size_t burst = opt.is<size_t>("--burst", 1000);
+    test_epoch_bulk(8 * 1024, 64 * 1024, burst);
+    test_epoch_bulk(64 * 1024, 512 * 1024, burst);
+    test_epoch_bulk(1024 * 1024, 8 * 1024 * 1024, burst);
+    return 0;
+  }
+
   test_epoch();
   return 0;
 }
@@ -0,0 +1,156 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark measures the throughput, in messages per second, of I/O
+ * completions delivered to cowns.
+ *
+ * A writer thread sends fixed size messages down a set of pipes. Each pipe is
+ * read by a cown, which a behaviour drains whenever the pipe becomes
+ * readable. Readiness is detected either by the scheduler threads, through
+ * `ThreadPool::set_event_poller`, or, with `--thread`, by a separate I/O
+ * thread that schedules the behaviours from outside the runtime.
+ */
+#include <test/opt.h>
+#include <verona.h>
+
+#if defined(__linux__)
+#  include <atomic>
+#  include <chrono>
+#  include <fcntl.h>
+#  include <pal/epoll.h>
+#  include <thread>
+#  include <unistd.h>
+#  include <vector>
+
+using namespace verona::rt;
+
+static size_t pipes;
+static size_t messages;
+static pal::EpollPoller* poller;
+static std::atomic<size_t> remaining;
+static std::atomic<bool> done{false};
+static std::thread io;
+
+struct Conn : public VCown<Conn>
+{
+  pal::EpollPoller::Registration reg;
+  size_t received = 0;
+};
+
+static std::vector<Conn*> conns;
+static std::vector<int> fds;
+
+void finish()
+{
+  // Wait until no thread is dispatching events for the cowns.
+  Scheduler::set_event_poller(nullptr);
+  done = true;
+  if (io.joinable())
+    io.join();
+
+  for (auto c : conns)
+    poller->remove(&c->reg);
+
+  auto& alloc = ThreadAlloc::get();
+  for (auto c : conns)
+    Cown::release(alloc, c);
+  conns.clear();
+
+  Scheduler::remove_external_event_source();
+}
+
+void drain(Conn* c)
+{
+  uint64_t buf[512];
+  ssize_t n;
+  while ((n = read(c->reg.fd, buf, sizeof(buf))) > 0)
+    c->received += (size_t)n / sizeof(uint64_t);
+
+  if ((c->received == messages) && (--remaining == 0))
+    schedule_lambda(finish);
+}
+
+void on_ready(void* data, uint32_t)
+{
+  auto c = static_cast<Conn*>(data);
+  schedule_lambda(c, [c]() { drain(c); });
+}
+
+void write_all()
+{
+  uint64_t msg = 0;
+  for (size_t i = 0; i < messages; i++)
+  {
+    for (size_t p = 0; p < pipes; p++)
+    {
+      if (write(fds[p * 2 + 1], &msg, sizeof(msg)) != sizeof(msg))
+        abort();
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto io_thread = opt.has("--thread");
+  pipes = opt.is<size_t>("--pipes", 8);
+  messages = opt.is<size_t>("--messages", 100'000);
+
+  pal::EpollPoller epoll;
+  poller = &epoll;
+  remaining = pipes;
+
+  fds.resize(pipes * 2);
+  for (size_t i = 0; i < pipes; i++)
+  {
+    if (pipe(&fds[i * 2]) != 0)
+      abort();
+    fcntl(fds[i * 2], F_SETFL, O_NONBLOCK);
+
+    auto c = new Conn;
+    c->reg = {fds[i * 2], on_ready, c};
+    conns.push_back(c);
+    epoll.add(&c->reg, EPOLLIN | EPOLLET);
+  }
+
+  auto& sched = Scheduler::get();
+  sched.init(cores);
+  if (!io_thread)
+    Scheduler::set_event_poller(&epoll);
+
+  schedule_lambda([]() { Scheduler::add_external_event_source(); });
+
+  if (io_thread)
+  {
+    io = std::thread([]() {
+      while (!done)
+        poller->poll(10);
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread writer(write_all);
+  sched.run();
+  auto end = std::chrono::steady_clock::now();
+
+  writer.join();
+  for (auto fd : fds)
+    close(fd);
+
+  double secs = std::chrono::duration<double>(end - start).count();
+  size_t total = pipes * messages;
+  std::cout << (io_thread ? "I/O thread" : "event poller") << ": " << total
+            << " messages in " << secs << " s, " << (size_t)(total / secs)
+            << " messages/s" << std::endl;
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,108 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark compares the Robin Hood `ObjectMap` with the SwissTable
+ * `SwissObjectMap`, on the operations the remembered set and the external
+ * reference table use: inserting the keys of one map into another, as a merge
+ * does, looking them up, marking and unmarking them in a sweep, and erasing.
+ */
+#include "ds/hashmap.h"
+
+#include <iomanip>
+#include <test/harness.h>
+#include <test/measuretime.h>
+#include <test/opt.h>
+#include <test/xoroshiro.h>
+#include <vector>
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+struct Key : public VCown<Key>
+{};
+
+template<template<typename> typename Map>
+void bench(const char* name, std::vector<Key*>& keys, std::vector<Key*>& misses)
+{
+  auto& alloc = ThreadAlloc::get();
+  size_t found = 0;
+  {
+    Map<Object*> source(alloc);
+    for (auto k : keys)
+      source.insert(alloc, k);
+
+    Map<Object*> map(alloc);
+    {
+      MeasureTime m;
+      m << name << " merge:  " << std::setw(10) << keys.size();
+      for (auto it = source.begin(); it != source.end(); ++it)
+        map.insert(alloc, it.key());
+    }
+
+    {
+      MeasureTime m;
+      m << name << " find:   " << std::setw(10) << keys.size();
+      for (auto k : keys)
+        found += map.find(k) != map.end();
+      for (auto k : misses)
+        found += map.find(k) != map.end();
+    }
+
+    {
+      MeasureTime m;
+      m << name << " sweep:  " << std::setw(10) << keys.size();
+      for (size_t i = 0; i < keys.size(); i += 2)
+        map.find(keys[i]).mark();
+
+      for (auto it = map.begin(); it != map.end(); ++it)
+      {
+        if (it.is_marked())
+          it.unmark();
+        else
+          map.erase(it);
+      }
+    }
+
+    {
+      MeasureTime m;
+      m << name << " erase:  " << std::setw(10) << keys.size();
+      for (auto k : keys)
+        map.erase(k);
+    }
+  }
+
+  check(found == keys.size());
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto entries = opt.is<size_t>("--entries", 1'000'000);
+  const auto seed = opt.is<size_t>("--seed", 5489);
+
+  auto& alloc = ThreadAlloc::get();
+  std::vector<Key*> keys;
+  std::vector<Key*> misses;
+  for (size_t i = 0; i < entries; i++)
+  {
+    keys.push_back(new (alloc) Key);
+    misses.push_back(new (alloc) Key);
+  }
+
+  // Insert in a random order, so the maps are not filled in address order.
+  xoroshiro::p128r64 rng(seed);
+  for (size_t i = keys.size() - 1; i > 0; i--)
+    std::swap(keys[i], keys[rng.next() % (i + 1)]);
+
+  bench<ObjectMap>("robin hood", keys, misses);
+  bench<SwissObjectMap>("swiss     ", keys, misses);
+
+  for (auto k : keys)
+    Cown::release(alloc, k);
+  for (auto k : misses)
+    Cown::release(alloc, k);
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark merges many small regions into one, for each kind of region
+ * that supports merging. Each small region holds a short list and, for every
+ * hundredth region, an object too large for an arena, so merging arena
+ * regions appends to both the arena list and the large object ring.
+ *
+ * The time to merge should grow linearly with `--regions`, and not with the
+ * size of the region merged into.
+ */
+#include <iomanip>
+#include <iostream>
+#include <test/measuretime.h>
+#include <test/opt.h>
+#include <vector>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+struct C1 : public V<C1>
+{
+  C1* f1 = nullptr;
+  C1* f2 = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    if (f1 != nullptr)
+      st.push(f1);
+
+    if (f2 != nullptr)
+      st.push(f2);
+  }
+};
+
+struct Large : public V<Large>
+{
+  std::byte data[1024 * 1024];
+};
+
+template<RegionType region_type>
+void test_merge(const char* name, size_t regions)
+{
+  std::vector<C1*> isos;
+  isos.reserve(regions);
+  for (size_t i = 0; i < regions; i++)
+  {
+    auto o = new (region_type) C1;
+    {
+      UsingRegion rr(o);
+      o->f1 = new C1;
+      o->f1->f1 = new C1;
+      if (i % 100 == 0)
+        new Large;
+    }
+    isos.push_back(o);
+  }
+
+  auto root = new (region_type) C1;
+  {
+    MeasureTime m;
+    m << name << " merge: " << std::setw(10) << regions;
+
+    UsingRegion rr(root);
+    C1* last = root;
+    for (auto o : isos)
+    {
+      last->f2 = merge(o);
+      last = o;
+    }
+  }
+
+  region_release(root);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  const auto regions = opt.is<size_t>("--regions", 10'000);
+
+  test_merge<RegionType::Arena>("arena ", regions);
+  test_merge<RegionType::Trace>("trace ", regions);
+  test_merge<RegionType::Hybrid>("hybrid", regions);
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark compares `Promise` with `OneShotPromise`, for promises with
+ * a single waiter.
+ *
+ * Following the pattern of the `promise` func test, each of `--producers`
+ * behaviours creates `--promises` promises in turn. For each one, it
+ * schedules a behaviour that fulfills the promise, and sets a continuation
+ * that adds the value to a checksum. A `Promise` allocates a cown and runs
+ * the continuation in a behaviour on it, a `OneShotPromise` runs the
+ * continuation directly when the promise is fulfilled.
+ */
+
+#include "test/opt.h"
+
+#include <chrono>
+#include <test/harness.h>
+
+static std::atomic<size_t> checksum = 0;
+
+template<template<typename> class P>
+void produce(size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    auto pp = P<size_t>::create_promise();
+
+    schedule_lambda([wp = std::move(pp.second), i]() mutable {
+      P<size_t>::fulfill(std::move(wp), std::move(i));
+    });
+
+    auto on_value =
+      [](std::variant<size_t, typename P<size_t>::PromiseErr> val) {
+        if (std::holds_alternative<size_t>(val))
+          checksum += std::get<size_t>(val);
+        else
+          abort();
+      };
+
+    if constexpr (std::is_same_v<P<size_t>, Promise<size_t>>)
+      pp.first.then(on_value);
+    else
+      std::move(pp.first).then(on_value);
+  }
+}
+
+template<template<typename> class P>
+void bench(const char* name, size_t cores, size_t producers, size_t promises)
+{
+  auto& sched = Scheduler::get();
+  sched.init(cores);
+  checksum = 0;
+
+  for (size_t p = 0; p < producers; p++)
+    schedule_lambda([promises]() { produce<P>(promises); });
+
+  auto start = std::chrono::steady_clock::now();
+  sched.run();
+  auto end = std::chrono::steady_clock::now();
+
+  check(checksum == producers * ((promises * (promises - 1)) / 2));
+
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  size_t total = producers * promises;
+  std::cout << name << ": cores: " << cores << ", promises: " << total
+            << ", time: " << ms.count() << " ms, "
+            << (total * 1000) / std::max<size_t>(ms.count(), 1)
+            << " promises/s" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto cores = opt.is<size_t>("--cores", 4);
+  const auto producers = opt.is<size_t>("--producers", 16);
+  const auto promises = opt.is<size_t>("--promises", 100'000);
+
+  bench<Promise>("Promise", cores, producers, promises);
+  bench<OneShotPromise>("OneShotPromise", cores, producers, promises);
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Compares enqueueing nodes one at a time with enqueueing segments of nodes,
+ * see `MPSCQ::enqueue_segment` and `MPMCQ::enqueue_segment`, with several
+ * producer threads contending on the back of the queue.
+ */
+#include <iomanip>
+#include <iostream>
+#include <test/measuretime.h>
+#include <test/opt.h>
+#include <thread>
+#include <vector>
+#include <verona.h>
+
+using namespace snmalloc;
+using namespace verona::rt;
+
+struct Node
+{
+  static constexpr auto NO_EPOCH_SET = (std::numeric_limits<uint64_t>::max)();
+
+  std::atomic<Node*> next{nullptr};
+  std::atomic<Node*> next_in_queue{nullptr};
+  uint64_t epoch_when_popped{NO_EPOCH_SET};
+
+  void dealloc(Alloc& alloc)
+  {
+    alloc.dealloc<sizeof(Node)>(this);
+  }
+};
+
+/// Link `count` nodes from `nodes` into segments of `length` nodes, and
+/// enqueue them with `enqueue(first, last)`.
+template<typename Enqueue>
+void produce(std::vector<Node*>& nodes, size_t length, Enqueue enqueue)
+{
+  for (size_t i = 0; i < nodes.size(); i += length)
+  {
+    size_t end = std::min(i + length, nodes.size());
+    for (size_t j = i + 1; j < end; j++)
+    {
+      nodes[j - 1]->next.store(nodes[j], std::memory_order_relaxed);
+      nodes[j - 1]->next_in_queue.store(nodes[j], std::memory_order_relaxed);
+    }
+    enqueue(nodes[i], nodes[end - 1]);
+  }
+}
+
+template<typename Enqueue>
+void run(
+  const char* name,
+  size_t producers,
+  size_t count,
+  size_t length,
+  Enqueue enqueue)
+{
+  std::vector<std::vector<Node*>> nodes(producers);
+  {
+    auto& alloc = ThreadAlloc::get();
+    for (auto& v : nodes)
+    {
+      for (size_t i = 0; i < count; i++)
+        v.push_back(new (alloc.alloc<sizeof(Node)>()) Node);
+    }
+  }
+
+  MeasureTime m;
+  m << name << " segment length " << std::setw(3) << length;
+
+  std::vector<std::thread> threads;
+  for (auto& v : nodes)
+    threads.emplace_back([&v, length, enqueue]() {
+      produce(v, length, enqueue);
+    });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+void test_mpscq(size_t producers, size_t count, size_t length)
+{
+  auto& alloc = ThreadAlloc::get();
+  MPSCQ<Node> q;
+  q.init(new (alloc.alloc<sizeof(Node)>()) Node);
+
+  run("MPSCQ", producers, count, length, [&q](Node* first, Node* last) {
+    q.enqueue_segment(first, last);
+  });
+
+  while (q.dequeue(alloc) != nullptr)
+  {}
+  q.destroy()->dealloc(alloc);
+}
+
+void test_mpmcq(size_t producers, size_t count, size_t length)
+{
+  auto& alloc = ThreadAlloc::get();
+  MPMCQ<Node> q(new (alloc.alloc<sizeof(Node)>()) Node);
+
+  run("MPMCQ", producers, count, length, [&q](Node* first, Node* last) {
+    q.enqueue_segment(ThreadAlloc::get(), first, last);
+  });
+
+  while (Node* n = q.dequeue(alloc))
+  {
+    if (((uintptr_t)n & 1) != 0)
+      q.enqueue(alloc, n);
+    else
+      n->dealloc(alloc);
+  }
+  q.destroy(alloc);
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  size_t producers = opt.is<size_t>("--producers", 4);
+  size_t count = opt.is<size_t>("--count", 1'000'000);
+
+  for (size_t length : {1, 4, 16, 64})
+  {
+    test_mpscq(producers, count, length);
+    test_mpmcq(producers, count, length);
+  }
+
+  Epoch::flush(ThreadAlloc::get());
+  return 0;
+}
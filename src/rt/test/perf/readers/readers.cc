@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark measures how read-only behaviours on a single cown scale
+ * with the number of scheduler threads.
+ *
+ * A `Config` cown holds a table that is only read. A number of independent
+ * chains of lookups each send a read-only behaviour to the `Config` cown,
+ * which performs `--work` lookups in the table and then sends the next
+ * behaviour of its chain. As the readers do not conflict, they can run in
+ * parallel on all the scheduler threads.
+ *
+ * The run is repeated for 1, 2, 4, ... up to `--cores` scheduler threads.
+ */
+
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <chrono>
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Config
+{
+  std::vector<size_t> table;
+
+  Config(size_t size) : table(size)
+  {
+    for (size_t i = 0; i < size; i++)
+      table[i] = (i * 7) + 1;
+  }
+};
+
+static size_t work;
+static std::atomic<size_t> checksum = 0;
+
+void lookup(cown_ptr<Config> config, size_t seed, size_t remaining)
+{
+  when(read(config)) << [config, seed, remaining](
+                          acquired_cown<const Config> c) mutable {
+    xoroshiro::p128r32 rng(seed);
+    size_t sum = 0;
+    for (size_t i = 0; i < work; i++)
+      sum += c->table[rng.next() % c->table.size()];
+    checksum += sum;
+
+    if (remaining > 1)
+      lookup(config, seed + 1, remaining - 1);
+  };
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto max_cores = opt.is<size_t>("--cores", 4);
+  const auto chains = opt.is<size_t>("--chains", 64);
+  const auto lookups = opt.is<size_t>("--lookups", 10'000);
+  const auto size = opt.is<size_t>("--size", 1 << 16);
+  work = opt.is<size_t>("--work", 100);
+
+  auto& sched = Scheduler::get();
+
+  for (size_t cores = 1; cores <= max_cores; cores *= 2)
+  {
+    sched.init(cores);
+
+    {
+      auto config = make_cown<Config>(size);
+      for (size_t i = 0; i < chains; i++)
+        lookup(config, i * lookups, lookups);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sched.run();
+    auto end = std::chrono::steady_clock::now();
+
+    auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    size_t reads = chains * lookups;
+    std::cout << "cores: " << cores << ", reads: " << reads
+              << ", time: " << ms.count() << " ms, "
+              << (reads * 1000) / std::max<size_t>(ms.count(), 1)
+              << " reads/s" << std::endl;
+  }
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
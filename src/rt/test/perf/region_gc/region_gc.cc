@@ -0,0 +1,144 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark compares collecting a large trace region on one thread,
+ * with `RegionTrace::gc`, to collecting it on all the scheduler threads,
+ * with `parallel_gc`.
+ *
+ * A behaviour on the cown holding the region builds a random graph of
+ * `--live` objects, which hold half as many non-trivial objects, and
+ * allocates `--garbage` unreachable objects of both kinds. It then collects
+ * the region sequentially, allocates the same garbage again, and collects it
+ * in parallel.
+ *
+ * The run is repeated for 1, 2, 4, ... up to `--cores` scheduler threads.
+ */
+
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <chrono>
+#include <cpp/parallel.h>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct Final : public V<Final>
+{
+  void finaliser(Object*, ObjectStack&) {}
+};
+
+struct Node : public V<Node>
+{
+  Node* edges[2] = {nullptr, nullptr};
+  Final* final = nullptr;
+
+  void trace(ObjectStack& st) const
+  {
+    for (auto e : edges)
+    {
+      if (e != nullptr)
+        st.push(e);
+    }
+
+    if (final != nullptr)
+      st.push(final);
+  }
+};
+
+struct RegionCown : public VCown<RegionCown>
+{
+  Node* root;
+
+  RegionCown() : root(new (RegionType::Trace) Node) {}
+
+  void trace(ObjectStack& st) const
+  {
+    st.push(root);
+  }
+};
+
+static size_t live;
+static size_t garbage;
+
+void allocate_garbage()
+{
+  for (size_t i = 0; i < garbage; i++)
+  {
+    if (i % 2 == 0)
+      new Node;
+    else
+      new Final;
+  }
+}
+
+template<typename F>
+size_t time_ms(F&& f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+    .count();
+}
+
+void collect(RegionCown* c, size_t cores)
+{
+  UsingRegion rr(c->root);
+
+  // A random graph, where each object is reachable from the previous one,
+  // and every other object holds a non-trivial one.
+  xoroshiro::p128r32 rng(cores);
+  std::vector<Node*> nodes;
+  nodes.reserve(live);
+  nodes.push_back(c->root);
+  for (size_t i = 1; i < live; i++)
+  {
+    auto n = new Node;
+    n->edges[1] = nodes[rng.next() % nodes.size()];
+    if (i % 2 == 0)
+      n->final = new Final;
+    nodes.back()->edges[0] = n;
+    nodes.push_back(n);
+  }
+  nodes.clear();
+  size_t size = debug_size();
+
+  allocate_garbage();
+  auto sequential = time_ms([]() { region_collect(); });
+  check(debug_size() == size);
+
+  allocate_garbage();
+  auto parallel = time_ms([c]() { parallel_gc(c->root); });
+  check(debug_size() == size);
+
+  std::cout << "cores: " << cores << ", live: " << live
+            << ", garbage: " << garbage << ", sequential: " << sequential
+            << " ms, parallel: " << parallel << " ms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+
+  const auto max_cores = opt.is<size_t>("--cores", 4);
+  live = opt.is<size_t>("--live", 1'000'000);
+  garbage = opt.is<size_t>("--garbage", 1'000'000);
+
+  auto& sched = Scheduler::get();
+
+  for (size_t cores = 1; cores <= max_cores; cores *= 2)
+  {
+    sched.init(cores);
+
+    auto c = new RegionCown;
+    schedule_lambda(c, [c, cores]() { collect(c, cores); });
+    Cown::release(ThreadAlloc::get(), c);
+
+    sched.run();
+  }
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
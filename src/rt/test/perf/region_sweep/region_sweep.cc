@@ -0,0 +1,136 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This benchmark measures the throughput, in objects per second, of the
+ * traversals that chase object pointers: collecting a trace region, which
+ * sweeps its rings, and scanning and releasing a large immutable graph.
+ *
+ * Objects of several sizes are allocated in a random mix, so that objects
+ * next to each other in a ring are in different slabs of the heap, and the
+ * cache is flushed before each measurement.
+ *
+ * To compare with the traversals without software prefetching, build with
+ * `VERONA_NO_PREFETCH` defined, see `Object::prefetch`.
+ */
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <chrono>
+#include <test/harness.h>
+#include <vector>
+
+template<size_t N>
+struct Node : public V<Node<N>>
+{
+  Object* next = nullptr;
+  uintptr_t padding[N];
+
+  void trace(ObjectStack& st) const
+  {
+    if (next != nullptr)
+      st.push(next);
+  }
+};
+
+struct Root : public VCown<Root>
+{};
+
+static size_t objects;
+
+template<typename T>
+Object* link(Object* next)
+{
+  auto n = new T;
+  n->next = next;
+  return n;
+}
+
+/**
+ * Allocates an object of a random size that points to `next`.
+ **/
+Object* alloc_node(xoroshiro::p128r32& rng, Object* next)
+{
+  switch (rng.next() % 4)
+  {
+    case 0:
+      return link<Node<1>>(next);
+    case 1:
+      return link<Node<4>>(next);
+    case 2:
+      return link<Node<12>>(next);
+    default:
+      return link<Node<30>>(next);
+  }
+}
+
+/**
+ * Evict the caches by touching a buffer larger than them.
+ **/
+void flush_cache()
+{
+  static std::vector<uint8_t> buffer(256 * 1024 * 1024);
+  for (size_t i = 0; i < buffer.size(); i += 64)
+    buffer[i]++;
+}
+
+template<typename F>
+void report(const char* name, size_t count, F&& f)
+{
+  flush_cache();
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  double secs = std::chrono::duration<double>(end - start).count();
+  std::cout << name << ": " << count << " objects in " << secs << " s, "
+            << (size_t)(count / secs) << " objects/s" << std::endl;
+}
+
+void sweep()
+{
+  auto& alloc = ThreadAlloc::get();
+  xoroshiro::p128r32 rng(1);
+
+  auto root = new (RegionType::Trace) Node<1>;
+  {
+    UsingRegion rr(root);
+
+    // Half of the objects are live, in a list from the root.
+    for (size_t i = 0; i < objects; i++)
+    {
+      if (i % 2 == 0)
+        root->next = alloc_node(rng, root->next);
+      else
+        alloc_node(rng, nullptr);
+    }
+
+    report("trace sweep", objects, []() { region_collect(); });
+  }
+
+  // Every object of the frozen list is reached by the scan and the release.
+  freeze(root);
+  report("immutable scan", objects / 2, [root, &alloc]() {
+    Immutable::mark_and_scan(alloc, root, EpochMark::EPOCH_A);
+  });
+  report("immutable release", objects / 2, [root, &alloc]() {
+    Immutable::release(alloc, root);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  opt::Opt opt(argc, argv);
+  objects = opt.is<size_t>("--objects", 4'000'000);
+
+  auto& sched = Scheduler::get();
+  sched.init(1);
+
+  auto c = new Root;
+  schedule_lambda(c, []() { sweep(); });
+  Cown::release(ThreadAlloc::get(), c);
+
+  sched.run();
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+}
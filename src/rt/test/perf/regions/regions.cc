@@ -0,0 +1,236 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Microbenchmarks of regions, run on the main thread by `BenchHarness`:
+ *
+ *  - alloc/<region>: allocating `--objects` objects in a list in a fresh
+ *    region, and releasing the region.
+ *  - gc/<region>/<live>: collecting a region as its live set grows to
+ *    `--live` objects. Each run collects `--pauses` times, after making as
+ *    many objects as are live into garbage rings, and records each pause as
+ *    a latency. For `Rc` regions the rings are buffered as cycle candidates
+ *    and the pause is that of `RegionRc::gc_cycles`. Arena regions are not
+ *    collected, and are skipped.
+ *  - merge/<region>: merging `--regions` small regions into one. Rc regions
+ *    cannot be merged, and are skipped.
+ *  - freeze/trace: freezing a trace region of `--live` objects, and
+ *    releasing the immutable graph.
+ *
+ * The object graphs are random, but generated from fixed seeds, so each run
+ * of a benchmark builds the same graph. `--scale` multiplies all the sizes.
+ */
+
+#include "test/xoroshiro.h"
+
+#include <test/perf/bench.h>
+#include <vector>
+
+using namespace verona::rt;
+using namespace verona::rt::api;
+
+struct Node : public V<Node>
+{
+  Node* edges[2] = {nullptr, nullptr};
+
+  void trace(ObjectStack& st) const
+  {
+    for (auto e : edges)
+    {
+      if (e != nullptr)
+        st.push(e);
+    }
+  }
+};
+
+static const char* region_name(RegionType type)
+{
+  switch (type)
+  {
+    case RegionType::Trace:
+      return "trace";
+    case RegionType::Arena:
+      return "arena";
+    case RegionType::Rc:
+      return "rc";
+    case RegionType::Hybrid:
+      return "hybrid";
+  }
+  abort();
+}
+
+/**
+ * Add `size` objects to the open region of `root`. Each object is reachable
+ * from the previous one, and also points to a random earlier object.
+ */
+void build(Node* root, size_t size, bool rc, uint32_t seed)
+{
+  xoroshiro::p128r32 rng(seed);
+  std::vector<Node*> nodes;
+  nodes.reserve(size + 1);
+  nodes.push_back(root);
+  for (size_t i = 0; i < size; i++)
+  {
+    auto n = new Node;
+    // Never point back to the entry point, whose count is not tracked.
+    size_t j = rng.next() % nodes.size();
+    if (j != 0)
+    {
+      n->edges[1] = nodes[j];
+      if (rc)
+        incref(nodes[j]);
+    }
+    nodes.back()->edges[0] = n;
+    nodes.push_back(n);
+  }
+}
+
+/**
+ * Allocate `size` unreachable objects in the open region, in rings of the
+ * same length. In an Rc region, each ring is a buffered cycle candidate. At
+ * most 512 rings are made, so that `RegionRc::decref` does not collect them
+ * before `region_collect`.
+ */
+void garbage(size_t size, bool rc)
+{
+  size_t length = std::max<size_t>(16, size / 512);
+  for (size_t made = 0; made < size; made += length)
+  {
+    auto head = new Node;
+    auto last = head;
+    for (size_t i = 1; i < length; i++)
+    {
+      last->edges[0] = new Node;
+      last = last->edges[0];
+    }
+    last->edges[0] = head;
+    if (rc)
+    {
+      incref(head);
+      decref(head);
+    }
+  }
+}
+
+void bench_alloc(BenchHarness& bench, RegionType type)
+{
+  size_t objects = bench.opt.is<size_t>("--objects", 100'000) * bench.scale;
+
+  bench.measure(
+    std::string("alloc/") + region_name(type), [type, objects]() {
+      auto root = new (type) Node;
+      {
+        UsingRegion rr(root);
+        auto last = root;
+        for (size_t i = 0; i < objects; i++)
+        {
+          last->edges[0] = new Node;
+          last = last->edges[0];
+        }
+      }
+      region_release(root);
+      return objects;
+    });
+}
+
+void bench_gc(BenchHarness& bench, RegionType type)
+{
+  size_t max_live = bench.opt.is<size_t>("--live", 100'000) * bench.scale;
+  size_t pauses = bench.opt.is<size_t>("--pauses", 4);
+  bool rc = type == RegionType::Rc;
+
+  for (size_t live = std::max<size_t>(max_live / 100, 1); live <= max_live;
+       live *= 10)
+  {
+    bench.measure(
+      std::string("gc/") + region_name(type) + "/" + std::to_string(live),
+      [&]() {
+        auto root = new (type) Node;
+        {
+          UsingRegion rr(root);
+          build(root, live, rc, 1);
+          for (size_t i = 0; i < pauses; i++)
+          {
+            garbage(live, rc);
+            auto start = std::chrono::steady_clock::now();
+            region_collect();
+            bench.record_latency(std::chrono::steady_clock::now() - start);
+          }
+        }
+        region_release(root);
+        return live * pauses;
+      });
+  }
+}
+
+void bench_merge(BenchHarness& bench, RegionType type)
+{
+  size_t regions = bench.opt.is<size_t>("--regions", 10'000) * bench.scale;
+
+  bench.measure(
+    std::string("merge/") + region_name(type), [type, regions]() {
+      std::vector<Node*> isos;
+      isos.reserve(regions);
+      for (size_t i = 0; i < regions; i++)
+      {
+        auto o = new (type) Node;
+        {
+          UsingRegion rr(o);
+          o->edges[0] = new Node;
+          o->edges[0]->edges[0] = new Node;
+        }
+        isos.push_back(o);
+      }
+
+      auto root = new (type) Node;
+      {
+        UsingRegion rr(root);
+        Node* last = root;
+        for (auto o : isos)
+        {
+          last->edges[1] = merge(o);
+          last = o;
+        }
+      }
+      region_release(root);
+      return regions;
+    });
+}
+
+void bench_freeze(BenchHarness& bench)
+{
+  size_t live = bench.opt.is<size_t>("--live", 100'000) * bench.scale;
+
+  bench.measure("freeze/trace", [live]() {
+    auto root = new (RegionType::Trace) Node;
+    {
+      UsingRegion rr(root);
+      build(root, live, false, 1);
+    }
+    freeze(root);
+    Immutable::release(ThreadAlloc::get(), root);
+    return live;
+  });
+}
+
+int main(int argc, char** argv)
+{
+  BenchHarness bench(argc, argv);
+
+  for (auto type :
+       {RegionType::Trace,
+        RegionType::Arena,
+        RegionType::Rc,
+        RegionType::Hybrid})
+  {
+    bench_alloc(bench, type);
+    if (type != RegionType::Arena)
+      bench_gc(bench, type);
+    if (type != RegionType::Rc)
+      bench_merge(bench, type);
+  }
+  bench_freeze(bench);
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return bench.report();
+}
@@ -6,6 +6,17 @@
  *
  * There are n cowns, each executing m writes to a large statically allocated
  * array of memory.  Each cown performs c behaviours.
+ *
+ * Passing `--skew` starts all of the cowns from a single behaviour, so the
+ * work starts on one scheduler thread and must be stolen by the others.
+ * `--steal_batch` sets the number of cowns that may be taken in one steal,
+ * see `ThreadPool::set_steal_batch`.
+ *
+ * To compare the ABA protection of the scheduler queues, build once with and
+ * once without `USE_TAGGED_MPMCQ`, see `MPMCQ`. Likewise, `USE_RUN_RING`
+ * puts a bounded ring in front of the queue of each core, see `RunRing`.
+ * `USE_NO_LEAK_DETECTOR` removes the leak detector checks from the
+ * scheduling paths, see `ThreadPool::has_leak_detector`.
  */
 
 #include "test/log.h"
@@ -70,6 +81,17 @@ int main(int argc, char** argv)
     printf(" %s", argv[i]);
   }
   printf("\n");
+#ifdef USE_TAGGED_MPMCQ
+  printf("Queue: tagged\n");
+#else
+  printf("Queue: aba\n");
+#endif
+#ifdef USE_RUN_RING
+  printf("Run ring: on\n");
+#endif
+#ifdef USE_NO_LEAK_DETECTOR
+  printf("Leak detector: off\n");
+#endif
   opt::Opt opt(argc, argv);
 
   //  auto& alloc = sn::ThreadAlloc::get();
@@ -80,17 +102,33 @@ int main(int argc, char** argv)
   global_array = new std::atomic<size_t>[global_array_size];
   const auto loops = opt.is<size_t>("--loops", 100);
   writes = opt.is<size_t>("--writes", 0);
+  const auto skew = opt.has("--skew");
+  const auto steal_batch = opt.is<size_t>("--steal_batch", 32);
 
   auto& sched = rt::Scheduler::get();
   sched.set_fair(true);
+  sched.set_steal_batch(steal_batch);
   for (int l = 0; l < 20; l++)
   {
     sched.init(cores);
 
-    for (size_t i = 0; i < cowns; i++)
+    if (skew)
+    {
+      schedule_lambda([cowns, loops]() {
+        for (size_t i = 0; i < cowns; i++)
+        {
+          auto c = new LoopCown(loops, i + 200);
+          c->go();
+        }
+      });
+    }
+    else
     {
-      auto c = new LoopCown(loops, i + 200);
-      c->go();
+      for (size_t i = 0; i < cowns; i++)
+      {
+        auto c = new LoopCown(loops, i + 200);
+        c->go();
+      }
     }
 
     auto start = sn::Aal::tick();
@@ -0,0 +1,156 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Simulator of the scheduler, for comparing scheduling policies without a
+ * large machine. It only simulates in the systematic testing build,
+ * `perf-sys-simulate`.
+ *
+ * The real scheduler threads run the workload, but systematic testing runs
+ * them as a discrete event simulation, see `Systematic::enable_simulation`:
+ * each yield of the runtime code costs `--step` virtual nanoseconds, and
+ * each behaviour takes a random virtual duration, exponentially distributed
+ * with a mean of `--work` nanoseconds, instead of running for real.
+ *
+ * The workload is `--chains` chains of `--length` behaviours. Each behaviour
+ * runs on a random one of `--cowns` cowns, or with `--percent_multi` percent
+ * likelihood on two, and schedules the next behaviour of its chain.
+ *
+ * For 1, 2, 4, ... up to `--cores` scheduler threads, this reports the
+ * virtual time of the run, the throughput in behaviours per virtual second,
+ * and the latency from scheduling a behaviour to it starting, in virtual
+ * nanoseconds. A run is deterministic for a given `--seed`.
+ */
+
+#include "test/opt.h"
+#include "test/xoroshiro.h"
+
+#include <cmath>
+#include <cpp/when.h>
+#include <memory>
+#include <test/harness.h>
+
+using namespace verona::cpp;
+
+struct State
+{
+  size_t count = 0;
+};
+
+using Cowns = std::shared_ptr<std::vector<cown_ptr<State>>>;
+
+static size_t work;
+static size_t percent_multi;
+static LatencyHistogram latency;
+static std::atomic<uint64_t> end_time = 0;
+
+uint64_t duration(xoroshiro::p128r32& rng)
+{
+  double u = ((double)rng.next() + 1.0) / 4294967296.0;
+  return (uint64_t)(-std::log(u) * (double)work);
+}
+
+void step(Cowns cowns, xoroshiro::p128r32 rng, size_t remaining);
+
+void run_step(
+  Cowns& cowns, xoroshiro::p128r32& rng, size_t remaining, uint64_t sent)
+{
+  // The thread running this may be behind the sender in virtual time.
+  uint64_t start = Systematic::now();
+  latency.record(start > sent ? start - sent : 0);
+  Systematic::advance(duration(rng));
+
+  uint64_t now = Systematic::now();
+  uint64_t prev = end_time.load();
+  while ((prev < now) && !end_time.compare_exchange_weak(prev, now))
+    ;
+
+  if (remaining > 1)
+    step(std::move(cowns), rng, remaining - 1);
+}
+
+void step(Cowns cowns, xoroshiro::p128r32 rng, size_t remaining)
+{
+  auto& all = *cowns;
+  size_t i = rng.next() % all.size();
+  auto a = all[i];
+  uint64_t sent = Systematic::now();
+
+  if ((rng.next() % 100) < percent_multi)
+  {
+    size_t j = rng.next() % all.size();
+    if (i != j)
+    {
+      auto b = all[j];
+      when(a, b) << [cowns, rng, remaining, sent](
+                      acquired_cown<State> a, acquired_cown<State> b) mutable {
+        a->count++;
+        b->count++;
+        run_step(cowns, rng, remaining, sent);
+      };
+      return;
+    }
+  }
+
+  when(a) << [cowns, rng, remaining, sent](acquired_cown<State> a) mutable {
+    a->count++;
+    run_step(cowns, rng, remaining, sent);
+  };
+}
+
+int main(int argc, char** argv)
+{
+#ifndef USE_SYSTEMATIC_TESTING
+  UNUSED(argc);
+  UNUSED(argv);
+  std::cout << "Simulation needs systematic testing, run perf-sys-simulate"
+            << std::endl;
+  return 0;
+#else
+  opt::Opt opt(argc, argv);
+
+  const auto seed = opt.is<size_t>("--seed", 1);
+  const auto max_cores = opt.is<size_t>("--cores", 64);
+  const auto step_cost = opt.is<size_t>("--step", 20);
+  const auto cowns = opt.is<size_t>("--cowns", 256);
+  const auto chains = opt.is<size_t>("--chains", 256);
+  const auto length = opt.is<size_t>("--length", 100);
+  work = opt.is<size_t>("--work", 1'000);
+  percent_multi = opt.is<size_t>("--percent_multi", 10);
+
+  auto& sched = Scheduler::get();
+
+  for (size_t cores = 1; cores <= max_cores; cores *= 2)
+  {
+    Systematic::set_seed(seed);
+    Systematic::enable_simulation(step_cost);
+    latency.clear();
+    end_time = 0;
+    sched.init(cores);
+
+    {
+      auto all = std::make_shared<std::vector<cown_ptr<State>>>();
+      for (size_t i = 0; i < cowns; i++)
+        all->push_back(make_cown<State>());
+
+      for (size_t i = 0; i < chains; i++)
+        step(all, xoroshiro::p128r32(seed + i), length);
+    }
+
+    sched.run();
+    Systematic::disable_simulation();
+
+    uint64_t ns = std::max<uint64_t>(end_time, 1);
+    size_t behaviours = chains * length;
+    std::cout << "cores: " << cores << ", virtual time: " << ns / 1000
+              << " us, throughput: " << (behaviours * 1'000'000'000) / ns
+              << " behaviours/s, p50: " << latency.percentile(0.5)
+              << " ns, p99: " << latency.percentile(0.99)
+              << " ns, switches: " << Systematic::get_counters().switches
+              << std::endl;
+  }
+
+  snmalloc::debug_check_empty<snmalloc::Alloc::Config>();
+  return 0;
+#endif
+}
@@ -232,6 +232,9 @@ void smallbank_body()
   experiment_init();
 }
 
+/// The oneTBB baseline, see `tbb_smallbank.cc`.
+int tbb_main(size_t cores);
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -240,5 +243,10 @@ int main(int argc, char** argv)
     return -1;
   }
 
+  if (harness.opt.has("--tbb"))
+  {
+    return tbb_main(harness.cores);
+  }
+
   harness.run(smallbank_body);
 }
@@ -0,0 +1,195 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Baseline of smallbank on oneTBB, run with `--tbb`.
+ *
+ * Each checking and savings balance is guarded by its own mutex, and each
+ * transaction is a task in a `tbb::task_group` that takes the mutexes of
+ * the balances it uses with `std::scoped_lock`, as the Verona version
+ * acquires their cowns. Generators are tasks that dispatch `--tx_batch`
+ * transactions and then run again, until each has dispatched `--tx_count`.
+ * Each generator reports its dispatch rate as in the Verona version, and the
+ * total time to complete all the transactions is reported at the end.
+ *
+ * This is built only when `VERONA_PERF_TBB` is set, see the runtime's
+ * `CMakeLists.txt`.
+ */
+
+#include "args.h"
+#include "test/log.h"
+#include "test/xoroshiro.h"
+
+#ifdef VERONA_PERF_TBB
+#  include <chrono>
+#  include <memory>
+#  include <mutex>
+#  include <string>
+#  include <tbb/task_arena.h>
+#  include <tbb/task_group.h>
+#  include <unordered_map>
+#  include <vector>
+
+namespace tbb_smallbank
+{
+  struct Balance
+  {
+    std::mutex lock;
+    int64_t balance = 0;
+  };
+
+  struct Account
+  {
+    std::unique_ptr<Balance> checking = std::make_unique<Balance>();
+    std::unique_ptr<Balance> savings = std::make_unique<Balance>();
+  };
+
+  using Accounts = std::unordered_map<std::string, Account>;
+
+  struct Generator
+  {
+    Accounts& accounts;
+    tbb::task_group& group;
+    xoroshiro::p128r32 rng;
+    uint32_t tx_count = 0;
+    std::chrono::time_point<std::chrono::steady_clock> start =
+      std::chrono::steady_clock::now();
+
+    Generator(Accounts& accounts, tbb::task_group& group, uint64_t seed)
+    : accounts(accounts), group(group), rng(seed)
+    {}
+
+    Account* find(uint64_t id)
+    {
+      auto account = accounts.find(std::to_string(id));
+      return (account == accounts.end()) ? nullptr : &account->second;
+    }
+
+    uint64_t pick()
+    {
+      return rng.next() % (ACCOUNTS_COUNT + ACCOUNT_EXTRA);
+    }
+
+    void generate_tx()
+    {
+      for (uint32_t i = 0; i < TX_BATCH; i++)
+      {
+        uint32_t txn_type = rng.next() % 5;
+        auto* a = find(pick());
+        int64_t amount = rng.next();
+        if (a == nullptr)
+          continue;
+
+        Balance* ch = a->checking.get();
+        Balance* sa = a->savings.get();
+        switch (txn_type)
+        {
+          case 0:
+            // Balance
+            group.run([ch, sa]() {
+              std::scoped_lock l(ch->lock, sa->lock);
+              volatile int64_t total = ch->balance + sa->balance;
+              (void)total;
+            });
+            break;
+          case 1:
+            // DepositChecking
+            group.run([ch, amount]() {
+              std::lock_guard<std::mutex> l(ch->lock);
+              ch->balance += amount;
+            });
+            break;
+          case 2:
+            // TransactSavings
+            group.run([sa, amount]() {
+              std::lock_guard<std::mutex> l(sa->lock);
+              if ((amount < 0) && (sa->balance < (-1 * amount)))
+                return;
+              sa->balance += amount;
+            });
+            break;
+          case 3:
+            // WriteCheck
+            group.run([ch, sa, amount]() {
+              std::scoped_lock l(sa->lock, ch->lock);
+              if (amount < (ch->balance + sa->balance))
+                ch->balance -= (amount + 1);
+              else
+                ch->balance -= amount;
+            });
+            break;
+          default:
+          {
+            // Amalgamate
+            Account* b;
+            do
+            {
+              b = find(pick());
+            } while (b == a);
+            if (b == nullptr)
+              break;
+            Balance* ch2 = b->checking.get();
+            group.run([ch, sa, ch2]() {
+              std::scoped_lock l(sa->lock, ch->lock, ch2->lock);
+              ch2->balance += (sa->balance + ch->balance);
+              sa->balance = 0;
+              ch->balance = 0;
+            });
+            break;
+          }
+        }
+      }
+      tx_count += TX_BATCH;
+
+      if (tx_count < PER_GEN_TX_COUNT)
+      {
+        group.run([this]() { generate_tx(); });
+        return;
+      }
+
+      std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start;
+      logger::cout() << "Generator: " << std::hex << this << ": Dispatched "
+                     << std::dec << tx_count / duration.count() << " tx/s"
+                     << std::endl;
+    }
+  };
+}
+
+int tbb_main(size_t cores)
+{
+  using namespace tbb_smallbank;
+
+  Accounts accounts;
+  for (uint64_t i = 0; i < ACCOUNTS_COUNT; i++)
+    accounts.emplace(std::to_string(i), Account());
+
+  tbb::task_arena arena((int)cores);
+  tbb::task_group group;
+  std::vector<std::unique_ptr<Generator>> generators;
+  for (uint32_t i = 0; i < GENERATOR_COUNT; i++)
+    generators.push_back(std::make_unique<Generator>(accounts, group, i + 1));
+
+  auto start = std::chrono::steady_clock::now();
+  arena.execute([&]() {
+    for (auto& g : generators)
+      group.run([g = g.get()]() { g->generate_tx(); });
+    group.wait();
+  });
+  std::chrono::duration<double> duration =
+    std::chrono::steady_clock::now() - start;
+
+  uint64_t total = (uint64_t)GENERATOR_COUNT * PER_GEN_TX_COUNT;
+  logger::cout() << "Generated " << total << " tx, completed in "
+                 << duration.count() << " s, " << total / duration.count()
+                 << " tx/s" << std::endl;
+  return 0;
+}
+#else
+int tbb_main(size_t)
+{
+  logger::cout() << "Built without oneTBB, configure with VERONA_PERF_TBB"
+                 << std::endl;
+  return 1;
+}
+#endif
@@ -0,0 +1,160 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Suite of the runtime benchmarks, run by `BenchHarness`.
+ *
+ * The scenarios are compact versions of the other perf programs:
+ *
+ *  - banking: transfers between random pairs of accounts, with the latency
+ *    from scheduling a transfer to running it.
+ *  - dining: philosophers each eating a number of times with their two
+ *    forks.
+ *  - fan_out: independent chains of behaviours on their own cowns.
+ *  - ping_pong: pairs of cowns sending a message back and forth, with the
+ *    latency of each hop.
+ *
+ * `--scale` multiplies the size of all the scenarios, and `--only <name>`
+ * runs a single one. The `rt_bench` target runs the suite on all the cores
+ * and writes `bench.json`.
+ */
+
+#include "test/xoroshiro.h"
+
+#include <cpp/when.h>
+#include <cstring>
+#include <test/perf/bench.h>
+
+using namespace verona::cpp;
+using Clock = std::chrono::steady_clock;
+
+static BenchHarness* harness;
+
+struct Account
+{
+  int64_t balance = 1000;
+};
+
+struct Fork
+{
+  size_t uses = 0;
+};
+
+struct Ball
+{
+  size_t hits = 0;
+};
+
+size_t banking(size_t scale)
+{
+  const size_t accounts = 1000;
+  const size_t transfers = 100'000 * scale;
+
+  std::vector<cown_ptr<Account>> all;
+  for (size_t i = 0; i < accounts; i++)
+    all.push_back(make_cown<Account>());
+
+  xoroshiro::p128r32 rng(1);
+  for (size_t i = 0; i < transfers; i++)
+  {
+    size_t from = rng.next() % accounts;
+    size_t to = (from + 1 + (rng.next() % (accounts - 1))) % accounts;
+    auto sent = Clock::now();
+    when(all[from], all[to])
+      << [sent](acquired_cown<Account> from, acquired_cown<Account> to) {
+           harness->record_latency(Clock::now() - sent);
+           from->balance -= 1;
+           to->balance += 1;
+         };
+  }
+  return transfers;
+}
+
+size_t dining(size_t scale)
+{
+  const size_t philosophers = 100;
+  const size_t meals = 1'000 * scale;
+
+  std::vector<cown_ptr<Fork>> forks;
+  for (size_t i = 0; i < philosophers; i++)
+    forks.push_back(make_cown<Fork>());
+
+  for (size_t m = 0; m < meals; m++)
+  {
+    for (size_t i = 0; i < philosophers; i++)
+    {
+      auto& left = forks[i];
+      auto& right = forks[(i + 1) % philosophers];
+      when(left, right) << [](acquired_cown<Fork> l, acquired_cown<Fork> r) {
+        l->uses++;
+        r->uses++;
+      };
+    }
+  }
+  return philosophers * meals;
+}
+
+void chain(cown_ptr<Account> c, size_t remaining)
+{
+  when(c) << [c, remaining](acquired_cown<Account> a) {
+    a->balance++;
+    if (remaining > 1)
+      chain(c, remaining - 1);
+  };
+}
+
+size_t fan_out(size_t scale)
+{
+  const size_t chains = 256;
+  const size_t length = 1'000 * scale;
+
+  for (size_t i = 0; i < chains; i++)
+    chain(make_cown<Account>(), length);
+  return chains * length;
+}
+
+void hop(cown_ptr<Ball> to, cown_ptr<Ball> back, size_t remaining)
+{
+  auto sent = Clock::now();
+  when(to) << [to, back, remaining, sent](acquired_cown<Ball> b) {
+    harness->record_latency(Clock::now() - sent);
+    b->hits++;
+    if (remaining > 1)
+      hop(back, to, remaining - 1);
+  };
+}
+
+size_t ping_pong(size_t scale)
+{
+  const size_t pairs = 16;
+  const size_t hops = 10'000 * scale;
+
+  for (size_t i = 0; i < pairs; i++)
+    hop(make_cown<Ball>(), make_cown<Ball>(), hops);
+  return pairs * hops;
+}
+
+int main(int argc, char** argv)
+{
+  BenchHarness bench(argc, argv);
+  harness = &bench;
+
+  const char* only = nullptr;
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (strcmp(argv[i], "--only") == 0)
+      only = argv[i + 1];
+  }
+
+  auto scenario = [&](const char* name, size_t (*f)(size_t)) {
+    if ((only == nullptr) || (strcmp(only, name) == 0))
+      bench.run(name, [&](size_t) { return f(bench.scale); });
+  };
+
+  scenario("banking", banking);
+  scenario("dining", dining);
+  scenario("fan_out", fan_out);
+  scenario("ping_pong", ping_pong);
+
+  return bench.report();
+}
@@ -0,0 +1,310 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * A TPC-C-style transaction benchmark on cowns, run by `BenchHarness`.
+ *
+ * Each warehouse has ten districts, each district has `--customers`
+ * customers, and the stock of `--items` items is a cown per warehouse. The
+ * item catalogue is a single cown that is only ever read. Every transaction
+ * is a single behaviour that acquires all the cowns it touches at once, so
+ * none is ever aborted:
+ *
+ *  - new order: reads the warehouse and the catalogue, takes the next order
+ *    number of the district, and takes 5 to 15 items from the stock.
+ *  - payment: adds to the year-to-date totals of the warehouse and the
+ *    district, and takes the amount from the customer's balance.
+ *  - delivery: delivers the oldest order of the district to a customer.
+ *  - order status: reads a customer and their district.
+ *  - stock level: reads a district and the stock of its warehouse.
+ *
+ * Districts and customers are picked with a Zipfian distribution of
+ * exponent `--theta` hundredths, so a few are hot. Each warehouse has
+ * `--terminals` terminals, each of which runs `--transactions` transactions
+ * one after the other, and the latency of a transaction is from the terminal
+ * issuing it to it completing.
+ *
+ * The `tpcc` scenario uses the TPC-C mix, in which 8% of transactions only
+ * read. The `tpcc/read_mostly` scenario makes 80% of them read-only, and
+ * measures how well readers of the same cowns run in parallel. There are
+ * `--warehouses` warehouses, or as many as cores if that is 0.
+ */
+
+#include "test/xoroshiro.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cpp/when.h>
+#include <test/perf/bench.h>
+#include <vector>
+
+using namespace verona::cpp;
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t DISTRICTS = 10;
+
+struct Warehouse
+{
+  int64_t ytd = 0;
+  int64_t tax = 5;
+};
+
+struct District
+{
+  int64_t ytd = 0;
+  int64_t tax = 7;
+  uint64_t next_order = 0;
+  uint64_t delivered = 0;
+};
+
+struct Customer
+{
+  int64_t balance = 0;
+  uint64_t payments = 0;
+  uint64_t deliveries = 0;
+};
+
+struct Catalogue
+{
+  std::vector<int64_t> prices;
+
+  Catalogue(size_t items) : prices(items)
+  {
+    for (size_t i = 0; i < items; i++)
+      prices[i] = 100 + (int64_t)((i * 37) % 9900);
+  }
+};
+
+struct Stock
+{
+  std::vector<int64_t> quantities;
+
+  Stock(size_t items) : quantities(items, 100) {}
+};
+
+/**
+ * Samples from a Zipfian distribution over `[0, n)`, in which the
+ * probability of `i` is proportional to `1 / (i + 1)^theta`.
+ */
+class Zipf
+{
+  std::vector<double> cdf;
+
+public:
+  Zipf(size_t n, double theta) : cdf(n)
+  {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      sum += 1.0 / std::pow((double)(i + 1), theta);
+      cdf[i] = sum;
+    }
+    for (auto& c : cdf)
+      c /= sum;
+  }
+
+  size_t sample(xoroshiro::p128r32& rng) const
+  {
+    double u = (double)rng.next() / 4294967296.0;
+    auto it = std::upper_bound(cdf.begin(), cdf.end(), u);
+    return std::min((size_t)(it - cdf.begin()), cdf.size() - 1);
+  }
+};
+
+struct Database
+{
+  size_t customers_per_district;
+  size_t items;
+  size_t read_pct;
+  Zipf hot_districts;
+  Zipf hot_customers;
+  cown_ptr<Catalogue> catalogue;
+  std::vector<cown_ptr<Warehouse>> warehouses;
+  std::vector<cown_ptr<Stock>> stocks;
+  std::vector<cown_ptr<District>> districts;
+  std::vector<cown_ptr<Customer>> customers;
+
+  Database(
+    size_t warehouse_count,
+    size_t per_district,
+    size_t items,
+    size_t read_pct,
+    double theta)
+  : customers_per_district(per_district),
+    items(items),
+    read_pct(read_pct),
+    hot_districts(warehouse_count * DISTRICTS, theta),
+    hot_customers(per_district, theta),
+    catalogue(make_cown<Catalogue>(items))
+  {
+    for (size_t w = 0; w < warehouse_count; w++)
+    {
+      warehouses.push_back(make_cown<Warehouse>());
+      stocks.push_back(make_cown<Stock>(items));
+    }
+    for (size_t d = 0; d < warehouse_count * DISTRICTS; d++)
+      districts.push_back(make_cown<District>());
+    for (size_t c = 0; c < districts.size() * per_district; c++)
+      customers.push_back(make_cown<Customer>());
+  }
+};
+
+static BenchHarness* harness;
+
+/**
+ * A terminal, which issues its next transaction once the last completes.
+ */
+struct Terminal
+{
+  std::shared_ptr<Database> db;
+  xoroshiro::p128r32 rng;
+  size_t remaining;
+};
+
+void issue(Terminal t);
+
+/// Record the latency of a transaction, and issue the next one.
+void complete(Terminal& t, Clock::time_point sent)
+{
+  harness->record_latency(Clock::now() - sent);
+  if (--t.remaining > 0)
+    issue(std::move(t));
+}
+
+void issue(Terminal t)
+{
+  auto& db = *t.db;
+  auto sent = Clock::now();
+  size_t d = db.hot_districts.sample(t.rng);
+  size_t w = d / DISTRICTS;
+  size_t c =
+    (d * db.customers_per_district) + db.hot_customers.sample(t.rng);
+  auto& warehouse = db.warehouses[w];
+  auto& stock = db.stocks[w];
+  auto& district = db.districts[d];
+  auto& customer = db.customers[c];
+  size_t kind = t.rng.next() % 100;
+  if (kind < db.read_pct)
+  {
+    if (kind % 2 == 0)
+    {
+      // Order status.
+      when(read(customer), read(district))
+        << [t = std::move(t), sent](
+             acquired_cown<const Customer> c,
+             acquired_cown<const District> d) mutable {
+             (void)(c->balance + (int64_t)d->next_order);
+             complete(t, sent);
+           };
+    }
+    else
+    {
+      // Stock level.
+      when(read(district), read(stock))
+        << [t = std::move(t), sent](
+             acquired_cown<const District> d,
+             acquired_cown<const Stock> s) mutable {
+             size_t low = 0;
+             size_t start = d->next_order % s->quantities.size();
+             for (size_t i = 0; i < 20; i++)
+             {
+               if (s->quantities[(start + i) % s->quantities.size()] < 10)
+                 low++;
+             }
+             (void)low;
+             complete(t, sent);
+           };
+    }
+    return;
+  }
+
+  // The updates are in the TPC-C proportions of 45:43:4.
+  kind = t.rng.next() % 92;
+  int64_t amount = 1 + (int64_t)(t.rng.next() % 5000);
+  if (kind < 45)
+  {
+    size_t lines = 5 + (t.rng.next() % 11);
+    std::vector<size_t> order(lines);
+    for (auto& item : order)
+      item = t.rng.next() % db.items;
+    when(read(warehouse), district, read(db.catalogue), stock)
+      << [t = std::move(t), sent, order = std::move(order)](
+           acquired_cown<const Warehouse> w,
+           acquired_cown<District> d,
+           acquired_cown<const Catalogue> cat,
+           acquired_cown<Stock> s) mutable {
+           int64_t total = 0;
+           for (auto item : order)
+           {
+             auto& q = s->quantities[item];
+             q = (q > 10) ? (q - 1) : (q + 90);
+             total += cat->prices[item];
+           }
+           (void)(total * (100 + w->tax + d->tax));
+           d->next_order++;
+           complete(t, sent);
+         };
+  }
+  else if (kind < 88)
+  {
+    when(warehouse, district, customer)
+      << [t = std::move(t), sent, amount](
+           acquired_cown<Warehouse> w,
+           acquired_cown<District> d,
+           acquired_cown<Customer> c) mutable {
+           w->ytd += amount;
+           d->ytd += amount;
+           c->balance -= amount;
+           c->payments++;
+           complete(t, sent);
+         };
+  }
+  else
+  {
+    when(district, customer)
+      << [t = std::move(t), sent, amount](
+           acquired_cown<District> d, acquired_cown<Customer> c) mutable {
+           if (d->delivered < d->next_order)
+           {
+             d->delivered++;
+             c->balance += amount;
+             c->deliveries++;
+           }
+           complete(t, sent);
+         };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BenchHarness bench(argc, argv);
+  harness = &bench;
+
+  size_t warehouses = bench.opt.is<size_t>("--warehouses", 0);
+  size_t terminals = bench.opt.is<size_t>("--terminals", 10);
+  size_t transactions =
+    bench.opt.is<size_t>("--transactions", 1'000) * bench.scale;
+  size_t customers = bench.opt.is<size_t>("--customers", 300);
+  size_t items = bench.opt.is<size_t>("--items", 10'000);
+  double theta = (double)bench.opt.is<size_t>("--theta", 99) / 100;
+
+  auto scenario = [&](const char* name, size_t read_pct) {
+    bench.run(name, [&](size_t cores) {
+      size_t count = (warehouses == 0) ? cores : warehouses;
+      auto db = std::make_shared<Database>(
+        count, customers, items, read_pct, theta);
+      xoroshiro::p128r32 seeds(1);
+      for (size_t i = 0; i < count * terminals; i++)
+      {
+        issue(Terminal{
+          db, xoroshiro::p128r32(seeds.next(), seeds.next()), transactions});
+      }
+      return count * terminals * transactions;
+    });
+  };
+
+  scenario("tpcc", 8);
+  scenario("tpcc/read_mostly", 80);
+
+  return bench.report();
+}
@@ -0,0 +1,158 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Baseline of the closed-loop message ubench on oneTBB, run with `--tbb`.
+ *
+ * Each `Pinger` is a mutex and its state, and each message is a task in a
+ * `tbb::task_group`, which holds the mutexes of its recipients while it
+ * runs, as a behaviour holds its cowns. A multi-message takes both mutexes
+ * with `std::scoped_lock`. Messages are counted as in the Verona version,
+ * and each interval reports the rate in the same format.
+ *
+ * This is built only when `VERONA_PERF_TBB` is set, see the runtime's
+ * `CMakeLists.txt`.
+ */
+
+#include "test/log.h"
+#include "test/xoroshiro.h"
+
+#include <chrono>
+#include <cstddef>
+
+#ifdef VERONA_PERF_TBB
+#  include <atomic>
+#  include <memory>
+#  include <mutex>
+#  include <tbb/task_arena.h>
+#  include <tbb/task_group.h>
+#  include <thread>
+#  include <vector>
+
+namespace tbb_ubench
+{
+  struct Pinger
+  {
+    std::mutex lock;
+    xoroshiro::p128r32 rng;
+    size_t select_mod = 0;
+    size_t count = 0;
+
+    Pinger(size_t seed, size_t percent_multimessage) : rng(seed)
+    {
+      if (percent_multimessage != 0)
+        select_mod = (size_t)((double)100.00 / (double)percent_multimessage);
+    }
+  };
+
+  struct Bench
+  {
+    std::vector<std::unique_ptr<Pinger>> pingers;
+    std::atomic<bool> running = false;
+    tbb::task_group group;
+  };
+
+  /**
+   * The body of a message to `p`. Returns the other recipient of the next
+   * message, if it is a multi-message.
+   */
+  Pinger* receive(Bench& b, Pinger* p)
+  {
+    p->count++;
+    const bool send_multimessage = (b.pingers.size() > 1) &&
+      (p->select_mod != 0) && ((p->rng.next() % p->select_mod) == 0);
+    if (!send_multimessage)
+      return nullptr;
+
+    Pinger* other;
+    do
+    {
+      other = b.pingers[p->rng.next() % b.pingers.size()].get();
+    } while (other == p);
+    return other;
+  }
+
+  /// Send a message to `p`, and also to `other` if it is not null.
+  void send(Bench& b, Pinger* p, Pinger* other)
+  {
+    b.group.run([&b, p, other]() {
+      if (!b.running.load(std::memory_order_relaxed))
+        return;
+
+      Pinger* next;
+      if (other == nullptr)
+      {
+        std::lock_guard<std::mutex> g(p->lock);
+        next = receive(b, p);
+      }
+      else
+      {
+        std::scoped_lock g(p->lock, other->lock);
+        next = receive(b, p);
+      }
+      send(b, p, next);
+    });
+  }
+}
+
+int tbb_main(
+  size_t seed,
+  size_t cores,
+  size_t pingers,
+  size_t initial_pings,
+  size_t percent_multimessage,
+  std::chrono::seconds report_interval,
+  size_t report_count)
+{
+  using namespace tbb_ubench;
+
+  tbb::task_arena arena((int)cores);
+  Bench b;
+  for (size_t p = 0; p < pingers; p++)
+    b.pingers.push_back(
+      std::make_unique<Pinger>(seed + p, percent_multimessage));
+
+  for (size_t r = 0; r < report_count; r++)
+  {
+    for (auto& p : b.pingers)
+      p->count = 0;
+    b.running = true;
+
+    // This thread is one of the `cores` threads of the arena, so it runs
+    // messages until the timer stops them.
+    auto start = std::chrono::steady_clock::now();
+    std::thread timer([&]() {
+      std::this_thread::sleep_for(report_interval);
+      b.running = false;
+    });
+    arena.execute([&]() {
+      for (auto& p : b.pingers)
+      {
+        for (size_t i = 0; i < initial_pings; i++)
+          send(b, p.get(), nullptr);
+      }
+      b.group.wait();
+    });
+    timer.join();
+
+    uint64_t t = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    uint64_t sum = 0;
+    for (auto& p : b.pingers)
+      sum += p->count;
+
+    uint64_t rate = (sum * 1'000'000'000) / t;
+    logger::cout() << t << " ns, " << rate << " msgs/s" << std::endl;
+  }
+  return 0;
+}
+#else
+int tbb_main(
+  size_t, size_t, size_t, size_t, size_t, std::chrono::seconds, size_t)
+{
+  logger::cout() << "Built without oneTBB, configure with VERONA_PERF_TBB"
+                 << std::endl;
+  return 1;
+}
+#endif
@@ -14,6 +14,26 @@
  * may randomly choose to include itself in the forwarded `Ping` multi-message
  * along with the selected recipient. By default 5% of `Ping` messages will
  * become these multi-messages.
+ *
+ * Passing `--inline` runs behaviours inline on the sending scheduler thread,
+ * when the send acquires all of their cowns immediately.
+ *
+ * All of the initial pings are sent from the `Start` behaviour, so the work
+ * starts on one scheduler thread. `--steal_batch` sets the number of cowns
+ * that may be taken in one steal, see `ThreadPool::set_steal_batch`.
+ *
+ * Passing `--open_loop` instead measures latency under a fixed arrival rate.
+ * `--generators` external threads send `Request` behaviours to random
+ * `Pinger`s, at `--rate` behaviours per second in total, whether or not the
+ * earlier ones have run. Each request spins for `--work` iterations, and its
+ * latency is measured from the time it was due to be sent, so that a late
+ * generator does not hide the queueing delay. Each interval reports the
+ * offered and achieved rates, and the latency percentiles, and then doubles
+ * the rate, so the last intervals show the latency as the offered load
+ * passes saturation.
+ *
+ * Passing `--tbb` runs the closed-loop benchmark on oneTBB instead, as a
+ * baseline, see `tbb_ubench.cc`.
  */
 
 #include "test/log.h"
@@ -21,6 +41,7 @@
 #include "test/xoroshiro.h"
 #include "verona.h"
 
+#include <atomic>
 #include <chrono>
 #include <test/harness.h>
 
@@ -112,6 +133,135 @@ namespace ubench
     }
   };
 
+  /// State of the `--open_loop` mode.
+  struct OpenLoop
+  {
+    size_t generators = 1;
+    size_t rate = 0;
+    size_t work = 0;
+    size_t seed = 0;
+    /// Generators still sending in this interval.
+    std::atomic<size_t> active = 0;
+    rt::LatencyHistogram latency;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static OpenLoop open_loop;
+
+  struct Request : public rt::VBehaviour<Request>
+  {
+    Pinger* pinger;
+    std::chrono::steady_clock::time_point due;
+
+    Request(Pinger* pinger_, std::chrono::steady_clock::time_point due_)
+    : pinger(pinger_), due(due_)
+    {}
+
+    void f()
+    {
+      for (size_t i = 0; i < open_loop.work; i++)
+        pinger->rng.next();
+      pinger->count++;
+
+      auto latency = std::chrono::steady_clock::now() - due;
+      open_loop.latency.record(
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+          .count());
+    }
+  };
+
+  struct OpenLoopReport;
+
+  /**
+   * Send requests from `id` at its share of the rate for an interval. The
+   * last generator to finish schedules the report on all the cowns, which
+   * runs after all the requests of the interval.
+   */
+  static void generate(Monitor* monitor, size_t id)
+  {
+    xoroshiro::p128r32 rng(open_loop.seed + id);
+    auto& pingers = monitor->pingers;
+    auto period = std::chrono::nanoseconds(std::max<size_t>(
+      (1'000'000'000 * open_loop.generators) / open_loop.rate, 1));
+    auto end = open_loop.start + monitor->report_interval;
+
+    // Offset the generators, so their requests interleave.
+    auto due = open_loop.start + ((period * id) / open_loop.generators);
+    for (; due < end; due += period)
+    {
+      if (std::chrono::steady_clock::now() < due)
+        std::this_thread::sleep_until(due);
+
+      auto* p = pingers[rng.next() % pingers.size()];
+      rt::Cown::schedule<Request>(p, p, due);
+    }
+
+    if (open_loop.active.fetch_sub(1) == 1)
+      rt::Cown::schedule<OpenLoopReport>(all_cowns_count, all_cowns, monitor);
+  }
+
+  static void start_generators(Monitor* monitor)
+  {
+    for (auto* p : monitor->pingers)
+      p->count = 0;
+    open_loop.latency.clear();
+    open_loop.start = std::chrono::steady_clock::now();
+    open_loop.active = open_loop.generators;
+
+    for (size_t i = 0; i < open_loop.generators; i++)
+      std::thread([=]() { generate(monitor, i); }).detach();
+  }
+
+  struct OpenLoopStart : public rt::VBehaviour<OpenLoopStart>
+  {
+    Monitor* monitor;
+
+    OpenLoopStart(Monitor* monitor_) : monitor(monitor_) {}
+
+    void f()
+    {
+      rt::Scheduler::add_external_event_source();
+      start_generators(monitor);
+    }
+  };
+
+  struct OpenLoopReport : public rt::VBehaviour<OpenLoopReport>
+  {
+    Monitor* monitor;
+
+    OpenLoopReport(Monitor* monitor_) : monitor(monitor_) {}
+
+    void f()
+    {
+      auto t = std::chrono::steady_clock::now() - open_loop.start;
+      uint64_t sum = 0;
+      for (auto* p : monitor->pingers)
+        sum += p->count;
+
+      auto& l = open_loop.latency;
+      uint64_t rate = (sum * 1'000'000'000) /
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t)
+          .count();
+      logger::cout() << "offered: " << open_loop.rate
+                     << " msgs/s, achieved: " << rate
+                     << " msgs/s, p50: " << l.percentile(0.5)
+                     << " ns, p99: " << l.percentile(0.99)
+                     << " ns, p99.9: " << l.percentile(0.999)
+                     << " ns, max: " << l.percentile(1.0) << " ns"
+                     << std::endl;
+
+      if (--monitor->report_count != 0)
+      {
+        open_loop.rate *= 2;
+        start_generators(monitor);
+        return;
+      }
+
+      rt::Scheduler::remove_external_event_source();
+      rt::Cown::release(sn::ThreadAlloc::get(), monitor);
+    }
+  };
+
   struct Stop;
   struct StopPinger;
   struct NotifyStopped;
@@ -227,6 +377,15 @@ namespace ubench
 
 using namespace ubench;
 
+int tbb_main(
+  size_t seed,
+  size_t cores,
+  size_t pingers,
+  size_t initial_pings,
+  size_t percent_multimessage,
+  std::chrono::seconds report_interval,
+  size_t report_count);
+
 int main(int argc, char** argv)
 {
   opt::Opt opt(argc, argv);
@@ -238,14 +397,52 @@ int main(int argc, char** argv)
   const auto report_count = opt.is<size_t>("--report_count", 10);
   const auto initial_pings = opt.is<size_t>("--initial_pings", 5);
   const auto percent_multimessage = opt.is<size_t>("--percent_multimessage", 5);
+  const auto inline_behaviours = opt.has("--inline");
+  const auto steal_batch = opt.is<size_t>("--steal_batch", 32);
+  const auto is_open_loop = opt.has("--open_loop");
+  const auto is_tbb = opt.has("--tbb");
+  open_loop.generators = opt.is<size_t>("--generators", 1);
+  open_loop.rate = opt.is<size_t>("--rate", 100'000);
+  open_loop.work = opt.is<size_t>("--work", 0);
+  open_loop.seed = seed;
   check(percent_multimessage <= 100);
+  check((open_loop.generators != 0) && (open_loop.rate != 0));
 
   logger::cout() << "cores: " << cores
                  << ", report_interval: " << report_interval.count()
                  << ", pingers: " << pingers
                  << ", initial_pings: " << initial_pings
                  << ", percent_mutlimessage: " << percent_multimessage
-                 << std::endl;
+                 << ", inline: " << inline_behaviours
+                 << ", steal_batch: " << steal_batch;
+  if (is_open_loop)
+  {
+    logger::cout() << ", open loop, generators: " << open_loop.generators
+                   << ", rate: " << open_loop.rate
+                   << ", work: " << open_loop.work;
+  }
+#ifdef USE_RUN_RING
+  logger::cout() << ", run ring";
+#endif
+#ifdef USE_NO_LEAK_DETECTOR
+  logger::cout() << ", no leak detector";
+#endif
+  if (is_tbb)
+    logger::cout() << ", oneTBB baseline";
+  logger::cout() << std::endl;
+
+  if (is_tbb)
+  {
+    check(!is_open_loop);
+    return tbb_main(
+      seed,
+      cores,
+      pingers,
+      initial_pings,
+      percent_multimessage,
+      report_interval,
+      report_count);
+  }
 
   auto& alloc = sn::ThreadAlloc::get();
 #ifdef USE_SYSTEMATIC_TESTING
@@ -256,6 +453,8 @@ int main(int argc, char** argv)
 #endif
   auto& sched = rt::Scheduler::get();
   sched.set_fair(true);
+  sched.set_inline_behaviours(inline_behaviours);
+  sched.set_steal_batch(steal_batch);
   sched.init(cores);
 
   static vector<Pinger*> pinger_set;
@@ -270,7 +469,10 @@ int main(int argc, char** argv)
   all_cowns = (rt::Cown**)alloc.alloc(all_cowns_count * sizeof(rt::Cown*));
   memcpy(all_cowns, pinger_set.data(), pinger_set.size() * sizeof(rt::Cown*));
   all_cowns[pinger_set.size()] = monitor;
-  rt::Cown::schedule<ubench::Start>(all_cowns_count, all_cowns, monitor);
+  if (is_open_loop)
+    rt::Cown::schedule<OpenLoopStart>(all_cowns_count, all_cowns, monitor);
+  else
+    rt::Cown::schedule<ubench::Start>(all_cowns_count, all_cowns, monitor);
 
   sched.run();
   alloc.dealloc(all_cowns, all_cowns_count * sizeof(rt::Cown*));
@@ -0,0 +1,73 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace verona::rt
+{
+  /**
+   * Tracks the number of messages that have been sent but not yet received by
+   * a set of cowns.  This is used by the backpressure benchmarks to check that
+   * the message queues of overloaded cowns stay bounded.
+   */
+  class QueueDepth
+  {
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> max_pending{0};
+    std::atomic<size_t> received_count{0};
+
+  public:
+    void send()
+    {
+      auto depth = pending.fetch_add(1, std::memory_order_relaxed) + 1;
+      auto prev = max_pending.load(std::memory_order_relaxed);
+      while ((depth > prev) &&
+             !max_pending.compare_exchange_weak(
+               prev, depth, std::memory_order_relaxed))
+      {}
+    }
+
+    void receive()
+    {
+      pending.fetch_sub(1, std::memory_order_relaxed);
+      received_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t max()
+    {
+      return max_pending.load(std::memory_order_relaxed);
+    }
+
+    size_t received()
+    {
+      return received_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Report the throughput and the maximum queue depth seen over `duration`.
+     * Returns false if the queue depth exceeded `limit`.  A `limit` of zero
+     * disables the check.
+     */
+    bool check(std::chrono::milliseconds duration, size_t limit)
+    {
+      auto ms = (std::max)(duration.count(), (decltype(duration.count()))1);
+      logger::cout() << "received: " << received() << " messages ("
+                     << (received() * 1000 / (size_t)ms) << " msgs/s)"
+                     << ", max queue depth: " << max() << std::endl;
+
+      if ((limit != 0) && (max() > limit))
+      {
+        logger::cout() << "FAIL: max queue depth " << max()
+                       << " exceeds limit " << limit << std::endl;
+        return false;
+      }
+      return true;
+    }
+  };
+}
@@ -6,6 +6,8 @@
 #include "ds/scramble.h"
 #include "test/xoroshiro.h"
 
+#include <algorithm>
+
 namespace verona::rt
 {
   class Systematic
@@ -47,6 +49,14 @@ namespace verona::rt
       /// Used for debugging.
       size_t systematic_id;
 
+      /// Virtual time of this thread, in nanoseconds, when simulating, see
+      /// `enable_simulation`.
+      uint64_t clock = 0;
+
+      /// Set if this thread was seen unable to make progress while
+      /// simulating. It resumes at the virtual time it is woken at.
+      bool waiting = false;
+
       /// Used to sleep and wake the threads systematically.
       pal::SleepHandle sh;
 
@@ -75,6 +85,17 @@ namespace verona::rt
     /// If true, then systematic testing has enabled a thread.
     static inline bool running{false};
 
+    /// Threads chosen to run, and calls to `yield_until` while running, since
+    /// the last `set_seed`.
+    static inline size_t switches{0};
+    static inline size_t yields{0};
+
+    /// See `enable_simulation`.
+    static inline bool simulating{false};
+    static inline uint64_t step_cost{0};
+    /// Virtual time of the thread last chosen to run.
+    static inline uint64_t sim_now{0};
+
     /// Return a mutable reference to the pseudo random number generator (PRNG).
     /// It is assumed that the PRNG will only be setup once via `set_seed`.
     /// After it is setup, the PRNG must only be used via `get_prng_next`.
@@ -95,6 +116,13 @@ namespace verona::rt
     }
 
   public:
+    /// See `get_counters`.
+    struct Counters
+    {
+      size_t switches;
+      size_t yields;
+    };
+
     /// Return the next pseudo random number.
     static uint32_t get_prng_next()
     {
@@ -115,6 +143,19 @@ namespace verona::rt
       auto& rng = get_prng_for_setup();
       rng.set_state(seed);
       get_scrambler_for_setup().setup(rng);
+      switches = 0;
+      yields = 0;
+    }
+
+    /**
+     * The scheduling decisions made since the last `set_seed`. A seed that
+     * switches threads much more often than others, for instance because
+     * threads keep stealing the same cowns from each other, shows here as
+     * well as in its run time, see `SystematicTestHarness`.
+     */
+    static Counters get_counters()
+    {
+      return {switches, yields};
     }
 
     /// 1/(2^range_bits) likelyhood of returning true
@@ -133,6 +174,12 @@ namespace verona::rt
      */
     static void choose_next(bool startup = false)
     {
+      if (simulating)
+      {
+        choose_next_simulated();
+        return;
+      }
+
       auto r = get_prng_next();
       auto i = snmalloc::bits::ctz(r != 0 ? r : 1);
       auto start = running_thread;
@@ -161,11 +208,60 @@ namespace verona::rt
       assert(curr->guard());
 
       running_thread = curr;
+      switches++;
       assert(curr->systematic_state == SystematicState::Active);
       curr->steps = get_prng_next() & curr->systematic_speed_mask;
       curr->sh.wake();
     }
 
+    /**
+     * Internal function for selecting the next thread to run when simulating.
+     * This is the thread that can make progress with the earliest virtual
+     * time, so the threads advance in virtual time as if they ran in
+     * parallel.
+     */
+    static void choose_next_simulated()
+    {
+      Local* next = nullptr;
+      auto curr = running_thread->next;
+      do
+      {
+        if (curr->systematic_state == SystematicState::Active)
+        {
+          if (!curr->guard())
+          {
+            curr->waiting = true;
+          }
+          else
+          {
+            if (curr->waiting)
+            {
+              curr->clock = std::max(curr->clock, sim_now);
+              curr->waiting = false;
+            }
+            if ((next == nullptr) || (curr->clock < next->clock))
+              next = curr;
+          }
+        }
+        curr = curr->next;
+      } while (curr != running_thread->next);
+
+      if (next == nullptr)
+      {
+        Logging::cout() << "All threads sleeping!" << Logging::endl;
+        abort();
+      }
+
+      Logging::cout() << "Set running thread:" << next->systematic_id
+                      << " at " << next->clock << Logging::endl;
+
+      sim_now = next->clock;
+      running_thread = next;
+      switches++;
+      next->steps = 0;
+      next->sh.wake();
+    }
+
   public:
     /**
      * Creates the structure for pausing a thread in systematic testing.  This
@@ -237,6 +333,9 @@ namespace verona::rt
         }
 
         assert(local_systematic != nullptr);
+        yields++;
+        if (simulating)
+          local_systematic->clock += step_cost;
 
         if (local_systematic->steps > 0 && guard())
         {
@@ -304,6 +403,59 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Simulate the threads in virtual time, for experimenting with scheduling
+     * policies, see `test/perf/simulate`. Instead of choosing the next thread
+     * at random, systematic testing runs the thread with the earliest virtual
+     * time, as a discrete event simulation. Each yield costs `step` virtual
+     * nanoseconds, and behaviours model their work with `advance`.
+     *
+     * This must be called before the threads are started, and stays on until
+     * `disable_simulation`.
+     */
+    static void enable_simulation(uint64_t step)
+    {
+      simulating = enabled;
+      step_cost = step;
+      sim_now = 0;
+    }
+
+    static void disable_simulation()
+    {
+      simulating = false;
+    }
+
+    /**
+     * The virtual time of the calling thread when simulating, or of the
+     * thread last chosen to run if it is not a systematic thread.
+     */
+    static uint64_t now()
+    {
+      if (local_systematic != nullptr)
+        return local_systematic->clock;
+      return sim_now;
+    }
+
+    /**
+     * Spend `ns` virtual nanoseconds on the calling thread, and let the
+     * threads that are earlier in virtual time run.
+     */
+    static void advance(uint64_t ns)
+    {
+      if constexpr (enabled)
+      {
+        if (simulating && (local_systematic != nullptr))
+        {
+          local_systematic->clock += ns;
+          yield();
+        }
+      }
+      else
+      {
+        snmalloc::UNUSED(ns);
+      }
+    }
+
     /**
      * Call this to start threads running in systematic testing.
      */
@@ -17,6 +17,7 @@
 #include "region/immutable.h"
 #include "region/region.h"
 #include "region/region_api.h"
+#include "sched/broadcast.h"
 #include "sched/cown.h"
 #include "sched/epoch.h"
 #include "sched/mpmcq.h"